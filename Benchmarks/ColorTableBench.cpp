@@ -0,0 +1,200 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// ColorTableBench -- CColorTable short names, the color markup used in Examples/, and lookup speed
+//
+//      ShortNames  -- Every conio short name ({r}, {db}, {ly}, {lgy}, ...) resolves, to the same color as its full name.
+//      Lookup      -- Time to resolve the short and full names, with and without user colors defined.
+//      Examples    -- Every "{...}" markup inside a string literal in the example sources (passed on the command line
+//                     by CMake) resolves: color names, "bg=", "fg=" and "lbg=" colors, colors made with MakeColor() and
+//                     fonts added with AddFont() in the same file.  Markup in comments is not checked.
+//
+//      ColorTableBench <example source files...>
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+#include "CColorTable.h"
+
+using namespace Sage;
+
+static constexpr int kLookupCount = 2000000;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+// Short names and the full names they stand for (conio.GetColorNames())
+
+static const char * const sShortNames[][2] =
+{
+    { "w",  "white"         },  { "r",  "red"           },  { "g",  "green"         },  { "b",  "blue"          },
+    { "c",  "cyan"          },  { "m",  "magenta"       },  { "p",  "purple"        },  { "y",  "yellow"        },
+    { "gy", "gray"          },  { "db", "darkblue"      },  { "dg", "darkgreen"     },  { "dc", "darkcyan"      },
+    { "dr", "darkred"       },  { "dp", "darkpurple"    },  { "dm", "darkmagenta"   },  { "dy", "darkyellow"    },
+    { "dgy","darkgray"      },  { "lb", "lightblue"     },  { "lg", "lightgreen"    },  { "lc", "lightcyan"     },
+    { "lr", "lightred"      },  { "lp", "lightpurple"   },  { "lm", "lightmagenta"  },  { "ly", "lightyellow"   },
+    { "lgy","lightgray"     },
+};
+
+// SourceFile_t -- String literals (with their line numbers) and the user colors and fonts named in one source file
+
+struct SourceFile_t
+{
+    struct Literal_t { std::string sText; int iLine; };
+
+    std::string             sPath;
+    std::vector<Literal_t>  vLiterals;
+    std::set<std::string>   setFonts;
+    std::set<std::string>   setColors;
+};
+
+// ReadLiterals() -- Collect the string literals of a C++ source, skipping comments and character literals.
+// Escapes are kept as written, which is enough to find "{...}" markup.
+
+static bool ReadLiterals(const char * sPath,SourceFile_t & stFile)
+{
+    FILE * fp = fopen(sPath,"rb");
+    if (!fp) return false;
+    std::string sSource;
+    char sBuffer[4096];
+    size_t szRead;
+    while ((szRead = fread(sBuffer,1,sizeof(sBuffer),fp)) > 0) sSource.append(sBuffer,szRead);
+    fclose(fp);
+
+    stFile.sPath = sPath;
+    int iLine = 1;
+    for (size_t i=0;i<sSource.size();i++)
+    {
+        char c = sSource[i];
+        if (c == '\n') { iLine++; continue; }
+        if (c == '/' && i+1 < sSource.size() && sSource[i+1] == '/')
+        {
+            while (i < sSource.size() && sSource[i] != '\n') i++;
+            iLine++;
+        }
+        else if (c == '/' && i+1 < sSource.size() && sSource[i+1] == '*')
+        {
+            for (i += 2;i+1 < sSource.size() && !(sSource[i] == '*' && sSource[i+1] == '/');i++) if (sSource[i] == '\n') iLine++;
+            i++;
+        }
+        else if (c == '"' || c == '\'')
+        {
+            SourceFile_t::Literal_t stLiteral{ std::string(),iLine };
+            for (i++;i < sSource.size() && sSource[i] != c && sSource[i] != '\n';i++)
+            {
+                if (sSource[i] == '\\' && i+1 < sSource.size()) stLiteral.sText += sSource[i++];
+                stLiteral.sText += sSource[i];
+            }
+            if (c == '"') stFile.vLiterals.push_back(stLiteral);
+        }
+    }
+
+    // Fonts and colors the file defines by name: AddFont("Arial,15","SmallFont") and MakeColor("MyColor",...)
+
+    for (size_t i=0;i+1<stFile.vLiterals.size();i++)
+    {
+        size_t szPos = sSource.find("AddFont(\"" + stFile.vLiterals[i].sText + "\"");
+        if (szPos != std::string::npos) stFile.setFonts.insert(stFile.vLiterals[i+1].sText);
+    }
+    for (auto & stLiteral : stFile.vLiterals)
+        if (sSource.find("MakeColor(\"" + stLiteral.sText + "\"") != std::string::npos) stFile.setColors.insert(stLiteral.sText);
+
+    return true;
+}
+
+// ResolveMarkup() -- true if the markup (the text between '{' and '}') is a closing tag, a known font, or a color
+
+static bool ResolveMarkup(const SourceFile_t & stFile,const std::string & sMarkup)
+{
+    if (sMarkup == "/" || stFile.setFonts.count(sMarkup)) return true;
+
+    const char * sColor = sMarkup.c_str();
+    size_t szEqual = sMarkup.find('=');
+    if (szEqual != std::string::npos)
+    {
+        std::string sKey = sMarkup.substr(0,szEqual);
+        for (auto & ch : sKey) ch = (char) CColorTable::Lower(ch);
+        if (sKey != "bg" && sKey != "fg" && sKey != "lbg") return false;
+        sColor += szEqual + 1;
+    }
+
+    DWORD dwColor;
+    return CColorTable::GetColor(sColor,(int) strlen(sColor),dwColor);
+}
+
+int main(int argc,char * argv[])
+{
+    int iErrors = 0;
+
+    // ShortNames
+
+    for (auto & sPair : sShortNames)
+    {
+        DWORD dwShort = 1,dwFull = 2;
+        if (!CColorTable::GetColor(sPair[0],dwShort) || !CColorTable::GetColor(sPair[1],dwFull) || dwShort != dwFull)
+        {
+            printf("{%s} does not resolve to the same color as {%s}\n",sPair[0],sPair[1]);
+            iErrors++;
+        }
+    }
+    printf("ShortNames  %d conio short names: %s\n",(int) (sizeof(sShortNames)/sizeof(sShortNames[0])),iErrors ? "errors" : "ok");
+
+    // Lookup
+
+    for (int iPass=0;iPass<2;iPass++)
+    {
+        if (iPass) CColorTable::MakeColor("BenchColor",RGB(10,20,30));
+
+        DWORD dwSum = 0,dwColor = 0;
+        int iNames = (int) (sizeof(sShortNames)/sizeof(sShortNames[0]));
+        auto tStart = std::chrono::steady_clock::now();
+        for (int i=0;i<kLookupCount;i++)
+        {
+            auto & sPair = sShortNames[i % iNames];
+            CColorTable::GetColor(sPair[i & 1],dwColor);
+            dwSum += dwColor;
+        }
+        double fMs = ElapsedMs(tStart);
+        printf("Lookup      %d lookups %s user colors: %.1f ms (%.1f ns each, check %u)\n",kLookupCount,
+               iPass ? "with" : "without",fMs,fMs*1e6/kLookupCount,(unsigned int) (dwSum & 0xFFFF));
+    }
+
+    // Examples
+
+    int iFiles = 0,iMarkups = 0,iUnresolved = 0;
+    std::vector<SourceFile_t> vFiles(argc > 1 ? argc-1 : 0);
+
+    for (int i=1;i<argc;i++)
+    {
+        if (!ReadLiterals(argv[i],vFiles[i-1])) { printf("Cannot read %s\n",argv[i]); iErrors++; continue; }
+        iFiles++;
+        for (auto & sColor : vFiles[i-1].setColors) CColorTable::MakeColor(sColor.c_str(),RGB(1,2,3));
+    }
+
+    for (auto & stFile : vFiles)
+        for (auto & stLiteral : stFile.vLiterals)
+            for (size_t szStart = stLiteral.sText.find('{');szStart != std::string::npos;szStart = stLiteral.sText.find('{',szStart+1))
+            {
+                size_t szEnd = stLiteral.sText.find('}',szStart);
+                if (szEnd == std::string::npos) break;
+                std::string sMarkup = stLiteral.sText.substr(szStart+1,szEnd-szStart-1);
+                iMarkups++;
+                if (!ResolveMarkup(stFile,sMarkup))
+                {
+                    printf("%s(%d): {%s} does not resolve\n",stFile.sPath.c_str(),stLiteral.iLine,sMarkup.c_str());
+                    iUnresolved++;
+                }
+            }
+
+    if (!iMarkups) { printf("No markup found -- the example sources were not passed on the command line\n"); iErrors++; }
+    iErrors += iUnresolved;
+    printf("Examples    %d files, %d markups, %d unresolved\n",iFiles,iMarkups,iUnresolved);
+
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
@@ -0,0 +1,267 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CompactStringBench -- CCompactString behavior checks, then CCompactString vs. std::string for many small strings
+//
+// Checks the in-object (SSO) and heap transitions at the 22-character edge, Reserve() and ShrinkToFit() capacity,
+// copy and move (within and across arenas), appending from the string itself, float styles, and that the memory
+// statistics return to zero once all strings are gone.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include "CCompactString.h"
+
+using namespace Sage;
+
+static constexpr int kNumStrings = 1000000;
+
+static int iErrors = 0;
+
+static void Check(bool bResult,const char * sTest,int iLine)
+{
+    if (!bResult && iErrors++ < 20) printf("Failed (line %d): %s\n",iLine,sTest);
+}
+
+#define CHECK(x) Check(x,#x,__LINE__)
+
+static std::string Repeat(char cChar,int iCount) { return std::string((size_t) iCount,cChar); }
+
+static void CheckSSOEdges()
+{
+    auto stStart = CStrC::GetMemStats();
+
+    CStrC csEmpty;
+    CHECK(csEmpty.isSSO() && csEmpty.isEmpty() && csEmpty.GetLength() == 0);
+    CHECK(csEmpty.GetCapacity() == (unsigned int) CStrC::kMaxSSOLength);
+    CHECK(csEmpty.GetMemSize() == sizeof(CStrC));
+    CHECK(csEmpty == "");
+
+    // Exactly kMaxSSOLength characters stays in the object; one more moves to the heap
+
+    std::string sFull = Repeat('a',CStrC::kMaxSSOLength);
+    CStrC csText(sFull.c_str());
+    CHECK(csText.isSSO() && csText.GetLength() == (unsigned int) CStrC::kMaxSSOLength && csText == sFull.c_str());
+
+    csText << 'b';
+    CHECK(!csText.isSSO() && csText.GetLength() == (unsigned int) CStrC::kMaxSSOLength+1 && csText == (sFull + "b").c_str());
+    CHECK(csText.GetCapacity() >= 2*CStrC::kSSOSize-1);
+    CHECK(csText.GetMemSize() == sizeof(CStrC) + csText.GetCapacity()+1);
+    CHECK(CStrC::GetMemStats().llHeapStrings == stStart.llHeapStrings+1);
+
+    // Clear() keeps the heap memory; ShrinkToFit() moves a short string back into the object
+
+    unsigned int uiCapacity = csText.GetCapacity();
+    csText.Clear();
+    CHECK(!csText.isSSO() && csText.isEmpty() && csText.GetCapacity() == uiCapacity);
+    csText << "short";
+    csText.ShrinkToFit();
+    CHECK(csText.isSSO() && csText == "short");
+    CHECK(CStrC::GetMemStats().llHeapStrings == stStart.llHeapStrings);
+
+    // ShrinkToFit() on a longer string reduces the capacity to the length
+
+    csText >> Repeat('c',40).c_str();
+    csText.Reserve(200);
+    CHECK(!csText.isSSO() && csText.GetCapacity() >= 200);
+    csText.ShrinkToFit();
+    CHECK(!csText.isSSO() && csText.GetCapacity() == 40 && csText == Repeat('c',40).c_str());
+
+    // Reserve() at the edge
+
+    CStrC csReserve;
+    CHECK(csReserve.Reserve(CStrC::kMaxSSOLength) && csReserve.isSSO());
+    CHECK(csReserve.Reserve(0) && csReserve.Reserve(-5) && csReserve.isSSO());
+    CHECK(csReserve.Reserve(CStrC::kMaxSSOLength+1) && !csReserve.isSSO() && csReserve.isEmpty());
+
+    // Growth is geometric: appending one character at a time reallocates O(log n) times
+
+    CStrC csGrow;
+    int iReallocs = 0;
+    for (int i=0;i<100000;i++)
+    {
+        unsigned int uiBefore = csGrow.GetCapacity();
+        csGrow << (char) ('a' + i % 26);
+        if (csGrow.GetCapacity() != uiBefore) iReallocs++;
+    }
+    CHECK(csGrow.GetLength() == 100000 && iReallocs < 30);
+    CHECK(csGrow.c_str()[99999] == 'a' + 99999 % 26 && csGrow.c_str()[100000] == 0);
+}
+
+static void CheckCopyMove()
+{
+    auto stStart = CStrC::GetMemStats();
+    std::string sLong = Repeat('x',50);
+
+    // Copies are independent, in both modes
+
+    CStrC csShort("abc");
+    CStrC csLong(sLong.c_str());
+    CStrC csShortCopy(csShort);
+    CStrC csLongCopy(csLong);
+    CHECK(csShortCopy.isSSO() && csShortCopy == "abc");
+    CHECK(!csLongCopy.isSSO() && csLongCopy == sLong.c_str() && csLongCopy.c_str() != csLong.c_str());
+    csLongCopy << "!";
+    CHECK(csLong == sLong.c_str());
+
+    // Copy assignment: heap into SSO, SSO into heap (which keeps its memory), and self-assignment
+
+    CStrC csTarget("small");
+    csTarget = csLong;
+    CHECK(!csTarget.isSSO() && csTarget == sLong.c_str());
+    csTarget = csShort;
+    CHECK(!csTarget.isSSO() && csTarget == "abc");
+    csTarget = *&csTarget;
+    CHECK(csTarget == "abc");
+
+    // Move construction takes the heap memory and leaves the source empty
+
+    const char * sData = csLong.c_str();
+    auto stBefore = CStrC::GetMemStats();
+    CStrC csMoved(std::move(csLong));
+    CHECK(csMoved.c_str() == sData && csMoved == sLong.c_str());
+    CHECK(csLong.isSSO() && csLong.isEmpty());
+    CHECK(CStrC::GetMemStats().llHeapStrings == stBefore.llHeapStrings);
+
+    CStrC csMovedShort(std::move(csShort));
+    CHECK(csMovedShort.isSSO() && csMovedShort == "abc" && csShort.isEmpty());
+
+    // Move assignment frees the target's memory
+
+    CStrC csAssign(Repeat('y',30).c_str());
+    stBefore = CStrC::GetMemStats();
+    csAssign = std::move(csMoved);
+    CHECK(csAssign.c_str() == sData && csMoved.isEmpty());
+    CHECK(CStrC::GetMemStats().llHeapStrings == stBefore.llHeapStrings-1);
+
+    // Float styles travel with copies and moves, and survive the move to the heap
+
+    CStrC csStyle;
+    csStyle.fs("%.3f") << 2.0;
+    CHECK(csStyle == "2.000");
+    CStrC csStyleCopy(csStyle);
+    csStyleCopy << ' ' << 1.5;
+    CHECK(csStyleCopy == "2.000 1.500");
+    csStyle << Repeat('-',30).c_str() << 0.25;
+    CHECK(!csStyle.isSSO() && !strcmp(csStyle.GetFloatStyle(),"%.3f") && csStyle == ("2.000" + Repeat('-',30) + "0.250").c_str());
+    CStrC csStyleMoved(std::move(csStyle));
+    CHECK(!strcmp(csStyleMoved.GetFloatStyle(),"%.3f") && !strcmp(csStyle.GetFloatStyle(),"%.3f"));
+    csStyleMoved.fs();
+    csStyleMoved >> 1.5;
+    CHECK(csStyleMoved == "1.5");
+
+    // Appending the string (or part of it) to itself, across the SSO edge
+
+    CStrC csSelf("0123456789abcde");
+    csSelf << csSelf;
+    CHECK(!csSelf.isSSO() && csSelf == "0123456789abcde0123456789abcde");
+    csSelf.Append(csSelf.c_str()+10,5);
+    CHECK(csSelf == "0123456789abcde0123456789abcdeabcde");
+    csSelf = csSelf.c_str()+30;
+    CHECK(csSelf == "abcde");
+
+    CStrC csNumbers;
+    csNumbers << "Item " << 12 << " of " << 3u << ' ' << -7LL << ' ' << 1.5;
+    CHECK(csNumbers == "Item 12 of 3 -7 1.5");
+
+    (void) stStart;
+}
+
+static void CheckArena()
+{
+    auto stStart = CStrC::GetMemStats();
+    CStringArena cArena;
+    CStringArena cOther;
+    {
+        CStrC csA(Repeat('a',30).c_str(),&cArena);
+        CStrC csB("short",&cArena);
+        CHECK(!csA.isSSO() && csA.GetArena() == &cArena && csB.isSSO());
+        CHECK(CStrC::GetMemStats().llArenaStrings == stStart.llArenaStrings+1);
+        CHECK(CStrC::GetMemStats().llHeapStrings == stStart.llHeapStrings);
+        CHECK(cArena.GetUsed() >= 31 && cArena.GetReserved() >= cArena.GetUsed());
+
+        // ShrinkToFit() does not apply to arena strings
+
+        csA.ShrinkToFit();
+        CHECK(!csA.isSSO());
+
+        // Moving within an arena takes the memory; moving to another arena copies
+
+        const char * sData = csA.c_str();
+        CStrC csSame(&cArena);
+        csSame = std::move(csA);
+        CHECK(csSame.c_str() == sData && csA.isEmpty());
+
+        CStrC csOther(&cOther);
+        csOther = std::move(csSame);
+        CHECK(csOther.c_str() != sData && csOther == Repeat('a',30).c_str() && csSame == Repeat('a',30).c_str());
+        CHECK(csOther.GetArena() == &cOther);
+
+        // Large strings get their own block
+
+        CStrC csLarge(&cArena);
+        csLarge.Reserve(100000);
+        CHECK(!csLarge.isSSO() && cArena.GetReserved() >= 100000);
+        csLarge << "x";
+        CHECK(csLarge == "x");
+    }
+    CHECK(CStrC::GetMemStats().llArenaStrings == stStart.llArenaStrings);
+    CHECK(CStrC::GetMemStats().llArenaBytes == stStart.llArenaBytes);
+    cArena.Reset();
+    CHECK(cArena.GetReserved() == 0 && cArena.GetUsed() == 0);
+}
+
+template <typename _fn>
+static double TimeMs(_fn && fnTest)
+{
+    auto tStart = std::chrono::steady_clock::now();
+    fnTest();
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+int main()
+{
+    CheckSSOEdges();
+    CheckCopyMove();
+    CheckArena();
+
+    auto stStats = CStrC::GetMemStats();
+    CHECK(stStats.llHeapStrings == 0 && stStats.llHeapBytes == 0 && stStats.llArenaStrings == 0 && stStats.llArenaBytes == 0);
+
+    // Timing -- many short strings ("Item nnnnnn") and some long ones, built with << and std::to_string()
+
+    volatile size_t szSink = 0;
+
+    printf("%-34s %12s %12s\n","Test","CStrC","std::string");
+    printf("%-34s %9d B %9d B\n","Object size",(int) sizeof(CStrC),(int) sizeof(std::string));
+
+    double fCompact = TimeMs([&]
+    {
+        std::vector<CStrC> vStrings(kNumStrings);
+        for (int i=0;i<kNumStrings;i++)
+        {
+            vStrings[i] << "Item " << i;
+            if (!(i & 15)) vStrings[i] << " -- with a longer description";
+        }
+        szSink += vStrings.back().GetLength();
+    });
+    double fStd = TimeMs([&]
+    {
+        std::vector<std::string> vStrings(kNumStrings);
+        for (int i=0;i<kNumStrings;i++)
+        {
+            vStrings[i] += "Item ";
+            vStrings[i] += std::to_string(i);
+            if (!(i & 15)) vStrings[i] += " -- with a longer description";
+        }
+        szSink += vStrings.back().length();
+    });
+    printf("%-34s %9.1f ms %9.1f ms\n","Build 1M strings (1/16 long)",fCompact,fStd);
+
+    if (iErrors) printf("FAILED (%d errors)\n",iErrors);
+    else printf("Passed\n");
+    return iErrors ? 1 : 0;
+}
@@ -0,0 +1,211 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// DebugLogBench -- Cost of debug output on the writing threads: CDebugLog vs. a shared, locked printf() line buffer
+//
+//      Locked      -- What CProcessWindow::printf() does today: one 2000-character line buffer behind a lock, formatted
+//                     with vsnprintf() by the writing thread (the window's GDI work is not even included)
+//      CDebugLog   -- Log() into the thread's ring; a separate thread drains, as the debug window would
+//
+// Both are timed on one thread (the writer's cost alone) and on 4 threads (wall time per call, which on machines with
+// fewer cores than threads includes the drain thread's time).
+//
+// Then checks that:
+//
+//      - every record is drained, each thread's records in order, and formats to the same text as snprintf()
+//      - with no drain, a full ring drops records and counts them (GetDropped()) without blocking
+//      - rings of threads that have exited are drained and then reused by new threads
+//      - the spill file gets every drained record
+//
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CDebugLog.h"
+
+using namespace Sage;
+
+static constexpr int kNumThreads    = 4;
+static constexpr int kPerThread     = 500000;
+
+// CLockedLog -- One shared line buffer, formatted under a lock
+
+class CLockedLog
+{
+    std::mutex  m_mtLock;
+    char        m_sWriteLine[2000];
+    size_t      m_szChecksum = 0;
+
+public:
+    void printf(const char * sFormat,...)
+    {
+        std::lock_guard<std::mutex> lock(m_mtLock);
+        va_list vaArgs;
+        va_start(vaArgs,sFormat);
+        int iLength = vsnprintf(m_sWriteLine,sizeof(m_sWriteLine),sFormat,vaArgs);
+        va_end(vaArgs);
+        m_szChecksum += iLength + m_sWriteLine[0];
+    }
+    size_t GetChecksum() const { return m_szChecksum; }
+};
+
+template <typename _Fn>
+static double NsPerCall(_Fn && fnThread)
+{
+    std::vector<std::thread> vThreads;
+    auto tStart = std::chrono::steady_clock::now();
+    for (int t=0;t<kNumThreads;t++) vThreads.emplace_back([&,t] { fnThread(t); });
+    for (auto & cThread : vThreads) cThread.join();
+    double fNs = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-tStart).count();
+    return fNs/kPerThread;           // Wall time per call on each thread
+}
+
+int main()
+{
+    int iErrors = 0;
+
+    // Locked shared buffer
+
+    CLockedLog cLocked;
+    double fLockedNs = NsPerCall([&](int t)
+    {
+        for (int i=0;i<kPerThread;i++) cLocked.printf("Worker %d: batch %d done in %.2f ms (%s)\n",t,i,i*0.01,"ok");
+    });
+
+    // Producer side only: one thread, no drain (the ring holds every record)
+
+    double fLockedOneNs,fLogOneNs;
+    {
+        CLockedLog cLockedOne;
+        CDebugLog cLogOne(64 << 20,16);
+        auto tStart = std::chrono::steady_clock::now();
+        for (int i=0;i<kPerThread;i++) cLockedOne.printf("Worker %d: batch %d done in %.2f ms (%s)\n",0,i,i*0.01,"ok");
+        fLockedOneNs = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-tStart).count()/kPerThread;
+
+        int iDropped = 0;
+        tStart = std::chrono::steady_clock::now();
+        for (int i=0;i<kPerThread;i++) iDropped += !cLogOne.Log("Worker %d: batch {g}%d{/} done in %.2f ms (%s)\n",0,i,i*0.01,"ok");
+        fLogOneNs = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-tStart).count()/kPerThread;
+        if (iDropped) { printf("%d records dropped from a ring large enough for all\n",iDropped); iErrors++; }
+    }
+
+    // CDebugLog, drained concurrently
+
+    CDebugLog cLog(1 << 20,kNumThreads*kPerThread);
+    std::atomic<bool> bStop{false};
+    int iDrains = 0;
+    std::thread cDrain([&]
+    {
+        while (!bStop) { if (!cLog.Drain()) std::this_thread::yield(); else iDrains++; }
+        cLog.Drain();
+    });
+
+    double fLogNs = NsPerCall([&](int t)
+    {
+        for (int i=0;i<kPerThread;i++)
+            while (!cLog.Log("Worker %d: batch {g}%d{/} done in %.2f ms (%s)\n",t,i,i*0.01,"ok")) std::this_thread::yield();
+    });
+    bStop = true;
+    cDrain.join();
+
+    // Every record, in order per thread, formatted as snprintf() would
+
+    if (cLog.GetCount() != kNumThreads*kPerThread) { printf("Drained %d of %d records\n",cLog.GetCount(),kNumThreads*kPerThread); iErrors++; }
+
+    std::vector<int> vNext(kNumThreads,0);
+    std::string sLine;
+    char sExpected[256];
+    int iBad = 0;
+    for (uint64_t ullIndex = cLog.GetFirstIndex();ullIndex < cLog.GetEndIndex();ullIndex++)
+    {
+        cLog.GetLine(ullIndex,sLine);
+        int iThread = -1,iValue = -1;
+        if (sscanf(sLine.c_str(),"Worker %d: batch {g}%d",&iThread,&iValue) != 2 || iThread < 0 || iThread >= kNumThreads || iValue != vNext[iThread]++)
+        {
+            if (iBad++ < 5) printf("Record %llu: \"%s\"\n",(unsigned long long) ullIndex,sLine.c_str());
+            continue;
+        }
+        snprintf(sExpected,sizeof(sExpected),"Worker %d: batch {g}%d{/} done in %.2f ms (%s)",iThread,iValue,iValue*0.01,"ok");
+        if (sLine != sExpected && iBad++ < 5) printf("\"%s\" should be \"%s\"\n",sLine.c_str(),sExpected);
+    }
+    if (iBad) { printf("%d records wrong or out of order\n",iBad); iErrors++; }
+
+    // Types
+
+    CDebugLog cTypes;
+    std::string sName = "name";
+    cTypes.Log("%s|%5.1f|%lld|%u|%c|%x|%-4s|%*d|%s",sName,2.25f,-(1LL << 40),4000000000u,'A',255,"ab",5,42,(const char *) nullptr);
+    cTypes.Drain();
+    cTypes.GetLine(0,sLine);
+    if (sLine != "name|  2.2|-1099511627776|4000000000|A|ff|ab  |   42|(null)") { printf("Types: \"%s\"\n",sLine.c_str()); iErrors++; }
+
+    // Drops: a small ring with no drain
+
+    CDebugLog cSmall(4096,100);
+    int iAccepted = 0;
+    for (int i=0;i<10000;i++) iAccepted += cSmall.Log("Record %d %s",i,"padding text");
+    if (cSmall.GetDropped() != (uint64_t) (10000 - iAccepted) || iAccepted == 0 || iAccepted == 10000)
+    {
+        printf("Drop count %llu, accepted %d\n",(unsigned long long) cSmall.GetDropped(),iAccepted);
+        iErrors++;
+    }
+    cSmall.Drain();
+    if (!cSmall.Log("After drain %d",1)) { printf("Ring did not recover after Drain()\n"); iErrors++; }
+
+    // Ring reuse: threads that exit give their rings back, so waves of short-lived threads don't add rings, and the
+    // records they left behind are still drained
+
+    CDebugLog cWaves(4096,1000);
+    int iWaveRecords = 0;
+    for (int iWave=0;iWave<20;iWave++)
+    {
+        std::vector<std::thread> vWave;
+        for (int t=0;t<kNumThreads;t++) vWave.emplace_back([&,t] { for (int i=0;i<5;i++) cWaves.Log("Wave %d thread %d line %d",iWave,t,i); });
+        for (auto & cThread : vWave) cThread.join();
+        iWaveRecords += kNumThreads*5;
+        cWaves.Drain();         // Collects the records, and frees the rings of the exited threads
+    }
+    if (cWaves.GetNumThreads() != kNumThreads || cWaves.GetCount() != iWaveRecords || cWaves.GetDropped())
+    {
+        printf("Ring reuse: %d rings (%d expected), %d of %d records drained\n",cWaves.GetNumThreads(),kNumThreads,cWaves.GetCount(),iWaveRecords);
+        iErrors++;
+    }
+
+    // Spill file
+
+    const char * sSpill = "DebugLogBench_spill.txt";
+    remove(sSpill);
+    CDebugLog cSpill(1 << 16,16);
+    cSpill.SetSpillFile(sSpill);
+    for (int i=0;i<1000;i++) { cSpill.Log("Spilled line %d",i); if (i % 100 == 99) cSpill.Drain(); }
+    cSpill.SetSpillFile(nullptr);
+
+    int iSpilled = 0;
+    if (FILE * fp = fopen(sSpill,"rb"))
+    {
+        char sBuffer[128];
+        while (fgets(sBuffer,sizeof(sBuffer),fp))
+        {
+            int iValue = -1;
+            if (sscanf(sBuffer,"Spilled line %d",&iValue) == 1 && iValue == iSpilled) iSpilled++;
+        }
+        fclose(fp);
+    }
+    remove(sSpill);
+    if (iSpilled != 1000) { printf("Spill file has %d of 1000 lines in order\n",iSpilled); iErrors++; }
+    if (cSpill.GetCount() != 16) { printf("History holds %d records (16 expected)\n",cSpill.GetCount()); iErrors++; }
+
+    printf("%-46s %10.1f ns/call\n","Locked buffer + vsnprintf, 1 thread",fLockedOneNs);
+    printf("%-46s %10.1f ns/call  (%.1fx)\n","CDebugLog::Log(), 1 thread",fLogOneNs,fLockedOneNs/fLogOneNs);
+    printf("%-46s %10.1f ns/call\n","Locked buffer + vsnprintf, 4 threads",fLockedNs);
+    printf("%-46s %10.1f ns/call  (%.1fx)\n","CDebugLog::Log(), 4 threads + drain thread",fLogNs,fLockedNs/fLogNs);
+    printf("%-46s %10d\n","Drain() calls",iDrains);
+
+    printf("\n%s (%d errors)   [checksum %zu]\n",iErrors ? "FAILED" : "Passed",iErrors,cLocked.GetChecksum());
+    return iErrors ? 1 : 0;
+}
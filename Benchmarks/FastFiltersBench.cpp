@@ -0,0 +1,140 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// FastFiltersBench -- CFastFilters fast filters vs. their xxxNaive() reference versions
+//
+// Checks that BoxBlur(), Erode(), Dilate() and Median() give exactly the same output as BoxBlurNaive(), ErodeNaive(),
+// DilateNaive() and MedianNaive() for a range of radii on an odd-sized random image (so row padding and edges are
+// exercised), then times both at a larger radius.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "CFastFilters.h"
+
+using namespace Sage;
+
+static constexpr int kCheckWidth    = 157;
+static constexpr int kCheckHeight   = 203;
+static constexpr int kMaxRadius     = 20;
+static constexpr int kMaxMedianCheck = 8;       // MedianNaive() is slow, so larger median radii are only spot-checked
+static constexpr int kTimeRadius    = 15;
+
+// CTestBitmap -- A 24-bit bitmap with padded rows in a std::vector (Sage::CreateBitmap() is in the library)
+
+class CTestBitmap
+{
+    std::vector<unsigned char> m_vMem;
+
+public:
+    RawBitmap_t stBitmap{};
+
+    CTestBitmap(int iWidth,int iHeight)
+    {
+        stBitmap.iWidth         = iWidth;
+        stBitmap.iHeight        = iHeight;
+        stBitmap.iWidthBytes    = (iWidth*3 + 3) & ~3;
+        stBitmap.iOverHang      = stBitmap.iWidthBytes - iWidth*3;
+        stBitmap.iTotalSize     = stBitmap.iWidthBytes*iHeight;
+        m_vMem.assign((size_t) stBitmap.iTotalSize,0);
+        stBitmap.stMem          = m_vMem.data();
+        stBitmap.stRGB          = (RGBColor24 *) stBitmap.stMem;
+    }
+
+    RawBitmap_t & operator * () { return stBitmap; }
+
+    void FillRandom(unsigned int uiSeed)
+    {
+        std::mt19937 cRand(uiSeed);
+        for (int iY=0;iY<stBitmap.iHeight;iY++)
+        {
+            unsigned char * sRow = stBitmap.stMem + (long long) iY*stBitmap.iWidthBytes;
+            for (int iX=0;iX<stBitmap.iWidth*3;iX++) sRow[iX] = (unsigned char) cRand();
+        }
+    }
+
+    // Compare() -- Number of pixel bytes that differ (row padding is ignored)
+
+    int Compare(CTestBitmap & cOther)
+    {
+        int iDiff = 0;
+        for (int iY=0;iY<stBitmap.iHeight;iY++)
+        {
+            const unsigned char * s1 = stBitmap.stMem + (long long) iY*stBitmap.iWidthBytes;
+            const unsigned char * s2 = cOther.stBitmap.stMem + (long long) iY*cOther.stBitmap.iWidthBytes;
+            for (int iX=0;iX<stBitmap.iWidth*3;iX++) iDiff += s1[iX] != s2[iX];
+        }
+        return iDiff;
+    }
+};
+
+typedef bool (*FilterFn_t)(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius);
+
+struct stFilterPair_t
+{
+    const char    * sName;
+    FilterFn_t      fnFast;
+    FilterFn_t      fnNaive;
+    int             iMaxCheck;
+};
+
+template <typename _fn>
+static double TimeMs(_fn && fnTest)
+{
+    auto tStart = std::chrono::steady_clock::now();
+    fnTest();
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+int main()
+{
+    stFilterPair_t stFilters[] =
+    {
+        { "BoxBlur",    CFastFilters::BoxBlur,  CFastFilters::BoxBlurNaive, kMaxRadius },
+        { "Erode",      CFastFilters::Erode,    CFastFilters::ErodeNaive,   kMaxRadius },
+        { "Dilate",     CFastFilters::Dilate,   CFastFilters::DilateNaive,  kMaxRadius },
+        { "Median",     CFastFilters::Median,   CFastFilters::MedianNaive,  kMaxMedianCheck },
+    };
+
+    CTestBitmap cSource(kCheckWidth,kCheckHeight);
+    CTestBitmap cFast(kCheckWidth,kCheckHeight);
+    CTestBitmap cNaive(kCheckWidth,kCheckHeight);
+    cSource.FillRandom(12345);
+
+    int iErrors = 0;
+
+    // Correctness
+
+    for (auto & stFilter : stFilters)
+    {
+        for (int iRadius=0;iRadius<=kMaxRadius;iRadius++)
+        {
+            if (iRadius > stFilter.iMaxCheck && iRadius != kMaxRadius) continue;
+
+            bool bFast  = stFilter.fnFast(*cSource,*cFast,iRadius);
+            bool bNaive = stFilter.fnNaive(*cSource,*cNaive,iRadius);
+            int iDiff = bFast && bNaive ? cFast.Compare(cNaive) : -1;
+            if (iDiff && iErrors++ < 10) printf("%s radius %d: %d bytes differ%s\n",stFilter.sName,iRadius,iDiff,iDiff < 0 ? " (filter failed)" : "");
+        }
+    }
+
+    // Timing on a larger image
+
+    CTestBitmap cBig(512,384);
+    CTestBitmap cBigOut(512,384);
+    cBig.FillRandom(54321);
+
+    printf("%-12s %12s %12s %8s   (512x384, radius %d)\n","Filter","Fast","Naive","Speedup",kTimeRadius);
+    for (auto & stFilter : stFilters)
+    {
+        double fFast  = TimeMs([&] { stFilter.fnFast(*cBig,*cBigOut,kTimeRadius); });
+        double fNaive = TimeMs([&] { stFilter.fnNaive(*cBig,*cBigOut,kTimeRadius); });
+        printf("%-12s %9.2f ms %9.2f ms %7.1fx\n",stFilter.sName,fFast,fNaive,fNaive/fFast);
+    }
+
+    if (iErrors) printf("FAILED (%d errors)\n",iErrors);
+    else printf("Passed\n");
+    return iErrors ? 1 : 0;
+}
@@ -0,0 +1,696 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// FormulaCompileBench -- Front-end compile throughput (lines/sec) with node-by-node allocation and linear lookups vs.
+// CTokenArena (compile arena, interned identifiers, hashed symbols and perfect-hash keyword/operator tables)
+//
+// Generates a 20,000-line formula library and compiles it to stNODE trees with the same small front end (tokenize,
+// parse, look up keywords, operators and variables, build nodes) in two configurations:
+//
+//      Linear  -- new for each stNODE/stNODEDATA/stVARSTRUCT, linear scans of stTokenAlphaLookup and stTokenOperatorLookup,
+//                 and variables kept in a linked list searched with strcmp(), then deleted node by node
+//      Arena   -- CCompileArena, CIdentifierTable, CSymbolTable and CTokenLookup, freed with one Reset()
+//
+// Both must produce the same trees (checked with a hash of every tree) before they are timed.
+//
+// The trees are then compiled with CFormulaCompiler (CFormulaVM) and run against a tree-walking reference that applies
+// CFormulaProgram::Apply() node by node:
+//
+//      Cases       -- Hand-written formulas for constant folding, shared subexpressions (CSE, including operands swapped
+//                     for commutative operators only) and non-commutative operators (x-y vs. y-x, div, mod, <, <=),
+//                     with the number of instructions each must compile to.
+//      Statements  -- Every statement of a 2,000-line library over 24 variables compiled on its own, and a 40-statement
+//                     block compiled as one program (assignments feed later statements).  Evaluate() and EvaluateN() must
+//                     give the reference result and assigned variables for every set of values.
+//      VM          -- Time to run the 40-statement block over 64K sets of values with Evaluate() (one set at a time) vs.
+//                     EvaluateN().
+//
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "CFormulaVM.h"
+#include "CTokenArena.h"
+
+using namespace Sage;
+
+static constexpr int kNumLines      = 20000;
+static constexpr int kNumVariables  = 2000;
+static constexpr double kMinSeconds = 1.0;           // Each configuration is timed for at least this long
+
+static constexpr int kVmLines       = 2000;          // Statements compiled one at a time
+static constexpr int kVmVariables   = 8;             // value_, gain_ and offset_ 0..7 (24 variables)
+static constexpr int kVmBlock       = 40;            // Statements compiled as one program
+static constexpr int kVmSets        = 1000;          // Sets of values each program is checked with
+static constexpr int kVmTimeSets    = 65536;
+static constexpr int kVmTimeRuns    = 5;             // Best of
+
+static double ElapsedMs(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+// Linear -- Allocation and lookups done the straightforward way
+
+class CLinearPolicy
+{
+    std::vector<stNODE *>       m_vNodes;
+    std::vector<stNODEDATA *>   m_vNodeData;
+    stVARSTRUCT               * m_stVars = nullptr;
+
+    static bool EqualNoCase(const char * s1,const char * s2,int iLength)
+    {
+        for (int i=0;i<iLength;i++) if (toupper((unsigned char) s1[i]) != toupper((unsigned char) s2[i])) return false;
+        return !s2[iLength];
+    }
+
+public:
+    ~CLinearPolicy() { Reset(); }
+
+    stNODE * NewNode()
+    {
+        auto stNode = new stNODE();
+        stNode->stNodeData = new stNODEDATA();
+        m_vNodes.push_back(stNode);
+        m_vNodeData.push_back(stNode->stNodeData);
+        return stNode;
+    }
+
+    TokenType FindKeyword(const char * sToken,int iLength)
+    {
+        for (int i=0;stTokenAlphaLookup[i].sToken;i++)
+            if (EqualNoCase(sToken,stTokenAlphaLookup[i].sToken+1,iLength)) return stTokenAlphaLookup[i].eToken;
+        return tNULL;
+    }
+
+    TokenType MatchOperator(const char * sText,int & iLength)
+    {
+        TokenType eToken = tNULL;
+        iLength = 0;
+        for (auto & stOp : stTokenOperatorLookup)
+        {
+            int iOpLength = (int) strlen(stOp.sToken);
+            if (iOpLength > iLength && !strncmp(sText,stOp.sToken,iOpLength)) { eToken = stOp.eToken; iLength = iOpLength; }
+        }
+        return eToken;
+    }
+
+    stVARSTRUCT * FindVar(const char * sToken,int iLength)
+    {
+        char sName[100];
+        if (iLength > 99) iLength = 99;
+        memcpy(sName,sToken,iLength);
+        sName[iLength] = 0;
+
+        for (auto stVar = m_stVars;stVar;stVar = stVar->stNextVar) if (!strcmp(stVar->sName,sName)) return stVar;
+
+        auto stVar = new stVARSTRUCT();
+        strcpy(stVar->sName,sName);
+        stVar->spName       = stVar->sName;
+        stVar->stNextVar    = m_stVars;
+        m_stVars            = stVar;
+        return stVar;
+    }
+
+    void Reset()
+    {
+        for (auto p : m_vNodes) delete p;
+        for (auto p : m_vNodeData) delete p;
+        m_vNodes.clear();
+        m_vNodeData.clear();
+        for (auto stVar = m_stVars;stVar;)
+        {
+            auto stNext = stVar->stNextVar;
+            delete stVar;
+            stVar = stNext;
+        }
+        m_stVars = nullptr;
+    }
+};
+
+// Arena -- CTokenArena
+
+class CArenaPolicy
+{
+    CCompileArena               m_cArena;
+    CIdentifierTable            m_cNames{m_cArena};
+    CSymbolTable<stVARSTRUCT>   m_cVars;
+    const CTokenLookup        & m_cKeywords     = CTokenLookup::GetAlphaTable();
+    const CTokenLookup        & m_cOperators    = CTokenLookup::GetOperatorTable();
+
+public:
+    stNODE * NewNode()
+    {
+        auto stNode = m_cArena.NewZeroed<stNODE>();
+        stNode->stNodeData = m_cArena.NewZeroed<stNODEDATA>();
+        return stNode;
+    }
+
+    TokenType FindKeyword(const char * sToken,int iLength) { return m_cKeywords.Find(sToken,iLength); }
+    TokenType MatchOperator(const char * sText,int & iLength) { return m_cOperators.Match(sText,iLength); }
+
+    stVARSTRUCT * FindVar(const char * sToken,int iLength)
+    {
+        const char * sName = m_cNames.Intern(sToken,iLength);
+        if (auto stVar = m_cVars.Find(sName)) return stVar;
+
+        auto stVar = m_cArena.NewZeroed<stVARSTRUCT>();
+        stVar->spName = (char *) sName;
+        m_cVars.Add(sName,stVar);
+        return stVar;
+    }
+
+    void Reset()
+    {
+        m_cVars.Clear();
+        m_cNames.Clear();
+        m_cArena.Reset();
+    }
+};
+
+// CFrontEnd -- Statements of the form "name := expression;" with C and keyword operators, parsed to stNODE trees
+
+template <typename _Policy>
+class CFrontEnd
+{
+    _Policy       & m_cPolicy;
+    const char    * m_sText     = nullptr;
+    int             m_iLine     = 1;
+
+    TokenType       m_eToken    = tNULL;
+    const char    * m_sToken    = nullptr;
+    int             m_iLength   = 0;
+    bool            m_bError    = false;
+
+    static bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    void Next()
+    {
+        for (;;)
+        {
+            while (*m_sText == ' ' || *m_sText == '\t' || *m_sText == '\r' || *m_sText == '\n') if (*m_sText++ == '\n') m_iLine++;
+            if (m_sText[0] != '/' || m_sText[1] != '/') break;
+            while (*m_sText && *m_sText != '\n') m_sText++;
+        }
+
+        m_sToken = m_sText;
+        if (!*m_sText) { m_eToken = tEOF; m_iLength = 0; return; }
+
+        if (isAlpha(*m_sText))
+        {
+            while (isAlpha(*m_sText) || isDigit(*m_sText)) m_sText++;
+            m_iLength = (int) (m_sText - m_sToken);
+            m_eToken = m_cPolicy.FindKeyword(m_sToken,m_iLength);
+            if (m_eToken == tNULL) m_eToken = tVar;
+            return;
+        }
+        if (isDigit(*m_sText))
+        {
+            m_eToken = tNum;
+            while (isDigit(*m_sText) || *m_sText == '.') if (*m_sText++ == '.') m_eToken = tFloat;
+            m_iLength = (int) (m_sText - m_sToken);
+            return;
+        }
+
+        m_eToken = m_cPolicy.MatchOperator(m_sText,m_iLength);
+        if (m_eToken == tNULL) { m_eToken = tBad; m_iLength = 1; }
+        m_sText += m_iLength;
+    }
+
+    stNODE * Node(eNODETYPE eType,stNODE * stLeft = nullptr,stNODE * stRight = nullptr)
+    {
+        stNODE * stNode = m_cPolicy.NewNode();
+        stNode->stNodeData->eNodeType   = eType;
+        stNode->stNodeData->iLineNumber = m_iLine;
+        stNode->tLeft                   = stLeft;
+        stNode->tRight                  = stRight;
+        if (stLeft) stLeft->tParent     = stNode;
+        if (stRight) stRight->tParent   = stNode;
+        return stNode;
+    }
+
+    stNODE * Primary()
+    {
+        stNODE * stNode = nullptr;
+        switch (m_eToken)
+        {
+            case tNum:
+                stNode = Node(nNum);
+                stNode->stNodeData->suTokenData.stNumber.stNumber.LSW = strtoul(m_sToken,nullptr,10);
+                break;
+            case tFloat:
+                stNode = Node(nFloat);
+                stNode->stNodeData->suTokenData.stNumber.stNumber.fFloat = strtof(m_sToken,nullptr);
+                break;
+            case tVar:
+                stNode = Node(nVar);
+                stNode->stNodeData->suTokenData.stVar = m_cPolicy.FindVar(m_sToken,m_iLength);
+                break;
+            case tlparen:
+                Next();
+                stNode = Expression(0);
+                if (m_eToken != trparen) m_bError = true;
+                break;
+            case tSub:
+                Next();
+                return Node(nneg,Primary());
+            case tNot:
+                Next();
+                return Node(nNot,Primary());
+            default:
+                m_bError = true;
+                return Node(nBad);
+        }
+        Next();
+        return stNode;
+    }
+
+    static int GetPriority(TokenType eToken,eNODETYPE & eType)
+    {
+        switch (eToken)
+        {
+            case tlogOr:                eType = nlogOr;         return 1;
+            case tlogAnd:               eType = nlogAnd;        return 2;
+            case tEqualto:              eType = nEqualto;       return 3;
+            case tNotEqualto:           eType = nNotEqualto;    return 3;
+            case tLessThan:             eType = nLessThan;      return 3;
+            case tGreaterThan:          eType = nGreaterThan;   return 3;
+            case tLessThanEqual:        eType = nGreaterThan;   return 3;       // not (a > b)
+            case tGreaterThanEqual:     eType = nLessThan;      return 3;       // not (a < b)
+            case tAdd:                  eType = nAdd;           return 4;
+            case tSub:                  eType = nSub;           return 4;
+            case tOr:                   eType = nOr;            return 4;
+            case txor:                  eType = nxor;           return 4;
+            case tMul:                  eType = nMul;           return 5;
+            case tDiv:                  eType = nDiv;           return 5;
+            case tMod:                  eType = nMod;           return 5;
+            case tAnd:                  eType = nAnd;           return 5;
+            default:                                            return 0;
+        }
+    }
+
+    stNODE * Expression(int iMinPriority)
+    {
+        stNODE * stLeft = Primary();
+        for (;;)
+        {
+            eNODETYPE eType;
+            TokenType eToken = m_eToken;
+            int iPriority = GetPriority(eToken,eType);
+            if (!iPriority || iPriority <= iMinPriority) return stLeft;
+
+            Next();
+            stLeft = Node(eType,stLeft,Expression(iPriority));
+            if (eToken == tLessThanEqual || eToken == tGreaterThanEqual) stLeft = Node(nNot,stLeft);
+        }
+    }
+
+public:
+    CFrontEnd(_Policy & cPolicy) : m_cPolicy(cPolicy) { }
+
+    // Compile() -- Parse every statement; returns false on a syntax error
+
+    bool Compile(const char * sText,std::vector<stNODE *> & vStatements)
+    {
+        m_sText     = sText;
+        m_iLine     = 1;
+        m_bError    = false;
+        vStatements.clear();
+
+        for (Next();m_eToken != tEOF && !m_bError;)
+        {
+            if (m_eToken != tVar) return false;
+            stNODE * stVar = Primary();
+            if (m_eToken != tAssign) return false;
+            Next();
+            vStatements.push_back(Node(nAssign,stVar,Expression(0)));
+            if (m_eToken != tDelimExpr) return false;
+            Next();
+        }
+        return !m_bError;
+    }
+};
+
+// HashTree() -- Structure, node types, values and variable names of a tree
+
+static unsigned long long HashTree(const stNODE * stNode)
+{
+    if (!stNode) return 1;
+    auto & stData = *stNode->stNodeData;
+    unsigned long long ullHash = (unsigned long long) stData.eNodeType*0x100000001B3ULL;
+    if (stData.eNodeType == nNum) ullHash ^= stData.suTokenData.stNumber.stNumber.LSW;
+    if (stData.eNodeType == nFloat) ullHash ^= (unsigned long long) (stData.suTokenData.stNumber.stNumber.fFloat*1000);
+    if (stData.eNodeType == nVar) for (const char * s = stData.suTokenData.stVar->spName;*s;s++) ullHash = (ullHash ^ (unsigned char) *s)*0x100000001B3ULL;
+    return (ullHash*31 + HashTree(stNode->tLeft))*37 + HashTree(stNode->tRight);
+}
+
+static std::string MakeLibrary(int iNumLines = kNumLines,int iNumVariables = kNumVariables)
+{
+    static const char * sOperators[] = { "+","-","*","/","%"," mod "," div "," and "," or ","&","^","&&","||","==","!=","<>","<","<=",">",">=" };
+    std::mt19937 cRand(2021);
+    std::string sText;
+    char sLine[256];
+
+    sText.reserve(iNumLines*64);
+    for (int i=0;i<iNumLines;i++)
+    {
+        if (i % 50 == 0)
+        {
+            snprintf(sLine,sizeof(sLine),"// Section %d\n",i/50);
+            sText += sLine;
+        }
+        snprintf(sLine,sizeof(sLine),"value_%d := ",(int) (cRand() % iNumVariables));
+        sText += sLine;
+
+        int iTerms = 3 + cRand() % 5;
+        for (int j=0;j<iTerms;j++)
+        {
+            if (j) sText += sOperators[cRand() % (sizeof(sOperators)/sizeof(sOperators[0]))];
+            switch (cRand() % 5)
+            {
+                case 0:     snprintf(sLine,sizeof(sLine),"%d",(int) (cRand() % 1000)); break;
+                case 1:     snprintf(sLine,sizeof(sLine),"%d.%02d",(int) (cRand() % 100),(int) (cRand() % 100)); break;
+                case 2:     snprintf(sLine,sizeof(sLine),"(gain_%d + -offset_%d)",(int) (cRand() % iNumVariables),(int) (cRand() % iNumVariables)); break;
+                default:    snprintf(sLine,sizeof(sLine),"value_%d",(int) (cRand() % iNumVariables)); break;
+            }
+            sText += sLine;
+        }
+        sText += ";\n";
+    }
+    return sText;
+}
+
+template <typename _Policy>
+static bool CompileOnce(_Policy & cPolicy,const std::string & sText,unsigned long long & ullHash)
+{
+    std::vector<stNODE *> vStatements;
+    CFrontEnd<_Policy> cFrontEnd(cPolicy);
+    bool bResult = cFrontEnd.Compile(sText.c_str(),vStatements);
+
+    ullHash = vStatements.size();
+    for (auto stNode : vStatements) ullHash = ullHash*0x9E3779B97F4A7C15ULL + HashTree(stNode);
+    cPolicy.Reset();
+    return bResult && (int) vStatements.size() == kNumLines;
+}
+
+template <typename _Policy>
+static double LinesPerSecond(_Policy & cPolicy,const std::string & sText)
+{
+    unsigned long long ullHash;
+    int iCompiles = 0;
+    double fSeconds = 0;
+    auto tStart = std::chrono::steady_clock::now();
+    for (;fSeconds < kMinSeconds;iCompiles++)
+    {
+        CompileOnce(cPolicy,sText,ullHash);
+        fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-tStart).count();
+    }
+    return kNumLines*(double) iCompiles/fSeconds;
+}
+
+// VmCase_t -- A hand-written formula and the number of instructions it must compile to (including the write-back of t)
+
+struct VmCase_t
+{
+    const char    * sText;
+    int             iInstructions;
+};
+
+static const VmCase_t stVmCases[] =
+{
+    { "t := 2*3 + x;",                                                                  2  },     // Folded: add, mov
+    { "t := (10 - 2*3) * (x + 0) - 4 div 2;",                                           3  },     // 4*x - 2
+    { "t := (x+y)*(x+y) + (y+x);",                                                      4  },     // One add shared by all three
+    { "t := (x-y)*(y-x);",                                                              4  },     // Two different subtractions
+    { "t := (x-y) - (y-x) + x/y - y/x;",                                                8  },
+    { "t := (x mod y)*10 + (y mod x) + (x < y)*2 + (y < x)*4 + (x <= y)*8;",            15 },     // x <= y is not (x > y)
+    { "x := x*2; t := x - y;",                                                          4  },     // t uses the new x
+    { "t := x; x := y; y := t;",                                                        5  },     // Swap: x and y are copied before the write-back
+};
+
+// Same() -- Equal, or both NaN
+
+static bool Same(double f1,double f2) { return f1 == f2 || (f1 != f1 && f2 != f2); }
+
+// BindVmVariables() -- value_, gain_ and offset_ 0..kVmVariables-1, then x, y and t; returns the names by index
+
+static std::vector<std::string> BindVmVariables(CFormulaCompiler & cCompiler)
+{
+    std::vector<std::string> vNames;
+    char sName[32];
+    for (const char * sPrefix : { "value_","gain_","offset_" })
+        for (int i=0;i<kVmVariables;i++)
+        {
+            snprintf(sName,sizeof(sName),"%s%d",sPrefix,i);
+            vNames.push_back(sName);
+        }
+    for (const char * sVar : { "x","y","t" }) vNames.push_back(sVar);
+    for (int i=0;i<(int) vNames.size();i++) cCompiler.BindVar(vNames[i].c_str(),i);
+    return vNames;
+}
+
+static int VarIndex(const std::vector<std::string> & vNames,const stVARSTRUCT * stVar)
+{
+    for (int i=0;i<(int) vNames.size();i++) if (vNames[i] == stVar->spName) return i;
+    return -1;
+}
+
+// Reference() -- Walk the tree, applying each node with CFormulaProgram::Apply() (no folding or sharing)
+
+static double Reference(const stNODE * stNode,double * pVars,const std::vector<std::string> & vNames)
+{
+    auto & stData = *stNode->stNodeData;
+    FormulaOp eOp;
+    switch (stData.eNodeType)
+    {
+        case nNum:          return (double) (int) stData.suTokenData.stNumber.stNumber.LSW;
+        case nFloat:        return (double) stData.suTokenData.stNumber.stNumber.fFloat;
+        case nVar:          return pVars[VarIndex(vNames,stData.suTokenData.stVar)];
+        case nAssign:       return pVars[VarIndex(vNames,stNode->tLeft->stNodeData->suTokenData.stVar)] = Reference(stNode->tRight,pVars,vNames);
+        case nneg:          return CFormulaProgram::Apply(FormulaOp::Neg,Reference(stNode->tLeft,pVars,vNames),0);
+        case nNot:          return CFormulaProgram::Apply(FormulaOp::Not,Reference(stNode->tLeft,pVars,vNames),0);
+        case nAdd:          eOp = FormulaOp::Add;       break;
+        case nSub:          eOp = FormulaOp::Sub;       break;
+        case nMul:          eOp = FormulaOp::Mul;       break;
+        case nDiv:          eOp = FormulaOp::IDiv;      break;
+        case nMod:          eOp = FormulaOp::Mod;       break;
+        case nAnd:          eOp = FormulaOp::And;       break;
+        case nOr:           eOp = FormulaOp::Or;        break;
+        case nxor:          eOp = FormulaOp::Xor;       break;
+        case nlogAnd:       eOp = FormulaOp::LogAnd;    break;
+        case nlogOr:        eOp = FormulaOp::LogOr;     break;
+        case nEqualto:      eOp = FormulaOp::Eq;        break;
+        case nNotEqualto:   eOp = FormulaOp::Ne;        break;
+        case nLessThan:     eOp = FormulaOp::Lt;        break;
+        case nGreaterThan:  eOp = FormulaOp::Gt;        break;
+        default:            return NAN;
+    }
+    double fLeft = Reference(stNode->tLeft,pVars,vNames);
+    return CFormulaProgram::Apply(eOp,fLeft,Reference(stNode->tRight,pVars,vNames));
+}
+
+// FillVmValues() -- iSets sets of values, variable v of set i at [v*iSets + i].  One in five is 0 (for div and mod).
+
+static std::vector<double> FillVmValues(int iNumVars,int iSets,std::mt19937 & cRand)
+{
+    std::vector<double> vValues((size_t) iNumVars*iSets);
+    for (auto & fValue : vValues) fValue = cRand() % 5 ? ((int) (cRand() % 2001) - 1000)/8.0 : 0;
+    return vValues;
+}
+
+// CheckProgram() -- Run the program with Evaluate() and EvaluateN() over kVmSets sets of values; the result and every
+// variable must match the reference run of the statements.  Returns the number of sets that differ.
+
+static int CheckProgram(const CFormulaProgram & cProgram,const stNODE * const * stStatements,int iNumStatements,
+                        const std::vector<std::string> & vNames,std::mt19937 & cRand,const char * sName)
+{
+    int iNumVars = (int) vNames.size();
+    std::vector<double> vInput = FillVmValues(iNumVars,kVmSets,cRand);
+    std::vector<double> vVector(vInput),vResult(kVmSets);
+    std::vector<FormulaVector_t> vVars(iNumVars);
+    for (int v=0;v<iNumVars;v++) vVars[v] = { vVector.data() + (size_t) v*kVmSets,1 };
+    cProgram.EvaluateN(vVars.data(),kVmSets,vResult.data());
+
+    int iMismatches = 0;
+    double fVars[CFormulaCompiler::kMaxVars],fReference[CFormulaCompiler::kMaxVars];
+    for (int i=0;i<kVmSets;i++)
+    {
+        for (int v=0;v<iNumVars;v++) fVars[v] = fReference[v] = vInput[(size_t) v*kVmSets + i];
+        double fExpected = 0;
+        for (int j=0;j<iNumStatements;j++) fExpected = Reference(stStatements[j],fReference,vNames);
+        double fValue = cProgram.Evaluate(fVars);
+
+        bool bSame = Same(fValue,fExpected) && Same(vResult[i],fExpected);
+        for (int v=0;v<iNumVars;v++) bSame = bSame && Same(fVars[v],fReference[v]) && Same(vVector[(size_t) v*kVmSets + i],fReference[v]);
+        if (!bSame && iMismatches++ < 3)
+            printf("%s: set %d gives %.17g (Evaluate) and %.17g (EvaluateN), expected %.17g\n",sName,i,fValue,vResult[i],fExpected);
+    }
+    return iMismatches;
+}
+
+// TimeVm() -- Best of kVmTimeRuns for kVmTimeSets sets, one at a time with Evaluate() (gathering the variables and
+// scattering the assigned ones, as EvaluateN() does) and with EvaluateN()
+
+static void TimeVm(const CFormulaProgram & cProgram,int iNumVars,std::mt19937 & cRand,double & fEvaluateMs,double & fEvaluateNMs)
+{
+    std::vector<double> vInput = FillVmValues(iNumVars,kVmTimeSets,cRand);
+    std::vector<double> vData,vResult(kVmTimeSets);
+    std::vector<FormulaVector_t> vVars(iNumVars);
+    double fVars[CFormulaCompiler::kMaxVars];
+
+    fEvaluateMs = fEvaluateNMs = 1e30;
+    for (int iRun=0;iRun<kVmTimeRuns;iRun++)
+    {
+        vData = vInput;
+        auto tStart = std::chrono::steady_clock::now();
+        for (int i=0;i<kVmTimeSets;i++)
+        {
+            for (int v=0;v<iNumVars;v++) fVars[v] = vData[(size_t) v*kVmTimeSets + i];
+            vResult[i] = cProgram.Evaluate(fVars);
+            for (int v=0;v<iNumVars;v++) if (cProgram.isAssigned(v)) vData[(size_t) v*kVmTimeSets + i] = fVars[v];
+        }
+        fEvaluateMs = std::min(fEvaluateMs,ElapsedMs(tStart));
+
+        vData = vInput;
+        for (int v=0;v<iNumVars;v++) vVars[v] = { vData.data() + (size_t) v*kVmTimeSets,1 };
+        tStart = std::chrono::steady_clock::now();
+        cProgram.EvaluateN(vVars.data(),kVmTimeSets,vResult.data());
+        fEvaluateNMs = std::min(fEvaluateNMs,ElapsedMs(tStart));
+    }
+}
+
+int main()
+{
+    std::string sText = MakeLibrary();
+
+    auto & cKeywords    = CTokenLookup::GetAlphaTable();
+    auto & cOperators   = CTokenLookup::GetOperatorTable();
+    printf("Library: %d lines, %.1f KB, %d variables\n",kNumLines,sText.size()/1024.0,kNumVariables*3);
+    printf("Keyword table: %d entries in %d slots; operator table: %d entries in %d slots\n\n",cKeywords.GetNumEntries(),
+            cKeywords.GetTableSize(),cOperators.GetNumEntries(),cOperators.GetTableSize());
+
+    // Correctness
+
+    int iErrors = 0;
+    CLinearPolicy cLinear;
+    CArenaPolicy cArena;
+    unsigned long long ullLinear = 0,ullArena = 0;
+
+    if (!cKeywords.isValid() || !cOperators.isValid())
+    {
+        printf("Could not build the perfect-hash tables (%s%s)\n",cKeywords.GetErrorMessage(),cOperators.GetErrorMessage());
+        iErrors++;
+    }
+
+    // Case-sensitive tokens that differ only in case cannot share the case-folded table; the error must name both
+
+    static const stTOKENOPERATORLOOKUP stCaseTable[] = { { (char *) "*Sin",tFunctionDecl },{ (char *) "!cos",tVarDecl },{ (char *) "*SIN",tOverload } };
+    CTokenLookup cCaseTable(stCaseTable,3,true);
+    if (cCaseTable.isValid() || !strstr(cCaseTable.GetErrorMessage(),"'Sin'") || !strstr(cCaseTable.GetErrorMessage(),"'SIN'"))
+    {
+        printf("Tokens differing only in case: table is %s, error \"%s\"\n",cCaseTable.isValid() ? "valid" : "invalid",cCaseTable.GetErrorMessage());
+        iErrors++;
+    }
+    if (!CompileOnce(cLinear,sText,ullLinear) || !CompileOnce(cArena,sText,ullArena)) { printf("Compile failed\n"); iErrors++; }
+    if (ullLinear != ullArena) { printf("Trees differ (%llx vs. %llx)\n",ullLinear,ullArena); iErrors++; }
+
+    for (int i=0;stTokenAlphaLookup[i].sToken;i++)
+    {
+        const char * sKeyword = stTokenAlphaLookup[i].sToken+1;
+        int iLength = (int) strlen(sKeyword);
+        if (cKeywords.Find(sKeyword,iLength) != cLinear.FindKeyword(sKeyword,iLength))
+            if (iErrors++ < 10) printf("Keyword mismatch: %s\n",sKeyword);
+    }
+    for (auto & stOp : stTokenOperatorLookup)
+    {
+        int iLength1,iLength2;
+        if (cOperators.Match(stOp.sToken,iLength1) != cLinear.MatchOperator(stOp.sToken,iLength2) || iLength1 != iLength2)
+            if (iErrors++ < 10) printf("Operator mismatch: %s\n",stOp.sToken);
+    }
+
+    // Throughput
+
+    double fLinear  = LinesPerSecond(cLinear,sText);
+    double fArena   = LinesPerSecond(cArena,sText);
+
+    printf("%-30s %16s\n","Front end","Lines/sec");
+    printf("%-30s %16.0f\n","Linear (new, strcmp scans)",fLinear);
+    printf("%-30s %16.0f  (%.1fx)\n\n","Arena (CTokenArena)",fArena,fArena/fLinear);
+
+    // Cases
+
+    CArenaPolicy cVmPolicy;
+    CFrontEnd<CArenaPolicy> cVmFrontEnd(cVmPolicy);
+    CFormulaCompiler cCompiler;
+    CFormulaProgram cProgram;
+    std::vector<std::string> vNames = BindVmVariables(cCompiler);
+    std::vector<stNODE *> vStatements;
+    std::mt19937 cVmRand(42);
+    int iVmErrors = 0;
+
+    for (auto & stCase : stVmCases)
+    {
+        if (!cVmFrontEnd.Compile(stCase.sText,vStatements) || !cCompiler.Compile(vStatements.data(),(int) vStatements.size(),cProgram))
+        {
+            printf("%s: does not compile (%s)\n",stCase.sText,cCompiler.GetErrorMessage());
+            iVmErrors++;
+        }
+        else
+        {
+            if (cProgram.GetNumInstructions() != stCase.iInstructions)
+            {
+                printf("%s: %d instructions, expected %d\n%s",stCase.sText,cProgram.GetNumInstructions(),stCase.iInstructions,cProgram.GetListing().c_str());
+                iVmErrors++;
+            }
+            iVmErrors += CheckProgram(cProgram,vStatements.data(),(int) vStatements.size(),vNames,cVmRand,stCase.sText);
+        }
+        cVmPolicy.Reset();
+    }
+    printf("Cases       %d formulas (folding, CSE, non-commutative operators): %s\n",(int) (sizeof(stVmCases)/sizeof(stVmCases[0])),
+           iVmErrors ? "errors" : "ok");
+    iErrors += iVmErrors;
+
+    // Statements
+
+    std::string sVmText = MakeLibrary(kVmLines,kVmVariables);
+    int iInstructions = 0;
+    iVmErrors = 0;
+
+    if (!cVmFrontEnd.Compile(sVmText.c_str(),vStatements) || (int) vStatements.size() != kVmLines) { printf("VM library does not parse\n"); iVmErrors++; }
+    else
+    {
+        char sName[32];
+        for (int i=0;i<kVmLines;i++)
+        {
+            snprintf(sName,sizeof(sName),"Line %d",vStatements[i]->stNodeData->iLineNumber);
+            if (!cCompiler.Compile(vStatements[i],cProgram)) { printf("%s: %s\n",sName,cCompiler.GetErrorMessage()); iVmErrors++; continue; }
+            iInstructions += cProgram.GetNumInstructions();
+            iVmErrors += CheckProgram(cProgram,&vStatements[i],1,vNames,cVmRand,sName);
+        }
+
+        if (!cCompiler.Compile(vStatements.data(),kVmBlock,cProgram)) { printf("Block: %s\n",cCompiler.GetErrorMessage()); iVmErrors++; }
+        else iVmErrors += CheckProgram(cProgram,vStatements.data(),kVmBlock,vNames,cVmRand,"Block");
+    }
+    printf("Statements  %d compiled alone (%d instructions), %d as one program (%d instructions): %s\n",kVmLines,iInstructions,kVmBlock,
+           cProgram.GetNumInstructions(),iVmErrors ? "errors" : "ok");
+    iErrors += iVmErrors;
+
+    // VM
+
+    if (cProgram.isValid())
+    {
+        double fEvaluateMs,fEvaluateNMs;
+        TimeVm(cProgram,(int) vNames.size(),cVmRand,fEvaluateMs,fEvaluateNMs);
+        printf("VM          %d sets: Evaluate() %.2f ms (%.1f ns per set), EvaluateN() %.2f ms (%.1f ns per set, %.1fx)\n",kVmTimeSets,
+               fEvaluateMs,fEvaluateMs*1e6/kVmTimeSets,fEvaluateNMs,fEvaluateNMs*1e6/kVmTimeSets,fEvaluateMs/fEvaluateNMs);
+    }
+    cVmPolicy.Reset();
+
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// LargeBitmapBench -- CLargeBitmap round trip through the tile file, moves, and streaming throughput
+//
+//      RoundTrip   -- A 300x200 image with 64x64 tiles (partial tiles on the right and bottom edges) is written in one
+//                     WriteRegion() and read back in one ReadRegion().  A 100x100 region across 4 tiles is then overwritten
+//                     and read back, and the pixels around it must be unchanged.
+//      LockTile    -- Pixels of a locked edge tile match the image, and changes made through the tile are read back.
+//      Move        -- Move construction and move assignment take over the file (the source is left empty, the contents
+//                     stay), including a tile locked before the move and unlocked through the new object.
+//      Throughput  -- 4096x4096 written and read back in 256-row strips.
+//
+// Only the tile file is exercised, so the header is included with SAGE_NO_SAGETOOLS (no GaussianBlurStd()).
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+#define SAGE_NO_SAGETOOLS
+#include "CLargeBitmap.h"
+
+using namespace Sage;
+
+static constexpr int kWidth         = 300;
+static constexpr int kHeight        = 200;
+static constexpr int kTileSize      = 64;
+static constexpr int kStreamSize    = 4096;
+static constexpr int kStreamRows    = 256;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+// Bitmap_t -- A RawBitmap_t over a std::vector, with the same row layout as Sage::CreateBitmap()
+
+struct Bitmap_t
+{
+    std::vector<unsigned char> vMem;
+    RawBitmap_t stBitmap = {};
+
+    Bitmap_t(int iWidth,int iHeight)
+    {
+        int iWidthBytes = (iWidth*3 + 3) & ~3;
+        vMem.assign((size_t) iWidthBytes*iHeight,0);
+        stBitmap.iWidth         = iWidth;
+        stBitmap.iHeight        = iHeight;
+        stBitmap.iWidthBytes    = iWidthBytes;
+        stBitmap.iOverHang      = iWidthBytes - iWidth*3;
+        stBitmap.iTotalSize     = iWidthBytes*iHeight;
+        stBitmap.stMem          = vMem.data();
+        stBitmap.stRGB          = (RGBColor24 *) vMem.data();
+    }
+    unsigned char * Pixel(int iX,int iY) { return stBitmap.stMem + (size_t) iY*stBitmap.iWidthBytes + iX*3; }
+};
+
+static unsigned char Pattern(int iX,int iY,int iChannel,int iSeed) { return (unsigned char) (iX*7 + iY*13 + iChannel*101 + iSeed); }
+
+static void FillPattern(Bitmap_t & stBitmap,int iSeed)
+{
+    for (int y=0;y<stBitmap.stBitmap.iHeight;y++)
+        for (int x=0;x<stBitmap.stBitmap.iWidth;x++)
+            for (int c=0;c<3;c++) stBitmap.Pixel(x,y)[c] = Pattern(x,y,c,iSeed);
+}
+
+// CheckImage() -- Read the whole image back and compare each pixel with the pattern (iSeed2 inside the rectangle, iSeed outside)
+
+static bool CheckImage(CLargeBitmap & cBitmap,int iSeed,RECT rInner = { 0,0,0,0 },int iSeed2 = 0)
+{
+    Bitmap_t stRead((int) cBitmap.GetWidth(),(int) cBitmap.GetHeight());
+    if (!cBitmap.ReadRegion(0,0,stRead.stBitmap)) { printf("ReadRegion() failed\n"); return false; }
+
+    for (int y=0;y<stRead.stBitmap.iHeight;y++)
+        for (int x=0;x<stRead.stBitmap.iWidth;x++)
+        {
+            bool bInner = x >= rInner.left && x < rInner.right && y >= rInner.top && y < rInner.bottom;
+            for (int c=0;c<3;c++)
+            {
+                unsigned char ucExpected = bInner ? Pattern(x - rInner.left,y - rInner.top,c,iSeed2) : Pattern(x,y,c,iSeed);
+                if (stRead.Pixel(x,y)[c] != ucExpected)
+                {
+                    printf("Pixel (%d,%d) channel %d is %d, expected %d\n",x,y,c,stRead.Pixel(x,y)[c],ucExpected);
+                    return false;
+                }
+            }
+        }
+    return true;
+}
+
+int main()
+{
+    int iErrors = 0;
+
+    // RoundTrip
+
+    CLargeBitmap cBitmap;
+    if (!cBitmap.Create(kWidth,kHeight,kTileSize))
+    {
+        printf("Create() failed\n\nFAILED (1 errors)\n");
+        return 1;
+    }
+    if (cBitmap.GetTilesX() != 5 || cBitmap.GetTilesY() != 4) { printf("Tiles are %dx%d, expected 5x4\n",cBitmap.GetTilesX(),cBitmap.GetTilesY()); iErrors++; }
+
+    Bitmap_t stSource(kWidth,kHeight);
+    FillPattern(stSource,0);
+    if (!cBitmap.WriteRegion(0,0,stSource.stBitmap)) { printf("WriteRegion() failed\n"); iErrors++; }
+    if (!CheckImage(cBitmap,0)) iErrors++;
+
+    Bitmap_t stRegion(100,100);
+    FillPattern(stRegion,77);
+    RECT rRegion = { 50,50,150,150 };
+    if (!cBitmap.WriteRegion(rRegion.left,rRegion.top,stRegion.stBitmap)) { printf("WriteRegion() across tiles failed\n"); iErrors++; }
+    if (!CheckImage(cBitmap,0,rRegion,77)) iErrors++;
+
+    printf("RoundTrip   %dx%d, %dx%d tiles of %d: %s\n",kWidth,kHeight,cBitmap.GetTilesX(),cBitmap.GetTilesY(),kTileSize,iErrors ? "mismatch" : "ok");
+
+    // LockTile -- bottom-right tile (44x8)
+
+    auto stTile = cBitmap.LockTile(4,3);
+    if (!stTile.isValid() || stTile.stBitmap.iWidth != kWidth - 4*kTileSize || stTile.stBitmap.iHeight != kHeight - 3*kTileSize)
+    {
+        printf("LockTile(4,3) failed or has the wrong size\n");
+        iErrors++;
+    }
+    else
+    {
+        int iWrong = 0;
+        for (int y=0;y<stTile.stBitmap.iHeight;y++)
+            for (int x=0;x<stTile.stBitmap.iWidth;x++)
+            {
+                unsigned char * sPixel = stTile.stBitmap.stMem + y*stTile.stBitmap.iWidthBytes + x*3;
+                if (sPixel[0] != Pattern(4*kTileSize + x,3*kTileSize + y,0,0)) iWrong++;
+                sPixel[0] = sPixel[1] = sPixel[2] = 0xEE;
+            }
+        cBitmap.UnlockTile(stTile);
+        if (iWrong) { printf("%d pixels of the locked tile are wrong\n",iWrong); iErrors++; }
+
+        Bitmap_t stCorner(1,1);
+        cBitmap.ReadRegion(kWidth-1,kHeight-1,stCorner.stBitmap);
+        if (stCorner.Pixel(0,0)[1] != 0xEE) { printf("Change through LockTile() was not kept\n"); iErrors++; }
+
+        // Put the tile back for the move checks
+
+        cBitmap.WriteRegion(4*kTileSize,3*kTileSize,stSource.stBitmap,{ 4*kTileSize,3*kTileSize });
+    }
+    if (cBitmap.GetLockedTiles()) { printf("%d tiles still locked\n",cBitmap.GetLockedTiles()); iErrors++; }
+
+    // Move -- construct, then assign over a bitmap that already has a file
+
+    auto stLocked = cBitmap.LockTile(1,1);
+
+    CLargeBitmap cMoved(std::move(cBitmap));
+    if (cBitmap.isValid() || cBitmap.GetWidth()) { printf("Moved-from bitmap is not empty\n"); iErrors++; }
+    if (cMoved.GetWidth() != kWidth || cMoved.GetHeight() != kHeight || cMoved.GetLockedTiles() != 1) { printf("Move constructor lost the geometry\n"); iErrors++; }
+    if (!CheckImage(cMoved,0,rRegion,77)) iErrors++;
+
+    CLargeBitmap cAssigned(kTileSize,kTileSize,kTileSize);
+    cAssigned = std::move(cMoved);
+    if (cMoved.isValid()) { printf("Move-assigned-from bitmap is not empty\n"); iErrors++; }
+    if (cAssigned.GetTilesX() != 5 || cAssigned.GetLockedTiles() != 1) { printf("Move assignment lost the geometry\n"); iErrors++; }
+    if (!CheckImage(cAssigned,0,rRegion,77)) iErrors++;
+
+    cAssigned.UnlockTile(stLocked);
+    if (cAssigned.GetLockedTiles()) { printf("Tile locked before the move was not unlocked\n"); iErrors++; }
+
+    cAssigned = std::move(cAssigned);
+    if (!cAssigned.isValid()) { printf("Self move-assignment emptied the bitmap\n"); iErrors++; }
+
+    printf("Move        constructor and assignment: %s\n",iErrors ? "errors" : "ok");
+
+    // Throughput
+
+    CLargeBitmap cStream(kStreamSize,kStreamSize);
+    Bitmap_t stStrip(kStreamSize,kStreamRows);
+    FillPattern(stStrip,5);
+
+    auto tStart = std::chrono::steady_clock::now();
+    for (int y=0;y<kStreamSize;y += kStreamRows) cStream.WriteRegion(0,y,stStrip.stBitmap);
+    double fWriteMs = ElapsedMs(tStart);
+
+    tStart = std::chrono::steady_clock::now();
+    bool bSame = true;
+    for (int y=0;y<kStreamSize;y += kStreamRows)
+    {
+        memset(stStrip.vMem.data(),0,stStrip.vMem.size());
+        cStream.ReadRegion(0,y,stStrip.stBitmap);
+        bSame &= stStrip.Pixel(kStreamSize-1,kStreamRows-1)[2] == Pattern(kStreamSize-1,kStreamRows-1,2,5);
+    }
+    double fReadMs = ElapsedMs(tStart);
+    if (!bSame) { printf("Streamed strips did not read back\n"); iErrors++; }
+
+    double fMB = (double) kStreamSize*kStreamSize*3/(1024.0*1024.0);
+    printf("Throughput  %dx%d: write %.1f ms (%.0f MB/s), read %.1f ms (%.0f MB/s)\n",kStreamSize,kStreamSize,
+           fWriteMs,fMB*1000.0/fWriteMs,fReadMs,fMB*1000.0/fReadMs);
+
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
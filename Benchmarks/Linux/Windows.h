@@ -0,0 +1,387 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// Windows.h (Linux) -- The small part of the Win32 API that the portable Sagebox headers use, so the benchmarks build on
+// Linux (see Benchmarks/CMakeLists.txt, which puts this directory on the include path for non-Windows builds only).
+//
+// This is not an emulation of Windows: it has the basic types and macros (DWORD, RECT, RGB(), __forceinline, etc.), the
+// aligned and virtual allocation calls used by CMemClass.h, and read-only/read-write file mapping used by the profile
+// and PGR readers, implemented with POSIX calls.  Headers that create windows or draw are not meant to build with it.
+//
+#if !defined(_SageLinuxWindows_H_)
+#define _SageLinuxWindows_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <ctime>
+#include <type_traits>
+#include <fcntl.h>
+#include <pthread.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define __forceinline   inline __attribute__((always_inline))
+#define __stdcall
+#define __cdecl
+#define CALLBACK
+#define WINAPI
+#define _In_
+#define _In_opt_
+#define _Out_
+
+typedef unsigned long       DWORD;
+typedef int                 BOOL;
+typedef unsigned char       BYTE;
+typedef unsigned short      WORD;
+typedef long                LONG;
+typedef unsigned long       ULONG;
+typedef unsigned int        UINT;
+typedef long long           LONGLONG;
+typedef unsigned long long  ULONGLONG;
+typedef unsigned long long  DWORD64;
+typedef int64_t             LONG64;
+typedef long long           __int64;
+typedef intptr_t            INT_PTR;
+typedef uintptr_t           UINT_PTR;
+typedef intptr_t            LONG_PTR;
+typedef uintptr_t           ULONG_PTR;
+typedef size_t              SIZE_T;
+typedef uintptr_t           WPARAM;
+typedef intptr_t            LPARAM;
+typedef intptr_t            LRESULT;
+typedef DWORD               COLORREF;
+typedef wchar_t             WCHAR;
+typedef char *              LPSTR;
+typedef const char *        LPCSTR;
+typedef wchar_t *           LPWSTR;
+typedef const wchar_t *     LPCWSTR;
+typedef void *              LPVOID;
+
+typedef void * HANDLE;
+typedef void * HWND;
+typedef void * HDC;
+typedef void * HINSTANCE;
+typedef void * HMODULE;
+typedef void * HBITMAP;
+typedef void * HFONT;
+typedef void * HBRUSH;
+typedef void * HPEN;
+typedef void * HICON;
+typedef void * HMENU;
+typedef void * HCURSOR;
+typedef void * HGDIOBJ;
+typedef void * HRGN;
+typedef void * HKEY;
+
+struct POINT { LONG x, y; };
+struct SIZE  { LONG cx, cy; };
+struct RECT  { LONG left, top, right, bottom; };
+typedef POINT * LPPOINT;
+typedef SIZE  * LPSIZE;
+typedef RECT  * LPRECT;
+
+typedef struct tagMSG { HWND hwnd; UINT message; WPARAM wParam; LPARAM lParam; DWORD time; POINT pt; } MSG;
+typedef struct { HWND hwndFrom; UINT_PTR idFrom; UINT code; } NMHDR;
+
+// Declared (for signatures in the headers) but not usable on Linux
+
+struct BITMAPINFOHEADER { DWORD biSize; LONG biWidth; LONG biHeight; WORD biPlanes; WORD biBitCount; DWORD biCompression; };
+struct BITMAPINFO { BITMAPINFOHEADER bmiHeader; };
+struct LOGFONT { LONG lfHeight; };
+struct PAINTSTRUCT { HDC hdc; BOOL fErase; RECT rcPaint; };
+struct TEXTMETRICA { LONG tmHeight; LONG tmAscent; LONG tmDescent; LONG tmAveCharWidth; };
+typedef TEXTMETRICA TEXTMETRIC;
+struct CRITICAL_SECTION { pthread_mutex_t stMutex; };
+
+typedef union
+{
+    struct { DWORD LowPart; LONG HighPart; };
+    long long QuadPart;
+} LARGE_INTEGER;
+
+typedef struct { DWORD dwPageSize; DWORD dwAllocationGranularity; DWORD dwNumberOfProcessors; } SYSTEM_INFO;
+typedef struct { DWORD nLength; void * lpSecurityDescriptor; BOOL bInheritHandle; } SECURITY_ATTRIBUTES;
+
+#define TRUE    1
+#define FALSE   0
+#define MAX_PATH 260
+#define MAXINT  INT_MAX
+#define INFINITE 0xFFFFFFFF
+#define WM_USER 0x0400
+#define MB_OK   0
+
+#define RGB(r,g,b)          ((COLORREF) (((BYTE) (r) | ((WORD) ((BYTE) (g)) << 8)) | (((DWORD) (BYTE) (b)) << 16)))
+#define GetRValue(rgb)      ((BYTE) (rgb))
+#define GetGValue(rgb)      ((BYTE) (((WORD) (rgb)) >> 8))
+#define GetBValue(rgb)      ((BYTE) ((rgb) >> 16))
+#define LOWORD(l)           ((WORD) (((uintptr_t) (l)) & 0xffff))
+#define HIWORD(l)           ((WORD) ((((uintptr_t) (l)) >> 16) & 0xffff))
+
+// min(), max() -- Functions rather than the Windows macros, which the C++ library headers on Linux cannot take.  As with
+// the macros, the arguments can be of different types.
+
+#if !defined(NOMINMAX)
+template <class _A,class _B>
+constexpr typename std::common_type<_A,_B>::type min(_A a,_B b) { return b < a ? b : a; }
+
+template <class _A,class _B>
+constexpr typename std::common_type<_A,_B>::type max(_A a,_B b) { return a < b ? b : a; }
+#endif
+
+// Memory
+
+#define MEM_COMMIT          0x00001000
+#define MEM_RESERVE         0x00002000
+#define MEM_RELEASE         0x00008000
+#define MEM_LARGE_PAGES     0x20000000
+#define PAGE_READONLY       0x02
+#define PAGE_READWRITE      0x04
+#define PAGE_WRITECOPY      0x08
+
+inline void * _aligned_malloc(size_t szBytes,size_t szAlign)
+{
+    void * pMem = nullptr;
+    return posix_memalign(&pMem,szAlign < sizeof(void *) ? sizeof(void *) : szAlign,szBytes ? szBytes : 1) ? nullptr : pMem;
+}
+
+inline void _aligned_free(void * pMem) { free(pMem); }
+
+inline void GetSystemInfo(SYSTEM_INFO * stInfo)
+{
+    long lPage = sysconf(_SC_PAGESIZE);
+    long lProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+    stInfo->dwPageSize              = (DWORD) (lPage > 0 ? lPage : 4096);
+    stInfo->dwAllocationGranularity = 65536;
+    stInfo->dwNumberOfProcessors    = (DWORD) (lProcessors > 0 ? lProcessors : 1);
+}
+
+inline SIZE_T GetLargePageMinimum() { return 2*1024*1024; }
+
+// VirtualAlloc() -- Page-aligned memory.  The size is kept in a page in front of the block so VirtualFree() can unmap it.
+// Large pages are not used (MEM_LARGE_PAGES fails, as it does on Windows without the privilege).
+
+inline void * VirtualAlloc(void *,SIZE_T szBytes,DWORD dwType,DWORD)
+{
+    if (dwType & MEM_LARGE_PAGES) return nullptr;
+    size_t szPage = (size_t) sysconf(_SC_PAGESIZE);
+    auto pBase = (unsigned char *) mmap(nullptr,szBytes + szPage,PROT_READ | PROT_WRITE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+    if (pBase == (unsigned char *) MAP_FAILED) return nullptr;
+    *(size_t *) pBase = szBytes + szPage;
+    return pBase + szPage;
+}
+
+inline BOOL VirtualFree(void * pMem,SIZE_T,DWORD)
+{
+    if (!pMem) return FALSE;
+    auto pBase = (unsigned char *) pMem - sysconf(_SC_PAGESIZE);
+    return munmap(pBase,*(size_t *) pBase) == 0;
+}
+
+// Token privileges -- OpenProcessToken() fails, so SeLockMemoryPrivilege is never enabled (large pages stay off, as above)
+
+struct LUID                 { DWORD LowPart; LONG HighPart; };
+struct LUID_AND_ATTRIBUTES  { LUID Luid; DWORD Attributes; };
+struct TOKEN_PRIVILEGES     { DWORD PrivilegeCount; LUID_AND_ATTRIBUTES Privileges[1]; };
+
+#define TOKEN_QUERY                 0x0008
+#define TOKEN_ADJUST_PRIVILEGES     0x0020
+#define SE_PRIVILEGE_ENABLED        0x00000002
+#define ERROR_SUCCESS               0
+#define ERROR_NOT_ALL_ASSIGNED      1300
+
+inline HANDLE GetCurrentProcess() { return (HANDLE) (intptr_t) -1; }
+inline DWORD GetLastError() { return ERROR_SUCCESS; }
+inline BOOL OpenProcessToken(HANDLE,DWORD,HANDLE * hToken) { *hToken = nullptr; return FALSE; }
+inline BOOL LookupPrivilegeValueA(const char *,const char *,LUID *) { return FALSE; }
+inline BOOL AdjustTokenPrivileges(HANDLE,BOOL,TOKEN_PRIVILEGES *,DWORD,TOKEN_PRIVILEGES *,DWORD *) { return FALSE; }
+
+// Files and file mapping -- a HANDLE is a LinuxFile_t (the mapping handle is the file handle)
+
+#define GENERIC_READ                0x80000000
+#define GENERIC_WRITE               0x40000000
+#define FILE_SHARE_READ             0x00000001
+#define FILE_SHARE_WRITE            0x00000002
+#define CREATE_NEW                  1
+#define CREATE_ALWAYS               2
+#define OPEN_EXISTING               3
+#define OPEN_ALWAYS                 4
+#define FILE_ATTRIBUTE_NORMAL       0x00000080
+#define FILE_ATTRIBUTE_TEMPORARY    0x00000100
+#define FILE_FLAG_DELETE_ON_CLOSE   0x04000000
+#define FILE_FLAG_SEQUENTIAL_SCAN   0x08000000
+#define FILE_MAP_COPY               0x0001
+#define FILE_MAP_WRITE              0x0002
+#define FILE_MAP_READ               0x0004
+#define FILE_MAP_ALL_ACCESS         0x000F001F
+#define INVALID_HANDLE_VALUE        ((HANDLE) (intptr_t) -1)
+
+struct LinuxFile_t
+{
+    int         iFile;
+    bool        bWrite;
+    long long   llMapSize;          // CreateFileMappingA() size (0 = the file size)
+};
+
+inline HANDLE CreateFileA(const char * sPath,DWORD dwAccess,DWORD,void *,DWORD dwCreation,DWORD dwFlags,HANDLE)
+{
+    bool bWrite = (dwAccess & GENERIC_WRITE) != 0;
+    int iFlags = bWrite ? ((dwAccess & GENERIC_READ) ? O_RDWR : O_WRONLY) : O_RDONLY;
+    if (dwCreation == CREATE_ALWAYS)    iFlags |= O_CREAT | O_TRUNC;
+    if (dwCreation == CREATE_NEW)       iFlags |= O_CREAT | O_EXCL;
+    if (dwCreation == OPEN_ALWAYS)      iFlags |= O_CREAT;
+
+    int iFile = sPath ? open(sPath,iFlags,0644) : -1;
+    if (iFile < 0) return INVALID_HANDLE_VALUE;
+    if (dwFlags & FILE_FLAG_DELETE_ON_CLOSE) unlink(sPath);
+    return (HANDLE) new LinuxFile_t{ iFile,bWrite,0 };
+}
+
+inline BOOL CloseHandle(HANDLE hHandle)
+{
+    if (!hHandle || hHandle == INVALID_HANDLE_VALUE) return FALSE;
+    auto stFile = (LinuxFile_t *) hHandle;
+    bool bSuccess = close(stFile->iFile) == 0;
+    delete stFile;
+    return bSuccess;
+}
+
+inline BOOL GetFileSizeEx(HANDLE hFile,LARGE_INTEGER * stSize)
+{
+    struct stat stStat;
+    if (!hFile || hFile == INVALID_HANDLE_VALUE || fstat(((LinuxFile_t *) hFile)->iFile,&stStat)) return FALSE;
+    stSize->QuadPart = (long long) stStat.st_size;
+    return TRUE;
+}
+
+inline BOOL ReadFile(HANDLE hFile,void * pBuffer,DWORD dwBytes,DWORD * dwRead,void *)
+{
+    ssize_t szRead = read(((LinuxFile_t *) hFile)->iFile,pBuffer,dwBytes);
+    if (dwRead) *dwRead = szRead > 0 ? (DWORD) szRead : 0;
+    return szRead >= 0;
+}
+
+inline BOOL WriteFile(HANDLE hFile,const void * pBuffer,DWORD dwBytes,DWORD * dwWritten,void *)
+{
+    ssize_t szWritten = write(((LinuxFile_t *) hFile)->iFile,pBuffer,dwBytes);
+    if (dwWritten) *dwWritten = szWritten > 0 ? (DWORD) szWritten : 0;
+    return szWritten == (ssize_t) dwBytes;
+}
+
+// CreateFileMappingA() -- Grows the file to the requested size (as Windows does) and returns a second handle to it
+
+inline HANDLE CreateFileMappingA(HANDLE hFile,void *,DWORD dwProtect,DWORD dwSizeHigh,DWORD dwSizeLow,const char *)
+{
+    if (!hFile || hFile == INVALID_HANDLE_VALUE) return nullptr;
+    auto stFile = (LinuxFile_t *) hFile;
+    long long llSize = ((long long) dwSizeHigh << 32) | dwSizeLow;
+
+    struct stat stStat;
+    if (fstat(stFile->iFile,&stStat)) return nullptr;
+    if (llSize > (long long) stStat.st_size)
+    {
+        if (dwProtect != PAGE_READWRITE || ftruncate(stFile->iFile,(off_t) llSize)) return nullptr;
+    }
+    if (!llSize) llSize = (long long) stStat.st_size;
+    if (!llSize) return nullptr;                                // Windows cannot map an empty file either
+
+    int iFile = dup(stFile->iFile);
+    return iFile < 0 ? nullptr : (HANDLE) new LinuxFile_t{ iFile,dwProtect == PAGE_READWRITE,llSize };
+}
+
+// MapViewOfFile() -- The offset must be a multiple of the page size (Windows requires 64K).  A size of 0 maps to the end.
+
+inline void * MapViewOfFile(HANDLE hMapping,DWORD dwAccess,DWORD dwOffsetHigh,DWORD dwOffsetLow,SIZE_T szBytes)
+{
+    if (!hMapping) return nullptr;
+    auto stMapping = (LinuxFile_t *) hMapping;
+    long long llOffset = ((long long) dwOffsetHigh << 32) | dwOffsetLow;
+    if (!szBytes) szBytes = (SIZE_T) (stMapping->llMapSize - llOffset);
+
+    int iProtect = PROT_READ | ((dwAccess & (FILE_MAP_WRITE | FILE_MAP_COPY)) ? PROT_WRITE : 0);
+    int iShare = dwAccess == FILE_MAP_COPY ? MAP_PRIVATE : MAP_SHARED;        // FILE_MAP_ALL_ACCESS has the FILE_MAP_COPY bit too
+
+    // munmap() needs the size, which UnmapViewOfFile() does not pass: map one page more in front and keep it there
+
+    size_t szPage = (size_t) sysconf(_SC_PAGESIZE);
+    auto pReserve = (unsigned char *) mmap(nullptr,szBytes + szPage,PROT_NONE,MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+    if (pReserve == (unsigned char *) MAP_FAILED) return nullptr;
+    void * pView = mmap(pReserve + szPage,szBytes,iProtect,iShare | MAP_FIXED,stMapping->iFile,(off_t) llOffset);
+    if (pView == MAP_FAILED || mprotect(pReserve,szPage,PROT_READ | PROT_WRITE)) { munmap(pReserve,szBytes + szPage); return nullptr; }
+    *(size_t *) pReserve = szBytes + szPage;
+    return pView;
+}
+
+inline BOOL UnmapViewOfFile(const void * pView)
+{
+    if (!pView) return FALSE;
+    auto pReserve = (unsigned char *) pView - sysconf(_SC_PAGESIZE);
+    return munmap(pReserve,*(size_t *) pReserve) == 0;
+}
+
+inline BOOL FlushViewOfFile(const void * pView,SIZE_T szBytes)
+{
+    size_t szPage = (size_t) sysconf(_SC_PAGESIZE);
+    auto pStart = (unsigned char *) ((uintptr_t) pView & ~(uintptr_t) (szPage-1));
+    return msync(pStart,szBytes + ((const unsigned char *) pView - pStart),MS_SYNC) == 0;
+}
+
+inline DWORD GetTempPathA(DWORD dwLength,char * sPath)
+{
+    const char * sTemp = getenv("TMPDIR");
+    if (!sTemp || !*sTemp) sTemp = "/tmp";
+    size_t szLength = strlen(sTemp);
+    if (szLength + 2 > dwLength) return (DWORD) (szLength + 2);
+    memcpy(sPath,sTemp,szLength);
+    if (sPath[szLength-1] != '/') sPath[szLength++] = '/';
+    sPath[szLength] = 0;
+    return (DWORD) szLength;
+}
+
+inline UINT GetTempFileNameA(const char * sPath,const char * sPrefix,UINT,char * sFile)
+{
+    int iLength = snprintf(sFile,MAX_PATH,"%s%.3sXXXXXX",sPath,sPrefix ? sPrefix : "");
+    if (iLength < 0 || iLength >= MAX_PATH) return 0;               // mkstemp() needs the XXXXXX intact
+    int iFile = mkstemp(sFile);
+    if (iFile < 0) return 0;
+    close(iFile);
+    return 1;
+}
+
+// C runtime names
+
+inline int _stricmp(const char * s1,const char * s2)                { return strcasecmp(s1,s2); }
+inline int _strnicmp(const char * s1,const char * s2,size_t szCount) { return strncasecmp(s1,s2,szCount); }
+
+// Threads and time
+
+inline DWORD GetCurrentThreadId() { return (DWORD) (uintptr_t) pthread_self(); }
+inline void Sleep(DWORD dwMs) { usleep((useconds_t) dwMs*1000); }
+
+inline DWORD GetTickCount()
+{
+    timespec stTime;
+    clock_gettime(CLOCK_MONOTONIC,&stTime);
+    return (DWORD) (stTime.tv_sec*1000 + stTime.tv_nsec/1000000);
+}
+
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER * stFrequency) { stFrequency->QuadPart = 1000000000LL; return TRUE; }
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER * stCounter)
+{
+    timespec stTime;
+    clock_gettime(CLOCK_MONOTONIC,&stTime);
+    stCounter->QuadPart = stTime.tv_sec*1000000000LL + stTime.tv_nsec;
+    return TRUE;
+}
+
+inline LONG InterlockedIncrement(volatile LONG * lValue)                        { return __sync_add_and_fetch(lValue,1); }
+inline LONG InterlockedDecrement(volatile LONG * lValue)                        { return __sync_sub_and_fetch(lValue,1); }
+inline LONG InterlockedExchange(volatile LONG * lValue,LONG lNew)               { return __sync_lock_test_and_set(lValue,lNew); }
+inline LONG InterlockedCompareExchange(volatile LONG * lValue,LONG lNew,LONG lCompare) { return __sync_val_compare_and_swap(lValue,lCompare,lNew); }
+
+#endif // _SageLinuxWindows_H_
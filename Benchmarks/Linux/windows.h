@@ -0,0 +1,3 @@
+// windows.h (Linux) -- Same as Windows.h (some headers use the lower-case name)
+//
+#include "Windows.h"
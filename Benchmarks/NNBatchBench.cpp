@@ -0,0 +1,564 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// NNBatchBench -- Training throughput of CDevNNBatch (minibatch, GEMM kernels) against per-data-set training, and that
+// the batched math is right
+//
+//      GEMM        -- CNNGemm::MulAdd()/MulAddBT(), AVX2 and plain C++, float and double, against a simple triple loop, on
+//                     sizes that are and are not multiples of the SIMD width and the cache blocks
+//      Activations -- CNNActivate::Sigmoid() and TanH(), AVX2 and plain C++, float and double, against std::exp() and
+//                     std::tanh() in double, and their speed
+//      Gradients   -- Batched weight and bias gradients against finite differences (RMS loss, and SoftMax with
+//                     cross-entropy).  Relu is left out: like CDevNN, its derivative is .1 (not 0) where the output is 0.
+//      Per set     -- With a batch size of 1, CDevNNBatch gives the same weights as a per-data-set network built the way
+//                     CDevNN is (per-node loops, activation through a member-function pointer per node)
+//      Counter     -- The 7-bit counter example network trains to 99% (outputs within .4) in double and float.  With
+//                     a fixed learning rate one or two of the 896 outputs can sit in a local minimum for a long time,
+//                     so 100% is not required.
+//      Throughput  -- Data sets/s for the counter network and a wider network (64-256-256-10), per data set vs. batched,
+//                     plain C++ vs. AVX2, double vs. float
+//
+// The per-data-set reference for the throughput is the example's own CDevNN when it can be linked (SAGE_BENCH_CDEVNN,
+// set by CMakeLists.txt on Windows when SageBox.lib is in lib/x64 or lib/x32 -- CDevNN is only in the prebuilt
+// CDevNN32/64.obj).  Otherwise it is CSetNN below, which is built the way CDevNN is.  The results checks always use CSetNN,
+// since CDevNN's weights are not laid out like CDevNNBatch's.
+//
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+#if defined(SAGE_BENCH_CDEVNN)
+#include "CDevNN.h"
+#endif
+#include "CDevNNBatch.h"
+
+static constexpr double kTimeSeconds = .3;      // Time for each throughput measurement
+
+// CSetNN -- Per-data-set training, structured like CDevNN's Forward()/Backward(): a loop per node, with the activation
+// and derivative called through member-function pointers.  Used as the reference for results and speed.
+
+class CSetNN
+{
+public:
+    using ActType = CDevNNBatch::ActType;
+
+private:
+    struct Layer_t
+    {
+        int                 iNodes;
+        int                 iOutputNodes;
+        std::vector<double> vWeights;           // iNodes x iOutputNodes
+        std::vector<double> vBias;              // iOutputNodes
+        std::vector<double> vIn;                // iNodes
+        std::vector<double> vDevCalc;           // iNodes
+        double (CSetNN::*Activate)(double);
+        double (CSetNN::*Derivative)(double);
+    };
+
+    std::vector<Layer_t> m_vLayers;
+    double m_fLearningRate;
+
+    double ActivateSig(double fValue)       { return 1/(1+exp(-fValue));    }
+    double DerivativeSig(double fValue)     { return fValue*(1-fValue);     }
+    double ActivateTanH(double fValue)      { return tanh(fValue);          }
+    double DerivativeTanH(double fValue)    { return 1-fValue*fValue;       }
+    double ActivateRelu(double fValue)      { return fValue > 0 ? fValue : 0; }
+    double DerivativeRelu(double fValue)    { return fValue == 0 ? .1 : fValue < 0 ? 0 : 1; }
+    double ActivateNone(double fValue)      { return fValue;                }
+    double DerivativeNone(double)           { return 1;                     }
+
+public:
+    CSetNN(const CDevNNBatch::stLayerInput_t * stLayers,double fLearningRate) : m_fLearningRate(fLearningRate)
+    {
+        for (int i=0;stLayers[i].eActType != ActType::End;i++)
+        {
+            Layer_t stLayer{};
+            stLayer.iNodes          = stLayers[i].iNodes;
+            stLayer.iOutputNodes    = stLayers[i+1].eActType == ActType::End ? 0 : stLayers[i+1].iNodes;
+            stLayer.vWeights.resize((size_t) stLayer.iNodes*stLayer.iOutputNodes);
+            stLayer.vBias.resize(stLayer.iOutputNodes);
+            stLayer.vIn.resize(stLayer.iNodes);
+            stLayer.vDevCalc.resize(stLayer.iNodes);
+            switch (stLayers[i].eActType)
+            {
+                case ActType::Sigmoid:  stLayer.Activate = &CSetNN::ActivateSig;    stLayer.Derivative = &CSetNN::DerivativeSig;    break;
+                case ActType::TanH:     stLayer.Activate = &CSetNN::ActivateTanH;   stLayer.Derivative = &CSetNN::DerivativeTanH;   break;
+                case ActType::Relu:     stLayer.Activate = &CSetNN::ActivateRelu;   stLayer.Derivative = &CSetNN::DerivativeRelu;   break;
+                default:                stLayer.Activate = &CSetNN::ActivateNone;   stLayer.Derivative = &CSetNN::DerivativeNone;   break;
+            }
+            m_vLayers.push_back(stLayer);
+        }
+    }
+
+    // CopyWeights() -- Start from the same weights as a CDevNNBatch network
+
+    template <typename _t>
+    void CopyWeights(CDevNNBatchT<_t> & cNN)
+    {
+        for (int l=0;l<cNN.GetLayers();l++)
+        {
+            m_vLayers[l].vWeights.assign(cNN.GetWeights(l).begin(),cNN.GetWeights(l).end());
+            m_vLayers[l].vBias.assign(cNN.GetBias(l).begin(),cNN.GetBias(l).end());
+        }
+    }
+
+    std::vector<double> & GetWeights(int iLayer) { return m_vLayers[iLayer].vWeights; }
+
+    void Forward(const double * fInputs)
+    {
+        memcpy(m_vLayers[0].vIn.data(),fInputs,m_vLayers[0].iNodes*sizeof(double));
+        for (size_t l=0;l+1<m_vLayers.size();l++)
+        {
+            auto & stLayer = m_vLayers[l];
+            auto & stNext = m_vLayers[l+1];
+            for (int o=0;o<stLayer.iOutputNodes;o++)
+            {
+                double fSum = stLayer.vBias[o];
+                for (int i=0;i<stLayer.iNodes;i++) fSum += stLayer.vIn[i]*stLayer.vWeights[(size_t) i*stLayer.iOutputNodes + o];
+                stNext.vIn[o] = (this->*stNext.Activate)(fSum);
+            }
+        }
+    }
+
+    void Backward(const double * fExpected)
+    {
+        auto & stLast = m_vLayers.back();
+        for (int o=0;o<stLast.iNodes;o++) stLast.vDevCalc[o] = 2*(stLast.vIn[o] - fExpected[o])*(this->*stLast.Derivative)(stLast.vIn[o]);
+
+        for (int l=(int) m_vLayers.size()-2;l>=0;l--)
+        {
+            auto & stLayer = m_vLayers[l];
+            auto & stNext = m_vLayers[l+1];
+            for (int i=0;i<stLayer.iNodes;i++)
+            {
+                double fDev = 0;
+                double * fWeights = &stLayer.vWeights[(size_t) i*stLayer.iOutputNodes];
+                for (int o=0;o<stLayer.iOutputNodes;o++)
+                {
+                    fDev += fWeights[o]*stNext.vDevCalc[o];
+                    fWeights[o] -= m_fLearningRate*stLayer.vIn[i]*stNext.vDevCalc[o];
+                }
+                stLayer.vDevCalc[i] = fDev*(this->*stLayer.Derivative)(stLayer.vIn[i]);
+            }
+            for (int o=0;o<stLayer.iOutputNodes;o++) stLayer.vBias[o] -= m_fLearningRate*stNext.vDevCalc[o];
+        }
+    }
+
+    void TrainEpoch(int iDataSets,int iInputs,int iOutputs,const double * fInputs,const double * fOutputs)
+    {
+        for (int i=0;i<iDataSets;i++)
+        {
+            Forward(fInputs + (size_t) i*iInputs);
+            Backward(fOutputs + (size_t) i*iOutputs);
+        }
+    }
+};
+
+static unsigned int uiRandom = 2463534242u;
+static double Rand1() { uiRandom ^= uiRandom << 13; uiRandom ^= uiRandom >> 17; uiRandom ^= uiRandom << 5; return (uiRandom >> 8)/(double) (1 << 24); }
+
+// CheckGemm() -- Returns the number of mismatches for one size
+
+template <typename _t>
+static int CheckGemm(int M,int N,int K,double fTolerance)
+{
+    std::vector<_t> vA((size_t) M*K),vAT((size_t) K*M),vB((size_t) K*N),vBT((size_t) N*K),vC0((size_t) M*N),vScratch;
+    for (int i=0;i<M;i++) for (int k=0;k<K;k++) vAT[(size_t) k*M + i] = vA[(size_t) i*K + k] = (_t) (Rand1() - .5);
+    for (int k=0;k<K;k++) for (int j=0;j<N;j++) vBT[(size_t) j*K + k] = vB[(size_t) k*N + j] = (_t) (Rand1() - .5);
+    for (auto & f : vC0) f = (_t) (Rand1() - .5);
+
+    std::vector<double> vExpected((size_t) M*N);
+    for (int i=0;i<M;i++)
+        for (int j=0;j<N;j++)
+        {
+            double fSum = vC0[(size_t) i*N + j];
+            for (int k=0;k<K;k++) fSum += (double) vA[(size_t) i*K + k]*vB[(size_t) k*N + j];
+            vExpected[(size_t) i*N + j] = fSum;
+        }
+
+    int iErrors = 0;
+    for (int iForm=0;iForm<3;iForm++)
+    {
+        std::vector<_t> vC(vC0);
+        if (iForm == 0) CNNGemm::MulAdd(M,N,K,vA.data(),K,1,vB.data(),vC.data());
+        if (iForm == 1) CNNGemm::MulAdd(M,N,K,vAT.data(),1,M,vB.data(),vC.data());
+        if (iForm == 2) CNNGemm::MulAddBT(M,N,K,vA.data(),vBT.data(),vC.data(),vScratch);
+
+        double fMaxError = 0;
+        for (size_t i=0;i<vC.size();i++) fMaxError = (std::max)(fMaxError,std::abs(vC[i] - vExpected[i]));
+        if (fMaxError > fTolerance*std::sqrt((double) K))
+        {
+            printf("GEMM %s %dx%dx%d form %d (%s): error %g\n",sizeof(_t) == 4 ? "float" : "double",M,N,K,iForm,
+                   CNNGemm::isSimd() ? "AVX2" : "C++",fMaxError);
+            iErrors++;
+        }
+    }
+    return iErrors;
+}
+
+// CheckActivations() -- Sigmoid() and TanH() from -50 to 50 against std::exp() and std::tanh() in double (relative
+// error).  The count is not a multiple of the SIMD width, so the last partial vector is checked too.
+
+template <typename _t>
+static int CheckActivations(double fTolerance)
+{
+    constexpr int kCount = 10001;
+    std::vector<_t> vSig(kCount),vTanH(kCount);
+    for (int i=0;i<kCount;i++) vSig[i] = vTanH[i] = (_t) ((i - kCount/2)*.01);
+    CNNActivate::Sigmoid(vSig.data(),vSig.size());
+    CNNActivate::TanH(vTanH.data(),vTanH.size());
+
+    double fSigError = 0,fTanHError = 0;
+    for (int i=0;i<kCount;i++)
+    {
+        double x = (double) (_t) ((i - kCount/2)*.01);
+        double fSig = 1/(1 + std::exp(-x)),fTanH = std::tanh(x);
+        fSigError   = (std::max)(fSigError,std::abs(vSig[i] - fSig)/fSig);
+        fTanHError  = (std::max)(fTanHError,fTanH ? std::abs(vTanH[i] - fTanH)/std::abs(fTanH) : std::abs((double) vTanH[i]));
+    }
+    if (fSigError <= fTolerance && fTanHError <= fTolerance) return 0;
+
+    printf("Activations %s (%s): sigmoid error %g, tanh error %g\n",sizeof(_t) == 4 ? "float" : "double",CNNGemm::isSimd() ? "AVX2" : "C++",
+           fSigError,fTanHError);
+    return 1;
+}
+
+// ActivationsPerSec() -- Values/s through Sigmoid() or TanH(), in blocks of 4096 (refilled each time)
+
+template <typename _t>
+static double ActivationsPerSec(bool bSimd,bool bTanH)
+{
+    constexpr int kCount = 4096;
+    std::vector<_t> vSource(kCount),vValues(kCount);
+    for (auto & f : vSource) f = (_t) (8*Rand1() - 4);
+
+    CNNGemm::EnableSimd(bSimd);
+    long long llValues = 0;
+    double fSeconds = 0;
+    auto tStart = std::chrono::steady_clock::now();
+    while (fSeconds < kTimeSeconds)
+    {
+        for (int i=0;i<100;i++)
+        {
+            memcpy(vValues.data(),vSource.data(),kCount*sizeof(_t));
+            if (bTanH) CNNActivate::TanH(vValues.data(),kCount);
+            else CNNActivate::Sigmoid(vValues.data(),kCount);
+        }
+        llValues += 100*kCount;
+        fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    }
+    CNNGemm::EnableSimd(true);
+    return llValues/fSeconds;
+}
+
+// LossOf() -- The loss that Backward() differentiates: squared error, or cross-entropy for SoftMax outputs
+
+static double LossOf(CDevNNBatch & cNN,const std::vector<double> & vIn,const std::vector<double> & vOut,int iDataSets)
+{
+    std::vector<double> vResult(vOut.size());
+    cNN.Predict(vIn.data(),iDataSets,vResult.data());
+    double fLoss = 0;
+    for (size_t i=0;i<vOut.size();i++)
+        fLoss += cNN.isSoftMax() ? -vOut[i]*std::log(vResult[i]) : (vResult[i] - vOut[i])*(vResult[i] - vOut[i]);
+    return fLoss;
+}
+
+// CheckGradients() -- Batched gradients against central differences for every weight and bias
+
+static int CheckGradients(const CDevNNBatch::stLayerInput_t * stLayers,const char * sName)
+{
+    constexpr int kDataSets = 8;
+    CDevNNBatch cNN(99,stLayers);
+    cNN.SetBatchSize(kDataSets);
+    for (int l=0;l<cNN.GetLayers();l++) for (auto & f : cNN.GetBias(l)) f = Rand1() - .5;
+
+    std::vector<double> vIn((size_t) kDataSets*cNN.GetInputs()),vOut((size_t) kDataSets*cNN.GetOutputs());
+    for (auto & f : vIn) f = 2*Rand1() - 1;
+    for (int i=0;i<kDataSets;i++)
+        for (int j=0;j<cNN.GetOutputs();j++)
+            vOut[(size_t) i*cNN.GetOutputs() + j] = cNN.isSoftMax() ? (j == i % cNN.GetOutputs()) : Rand1();
+
+    cNN.Gradients(vIn.data(),vOut.data(),kDataSets);
+
+    int iBad = 0,iChecked = 0;
+    double fWorst = 0;
+    for (int l=0;l<cNN.GetLayers();l++)
+    {
+        std::vector<double> vWDev(cNN.GetWDev(l)),vBDev(cNN.GetBDev(l));
+        for (int iBias=0;iBias<2;iBias++)
+        {
+            auto & vValues = iBias ? cNN.GetBias(l) : cNN.GetWeights(l);
+            auto & vDev = iBias ? vBDev : vWDev;
+            for (size_t i=0;i<vValues.size();i++)
+            {
+                constexpr double kStep = 1e-6;
+                double fSave = vValues[i];
+                vValues[i] = fSave + kStep;
+                double fPlus = LossOf(cNN,vIn,vOut,kDataSets);
+                vValues[i] = fSave - kStep;
+                double fMinus = LossOf(cNN,vIn,vOut,kDataSets);
+                vValues[i] = fSave;
+
+                double fNumeric = (fPlus - fMinus)/(2*kStep);
+                double fError = std::abs(fNumeric - vDev[i])/(std::max)(1e-3,std::abs(fNumeric) + std::abs(vDev[i]));
+                fWorst = (std::max)(fWorst,fError);
+                iBad += fError > 1e-5;
+                iChecked++;
+            }
+        }
+    }
+    if (iBad) printf("%s: %d of %d gradients differ from finite differences (worst %g)\n",sName,iBad,iChecked,fWorst);
+    return iBad != 0;
+}
+
+// Accuracy() -- Fraction of outputs within .4 of the expected 0 or 1 (the 7-bit counter example's measure)
+
+template <typename _t>
+static double Accuracy(CDevNNBatchT<_t> & cNN,const std::vector<double> & vIn,const std::vector<double> & vOut,int iDataSets)
+{
+    std::vector<double> vResult(vOut.size());
+    cNN.Predict(vIn.data(),iDataSets,vResult.data());
+    int iCorrect = 0;
+    for (size_t i=0;i<vOut.size();i++) iCorrect += std::abs(vResult[i] - vOut[i]) < .4;
+    return (double) iCorrect/vOut.size();
+}
+
+// Throughput() -- Data sets per second training with CDevNNBatch
+
+template <typename _t>
+static double Throughput(const CDevNNBatch::stLayerInput_t * stLayers,int iBatchSize,bool bSimd,int iDataSets,
+                         const std::vector<double> & vIn,const std::vector<double> & vOut)
+{
+    CNNGemm::EnableSimd(bSimd);
+    CDevNNBatchT<_t> cNN(1234,stLayers);
+    cNN.SetBatchSize(iBatchSize);
+    cNN.SetLearnRate(.05);
+    cNN.SetTrainingData(iDataSets,vIn.data(),vOut.data());
+    cNN.TrainEpoch();
+
+    long long llSamples = 0;
+    auto tStart = std::chrono::steady_clock::now();
+    double fSeconds;
+    while ((fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count()) < kTimeSeconds)
+    {
+        cNN.TrainEpoch();
+        llSamples += iDataSets;
+    }
+    CNNGemm::EnableSimd(true);
+    return llSamples/fSeconds;
+}
+
+#if defined(SAGE_BENCH_CDEVNN)
+
+// CTimedDevNN -- The example's CDevNN, trained until kTimeSeconds have passed (TrainUpdate() is called after every epoch)
+
+class CTimedDevNN : public CDevNN
+{
+    std::chrono::steady_clock::time_point   m_tStart;
+    int                                     m_iEpochs = 0;
+
+    cnnErr_t TrainUpdate(const char * & sMsg) override
+    {
+        m_iEpochs++;
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_tStart).count() < kTimeSeconds ? cnnOk : cnnStop;
+    }
+
+public:
+    CTimedDevNN(stLayerInput_t * & stLayers) : CDevNN(1234,LockEnable::Off,stLayers)
+    {
+        SetLearnRate(.05);
+        SetRateChange(false);
+    }
+
+    double Throughput(int iDataSets,double * fInputs,double * fOutputs)
+    {
+        Train(1,iDataSets,fInputs,fOutputs);                // Warm up
+
+        m_iEpochs = 0;
+        m_tStart = std::chrono::steady_clock::now();
+        Train(-1,iDataSets,fInputs,fOutputs);
+        return (double) m_iEpochs*iDataSets/std::chrono::duration<double>(std::chrono::steady_clock::now() - m_tStart).count();
+    }
+};
+
+static const char * const kSetName = "Per data set (CDevNN)";
+
+// ThroughputSet() -- Data sets per second training one data set at a time with CDevNN (CDevNN is large, so it is on the heap)
+
+static double ThroughputSet(const CDevNNBatch::stLayerInput_t * stLayers,int iDataSets,std::vector<double> & vIn,std::vector<double> & vOut)
+{
+    std::vector<CDevNN::stLayerInput_t> vLayers;
+    for (int i=0;;i++)
+    {
+        vLayers.push_back({ stLayers[i].iNodes,(CDevNN::ActType) stLayers[i].eActType });      // Same order of activation types
+        if (stLayers[i].eActType == CDevNNBatch::ActType::End) break;
+    }
+    CDevNN::stLayerInput_t * stDevLayers = vLayers.data();
+    std::unique_ptr<CTimedDevNN> cNN(new CTimedDevNN(stDevLayers));
+    return cNN->Throughput(iDataSets,vIn.data(),vOut.data());
+}
+
+#else
+
+static const char * const kSetName = "Per data set (CDevNN-style node loops)";
+
+// ThroughputSet() -- Data sets per second training one data set at a time with CSetNN
+
+static double ThroughputSet(const CDevNNBatch::stLayerInput_t * stLayers,int iDataSets,std::vector<double> & vIn,std::vector<double> & vOut)
+{
+    CDevNNBatch cInit(1234,stLayers);
+    CSetNN cNN(stLayers,.05);
+    cNN.CopyWeights(cInit);
+
+    long long llSamples = 0;
+    auto tStart = std::chrono::steady_clock::now();
+    double fSeconds;
+    while ((fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count()) < kTimeSeconds)
+    {
+        cNN.TrainEpoch(iDataSets,cInit.GetInputs(),cInit.GetOutputs(),vIn.data(),vOut.data());
+        llSamples += iDataSets;
+    }
+    return llSamples/fSeconds;
+}
+
+#endif
+
+int main()
+{
+    int iErrors = 0;
+    using Act = CDevNNBatch::ActType;
+
+    // GEMM
+
+    static const int iSizes[][3] = { {1,1,1}, {3,5,7}, {4,16,8}, {37,29,53}, {64,128,96}, {130,300,260}, {5,513,17} };
+    for (int iSimd=0;iSimd<2;iSimd++)
+    {
+        CNNGemm::EnableSimd(iSimd != 0);
+        for (auto & iSize : iSizes)
+        {
+            iErrors += CheckGemm<double>(iSize[0],iSize[1],iSize[2],1e-14);
+            iErrors += CheckGemm<float>(iSize[0],iSize[1],iSize[2],1e-6);
+        }
+    }
+    CNNGemm::EnableSimd(true);
+
+    // Activations
+
+    for (int iSimd=0;iSimd<2;iSimd++)
+    {
+        CNNGemm::EnableSimd(iSimd != 0);
+        iErrors += CheckActivations<double>(2e-15);
+        iErrors += CheckActivations<float>(5e-7);
+    }
+    CNNGemm::EnableSimd(true);
+
+    // Gradients
+
+    static const CDevNNBatch::stLayerInput_t stGradNet[] = { {5,Act::Input}, {7,Act::TanH}, {6,Act::None}, {4,Act::Sigmoid}, {0,Act::End} };
+    static const CDevNNBatch::stLayerInput_t stSoftNet[] = { {5,Act::Input}, {8,Act::Sigmoid}, {3,Act::SoftMax}, {0,Act::End} };
+    iErrors += CheckGradients(stGradNet,"TanH/None/Sigmoid");
+    iErrors += CheckGradients(stSoftNet,"Sigmoid/SoftMax");
+
+    // 7-bit counter data (inputs i, expected outputs i+1, one value per bit)
+
+    constexpr int kBits = 7,kCounterSets = 1 << kBits;
+    static const CDevNNBatch::stLayerInput_t stCounter[] = { {kBits,Act::Input}, {12,Act::Sigmoid}, {12,Act::Sigmoid}, {kBits,Act::Sigmoid}, {0,Act::End} };
+    std::vector<double> vCounterIn(kCounterSets*kBits),vCounterOut(kCounterSets*kBits);
+    for (int i=0;i<kCounterSets;i++)
+        for (int k=0;k<kBits;k++)
+        {
+            vCounterIn[i*kBits + k] = (i >> k) & 1;
+            vCounterOut[i*kBits + k] = (((i+1) & (kCounterSets-1)) >> k) & 1;
+        }
+
+    // Per set: batch size 1, no shuffle, same starting weights -> same weights as the per-node network
+
+    {
+        CDevNNBatch cNN(5,stCounter);
+        cNN.SetBatchSize(1);
+        cNN.SetShuffle(false);
+        cNN.SetLearnRate(.3);
+        CSetNN cSetNN(stCounter,.3);
+        cSetNN.CopyWeights(cNN);
+
+        cNN.Train(3,kCounterSets,vCounterIn.data(),vCounterOut.data());
+        for (int i=0;i<3;i++) cSetNN.TrainEpoch(kCounterSets,kBits,kBits,vCounterIn.data(),vCounterOut.data());
+
+        double fMaxDiff = 0;
+        for (int l=0;l<cNN.GetLayers();l++)
+            for (size_t i=0;i<cNN.GetWeights(l).size();i++) fMaxDiff = (std::max)(fMaxDiff,std::abs(cNN.GetWeights(l)[i] - cSetNN.GetWeights(l)[i]));
+        if (fMaxDiff > 1e-9) { printf("Batch size 1 differs from per-set training by %g\n",fMaxDiff); iErrors++; }
+    }
+
+    // Counter: train to 99% within .4, double and float
+
+    int iCounterEpochs[2] = {};
+    for (int iFloat=0;iFloat<2;iFloat++)
+    {
+        constexpr int kMaxEpochs = 20000;
+        auto fnTrain = [&](auto & cNN)
+        {
+            cNN.SetBatchSize(8);
+            cNN.SetLearnRate(2);
+            cNN.SetMomentum(.5);
+            cNN.SetTrainingData(kCounterSets,vCounterIn.data(),vCounterOut.data());
+            for (int i=0;i<kMaxEpochs;i++)
+            {
+                cNN.TrainEpoch();
+                if (i % 25 == 24 && Accuracy(cNN,vCounterIn,vCounterOut,kCounterSets) >= .99) return cNN.getEpoch();
+            }
+            return -1;
+        };
+
+        if (iFloat) { CDevNNBatchF cNN(1234,stCounter); iCounterEpochs[1] = fnTrain(cNN); }
+        else        { CDevNNBatch  cNN(1234,stCounter); iCounterEpochs[0] = fnTrain(cNN); }
+        if (iCounterEpochs[iFloat] < 0) { printf("7-bit counter (%s) did not train in %d epochs\n",iFloat ? "float" : "double",kMaxEpochs); iErrors++; }
+    }
+
+    // Throughput
+
+    constexpr int kWideSets = 2048;
+    static const CDevNNBatch::stLayerInput_t stWide[] = { {64,Act::Input}, {256,Act::Relu}, {256,Act::Relu}, {10,Act::SoftMax}, {0,Act::End} };
+    std::vector<double> vWideIn((size_t) kWideSets*64),vWideOut((size_t) kWideSets*10);
+    for (auto & f : vWideIn) f = 2*Rand1() - 1;
+    for (int i=0;i<kWideSets;i++) vWideOut[(size_t) i*10 + i % 10] = 1;
+
+    printf("%-44s %12s %12s\n","Data sets/s","7-bit","64-256-256-10");
+    auto fnRow = [](const char * sName,double fCounter,double fWide,double fBase0,double fBase1)
+    {
+        printf("%-44s %12.0f %12.0f   (x%.1f, x%.1f)\n",sName,fCounter,fWide,fCounter/fBase0,fWide/fBase1);
+    };
+
+    double fSet0 = ThroughputSet(stCounter,kCounterSets,vCounterIn,vCounterOut);
+    double fSet1 = ThroughputSet(stWide,kWideSets,vWideIn,vWideOut);
+    fnRow(kSetName,fSet0,fSet1,fSet0,fSet1);
+    fnRow("Batch 1, double",Throughput<double>(stCounter,1,true,kCounterSets,vCounterIn,vCounterOut),
+          Throughput<double>(stWide,1,true,kWideSets,vWideIn,vWideOut),fSet0,fSet1);
+    fnRow("Batch 32, double, C++ kernels",Throughput<double>(stCounter,32,false,kCounterSets,vCounterIn,vCounterOut),
+          Throughput<double>(stWide,32,false,kWideSets,vWideIn,vWideOut),fSet0,fSet1);
+    fnRow("Batch 32, float, C++ kernels",Throughput<float>(stCounter,32,false,kCounterSets,vCounterIn,vCounterOut),
+          Throughput<float>(stWide,32,false,kWideSets,vWideIn,vWideOut),fSet0,fSet1);
+    if (CNNGemm::isAVX2())
+    {
+        fnRow("Batch 32, double, AVX2/FMA",Throughput<double>(stCounter,32,true,kCounterSets,vCounterIn,vCounterOut),
+              Throughput<double>(stWide,32,true,kWideSets,vWideIn,vWideOut),fSet0,fSet1);
+        fnRow("Batch 32, float, AVX2/FMA",Throughput<float>(stCounter,32,true,kCounterSets,vCounterIn,vCounterOut),
+              Throughput<float>(stWide,32,true,kWideSets,vWideIn,vWideOut),fSet0,fSet1);
+    }
+    else printf("(AVX2/FMA not available on this CPU)\n");
+
+    printf("\n%-44s %12s %12s\n","Activations (M values/s)","C++","AVX2");
+    for (int iType=0;iType<4;iType++)
+    {
+        static const char * sNames[] = { "Sigmoid, double","Sigmoid, float","TanH, double","TanH, float" };
+        bool bTanH = iType >= 2,bFloat = (iType & 1) != 0;
+        double fScalar  = bFloat ? ActivationsPerSec<float>(false,bTanH) : ActivationsPerSec<double>(false,bTanH);
+        double fSimd    = !CNNGemm::isAVX2() ? 0 : bFloat ? ActivationsPerSec<float>(true,bTanH) : ActivationsPerSec<double>(true,bTanH);
+        printf("%-44s %12.1f %12.1f   (x%.1f)\n",sNames[iType],fScalar/1e6,fSimd/1e6,fSimd/fScalar);
+    }
+    printf("\n7-bit counter at 99%% (within .4): %d epochs (double), %d epochs (float)\n",iCounterEpochs[0],iCounterEpochs[1]);
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
@@ -0,0 +1,137 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// NumFormatBench -- CNumFormat vs. sprintf()/atof() for the number formats used by CString
+//
+// Checks that CNumFormat gives the same text as sprintf() for each style (and that the shortest round-trip text
+// reads back as the same double, laid out as std::to_chars() does), then times both.
+//
+// With C++14 CNumFormat converts doubles itself (Grisu3, exact %f rounding, and a fast-path parser), and in optimized
+// (NDEBUG) builds each conversion must be at least kMinSpeedup times faster than the CRT function it replaces.
+//
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "CNumFormat.h"
+
+using namespace Sage;
+
+static constexpr int kNumValues     = 1000000;
+static constexpr int kTimeRuns      = 3;            // Best of 3, to keep a busy machine from failing the speed check
+static constexpr double kMinSpeedup = 1.5;
+
+template <typename _fn>
+static double TimeNs(_fn && fnTest)
+{
+    double fBest = 0;
+    for (int i=0;i<kTimeRuns;i++)
+    {
+        auto tStart = std::chrono::steady_clock::now();
+        fnTest();
+        double fNs = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-tStart).count()/kNumValues;
+        if (!i || fNs < fBest) fBest = fNs;
+    }
+    return fBest;
+}
+
+// Shortest() layout -- the same text as std::to_chars() (fixed or scientific, whichever is shorter; exact large integers)
+
+static const struct { double fValue; const char * sText; } stLayouts[] =
+{
+    { 0.0, "0" },                   { -0.0, "-0" },                 { 0.1, "0.1" },                 { 1.0/3, "0.3333333333333333" },
+    { 0.001, "0.001" },             { 0.0001, "1e-04" },            { 123456.0, "123456" },         { 1e16, "1e+16" },
+    { 1e22, "1e+22" },              { 5e-324, "5e-324" },           { -1.5e300, "-1.5e+300" },      { 1.7976931348623157e308, "1.7976931348623157e+308" },
+    { 123456789012345680000.0, "123456789012345683968" },          { 9007199254740993.0, "9007199254740992" },
+};
+
+int main()
+{
+    std::mt19937_64 cRand(12345);
+    std::vector<double> vDoubles(kNumValues);
+    std::vector<long long> vInts(kNumValues);
+    for (int i=0;i<kNumValues;i++)
+    {
+        vDoubles[i] = std::ldexp((double) cRand()/(double) cRand.max()*2-1,(int) (cRand() % 80)-40);
+        vInts[i] = (long long) cRand() >> (cRand() % 63);
+    }
+
+    char sFast[CNumFormat::kMaxFormatText];
+    char sSlow[CNumFormat::kMaxFormatText];
+    int iErrors = 0;
+    volatile int iSink = 0;
+
+    // Correctness
+
+    const char * sStyles[] = { "%g", "%.3f", "%.10e", "%G", "%.15g", "%f", "%.0f", "%.1e", "%.10g" };
+    for (int i=0;i<kNumValues;i++)
+    {
+        for (auto sStyle : sStyles)
+        {
+            CNumFormat::Format(sFast,vDoubles[i],sStyle);
+            snprintf(sSlow,sizeof(sSlow),sStyle,vDoubles[i]);
+            if (strcmp(sFast,sSlow) && iErrors++ < 10) printf("Mismatch (%s): %s vs %s\n",sStyle,sFast,sSlow);
+        }
+
+        double fRead = 0;
+        CNumFormat::Shortest(sFast,vDoubles[i]);
+        if (!CNumFormat::ParseDouble(sFast,fRead) || fRead != vDoubles[i] || atof(sFast) != vDoubles[i])
+            if (iErrors++ < 10) printf("Round-trip failed: %s\n",sFast);
+
+        long long llRead = 0;
+        CNumFormat::IntToText(sFast,vInts[i]);
+        snprintf(sSlow,sizeof(sSlow),"%lld",vInts[i]);
+        if (strcmp(sFast,sSlow) || !CNumFormat::ParseInt(sFast,llRead) || llRead != vInts[i])
+            if (iErrors++ < 10) printf("Integer mismatch: %s vs %s\n",sFast,sSlow);
+    }
+
+    for (auto & stLayout : stLayouts)
+    {
+        CNumFormat::Shortest(sFast,stLayout.fValue);
+        if (strcmp(sFast,stLayout.sText) && iErrors++ < 20) printf("Shortest(%.17g) is \"%s\", expected \"%s\"\n",stLayout.fValue,sFast,stLayout.sText);
+    }
+
+    printf("%-28s %12s %12s %8s\n","Test","CNumFormat","sprintf","Speedup");
+
+    auto Report = [&](const char * sTest,double fFast,double fSlow)
+    {
+        printf("%-28s %9.1f ns %9.1f ns %7.2fx\n",sTest,fFast,fSlow,fSlow/fFast);
+#if defined(NDEBUG)
+        if (fSlow/fFast < kMinSpeedup)
+        {
+            printf("    %s is less than %.1fx faster than the CRT\n",sTest,kMinSpeedup);
+            iErrors++;
+        }
+#endif
+    };
+
+    Report("int64 -> text",
+        TimeNs([&] { for (auto llValue : vInts) iSink += CNumFormat::IntToText(sFast,llValue); }),
+        TimeNs([&] { for (auto llValue : vInts) iSink += snprintf(sSlow,sizeof(sSlow),"%lld",llValue); }));
+
+    Report("double -> text (%g)",
+        TimeNs([&] { for (auto fValue : vDoubles) iSink += CNumFormat::Format(sFast,fValue,"%g"); }),
+        TimeNs([&] { for (auto fValue : vDoubles) iSink += snprintf(sSlow,sizeof(sSlow),"%g",fValue); }));
+
+    Report("double -> text (%.3f)",
+        TimeNs([&] { for (auto fValue : vDoubles) iSink += CNumFormat::Format(sFast,fValue,"%.3f"); }),
+        TimeNs([&] { for (auto fValue : vDoubles) iSink += snprintf(sSlow,sizeof(sSlow),"%.3f",fValue); }));
+
+    Report("double -> shortest (%.17g)",
+        TimeNs([&] { for (auto fValue : vDoubles) iSink += CNumFormat::Shortest(sFast,fValue); }),
+        TimeNs([&] { for (auto fValue : vDoubles) iSink += snprintf(sSlow,sizeof(sSlow),"%.17g",fValue); }));
+
+    std::vector<char> vText(kNumValues*32);
+    for (int i=0;i<kNumValues;i++) CNumFormat::Shortest(vText.data()+i*32,vDoubles[i]);
+
+    double fSum = 0;
+    Report("text -> double",
+        TimeNs([&] { for (int i=0;i<kNumValues;i++) { double f = 0; CNumFormat::ParseDouble(vText.data()+i*32,f); fSum += f; } }),
+        TimeNs([&] { for (int i=0;i<kNumValues;i++) fSum += atof(vText.data()+i*32); }));
+
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+# PgrBuildTest.cmake -- ctest script for PgrBuild: the same input must give the same archive, and every entry must read back
+#
+#   cmake -DPGRBUILD=<PgrBuild executable> -DINPUT=<directory> -P PgrBuildTest.cmake
+#
+# The archives are written to the working directory and removed when the test passes.
+
+foreach(sVar PGRBUILD INPUT)
+    if(NOT DEFINED ${sVar})
+        message(FATAL_ERROR "PgrBuildTest: -D${sVar}=... is required")
+    endif()
+endforeach()
+
+set(sArchive1 "${CMAKE_CURRENT_BINARY_DIR}/PgrBuildTest1.pgr")
+set(sArchive2 "${CMAKE_CURRENT_BINARY_DIR}/PgrBuildTest2.pgr")
+file(REMOVE "${sArchive1}" "${sArchive2}")
+
+execute_process(COMMAND "${PGRBUILD}" "${sArchive1}" "${INPUT}" -threads 1 -verify RESULT_VARIABLE iResult)
+if(NOT iResult EQUAL 0)
+    message(FATAL_ERROR "PgrBuild with one thread failed (${iResult})")
+endif()
+
+execute_process(COMMAND "${PGRBUILD}" "${sArchive2}" "${INPUT}" -verify RESULT_VARIABLE iResult)
+if(NOT iResult EQUAL 0)
+    message(FATAL_ERROR "PgrBuild with all threads failed (${iResult})")
+endif()
+
+if(EXISTS "${sArchive1}.tmp" OR EXISTS "${sArchive2}.tmp")
+    message(FATAL_ERROR "Build() left its temporary file behind")
+endif()
+
+execute_process(COMMAND "${CMAKE_COMMAND}" -E compare_files "${sArchive1}" "${sArchive2}" RESULT_VARIABLE iResult)
+if(NOT iResult EQUAL 0)
+    message(FATAL_ERROR "The archives differ: the output depends on the number of threads")
+endif()
+
+file(REMOVE "${sArchive1}" "${sArchive2}")
+message(STATUS "Passed: identical archives, every entry read back")
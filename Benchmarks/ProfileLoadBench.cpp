@@ -0,0 +1,158 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// ProfileLoadBench -- Load time of a text profile (CProfileIndex) vs. the same profile in binary form (CProfileBinary)
+//
+// Builds a preset-library-sized profile (sections of tags plus embedded data files), converts it to binary, checks that
+// both forms give the same values and files, then times loading each form: open, read every tag, and get every file.
+//
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CProfileBinary.h"
+
+using namespace Sage;
+
+static constexpr int kNumSections   = 50;
+static constexpr int kTagsPerSection = 100;
+static constexpr int kNumFiles      = 8;
+static constexpr int kFileSize      = 1024*1024;
+static constexpr int kIterations    = 20;
+
+template <typename _fn>
+static double TimeMs(_fn && fnTest)
+{
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i=0;i<kIterations;i++) fnTest();
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count()/kIterations;
+}
+
+int main()
+{
+    // Build the text profile
+
+    std::vector<std::string> vNames;
+    std::vector<std::vector<unsigned char>> vFiles(kNumFiles);
+
+    CProfileWriter cWriter;
+    cWriter.OpenMemory();
+    cWriter.Comment("ProfileLoadBench preset library");
+    for (int i=0;i<kNumSections;i++)
+    {
+        char sSection[32],sTag[32];
+        snprintf(sSection,sizeof(sSection),"Preset%d",i);
+        cWriter.Section(sSection);
+        for (int j=0;j<kTagsPerSection;j++)
+        {
+            snprintf(sTag,sizeof(sTag),"Value%d",j);
+            cWriter.PutInteger(sTag,i*kTagsPerSection+j);
+            vNames.push_back(std::string(sSection) + "." + sTag);
+        }
+    }
+    for (int i=0;i<kNumFiles;i++)
+    {
+        vFiles[i].resize(kFileSize);
+        for (int j=0;j<kFileSize;j++) vFiles[i][j] = (unsigned char) (j*(i+3) >> 4);
+        cWriter.PutFile(("File" + std::to_string(i) + ".bin").c_str(),vFiles[i].data(),kFileSize);
+    }
+    cWriter.Close();
+    const std::string & sText = cWriter.GetMemory();
+
+    CProfileIndex cText(sText.data(),(int) sText.size());
+    std::vector<unsigned char> vBinary;
+    if (!cText.isValid() || !CProfileBinary::FromText(cText,vBinary))
+    {
+        printf("FAILED: could not convert the profile (%s)\n",cText.GetErrorMessage() ? cText.GetErrorMessage() : "file data");
+        return 1;
+    }
+
+    // Correctness
+
+    int iErrors = 0;
+    CProfileBinary cBinary(vBinary.data(),vBinary.size());
+    for (int i=0;i<(int) vNames.size();i++)
+    {
+        if (cText.GetInteger(vNames[i].c_str(),-1) != i || cBinary.GetInteger(vNames[i].c_str(),-1) != i)
+            if (iErrors++ < 10) printf("Tag mismatch: %s\n",vNames[i].c_str());
+    }
+    for (int i=0;i<kNumFiles;i++)
+    {
+        std::string sName = "File" + std::to_string(i) + ".bin";
+        bool bText,bBinary;
+        auto cData = cText.GetFileData(sName.c_str(),&bText);
+        auto stView = cBinary.GetFileData(sName.c_str(),&bBinary);
+        if (!bText || !bBinary || memcmp((char *) cData,vFiles[i].data(),kFileSize) || stView.iSize != kFileSize || memcmp(stView.pData,vFiles[i].data(),kFileSize))
+            if (iErrors++ < 10) printf("File mismatch: %s\n",sName.c_str());
+    }
+
+    // Trailing comments, "//" inside values, and integer limits
+
+    {
+        const char sSmall[] = "Five = 5 // five\nUrl = http://sagebox.com  // site\nEmpty = // nothing\nLast = 7//no space\n"
+                              "Min = -2147483648\nMax = 0x7fffffff\nOver = 2147483648\nHexMin = -0x80000000\n";
+        CProfileIndex cSmall(sSmall,(int) sizeof(sSmall)-1);
+        auto Value = [&](const char * sTag) { auto stView = cSmall.GetView(sTag); return std::string(stView.pData ? stView.pData : "",(size_t) stView.iLength); };
+        bool bOver = true,bHexMin = true;
+        cSmall.GetInteger("Over",0,&bOver);
+        cSmall.GetInteger("HexMin",0,&bHexMin);
+
+        if (!cSmall.isValid() || cSmall.GetInteger("Five") != 5 || Value("Url") != "http://sagebox.com" || Value("Empty") != "" ||
+            Value("Last") != "7//no space" || cSmall.GetInteger("Min") != INT_MIN || cSmall.GetInteger("Max") != INT_MAX || bOver || bHexMin)
+            if (iErrors++ < 10) printf("Comment or integer parsing mismatch\n");
+
+        CProfileWriter cOut;
+        cOut.OpenMemory();
+        cOut.PutString("Path","a // b");
+        cOut.PutString("Start","// c");
+        cOut.Close();
+        CProfileIndex cIn(cOut.GetMemory().data(),(int) cOut.GetMemory().size());
+        auto stPath = cIn.GetView("Path"),stStart = cIn.GetView("Start");
+        if (std::string(stPath.pData ? stPath.pData : "",(size_t) stPath.iLength) != "a // b" || std::string(stStart.pData ? stStart.pData : "",(size_t) stStart.iLength) != "// c")
+            if (iErrors++ < 10) printf("CProfileWriter value with \"//\" did not read back\n");
+    }
+
+    // Load times (open, read every tag, get every file)
+
+    volatile long long llSink = 0;
+
+    auto LoadText = [&]
+    {
+        CProfileIndex cProfile(sText.data(),(int) sText.size());
+        for (auto & sName : vNames) llSink += cProfile.GetInteger(sName.c_str());
+        for (auto & stFile : cProfile.GetFiles()) llSink += cProfile.GetFileData(cProfile.GetFileName(stFile).c_str()).GetNumitems();
+    };
+
+    auto LoadBinary = [&]
+    {
+        CProfileBinary cProfile(vBinary.data(),vBinary.size());
+        for (auto & sName : vNames) llSink += cProfile.GetInteger(sName.c_str());
+        for (int i=0;i<cProfile.GetNumFiles();i++) llSink += cProfile.GetFileData(cProfile.GetFileName(cProfile.GetFile(i))).iSize;
+    };
+
+    auto OpenText   = [&] { CProfileIndex cProfile(sText.data(),(int) sText.size()); llSink += cProfile.GetNumTags(); };
+    auto OpenBinary = [&] { CProfileBinary cProfile(vBinary.data(),vBinary.size()); llSink += cProfile.GetNumTags(); };
+
+    printf("Profile: %d tags, %d files of %d KB; text %.1f MB, binary %.1f MB (CRC32C %s)\n\n",(int) vNames.size(),kNumFiles,kFileSize/1024,
+            sText.size()/1048576.0,vBinary.size()/1048576.0,CCrc32c::isHardware() ? "SSE4.2" : "software");
+
+    printf("%-30s %12s %12s %8s\n","Test","Text","Binary","Speedup");
+
+    auto Report = [&](const char * sTest,double fText,double fBinary)
+    {
+        printf("%-30s %9.3f ms %9.3f ms %7.1fx\n",sTest,fText,fBinary,fText/fBinary);
+    };
+
+    Report("Open",TimeMs(OpenText),TimeMs(OpenBinary));
+    Report("Open + all tags + all files",TimeMs(LoadText),TimeMs(LoadBinary));
+
+    std::vector<unsigned char> vOut;
+    double fToBinary = TimeMs([&] { CProfileBinary::FromText(cText,vOut); });
+    double fToText   = TimeMs([&] { CProfileWriter cOut; cOut.OpenMemory(); cBinary.ToText(cOut); cOut.Close(); llSink += cOut.GetMemory().size(); });
+    printf("\nConvert text -> binary: %.3f ms, binary -> text: %.3f ms\n",fToBinary,fToText);
+
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
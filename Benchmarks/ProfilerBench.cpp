@@ -0,0 +1,246 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// ProfilerBench -- Cost of a CProfiler zone, and that the events from several threads are collected and exported intact
+//
+//      Cost        -- ns per SageProfileZone() with recording off (what is left in a program that never turns it on)
+//                     and on, next to the plain clock read it is built from
+//      Threads     -- 4 threads record nested zones, counters and frames while this thread collects.  Every event must
+//                     be collected or counted as dropped, with the right depth, and inner zones inside their outer zone.
+//      Memory      -- The history is not allocated until Enable(), and the rings of exited threads are freed by Collect()
+//      Export      -- The Chrome trace JSON has every zone, the thread names and the startup events, escapes names, writes
+//                     NaN and infinite counter values as null (JSON has no literal for them), and is balanced.
+//
+// The SageProfile macros are opt-in, so SAGE_PROFILE is defined before anything is included.
+//
+#define SAGE_PROFILE
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CProfiler.h"
+
+using namespace Sage;
+
+static constexpr int kCostLoops     = 2000000;
+static constexpr int kNumThreads    = 4;
+static constexpr int kPerThread     = 25000;        // Outer zones per thread (each has 2 inner zones and a counter)
+
+static thread_local volatile int iSink;      // Keeps the timed loops from being optimized away
+
+static double NsPerLoop(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-tStart).count()/kCostLoops;
+}
+
+// isBalanced() -- Brackets and braces match outside of strings, and strings are closed
+
+static bool isBalanced(const std::string & sJson)
+{
+    std::vector<char> vStack;
+    bool bString = false;
+    for (size_t i=0;i<sJson.size();i++)
+    {
+        char c = sJson[i];
+        if (bString)
+        {
+            if (c == '\\') i++;
+            else if (c == '"') bString = false;
+            else if ((unsigned char) c < 0x20) return false;
+            continue;
+        }
+        if (c == '"') bString = true;
+        else if (c == '{' || c == '[') vStack.push_back(c);
+        else if (c == '}' || c == ']')
+        {
+            if (vStack.empty() || vStack.back() != (c == '}' ? '{' : '[')) return false;
+            vStack.pop_back();
+        }
+    }
+    return !bString && vStack.empty();
+}
+
+static int CountOf(const std::string & sText,const char * sFind)
+{
+    int iCount = 0;
+    for (size_t szPos = sText.find(sFind);szPos != std::string::npos;szPos = sText.find(sFind,szPos+1)) iCount++;
+    return iCount;
+}
+
+int main()
+{
+    int iErrors = 0;
+
+    // Cost
+
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i=0;i<kCostLoops;i++) iSink = (int) CProfiler::Now();
+    double fClockNs = NsPerLoop(tStart);
+
+    tStart = std::chrono::steady_clock::now();
+    for (int i=0;i<kCostLoops;i++) { SageProfileZone("Off"); iSink = i; }
+    double fOffNs = NsPerLoop(tStart);
+
+    if (CProfiler::GetHistoryMemory()) { printf("History allocated before Enable()\n"); iErrors++; }
+    CProfiler::Enable(true);
+    if (CProfiler::GetHistoryMemory() != (size_t) CProfiler::kDefaultHistory*sizeof(CProfiler::Event_t)) { printf("Enable() did not allocate the history\n"); iErrors++; }
+    CProfiler::SetHistorySize(kCostLoops);
+    tStart = std::chrono::steady_clock::now();
+    for (int i=0;i<kCostLoops;i++)
+    {
+        SageProfileZone("On");
+        iSink = i;
+        if ((i & 0x3FFF) == 0x3FFF) CProfiler::Collect();       // As the view's timer would (every 16k zones)
+    }
+    double fOnNs = NsPerLoop(tStart);
+    if (CProfiler::GetDropped()) { printf("%lld zones dropped on one thread\n",CProfiler::GetDropped()); iErrors++; }
+    CProfiler::Clear();
+
+    // Threads
+
+    CProfiler::SetHistorySize(kNumThreads*kPerThread*5 + 1000);
+    CProfiler::SetThreadName("Main \"collector\"");
+    CStartupTrace::Mark("Bench start");
+    long long llFrameStart = CProfiler::Frame();
+
+    std::atomic<int> iDone{0};
+    std::vector<std::thread> vThreads;
+    for (int t=0;t<kNumThreads;t++)
+        vThreads.emplace_back([&,t]
+        {
+            char sName[32];
+            snprintf(sName,sizeof(sName),"Worker %d",t);
+            CProfiler::SetThreadName(sName);
+            for (int i=0;i<kPerThread;i++)
+            {
+                SageProfileZone("Outer");
+                { SageProfileZone("Inner A"); iSink = i; }
+                { SageProfileZone("Inner B"); iSink = i; }
+                SageProfileCounter("Items",i);
+            }
+            iDone++;
+        });
+
+    int iCollected = 0,iFrames = 1;
+    while (iDone < kNumThreads)
+    {
+        iCollected += CProfiler::Collect();
+        CProfiler::Frame();
+        iFrames++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    for (auto & cThread : vThreads) cThread.join();
+    iCollected += CProfiler::Collect();
+
+    // The workers have exited, so that Collect() freed their rings (the names stay for the export)
+
+    int iRunning = 0;
+    for (auto & stThread : CProfiler::GetThreads()) iRunning += stThread.bRunning;
+    if (iRunning != 1) { printf("%d threads still have rings (only this one should)\n",iRunning); iErrors++; }
+
+    long long llDropped = CProfiler::GetDropped();
+    long long llProduced = (long long) kNumThreads*kPerThread*4 + iFrames;
+    if (iCollected + llDropped != llProduced)
+    {
+        printf("%d collected + %lld dropped != %lld recorded\n",iCollected,llDropped,llProduced);
+        iErrors++;
+    }
+
+    std::vector<CProfiler::Event_t> vEvents;
+    CProfiler::GetEvents(vEvents);
+    if ((int) vEvents.size() != iCollected) { printf("History has %d of %d events\n",(int) vEvents.size(),iCollected); iErrors++; }
+
+    int iBad = 0,iOuter = 0;
+    std::vector<const CProfiler::Event_t *> vLastOuter(kNumThreads+1,nullptr);
+    std::vector<std::vector<const CProfiler::Event_t *>> vInner(kNumThreads+1);
+    std::vector<long long> vThreadDropped(kNumThreads+1,0);
+    for (auto & stThread : CProfiler::GetThreads()) if (stThread.iIndex <= kNumThreads) vThreadDropped[stThread.iIndex] = stThread.llDropped;
+    long long llLastFrame = -1;
+    for (auto & stEvent : vEvents)
+    {
+        if (stEvent.eType == CProfiler::EventType::Frame)
+        {
+            if (stEvent.llFrame <= llLastFrame) iBad++;
+            llLastFrame = stEvent.llFrame;
+            continue;
+        }
+        if (stEvent.uiThread == 0 || stEvent.uiThread > kNumThreads) continue;
+        if (stEvent.eType == CProfiler::EventType::Counter) continue;
+
+        bool bOuter = !strcmp(stEvent.sName,"Outer");
+        if (stEvent.ucDepth != (bOuter ? 0 : 1) || stEvent.llDurationNs < 0) { iBad++; continue; }
+
+        // Inner zones end before their outer zone, so they are recorded (and collected) first.  Nesting is only checked
+        // on threads that dropped nothing (a dropped outer zone leaves its inner zones to the next one).
+
+        if (!bOuter) { vInner[stEvent.uiThread].push_back(&stEvent); continue; }
+        iOuter++;
+        if (vThreadDropped[stEvent.uiThread] == 0)
+            for (auto pInner : vInner[stEvent.uiThread])
+                if (pInner->llStartNs < stEvent.llStartNs || pInner->llStartNs + pInner->llDurationNs > stEvent.llStartNs + stEvent.llDurationNs) iBad++;
+        if (vLastOuter[stEvent.uiThread] && vLastOuter[stEvent.uiThread]->llStartNs > stEvent.llStartNs) iBad++;
+        vLastOuter[stEvent.uiThread] = &stEvent;
+        vInner[stEvent.uiThread].clear();
+    }
+    if (iBad) { printf("%d events with the wrong depth, nesting or order\n",iBad); iErrors++; }
+    if (!llDropped && iOuter != kNumThreads*kPerThread) { printf("%d of %d outer zones\n",iOuter,kNumThreads*kPerThread); iErrors++; }
+
+    double fAverageMs,fMaxMs;
+    if (!CProfiler::GetFrameStats(100,fAverageMs,fMaxMs) || fAverageMs < 1.0 || fMaxMs < fAverageMs)
+    {
+        printf("Frame stats %.3f ms avg, %.3f ms max\n",fAverageMs,fMaxMs);
+        iErrors++;
+    }
+
+    // Export
+
+    CProfiler::Mark("Line\nbreak");
+    CProfiler::Counter("Not finite",NAN);
+    CProfiler::Counter("Not finite",INFINITY);
+    CProfiler::Counter("Not finite",-INFINITY);
+    CProfiler::Counter("Not finite",-0.5);
+    std::string sJson;
+    CProfiler::ExportChromeTrace(sJson);
+
+    int iZones = 0;
+    for (auto & stEvent : vEvents) iZones += stEvent.eType == CProfiler::EventType::Zone;
+    const char * sPrefix = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n{";
+    if (sJson.compare(0,strlen(sPrefix),sPrefix) || !isBalanced(sJson)) { printf("JSON is not well formed\n"); iErrors++; }
+    if (CountOf(sJson,"\"cat\":\"sage\"") != iZones)
+    {
+        printf("JSON has %d zones (%d expected)\n",CountOf(sJson,"\"cat\":\"sage\""),iZones);
+        iErrors++;
+    }
+    if (CountOf(sJson,"\"thread_name\"") != kNumThreads+1 || CountOf(sJson,"\"Worker 3\"") != 1 || CountOf(sJson,"\"Main \\\"collector\\\"\"") != 1)
+    {
+        printf("JSON thread names are missing\n");
+        iErrors++;
+    }
+    if (CountOf(sJson,"\"Line\\u000abreak\"") != 1 || CountOf(sJson,"\"Bench start\"") != 1 || CountOf(sJson,"\"ph\":\"C\"") == 0)
+    {
+        printf("JSON marks, escapes or counters are missing\n");
+        iErrors++;
+    }
+    if (CountOf(sJson,"\"value\":null}") != 3 || CountOf(sJson,"\"value\":-0.5}") != 1 || CountOf(sJson,"nan}") || CountOf(sJson,"inf}"))
+    {
+        printf("JSON counters with NaN or infinite values are not null\n");
+        iErrors++;
+    }
+
+    const char * sPath = "ProfilerBench_trace.json";
+    if (!CProfiler::ExportChromeTrace(sPath)) { printf("Could not write %s\n",sPath); iErrors++; }
+    remove(sPath);
+
+    printf("%-40s %10.1f ns\n","Clock read (CProfiler::Now())",fClockNs);
+    printf("%-40s %10.1f ns\n","Zone, recording off",fOffNs);
+    printf("%-40s %10.1f ns\n","Zone, recording on",fOnNs);
+    printf("%-40s %10d events, %lld dropped, %d frames from %lld\n","4 threads + collector",iCollected,llDropped,iFrames,llFrameStart);
+    printf("%-40s %10.1f KB\n","Chrome trace JSON",sJson.size()/1024.0);
+
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
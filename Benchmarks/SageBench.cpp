@@ -0,0 +1,689 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// SageBench -- Benchmark suite for the portable image, memory, string and sort code, with JSON output for baselines
+//
+// Each benchmark is run repeatedly for at least --min-time (300ms by default).  Every sample is timed on its own (short
+// benchmarks are batched so a sample is at least ~20us), and the results are reported as throughput and as latency
+// percentiles per call (p50, p90, p99).
+//
+//      SageBench                                   -- Run everything, print a table
+//      SageBench --json results.json               -- Also write the results as JSON
+//      SageBench --baseline base.json              -- Compare the p50 of each benchmark with an earlier --json file;
+//                --tolerance 10                       more than 10% slower is a regression (and the run fails)
+//      SageBench --filter image/                   -- Only benchmarks whose name contains "image/"
+//      SageBench --quick                           -- Short run (for ctest: checks that everything runs and is correct)
+//      SageBench --list                            -- List the benchmarks
+//
+// Groups:
+//
+//      image/      CWarp resize (bilinear, bicubic) and rotate with a coverage mask, CFastFilters box blur (one pass and
+//                  three passes) and median, CBitmapStats auto-level
+//      mem/        Mem Fill() vs. FillFast() and ClearMem() vs. ClearMemFast(), Mem and MemP copy, MemP fill, clear and
+//                  allocation (CMemClass.h)
+//      string/     CNumFormat, CFormatCache and CCompactString formatting, with snprintf() references (ref/)
+//      sort/       The sort algorithms from the Visual Sort example (SortAlgorithms.cpp)
+//
+// Only code that is in the headers (or the examples) is covered.  The library's own resize (Lanczos), color-space
+// conversion, bitmap copy, mask and fill (RawBitmap_t), JPEG decoding and CString are compiled into the prebuilt Windows libraries and cannot be built here;
+// they are listed as not covered in the JSON so that a baseline shows the gap rather than hiding it.
+//
+// Results are checked as well as timed (sorted output, blurred and resized pixels, formatted text), and the program ends
+// with Passed/FAILED like the other benchmarks.
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CWarp.h"
+#include "CFastFilters.h"
+#include "CBitmapStats.h"
+#include "CNumFormat.h"
+#include "CFormatCache.h"
+#include "CCompactString.h"
+#include "SortAlgorithms.h"
+
+using namespace Sage;
+
+#if !defined(SAGE_BENCH_BUILD_TYPE)
+#define SAGE_BENCH_BUILD_TYPE "unknown"
+#endif
+
+static constexpr int kImageWidth    = 1920;
+static constexpr int kImageHeight   = 1080;
+static constexpr int kSortItems     = 100000;
+static constexpr int kSelectionItems = 5000;            // Selection sort is O(n^2)
+static constexpr int kStringItems   = 100000;
+
+// NotCovered_t -- Requested areas whose code is only in the prebuilt libraries
+
+struct NotCovered_t
+{
+    const char * sName;
+    const char * sReason;
+};
+
+static const NotCovered_t stNotCovered[] =
+{
+    { "image/resize_lanczos",       "CSageTools resize is in the prebuilt library (CWarp bilinear/bicubic are covered)" },
+    { "image/color_convert",        "Color-space conversion is in the prebuilt library" },
+    { "image/bitmap_copy",          "RawBitmap_t::CopyFrom() is in the prebuilt library" },
+    { "image/bitmap_mask",          "RawBitmap_t::ApplyMaskColor() and ApplyMaskGraphic() are in the prebuilt library" },
+    { "image/bitmap_fill",          "RawBitmap_t::FillColor() is in the prebuilt library" },
+    { "image/jpeg_decode",          "CJpeg is in the prebuilt library" },
+    { "string/cstring_format",      "CString is in the prebuilt library (CCompactString, CFormatCache and CNumFormat are covered)" },
+};
+
+// CBenchBitmap -- A 24-bit bitmap in MemP memory (Sage::CreateBitmap() is in the library)
+
+class CBenchBitmap
+{
+    MemP<unsigned char> m_mMem;
+
+public:
+    RawBitmap_t stBitmap{};
+
+    CBenchBitmap(int iWidth,int iHeight)
+    {
+        stBitmap.iWidth         = iWidth;
+        stBitmap.iHeight        = iHeight;
+        stBitmap.iWidthBytes    = (iWidth*3 + 3) & ~3;
+        stBitmap.iOverHang      = stBitmap.iWidthBytes - iWidth*3;
+        stBitmap.iTotalSize     = stBitmap.iWidthBytes*iHeight;
+        m_mMem                  = stBitmap.iTotalSize;
+        m_mMem.ClearMem();
+        stBitmap.stMem          = m_mMem;
+        stBitmap.stRGB          = (RGBColor24 *) stBitmap.stMem;
+    }
+
+    RawBitmap_t & operator * () { return stBitmap; }
+    unsigned char * GetRow(int iY) { return stBitmap.stMem + (long long) iY*stBitmap.iWidthBytes; }
+    long long GetBytes() const { return (long long) stBitmap.iWidth*stBitmap.iHeight*3; }
+
+    void CopyFrom(CBenchBitmap & cSource) { memcpy(stBitmap.stMem,cSource.stBitmap.stMem,(size_t) stBitmap.iTotalSize); }
+
+    // FillPattern() -- Gradients with noise in [iLow,iHigh], so filters and resampling do real work
+
+    void FillPattern(int iLow = 0,int iHigh = 255)
+    {
+        unsigned int uiRandom = 12345;
+        for (int iY=0;iY<stBitmap.iHeight;iY++)
+        {
+            unsigned char * sRow = GetRow(iY);
+            for (int iX=0;iX<stBitmap.iWidth*3;iX++)
+            {
+                uiRandom ^= uiRandom << 13; uiRandom ^= uiRandom >> 17; uiRandom ^= uiRandom << 5;
+                int iValue = ((iX/3)*255/stBitmap.iWidth + iY*255/stBitmap.iHeight)/2 + (int) (uiRandom & 31) - 16;
+                iValue = iValue < 0 ? 0 : iValue > 255 ? 255 : iValue;
+                sRow[iX] = (unsigned char) (iLow + iValue*(iHigh - iLow)/255);
+            }
+        }
+    }
+};
+
+// CBenchRunner -- Runs, times and records the benchmarks
+
+class CBenchRunner
+{
+public:
+    enum class Unit { Bytes, Items };
+
+    struct Result_t
+    {
+        std::string     sName;
+        Unit            eUnit;
+        double          fWork;              // Bytes or items per call
+        long long       llCalls;
+        int             iSamples;
+        double          fMeanNs;
+        double          fMinNs;
+        double          fP50Ns;
+        double          fP90Ns;
+        double          fP99Ns;
+        double          fMaxNs;
+        double          fThroughput;        // MB/s (10^6 bytes) or million items/s, from the mean
+    };
+
+private:
+    static constexpr double kMinSampleNs    = 20000;
+    static constexpr int kMinSamples        = 10;
+    static constexpr int kMaxSamples        = 100000;
+
+    double                  m_fMinTimeMs    = 300;
+    std::string             m_sFilter;
+    bool                    m_bList         = false;
+    std::vector<Result_t>   m_vResults;
+
+    static double NowNs()
+    {
+        return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static double Percentile(const std::vector<double> & vSorted,double fPercent)
+    {
+        size_t szIndex = (size_t) std::ceil(fPercent/100.0*vSorted.size());
+        return vSorted[szIndex ? szIndex-1 : 0];
+    }
+
+public:
+    void SetMinTime(double fMs)                 { m_fMinTimeMs = fMs; }
+    void SetFilter(const char * sFilter)        { m_sFilter = sFilter ? sFilter : ""; }
+    void SetList(bool bList)                    { m_bList = bList; }
+    double GetMinTime() const                   { return m_fMinTimeMs; }
+    const std::vector<Result_t> & GetResults() const { return m_vResults; }
+
+    bool isSelected(const char * sName) const { return m_sFilter.empty() || strstr(sName,m_sFilter.c_str()); }
+
+    // Run() -- Time fnRun(), which does fWork bytes or items of work per call
+
+    template <typename _Fn>
+    void Run(const char * sName,Unit eUnit,double fWork,_Fn && fnRun)
+    {
+        if (!isSelected(sName)) return;
+        if (m_bList) { printf("%s\n",sName); return; }
+
+        // Warm up (and size the batches from the warm-up call)
+
+        double fStart = NowNs();
+        fnRun();
+        double fFirstNs = NowNs() - fStart;
+        int iBatch = fFirstNs >= kMinSampleNs ? 1 : (int) (kMinSampleNs/(fFirstNs > 1 ? fFirstNs : 1)) + 1;
+
+        std::vector<double> vSamples;
+        double fEnd = NowNs() + m_fMinTimeMs*1e6;
+        while (((int) vSamples.size() < kMinSamples || NowNs() < fEnd) && (int) vSamples.size() < kMaxSamples)
+        {
+            fStart = NowNs();
+            for (int i=0;i<iBatch;i++) fnRun();
+            vSamples.push_back((NowNs() - fStart)/iBatch);
+        }
+
+        Result_t stResult;
+        stResult.sName      = sName;
+        stResult.eUnit      = eUnit;
+        stResult.fWork      = fWork;
+        stResult.llCalls    = (long long) vSamples.size()*iBatch;
+        stResult.iSamples   = (int) vSamples.size();
+
+        double fTotal = 0;
+        for (double fNs : vSamples) fTotal += fNs;
+        std::sort(vSamples.begin(),vSamples.end());
+        stResult.fMeanNs    = fTotal/vSamples.size();
+        stResult.fMinNs     = vSamples.front();
+        stResult.fP50Ns     = Percentile(vSamples,50);
+        stResult.fP90Ns     = Percentile(vSamples,90);
+        stResult.fP99Ns     = Percentile(vSamples,99);
+        stResult.fMaxNs     = vSamples.back();
+        stResult.fThroughput = fWork/stResult.fMeanNs*1e3;          // work/ns * 1e9 / 1e6
+
+        printf("%-34s %10.3f ms %10.3f ms %10.3f ms %10.1f %s\n",sName,stResult.fP50Ns/1e6,stResult.fP90Ns/1e6,stResult.fP99Ns/1e6,
+               stResult.fThroughput,eUnit == Unit::Bytes ? "MB/s" : "M items/s");
+        fflush(stdout);
+        m_vResults.push_back(stResult);
+    }
+};
+
+// JSON
+
+static void AppendJson(std::string & sOut,const char * sText)
+{
+    sOut += '"';
+    for (const char * s = sText;*s;s++)
+    {
+        if (*s == '"' || *s == '\\') sOut += '\\';
+        if ((unsigned char) *s >= 0x20) sOut += *s;
+    }
+    sOut += '"';
+}
+
+static const char * GetCompiler()
+{
+    static char sCompiler[64];
+#if defined(__clang__)
+    snprintf(sCompiler,sizeof(sCompiler),"Clang %d.%d.%d",__clang_major__,__clang_minor__,__clang_patchlevel__);
+#elif defined(__GNUC__)
+    snprintf(sCompiler,sizeof(sCompiler),"GCC %d.%d.%d",__GNUC__,__GNUC_MINOR__,__GNUC_PATCHLEVEL__);
+#elif defined(_MSC_VER)
+    snprintf(sCompiler,sizeof(sCompiler),"MSVC %d",_MSC_FULL_VER);
+#else
+    snprintf(sCompiler,sizeof(sCompiler),"unknown");
+#endif
+    return sCompiler;
+}
+
+static bool WriteJson(const char * sPath,const CBenchRunner & cRunner)
+{
+    char sBuffer[512];
+    time_t tNow = time(nullptr);
+    char sDate[32];
+    strftime(sDate,sizeof(sDate),"%Y-%m-%dT%H:%M:%SZ",gmtime(&tNow));
+
+    std::string sOut = "{\n  \"suite\": \"SageBench\",\n  \"schema\": 1,\n  \"context\": {\n";
+    snprintf(sBuffer,sizeof(sBuffer),"    \"date\": \"%s\",\n    \"compiler\": \"%s\",\n    \"build_type\": \"%s\",\n"
+             "    \"hardware_threads\": %u,\n    \"min_time_ms\": %.0f\n  },\n  \"benchmarks\": [\n",
+             sDate,GetCompiler(),SAGE_BENCH_BUILD_TYPE,std::thread::hardware_concurrency(),cRunner.GetMinTime());
+    sOut += sBuffer;
+
+    auto & vResults = cRunner.GetResults();
+    for (size_t i=0;i<vResults.size();i++)
+    {
+        auto & stResult = vResults[i];
+        sOut += "    { \"name\": ";
+        AppendJson(sOut,stResult.sName.c_str());
+        snprintf(sBuffer,sizeof(sBuffer),", \"unit\": \"%s\", \"work_per_call\": %.0f, \"calls\": %lld, \"samples\": %d,\n"
+                 "      \"throughput\": %.3f, \"throughput_unit\": \"%s\",\n"
+                 "      \"mean_ns\": %.1f, \"min_ns\": %.1f, \"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f }%s\n",
+                 stResult.eUnit == CBenchRunner::Unit::Bytes ? "bytes" : "items",stResult.fWork,stResult.llCalls,stResult.iSamples,
+                 stResult.fThroughput,stResult.eUnit == CBenchRunner::Unit::Bytes ? "MB/s" : "Mitems/s",
+                 stResult.fMeanNs,stResult.fMinNs,stResult.fP50Ns,stResult.fP90Ns,stResult.fP99Ns,stResult.fMaxNs,
+                 i+1 < vResults.size() ? "," : "");
+        sOut += sBuffer;
+    }
+
+    sOut += "  ],\n  \"not_covered\": [\n";
+    for (size_t i=0;i<sizeof(stNotCovered)/sizeof(stNotCovered[0]);i++)
+    {
+        sOut += "    { \"name\": ";
+        AppendJson(sOut,stNotCovered[i].sName);
+        sOut += ", \"reason\": ";
+        AppendJson(sOut,stNotCovered[i].sReason);
+        sOut += i+1 < sizeof(stNotCovered)/sizeof(stNotCovered[0]) ? " },\n" : " }\n";
+    }
+    sOut += "  ]\n}\n";
+
+    FILE * fp = fopen(sPath,"wb");
+    if (!fp) return false;
+    bool bSuccess = fwrite(sOut.data(),1,sOut.size(),fp) == sOut.size();
+    return fclose(fp) == 0 && bSuccess;
+}
+
+// CompareBaseline() -- Compare p50 with a file written by --json.  Returns the number of regressions, or -1 if the file
+// cannot be read.
+
+static int CompareBaseline(const char * sPath,const CBenchRunner & cRunner,double fTolerance)
+{
+    FILE * fp = fopen(sPath,"rb");
+    if (!fp) return -1;
+    std::string sBaseline;
+    char sBuffer[4096];
+    for (size_t szRead;(szRead = fread(sBuffer,1,sizeof(sBuffer),fp)) > 0;) sBaseline.append(sBuffer,szRead);
+    fclose(fp);
+
+    printf("\n%-34s %12s %12s %9s\n","Baseline comparison (p50)","baseline","now","change");
+    int iRegressions = 0;
+    for (auto & stResult : cRunner.GetResults())
+    {
+        std::string sKey = "\"name\": \"" + stResult.sName + "\"";
+        size_t szName = sBaseline.find(sKey);
+        size_t szP50 = szName == std::string::npos ? std::string::npos : sBaseline.find("\"p50_ns\":",szName);
+        size_t szNext = szName == std::string::npos ? std::string::npos : sBaseline.find("\"name\":",szName + sKey.size());
+        if (szP50 == std::string::npos || (szNext != std::string::npos && szP50 > szNext))
+        {
+            printf("%-34s %12s %10.3f ms\n",stResult.sName.c_str(),"(new)",stResult.fP50Ns/1e6);
+            continue;
+        }
+
+        double fBaseNs = atof(sBaseline.c_str() + szP50 + 9);
+        double fChange = fBaseNs > 0 ? (stResult.fP50Ns/fBaseNs - 1.0)*100.0 : 0;
+        bool bRegression = fChange > fTolerance;
+        iRegressions += bRegression;
+        printf("%-34s %10.3f ms %10.3f ms %+8.1f%%%s\n",stResult.sName.c_str(),fBaseNs/1e6,stResult.fP50Ns/1e6,fChange,
+               bRegression ? "  REGRESSION" : "");
+    }
+    return iRegressions;
+}
+
+// isSorted() -- Check a sort's output against std::sort's
+
+// CTextSink -- CFormatCache sink that keeps the text and counts the markup passed through
+
+struct CTextSink
+{
+    std::string sText;
+    int iMarkups = 0;
+    void Text(const char * sRun,int iLength,const FormatStyle_t &) { sText.append(sRun,iLength); }
+    void Markup(const char *,int) { iMarkups++; }
+};
+
+static bool isSorted(const int * iValues,const std::vector<int> & vExpected)
+{
+    return !memcmp(iValues,vExpected.data(),vExpected.size()*sizeof(int));
+}
+
+int main(int argc,char * argv[])
+{
+    int iErrors = 0;
+    CBenchRunner cRunner;
+    const char * sJsonPath      = nullptr;
+    const char * sBaselinePath  = nullptr;
+    double fTolerance           = 10;
+
+    for (int i=1;i<argc;i++)
+    {
+        const char * sArg = argv[i];
+        const char * sValue = i+1 < argc ? argv[i+1] : nullptr;
+        if (!strcmp(sArg,"--json") && sValue)               { sJsonPath = sValue; i++; }
+        else if (!strcmp(sArg,"--baseline") && sValue)      { sBaselinePath = sValue; i++; }
+        else if (!strcmp(sArg,"--tolerance") && sValue)     { fTolerance = atof(sValue); i++; }
+        else if (!strcmp(sArg,"--filter") && sValue)        { cRunner.SetFilter(sValue); i++; }
+        else if (!strcmp(sArg,"--min-time") && sValue)      { cRunner.SetMinTime(atof(sValue)); i++; }
+        else if (!strcmp(sArg,"--quick"))                   cRunner.SetMinTime(20);
+        else if (!strcmp(sArg,"--list"))                    cRunner.SetList(true);
+        else
+        {
+            printf("Usage: SageBench [--json file] [--baseline file [--tolerance percent]] [--filter text] [--min-time ms] [--quick] [--list]\n");
+            return 1;
+        }
+    }
+
+    printf("%-34s %13s %13s %13s %15s\n","Benchmark","p50","p90","p99","throughput");
+
+    // ---- image/ ----
+
+    CBenchBitmap cSource(kImageWidth,kImageHeight);
+    cSource.FillPattern();
+    CBenchBitmap cWork(kImageWidth,kImageHeight);
+    CBenchBitmap cTemp(kImageWidth,kImageHeight);
+    CBenchBitmap cSmall(1280,720);
+    CBenchBitmap cSmallSource(640,360);
+    cSmallSource.FillPattern();
+    std::vector<unsigned char> vMask((size_t) kImageWidth*kImageHeight);
+
+    double fImageBytes = (double) cSource.GetBytes();
+    auto mDown = WarpMatrix_t::Scale(1280.0/kImageWidth,720.0/kImageHeight);
+    auto mUp   = WarpMatrix_t::Scale((double) kImageWidth/640,(double) kImageHeight/360);
+    auto mRotate = WarpMatrix_t::Rotate(15,kImageWidth/2.0,kImageHeight/2.0);
+
+    cRunner.Run("image/resize_bilinear_down",CBenchRunner::Unit::Bytes,fImageBytes,
+                [&] { CWarp::Warp(*cSource,*cSmall,mDown,WarpSample::Bilinear); });
+    cRunner.Run("image/resize_bicubic_down",CBenchRunner::Unit::Bytes,fImageBytes,
+                [&] { CWarp::Warp(*cSource,*cSmall,mDown,WarpSample::Bicubic); });
+    cRunner.Run("image/resize_bilinear_up",CBenchRunner::Unit::Bytes,fImageBytes,
+                [&] { CWarp::Warp(*cSmallSource,*cWork,mUp,WarpSample::Bilinear); });
+    cRunner.Run("image/rotate_bilinear_mask",CBenchRunner::Unit::Bytes,fImageBytes,
+                [&] { CWarp::Warp(*cSource,*cWork,mRotate,WarpSample::Bilinear,nullptr,vMask.data()); });
+
+    if (cRunner.isSelected("image/"))
+    {
+        // A flat source resizes to the same flat color; the rotation's mask covers the center and not the corners
+
+        CBenchBitmap cFlat(640,360);
+        memset((*cFlat).stMem,77,(size_t) (*cFlat).iTotalSize);
+        CWarp::Warp(*cFlat,*cWork,mUp,WarpSample::Bicubic);
+        if (cWork.GetRow(kImageHeight/2)[kImageWidth*3/2] != 77) { printf("Resize of a flat bitmap is not flat\n"); iErrors++; }
+
+        CWarp::Warp(*cSource,*cWork,mRotate,WarpSample::Bilinear,nullptr,vMask.data());
+        if (!vMask[(size_t) kImageWidth*(kImageHeight/2) + kImageWidth/2] || vMask[0]) { printf("Rotation mask is wrong\n"); iErrors++; }
+    }
+
+    cRunner.Run("image/box_blur_r8",CBenchRunner::Unit::Bytes,fImageBytes,
+                [&] { CFastFilters::BoxBlur(*cSource,*cWork,8); });
+    cRunner.Run("image/box_blur_3pass_r4",CBenchRunner::Unit::Bytes,fImageBytes,[&]
+    {
+        // Three box passes (close to a Gaussian with sigma ~ 4.9, but this is not a Gaussian filter)
+
+        CFastFilters::BoxBlur(*cSource,*cWork,4);
+        CFastFilters::BoxBlur(*cWork,*cTemp,4);
+        CFastFilters::BoxBlur(*cTemp,*cWork,4);
+    });
+    cRunner.Run("image/median_r2",CBenchRunner::Unit::Bytes,fImageBytes,
+                [&] { CFastFilters::Median(*cSource,*cWork,2); });
+
+    if (cRunner.isSelected("image/"))
+    {
+        // A blur of the noisy pattern must be smoother than the pattern (less change between neighbours)
+
+        auto fnRoughness = [](CBenchBitmap & cBitmap)
+        {
+            long long llSum = 0;
+            unsigned char * sRow = cBitmap.GetRow(kImageHeight/2);
+            for (int iX=3;iX<kImageWidth*3;iX++) llSum += std::abs(sRow[iX] - sRow[iX-3]);
+            return llSum;
+        };
+        CFastFilters::BoxBlur(*cSource,*cWork,8);
+        if (fnRoughness(cWork)*4 > fnRoughness(cSource)) { printf("Box blur did not smooth the image\n"); iErrors++; }
+    }
+
+    CBenchBitmap cLowContrast(kImageWidth,kImageHeight);
+    cLowContrast.FillPattern(64,191);
+    CBitmapStats cStats;
+    cRunner.Run("image/bitmapstats_autolevel",CBenchRunner::Unit::Bytes,fImageBytes,[&]
+    {
+        cWork.CopyFrom(cLowContrast);           // Included in the time: normalizing an already normalized bitmap does nothing
+        cStats.Build(*cWork);
+        cStats.AutoLevel(*cWork);
+    });
+    if (cRunner.isSelected("image/"))
+    {
+        cStats.Build(*cWork);
+        if (cStats.GetMin(StatChannel::Luminance) > 2 || cStats.GetMax(StatChannel::Luminance) < 253)
+        {
+            printf("Auto-level range is %d..%d\n",cStats.GetMin(StatChannel::Luminance),cStats.GetMax(StatChannel::Luminance));
+            iErrors++;
+        }
+    }
+
+    // ---- mem/ ----
+    //
+    // Items are read with operator() -- the checked operator[] throws std::exception(const char *), which only MSVC has.
+    // The 16MB fills and clears are past MemTools::kStreamThreshold, so the Mem Fast versions and the MemP fill with
+    // bStream use non-temporal stores; MemP Fill() and ClearMem() without it use normal (cached) stores.
+
+    constexpr long long kMemBytes = 16*1024*1024;
+    Mem<unsigned int> mMemDwords((int) (kMemBytes/4));
+    Mem<unsigned char> mMemBytes((int) kMemBytes);
+    Mem<unsigned char> mMemBytesCopy;
+    mMemBytes.ClearMem(1);
+
+    cRunner.Run("mem/mem_fill_dword",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mMemDwords.Fill(0x00FF8040); });
+    cRunner.Run("mem/mem_fillfast_dword",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mMemDwords.FillFast(0x00408040); });
+    cRunner.Run("mem/mem_clear",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mMemBytes.ClearMem(0x3C); });
+    cRunner.Run("mem/mem_clearfast",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mMemBytes.ClearMemFast(0x5A); });
+    cRunner.Run("mem/mem_copy",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mMemBytesCopy.copyFrom(mMemBytes); });   // Mem::copyFrom() reallocates
+
+    if (cRunner.isSelected("mem/mem_"))
+    {
+        mMemDwords.Fill(0x00FF8040);
+        bool bFill = mMemDwords(0) == 0x00FF8040 && mMemDwords((int) (kMemBytes/4-1)) == 0x00FF8040;
+        mMemDwords.FillFast(0x00408040);
+        bool bFillFast = mMemDwords(1) == 0x00408040 && mMemDwords((int) (kMemBytes/4-1)) == 0x00408040;
+        mMemBytes.ClearMemFast(0x5A);
+        mMemBytesCopy.copyFrom(mMemBytes);
+        bool bCopy = mMemBytesCopy.iSize == (int) kMemBytes && mMemBytesCopy(0) == 0x5A && mMemBytesCopy((int) kMemBytes-1) == 0x5A;
+        if (!bFill || !bFillFast || !bCopy) { printf("Mem Fill(), FillFast(), ClearMemFast() or copyFrom() gave the wrong values\n"); iErrors++; }
+    }
+
+    MemP<unsigned int> mDwords(kMemBytes/4);
+    MemP<unsigned char> mBytes(kMemBytes);
+    MemP<unsigned char> mBytesCopy(kMemBytes);
+    mBytes.ClearMem(1);
+
+    cRunner.Run("mem/memp_fill_dword",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mDwords.Fill(0x00FF8040); });
+    cRunner.Run("mem/memp_fillstream_dword",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mDwords.Fill(0x00408040,true); });
+    cRunner.Run("mem/memp_clear",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mBytes.ClearMem(0x5A); });
+    cRunner.Run("mem/memp_copy",CBenchRunner::Unit::Bytes,(double) kMemBytes,[&] { mBytesCopy.copyFrom(mBytes); });
+    cRunner.Run("mem/memp_alloc_free_4k",CBenchRunner::Unit::Items,1000,[&]
+    {
+        for (int i=0;i<1000;i++)
+        {
+            MemP<int> mItems(1024);
+            mItems(i & 1023) = i;
+        }
+    });
+
+    bool bStreamFill = true;
+    if (cRunner.isSelected("mem/memp_"))
+    {
+        mDwords.Fill(0x00408040,true);
+        bStreamFill = mDwords(0) == 0x00408040 && mDwords(kMemBytes/4-1) == 0x00408040;
+        mDwords.Fill(0x00FF8040);
+    }
+    if (cRunner.isSelected("mem/memp_") && (!bStreamFill || mDwords(kMemBytes/4-1) != 0x00FF8040 || mBytesCopy(kMemBytes-1) != 0x5A || mBytesCopy(0) != 0x5A))
+    {
+        printf("MemP fill, clear or copy gave the wrong values\n");
+        iErrors++;
+    }
+
+    // ---- string/ ----
+
+    std::vector<long long> vIntegers(kStringItems);
+    std::vector<double> vDoubles(kStringItems);
+    for (int i=0;i<kStringItems;i++)
+    {
+        vIntegers[i] = (long long) (i*2654435761u % 2000000000u) - 1000000000;
+        vDoubles[i] = vIntegers[i]/1024.0 + i/7.0;
+    }
+
+    char sText[256];
+    volatile size_t szSink = 0;
+
+    cRunner.Run("string/int_to_text",CBenchRunner::Unit::Items,kStringItems,[&]
+    {
+        size_t szTotal = 0;
+        for (long long llValue : vIntegers) szTotal += CNumFormat::IntToText(sText,llValue);
+        szSink = szTotal;
+    });
+    cRunner.Run("string/ref_int_snprintf",CBenchRunner::Unit::Items,kStringItems,[&]
+    {
+        size_t szTotal = 0;
+        for (long long llValue : vIntegers) szTotal += snprintf(sText,sizeof(sText),"%lld",llValue);
+        szSink = szTotal;
+    });
+    cRunner.Run("string/double_shortest",CBenchRunner::Unit::Items,kStringItems,[&]
+    {
+        size_t szTotal = 0;
+        for (double fValue : vDoubles) szTotal += CNumFormat::Shortest(sText,fValue);
+        szSink = szTotal;
+    });
+    cRunner.Run("string/ref_double_snprintf_g17",CBenchRunner::Unit::Items,kStringItems,[&]
+    {
+        size_t szTotal = 0;
+        for (double fValue : vDoubles) szTotal += snprintf(sText,sizeof(sText),"%.17g",fValue);
+        szSink = szTotal;
+    });
+
+    std::string sFormatted;
+    cRunner.Run("string/format_cache_sprintf",CBenchRunner::Unit::Items,kStringItems/10,[&]
+    {
+        for (int i=0;i<kStringItems/10;i++)
+        {
+            sFormatted.clear();                 // Sprintf() appends
+            CFormatCache::Sprintf(sFormatted,"Item %d of %d: %.3f (%s)",i,kStringItems,vDoubles[i],"ok");
+        }
+    });
+    cRunner.Run("string/ref_snprintf",CBenchRunner::Unit::Items,kStringItems/10,[&]
+    {
+        for (int i=0;i<kStringItems/10;i++) snprintf(sText,sizeof(sText),"Item %d of %d: %.3f (%s)",i,kStringItems,vDoubles[i],"ok");
+    });
+
+    CStrC csText;
+    cRunner.Run("string/compact_string_build",CBenchRunner::Unit::Items,kStringItems/10,[&]
+    {
+        for (int i=0;i<kStringItems/10;i++) csText >> "Item " << i << " of " << kStringItems << ": " << vDoubles[i];
+    });
+
+    if (cRunner.isSelected("string/"))
+    {
+        sFormatted.clear();
+        CFormatCache::Sprintf(sFormatted,"Item %d of %d: %.3f (%s)",12,kStringItems,2.5,"ok");
+        if (sFormatted != "Item 12 of 100000: 2.500 (ok)") { printf("Sprintf gave \"%s\"\n",sFormatted.c_str()); iErrors++; }
+
+        // A format buffer changed in place is recompiled after Forget()
+
+        char sBuffer[32];
+        for (int i=0;i<2;i++)
+        {
+            strcpy(sBuffer,i ? "B=%d" : "A=%d");
+            CFormatCache::Forget(sBuffer);
+            sFormatted.clear();
+            CFormatCache::Sprintf(sFormatted,sBuffer,i);
+            if (sFormatted != (i ? "B=1" : "A=0")) { printf("Reused format buffer gave \"%s\"\n",sFormatted.c_str()); iErrors++; }
+        }
+
+        // Arguments are plain text, both when compiled and after an unsupported conversion (%C, formatted by vsnprintf())
+
+        CTextSink cSink;
+        CFormatCache::Printf(cSink,"%s{g}x{/} %C {r}%s",(const char *) "{b}arg",(wint_t) 'Z',(const char *) "{/}");
+        if (cSink.sText != "{b}argx Z {r}{/}" || cSink.iMarkups) { printf("Printf gave \"%s\" with %d markups\n",cSink.sText.c_str(),cSink.iMarkups); iErrors++; }
+        csText >> "Item " << 12 << " of " << 3;
+        if (strcmp(csText.c_str(),"Item 12 of 3")) { printf("CCompactString gave \"%s\"\n",csText.c_str()); iErrors++; }
+
+        double fValue;
+        int iLength = CNumFormat::Shortest(sText,vDoubles[1234]);
+        sText[iLength] = 0;
+        if (!CNumFormat::ParseDouble(sText,fValue) || fValue != vDoubles[1234]) { printf("Shortest(%.17g) gave \"%s\"\n",vDoubles[1234],sText); iErrors++; }
+    }
+
+    // ---- sort/ ----
+
+    std::vector<int> vUnsorted(kSortItems);
+    unsigned int uiRandom = 2463534242u;
+    for (auto & iValue : vUnsorted)
+    {
+        uiRandom ^= uiRandom << 13; uiRandom ^= uiRandom >> 17; uiRandom ^= uiRandom << 5;
+        iValue = (int) (uiRandom % 1000000);
+    }
+    std::vector<int> vSorted(vUnsorted);
+    std::sort(vSorted.begin(),vSorted.end());
+    std::vector<int> vSortedSmall(vUnsorted.begin(),vUnsorted.begin() + kSelectionItems);
+    std::sort(vSortedSmall.begin(),vSortedSmall.end());
+
+    std::vector<int> vWork(kSortItems);
+    CQuickSort      cQuickSort;
+    CMergeSort      cMergeSort;
+    CHeapSort       cHeapSort;
+    CShellSort      cShellSort;
+    CSelectionSort  cSelectionSort;
+
+    struct Sort_t
+    {
+        const char                * sName;
+        int                         iItems;
+        std::function<void(int *)>  fnSort;
+    };
+
+    Sort_t stSorts[] =
+    {
+        { "sort/quick_100k",        kSortItems,         [&](int * iData) { cQuickSort.QuickSort(iData,0,kSortItems-1); }           },
+        { "sort/merge_100k",        kSortItems,         [&](int * iData) { cMergeSort.MergeSort(iData,0,kSortItems-1); }           },
+        { "sort/heap_100k",         kSortItems,         [&](int * iData) { cHeapSort.HeapSort(iData,kSortItems); }                 },
+        { "sort/shell_100k",        kSortItems,         [&](int * iData) { cShellSort.ShellSort(iData,kSortItems); }               },
+        { "sort/selection_5k",      kSelectionItems,    [&](int * iData) { cSelectionSort.SelectionSort(iData,kSelectionItems); }  },
+        { "sort/ref_std_sort_100k", kSortItems,         [&](int * iData) { std::sort(iData,iData + kSortItems); }                  },
+    };
+
+    for (auto & stSort : stSorts)
+    {
+        // Each call sorts a fresh copy of the input (the copy is ~0.1% of the time)
+
+        cRunner.Run(stSort.sName,CBenchRunner::Unit::Items,stSort.iItems,[&]
+        {
+            memcpy(vWork.data(),vUnsorted.data(),stSort.iItems*sizeof(int));
+            stSort.fnSort(vWork.data());
+        });
+
+        if (cRunner.isSelected(stSort.sName) && !isSorted(vWork.data(),stSort.iItems == kSortItems ? vSorted : vSortedSmall))
+        {
+            printf("%s did not sort\n",stSort.sName);
+            iErrors++;
+        }
+    }
+
+    if (sJsonPath && !WriteJson(sJsonPath,cRunner)) { printf("Could not write %s\n",sJsonPath); iErrors++; }
+    if (sBaselinePath)
+    {
+        int iRegressions = CompareBaseline(sBaselinePath,cRunner,fTolerance);
+        if (iRegressions < 0) { printf("Could not read %s\n",sBaselinePath); iErrors++; }
+        else if (iRegressions) { printf("%d regressions (more than %.0f%% slower)\n",iRegressions,fTolerance); iErrors += iRegressions; }
+    }
+
+    printf("\n%s (%d errors)   [%zu]\n",iErrors ? "FAILED" : "Passed",iErrors,(size_t) szSink);
+    return iErrors ? 1 : 0;
+}
@@ -0,0 +1,152 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// ScrollbackBench -- CScrollback append cost, memory under a line cap, and lock-free writes from several threads
+//
+//      Append      -- 2,000,000 lines with a 100,000-line cap.  The time per line and the memory used should be the same
+//                     for the last 100k lines as for the first 100k (the cost must not grow with the history).
+//      Markup      -- Write() with color markup is split into the expected spans.
+//      Threads     -- 4 threads printf() 250,000 lines each while this thread drains.  Every line must arrive once, and
+//                     each thread's lines in the order written.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include "CScrollback.h"
+
+using namespace Sage;
+
+static constexpr int kNumLines      = 2000000;
+static constexpr int kMaxLines      = 100000;
+static constexpr int kNumThreads    = 4;
+static constexpr int kThreadLines   = 250000;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+static std::string GetText(const CScrollback & cStore,uint64_t ullLine)
+{
+    CScrollback::Line_t stLine;
+    return cStore.GetLine(ullLine,stLine) ? std::string(stLine.sText,stLine.iLength) : std::string("<none>");
+}
+
+int main()
+{
+    int iErrors = 0;
+
+    // Append -- time each block of kMaxLines lines
+
+    CScrollback cStore;
+    cStore.SetMaxLines(kMaxLines);
+
+    FormatStyle_t stRed;
+    stRed.dwFgColor = RGB(255,0,0);
+    stRed.bFgColor  = true;
+
+    char sLine[128];
+    double fFirstBlockMs = 0,fLastBlockMs = 0;
+    size_t szFirstMemory = 0;
+    auto tStart = std::chrono::steady_clock::now();
+    auto tBlock = tStart;
+
+    for (int i=0;i<kNumLines;i++)
+    {
+        int iLength = snprintf(sLine,sizeof(sLine),"[%07d] worker %d: processed batch of %d records\n",i,i % 16,i % 1000);
+        cStore.Append(sLine,10);
+        cStore.Append(sLine+10,iLength-10,stRed);
+
+        if ((i+1) % kMaxLines == 0)
+        {
+            double fMs = ElapsedMs(tBlock);
+            if (i+1 == kMaxLines) { fFirstBlockMs = fMs; szFirstMemory = cStore.GetMemoryUsed(); }
+            fLastBlockMs = fMs;
+            tBlock = std::chrono::steady_clock::now();
+        }
+    }
+    double fTotalMs = ElapsedMs(tStart);
+
+    uint64_t ullLast = cStore.GetEndLine()-2;           // The last complete line (the open line is empty)
+    snprintf(sLine,sizeof(sLine),"[%07d] worker %d: processed batch of %d records",kNumLines-1,(kNumLines-1) % 16,(kNumLines-1) % 1000);
+    if (GetText(cStore,ullLast) != sLine) { printf("Last line is \"%s\"\n",GetText(cStore,ullLast).c_str()); iErrors++; }
+    if (cStore.GetLineCount() < (uint64_t) kMaxLines || cStore.GetLineCount() >= (uint64_t) kMaxLines + CScrollback::kLinesPerChunk + 1)
+    {
+        printf("Line count %llu is outside the cap\n",(unsigned long long) cStore.GetLineCount());
+        iErrors++;
+    }
+    snprintf(sLine,sizeof(sLine),"[%07llu]",(unsigned long long) cStore.GetFirstLine());
+    if (GetText(cStore,cStore.GetFirstLine()).compare(0,9,sLine)) { printf("First line numbering is wrong\n"); iErrors++; }
+
+    CScrollback::Line_t stLine;
+    if (!cStore.GetLine(ullLast,stLine) || stLine.iNumSpans != 2 || stLine.stSpans[1].iStart != 10 || !stLine.stSpans[1].stStyle.bFgColor)
+    {
+        printf("Spans of the last line are wrong\n");
+        iErrors++;
+    }
+
+    // Markup
+
+    CScrollback cMarkup;
+    cMarkup.Write("plain {red}red {bg=blue}on blue{/} red{/} plain {x=40}still plain{/}\n");
+    cMarkup.printf("%d {g}%s{/}\n",42,"green");
+    cMarkup.Drain();
+
+    if (!cMarkup.GetLine(0,stLine) || std::string(stLine.sText,stLine.iLength) != "plain red on blue red plain still plain" || stLine.iNumSpans != 5 ||
+        stLine.stSpans[2].iStart != 10 || !stLine.stSpans[2].stStyle.bBgColor || stLine.stSpans[4].stStyle.bFgColor)
+    {
+        printf("Write() markup: \"%s\" (%d spans)\n",GetText(cMarkup,0).c_str(),stLine.iNumSpans);
+        iErrors++;
+    }
+    if (!cMarkup.GetLine(1,stLine) || std::string(stLine.sText,stLine.iLength) != "42 green" || stLine.iNumSpans != 2 || !stLine.stSpans[1].stStyle.bFgColor)
+    {
+        printf("printf() markup: \"%s\" (%d spans)\n",GetText(cMarkup,1).c_str(),stLine.iNumSpans);
+        iErrors++;
+    }
+
+    // Threads
+
+    CScrollback cShared;
+    cShared.SetMaxLines(kNumThreads*kThreadLines + 1000);
+    std::atomic<int> iDone{0};
+    std::vector<std::thread> vThreads;
+
+    tStart = std::chrono::steady_clock::now();
+    for (int t=0;t<kNumThreads;t++)
+        vThreads.emplace_back([&,t]
+        {
+            for (int i=0;i<kThreadLines;i++) cShared.printf("T%d {g}%d{/}\n",t,i);
+            iDone++;
+        });
+
+    int iDrains = 0;
+    while (iDone < kNumThreads || cShared.isPending())
+    {
+        if (cShared.Drain()) iDrains++;
+        else std::this_thread::yield();
+    }
+    for (auto & cThread : vThreads) cThread.join();
+    double fThreadMs = ElapsedMs(tStart);
+
+    std::vector<int> vNext(kNumThreads,0);
+    int iBad = 0;
+    for (uint64_t ullLine = cShared.GetFirstLine();ullLine+1 < cShared.GetEndLine();ullLine++)
+    {
+        int iThread = -1,iValue = -1;
+        if (sscanf(GetText(cShared,ullLine).c_str(),"T%d %d",&iThread,&iValue) != 2 || iThread < 0 || iThread >= kNumThreads ||
+            iValue != vNext[iThread]++)
+            if (iBad++ < 5) printf("Line %llu: \"%s\"\n",(unsigned long long) ullLine,GetText(cShared,ullLine).c_str());
+    }
+    for (int t=0;t<kNumThreads;t++) if (vNext[t] != kThreadLines) iBad++;
+    if (iBad) { printf("%d lines lost, duplicated or out of order\n",iBad); iErrors++; }
+
+    printf("%-40s %10.1f ns/line\n","Append (2M lines, 100k cap)",fTotalMs*1e6/kNumLines);
+    printf("%-40s %10.1f ms / %.1f ms\n","First / last 100k lines",fFirstBlockMs,fLastBlockMs);
+    printf("%-40s %10.1f MB / %.1f MB\n","Memory after first 100k / after 2M",szFirstMemory/(1024.0*1024.0),cStore.GetMemoryUsed()/(1024.0*1024.0));
+    printf("%-40s %10.1f ns/line  (%d drains)\n","4 threads printf() + drain",fThreadMs*1e6/(kNumThreads*kThreadLines),iDrains);
+
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
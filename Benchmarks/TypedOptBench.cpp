@@ -0,0 +1,94 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// TypedOptBench -- OptSet_t / topt:: compile-time construction, typed read-back, and run-time merge cost
+//
+//      Compile     -- static_assert()s that a full option set is built at compile time, that the right-most value wins,
+//                     and that the typed accessors read it back in constant expressions.  OptSet_t must still convert to
+//                     cwfOpt for the library functions that take one (checked without calling it, since cwfOpt is in the library).
+//      ReadBack    -- Color names, string defaults, SetFlag(false), and Merge() of every option type at run time.
+//      Merge       -- Time to build a 6-option set at run time from non-constant values.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include "SageTypedOpt.h"
+
+using namespace Sage;
+
+static constexpr int kMergeCount = 10000000;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+// Compile
+
+static constexpr auto kButtonOpt = topt::fgColor(RGB(255,0,0)) | topt::Font("Arial,15") | topt::Transparent(128)
+                                 | topt::MinMax(-5,5) | topt::Default(.25) | topt::Checked() | topt::fgColor("Green");
+
+static constexpr DWORD GetColorOr(const OptSet_t & stOpt,OptKey eKey,DWORD dwDefault)
+{
+    DWORD dwColor = dwDefault;
+    return stOpt.GetColor(eKey,dwColor) ? dwColor : dwDefault;
+}
+
+static_assert(kButtonOpt.isSet(OptKey::FgColor) && kButtonOpt.isSet(OptKey::Font) && kButtonOpt.isSet(OptKey::Transparent),"Options not set");
+static_assert(!kButtonOpt.isSet(OptKey::BgColor) && !kButtonOpt.isSet(OptKey::Hidden),"Options set that were not given");
+static_assert(GetColorOr(kButtonOpt,OptKey::FgColor,1) == 1,"Right-most fgColor (a name) must replace the value");
+static_assert(GetColorOr(topt::fgColor(0) | topt::bgColor(RGB(1,2,3)),OptKey::BgColor,0) == RGB(1,2,3),"Color value not read back");
+static_assert(kButtonOpt.GetInt(OptKey::Blend) == 128 && kButtonOpt.GetInt(OptKey::PadX,-1) == -1,"Int options");
+static_assert(kButtonOpt.GetDefaultFloat() == .25 && kButtonOpt.GetChecked(),"Default() / Checked()");
+static_assert(OptSet_t().isEmpty() && !topt::Hidden().isEmpty(),"isEmpty()");
+static_assert(std::is_convertible<OptSet_t,cwfOpt>::value,"OptSet_t must still convert to cwfOpt for the library functions");
+
+int main()
+{
+    int iErrors = 0;
+
+    // ReadBack
+
+    const char * sName = kButtonOpt.GetColorName(OptKey::FgColor);
+    if (!sName || strcmp(sName,"Green")) { printf("fgColor name is \"%s\"\n",sName ? sName : "(null)"); iErrors++; }
+    if (strcmp(kButtonOpt.GetString(OptKey::Font,""),"Arial,15")) { printf("Font was not read back\n"); iErrors++; }
+    if (strcmp(kButtonOpt.GetString(OptKey::Title,"none"),"none")) { printf("Unset string did not return the default\n"); iErrors++; }
+
+    double fMin = 0,fMax = 0;
+    if (!kButtonOpt.GetMinMax(fMin,fMax) || fMin != -5 || fMax != 5) { printf("MinMax() is %g,%g\n",fMin,fMax); iErrors++; }
+
+    OptSet_t stOpt = topt::Hidden() | topt::Border();
+    stOpt.SetFlag(OptKey::Hidden,false);
+    if (stOpt.isSet(OptKey::Hidden) || !stOpt.isSet(OptKey::Border)) { printf("SetFlag(false) failed\n"); iErrors++; }
+
+    stOpt |= topt::Label("Speed") | topt::Width(200) | topt::bgColor("Black") | topt::Default(7);
+    stOpt |= topt::Width(300);
+    if (stOpt.GetInt(OptKey::Width) != 300 || stOpt.GetInt(OptKey::DefaultInt) != 7 || strcmp(stOpt.GetString(OptKey::Label),"Speed")
+        || strcmp(stOpt.GetColorName(OptKey::BgColor),"Black") || !stOpt.isSet(OptKey::Border))
+    {
+        printf("Run-time Merge() lost an option\n");
+        iErrors++;
+    }
+
+    printf("ReadBack    typed accessors: %s\n",iErrors ? "errors" : "ok");
+
+    // Merge -- values come from a volatile so the set cannot be folded at compile time
+
+    volatile int iSeed = 1;
+    unsigned long long ullCheck = 0;
+    auto tStart = std::chrono::steady_clock::now();
+
+    for (int i=0;i<kMergeCount;i++)
+    {
+        int iValue = iSeed + i;
+        auto stSet = topt::fgColor((DWORD) iValue) | topt::Font("Arial,15") | topt::Width(iValue) | topt::PadX(iValue & 7)
+                   | topt::Transparent() | topt::MinMax(0,iValue);
+        ullCheck += (unsigned long long) stSet.GetInt(OptKey::Width) + stSet.uiSet;
+    }
+    double fMs = ElapsedMs(tStart);
+    printf("Merge       %d 6-option sets: %.1f ms (%.1f ns per set, check %llu)\n",kMergeCount,fMs,fMs*1e6/kMergeCount,ullCheck & 0xFFFF);
+
+    printf("\n%s (%d errors)\n",iErrors ? "FAILED" : "Passed",iErrors);
+    return iErrors ? 1 : 0;
+}
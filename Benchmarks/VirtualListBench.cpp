@@ -0,0 +1,177 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// VirtualListBench -- Appending, scrolling and searching 500,000 log lines in a CVirtualListModel
+//
+// CVirtualListBox draws from a CVirtualListModel, so the costs of a huge list are the model's costs:
+//
+//      Append      -- adding 500,000 lines to the column store (the native list box needs a message and allocation per item)
+//      Scroll      -- fetching one page (40 rows) at random top rows, which is all a paint asks for
+//      Type-ahead  -- FindPrefix() through the sorted index vs. a linear scan of every row
+//      Find        -- FindText() substring scan
+//
+// Type-ahead results are checked against the linear scan (including 1- and 2-character prefixes that match most rows), and
+// the same lines are also served through a callback model.
+//
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "CVirtualListModel.h"
+
+using namespace Sage;
+
+static constexpr int kNumLines      = 500000;
+static constexpr int kPageRows      = 40;
+static constexpr int kNumSearches   = 2000;
+
+static const char * sLevels[]   = { "INFO", "WARN", "ERROR", "DEBUG", "TRACE" };
+static const char * sModules[]  = { "Render", "Network", "Storage", "Audio", "Input", "Physics", "Scheduler", "Loader" };
+
+static double ElapsedMs(std::chrono::steady_clock::time_point tStart)
+{
+    return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+}
+
+static std::vector<std::string> MakeLines()
+{
+    std::mt19937 cRand(1234);
+    std::vector<std::string> vLines(kNumLines);
+    char sLine[160];
+    for (int i=0;i<kNumLines;i++)
+    {
+        snprintf(sLine,sizeof(sLine),"%s %s: request %u finished in %u us (queue %u, worker %u) line %d",
+                sModules[cRand() % 8],sLevels[cRand() % 5],(unsigned) cRand(),(unsigned) (cRand() % 100000),(unsigned) (cRand() % 64),(unsigned) (cRand() % 16),i);
+        vLines[i] = sLine;
+    }
+    return vLines;
+}
+
+// LinearPrefix() -- Type-ahead the way a plain list does it: scan from iStart (wrapping) for the first match
+
+static int LinearPrefix(const CVirtualListModel & cModel,const char * sPrefix,int iStart)
+{
+    int iCount = cModel.GetCount();
+    int iLength = (int) strlen(sPrefix);
+    std::string sScratch;
+    for (int i=0;i<iCount;i++)
+    {
+        int iRow = (iStart + i) % iCount;
+        const char * s = cModel.GetItem(iRow,sScratch);
+        int j = 0;
+        while (j < iLength && s[j] && tolower((unsigned char) s[j]) == tolower((unsigned char) sPrefix[j])) j++;
+        if (j == iLength) return iRow;
+    }
+    return -1;
+}
+
+int main()
+{
+    int iErrors = 0;
+    auto vLines = MakeLines();
+
+    std::vector<const char *> vPointers(kNumLines);
+    size_t szTextBytes = 0;
+    for (int i=0;i<kNumLines;i++) { vPointers[i] = vLines[i].c_str(); szTextBytes += vLines[i].size(); }
+
+    printf("%d log lines, %.1f MB of text\n\n",kNumLines,szTextBytes/(1024.0*1024.0));
+
+    // Append
+
+    CVirtualListModel cModel;
+    auto tStart = std::chrono::steady_clock::now();
+    cModel.AppendItems(vPointers.data(),kNumLines);
+    double fAppendMs = ElapsedMs(tStart);
+
+    tStart = std::chrono::steady_clock::now();
+    cModel.BuildIndex();
+    double fIndexMs = ElapsedMs(tStart);
+
+    if (cModel.GetCount() != kNumLines) { printf("Count is %d\n",cModel.GetCount()); iErrors++; }
+    for (int i=0;i<kNumLines;i += 997)
+    {
+        std::string sScratch;
+        if (strcmp(cModel.GetItem(i,sScratch),vPointers[i]) && iErrors++ < 10) printf("Row %d differs\n",i);
+    }
+
+    // Scroll -- one page per paint, at random positions
+
+    std::mt19937 cRand(42);
+    int iPages = 20000;
+    size_t szChecksum = 0;
+    tStart = std::chrono::steady_clock::now();
+    for (int i=0;i<iPages;i++)
+    {
+        int iTop = cRand() % (kNumLines - kPageRows);
+        std::string sScratch;
+        for (int j=0;j<kPageRows;j++) szChecksum += strlen(cModel.GetItem(iTop+j,sScratch));
+    }
+    double fPageUs = ElapsedMs(tStart)*1000.0/iPages;
+
+    // Type-ahead -- prefixes of random rows, from random start rows
+
+    std::vector<std::string> vPrefixes(kNumSearches);
+    std::vector<int> vStarts(kNumSearches);
+    for (int i=0;i<kNumSearches;i++)
+    {
+        const std::string & sLine = vLines[cRand() % kNumLines];
+        vPrefixes[i] = sLine.substr(0,1 + cRand() % 20);
+        vStarts[i] = cRand() % kNumLines;
+    }
+    vPrefixes[0] = "zzz";           // No match
+
+    std::vector<int> vIndexed(kNumSearches);
+    tStart = std::chrono::steady_clock::now();
+    for (int i=0;i<kNumSearches;i++) vIndexed[i] = cModel.FindPrefix(vPrefixes[i].c_str(),vStarts[i]);
+    double fIndexedUs = ElapsedMs(tStart)*1000.0/kNumSearches;
+
+    int iLinearSearches = 200;
+    tStart = std::chrono::steady_clock::now();
+    for (int i=0;i<iLinearSearches;i++)
+    {
+        int iRow = LinearPrefix(cModel,vPrefixes[i].c_str(),vStarts[i]);
+        if (iRow != vIndexed[i] && iErrors++ < 10) printf("Prefix \"%s\" from %d: indexed %d, linear %d\n",vPrefixes[i].c_str(),vStarts[i],vIndexed[i],iRow);
+    }
+    double fLinearUs = ElapsedMs(tStart)*1000.0/iLinearSearches;
+
+    // Short prefixes match most rows; the lowest match at or after the start row must still be the one found
+
+    for (int i=0;i<iLinearSearches;i++)
+    {
+        std::string sPrefix = vPrefixes[i].substr(0,1 + i % 2);
+        int iRow = cModel.FindPrefix(sPrefix.c_str(),vStarts[i]),iLinear = LinearPrefix(cModel,sPrefix.c_str(),vStarts[i]);
+        if (iRow != iLinear && iErrors++ < 10) printf("Prefix \"%s\" from %d: indexed %d, linear %d\n",sPrefix.c_str(),vStarts[i],iRow,iLinear);
+    }
+
+    // Find -- substring scan
+
+    const char * sFind[] = { "worker 15) line 4999", "Scheduler ERROR: request 1", "not in any line" };
+    tStart = std::chrono::steady_clock::now();
+    int iFound = 0;
+    for (auto sText : sFind) iFound += cModel.FindText(sText,0) >= 0;
+    double fFindMs = ElapsedMs(tStart)/3;
+    if (iFound != 2) { printf("FindText found %d of 2\n",iFound); iErrors++; }
+
+    // Callback model over the same lines (appending rows as a growing log does)
+
+    CVirtualListModel cCallback;
+    cCallback.SetCallback(kNumLines/2,[&](int iRow,std::string &) { return vPointers[iRow]; });
+    cCallback.BuildIndex();
+    cCallback.SetCount(kNumLines);
+    for (int i=0;i<iLinearSearches;i++)
+        if (cCallback.FindPrefix(vPrefixes[i].c_str(),vStarts[i]) != vIndexed[i] && iErrors++ < 10) printf("Callback model differs for \"%s\"\n",vPrefixes[i].c_str());
+
+    printf("%-34s %12.1f ms  (%.0f lines/ms)\n","Append 500k lines",fAppendMs,kNumLines/fAppendMs);
+    printf("%-34s %12.1f MB  (%.1f bytes/line)\n","Column store memory",cModel.GetStore().GetMemoryUsed()/(1024.0*1024.0),
+            (double) cModel.GetStore().GetMemoryUsed()/kNumLines);
+    printf("%-34s %12.1f ms\n","Build type-ahead index",fIndexMs);
+    printf("%-34s %12.2f us\n","Fetch one page (40 rows)",fPageUs);
+    printf("%-34s %12.2f us\n","Type-ahead, indexed",fIndexedUs);
+    printf("%-34s %12.2f us  (%.0fx)\n","Type-ahead, linear scan",fLinearUs,fLinearUs/fIndexedUs);
+    printf("%-34s %12.2f ms\n","Find (substring scan)",fFindMs);
+
+    printf("\n%s (%d errors)   [checksum %zu]\n",iErrors ? "FAILED" : "Passed",iErrors,szChecksum);
+    return iErrors ? 1 : 0;
+}
@@ -182,6 +182,12 @@
 // 
 // During the training, TrainUpdate() will print out the percentage complete (of the .4 threshold), the current error, the learning rate (which changes a lot),
 // and the trend (converging or diverging)
+//
+// Minibatch training (CDevNNBatch)
+//
+// main.cpp can also run the same network with CDevNNBatch (see CDevNNBatch.h), which trains 8 data sets at a time with matrix multiplies instead of
+// one data set at a time.  BatchUpdate() takes the place of TrainUpdate() and the display is the same.  CDevNNBatch uses a fixed learning rate, so the
+// samples per second are shown in place of the trend.
 // 
 // note: Neural networking backpropagation (training) is very CPU-intensive.  Setting up speed optimization and removing some debug elements, such as frame checking,
 // can speed up the program 2-3 fold.
@@ -221,7 +227,10 @@ static CDevNN::stLayerInput_t stLayers[]  =
 //
 // The constructor tells CDevNN that we won't be using lockable weights (which can be used to shut off weights and nodes).
 //
-CCounterNN::CCounterNN(unsigned int uiRandSeed,CDevNN::stLayerInput_t * stLayers)  : CDevNN(uiRandSeed,CDevNN::LockEnable::Off,stLayers) {}
+// bBatch = true trains with CDevNNBatch instead (see RunNeuralNetwork()), using the same layer table.
+//
+CCounterNN::CCounterNN(unsigned int uiRandSeed,CDevNN::stLayerInput_t * stLayers,bool bBatch)  : CDevNN(uiRandSeed,CDevNN::LockEnable::Off,stLayers),
+    m_bBatch(bBatch), m_uiRandSeed(uiRandSeed), m_stLayers(stLayers) {}
 
 
 
@@ -234,23 +243,15 @@ CCounterNN::CCounterNN(unsigned int uiRandSeed,CDevNN::stLayerInput_t * stLayers
 //
 cnnErr_t CCounterNN::TrainUpdate(const char * & sMsg)
 {
-    static int iUpdateCount     = 0;
     static int iIter            = -1;
-    float fThreshold            = .4f;              // Thresold for success -- < .4 = 0, >.4 = 1
     
     double * fInputs,* fOutputs;
 
-    auto cnnReturnStatus = cnnErr_t::cnnOk;         // Ok for now, but might return a stop status
-
     if (++iIter < m_iTrainResolution) return cnnOk; // Omly process every m_iTrainResolution iterations to keep it faster
-
-    double fError = getError();                     // Get current NN error
+    iIter = 0;
 
     GetUpdateMem(fInputs,fOutputs);                 // Get memory for update inputs and outputs.  
    
-    int iCorrect = 0;
-    m_cGraphWin->Cls();                             // Clear the Graph Window so we can make a new set of bar charts.
-
     for (int i=0;i<(1 << kBits);i++)
     {
         // Set the inputs, one binary digit for loop value i
@@ -259,6 +260,47 @@ cnnErr_t CCounterNN::TrainUpdate(const char * & sMsg)
     
         TrainUpdateForward();           // Perform a Forward Propogation for our X,Y point.  
 
+        for (int k=0;k<kBits;k++) m_fOutputs[i*kBits+k] = fOutputs[k];
+    }
+
+    return ShowProgress(getEpoch(),getError(),getLearningRate(),"Trend",getTrendString(),sMsg);
+}
+
+// BatchUpdate() -- TrainUpdate() for CDevNNBatch, called by CBatchTrainer after every epoch.  Returns false to stop training.
+//
+// Predict() runs all 128 data sets through the network in batches, rather than one TrainUpdateForward() per data set.
+//
+bool CCounterNN::BatchUpdate(CBatchTrainer & cTrainer)
+{
+    static int iIter = -1;
+
+    if (++iIter < m_iTrainResolution) return true;
+    iIter = 0;
+
+    cTrainer.Predict(m_fTrainInputs,m_iDataSets,m_fOutputs);
+
+    char sRate[40];
+    sprintf(sRate,"%.0f/s",cTrainer.GetSamplesPerSec());
+    return ShowProgress(cTrainer.getEpoch(),cTrainer.getError(),cTrainer.getLearningRate(),"Samples",sRate,m_sBatchMsg) == cnnOk;
+}
+
+// ShowProgress() -- Show the outputs in m_fOutputs (from TrainUpdate() or BatchUpdate()) and the training status, and check
+//                   whether to stop.  Returns cnnStop (with a message in sMsg) to stop, cnnOk to keep training.
+//
+cnnErr_t CCounterNN::ShowProgress(int iEpoch,double fError,double fLearningRate,const char * sTrendLabel,const char * sTrend,const char * & sMsg)
+{
+    static int iUpdateCount     = 0;
+    float fThreshold            = .4f;              // Thresold for success -- < .4 = 0, >.4 = 1
+
+    auto cnnReturnStatus = cnnErr_t::cnnOk;         // Ok for now, but might return a stop status
+
+    int iCorrect = 0;
+    m_cGraphWin->Cls();                             // Clear the Graph Window so we can make a new set of bar charts.
+
+    for (int i=0;i<(1 << kBits);i++)
+    {
+        const double * fOutputs = m_fOutputs + i*kBits;
+
         double fTemp[kBits];
         int j = (i+1) & ((1 << kBits) -1); 
 
@@ -295,15 +337,15 @@ cnnErr_t CCounterNN::TrainUpdate(const char * & sMsg)
     // it here -- if it grows then it will probably be refactored out to a function call (it's on the edge of needing it)
     // -------------------------------------------------------------------------------------------------------------------------------------
 
-    m_cTextIteration    ->Write(CString() << "Epoch {cyan}" << getEpoch());
+    m_cTextIteration    ->Write(CString() << "Epoch {cyan}" << iEpoch);
     m_cTextPercent      ->Write(CString() << "Percent = {cyan}" << (int) (fPercent*100.0) << "%{/} (" << iCorrect << " out of " << m_iMaxValues << ")");
     m_cTextError        ->Write(CString() << "Error = {cyan}" << fError);
-    m_cTextTrend        ->Write(CString() << "Trend: {cyan}" << getTrendString());
-    m_cTextLR           ->Write(CString() << "Learning Rate: {cyan}" << getLearningRate());
+    m_cTextTrend        ->Write(CString() << sTrendLabel << ": {cyan}" << sTrend);
+    m_cTextLR           ->Write(CString() << "Learning Rate: {cyan}" << fLearningRate);
 
     // ** Original Console Output before SageBox was used to make give it a Graphic Output **
 
-    printf("[%d] P = %lf (%d/%d) -- LR = %lf, Error = %lf (%s)\n",getEpoch(),fPercent,iCorrect,m_iMaxValues,getLearningRate(),fError,getTrendString());
+    printf("[%d] P = %lf (%d/%d) -- LR = %lf, Error = %lf (%s)\n",iEpoch,fPercent,iCorrect,m_iMaxValues,fLearningRate,fError,sTrend);
     
     if (!(iUpdateCount++ % 10)) UpdateValueBox();   // Only update the Values every 10 times, to keep the output faster, since it does a lot of work. 
 
@@ -338,8 +380,6 @@ cnnErr_t CCounterNN::TrainUpdate(const char * & sMsg)
 
     if (fError < .001) SetStopMsg("Error-threshold went below minimum.");   // add "|| iCorrect >= m_iMaxValues" to exit earlier
 
-    iIter = 0;
-
     return cnnReturnStatus;
 }
 
@@ -431,6 +471,23 @@ CString CCounterNN::RunNeuralNetwork()
 {
     CreateDataMap();                        // Create the traning inputs and outputs.
 
+    if (m_bBatch) 
+    {
+        // Minibatch training with CDevNNBatch.  Train() runs until BatchUpdate() stops it.
+
+        CBatchTrainer cTrainer(*this,m_uiRandSeed,m_stLayers);
+        cTrainer.SetBatchSize(kBatchSize);
+        cTrainer.SetLearnRate(kBatchLearnRate);
+        cTrainer.SetMomentum(kBatchMomentum);
+        cTrainer.Train(m_iMaxEpochs,m_iDataSets,m_fTrainInputs,m_fTrainOutputs);
+
+        CString cMsg;
+        sprintf(cMsg,"Done (CDevNNBatch, %d epochs, %.0f samples/s).\n%s\n",cTrainer.getEpoch(),cTrainer.GetSamplesPerSec(),m_sBatchMsg ? m_sBatchMsg : "");
+
+        UpdateValueBox();
+        return cMsg;
+    }
+
     // Set up the learning rate values and automatic status.  These vary for every neural network.
 
     SetLearnRate(.0001);                    // Set initial learning rate
@@ -481,7 +538,9 @@ void CCounterNN::Go(CWindow & cWin)
 
 // main() -- Create neural network object and run it.
 //
-int CCounterNN::main()
+// bBatch = true trains with CDevNNBatch rather than CDevNN (see main.cpp)
+//
+int CCounterNN::main(bool bBatch)
 {
     // Create the main SageBox Object.
     // Also add a program name to display in the window titles.
@@ -533,8 +592,8 @@ int CCounterNN::main()
     // Get our 7-bit counter in a container so we don't need to delete it. 
     // CounterNN is too big to put on the stack.
 
-    Obj<CCounterNN> cCounterNN = new CCounterNN(1234,stLayers); // Give it a random number for the neural network, and the NN layer 
-                                                                // description.
+    Obj<CCounterNN> cCounterNN = new CCounterNN(1234,stLayers,bBatch);  // Give it a random number for the neural network, and the NN layer 
+                                                                        // description.
     cCounterNN->Go(cWin);
 
     while (cWin.GetEvent())
@@ -18,6 +18,7 @@
 #include "CSageBox.h"
 #include "CBarGraph.h"
 #include "CDevNN.h"
+#include "CDevNNBatch.h"
 
 // Main CounterNN class, derived from CDevNN
 class CCounterNN : protected CDevNN
@@ -42,6 +43,17 @@ private:
     CTextWidget               * m_cTextLR           = nullptr;
     CBarGraph                   m_cBarGraph;                    // Bar Graph Class to print bar chart bars
 
+    // CBatchTrainer -- CDevNNBatch (minibatch training) that reports each epoch back to the counter, the way
+    //                  CDevNN calls TrainUpdate()
+
+    class CBatchTrainer : public CDevNNBatch
+    {
+        CCounterNN & m_cCounter;
+    public:
+        CBatchTrainer(CCounterNN & cCounter,unsigned int uiRandSeed,CDevNN::stLayerInput_t * stLayers) : CDevNNBatch(uiRandSeed,stLayers), m_cCounter(cCounter) { }
+        bool TrainUpdate() override { return m_cCounter.BatchUpdate(*this); }
+    };
+
     // Some constant values 
 
     static constexpr int          m_iMaxEpochs      = -1;                       // Run forever (until TrainUpdate() quits automatically)
@@ -50,6 +62,9 @@ private:
     static constexpr int          m_iDataSets       = 1 << kBits;               // 0-127 in 7 bits
     static constexpr int          m_iMaxValues      = m_iOutputs*m_iDataSets;
     static constexpr int          m_iTrainResolution= 25;                       // Train Update() will only execute very 25 epochs
+    static constexpr int          kBatchSize        = 8;                        // Data sets per weight update with CDevNNBatch
+    static constexpr double       kBatchLearnRate   = 2;                        // CDevNNBatch learning rate and momentum (fixed; CDevNNBatch
+    static constexpr double       kBatchMomentum    = .5;                       //   has no automatic learning rate)
     static constexpr int          kBarWidth         = 7;                        // Width of Bar Graph bars
     static constexpr int          kWinWidth         = (1 << kBits)*kBarWidth;   // Width of the Bar Graph Window, based on Bar Size and number of possible outputs
     static constexpr int          kWinHeight        = 310;
@@ -66,16 +81,24 @@ private:
 
     double  m_fTrainInputs[m_iInputs*m_iDataSets];          // Training Inputs
     double  m_fTrainOutputs[m_iInputs*m_iDataSets];         // Training Outputs
+    double  m_fOutputs[m_iOutputs*m_iDataSets];             // Network outputs for every data set, for the display
+
+    bool                        m_bBatch        = false;    // Train with CDevNNBatch rather than CDevNN
+    unsigned int                m_uiRandSeed;
+    CDevNN::stLayerInput_t    * m_stLayers;
+    const char                * m_sBatchMsg     = nullptr;  // Stop message from BatchUpdate()
 
     cnnErr_t TrainUpdate(const char * & sMsg) override;     // Override for TrainUpdate() called after every Epoch in the neural network
+    bool BatchUpdate(CBatchTrainer & cTrainer);             // The same, for CDevNNBatch
+    cnnErr_t ShowProgress(int iEpoch,double fError,double fLearningRate,const char * sTrendLabel,const char * sTrend,const char * & sMsg);
     void UpdateValueBox();
     void InitUI();
     CString RunNeuralNetwork();
 public:
-    CCounterNN(unsigned int uiRandSeed,CDevNN::stLayerInput_t * stLayers);
+    CCounterNN(unsigned int uiRandSeed,CDevNN::stLayerInput_t * stLayers,bool bBatch = false);
     void CreateDataMap();
     void Go(CWindow & cWin);
-    static int main();
+    static int main(bool bBatch = false);
 
 };
 
@@ -0,0 +1,850 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CDevNNBatch.h -- Minibatch training back end for CDevNN networks
+//
+// CDevNN trains one data set at a time: every node sums its inputs in its own loop, and the activation and derivative are
+// called through a member-function pointer for each node.  That is fine for watching a small network learn, but most of
+// the time goes to loop and call overhead rather than math.
+//
+// CDevNNBatch trains the same networks (same layer structure, activations and losses) a minibatch at a time:
+//
+//      1. Each layer is three matrix multiplies per batch -- forward (Out = In*W), weight gradient (dW = In'*Delta) and
+//         back-propagated delta (Delta*W').  These run through CNNGemm, a blocked kernel that uses AVX2/FMA when the CPU
+//         has it (checked once at run-time, like CCrc32c) and plain C++ otherwise.
+//      2. Activations and derivatives are whole-array passes over the batch, selected once per layer when the network is
+//         created, rather than a call per node.  Sigmoid and TanH use AVX2 exp() and tanh() approximations (CNNActivate)
+//         along with the GEMM; the derivatives, Relu and SoftMax are plain loops.
+//      3. The math type is a template parameter: CDevNNBatch is double (like CDevNN), CDevNNBatchF is float, which
+//         doubles the SIMD width and halves the memory traffic.
+//
+// The gradient for a batch is the average over its data sets, so the learning rate is not tied to the batch size.
+// Training throughput (data sets per second) is measured by Train() and returned by GetSamplesPerSec().
+//
+//      static CDevNNBatch::stLayerInput_t stLayers[] =             // Or pass a CDevNN::stLayerInput_t table
+//      {
+//          7   ,CDevNNBatch::ActType::Input    ,
+//          12  ,CDevNNBatch::ActType::Sigmoid  ,
+//          7   ,CDevNNBatch::ActType::Sigmoid  ,
+//          0   ,CDevNNBatch::ActType::End      ,
+//      };
+//
+//      CDevNNBatchF cNN(1234,stLayers);                            // float math
+//      cNN.SetBatchSize(32);
+//      cNN.Train(1000,iDataSets,fInputs,fOutputs);                 // double (or float) inputs and expected outputs
+//      printf("%.0f samples/s, error %g\n",cNN.GetSamplesPerSec(),cNN.getError());
+//      cNN.Predict(fInputs,iDataSets,fResults);
+//
+// This is a separate class rather than a change to CDevNN itself, since CDevNN's Forward() and Backward() are in the
+// prebuilt CDevNN32/64.obj.  Weight locking, automatic learning rate and the development hooks of CDevNN are not included.
+//
+#if !defined(_CDevNNBatch_H_)
+#define _CDevNNBatch_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// (std::min) and (std::max) are in parentheses throughout, so the min() and max() macros from <Windows.h> do not apply.
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define _CDevNNBatch_AVX2_
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define _CNNTargetAVX2
+#else
+#define _CNNTargetAVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// CNNGemm -- Row-major matrix multiply kernels used by CDevNNBatch
+//
+//      MulAdd()    -- C[M x N] += A[M x K] * B[K x N], where A can be read transposed through its strides (A(i,k) is
+//                     A[i*iRowStride + k*iColStride]), so In'*Delta needs no copy
+//      MulAddBT()  -- C[M x N] += A[M x K] * B'   (B is N x K; it is transposed into a scratch buffer first)
+//
+// The work is split into blocks of kBlockK x kBlockN of B (so the block stays in L1/L2 while all rows of A pass over it),
+// and each block is done 4 rows by 2 SIMD vectors at a time, keeping 8 accumulators in registers.
+//
+class CNNGemm
+{
+    static constexpr int kBlockK = 128;
+    static constexpr int kBlockN = 256;
+
+    static bool & SimdEnabled() { static bool bEnabled = true; return bEnabled; }
+
+    template <typename _t>
+    static void MulAddScalar(int M,int N,int K,const _t * A,int iRowStride,int iColStride,const _t * B,_t * C)
+    {
+        for (int k0=0;k0<K;k0 += kBlockK)
+        {
+            int kEnd = (std::min)(K,k0 + kBlockK);
+            for (int j0=0;j0<N;j0 += kBlockN)
+            {
+                int jEnd = (std::min)(N,j0 + kBlockN);
+                for (int i=0;i<M;i++)
+                {
+                    _t * c = C + (size_t) i*N;
+                    for (int k=k0;k<kEnd;k++)
+                    {
+                        _t a = A[(size_t) i*iRowStride + (size_t) k*iColStride];
+                        const _t * b = B + (size_t) k*N;
+                        for (int j=j0;j<jEnd;j++) c[j] += a*b[j];
+                    }
+                }
+            }
+        }
+    }
+
+#if defined(_CDevNNBatch_AVX2_)
+
+    // AVX2 access for double (4 wide) and float (8 wide)
+
+    struct AVX2d
+    {
+        using V = __m256d;
+        static constexpr int kWidth = 4;
+        _CNNTargetAVX2 static inline V Load(const double * p)               { return _mm256_loadu_pd(p);        }
+        _CNNTargetAVX2 static inline void Store(double * p,V v)             { _mm256_storeu_pd(p,v);            }
+        _CNNTargetAVX2 static inline V Set(double f)                        { return _mm256_set1_pd(f);         }
+        _CNNTargetAVX2 static inline V Fma(V a,V b,V c)                     { return _mm256_fmadd_pd(a,b,c);    }
+    };
+
+    struct AVX2f
+    {
+        using V = __m256;
+        static constexpr int kWidth = 8;
+        _CNNTargetAVX2 static inline V Load(const float * p)                { return _mm256_loadu_ps(p);        }
+        _CNNTargetAVX2 static inline void Store(float * p,V v)              { _mm256_storeu_ps(p,v);            }
+        _CNNTargetAVX2 static inline V Set(float f)                         { return _mm256_set1_ps(f);         }
+        _CNNTargetAVX2 static inline V Fma(V a,V b,V c)                     { return _mm256_fmadd_ps(a,b,c);    }
+    };
+
+    template <typename S,typename _t>
+    _CNNTargetAVX2 static void MulAddAVX2(int M,int N,int K,const _t * A,int iRowStride,int iColStride,const _t * B,_t * C)
+    {
+        using V = typename S::V;
+        constexpr int W = S::kWidth;
+
+        for (int k0=0;k0<K;k0 += kBlockK)
+        {
+            int kEnd = (std::min)(K,k0 + kBlockK);
+            for (int j0=0;j0<N;j0 += kBlockN)
+            {
+                int jEnd = (std::min)(N,j0 + kBlockN);
+                int i = 0;
+                for (;i+4<=M;i += 4)
+                {
+                    const _t * a0 = A + (size_t) i*iRowStride;
+                    const _t * a1 = a0 + iRowStride;
+                    const _t * a2 = a1 + iRowStride;
+                    const _t * a3 = a2 + iRowStride;
+                    _t * c0 = C + (size_t) i*N;
+                    _t * c1 = c0 + N;
+                    _t * c2 = c1 + N;
+                    _t * c3 = c2 + N;
+
+                    int j = j0;
+                    for (;j+2*W<=jEnd;j += 2*W)
+                    {
+                        V v00 = S::Load(c0+j),v01 = S::Load(c0+j+W);
+                        V v10 = S::Load(c1+j),v11 = S::Load(c1+j+W);
+                        V v20 = S::Load(c2+j),v21 = S::Load(c2+j+W);
+                        V v30 = S::Load(c3+j),v31 = S::Load(c3+j+W);
+                        for (int k=k0;k<kEnd;k++)
+                        {
+                            const _t * b = B + (size_t) k*N + j;
+                            V b0 = S::Load(b),b1 = S::Load(b+W);
+                            size_t szA = (size_t) k*iColStride;
+                            V a = S::Set(a0[szA]); v00 = S::Fma(a,b0,v00); v01 = S::Fma(a,b1,v01);
+                            a   = S::Set(a1[szA]); v10 = S::Fma(a,b0,v10); v11 = S::Fma(a,b1,v11);
+                            a   = S::Set(a2[szA]); v20 = S::Fma(a,b0,v20); v21 = S::Fma(a,b1,v21);
+                            a   = S::Set(a3[szA]); v30 = S::Fma(a,b0,v30); v31 = S::Fma(a,b1,v31);
+                        }
+                        S::Store(c0+j,v00); S::Store(c0+j+W,v01);
+                        S::Store(c1+j,v10); S::Store(c1+j+W,v11);
+                        S::Store(c2+j,v20); S::Store(c2+j+W,v21);
+                        S::Store(c3+j,v30); S::Store(c3+j+W,v31);
+                    }
+                    for (;j+W<=jEnd;j += W)
+                    {
+                        V v0 = S::Load(c0+j),v1 = S::Load(c1+j),v2 = S::Load(c2+j),v3 = S::Load(c3+j);
+                        for (int k=k0;k<kEnd;k++)
+                        {
+                            V b = S::Load(B + (size_t) k*N + j);
+                            size_t szA = (size_t) k*iColStride;
+                            v0 = S::Fma(S::Set(a0[szA]),b,v0);
+                            v1 = S::Fma(S::Set(a1[szA]),b,v1);
+                            v2 = S::Fma(S::Set(a2[szA]),b,v2);
+                            v3 = S::Fma(S::Set(a3[szA]),b,v3);
+                        }
+                        S::Store(c0+j,v0); S::Store(c1+j,v1); S::Store(c2+j,v2); S::Store(c3+j,v3);
+                    }
+                    for (;j<jEnd;j++)
+                        for (int k=k0;k<kEnd;k++)
+                        {
+                            _t b = B[(size_t) k*N + j];
+                            size_t szA = (size_t) k*iColStride;
+                            c0[j] += a0[szA]*b; c1[j] += a1[szA]*b; c2[j] += a2[szA]*b; c3[j] += a3[szA]*b;
+                        }
+                }
+
+                // Remaining rows (fewer than 4), one at a time
+
+                for (;i<M;i++)
+                {
+                    const _t * a0 = A + (size_t) i*iRowStride;
+                    _t * c0 = C + (size_t) i*N;
+                    int j = j0;
+                    for (;j+W<=jEnd;j += W)
+                    {
+                        V v0 = S::Load(c0+j);
+                        for (int k=k0;k<kEnd;k++) v0 = S::Fma(S::Set(a0[(size_t) k*iColStride]),S::Load(B + (size_t) k*N + j),v0);
+                        S::Store(c0+j,v0);
+                    }
+                    for (;j<jEnd;j++)
+                        for (int k=k0;k<kEnd;k++) c0[j] += a0[(size_t) k*iColStride]*B[(size_t) k*N + j];
+                }
+            }
+        }
+    }
+
+    static void MulAddAVX2Type(int M,int N,int K,const double * A,int iRowStride,int iColStride,const double * B,double * C)
+    {
+        MulAddAVX2<AVX2d>(M,N,K,A,iRowStride,iColStride,B,C);
+    }
+    static void MulAddAVX2Type(int M,int N,int K,const float * A,int iRowStride,int iColStride,const float * B,float * C)
+    {
+        MulAddAVX2<AVX2f>(M,N,K,A,iRowStride,iColStride,B,C);
+    }
+#endif
+
+public:
+    // isAVX2() -- true if the CPU (and OS) support AVX2 and FMA (checked once)
+    //
+    static bool isAVX2()
+    {
+#if defined(_CDevNNBatch_AVX2_)
+        static const bool bAVX2 = []
+        {
+#if defined(_MSC_VER)
+            int iInfo[4];
+            __cpuid(iInfo,1);
+            bool bFma       = (iInfo[2] & (1 << 12)) != 0;
+            bool bOSXSave   = (iInfo[2] & (1 << 27)) != 0;
+            if (!bFma || !bOSXSave || (_xgetbv(0) & 6) != 6) return false;
+            __cpuidex(iInfo,7,0);
+            return (iInfo[1] & (1 << 5)) != 0;
+#else
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        }();
+        return bAVX2;
+#else
+        return false;
+#endif
+    }
+
+    // EnableSimd() -- Turn the AVX2 kernels off (or back on), i.e. to compare them with the plain C++ kernels
+    //
+    static void EnableSimd(bool bEnable) { SimdEnabled() = bEnable; }
+
+    // isSimd() -- true if the AVX2 kernels are being used
+    //
+    static bool isSimd() { return SimdEnabled() && isAVX2(); }
+
+    // MulAdd() -- C[M x N] += A[M x K] * B[K x N].  A(i,k) is A[i*iRowStride + k*iColStride]: (K,1) for A as stored,
+    // (1,M) for A transposed (A stored as K x M).
+    //
+    template <typename _t>
+    static void MulAdd(int M,int N,int K,const _t * A,int iRowStride,int iColStride,const _t * B,_t * C)
+    {
+        if (M <= 0 || N <= 0 || K <= 0) return;
+#if defined(_CDevNNBatch_AVX2_)
+        if (isSimd()) return MulAddAVX2Type(M,N,K,A,iRowStride,iColStride,B,C);
+#endif
+        MulAddScalar(M,N,K,A,iRowStride,iColStride,B,C);
+    }
+
+    // MulAddBT() -- C[M x N] += A[M x K] * B', where B is N x K.  vScratch holds B' between calls.
+    //
+    template <typename _t>
+    static void MulAddBT(int M,int N,int K,const _t * A,const _t * B,_t * C,std::vector<_t> & vScratch)
+    {
+        vScratch.resize((size_t) K*N);
+        for (int j=0;j<N;j++)
+            for (int k=0;k<K;k++) vScratch[(size_t) k*N + j] = B[(size_t) j*K + k];
+        MulAdd(M,N,K,A,K,1,vScratch.data(),C);
+    }
+};
+
+// CNNActivate -- Sigmoid and tanh over whole arrays, used by CDevNNBatch
+//
+// With the AVX2 kernels (CNNGemm::isSimd()), 4 doubles or 8 floats are done at a time.  exp(x) is split into n*ln2 + r
+// (|r| <= ln2/2), with e^r from its Taylor series and 2^n written into the exponent bits.  The input is clamped to the range
+// where 2^n is a normal number, so it does not overflow.  tanh(x) uses the Cephes polynomial (float) or rational
+// function (double) below |x| = .625, and 1 - 2/(e^2|x| + 1) above it.  The results are within a few units in the last
+// place of std::exp() and std::tanh(), which the plain C++ version uses.
+//
+class CNNActivate
+{
+#if defined(_CDevNNBatch_AVX2_)
+
+    _CNNTargetAVX2 static inline __m256d Load(const double * p)            { return _mm256_loadu_pd(p);    }
+    _CNNTargetAVX2 static inline __m256 Load(const float * p)              { return _mm256_loadu_ps(p);    }
+    _CNNTargetAVX2 static inline void Store(double * p,__m256d v)          { _mm256_storeu_pd(p,v);        }
+    _CNNTargetAVX2 static inline void Store(float * p,__m256 v)            { _mm256_storeu_ps(p,v);        }
+
+    _CNNTargetAVX2 static inline __m256d ExpV(__m256d x)
+    {
+        static constexpr double fInvFactorial[] =
+        {
+            1/6227020800.0,1/479001600.0,1/39916800.0,1/3628800.0,1/362880.0,1/40320.0,1/5040.0,1/720.0,1/120.0,1/24.0,1/6.0,.5,1,1,
+        };
+        x = _mm256_min_pd(_mm256_set1_pd(709),_mm256_max_pd(_mm256_set1_pd(-708),x));        // x (NaN) is the second operand
+        __m256d n = _mm256_round_pd(_mm256_mul_pd(x,_mm256_set1_pd(1.4426950408889634)),_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d r = _mm256_fnmadd_pd(n,_mm256_set1_pd(6.93145751953125e-1),x);
+        r = _mm256_fnmadd_pd(n,_mm256_set1_pd(1.42860682030941723212e-6),r);
+
+        __m256d p = _mm256_set1_pd(fInvFactorial[0]);
+        for (int i=1;i<(int) (sizeof(fInvFactorial)/sizeof(fInvFactorial[0]));i++) p = _mm256_fmadd_pd(p,r,_mm256_set1_pd(fInvFactorial[i]));
+
+        __m256i iExp = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n)),_mm256_set1_epi64x(1023));
+        return _mm256_mul_pd(p,_mm256_castsi256_pd(_mm256_slli_epi64(iExp,52)));
+    }
+
+    _CNNTargetAVX2 static inline __m256 ExpV(__m256 x)
+    {
+        static constexpr float fInvFactorial[] = { 1/5040.f,1/720.f,1/120.f,1/24.f,1/6.f,.5f,1,1 };
+        x = _mm256_min_ps(_mm256_set1_ps(88),_mm256_max_ps(_mm256_set1_ps(-87),x));
+        __m256 n = _mm256_round_ps(_mm256_mul_ps(x,_mm256_set1_ps(1.44269504f)),_MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_fnmadd_ps(n,_mm256_set1_ps(.693359375f),x);
+        r = _mm256_fnmadd_ps(n,_mm256_set1_ps(-2.12194440e-4f),r);
+
+        __m256 p = _mm256_set1_ps(fInvFactorial[0]);
+        for (int i=1;i<(int) (sizeof(fInvFactorial)/sizeof(fInvFactorial[0]));i++) p = _mm256_fmadd_ps(p,r,_mm256_set1_ps(fInvFactorial[i]));
+
+        __m256i iExp = _mm256_add_epi32(_mm256_cvtps_epi32(n),_mm256_set1_epi32(127));
+        return _mm256_mul_ps(p,_mm256_castsi256_ps(_mm256_slli_epi32(iExp,23)));
+    }
+
+    _CNNTargetAVX2 static inline __m256d SigmoidV(__m256d x)
+    {
+        __m256d vOne = _mm256_set1_pd(1);
+        return _mm256_div_pd(vOne,_mm256_add_pd(vOne,ExpV(_mm256_sub_pd(_mm256_setzero_pd(),x))));
+    }
+
+    _CNNTargetAVX2 static inline __m256 SigmoidV(__m256 x)
+    {
+        __m256 vOne = _mm256_set1_ps(1);
+        return _mm256_div_ps(vOne,_mm256_add_ps(vOne,ExpV(_mm256_sub_ps(_mm256_setzero_ps(),x))));
+    }
+
+    _CNNTargetAVX2 static inline __m256d TanHV(__m256d x)
+    {
+        __m256d vSign   = _mm256_and_pd(x,_mm256_set1_pd(-0.0));
+        __m256d vAbs    = _mm256_xor_pd(x,vSign);
+        __m256d vOne    = _mm256_set1_pd(1);
+
+        __m256d z = _mm256_mul_pd(x,x);
+        __m256d P = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_set1_pd(-9.64399179425052238628e-1),z,_mm256_set1_pd(-9.92877231001918586564e1)),z,
+                                    _mm256_set1_pd(-1.61468768441708447952e3));
+        __m256d Q = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_add_pd(z,_mm256_set1_pd(1.12811678491632931402e2)),z,
+                                    _mm256_set1_pd(2.23548839060100448583e3)),z,_mm256_set1_pd(4.84406305325125486048e3));
+        __m256d vSmall = _mm256_fmadd_pd(_mm256_mul_pd(x,z),_mm256_div_pd(P,Q),x);
+
+        __m256d vLarge = _mm256_sub_pd(vOne,_mm256_div_pd(_mm256_set1_pd(2),_mm256_add_pd(ExpV(_mm256_add_pd(vAbs,vAbs)),vOne)));
+        vLarge = _mm256_or_pd(vLarge,vSign);
+        return _mm256_blendv_pd(vLarge,vSmall,_mm256_cmp_pd(vAbs,_mm256_set1_pd(.625),_CMP_LT_OQ));
+    }
+
+    _CNNTargetAVX2 static inline __m256 TanHV(__m256 x)
+    {
+        __m256 vSign    = _mm256_and_ps(x,_mm256_set1_ps(-0.0f));
+        __m256 vAbs     = _mm256_xor_ps(x,vSign);
+        __m256 vOne     = _mm256_set1_ps(1);
+
+        __m256 z = _mm256_mul_ps(x,x);
+        __m256 p = _mm256_set1_ps(-5.70498872745e-3f);
+        p = _mm256_fmadd_ps(p,z,_mm256_set1_ps(2.06390887954e-2f));
+        p = _mm256_fmadd_ps(p,z,_mm256_set1_ps(-5.37397155531e-2f));
+        p = _mm256_fmadd_ps(p,z,_mm256_set1_ps(1.33314422036e-1f));
+        p = _mm256_fmadd_ps(p,z,_mm256_set1_ps(-3.33332819422e-1f));
+        __m256 vSmall = _mm256_fmadd_ps(_mm256_mul_ps(p,z),x,x);
+
+        __m256 vLarge = _mm256_sub_ps(vOne,_mm256_div_ps(_mm256_set1_ps(2),_mm256_add_ps(ExpV(_mm256_add_ps(vAbs,vAbs)),vOne)));
+        vLarge = _mm256_or_ps(vLarge,vSign);
+        return _mm256_blendv_ps(vLarge,vSmall,_mm256_cmp_ps(vAbs,_mm256_set1_ps(.625f),_CMP_LT_OQ));
+    }
+
+    // ApplyAVX2() -- A whole vector at a time; the last partial vector goes through a copy, so every value gets the
+    // same approximation
+
+    template <bool bTanH,typename _t>
+    _CNNTargetAVX2 static void ApplyAVX2(_t * fValues,size_t szCount)
+    {
+        constexpr size_t W = 32/sizeof(_t);
+        size_t i = 0;
+        for (;i+W<=szCount;i += W)
+        {
+            auto v = Load(fValues+i);
+            Store(fValues+i,bTanH ? TanHV(v) : SigmoidV(v));
+        }
+        if (i < szCount)
+        {
+            _t fTail[W] = {};
+            memcpy(fTail,fValues+i,(szCount-i)*sizeof(_t));
+            auto v = Load(fTail);
+            Store(fTail,bTanH ? TanHV(v) : SigmoidV(v));
+            memcpy(fValues+i,fTail,(szCount-i)*sizeof(_t));
+        }
+    }
+#endif
+
+public:
+    // Sigmoid() -- fValues[i] = 1/(1 + e^-fValues[i])
+    //
+    template <typename _t>
+    static void Sigmoid(_t * fValues,size_t szCount)
+    {
+#if defined(_CDevNNBatch_AVX2_)
+        if (CNNGemm::isSimd()) return ApplyAVX2<false>(fValues,szCount);
+#endif
+        for (size_t i=0;i<szCount;i++) fValues[i] = 1/(1 + std::exp(-fValues[i]));
+    }
+
+    // TanH() -- fValues[i] = tanh(fValues[i])
+    //
+    template <typename _t>
+    static void TanH(_t * fValues,size_t szCount)
+    {
+#if defined(_CDevNNBatch_AVX2_)
+        if (CNNGemm::isSimd()) return ApplyAVX2<true>(fValues,szCount);
+#endif
+        for (size_t i=0;i<szCount;i++) fValues[i] = std::tanh(fValues[i]);
+    }
+};
+
+// CDevNNBatchTypes -- Layer table types, shared by the double and float versions
+
+class CDevNNBatchTypes
+{
+public:
+    // Activation types, in the same order as CDevNN::ActType so CDevNN layer tables can be used as-is
+
+    enum class ActType
+    {
+        SoftMax     ,
+        Relu        ,
+        Sigmoid     ,
+        TanH        ,
+        Custom      ,   // Calls ActivateCustom()/DerivativeCustom() (override them in a derived class)
+        None        ,   // No activation (derivative is 1)
+        Input       ,   // Input layer (no activation)
+        End         ,   // End of the layer table
+    };
+
+    struct stLayerInput_t
+    {
+        int         iNodes;
+        ActType     eActType;
+    };
+};
+
+// CDevNNBatchT -- Minibatch neural network (see notes at the top of the file).  Use CDevNNBatch (double) or CDevNNBatchF (float).
+
+template <typename _t>
+class CDevNNBatchT : public CDevNNBatchTypes
+{
+public:
+    static constexpr int    kDefaultBatchSize   = 32;
+    static constexpr double kDefaultLearnRate   = .5;
+
+protected:
+
+    // Layer_t -- One layer after the input.  Weights are stored one row per input node (iInputs x iNodes), so the forward
+    // pass is a plain Out = In*W for the whole batch.
+
+    struct Layer_t
+    {
+        int                 iNodes;
+        int                 iInputs;
+        ActType             eActType;
+        std::vector<_t>     vWeights;           // iInputs x iNodes
+        std::vector<_t>     vBias;              // iNodes (bias input is always 1)
+        std::vector<_t>     vWDev;              // Weight gradient, summed over the batch
+        std::vector<_t>     vBDev;
+        std::vector<_t>     vWMom;              // Momentum (last update)
+        std::vector<_t>     vBMom;
+        std::vector<_t>     vOut;               // Batch x iNodes outputs (after activation)
+        std::vector<_t>     vDelta;             // Batch x iNodes derivative of the loss for each node's sum
+
+        void (CDevNNBatchT::*Activate)(_t * fValues,int iRows,int iCols);              // Selected once from eActType
+        void (CDevNNBatchT::*Derivative)(const _t * fOut,_t * fDelta,size_t szCount);   // fDelta *= f'(fOut)
+    };
+
+    std::vector<Layer_t>    m_vLayers;
+    std::vector<_t>         m_vIn;                  // Batch x inputs
+    std::vector<_t>         m_vTarget;              // Batch x outputs
+    std::vector<_t>         m_vScratch;             // Transposed weights for the back-propagated delta
+    std::vector<_t>         m_vDataIn;              // Training data, converted to _t
+    std::vector<_t>         m_vDataOut;
+    std::vector<int>        m_vOrder;               // Data set order for the current epoch
+    int                     m_iInputs               = 0;
+    int                     m_iOutputs              = 0;
+    int                     m_iBatchSize            = kDefaultBatchSize;
+    int                     m_iEpoch                = 0;
+    bool                    m_bSoftMax              = false;
+    bool                    m_bShuffle              = true;
+    _t                      m_fLearningRate         = (_t) kDefaultLearnRate;
+    _t                      m_fMomentum             = 0;
+    double                  m_fError                = 0;
+    long long               m_llSamples             = 0;
+    double                  m_fSeconds              = 0;
+    unsigned int            m_uiRandom;
+    bool                    m_bValid                = false;
+
+    unsigned int Rand() { m_uiRandom ^= m_uiRandom << 13; m_uiRandom ^= m_uiRandom >> 17; m_uiRandom ^= m_uiRandom << 5; return m_uiRandom; }
+    _t Rand1() { return (_t) (Rand() >> 8)/(_t) (1 << 24); }                        // 0 to 1
+
+    // Custom override activation functions (whole-array, like the built-in ones)
+
+    virtual void ActivateCustom(_t *,int,int) { }
+    virtual void DerivativeCustom(const _t *,_t *,size_t) { }
+
+    // Activation passes over a batch (iRows x iCols), and their derivatives from the outputs.  The derivatives are the
+    // same as CDevNN's, including Relu's .1 at 0.
+
+    void ActivateSig(_t * fValues,int iRows,int iCols)  { CNNActivate::Sigmoid(fValues,(size_t) iRows*iCols); }
+    void ActivateTanH(_t * fValues,int iRows,int iCols) { CNNActivate::TanH(fValues,(size_t) iRows*iCols); }
+    void ActivateRelu(_t * fValues,int iRows,int iCols)
+    {
+        size_t szCount = (size_t) iRows*iCols;
+        for (size_t i=0;i<szCount;i++) fValues[i] = fValues[i] > 0 ? fValues[i] : 0;
+    }
+    void ActivateNone(_t *,int,int) { }
+    void ActivateSoftMax(_t * fValues,int iRows,int iCols)
+    {
+        for (int i=0;i<iRows;i++)
+        {
+            _t * f = fValues + (size_t) i*iCols;
+            _t fMax = f[0],fSum = 0;
+            for (int j=1;j<iCols;j++) fMax = f[j] > fMax ? f[j] : fMax;
+            for (int j=0;j<iCols;j++) fSum += (f[j] = std::exp(f[j] - fMax));
+            _t fScale = 1/fSum;
+            for (int j=0;j<iCols;j++) f[j] *= fScale;
+        }
+    }
+
+    void DerivativeSig(const _t * fOut,_t * fDelta,size_t szCount)
+    {
+        for (size_t i=0;i<szCount;i++) fDelta[i] *= fOut[i]*(1 - fOut[i]);
+    }
+    void DerivativeTanH(const _t * fOut,_t * fDelta,size_t szCount)
+    {
+        for (size_t i=0;i<szCount;i++) fDelta[i] *= 1 - fOut[i]*fOut[i];
+    }
+    void DerivativeRelu(const _t * fOut,_t * fDelta,size_t szCount)
+    {
+        for (size_t i=0;i<szCount;i++) fDelta[i] *= fOut[i] == 0 ? (_t) .1 : fOut[i] < 0 ? 0 : 1;
+    }
+    void DerivativeNone(const _t *,_t *,size_t) { }
+
+    // Forward() -- Forward propagation of iRows data sets in m_vIn.  Each layer starts from its bias and adds In*W.
+
+    void Forward(int iRows)
+    {
+        const _t * fIn = m_vIn.data();
+        for (auto & stLayer : m_vLayers)
+        {
+            _t * fOut = stLayer.vOut.data();
+            for (int i=0;i<iRows;i++) memcpy(fOut + (size_t) i*stLayer.iNodes,stLayer.vBias.data(),stLayer.iNodes*sizeof(_t));
+            CNNGemm::MulAdd(iRows,stLayer.iNodes,stLayer.iInputs,fIn,stLayer.iInputs,1,stLayer.vWeights.data(),fOut);
+            (this->*stLayer.Activate)(fOut,iRows,stLayer.iNodes);
+            fIn = fOut;
+        }
+    }
+
+    // Backward() -- Gradients for iRows data sets with expected outputs in m_vTarget.  Returns the summed squared error.
+    //
+    // The output delta is 2*(Out - Expected)*f'(Out) (CDevNN's RMS loss), or Out - Expected for SoftMax with its
+    // cross-entropy loss.
+
+    double Backward(int iRows)
+    {
+        auto & stLast = m_vLayers.back();
+        size_t szOut = (size_t) iRows*m_iOutputs;
+        double fError = 0;
+        for (size_t i=0;i<szOut;i++)
+        {
+            _t fDiff = stLast.vOut[i] - m_vTarget[i];
+            fError += (double) fDiff*fDiff;
+            stLast.vDelta[i] = m_bSoftMax ? fDiff : 2*fDiff;
+        }
+        if (!m_bSoftMax) (this->*stLast.Derivative)(stLast.vOut.data(),stLast.vDelta.data(),szOut);
+
+        for (int l=(int) m_vLayers.size()-1;l>=0;l--)
+        {
+            auto & stLayer = m_vLayers[l];
+            const _t * fIn = l ? m_vLayers[l-1].vOut.data() : m_vIn.data();
+
+            // dW = In'*Delta, dB = column sums of Delta
+
+            std::fill(stLayer.vWDev.begin(),stLayer.vWDev.end(),(_t) 0);
+            CNNGemm::MulAdd(stLayer.iInputs,stLayer.iNodes,iRows,fIn,1,stLayer.iInputs,stLayer.vDelta.data(),stLayer.vWDev.data());
+            std::fill(stLayer.vBDev.begin(),stLayer.vBDev.end(),(_t) 0);
+            for (int i=0;i<iRows;i++)
+            {
+                const _t * fDelta = stLayer.vDelta.data() + (size_t) i*stLayer.iNodes;
+                for (int j=0;j<stLayer.iNodes;j++) stLayer.vBDev[j] += fDelta[j];
+            }
+
+            // Delta for the layer before: (Delta*W') * f'(Out)
+
+            if (l)
+            {
+                auto & stPrev = m_vLayers[l-1];
+                size_t szPrev = (size_t) iRows*stPrev.iNodes;
+                std::fill(stPrev.vDelta.begin(),stPrev.vDelta.begin() + szPrev,(_t) 0);
+                CNNGemm::MulAddBT(iRows,stPrev.iNodes,stLayer.iNodes,stLayer.vDelta.data(),stLayer.vWeights.data(),stPrev.vDelta.data(),m_vScratch);
+                (this->*stPrev.Derivative)(stPrev.vOut.data(),stPrev.vDelta.data(),szPrev);
+            }
+        }
+        return fError;
+    }
+
+    // ApplyDerivatives() -- Step the weights by the average gradient of the batch (with momentum, if set)
+
+    void ApplyDerivatives(int iRows)
+    {
+        _t fScale = m_fLearningRate/iRows;
+        for (auto & stLayer : m_vLayers)
+        {
+            if (m_fMomentum == 0)
+            {
+                for (size_t i=0;i<stLayer.vWeights.size();i++) stLayer.vWeights[i] -= fScale*stLayer.vWDev[i];
+                for (size_t i=0;i<stLayer.vBias.size();i++) stLayer.vBias[i] -= fScale*stLayer.vBDev[i];
+                continue;
+            }
+            for (size_t i=0;i<stLayer.vWeights.size();i++) stLayer.vWeights[i] -= (stLayer.vWMom[i] = m_fMomentum*stLayer.vWMom[i] + fScale*stLayer.vWDev[i]);
+            for (size_t i=0;i<stLayer.vBias.size();i++) stLayer.vBias[i] -= (stLayer.vBMom[i] = m_fMomentum*stLayer.vBMom[i] + fScale*stLayer.vBDev[i]);
+        }
+    }
+
+    // SetBatchMem() -- Size the per-batch memory for the current batch size
+
+    void SetBatchMem()
+    {
+        m_vIn.resize((size_t) m_iBatchSize*m_iInputs);
+        m_vTarget.resize((size_t) m_iBatchSize*m_iOutputs);
+        for (auto & stLayer : m_vLayers)
+        {
+            stLayer.vOut.resize((size_t) m_iBatchSize*stLayer.iNodes);
+            stLayer.vDelta.resize((size_t) m_iBatchSize*stLayer.iNodes);
+        }
+    }
+
+    template <typename _Layer>
+    bool Create(unsigned int uiRandSeed,const _Layer * stLayers)
+    {
+        m_uiRandom = uiRandSeed ? uiRandSeed : 1;
+        if (!stLayers || stLayers[0].iNodes <= 0 || (ActType) stLayers[0].eActType != ActType::Input) return false;
+
+        m_iInputs = stLayers[0].iNodes;
+        int iInputs = m_iInputs;
+        for (int i=1;(ActType) stLayers[i].eActType != ActType::End;i++)
+        {
+            ActType eActType = (ActType) stLayers[i].eActType;
+            if (stLayers[i].iNodes <= 0 || eActType == ActType::Input) return false;
+
+            Layer_t stLayer{};
+            stLayer.iNodes      = stLayers[i].iNodes;
+            stLayer.iInputs     = iInputs;
+            stLayer.eActType    = eActType;
+            stLayer.vWeights.resize((size_t) iInputs*stLayer.iNodes);
+            stLayer.vBias.resize(stLayer.iNodes);
+            stLayer.vWDev.resize(stLayer.vWeights.size());
+            stLayer.vBDev.resize(stLayer.iNodes);
+            stLayer.vWMom.resize(stLayer.vWeights.size());
+            stLayer.vBMom.resize(stLayer.iNodes);
+
+            switch (eActType)
+            {
+                case ActType::Sigmoid:  stLayer.Activate = &CDevNNBatchT::ActivateSig;      stLayer.Derivative = &CDevNNBatchT::DerivativeSig;      break;
+                case ActType::TanH:     stLayer.Activate = &CDevNNBatchT::ActivateTanH;     stLayer.Derivative = &CDevNNBatchT::DerivativeTanH;     break;
+                case ActType::Relu:     stLayer.Activate = &CDevNNBatchT::ActivateRelu;     stLayer.Derivative = &CDevNNBatchT::DerivativeRelu;     break;
+                case ActType::SoftMax:  stLayer.Activate = &CDevNNBatchT::ActivateSoftMax;  stLayer.Derivative = &CDevNNBatchT::DerivativeSig;      break;
+                case ActType::Custom:   stLayer.Activate = &CDevNNBatchT::ActivateCustom;   stLayer.Derivative = &CDevNNBatchT::DerivativeCustom;   break;
+                default:                stLayer.Activate = &CDevNNBatchT::ActivateNone;     stLayer.Derivative = &CDevNNBatchT::DerivativeNone;     break;
+            }
+
+            m_vLayers.push_back(std::move(stLayer));
+            iInputs = stLayers[i].iNodes;
+        }
+        if (m_vLayers.empty()) return false;
+
+        // SoftMax is only used (with cross-entropy) on the output layer; a hidden SoftMax layer uses the Sigmoid derivative
+
+        m_iOutputs  = iInputs;
+        m_bSoftMax  = m_vLayers.back().eActType == ActType::SoftMax;
+        FillWeights();
+        SetBatchMem();
+        return true;
+    }
+
+public:
+    CDevNNBatchT(unsigned int uiRandSeed,const stLayerInput_t * stLayers) { m_bValid = Create(uiRandSeed,stLayers); }
+#if defined(_CDevNN_H_)
+    CDevNNBatchT(unsigned int uiRandSeed,const CDevNN::stLayerInput_t * stLayers) { m_bValid = Create(uiRandSeed,stLayers); }
+#endif
+    virtual ~CDevNNBatchT() { }
+
+    // isValid() -- false if the layer table was not usable (no Input layer first, a layer with no nodes, or no layers)
+    //
+    bool isValid() const { return m_bValid; }
+
+    // FillWeights() -- Random weights, uniform in +/- sqrt(6/(inputs + nodes)) for each layer.  Biases and momentum are cleared.
+    //
+    void FillWeights()
+    {
+        for (auto & stLayer : m_vLayers)
+        {
+            _t fRange = (_t) std::sqrt(6.0/(stLayer.iInputs + stLayer.iNodes));
+            for (auto & fWeight : stLayer.vWeights) fWeight = (2*Rand1() - 1)*fRange;
+            std::fill(stLayer.vBias.begin(),stLayer.vBias.end(),(_t) 0);
+            std::fill(stLayer.vWMom.begin(),stLayer.vWMom.end(),(_t) 0);
+            std::fill(stLayer.vBMom.begin(),stLayer.vBMom.end(),(_t) 0);
+        }
+    }
+
+    // SetBatchSize() -- Data sets per weight update (1 = per data set, like CDevNN)
+    //
+    void SetBatchSize(int iBatchSize) { m_iBatchSize = (std::max)(1,iBatchSize); SetBatchMem(); }
+    int GetBatchSize() const { return m_iBatchSize; }
+
+    void SetLearnRate(double fRate) { if (fRate > 0) m_fLearningRate = (_t) fRate; }
+    void SetMomentum(double fMomentum) { m_fMomentum = (_t) fMomentum; }
+    void SetShuffle(bool bShuffle) { m_bShuffle = bShuffle; }
+
+    double getLearningRate() const  { return m_fLearningRate; }
+    double getError() const         { return m_fError; }            // Mean squared error of the last epoch
+    int getEpoch() const            { return m_iEpoch; }
+    bool isSoftMax() const          { return m_bSoftMax; }
+    int GetInputs() const           { return m_iInputs; }
+    int GetOutputs() const          { return m_iOutputs; }
+    int GetLayers() const           { return (int) m_vLayers.size(); }
+
+    // Weights and gradients for layer iLayer (0 = the first layer after the input).  Weights are iInputs x iNodes, row
+    // per input node; the gradients are from the last batch (summed, not averaged).
+    //
+    std::vector<_t> & GetWeights(int iLayer)        { return m_vLayers[iLayer].vWeights;    }
+    std::vector<_t> & GetBias(int iLayer)           { return m_vLayers[iLayer].vBias;       }
+    const std::vector<_t> & GetWDev(int iLayer)     { return m_vLayers[iLayer].vWDev;       }
+    const std::vector<_t> & GetBDev(int iLayer)     { return m_vLayers[iLayer].vBDev;       }
+
+    // GetSamplesPerSec() -- Training throughput (data sets per second) over all Train() calls so far
+    //
+    double GetSamplesPerSec() const { return m_fSeconds > 0 ? m_llSamples/m_fSeconds : 0; }
+    long long GetSamplesTrained() const { return m_llSamples; }
+
+    // Predict() -- Forward propagation of iDataSets inputs (iDataSets x inputs) to fOutputs (iDataSets x outputs)
+    //
+    template <typename _In>
+    void Predict(const _In * fInputs,int iDataSets,_In * fOutputs)
+    {
+        for (int i0=0;i0<iDataSets;i0 += m_iBatchSize)
+        {
+            int iRows = (std::min)(m_iBatchSize,iDataSets - i0);
+            for (size_t i=0;i<(size_t) iRows*m_iInputs;i++) m_vIn[i] = (_t) fInputs[(size_t) i0*m_iInputs + i];
+            Forward(iRows);
+            auto & vOut = m_vLayers.back().vOut;
+            for (size_t i=0;i<(size_t) iRows*m_iOutputs;i++) fOutputs[(size_t) i0*m_iOutputs + i] = (_In) vOut[i];
+        }
+    }
+
+    // Gradients() -- Forward and backward propagation of one batch (up to the batch size) without changing the
+    // weights.  Returns the summed squared error; the gradients are in GetWDev()/GetBDev().
+    //
+    template <typename _In>
+    double Gradients(const _In * fInputs,const _In * fOutputs,int iDataSets)
+    {
+        int iRows = (std::min)(m_iBatchSize,iDataSets);
+        for (size_t i=0;i<(size_t) iRows*m_iInputs;i++) m_vIn[i] = (_t) fInputs[i];
+        for (size_t i=0;i<(size_t) iRows*m_iOutputs;i++) m_vTarget[i] = (_t) fOutputs[i];
+        Forward(iRows);
+        return Backward(iRows);
+    }
+
+    // TrainEpoch() -- One pass over the data set given to Train() (or SetTrainingData()), in shuffled batches.  Returns
+    // the mean squared error.
+    //
+    double TrainEpoch()
+    {
+        int iDataSets = (int) m_vOrder.size();
+        if (!iDataSets) return 0;
+
+        if (m_bShuffle)
+            for (int i=iDataSets-1;i>0;i--) std::swap(m_vOrder[i],m_vOrder[Rand() % (i+1)]);
+
+        double fError = 0;
+        for (int i0=0;i0<iDataSets;i0 += m_iBatchSize)
+        {
+            int iRows = (std::min)(m_iBatchSize,iDataSets - i0);
+            for (int i=0;i<iRows;i++)
+            {
+                int iSet = m_vOrder[i0 + i];
+                memcpy(&m_vIn[(size_t) i*m_iInputs],&m_vDataIn[(size_t) iSet*m_iInputs],m_iInputs*sizeof(_t));
+                memcpy(&m_vTarget[(size_t) i*m_iOutputs],&m_vDataOut[(size_t) iSet*m_iOutputs],m_iOutputs*sizeof(_t));
+            }
+            Forward(iRows);
+            fError += Backward(iRows);
+            ApplyDerivatives(iRows);
+        }
+        m_iEpoch++;
+        return m_fError = fError/((double) iDataSets*m_iOutputs);
+    }
+
+    // SetTrainingData() -- Copy (and convert) iDataSets inputs and expected outputs for TrainEpoch()
+    //
+    template <typename _In>
+    void SetTrainingData(int iDataSets,const _In * fpDataSet,const _In * fpEOutputs)
+    {
+        m_vDataIn.assign(fpDataSet,fpDataSet + (size_t) iDataSets*m_iInputs);
+        m_vDataOut.assign(fpEOutputs,fpEOutputs + (size_t) iDataSets*m_iOutputs);
+        m_vOrder.resize(iDataSets);
+        for (int i=0;i<iDataSets;i++) m_vOrder[i] = i;
+    }
+
+    // TrainUpdate() -- Called after every epoch by Train().  Return false to stop training.
+    //
+    virtual bool TrainUpdate() { return true; }
+
+    // Train() -- Train for iEpochs epochs (-1 = until TrainUpdate() returns false) on iDataSets inputs and expected outputs.
+    // Returns false if the network is not valid or TrainUpdate() stopped the training.
+    //
+    template <typename _In>
+    bool Train(int iEpochs,int iDataSets,const _In * fpDataSet,const _In * fpEOutputs)
+    {
+        if (!m_bValid || iDataSets <= 0) return false;
+        SetTrainingData(iDataSets,fpDataSet,fpEOutputs);
+
+        for (int i=0;iEpochs < 0 || i<iEpochs;i++)
+        {
+            auto tStart = std::chrono::steady_clock::now();
+            TrainEpoch();
+            m_fSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+            m_llSamples += iDataSets;
+            if (!TrainUpdate()) return false;
+        }
+        return true;
+    }
+};
+
+using CDevNNBatch   = CDevNNBatchT<double>;
+using CDevNNBatchF  = CDevNNBatchT<float>;
+
+#endif // _CDevNNBatch_H_
@@ -1,7 +1,12 @@
 #include "CSageBox.h"
 #include "CCounter.h"
 
+// Set kUseBatchTrainer to true to train the counter with CDevNNBatch (minibatch training, see CDevNNBatch.h) instead of
+// CDevNN (one data set at a time).  The display is the same for both.
+
+static constexpr bool kUseBatchTrainer = false;
+
 int main()
 {
-    return CCounterNN::main();
-}
\ No newline at end of file
+    return CCounterNN::main(kUseBatchTrainer);
+}
@@ -0,0 +1,146 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// PgrBuild -- Command-line tool to build indexed PGR archives with CPgrBuilder
+//
+// Usage: PgrBuild <output.pgr> <input> [<input> ...] [options]
+//
+//      <input>             A directory (all files under it are added, named by their relative path),
+//                          a manifest file given as @manifest.txt ("name = path" per line), or a single file.
+//
+//      -align <n>          Alignment of each stored file in bytes (power of 2, default 64; 4096 for page alignment)
+//      -nocompress         Store all files uncompressed
+//      -threads <n>        Number of threads (default: all hardware threads)
+//      -prefix <name>      Put the following directory inputs under <name>/
+//      -list               List the archive's entries after building
+//      -verify             Read the archive back from disk and check every entry (decompressing LZ4 entries)
+//
+// The archive is written by CPgrBuilder::Build(), under a temporary name that is renamed when complete.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CPgrBuilder.h"
+
+using namespace Sage;
+
+static int Usage()
+{
+    printf("Usage: PgrBuild <output.pgr> <directory | @manifest | file> [...] [-align n] [-nocompress] [-threads n] [-prefix name] [-list] [-verify]\n");
+    return 1;
+}
+
+static bool ReadArchive(const char * sPath,std::vector<unsigned char> & vArchive)
+{
+    FILE * fFile = fopen(sPath,"rb");
+    if (!fFile) return false;
+    bool bSuccess = !fseek(fFile,0,SEEK_END);
+    long lSize = bSuccess ? ftell(fFile) : -1;
+    bSuccess = lSize >= 0 && !fseek(fFile,0,SEEK_SET);
+    if (bSuccess) vArchive.resize((size_t) lSize);
+    bSuccess = bSuccess && (!lSize || fread(vArchive.data(),1,(size_t) lSize,fFile) == (size_t) lSize);
+    fclose(fFile);
+    return bSuccess;
+}
+
+// VerifyArchive() -- Extract every entry and check its size and Hash64() against the entry table.  Returns the number of
+// bad entries, or -1 if the archive fails CPgrArchive::GetHeader().
+//
+static int VerifyArchive(const std::vector<unsigned char> & vArchive)
+{
+    auto stHeader = CPgrArchive::GetHeader(vArchive.data(),vArchive.size());
+    if (!stHeader) return -1;
+
+    int iBad = 0;
+    auto stEntries = CPgrArchive::GetEntries(vArchive.data());
+    std::vector<unsigned char> vFile;
+    for (unsigned int i=0;i<stHeader->uiNumEntries;i++)
+    {
+        auto & stEntry = stEntries[i];
+        vFile.assign((size_t) stEntry.ullSize,0);
+        if (!CPgrArchive::Extract(vArchive.data(),stEntry,vFile.data()) ||
+            CPgrArchive::Hash64(vFile.data(),vFile.size()) != stEntry.ullHash)
+        {
+            printf("Entry %s does not read back\n",CPgrArchive::GetName(vArchive.data(),stEntry));
+            iBad++;
+        }
+    }
+    return iBad;
+}
+
+static void ListArchive(const std::vector<unsigned char> & vArchive)
+{
+    auto stHeader = CPgrArchive::GetHeader(vArchive.data(),vArchive.size());
+    if (!stHeader) { printf("Archive failed verification.\n"); return; }
+
+    auto stEntries = CPgrArchive::GetEntries(vArchive.data());
+    printf("\n%12s %12s %12s  %-5s %s\n","Offset","Size","Stored","Type","Name");
+    for (unsigned int i=0;i<stHeader->uiNumEntries;i++)
+    {
+        auto & stEntry = stEntries[i];
+        printf("%12llu %12llu %12llu  %-5s %s\n",stEntry.ullOffset,stEntry.ullSize,stEntry.ullStoredSize,
+                stEntry.uiCompression == CPgrArchive::LZ4 ? "LZ4" : "-",CPgrArchive::GetName(vArchive.data(),stEntry));
+    }
+}
+
+int main(int argc,char * argv[])
+{
+    if (argc < 3) return Usage();
+
+    CPgrBuilder::Options_t stOptions;
+    CPgrBuilder cBuilder;
+    const char * sOutput = argv[1];
+    const char * sPrefix = nullptr;
+    bool bList = false;
+    bool bVerify = false;
+
+    for (int i=2;i<argc;i++)
+    {
+        const char * sArg = argv[i];
+        bool bHasValue = i+1 < argc;
+
+        if (!strcmp(sArg,"-align") && bHasValue)            stOptions.uiAlignment = (unsigned int) atoi(argv[++i]);
+        else if (!strcmp(sArg,"-threads") && bHasValue)     stOptions.iMaxThreads = atoi(argv[++i]);
+        else if (!strcmp(sArg,"-prefix") && bHasValue)      sPrefix = argv[++i];
+        else if (!strcmp(sArg,"-nocompress"))               stOptions.bCompress = false;
+        else if (!strcmp(sArg,"-list"))                     bList = true;
+        else if (!strcmp(sArg,"-verify"))                   bVerify = true;
+        else if (sArg[0] == '-')                            return Usage();
+        else
+        {
+            bool bAdded;
+            if (sArg[0] == '@')                                 bAdded = cBuilder.AddManifest(sArg+1);
+            else if (CPgrBuilder::isDirectory(sArg))            bAdded = cBuilder.AddDirectory(sArg,sPrefix);
+            else
+            {
+                std::string sName = CPgrBuilder::GetFileName(sArg);
+                if (sPrefix) sName = std::string(sPrefix) + "/" + sName;
+                bAdded = cBuilder.AddFile(sName.c_str(),sArg);
+            }
+            if (!bAdded) { printf("Error: %s\n",cBuilder.GetError()); return 1; }
+        }
+    }
+
+    cBuilder.SetOptions(stOptions);
+    if (!cBuilder.Build(sOutput)) { printf("Error: %s\n",cBuilder.GetError()); return 1; }
+
+    auto stStats = cBuilder.GetStats();
+    printf("%s: %d entries, %d stored (%d LZ4), %lld bytes in, %lld bytes of data, %lld byte archive\n",sOutput,
+            stStats.iEntries,stStats.iStoredFiles,stStats.iCompressedFiles,stStats.llInputBytes,stStats.llStoredBytes,stStats.llArchiveBytes);
+
+    if (!bList && !bVerify) return 0;
+
+    std::vector<unsigned char> vArchive;
+    if (!ReadArchive(sOutput,vArchive)) { printf("Error: can't read %s\n",sOutput); return 1; }
+    if (bList) ListArchive(vArchive);
+    if (bVerify)
+    {
+        int iBad = VerifyArchive(vArchive);
+        if (iBad < 0) { printf("Error: %s failed verification\n",sOutput); return 1; }
+        if (iBad) { printf("Error: %d entries of %s do not read back\n",iBad,sOutput); return 1; }
+        printf("%s: all entries read back\n",sOutput);
+    }
+    return 0;
+}
@@ -0,0 +1,306 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CBitmapCache -- Process-wide cache of bitmaps decoded from PGR files.
+//
+// Widgets and button styles read their textures with CSagePGR::ReadBitmap() or CDavinci::ReadPgrBitmap() each time an
+// instance is created, so 40 dials decode the same JPEG faces 40 times.  CBitmapCache decodes each image once and hands
+// out CSharedBitmap objects that all refer to the same pixels.
+//
+// Images are keyed by the PGR (its path, memory address, or CSagePGR/CPgrReader object) plus the image name.  The cache
+// keeps images up to a memory budget (default 64MB), dropping the least-recently-used images when it is exceeded.
+// Dropping an image from the cache does not free it while any CSharedBitmap still refers to it.
+//
+// CSharedBitmap is copy-on-write: Get() gives read-only access to the shared pixels, and Modify() makes a private copy
+// first if the bitmap is shared (including with the cache), so changing one widget's bitmap never changes another's.
+//
+// Basic usage:
+//
+//      auto cFace = CBitmapCache::GetDefault().ReadPgrBitmap("DialFace",sDialPgr);     // Decodes the first time only
+//      cWin.DisplayBitmap(cFace.Get());
+//
+//      cFace.Modify().stBitmap.FillColor(...);                                        // Private copy from here on
+//
+//      auto stStats = CBitmapCache::GetDefault().GetStats();                           // Hits, misses, memory used
+//
+// Only the pixel data is shared and copied; bitmaps with a mask (sMask) are not cached.
+//
+#if !defined(_CBitmapCache_H_)
+#define _CBitmapCache_H_
+
+#include <Windows.h>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Sage.h"
+#include "CRawBitmap.h"
+#include "CPgr.h"
+#include "CPgrReader.h"
+#include "CDavinci.h"
+#include "SageProfile.h"
+
+namespace Sage
+{
+
+// CSharedBitmap -- Reference-counted, copy-on-write handle to a cached bitmap.
+//
+class CSharedBitmap
+{
+    std::shared_ptr<CBitmap> m_cBitmap;
+
+public:
+    CSharedBitmap() { }
+    CSharedBitmap(std::shared_ptr<CBitmap> cBitmap) : m_cBitmap(std::move(cBitmap)) { }
+
+    bool isValid() const { return m_cBitmap && m_cBitmap->stBitmap.stMem; }
+    bool isEmpty() const { return !isValid(); }
+    bool isShared() const { return m_cBitmap && m_cBitmap.use_count() > 1; }
+
+    // Get() -- Read-only access to the bitmap.  The bitmap must not be changed through this reference (use Modify()).
+    //
+    const RawBitmap_t & Get() const
+    {
+        static const RawBitmap_t stEmpty{};
+        return m_cBitmap ? m_cBitmap->stBitmap : stEmpty;
+    }
+    operator const RawBitmap_t & () const { return Get(); }
+    SIZE GetSize() const { return m_cBitmap ? SIZE{ m_cBitmap->stBitmap.iWidth,m_cBitmap->stBitmap.iHeight } : SIZE{ 0,0 }; }
+
+    // Modify() -- Return a bitmap that can be changed, copying the pixels first if the bitmap is shared.
+    //
+    CBitmap & Modify()
+    {
+        if (!m_cBitmap) m_cBitmap = std::make_shared<CBitmap>();
+        else if (isShared()) m_cBitmap = std::make_shared<CBitmap>(Copy(m_cBitmap->stBitmap));
+        return *m_cBitmap;
+    }
+
+    // Detach() -- Return a CBitmap of its own (a copy if shared, otherwise the bitmap itself), and release this handle.
+    //
+    CBitmap Detach()
+    {
+        CBitmap cBitmap;
+        if (!m_cBitmap) return cBitmap;
+        if (isShared()) cBitmap = Copy(m_cBitmap->stBitmap);
+        else std::swap(cBitmap.stBitmap,m_cBitmap->stBitmap);
+        m_cBitmap.reset();
+        return cBitmap;
+    }
+
+    void Release() { m_cBitmap.reset(); }
+
+    // Copy() -- Copy the pixels of a bitmap into a new RawBitmap_t.
+    //
+    static RawBitmap_t Copy(const RawBitmap_t & stSource)
+    {
+        if (!stSource.stMem || stSource.iWidth <= 0 || stSource.iHeight <= 0) return RawBitmap_t{};
+        RawBitmap_t stCopy = Sage::CreateBitmap(stSource.iWidth,stSource.iHeight);
+        if (stCopy.stMem && stCopy.iTotalSize == stSource.iTotalSize) memcpy(stCopy.stMem,stSource.stMem,stSource.iTotalSize);
+        return stCopy;
+    }
+};
+
+class CBitmapCache
+{
+public:
+    static constexpr long long kDefaultBudget = 64*1024*1024;
+
+    struct Stats_t
+    {
+        long long llHits;
+        long long llMisses;
+        long long llEvictions;
+        long long llMemUsed;        // Bytes of pixel data held by the cache
+        long long llBudget;
+        int       iEntries;
+    };
+
+private:
+    struct Entry_t
+    {
+        std::shared_ptr<CBitmap>    cBitmap;
+        long long                   llSize;
+        std::list<std::string>::iterator itLRU;
+    };
+
+    std::mutex                                  m_mutex;
+    std::unordered_map<std::string,Entry_t>     m_mapEntries;
+    std::list<std::string>                      m_lLRU;             // Most-recently used at the front
+    long long                                   m_llMemUsed     = 0;
+    long long                                   m_llBudget      = kDefaultBudget;
+
+    std::atomic<long long>                      m_llHits{0};
+    std::atomic<long long>                      m_llMisses{0};
+    std::atomic<long long>                      m_llEvictions{0};
+
+    // MakeKey() -- PGR identity, then the image name.  The identity is prefixed by its kind so a path and a memory address
+    // can never produce the same key.
+    //
+    static std::string MakeKey(char cKind,const void * pIdentity,const char * sTopKey,const char * sFile)
+    {
+        char sIdentity[32];
+        snprintf(sIdentity,sizeof(sIdentity),"%c%p",cKind,pIdentity);
+        return MakeKey(sIdentity,sTopKey,sFile);
+    }
+    static std::string MakeKey(const char * sIdentity,const char * sTopKey,const char * sFile)
+    {
+        std::string sKey(sIdentity);
+        sKey += '|';
+        if (sTopKey) sKey += sTopKey;
+        sKey += '|';
+        if (sFile) sKey += sFile;
+        return sKey;
+    }
+
+    // Trim() -- Drop least-recently-used entries until the cache is within budget.  m_mutex must be held.
+    //
+    void Trim()
+    {
+        while (m_llMemUsed > m_llBudget && !m_lLRU.empty())
+        {
+            auto it = m_mapEntries.find(m_lLRU.back());
+            m_llMemUsed -= it->second.llSize;
+            m_mapEntries.erase(it);
+            m_lLRU.pop_back();
+            m_llEvictions.fetch_add(1,std::memory_order_relaxed);
+        }
+    }
+
+public:
+    CBitmapCache(long long llBudget = kDefaultBudget) : m_llBudget(llBudget) { }
+
+    // GetDefault() -- The process-wide cache.
+    //
+    static CBitmapCache & GetDefault()
+    {
+        static CBitmapCache cCache;
+        return cCache;
+    }
+
+    // SetBudget() -- Set the memory budget in bytes.  Images are dropped from the cache right away if it is over the new budget.
+    // A budget of 0 disables caching (images are still shared among the CSharedBitmap objects returned by a single Find()).
+    //
+    void SetBudget(long long llBudget)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_llBudget = llBudget < 0 ? 0 : llBudget;
+        Trim();
+    }
+
+    // Find() -- Return the cached bitmap for sKey, or an empty CSharedBitmap if it is not in the cache.
+    //
+    CSharedBitmap Find(const std::string & sKey)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_mapEntries.find(sKey);
+        if (it == m_mapEntries.end()) return CSharedBitmap();
+        m_lLRU.splice(m_lLRU.begin(),m_lLRU,it->second.itLRU);
+        return CSharedBitmap(it->second.cBitmap);
+    }
+
+    // Insert() -- Add a decoded bitmap to the cache.  If another thread added the same key first, that bitmap is returned
+    // (and cBitmap is discarded), so all callers end up sharing one copy.
+    //
+    CSharedBitmap Insert(const std::string & sKey,CBitmap && cBitmap)
+    {
+        auto & stBitmap = cBitmap.stBitmap;
+        if (!stBitmap.stMem) return CSharedBitmap();
+
+        auto cShared = std::make_shared<CBitmap>();
+        std::swap(cShared->stBitmap,stBitmap);
+        if (cShared->stBitmap.sMask) return CSharedBitmap(cShared);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_mapEntries.find(sKey);
+        if (it != m_mapEntries.end())
+        {
+            m_lLRU.splice(m_lLRU.begin(),m_lLRU,it->second.itLRU);
+            return CSharedBitmap(it->second.cBitmap);
+        }
+
+        long long llSize = cShared->stBitmap.iTotalSize;
+        if (llSize > m_llBudget) return CSharedBitmap(cShared);
+
+        m_lLRU.push_front(sKey);
+        m_mapEntries.emplace(sKey,Entry_t{ cShared,llSize,m_lLRU.begin() });
+        m_llMemUsed += llSize;
+        Trim();
+        return CSharedBitmap(cShared);
+    }
+
+    // GetBitmap() -- Return the cached bitmap for sKey, calling fnLoad() to decode it on a miss.
+    //
+    // fnLoad() is called without any lock held, so two threads missing on the same key at once may both decode it;
+    // the first one inserted is kept and shared.
+    //
+    CSharedBitmap GetBitmap(const std::string & sKey,const std::function<CBitmap()> & fnLoad)
+    {
+        auto cShared = Find(sKey);
+        if (cShared.isValid())
+        {
+            m_llHits.fetch_add(1,std::memory_order_relaxed);
+            return cShared;
+        }
+        m_llMisses.fetch_add(1,std::memory_order_relaxed);
+
+        SageProfileZone("CBitmapCache::Decode");
+        return Insert(sKey,fnLoad());
+    }
+
+    // ReadPgrBitmap() -- Cached CDavinci::ReadPgrBitmap().  The PGR is identified by its path (file) or address (memory).
+    //
+    CSharedBitmap ReadPgrBitmap(const char * sImageTitle,const char * sPgrPath,bool * bSuccess = nullptr)
+    {
+        auto cShared = GetBitmap(MakeKey((std::string("f") + (sPgrPath ? sPgrPath : "")).c_str(),nullptr,sImageTitle),
+                                 [&] { return CDavinci::ReadPgrBitmap(sImageTitle,sPgrPath); });
+        if (bSuccess) *bSuccess = cShared.isValid();
+        return cShared;
+    }
+    CSharedBitmap ReadPgrBitmap(const char * sImageTitle,const unsigned char * sPGRMemory,bool * bSuccess = nullptr)
+    {
+        auto cShared = GetBitmap(MakeKey('m',sPGRMemory,nullptr,sImageTitle),
+                                 [&] { return CDavinci::ReadPgrBitmap(sImageTitle,sPGRMemory); });
+        if (bSuccess) *bSuccess = cShared.isValid();
+        return cShared;
+    }
+
+    // ReadBitmap() -- Cached CSagePGR::ReadBitmap() and CPgrReader::ReadBitmap().  The PGR is identified by the object, so
+    // entries must be cleared with Clear() if the object is deleted and another PGR may be created at the same address.
+    //
+    CSharedBitmap ReadBitmap(CSagePGR & cPgr,const char * sTopKey,const char * sFile)
+    {
+        return GetBitmap(MakeKey('s',&cPgr,sTopKey,sFile),[&] { return sTopKey ? cPgr.ReadBitmap(sTopKey,sFile) : cPgr.ReadBitmap(sFile); });
+    }
+    CSharedBitmap ReadBitmap(CSagePGR & cPgr,const char * sFile) { return ReadBitmap(cPgr,nullptr,sFile); }
+
+    CSharedBitmap ReadBitmap(CPgrReader & cPgr,const char * sTopKey,const char * sFile)
+    {
+        return GetBitmap(MakeKey('r',&cPgr,sTopKey,sFile),[&] { return sTopKey ? cPgr.ReadBitmap(sTopKey,sFile) : cPgr.ReadBitmap(sFile); });
+    }
+    CSharedBitmap ReadBitmap(CPgrReader & cPgr,const char * sFile) { return ReadBitmap(cPgr,nullptr,sFile); }
+
+    // Clear() -- Drop all images from the cache (images still referred to by a CSharedBitmap stay valid).
+    //
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapEntries.clear();
+        m_lLRU.clear();
+        m_llMemUsed = 0;
+    }
+
+    Stats_t GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return { m_llHits.load(std::memory_order_relaxed),m_llMisses.load(std::memory_order_relaxed),
+                 m_llEvictions.load(std::memory_order_relaxed),m_llMemUsed,m_llBudget,(int) m_mapEntries.size() };
+    }
+};
+
+}; // namespace Sage
+#endif // _CBitmapCache_H_
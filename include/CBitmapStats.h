@@ -0,0 +1,350 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CBitmapStats -- Histograms and statistics for 24-bit bitmaps (RawBitmap_t / CBitmap)
+//
+// CBitmapStats builds per-channel (Red, Green, Blue) and Luminance histograms in one pass over the image, using
+// one sub-histogram per thread (each thread working on a band of rows), which are then merged with SSE2.
+// Counts are 64-bit (see Histogram_t).
+//
+// Once built, the histogram answers percentile, min/max, mean and standard deviation queries without
+// touching the image again, and can be updated for a changed sub-rectangle only (i.e. after painting or
+// a local edit), so that levels/curves controls can redraw interactively on large images.
+//
+// Example:
+//
+//      CBitmapStats cStats(cBitmap);
+//
+//      int iBlack = cStats.GetPercentile(StatChannel::Luminance,.005);
+//      int iWhite = cStats.GetPercentile(StatChannel::Luminance,.995);
+//      double fMean = cStats.GetMean(StatChannel::Red);
+//
+//      cStats.AutoLevel(cBitmap,.005,.995);        // Stretch black and white points in-place
+//
+// Luminance uses the integer Rec. 601 weights (77*R + 150*G + 29*B) >> 8.
+//
+#if !defined(_CBitmapStats_H_)
+#define _CBitmapStats_H_
+
+#include <vector>
+#include <cmath>
+#include <emmintrin.h>
+#include "Sage.h"
+#include "CRawBitmap.h"
+#include "CParallel.h"
+
+namespace Sage
+{
+
+enum class StatChannel
+{
+    Red         = 0,
+    Green       = 1,
+    Blue        = 2,
+    Luminance   = 3,
+};
+
+class CBitmapStats
+{
+public:
+    static constexpr int kNumChannels       = 4;
+    static constexpr int kMinRowsPerThread  = 64;       // Don't create threads for small images/bands
+
+    // Histogram_t -- Counts for each value (0-255) in each channel.  The channels are in StatChannel order.
+    //
+    // The counts are 64-bit, so a histogram accumulated with AddRect() over many images (or a CLargeBitmap, tile by tile)
+    // does not wrap at 4G pixels in one bin.
+    //
+    // Histogram_t is kept in std::vector and on the stack, neither of which guarantees 16-byte alignment (i.e. 32-bit
+    // heaps align to 8 bytes), so Merge() and Subtract() use unaligned loads and stores.
+    //
+    struct Histogram_t
+    {
+        unsigned long long ullCount[kNumChannels][256];
+
+        void Clear() { memset(ullCount,0,sizeof(ullCount)); }
+
+        // Merge() -- Add another histogram into this one, 2 counts at a time.
+        //
+        void Merge(const Histogram_t & stSource)
+        {
+            __m128i * pDest         = (__m128i *) &ullCount[0][0];
+            const __m128i * pSource = (const __m128i *) &stSource.ullCount[0][0];
+
+            for (int i=0;i<kNumChannels*256/2;i++)
+                _mm_storeu_si128(pDest+i,_mm_add_epi64(_mm_loadu_si128(pDest+i),_mm_loadu_si128(pSource+i)));
+        }
+
+        // Subtract() -- Remove another histogram's counts from this one (used for incremental updates)
+        //
+        void Subtract(const Histogram_t & stSource)
+        {
+            __m128i * pDest         = (__m128i *) &ullCount[0][0];
+            const __m128i * pSource = (const __m128i *) &stSource.ullCount[0][0];
+
+            for (int i=0;i<kNumChannels*256/2;i++)
+                _mm_storeu_si128(pDest+i,_mm_sub_epi64(_mm_loadu_si128(pDest+i),_mm_loadu_si128(pSource+i)));
+        }
+    };
+
+private:
+    Histogram_t m_stHist;
+    long long   m_llTotal       = 0;            // Total pixels counted
+    int         m_iMaxThreads   = 0;            // 0 = use hardware_concurrency()
+
+    static __forceinline int Luminance(int iRed,int iGreen,int iBlue) { return (77*iRed + 150*iGreen + 29*iBlue) >> 8; }
+
+    // CountRows() -- Count a band of rows into a (thread-local) histogram
+    //
+    static void CountRows(const RawBitmap_t & stBitmap,int iX,int iWidth,int iY1,int iY2,Histogram_t & stHist)
+    {
+        unsigned long long * ullRed     = stHist.ullCount[(int) StatChannel::Red];
+        unsigned long long * ullGreen   = stHist.ullCount[(int) StatChannel::Green];
+        unsigned long long * ullBlue    = stHist.ullCount[(int) StatChannel::Blue];
+        unsigned long long * ullLum     = stHist.ullCount[(int) StatChannel::Luminance];
+
+        for (int iY=iY1;iY<iY2;iY++)
+        {
+            const unsigned char * sLine = stBitmap.stMem + (long long) iY*stBitmap.iWidthBytes + iX*3;
+            for (int i=0;i<iWidth;i++)
+            {
+                int iBlue   = *sLine++;
+                int iGreen  = *sLine++;
+                int iRed    = *sLine++;
+                ullRed[iRed]++;
+                ullGreen[iGreen]++;
+                ullBlue[iBlue]++;
+                ullLum[Luminance(iRed,iGreen,iBlue)]++;
+            }
+        }
+    }
+
+    // ClipRect() -- Clip the requested area to the bitmap.  A size of { 0,0 } means the whole bitmap.
+    //
+    static bool ClipRect(const RawBitmap_t & stBitmap,POINT & pStart,SIZE & szSize)
+    {
+        if (!stBitmap.stMem || stBitmap.iWidth <= 0 || stBitmap.iHeight <= 0) return false;
+        if (!szSize.cx || !szSize.cy) { pStart = { 0,0 }; szSize = { stBitmap.iWidth, stBitmap.iHeight }; }
+        if (pStart.x < 0) { szSize.cx += pStart.x; pStart.x = 0; }
+        if (pStart.y < 0) { szSize.cy += pStart.y; pStart.y = 0; }
+        if (pStart.x + szSize.cx > stBitmap.iWidth)  szSize.cx = stBitmap.iWidth - pStart.x;
+        if (pStart.y + szSize.cy > stBitmap.iHeight) szSize.cy = stBitmap.iHeight - pStart.y;
+        return szSize.cx > 0 && szSize.cy > 0;
+    }
+
+    // Count() -- Build a histogram of an area of the bitmap, split into row bands across threads.
+    //
+    bool Count(const RawBitmap_t & stBitmap,POINT pStart,SIZE szSize,Histogram_t & stOut,long long & llPixels)
+    {
+        stOut.Clear();
+        llPixels = 0;
+        if (!ClipRect(stBitmap,pStart,szSize)) return false;
+
+        int iBands = CParallel::GetNumBands(szSize.cy,kMinRowsPerThread,m_iMaxThreads);
+        llPixels = (long long) szSize.cx*szSize.cy;
+
+        if (iBands == 1)
+        {
+            CountRows(stBitmap,pStart.x,szSize.cx,pStart.y,pStart.y + szSize.cy,stOut);
+            return true;
+        }
+
+        std::vector<Histogram_t> vHist(iBands);
+
+        CParallel::ForBands(szSize.cy,[&](int iY1,int iY2,int iBand)
+        {
+            vHist[iBand].Clear();
+            CountRows(stBitmap,pStart.x,szSize.cx,pStart.y + iY1,pStart.y + iY2,vHist[iBand]);
+        },kMinRowsPerThread,m_iMaxThreads);
+
+        for (auto & h : vHist) stOut.Merge(h);
+        return true;
+    }
+
+public:
+    CBitmapStats() { m_stHist.Clear(); }
+    CBitmapStats(const RawBitmap_t & stBitmap) { Build(stBitmap); }
+    CBitmapStats(CBitmap & cBitmap) { Build(*cBitmap); }
+
+    // SetMaxThreads() -- Set the maximum number of threads used to build histograms.  0 = number of cores (default)
+    //
+    void SetMaxThreads(int iMaxThreads) { m_iMaxThreads = iMaxThreads; }
+
+    // Build() -- Build the histogram for the entire bitmap, or for an area when pStart and szSize are given.
+    // Any previous histogram is replaced.
+    //
+    bool Build(const RawBitmap_t & stBitmap,POINT pStart = { 0,0 },SIZE szSize = { 0,0 })
+    {
+        return Count(stBitmap,pStart,szSize,m_stHist,m_llTotal);
+    }
+    bool Build(CBitmap & cBitmap,POINT pStart = { 0,0 },SIZE szSize = { 0,0 }) { return Build(*cBitmap,pStart,szSize); }
+
+    // RemoveRect() / AddRect() -- Incremental update for a changed area of the image.
+    //
+    // Call RemoveRect() with the area before it is changed, then AddRect() with the same area after the change.
+    // Only the changed area is scanned, so the histogram stays current during painting or local edits.
+    //
+    // Example:
+    //
+    //      cStats.RemoveRect(cBitmap,pStart,szSize);
+    //      ... draw into cBitmap in the rectangle ...
+    //      cStats.AddRect(cBitmap,pStart,szSize);
+    //
+    bool RemoveRect(const RawBitmap_t & stBitmap,POINT pStart,SIZE szSize)
+    {
+        Histogram_t stHist;
+        long long llPixels;
+        if (!Count(stBitmap,pStart,szSize,stHist,llPixels)) return false;
+        m_stHist.Subtract(stHist);
+        m_llTotal -= llPixels;
+        return true;
+    }
+    bool AddRect(const RawBitmap_t & stBitmap,POINT pStart,SIZE szSize)
+    {
+        Histogram_t stHist;
+        long long llPixels;
+        if (!Count(stBitmap,pStart,szSize,stHist,llPixels)) return false;
+        m_stHist.Merge(stHist);
+        m_llTotal += llPixels;
+        return true;
+    }
+
+    // UpdateRect() -- Incremental update when a copy of the area before the change is available.
+    //
+    // stBefore is a bitmap holding the old contents of the area (i.e. the size of szSize), and stBitmap is the
+    // changed image.  pStart is the location of the area in stBitmap.
+    //
+    bool UpdateRect(const RawBitmap_t & stBefore,const RawBitmap_t & stBitmap,POINT pStart)
+    {
+        if (!RemoveRect(stBefore,{ 0,0 },{ stBefore.iWidth, stBefore.iHeight })) return false;
+        return AddRect(stBitmap,pStart,{ stBefore.iWidth, stBefore.iHeight });
+    }
+
+    const Histogram_t & GetHistogram() const { return m_stHist; }
+    const unsigned long long * GetHistogram(StatChannel eChannel) const { return m_stHist.ullCount[(int) eChannel]; }
+    long long GetTotalPixels() const { return m_llTotal; }
+
+    // GetPercentile() -- Returns the value (0-255) below which fPercent (0.0-1.0) of the pixels fall.
+    // For example, GetPercentile(StatChannel::Luminance,.5) returns the median luminance.
+    //
+    int GetPercentile(StatChannel eChannel,double fPercent) const
+    {
+        if (m_llTotal <= 0) return 0;
+        if (fPercent < 0) fPercent = 0;
+        if (fPercent > 1) fPercent = 1;
+
+        const unsigned long long * ullCount = GetHistogram(eChannel);
+        long long llTarget = (long long) std::ceil(fPercent*(double) m_llTotal);
+        if (llTarget < 1) llTarget = 1;
+
+        long long llSum = 0;
+        for (int i=0;i<256;i++)
+        {
+            llSum += (long long) ullCount[i];
+            if (llSum >= llTarget) return i;
+        }
+        return 255;
+    }
+
+    // GetMin() / GetMax() -- Lowest and highest value present in the channel (-1 if the histogram is empty)
+    //
+    int GetMin(StatChannel eChannel) const
+    {
+        const unsigned long long * ullCount = GetHistogram(eChannel);
+        for (int i=0;i<256;i++) if (ullCount[i]) return i;
+        return -1;
+    }
+    int GetMax(StatChannel eChannel) const
+    {
+        const unsigned long long * ullCount = GetHistogram(eChannel);
+        for (int i=255;i>=0;i--) if (ullCount[i]) return i;
+        return -1;
+    }
+
+    // GetMean() -- Average value of the channel
+    //
+    double GetMean(StatChannel eChannel) const
+    {
+        if (m_llTotal <= 0) return 0;
+        const unsigned long long * ullCount = GetHistogram(eChannel);
+        double fSum = 0;
+        for (int i=0;i<256;i++) fSum += (double) i*(double) ullCount[i];
+        return fSum/(double) m_llTotal;
+    }
+
+    // GetStdDev() -- Standard deviation of the channel (population)
+    //
+    double GetStdDev(StatChannel eChannel) const
+    {
+        if (m_llTotal <= 0) return 0;
+        const unsigned long long * ullCount = GetHistogram(eChannel);
+        double fMean = GetMean(eChannel);
+        double fSum = 0;
+        for (int i=0;i<256;i++) fSum += (double) ullCount[i]*(i - fMean)*(i - fMean);
+        return std::sqrt(fSum/(double) m_llTotal);
+    }
+
+    // GetPeak() -- Largest count in the channel (useful for scaling a histogram display)
+    //
+    unsigned long long GetPeak(StatChannel eChannel) const
+    {
+        const unsigned long long * ullCount = GetHistogram(eChannel);
+        unsigned long long ullPeak = 0;
+        for (int i=0;i<256;i++) if (ullCount[i] > ullPeak) ullPeak = ullCount[i];
+        return ullPeak;
+    }
+
+    // ApplyLevels() -- Map the range [iBlack,iWhite] to [0,255] on all channels (in-place, multi-threaded),
+    // with an optional gamma (1.0 = linear)
+    //
+    static bool ApplyLevels(RawBitmap_t & stBitmap,int iBlack,int iWhite,double fGamma = 1.0)
+    {
+        if (!stBitmap.stMem || iWhite <= iBlack) return false;
+
+        unsigned char ucLUT[256];
+        double fRange = (double) (iWhite - iBlack);
+        double fInvGamma = fGamma > 0 ? 1.0/fGamma : 1.0;
+
+        for (int i=0;i<256;i++)
+        {
+            double f = (i - iBlack)/fRange;
+            f = f < 0 ? 0 : f > 1 ? 1 : f;
+            if (fInvGamma != 1.0) f = std::pow(f,fInvGamma);
+            ucLUT[i] = (unsigned char) (f*255.0 + .5);
+        }
+
+        auto fnRows = [&stBitmap,&ucLUT](int iY1,int iY2)
+        {
+            for (int iY=iY1;iY<iY2;iY++)
+            {
+                unsigned char * sLine = stBitmap.stMem + (long long) iY*stBitmap.iWidthBytes;
+                for (int i=0;i<stBitmap.iWidth*3;i++) sLine[i] = ucLUT[sLine[i]];
+            }
+        };
+
+        CParallel::ForBands(stBitmap.iHeight,[&fnRows](int iY1,int iY2,int) { fnRows(iY1,iY2); },kMinRowsPerThread);
+        return true;
+    }
+
+    // AutoLevel() -- Set the black and white points from the luminance histogram and apply them to the bitmap.
+    //
+    // fLowerThreshold and fUpperThreshold are percentiles (0.0-1.0), i.e. .005 and .995 clip 0.5% at each end.
+    // Using 0 and 1 stretches between the darkest and brightest luminance values.
+    //
+    // The same black and white points are applied to all three channels, so the color balance is kept.  This is not
+    // the same as CSageTools::NormalizeBitmap(), which stretches each channel between its own min and max.
+    //
+    // The histogram must have been built from the bitmap (with Build()).  The histogram is not updated
+    // after the bitmap is changed; call Build() again if it is needed.
+    //
+    bool AutoLevel(RawBitmap_t & stBitmap,double fLowerThreshold = 0,double fUpperThreshold = 1)
+    {
+        int iBlack = GetPercentile(StatChannel::Luminance,fLowerThreshold);
+        int iWhite = GetPercentile(StatChannel::Luminance,fUpperThreshold);
+        return ApplyLevels(stBitmap,iBlack,iWhite);
+    }
+    bool AutoLevel(CBitmap & cBitmap,double fLowerThreshold = 0,double fUpperThreshold = 1) { return AutoLevel(*cBitmap,fLowerThreshold,fUpperThreshold); }
+};
+
+}; // namespace Sage
+#endif // _CBitmapStats_H_
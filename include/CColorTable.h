@@ -0,0 +1,385 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CColorTable -- O(1) color name lookup for string colors ("Red", "lightyellow", "{db}", "bg=blue", etc.)
+//
+// Stock colors are kept in a perfect hash table generated by the compiler (see BuildStockHash()), so a lookup is one
+// case-insensitive hash, one table read and one name compare -- with no allocation and no search.
+//
+// User colors (MakeColor()) are kept in a separate open-addressing table, with the names interned into a block
+// arena so that the name pointers stay valid for the life of the program.  User colors take priority over stock colors,
+// so a stock color may be redefined.
+//
+// Lookups can be made with a length, so names can be resolved in-place inside format strings and markup such as
+// "{bg=blue}" without copying them out first.
+//
+// GetGeneration() changes each time a user color is added or changed, so callers that cache resolved colors (such as
+// compiled format strings) can tell when they need to resolve them again.
+//
+#if !defined(_CColorTable_H_)
+#define _CColorTable_H_
+
+#include <Windows.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <vector>
+
+namespace Sage
+{
+
+// CStockColorsT -- Stock color table and the constexpr helpers used to build its perfect hash at compile time.
+//
+// This is a template only so that the tables can be defined in this header (see the definitions after CStockHashT)
+// without C++17 inline variables.  Use CStockColors.
+//
+template <typename _t = void>
+class CStockColorsT
+{
+public:
+    struct StockColor_t
+    {
+        const char * sName;
+        unsigned char ucRed;
+        unsigned char ucGreen;
+        unsigned char ucBlue;
+    };
+
+    // Stock colors, including the short names used in conio/printf markup (i.e. {r}, {db}, {ly}).
+    //
+    // The short names are the full conio set (conio.GetColorNames()): the first letter of each base color, 'd' and 'l' in
+    // front for the dark and light versions, and "gy" for gray (so "dgy" and "lgy" for the dark and light grays).
+    //
+    static constexpr StockColor_t kStockColors[] =
+    {
+        { "black",          0,      0,      0   },
+        { "white",          255,    255,    255 },
+        { "w",              255,    255,    255 },
+        { "red",            255,    0,      0   },
+        { "r",              255,    0,      0   },
+        { "green",          0,      255,    0   },
+        { "g",              0,      255,    0   },
+        { "blue",           0,      0,      255 },
+        { "b",              0,      0,      255 },
+        { "cyan",           0,      255,    255 },
+        { "c",              0,      255,    255 },
+        { "magenta",        255,    0,      255 },
+        { "m",              255,    0,      255 },
+        { "purple",         255,    0,      255 },
+        { "p",              255,    0,      255 },
+        { "yellow",         255,    255,    0   },
+        { "y",              255,    255,    0   },
+        { "gray",           128,    128,    128 },
+        { "grey",           128,    128,    128 },
+        { "gy",             128,    128,    128 },
+        { "darkblue",       0,      0,      128 },
+        { "db",             0,      0,      128 },
+        { "darkgreen",      0,      128,    0   },
+        { "dg",             0,      128,    0   },
+        { "darkcyan",       0,      128,    128 },
+        { "dc",             0,      128,    128 },
+        { "darkred",        128,    0,      0   },
+        { "dr",             128,    0,      0   },
+        { "darkpurple",     128,    0,      128 },
+        { "dp",             128,    0,      128 },
+        { "darkmagenta",    128,    0,      128 },
+        { "dm",             128,    0,      128 },
+        { "darkyellow",     128,    128,    0   },
+        { "dy",             128,    128,    0   },
+        { "darkgray",       64,     64,     64  },
+        { "darkgrey",       64,     64,     64  },
+        { "dgy",            64,     64,     64  },
+        { "lightgray",      192,    192,    192 },
+        { "lightgrey",      192,    192,    192 },
+        { "lgy",            192,    192,    192 },
+        { "lightblue",      128,    128,    255 },
+        { "lb",             128,    128,    255 },
+        { "lightgreen",     128,    255,    128 },
+        { "lg",             128,    255,    128 },
+        { "lightred",       255,    128,    128 },
+        { "lr",             255,    128,    128 },
+        { "lightcyan",      128,    255,    255 },
+        { "lc",             128,    255,    255 },
+        { "lightyellow",    255,    255,    192 },
+        { "ly",             255,    255,    192 },
+        { "lightpurple",    255,    128,    255 },
+        { "lp",             255,    128,    255 },
+        { "lightmagenta",   255,    128,    255 },
+        { "lm",             255,    128,    255 },
+        { "orange",         255,    128,    0   },
+        { "skyblue",        135,    206,    235 },
+        { "pink",           255,    192,    203 },
+        { "brown",          150,    75,     0   },
+        { "gold",           255,    215,    0   },
+        { "beige",          245,    245,    220 },
+        { "ivory",          255,    255,    240 },
+        { "khaki",          240,    230,    140 },
+        { "lavender",       230,    230,    250 },
+        { "navy",           0,      0,      128 },
+        { "olive",          128,    128,    0   },
+        { "teal",           0,      128,    128 },
+        { "maroon",         128,    0,      0   },
+        { "silver",         192,    192,    192 },
+        { "lime",           0,      255,    0   },
+        { "aqua",           0,      255,    255 },
+        { "fuchsia",        255,    0,      255 },
+        { "violet",         238,    130,    238 },
+    };
+
+    static constexpr int kNumStockColors = (int) (sizeof(kStockColors)/sizeof(kStockColors[0]));
+
+    // Lower(), Length(), Hash() -- constexpr helpers used to build the stock table at compile time, and for lookups.
+    //
+    static constexpr unsigned char Lower(char c) { return (unsigned char) (c >= 'A' && c <= 'Z' ? c + ('a'-'A') : c); }
+    static constexpr int Length(const char * sString) { int iLen = 0; while (sString[iLen]) iLen++; return iLen; }
+
+    // Hash() -- Case-insensitive FNV-1a hash with a seed.
+    //
+    static constexpr unsigned int Hash(const char * sName,int iLength,unsigned int uiSeed = 0)
+    {
+        unsigned int uiHash = 2166136261u ^ uiSeed;
+        for (int i=0;i<iLength;i++) uiHash = (uiHash ^ Lower(sName[i]))*16777619u;
+        return uiHash ^ (uiHash >> 15);
+    }
+
+    // Equal() -- case-insensitive compare of a length-delimited name with a null-terminated name
+    //
+    static constexpr bool Equal(const char * sName,int iLength,const char * sTableName)
+    {
+        for (int i=0;i<iLength;i++)
+            if (!sTableName[i] || Lower(sName[i]) != Lower(sTableName[i])) return false;
+        return !sTableName[iLength];
+    }
+
+    static constexpr int kStockHashSize = 512;        // Power of 2, large enough that a seed is found quickly
+
+    struct StockHash_t
+    {
+        unsigned int uiSeed;
+        unsigned char ucIndex[kStockHashSize];        // Index into kStockColors, 0xFF = empty
+    };
+
+    static_assert(kNumStockColors < 255,"CStockColors: stock table too large for 8-bit index");
+
+    // BuildStockHash() -- Finds a seed with no collisions in the stock table.  Evaluated at compile time.
+    //
+    static constexpr StockHash_t BuildStockHash()
+    {
+        StockHash_t stHash{};
+        for (unsigned int uiSeed = 1;;uiSeed++)
+        {
+            for (int i=0;i<kStockHashSize;i++) stHash.ucIndex[i] = 0xFF;
+
+            bool bCollision = false;
+            for (int i=0;i<kNumStockColors && !bCollision;i++)
+            {
+                auto & stColor = kStockColors[i];
+                unsigned int uiSlot = Hash(stColor.sName,Length(stColor.sName),uiSeed) & (kStockHashSize-1);
+                if (stHash.ucIndex[uiSlot] != 0xFF) bCollision = true;
+                else stHash.ucIndex[uiSlot] = (unsigned char) i;
+            }
+            if (!bCollision)
+            {
+                stHash.uiSeed = uiSeed;
+                return stHash;
+            }
+        }
+    }
+};
+
+// CStockHashT -- The perfect hash of the stock table.  This is separate from CStockColorsT, since BuildStockHash()
+// can only be evaluated once that class is complete.
+//
+template <typename _t = void>
+struct CStockHashT : public CStockColorsT<_t>
+{
+    static constexpr typename CStockColorsT<_t>::StockHash_t kStockHash = CStockColorsT<_t>::BuildStockHash();
+};
+
+template <typename _t> constexpr typename CStockColorsT<_t>::StockColor_t CStockColorsT<_t>::kStockColors[];
+template <typename _t> constexpr typename CStockColorsT<_t>::StockHash_t CStockHashT<_t>::kStockHash;
+
+typedef CStockColorsT<> CStockColors;
+
+class CColorTable : public CStockHashT<>
+{
+public:
+
+    static constexpr DWORD StockRGB(int iIndex) { return RGB(kStockColors[iIndex].ucRed,kStockColors[iIndex].ucGreen,kStockColors[iIndex].ucBlue); }
+
+    // GetStockColor() -- Look up a stock color only.  May be used at compile time, e.g.
+    //
+    //      constexpr DWORD dwColor = CColorTable::GetStockColor("lightyellow");
+    //
+    // Returns dwDefault if the name is not a stock color.
+    //
+    static constexpr DWORD GetStockColor(const char * sName,DWORD dwDefault = 0)
+    {
+        int iIndex = FindStock(sName,Length(sName));
+        return iIndex < 0 ? dwDefault : StockRGB(iIndex);
+    }
+
+    static constexpr int FindStock(const char * sName,int iLength)
+    {
+        int iIndex = kStockHash.ucIndex[Hash(sName,iLength,kStockHash.uiSeed) & (kStockHashSize-1)];
+        if (iIndex == 0xFF || !Equal(sName,iLength,kStockColors[iIndex].sName)) return -1;
+        return iIndex;
+    }
+
+private:
+    struct UserColor_t
+    {
+        const char    * sName;          // Interned name (nullptr = empty slot)
+        unsigned int    uiHash;
+        DWORD           dwColor;
+    };
+
+    static constexpr int kNameBlockSize = 4096;
+    static constexpr int kMaxNameLength = 255;
+
+    struct Registry_t
+    {
+        std::shared_timed_mutex                 mtLock;
+        std::vector<UserColor_t>                vTable;                 // Open-addressing, power-of-2 size
+        int                                     iCount      = 0;
+        std::vector<std::unique_ptr<char[]>>    vNameBlocks;            // Interned name storage; never moved or freed
+        int                                     iBlockUsed  = kNameBlockSize;
+        std::atomic<unsigned int>               uiGeneration{0};
+        std::atomic<int>                        iAtomicCount{0};        // Lets lookups skip the lock when there are no user colors
+    };
+
+    static Registry_t & GetRegistry() { static Registry_t stRegistry; return stRegistry; }
+
+    // InternLocked() -- copy a name into the name arena (must be called with the write lock held)
+    //
+    static const char * InternLocked(Registry_t & stReg,const char * sName,int iLength)
+    {
+        if (stReg.iBlockUsed + iLength + 1 > kNameBlockSize)
+        {
+            stReg.vNameBlocks.emplace_back(new char[kNameBlockSize]);
+            stReg.iBlockUsed = 0;
+        }
+        char * sOut = stReg.vNameBlocks.back().get() + stReg.iBlockUsed;
+        for (int i=0;i<iLength;i++) sOut[i] = sName[i];
+        sOut[iLength] = 0;
+        stReg.iBlockUsed += iLength + 1;
+        return sOut;
+    }
+
+    static UserColor_t * FindUserLocked(Registry_t & stReg,const char * sName,int iLength,unsigned int uiHash)
+    {
+        if (stReg.vTable.empty()) return nullptr;
+        unsigned int uiMask = (unsigned int) stReg.vTable.size()-1;
+        for (unsigned int uiSlot = uiHash & uiMask;;uiSlot = (uiSlot+1) & uiMask)
+        {
+            auto & stEntry = stReg.vTable[uiSlot];
+            if (!stEntry.sName) return nullptr;
+            if (stEntry.uiHash == uiHash && Equal(sName,iLength,stEntry.sName)) return &stEntry;
+        }
+    }
+
+    static void InsertLocked(std::vector<UserColor_t> & vTable,const UserColor_t & stColor)
+    {
+        unsigned int uiMask = (unsigned int) vTable.size()-1;
+        unsigned int uiSlot = stColor.uiHash & uiMask;
+        while (vTable[uiSlot].sName) uiSlot = (uiSlot+1) & uiMask;
+        vTable[uiSlot] = stColor;
+    }
+
+public:
+    // MakeColor() -- Add or change a user color.  Returns the interned name, which remains valid for the life of the program.
+    //
+    // Returns nullptr if sName is empty or longer than kMaxNameLength.
+    //
+    static const char * MakeColor(const char * sName,DWORD dwColor)
+    {
+        if (!sName || !*sName) return nullptr;
+        int iLength = Length(sName);
+        if (iLength > kMaxNameLength) return nullptr;
+        unsigned int uiHash = Hash(sName,iLength);
+
+        auto & stReg = GetRegistry();
+        std::unique_lock<std::shared_timed_mutex> lock(stReg.mtLock);
+
+        if (auto * stEntry = FindUserLocked(stReg,sName,iLength,uiHash))
+        {
+            stEntry->dwColor = dwColor;
+            stReg.uiGeneration++;
+            return stEntry->sName;
+        }
+
+        // Keep the load factor under 1/2
+
+        if ((stReg.iCount+1)*2 > (int) stReg.vTable.size())
+        {
+            std::vector<UserColor_t> vNew(stReg.vTable.empty() ? 64 : stReg.vTable.size()*2,UserColor_t{});
+            for (auto & stEntry : stReg.vTable) if (stEntry.sName) InsertLocked(vNew,stEntry);
+            stReg.vTable.swap(vNew);
+        }
+
+        UserColor_t stColor = { InternLocked(stReg,sName,iLength), uiHash, dwColor };
+        InsertLocked(stReg.vTable,stColor);
+        stReg.iCount++;
+        stReg.iAtomicCount.store(stReg.iCount,std::memory_order_release);
+        stReg.uiGeneration++;
+        return stColor.sName;
+    }
+
+    // Intern() -- Returns the interned name for a user color, or nullptr if it is not a user color.
+    //
+    static const char * Intern(const char * sName)
+    {
+        if (!sName || !GetRegistry().iAtomicCount.load(std::memory_order_acquire)) return nullptr;
+        int iLength = Length(sName);
+        auto & stReg = GetRegistry();
+        std::shared_lock<std::shared_timed_mutex> lock(stReg.mtLock);
+        auto * stEntry = FindUserLocked(stReg,sName,iLength,Hash(sName,iLength));
+        return stEntry ? stEntry->sName : nullptr;
+    }
+
+    // GetColor() -- Look up a color name, user colors first, then stock colors.
+    //
+    // The length version does not need the name to be null-terminated, i.e. for names inside a format string.
+    // Returns false (and leaves dwColor unchanged) if the name is not found.
+    //
+    static bool GetColor(const char * sName,int iLength,DWORD & dwColor)
+    {
+        if (!sName || iLength <= 0) return false;
+
+        auto & stReg = GetRegistry();
+        if (stReg.iAtomicCount.load(std::memory_order_acquire))
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(stReg.mtLock);
+            if (auto * stEntry = FindUserLocked(stReg,sName,iLength,Hash(sName,iLength)))
+            {
+                dwColor = stEntry->dwColor;
+                return true;
+            }
+        }
+
+        int iIndex = FindStock(sName,iLength);
+        if (iIndex < 0) return false;
+        dwColor = StockRGB(iIndex);
+        return true;
+    }
+
+    static bool GetColor(const char * sName,DWORD & dwColor) { return sName && GetColor(sName,Length(sName),dwColor); }
+
+    // GetColor() -- Returns the color, or 0 (black) if not found.  pColorFound (optional) is set to whether the color was found.
+    //
+    static DWORD GetColor(const char * sName,bool * pColorFound = nullptr)
+    {
+        DWORD dwColor = 0;
+        bool bColorFound = GetColor(sName,dwColor);
+        if (pColorFound) *pColorFound = bColorFound;
+        return dwColor;
+    }
+
+    // GetGeneration() -- Changes whenever a user color is added or changed.
+    //
+    static unsigned int GetGeneration() { return GetRegistry().uiGeneration.load(std::memory_order_acquire); }
+};
+
+}; // namespace Sage
+#endif // _CColorTable_H_
@@ -0,0 +1,416 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CCompactString (CStrC) -- 32-byte string with the CString << and >> interface, for use where many strings are kept.
+//
+// CString keeps a 300-byte buffer inside every object so that short strings never allocate, which makes each CString
+// over 330 bytes even when empty.  CCompactString is 32 bytes:
+//
+//      -- Strings up to 22 characters are kept inside the object (a 23-byte buffer, including the terminating 0).
+//      -- Longer strings are allocated with malloc(), or from a CStringArena given to the constructor.
+//      -- Memory grows geometrically (at least 1.5x), so appending one piece at a time is amortized O(1).
+//
+// Streaming works the same as CString:
+//
+//      CStrC csText;
+//      csText << "Value = " << 1.5 << ", Count = " << iCount;     // Append
+//      csText >> "New text " << 12;                               // >> replaces the contents, then << appends
+//
+// Floating-point values use the CString "%g" default, which can be changed per string with fs() or
+// << CString::csFloatType{"%.3f"}, as with CString.  Numbers are formatted with CNumFormat.
+//
+// Arenas:
+//
+// A CStringArena hands out memory in large blocks and releases it all at once when it is deleted or Reset().  This
+// is useful for large numbers of strings with the same lifetime (i.e. a list-box model).  Strings using an arena must
+// not outlive it.  Memory for a string that grows is not returned to the arena until the arena is Reset().
+//
+// Instrumentation:
+//
+// CCompactString::GetMemStats() returns the current number of heap-allocated strings and their bytes (malloc and arena);
+// CStringArena::GetReserved()/GetUsed() report each arena.  GetMemSize() returns the memory used by one string.
+//
+#if !defined(_CCompactString_H_)
+#define _CCompactString_H_
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "CString.h"
+#include "CNumFormat.h"
+
+namespace Sage
+{
+
+// CStringArena -- Block allocator for CCompactString.  Not thread-safe: use one arena per thread (or lock around it).
+//
+class CStringArena
+{
+    static constexpr size_t kDefaultBlockSize = 64*1024;
+
+    std::vector<char *> m_vBlocks;
+    size_t m_szBlockSize;
+    size_t m_szBlockUsed    = 0;
+    size_t m_szBlockEnd     = 0;        // Size of the current block
+    size_t m_szReserved     = 0;
+    size_t m_szUsed         = 0;
+
+public:
+    CStringArena(size_t szBlockSize = kDefaultBlockSize) : m_szBlockSize(szBlockSize < 1024 ? 1024 : szBlockSize) { }
+    ~CStringArena() { Reset(); }
+    CStringArena(const CStringArena &) = delete;
+    CStringArena & operator = (const CStringArena &) = delete;
+
+    // Allocate() -- Returns szSize bytes, 8-byte aligned.  Returns nullptr on failure.
+    //
+    char * Allocate(size_t szSize)
+    {
+        szSize = (szSize + 7) & ~(size_t) 7;
+        if (m_vBlocks.empty() || m_szBlockUsed + szSize > m_szBlockEnd)
+        {
+            size_t szNew = szSize > m_szBlockSize/4 ? szSize : m_szBlockSize;   // Large strings get their own block
+            char * sBlock = (char *) malloc(szNew);
+            if (!sBlock) return nullptr;
+
+            // Keep the current block active if the new one is a dedicated large block
+
+            if (szNew != m_szBlockSize && !m_vBlocks.empty())
+            {
+                m_vBlocks.insert(m_vBlocks.end()-1,sBlock);
+                m_szReserved += szNew;
+                m_szUsed += szSize;
+                return sBlock;
+            }
+            m_vBlocks.push_back(sBlock);
+            m_szBlockUsed = 0;
+            m_szBlockEnd = szNew;
+            m_szReserved += szNew;
+        }
+        char * sOut = m_vBlocks.back() + m_szBlockUsed;
+        m_szBlockUsed += szSize;
+        m_szUsed += szSize;
+        return sOut;
+    }
+
+    // Reset() -- Release all memory.  All strings using this arena become invalid.
+    //
+    void Reset()
+    {
+        for (auto sBlock : m_vBlocks) free(sBlock);
+        m_vBlocks.clear();
+        m_szBlockUsed = m_szBlockEnd = m_szReserved = m_szUsed = 0;
+    }
+
+    size_t GetReserved() const  { return m_szReserved; }       // Bytes allocated from the system
+    size_t GetUsed() const      { return m_szUsed; }           // Bytes handed out to strings (including memory left behind by growth)
+};
+
+class CCompactString
+{
+public:
+    static constexpr int kSSOSize       = 23;                  // Bytes of in-object storage, including the terminating 0
+    static constexpr int kMaxSSOLength  = kSSOSize-1;
+
+    struct MemStats_t
+    {
+        long long llHeapStrings;        // Strings currently using malloc() memory
+        long long llHeapBytes;          // Bytes of malloc() memory held by strings
+        long long llArenaStrings;       // Strings currently using arena memory
+        long long llArenaBytes;         // Bytes of arena memory held by strings (current allocation only)
+    };
+
+private:
+    static constexpr unsigned char kHeapFlag    = 0x80;
+    static constexpr unsigned char kStyleMask   = 0x7F;
+    static constexpr int kMaxStyles             = 128;
+
+    // Storage.  In SSO mode the text is in sSSO[]; in heap mode stHeap.sData points to it.  The last byte (Tag())
+    // is outside stHeap, and holds the heap flag and the float style index in both modes.
+
+    union
+    {
+        char sSSO[kSSOSize+1];
+        struct
+        {
+            char          * sData;
+            unsigned int    uiLength;
+            unsigned int    uiCapacity;         // Not including the terminating 0
+        } stHeap;
+    };
+    CStringArena * m_cArena = nullptr;
+
+    unsigned char & Tag() { return (unsigned char &) sSSO[kSSOSize]; }
+    unsigned char Tag() const { return (unsigned char) sSSO[kSSOSize]; }
+
+    struct Stats_t
+    {
+        std::atomic<long long> llHeapStrings{0};
+        std::atomic<long long> llHeapBytes{0};
+        std::atomic<long long> llArenaStrings{0};
+        std::atomic<long long> llArenaBytes{0};
+    };
+    static Stats_t & GetStats() { static Stats_t stStats; return stStats; }
+
+    // Float styles are interned in a small global table, so each string needs only a 7-bit index (0 = "%g").
+
+    struct Styles_t
+    {
+        std::mutex mtLock;
+        char sStyles[kMaxStyles][16] = { "%g" };
+        int iCount = 1;
+    };
+    static Styles_t & GetStyles() { static Styles_t stStyles; return stStyles; }
+
+    static int InternStyle(const char * sStyle)
+    {
+        if (!sStyle || !*sStyle || strlen(sStyle) >= 16) return 0;
+        auto & stStyles = GetStyles();
+        std::lock_guard<std::mutex> lock(stStyles.mtLock);
+        for (int i=0;i<stStyles.iCount;i++) if (!strcmp(stStyles.sStyles[i],sStyle)) return i;
+        if (stStyles.iCount == kMaxStyles) return 0;
+        strcpy(stStyles.sStyles[stStyles.iCount],sStyle);
+        return stStyles.iCount++;
+    }
+
+    bool isHeap() const { return (Tag() & kHeapFlag) != 0; }
+    int GetStyleIndex() const { return Tag() & kStyleMask; }
+
+    void FreeHeap()
+    {
+        if (!isHeap()) return;
+        auto & stStats = GetStats();
+        if (m_cArena)
+        {
+            stStats.llArenaStrings--;
+            stStats.llArenaBytes -= stHeap.uiCapacity+1;
+        }
+        else
+        {
+            stStats.llHeapStrings--;
+            stStats.llHeapBytes -= stHeap.uiCapacity+1;
+            free(stHeap.sData);
+        }
+    }
+
+    // Grow() -- Make room for at least uiNeeded characters (plus the terminating 0).  Returns false on allocation failure.
+    //
+    bool Grow(unsigned int uiNeeded)
+    {
+        unsigned int uiCapacity = GetCapacity();
+        if (uiNeeded <= uiCapacity) return true;
+
+        unsigned int uiNew = uiCapacity + uiCapacity/2;
+        if (uiNew < uiNeeded) uiNew = uiNeeded;
+        if (uiNew < 2*kSSOSize-1) uiNew = 2*kSSOSize-1;
+
+        unsigned int uiLength = GetLength();
+        char * sNew;
+        auto & stStats = GetStats();
+
+        if (m_cArena)
+        {
+            sNew = m_cArena->Allocate(uiNew+1);
+            if (!sNew) return false;
+            memcpy(sNew,c_str(),uiLength+1);
+            if (isHeap()) stStats.llArenaBytes -= stHeap.uiCapacity+1;
+            else stStats.llArenaStrings++;
+            stStats.llArenaBytes += uiNew+1;
+        }
+        else if (isHeap())
+        {
+            sNew = (char *) realloc(stHeap.sData,uiNew+1);
+            if (!sNew) return false;
+            stStats.llHeapBytes += uiNew-stHeap.uiCapacity;
+        }
+        else
+        {
+            sNew = (char *) malloc(uiNew+1);
+            if (!sNew) return false;
+            memcpy(sNew,sSSO,uiLength+1);
+            stStats.llHeapStrings++;
+            stStats.llHeapBytes += uiNew+1;
+        }
+
+        stHeap.sData        = sNew;
+        stHeap.uiLength     = uiLength;
+        stHeap.uiCapacity   = uiNew;
+        Tag()            |= kHeapFlag;
+        return true;
+    }
+
+    void SetLength(unsigned int uiLength)
+    {
+        if (isHeap()) { stHeap.uiLength = uiLength; stHeap.sData[uiLength] = 0; }
+        else sSSO[uiLength] = 0;
+    }
+
+public:
+    CCompactString(CStringArena * cArena = nullptr) : m_cArena(cArena) { sSSO[0] = 0; Tag() = 0; }
+    CCompactString(const char * sString,CStringArena * cArena = nullptr) : m_cArena(cArena) { sSSO[0] = 0; Tag() = 0; Append(sString); }
+    CCompactString(const CCompactString & p2) : m_cArena(p2.m_cArena)
+    {
+        sSSO[0] = 0;
+        Tag() = (unsigned char) p2.GetStyleIndex();
+        Append(p2.c_str(),p2.GetLength());
+    }
+    CCompactString(CCompactString && p2) noexcept : m_cArena(p2.m_cArena)
+    {
+        memcpy(sSSO,p2.sSSO,sizeof(sSSO));      // Copies the heap pointer/length/capacity in heap mode
+        p2.Tag() &= kStyleMask;
+        p2.sSSO[0] = 0;
+    }
+    ~CCompactString() { FreeHeap(); }
+
+    CCompactString & operator = (const CCompactString & p2)
+    {
+        if (&p2 == this) return *this;
+        Clear();
+        Tag() = (unsigned char) ((Tag() & kHeapFlag) | p2.GetStyleIndex());
+        return Append(p2.c_str(),p2.GetLength());
+    }
+    CCompactString & operator = (CCompactString && p2) noexcept
+    {
+        if (&p2 == this) return *this;
+        if (m_cArena != p2.m_cArena) return *this = (const CCompactString &) p2;   // Different arenas -- copy instead
+        FreeHeap();
+        memcpy(sSSO,p2.sSSO,sizeof(sSSO));
+        Tag() = p2.Tag();
+        p2.Tag() &= kStyleMask;
+        p2.sSSO[0] = 0;
+        return *this;
+    }
+    CCompactString & operator = (const char * sString) { if (sString != c_str()) { Clear(); Append(sString); } return *this; }
+
+    const char * c_str() const  { return isHeap() ? stHeap.sData : sSSO; }
+    const char * str() const    { return c_str(); }
+    char * GetBuffer()          { return isHeap() ? stHeap.sData : sSSO; }
+    operator const char * () const { return c_str(); }
+    const char * operator * () const { return c_str(); }
+
+    unsigned int GetLength() const      { return isHeap() ? stHeap.uiLength : (unsigned int) strlen(sSSO); }
+    unsigned int GetCapacity() const    { return isHeap() ? stHeap.uiCapacity : kMaxSSOLength; }
+    bool isEmpty() const                { return !*c_str(); }
+    bool isSSO() const                  { return !isHeap(); }
+    CStringArena * GetArena() const     { return m_cArena; }
+
+    // GetMemSize() -- Memory used by this string: the object plus any allocated memory.
+    //
+    size_t GetMemSize() const { return sizeof(*this) + (isHeap() ? stHeap.uiCapacity+1 : 0); }
+
+    // Clear() -- Empty the string, keeping its memory.
+    //
+    void Clear() { SetLength(0); }
+
+    // Reserve() -- Make sure there is room for iLength characters without reallocating.
+    //
+    bool Reserve(int iLength) { return iLength <= 0 || Grow((unsigned int) iLength); }
+
+    // ShrinkToFit() -- Move the string back into the object (if short enough) or reduce its allocation (malloc only).
+    //
+    void ShrinkToFit()
+    {
+        if (!isHeap() || m_cArena) return;
+        unsigned int uiLength = stHeap.uiLength;
+        if (uiLength <= (unsigned int) kMaxSSOLength)
+        {
+            char sTemp[kSSOSize];
+            memcpy(sTemp,stHeap.sData,uiLength+1);
+            FreeHeap();
+            memcpy(sSSO,sTemp,uiLength+1);
+            Tag() &= kStyleMask;
+            return;
+        }
+        char * sNew = (char *) realloc(stHeap.sData,uiLength+1);
+        if (!sNew) return;
+        GetStats().llHeapBytes -= stHeap.uiCapacity-uiLength;
+        stHeap.sData = sNew;
+        stHeap.uiCapacity = uiLength;
+    }
+
+    // Append() -- Add iCount characters (or up to the terminating 0 if iCount < 0).
+    //
+    CCompactString & Append(const char * sString,int iCount = -1)
+    {
+        if (!sString) return *this;
+        unsigned int uiAdd = iCount < 0 ? (unsigned int) strlen(sString) : (unsigned int) iCount;
+        if (!uiAdd) return *this;
+
+        unsigned int uiLength = GetLength();
+
+        // Handle appending part of ourselves, which may move when growing
+
+        const char * sStart = c_str();
+        if (sString >= sStart && sString <= sStart + uiLength)
+        {
+            size_t szOffset = sString - sStart;
+            if (!Grow(uiLength + uiAdd)) return *this;
+            sString = c_str() + szOffset;
+        }
+        else if (!Grow(uiLength + uiAdd)) return *this;
+
+        memmove(GetBuffer() + uiLength,sString,uiAdd);
+        SetLength(uiLength + uiAdd);
+        return *this;
+    }
+
+    CCompactString & Append(char cChar) { return Append(&cChar,1); }
+
+    // fs() -- Set the floating-point style (i.e. "%.3f") for this string.  fs() with no style restores the default ("%g").
+    //
+    CCompactString & fs(const char * sStyle = nullptr)
+    {
+        Tag() = (unsigned char) ((Tag() & kHeapFlag) | InternStyle(sStyle));
+        return *this;
+    }
+
+    const char * GetFloatStyle() const { return GetStyles().sStyles[GetStyleIndex()]; }
+
+    CCompactString & AddNumber(long long llValue)           { char sNum[CNumFormat::kMaxText]; return Append(sNum,CNumFormat::IntToText(sNum,llValue)); }
+    CCompactString & AddNumber(unsigned long long ullValue) { char sNum[CNumFormat::kMaxText]; return Append(sNum,CNumFormat::UIntToText(sNum,ullValue)); }
+    CCompactString & AddDouble(double fValue)
+    {
+        char sNum[CNumFormat::kMaxFormatText];
+        int iStyle = GetStyleIndex();
+        return Append(sNum,CNumFormat::Format(sNum,fValue,iStyle ? GetStyles().sStyles[iStyle] : nullptr));
+    }
+
+    CCompactString & operator << (const char * x)              { return Append(x);                          }
+    CCompactString & operator << (const std::string & x)       { return Append(x.c_str(),(int) x.length()); }
+    CCompactString & operator << (const CCompactString & x)    { return Append(x.c_str(),(int) x.GetLength()); }
+    CCompactString & operator << (char x)                      { return Append(x);                          }
+    CCompactString & operator << (int x)                       { return AddNumber((long long) x);           }
+    CCompactString & operator << (long x)                      { return AddNumber((long long) x);           }
+    CCompactString & operator << (long long x)                 { return AddNumber(x);                       }
+    CCompactString & operator << (unsigned int x)              { return AddNumber((unsigned long long) x);  }
+    CCompactString & operator << (unsigned long x)             { return AddNumber((unsigned long long) x);  }
+    CCompactString & operator << (unsigned long long x)        { return AddNumber(x);                       }
+    CCompactString & operator << (double x)                    { return AddDouble(x);                       }
+    CCompactString & operator << (CString::csFloatType x)      { return fs(x.sFloatStyle);                  }
+
+    // >> replaces the contents of the string, as with CString
+
+    template <typename _t>
+    CCompactString & operator >> (const _t & x)                { Clear(); return *this << x; }
+    CCompactString & operator >> (const char * x)              { if (x != c_str()) { Clear(); Append(x); } return *this; }
+
+    bool operator == (const char * sString) const { return sString && !strcmp(c_str(),sString); }
+    bool operator != (const char * sString) const { return !(*this == sString); }
+
+    // GetMemStats() -- Totals for all CCompactString objects (see notes at the top of this file)
+    //
+    static MemStats_t GetMemStats()
+    {
+        auto & stStats = GetStats();
+        return { stStats.llHeapStrings.load(), stStats.llHeapBytes.load(), stStats.llArenaStrings.load(), stStats.llArenaBytes.load() };
+    }
+};
+
+using CStrC = CCompactString;
+
+static_assert(sizeof(CCompactString) == 32 || sizeof(void *) != 8,"CCompactString: expected 32 bytes on 64-bit builds");
+
+}; // namespace Sage
+#endif // _CCompactString_H_
@@ -0,0 +1,133 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CCrc32c -- CRC-32C (Castagnoli), using the SSE4.2 CRC32 instruction when the CPU has it.
+//
+// With SSE4.2 the CRC is computed 8 bytes per instruction (several GB/sec), so checking even large data blocks costs
+// little compared to reading them.  Other CPUs use an 8-way table (slicing-by-8).  Both give the same result.
+//
+//      unsigned int uiCrc = CCrc32c::Compute(pData,szSize);
+//      uiCrc = CCrc32c::Compute(pMore,szMore,uiCrc);           // Continue a CRC over more data
+//
+#if !defined(_CCrc32c_H_)
+#define _CCrc32c_H_
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define _CCrc32c_Hardware_
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace Sage
+{
+
+class CCrc32c
+{
+    struct Table_t
+    {
+        unsigned int uiTable[8][256];
+
+        Table_t()
+        {
+            for (unsigned int i=0;i<256;i++)
+            {
+                unsigned int uiCrc = i;
+                for (int j=0;j<8;j++) uiCrc = (uiCrc >> 1) ^ (0x82F63B78u & (0u-(uiCrc & 1)));
+                uiTable[0][i] = uiCrc;
+            }
+            for (int i=0;i<256;i++)
+                for (int j=1;j<8;j++) uiTable[j][i] = (uiTable[j-1][i] >> 8) ^ uiTable[0][uiTable[j-1][i] & 0xFF];
+        }
+    };
+
+    static const Table_t & GetTable() { static Table_t stTable; return stTable; }
+
+    static unsigned int UpdateSoftware(const unsigned char * p,size_t szSize,unsigned int uiCrc)
+    {
+        auto & t = GetTable().uiTable;
+
+        for (;szSize >= 8;p += 8,szSize -= 8)
+        {
+            unsigned int uiLow,uiHigh;
+            memcpy(&uiLow,p,4);
+            memcpy(&uiHigh,p+4,4);
+            uiLow ^= uiCrc;
+            uiCrc = t[7][uiLow & 0xFF] ^ t[6][(uiLow >> 8) & 0xFF] ^ t[5][(uiLow >> 16) & 0xFF] ^ t[4][uiLow >> 24] ^
+                    t[3][uiHigh & 0xFF] ^ t[2][(uiHigh >> 8) & 0xFF] ^ t[1][(uiHigh >> 16) & 0xFF] ^ t[0][uiHigh >> 24];
+        }
+        while (szSize--) uiCrc = (uiCrc >> 8) ^ t[0][(uiCrc ^ *p++) & 0xFF];
+        return uiCrc;
+    }
+
+#if defined(_CCrc32c_Hardware_)
+#if !defined(_MSC_VER)
+    __attribute__((target("sse4.2")))
+#endif
+    static unsigned int UpdateHardware(const unsigned char * p,size_t szSize,unsigned int uiCrc)
+    {
+        unsigned long long ullCrc = uiCrc;
+
+        for (;szSize && ((size_t) p & 7);szSize--) ullCrc = _mm_crc32_u8((unsigned int) ullCrc,*p++);
+        for (;szSize >= 8;p += 8,szSize -= 8)
+        {
+            unsigned long long ullValue;
+            memcpy(&ullValue,p,8);
+            ullCrc = _mm_crc32_u64(ullCrc,ullValue);
+        }
+        for (;szSize;szSize--) ullCrc = _mm_crc32_u8((unsigned int) ullCrc,*p++);
+        return (unsigned int) ullCrc;
+    }
+#endif
+
+public:
+    // isHardware() -- true if the CPU has the SSE4.2 CRC32 instruction (checked once)
+    //
+    static bool isHardware()
+    {
+#if defined(_CCrc32c_Hardware_)
+        static const bool bHardware = []
+        {
+#if defined(_MSC_VER)
+            int iInfo[4];
+            __cpuid(iInfo,1);
+            return (iInfo[2] & (1 << 20)) != 0;
+#else
+            unsigned int a,b,c,d;
+            return __get_cpuid(1,&a,&b,&c,&d) && (c & (1 << 20)) != 0;
+#endif
+        }();
+        return bHardware;
+#else
+        return false;
+#endif
+    }
+
+    // Compute() -- CRC-32C of a block of memory.  Pass the previous result as uiCrc to continue a CRC over more data.
+    //
+    static unsigned int Compute(const void * pData,size_t szSize,unsigned int uiCrc = 0)
+    {
+        auto p = (const unsigned char *) pData;
+        uiCrc = ~uiCrc;
+#if defined(_CCrc32c_Hardware_)
+        if (isHardware()) return ~UpdateHardware(p,szSize,uiCrc);
+#endif
+        return ~UpdateSoftware(p,szSize,uiCrc);
+    }
+
+    // ComputeSoftware() -- CRC-32C without the CRC32 instruction (for testing and comparison)
+    //
+    static unsigned int ComputeSoftware(const void * pData,size_t szSize,unsigned int uiCrc = 0)
+    {
+        return ~UpdateSoftware((const unsigned char *) pData,szSize,~uiCrc);
+    }
+};
+
+}; // namespace Sage
+#endif // _CCrc32c_H_
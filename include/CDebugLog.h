@@ -0,0 +1,659 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CDebugLog -- High-rate debug logging channel (for the Quick C++ debug window, CProcessWindow, and other log views)
+//
+// CProcessWindow::printf() formats into one shared line buffer and translates the line for its window as it is written,
+// so heavy debug output from several worker threads contends for the window and slows the program being debugged.
+// CDebugLog moves all of that work off the writing threads:
+//
+//      Log()       -- Writes a binary record (the format string pointer, a timestamp and the raw arguments) into a ring
+//                     owned by the calling thread.  No formatting, no lock, no allocation, no shared cache line: a few
+//                     stores and one release store, i.e. nanoseconds.  If the ring is full, the record is dropped and
+//                     counted (GetDropped()) -- the program being debugged is never held up by the log.
+//      Drain()     -- The window's thread collects the records from every thread's ring, in time order, into a history
+//                     of the last N records (still binary).
+//      GetLine()   -- Formats one record from the history.  A view formats only the lines it is showing, i.e. with a
+//                     CVirtualListBox in callback mode:
+//
+//                          cList.GetModel().SetCallback(0,[&](int iRow,std::string & s)
+//                              { cLog.GetLine(cLog.GetFirstIndex()+iRow,s); return s.c_str(); });
+//                          ...
+//                          if (cLog.Drain()) { cList.GetModel().SetCount(cLog.GetCount()); cList.Refresh(); }
+//
+//                     or, for the CProcessWindow debug window, write the lines it will show:
+//
+//                          cLog.Drain(); cLog.ForEachNew([&](const char * sLine) { cProcessWin.Write(sLine); });
+//
+//      SetSpillFile() -- Optionally, every drained record is also formatted and appended to a text file, so nothing that
+//                     reached the ring is lost when it leaves the history.  This is done by Drain(), not the writers.
+//
+// Rings: each thread that logs gets a ring the first time it logs, and gives it back when it exits.  Drain() collects what
+// is left in the ring of a thread that has exited, then marks the ring free, and the next new thread to log reuses it -- so
+// the number of rings (and their memory) follows the number of threads logging at the same time, not the number of threads
+// ever created.
+//
+// Formats are printf() formats with Sagebox markup ({g}, {bg=blue}, {/}), compiled and cached by CFormatCache.  Because
+// only the pointer is stored, the format must be a string literal (or otherwise outlive the log).  Arguments are
+// captured by value; strings are copied (up to kMaxString characters).
+//
+// Example:
+//
+//      CDebugLog::GetDefault().Log("Worker %d: batch {g}%d{/} done in %.2f ms",iWorker,iBatch,fMs);
+//
+#if !defined(_CDebugLog_H_)
+#define _CDebugLog_H_
+
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "CFormatCache.h"
+
+namespace Sage
+{
+
+class CDebugLog
+{
+public:
+    static constexpr int kDefaultRingBytes      = 256*1024;     // Per writing thread
+    static constexpr int kDefaultHistory        = 2000;         // Records kept by Drain() (the debug window keeps 2000 lines)
+    static constexpr int kMaxString             = 1024;         // Longer string arguments are cut
+
+private:
+    enum ArgTag : unsigned char { TagInt = 'I', TagUInt = 'U', TagDouble = 'D', TagString = 'S', TagPointer = 'P' };
+
+    struct alignas(8) Header_t
+    {
+        uint32_t        uiSize;             // Whole record, including this header, rounded up to 8
+        uint16_t        usNumArgs;
+        uint16_t        usThread;           // Index of the writing thread's ring
+        const char    * sFormat;            // nullptr for padding at the end of the ring
+        int64_t         llTime;             // steady_clock ticks
+    };
+
+    enum RingState : int { RingActive, RingRetired, RingFree };    // Retired: the thread has exited; Free: drained, ready for reuse
+
+    // CRing -- Single-writer, single-reader byte ring.  Positions only increase; the index is the position & mask.
+    //          The writer's and reader's positions are on separate cache lines.
+
+    struct CRing
+    {
+        std::unique_ptr<char[]>     pData;
+        uint64_t                    ullMask;
+        uint16_t                    usThread;
+        std::atomic<int>            iState{RingActive};
+        std::atomic<bool>           bLogAlive{true};               // Cleared by ~CDebugLog()
+
+        char                                cPadHead[64];       // (C++14 new ignores alignas(64), so the lines are padded apart)
+        std::atomic<uint64_t>               ullHead{0};        // Written by the logging thread
+        uint64_t                            ullCachedTail = 0;  // Logging thread's last view of ullTail
+        std::atomic<uint64_t>               ullDropped{0};
+        std::atomic<uint64_t>               ullWritten{0};
+
+        char                                cPadTail[64];
+        std::atomic<uint64_t>               ullTail{0};        // Written by Drain()
+
+        CRing(int iBytes,uint16_t usIndex) : pData(new char[iBytes]),ullMask(iBytes-1),usThread(usIndex) { }
+    };
+
+    struct Entry_t
+    {
+        std::string     sRecord;            // Copy of the record (header + arguments); the capacity is reused
+    };
+
+    // RingOwner_t -- The calling thread's rings (one per log it has used).  Its destructor runs when the thread exits and
+    //                retires the rings, so Drain() can collect what is left in them and then reuse them.
+
+    struct RingOwner_t
+    {
+        struct Entry_t { uint64_t ullId; std::shared_ptr<CRing> pRing; };
+        std::vector<Entry_t>    vRings;
+
+        ~RingOwner_t() { for (auto & stEntry : vRings) stEntry.pRing->iState.store(RingRetired,std::memory_order_release); }
+    };
+
+    int                                 m_iRingBytes;
+    uint64_t                            m_ullId;                    // Tells this log from one later created at the same address
+    std::mutex                          m_mtRings;                  // Only taken when a thread first logs, and by Drain()
+    std::vector<std::shared_ptr<CRing>> m_vRings;                   // Shared with the RingOwner_t of the thread using each ring
+    std::atomic<int>                    m_iNumRings{0};
+
+    std::vector<Entry_t>                m_vHistory;
+    uint64_t                            m_ullCount      = 0;        // Records drained so far (the next record's index)
+    uint64_t                            m_ullReported   = 0;        // ForEachNew() position
+
+    FILE                              * m_fpSpill       = nullptr;
+    uint64_t                            m_ullSpilled    = 0;
+
+    static uint64_t NextId()
+    {
+        static std::atomic<uint64_t> ullId{0};
+        return ++ullId;
+    }
+
+    // ArgSize(), PutArg() -- Size and encoding of each argument type (tag byte, then the value)
+
+    template <typename _t>
+    static constexpr bool isString()
+    {
+        using _d = typename std::decay<_t>::type;
+        return std::is_same<_d,char *>::value || std::is_same<_d,const char *>::value;
+    }
+
+    // ArgKind_t -- How an argument type is stored, for PutArg() and ArgSize()
+
+    enum ArgKind : int { ArgString, ArgStdString, ArgFloat, ArgPointer, ArgEnum, ArgSigned, ArgUnsigned };
+
+    template <typename _t>
+    using ArgKind_t = std::integral_constant<int,isString<_t>() ? ArgString : std::is_same<_t,std::string>::value ? ArgStdString :
+                                                 std::is_floating_point<_t>::value ? ArgFloat :
+                                                 std::is_pointer<_t>::value || std::is_same<_t,std::nullptr_t>::value ? ArgPointer :
+                                                 std::is_enum<_t>::value ? ArgEnum : std::is_signed<_t>::value ? ArgSigned : ArgUnsigned>;
+
+    static int StringLength(const char * sText)
+    {
+        if (!sText) return 6;                                       // "(null)"
+        const void * pEnd = memchr(sText,0,kMaxString);
+        return pEnd ? (int) ((const char *) pEnd - sText) : kMaxString;
+    }
+
+    static int StringLength(const std::string & sText) { return sText.size() < (size_t) kMaxString ? (int) sText.size() : kMaxString; }
+
+    template <typename _t> static int ArgSize(const _t & xArg,std::integral_constant<int,ArgString>)     { return 1 + 2 + StringLength(xArg); }
+    template <typename _t> static int ArgSize(const _t & xArg,std::integral_constant<int,ArgStdString>)  { return 1 + 2 + StringLength(xArg); }
+    template <typename _t,int _Kind> static int ArgSize(const _t &,std::integral_constant<int,_Kind>)    { return 1 + 8; }
+
+    template <typename _t>
+    static int ArgSize(const _t & xArg) { return ArgSize(xArg,ArgKind_t<_t>()); }
+
+    static char * PutValue(char * pOut,ArgTag eTag,const void * pValue)
+    {
+        *pOut++ = (char) eTag;
+        memcpy(pOut,pValue,8);
+        return pOut + 8;
+    }
+
+    static char * PutString(char * pOut,const char * sText,int iLength)
+    {
+        uint16_t usLength = (uint16_t) iLength;
+        *pOut++ = (char) TagString;
+        memcpy(pOut,&usLength,2);
+        memcpy(pOut+2,sText ? sText : "(null)",iLength);
+        return pOut + 2 + iLength;
+    }
+
+    template <typename _t>
+    static char * PutArg(char * pOut,const _t & xArg,std::integral_constant<int,ArgString>) { return PutString(pOut,xArg,StringLength(xArg)); }
+
+    template <typename _t>
+    static char * PutArg(char * pOut,const _t & xArg,std::integral_constant<int,ArgStdString>) { return PutString(pOut,xArg.data(),StringLength(xArg)); }
+
+    template <typename _t>
+    static char * PutArg(char * pOut,const _t & xArg,std::integral_constant<int,ArgFloat>) { double fValue = (double) xArg; return PutValue(pOut,TagDouble,&fValue); }
+
+    template <typename _t>
+    static char * PutArg(char * pOut,const _t & xArg,std::integral_constant<int,ArgPointer>) { const void * pValue = xArg; return PutValue(pOut,TagPointer,&pValue); }
+
+    template <typename _t>
+    static char * PutArg(char * pOut,const _t & xArg,std::integral_constant<int,ArgEnum>) { int64_t llValue = (int64_t) xArg; return PutValue(pOut,TagInt,&llValue); }
+
+    template <typename _t>
+    static char * PutArg(char * pOut,const _t & xArg,std::integral_constant<int,ArgSigned>)
+    {
+        static_assert(std::is_integral<_t>::value,"CDebugLog::Log() -- unsupported argument type");
+        int64_t llValue = xArg;
+        return PutValue(pOut,TagInt,&llValue);
+    }
+
+    template <typename _t>
+    static char * PutArg(char * pOut,const _t & xArg,std::integral_constant<int,ArgUnsigned>)
+    {
+        static_assert(std::is_integral<_t>::value,"CDebugLog::Log() -- unsupported argument type");
+        uint64_t ullValue = xArg;
+        return PutValue(pOut,TagUInt,&ullValue);
+    }
+
+    template <typename _t>
+    static char * PutArg(char * pOut,const _t & xArg) { return PutArg(pOut,xArg,ArgKind_t<_t>()); }
+
+    // GetRing() -- The calling thread's ring (taken on its first Log()).  A one-entry thread cache makes this a compare.
+
+    CRing * GetRing()
+    {
+        struct Cache_t { uint64_t ullId; CRing * pRing; };
+        thread_local Cache_t stCache = { 0,nullptr };
+        if (stCache.ullId == m_ullId) return stCache.pRing;
+
+        // First use on this thread (or another log was used last): find the ring, or take a free one or a new one
+
+        thread_local RingOwner_t stOwner;
+        for (auto & stEntry : stOwner.vRings)
+            if (stEntry.ullId == m_ullId) { stCache = { m_ullId,stEntry.pRing.get() }; return stCache.pRing; }
+
+        // Let go of rings of logs that no longer exist
+
+        stOwner.vRings.erase(std::remove_if(stOwner.vRings.begin(),stOwner.vRings.end(),[](const RingOwner_t::Entry_t & stEntry)
+                                { return !stEntry.pRing->bLogAlive.load(std::memory_order_acquire); }),stOwner.vRings.end());
+
+        std::shared_ptr<CRing> pRing;
+        {
+            std::lock_guard<std::mutex> lock(m_mtRings);
+            for (auto & pFree : m_vRings)
+                if (pFree->iState.load(std::memory_order_acquire) == RingFree)
+                {
+                    // Drained and empty (ullTail == ullHead); keep the positions and counts, and give it to this thread
+
+                    pFree->ullCachedTail = pFree->ullTail.load(std::memory_order_relaxed);
+                    pFree->iState.store(RingActive,std::memory_order_relaxed);
+                    pRing = pFree;
+                    break;
+                }
+
+            if (!pRing)
+            {
+                if (m_vRings.size() >= 0xFFFF) return nullptr;
+                pRing = std::make_shared<CRing>(m_iRingBytes,(uint16_t) m_vRings.size());
+                m_vRings.push_back(pRing);
+                m_iNumRings.store((int) m_vRings.size(),std::memory_order_release);
+            }
+        }
+
+        stOwner.vRings.push_back({ m_ullId,pRing });
+        stCache = { m_ullId,pRing.get() };
+        return stCache.pRing;
+    }
+
+    // Reserve() -- Space for a record of szSize bytes in the ring (contiguous: a padding record is written if it would
+    //              wrap).  Returns nullptr if the ring is full.
+
+    static char * Reserve(CRing & cRing,uint32_t uiSize,uint64_t & ullNewHead)
+    {
+        uint64_t ullHead = cRing.ullHead.load(std::memory_order_relaxed);
+        uint64_t ullSize = cRing.ullMask + 1;
+        uint64_t ullOffset = ullHead & cRing.ullMask;
+        uint64_t ullPad = ullOffset + uiSize > ullSize ? ullSize - ullOffset : 0;
+
+        if (ullHead + ullPad + uiSize - cRing.ullCachedTail > ullSize)
+        {
+            cRing.ullCachedTail = cRing.ullTail.load(std::memory_order_acquire);
+            if (ullHead + ullPad + uiSize - cRing.ullCachedTail > ullSize) return nullptr;
+        }
+
+        if (ullPad)
+        {
+            if (ullPad >= sizeof(Header_t))
+            {
+                Header_t stPad = { (uint32_t) ullPad,0,cRing.usThread,nullptr,0 };
+                memcpy(cRing.pData.get() + ullOffset,&stPad,sizeof(stPad));
+            }
+            ullHead += ullPad;
+        }
+        ullNewHead = ullHead + uiSize;
+        return cRing.pData.get() + (ullHead & cRing.ullMask);
+    }
+
+    // ArgValue_t -- A decoded argument
+
+    struct ArgValue_t
+    {
+        ArgTag          eTag;
+        union { int64_t llValue; uint64_t ullValue; double fValue; const void * pValue; };
+        const char    * sText;
+        int             iLength;
+    };
+
+    static int DecodeArgs(const char * pArgs,const char * pEnd,int iNumArgs,ArgValue_t * stArgs,int iMaxArgs)
+    {
+        int iCount = 0;
+        for (int i=0;i<iNumArgs && i < iMaxArgs && pArgs < pEnd;i++,iCount++)
+        {
+            ArgValue_t & stArg = stArgs[i];
+            stArg.eTag = (ArgTag) *pArgs++;
+            if (stArg.eTag == TagString)
+            {
+                uint16_t usLength;
+                memcpy(&usLength,pArgs,2);
+                stArg.sText     = pArgs+2;
+                stArg.iLength   = usLength;
+                pArgs += 2 + usLength;
+            }
+            else
+            {
+                memcpy(&stArg.ullValue,pArgs,8);
+                pArgs += 8;
+            }
+        }
+        return iCount;
+    }
+
+    // FormatArg() -- One argument with its compiled spec (as CFormatCache::FormatArg(), with the value from the record)
+
+    static void FormatArg(std::string & sOut,const CFormatProgram::Arg_t & stArg,const ArgValue_t * stArgs,int iNumArgs,int & iNext)
+    {
+        using ArgType = CFormatProgram::ArgType;
+
+        auto NextInt = [&]() -> int { return iNext < iNumArgs && stArgs[iNext].eTag != TagString ? (int) stArgs[iNext++].llValue : (iNext++,0); };
+        int iWidth      = stArg.bStarWidth ? NextInt() : 0;
+        int iPrecision  = stArg.bStarPrecision ? NextInt() : 0;
+
+        if (iNext >= iNumArgs) { sOut += "<?>"; return; }
+        const ArgValue_t & stValue = stArgs[iNext++];
+        bool bString = stValue.eTag == TagString;
+
+        char sBuffer[CNumFormat::kMaxFormatText];
+        auto Print = [&](auto xValue)
+        {
+            int iLength;
+            if (stArg.bStarWidth && stArg.bStarPrecision) iLength = snprintf(sBuffer,sizeof(sBuffer),stArg.sSpec,iWidth,iPrecision,xValue);
+            else if (stArg.bStarWidth) iLength = snprintf(sBuffer,sizeof(sBuffer),stArg.sSpec,iWidth,xValue);
+            else if (stArg.bStarPrecision) iLength = snprintf(sBuffer,sizeof(sBuffer),stArg.sSpec,iPrecision,xValue);
+            else iLength = snprintf(sBuffer,sizeof(sBuffer),stArg.sSpec,xValue);
+            if (iLength > 0) sOut.append(sBuffer,iLength < (int) sizeof(sBuffer) ? iLength : (int) sizeof(sBuffer)-1);
+        };
+
+        // Values are converted to the type the format expects (so "%d" with a long long prints its low 32 bits, as printf() would)
+
+        double fValue = stValue.eTag == TagDouble ? stValue.fValue : stValue.eTag == TagUInt ? (double) stValue.ullValue : (double) stValue.llValue;
+
+        switch (stArg.eType)
+        {
+            case ArgType::String:
+                if (!bString) { sOut += "<?>"; return; }
+                if (stArg.bPlain) { sOut.append(stValue.sText,stValue.iLength); return; }
+                Print(std::string(stValue.sText,stValue.iLength).c_str());
+                return;
+            case ArgType::WideString:   sOut.append(bString ? stValue.sText : "<?>",bString ? stValue.iLength : 3); return;
+            case ArgType::Count:        return;
+            default:                    if (bString) { sOut += "<?>"; return; } break;
+        }
+
+        switch (stArg.eType)
+        {
+            case ArgType::Int:          Print((int) stValue.llValue);                   break;
+            case ArgType::UInt:         Print((unsigned int) stValue.llValue);          break;
+            case ArgType::Char:         Print((int) (signed char) stValue.llValue);     break;
+            case ArgType::UChar:        Print((int) (unsigned char) stValue.llValue);   break;
+            case ArgType::Short:        Print((int) (short) stValue.llValue);           break;
+            case ArgType::UShort:       Print((int) (unsigned short) stValue.llValue);  break;
+            case ArgType::Long:         Print((long) stValue.llValue);                  break;
+            case ArgType::ULong:        Print((unsigned long) stValue.llValue);         break;
+            case ArgType::LongLong:     Print((long long) stValue.llValue);             break;
+            case ArgType::ULongLong:    Print((unsigned long long) stValue.llValue);    break;
+            case ArgType::SizeT:        Print((size_t) stValue.llValue);                break;
+            case ArgType::PtrDiff:      Print((ptrdiff_t) stValue.llValue);             break;
+            case ArgType::IntMax:       Print((intmax_t) stValue.llValue);              break;
+            case ArgType::UIntMax:      Print((uintmax_t) stValue.llValue);             break;
+            case ArgType::Double:       Print(fValue);                                  break;
+            case ArgType::LongDouble:   Print((long double) fValue);                    break;
+            case ArgType::Character:    Print((int) stValue.llValue);                   break;
+            case ArgType::Pointer:      Print(stValue.pValue);                          break;
+            default:                                                                    break;
+        }
+    }
+
+    static void FormatRecord(const std::string & sRecord,std::string & sOut)
+    {
+        static constexpr int kMaxArgs = 64;
+        sOut.clear();
+        if (sRecord.size() < sizeof(Header_t)) return;
+
+        Header_t stHeader;
+        memcpy(&stHeader,sRecord.data(),sizeof(stHeader));
+        ArgValue_t stArgs[kMaxArgs];
+        int iNumArgs = DecodeArgs(sRecord.data() + sizeof(Header_t),sRecord.data() + sRecord.size(),stHeader.usNumArgs,stArgs,kMaxArgs);
+
+        auto & cProgram = CFormatCache::FindProgram(stHeader.sFormat);
+        const char * sBase = cProgram.m_sFormat.c_str();
+        if (!cProgram.m_bValid)
+        {
+            sOut = cProgram.m_sFormat;          // Unsupported conversion: show the format as written
+            return;
+        }
+
+        // As CFormatCache::vSprintf(): the markup is written back out, so the line can be given to any Sagebox Write()
+
+        int iNext = 0;
+        for (auto & stInstr : cProgram.m_vInstr)
+        {
+            using Op = CFormatProgram::Op;
+            switch (stInstr.eOp)
+            {
+                case Op::Literal:
+                case Op::Markup:
+                case Op::Pop:       sOut.append(sBase + stInstr.iOffset,stInstr.iLength); break;
+                case Op::PushFg:    sOut += '{'; sOut.append(sBase + stInstr.iOffset,stInstr.iLength); sOut += '}'; break;
+                case Op::PushBg:    sOut += "{bg="; sOut.append(sBase + stInstr.iOffset,stInstr.iLength); sOut += '}'; break;
+                case Op::Arg:       FormatArg(sOut,cProgram.m_vArgs[stInstr.iOffset],stArgs,iNumArgs,iNext); break;
+            }
+        }
+
+        // Each record is one line
+
+        while (!sOut.empty() && (sOut.back() == '\n' || sOut.back() == '\r')) sOut.pop_back();
+    }
+
+public:
+    // CDebugLog() -- iRingBytes per writing thread (rounded up to a power of 2), and the number of records kept by Drain()
+    //
+    CDebugLog(int iRingBytes = kDefaultRingBytes,int iHistory = kDefaultHistory) : m_ullId(NextId())
+    {
+        m_iRingBytes = 4096;
+        while (m_iRingBytes < iRingBytes && m_iRingBytes < (1 << 30)) m_iRingBytes <<= 1;
+        m_vHistory.resize(iHistory < 1 ? 1 : iHistory);
+    }
+
+    CDebugLog(const CDebugLog &) = delete;
+    CDebugLog & operator = (const CDebugLog &) = delete;
+    ~CDebugLog()
+    {
+        SetSpillFile(nullptr);
+        for (auto & pRing : m_vRings) pRing->bLogAlive.store(false,std::memory_order_release);
+    }
+
+    // GetDefault() -- The log used by the debug window
+    //
+    static CDebugLog & GetDefault()
+    {
+        static CDebugLog cLog;
+        return cLog;
+    }
+
+    // Log() -- Record a line.  Any thread, lock-free.  sFormat must be a string literal (only its pointer is kept).
+    // Returns false if the record was dropped (the ring is full, or the record is larger than a quarter of the ring).
+    //
+    template <typename... _Args>
+    bool Log(const char * sFormat,const _Args &... xArgs)
+    {
+        CRing * pRing = GetRing();
+        if (!pRing) return false;
+
+        uint32_t uiSize = (uint32_t) sizeof(Header_t);
+        int iExpand[] = { 0,((uiSize += ArgSize(xArgs)),0)... };
+        (void) iExpand;
+        uiSize = (uiSize + 7) & ~7u;
+
+        uint64_t ullNewHead;
+        char * pOut = uiSize <= pRing->ullMask/4 ? Reserve(*pRing,uiSize,ullNewHead) : nullptr;
+        if (!pOut)
+        {
+            pRing->ullDropped.store(pRing->ullDropped.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+            return false;
+        }
+
+        Header_t stHeader = { uiSize,(uint16_t) sizeof...(xArgs),pRing->usThread,sFormat ? sFormat : "",
+                              (int64_t) std::chrono::steady_clock::now().time_since_epoch().count() };
+        memcpy(pOut,&stHeader,sizeof(stHeader));
+        char * pArgs = pOut + sizeof(Header_t);
+        int iPut[] = { 0,((pArgs = PutArg(pArgs,xArgs)),0)... };
+        (void) iPut;
+
+        pRing->ullWritten.store(pRing->ullWritten.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+        pRing->ullHead.store(ullNewHead,std::memory_order_release);
+        return true;
+    }
+
+    // Drain() -- Move the records from all threads into the history, in time order (and to the spill file, if set).  One
+    // thread only (i.e. the debug window's).  Returns the number of records moved.
+    //
+    // Free rings are skipped.  The ring of a thread that has exited is drained one last time and then marked free.
+    //
+    int Drain()
+    {
+        struct Pending_t { int64_t llTime; CRing * pRing; uint64_t ullPos; };
+        struct End_t { CRing * pRing; uint64_t ullHead; bool bRetired; };
+        thread_local std::vector<Pending_t> vPending;
+        vPending.clear();
+
+        std::vector<End_t> vEnds;
+        {
+            std::lock_guard<std::mutex> lock(m_mtRings);
+            for (auto & pRing : m_vRings)
+            {
+                // The state is read before the head, so a retired ring's head is its last one
+
+                int iState = pRing->iState.load(std::memory_order_acquire);
+                if (iState == RingFree) continue;
+
+                uint64_t ullHead = pRing->ullHead.load(std::memory_order_acquire);
+                uint64_t ullPos = pRing->ullTail.load(std::memory_order_relaxed);
+                uint64_t ullSize = pRing->ullMask + 1;
+
+                while (ullPos < ullHead)
+                {
+                    uint64_t ullOffset = ullPos & pRing->ullMask;
+                    if (ullSize - ullOffset < sizeof(Header_t)) { ullPos += ullSize - ullOffset; continue; }
+
+                    Header_t stHeader;
+                    memcpy(&stHeader,pRing->pData.get() + ullOffset,sizeof(stHeader));
+                    if (stHeader.sFormat) vPending.push_back({ stHeader.llTime,pRing.get(),ullPos });
+                    ullPos += stHeader.uiSize;
+                }
+                vEnds.push_back({ pRing.get(),ullHead,iState == RingRetired });
+            }
+        }
+
+        std::stable_sort(vPending.begin(),vPending.end(),[](const Pending_t & st1,const Pending_t & st2) { return st1.llTime < st2.llTime; });
+
+        std::string sLine;
+        for (auto & stPending : vPending)
+        {
+            const char * pRecord = stPending.pRing->pData.get() + (stPending.ullPos & stPending.pRing->ullMask);
+            uint32_t uiSize;
+            memcpy(&uiSize,pRecord,sizeof(uiSize));
+
+            Entry_t & stEntry = m_vHistory[m_ullCount % m_vHistory.size()];
+            stEntry.sRecord.assign(pRecord,uiSize);
+            m_ullCount++;
+
+            if (m_fpSpill)
+            {
+                FormatRecord(stEntry.sRecord,sLine);
+                sLine += '\n';
+                fwrite(sLine.data(),1,sLine.size(),m_fpSpill);
+                m_ullSpilled++;
+            }
+        }
+
+        // Give the space back to the writers only after the records have been copied, and retired rings to new threads
+
+        for (auto & stEnd : vEnds)
+        {
+            stEnd.pRing->ullTail.store(stEnd.ullHead,std::memory_order_release);
+            if (stEnd.bRetired) stEnd.pRing->iState.store(RingFree,std::memory_order_release);
+        }
+        return (int) vPending.size();
+    }
+
+    // GetFirstIndex(), GetEndIndex() -- The records in the history are GetFirstIndex() .. GetEndIndex()-1.  Indexes keep
+    // increasing as records are drained; older records leave the history.
+    //
+    uint64_t GetEndIndex() const { return m_ullCount; }
+    uint64_t GetFirstIndex() const { return m_ullCount > m_vHistory.size() ? m_ullCount - m_vHistory.size() : 0; }
+    int GetCount() const { return (int) (m_ullCount - GetFirstIndex()); }
+
+    // GetLine() -- Format a record from the history.  Returns false if it is not in the history.  Drain() thread only.
+    //
+    bool GetLine(uint64_t ullIndex,std::string & sLine) const
+    {
+        if (ullIndex < GetFirstIndex() || ullIndex >= m_ullCount) { sLine.clear(); return false; }
+        FormatRecord(m_vHistory[ullIndex % m_vHistory.size()].sRecord,sLine);
+        return true;
+    }
+
+    // GetTime() -- Time a record was logged (steady_clock ticks), or 0
+    //
+    int64_t GetTime(uint64_t ullIndex) const
+    {
+        if (ullIndex < GetFirstIndex() || ullIndex >= m_ullCount) return 0;
+        Header_t stHeader;
+        memcpy(&stHeader,m_vHistory[ullIndex % m_vHistory.size()].sRecord.data(),sizeof(stHeader));
+        return stHeader.llTime;
+    }
+
+    // ForEachNew() -- Format each record drained since the last call (at most the history), i.e. to Write() them to a window
+    //
+    template <typename _Fn>
+    int ForEachNew(_Fn && fnLine)
+    {
+        if (m_ullReported < GetFirstIndex()) m_ullReported = GetFirstIndex();
+        std::string sLine;
+        int iCount = 0;
+        for (;m_ullReported < m_ullCount;m_ullReported++,iCount++)
+        {
+            GetLine(m_ullReported,sLine);
+            fnLine(sLine.c_str());
+        }
+        return iCount;
+    }
+
+    // SetSpillFile() -- Also write every drained record to a text file (appended).  nullptr closes it.
+    //
+    bool SetSpillFile(const char * sPath)
+    {
+        if (m_fpSpill) fclose(m_fpSpill);
+        m_fpSpill = nullptr;
+        if (!sPath || !*sPath) return true;
+
+        m_fpSpill = fopen(sPath,"ab");
+        if (m_fpSpill) setvbuf(m_fpSpill,nullptr,_IOFBF,1 << 16);
+        return m_fpSpill != nullptr;
+    }
+
+    void FlushSpillFile() { if (m_fpSpill) fflush(m_fpSpill); }
+    uint64_t GetSpilled() const { return m_ullSpilled; }
+
+    // GetDropped(), GetWritten() -- Records dropped because a thread's ring was full, and records written, over all threads
+    //
+    uint64_t GetDropped()
+    {
+        std::lock_guard<std::mutex> lock(m_mtRings);
+        uint64_t ullDropped = 0;
+        for (auto & pRing : m_vRings) ullDropped += pRing->ullDropped.load(std::memory_order_relaxed);
+        return ullDropped;
+    }
+
+    uint64_t GetWritten()
+    {
+        std::lock_guard<std::mutex> lock(m_mtRings);
+        uint64_t ullWritten = 0;
+        for (auto & pRing : m_vRings) ullWritten += pRing->ullWritten.load(std::memory_order_relaxed);
+        return ullWritten;
+    }
+
+    // GetNumThreads() -- Number of rings, i.e. the most threads that have been logging at the same time
+    //
+    int GetNumThreads() const { return m_iNumRings.load(std::memory_order_acquire); }
+};
+
+}; // namespace Sage
+#endif // _CDebugLog_H_
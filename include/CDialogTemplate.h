@@ -0,0 +1,444 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CDialogTemplate -- Compiled, cached dialog definitions
+//
+// CDialogParser::CompileDialog() parses the dialog definition string, and the text is measured, every time a dialog is
+// created.  Flows that open the same dialog many times repeat this work each time.
+//
+// CDialogTemplate holds the result of compiling a definition once: the stControl_t list, the text size of each control,
+// and the layout rectangle of each control (auto-sized controls, with a width or height of 0, are sized from their
+// text).  Instantiate() then creates all of the controls in one pass with window redraws turned off, redrawing the
+// window once at the end rather than once per control.
+//
+// CDialogTemplateCache keeps compiled templates keyed by the definition string, the font and the DPI the text was measured
+// with (the whole string is compared on a hash match), so each distinct definition is compiled once per font and DPI.
+//
+// CTextSizeCache keeps measured text sizes keyed by font, DPI and text (i.e. "Arial,13" for list and combo box items), so
+// repeated dialogs do not re-measure the same strings.
+//
+// Basic usage:
+//
+//      auto cTemplate = CDialogTemplateCache::GetDefault().Get(sDefinition,&cWin);    // Compiles the first time only
+//
+//      std::vector<CDialogParser::stControl_t> vControls;
+//      if (cTemplate) cTemplate->Instantiate(cDialogWin,vControls);                    // pObject = the created control
+//
+// Instantiate() creates Button, EditBox, Slider, TextWidget, ListBox and Window controls.  BitmapWidget, Bitmap and Widget
+// controls need objects from the caller, and are returned with pObject == nullptr and their layout filled in.
+//
+#if !defined(_CDialogTemplate_H_)
+#define _CDialogTemplate_H_
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CSageBox.h"
+#include "CDialogParser.h"
+#include "SageProfile.h"
+
+namespace Sage
+{
+
+// CTextSizeCache -- Process-wide cache of text sizes by font and text
+
+class CTextSizeCache
+{
+public:
+    static constexpr int kMaxEntries = 8192;        // The cache is cleared when it grows past this
+
+    // Measure_t -- What text is measured with: the font (the font string, or a description of the window's current font
+    // when no font string is given) and the DPI of the window.  Text sizes and templates are only reused for the same one.
+
+    struct Measure_t
+    {
+        std::string     sFont;
+        int             iDpi = 0;       // 0 = no window to measure with
+
+        bool operator == (const Measure_t & stOther) const { return iDpi == stOther.iDpi && sFont == stOther.sFont; }
+    };
+
+private:
+    std::mutex                              m_mutex;
+    std::unordered_map<std::string,SIZE>    m_mapSizes;
+
+public:
+    static CTextSizeCache & GetDefault()
+    {
+        static CTextSizeCache cCache;
+        return cCache;
+    }
+
+    // GetDpi() -- Vertical DPI of cWin's window (96 if it has none yet)
+    //
+    static int GetDpi(CWindow & cWin)
+    {
+        HWND hWnd = cWin.GetWindowHandle();
+        HDC hDC = hWnd ? GetDC(hWnd) : nullptr;
+        if (!hDC) return 96;
+        int iDpi = GetDeviceCaps(hDC,LOGPIXELSY);
+        ReleaseDC(hWnd,hDC);
+        return iDpi > 0 ? iDpi : 96;
+    }
+
+    // GetMeasure() -- The font and DPI that GetTextSize(cWin,sFont,...) measures with
+    //
+    static Measure_t GetMeasure(CWindow & cWin,const char * sFont)
+    {
+        Measure_t stMeasure;
+        stMeasure.iDpi = GetDpi(cWin);
+        if (sFont && *sFont) { stMeasure.sFont = sFont; return stMeasure; }
+
+        // The window's current font, by its description rather than its handle (handles are reused once a font is deleted)
+
+        LOGFONTA stFont{};
+        HFONT hFont = cWin.GetCurrentFont();
+        if (!hFont || !GetObjectA(hFont,sizeof(stFont),&stFont)) return stMeasure;
+
+        char sFontKey[LF_FACESIZE + 64];
+        snprintf(sFontKey,sizeof(sFontKey),"\x02%.*s,%ld,%ld,%ld,%d,%d,%d",LF_FACESIZE,stFont.lfFaceName,stFont.lfHeight,stFont.lfWidth,
+                 stFont.lfWeight,stFont.lfItalic,stFont.lfCharSet,stFont.lfQuality);
+        stMeasure.sFont = sFontKey;
+        return stMeasure;
+    }
+
+    // GetTextSize() -- Size of sText in sFont (i.e. "Arial,13", or cWin's current font when sFont is nullptr), measured with
+    // cWin the first time
+    //
+    SIZE GetTextSize(CWindow & cWin,const char * sFont,const char * sText)
+    {
+        return GetTextSize(cWin,sFont,sText,GetMeasure(cWin,sFont));
+    }
+
+    // GetTextSize() -- As above, with stMeasure from GetMeasure(cWin,sFont) (so many strings can be measured with one lookup)
+    //
+    SIZE GetTextSize(CWindow & cWin,const char * sFont,const char * sText,const Measure_t & stMeasure)
+    {
+        if (!sText || !*sText) return SIZE{};
+        std::string sKey(stMeasure.sFont);
+        sKey += '\x01';
+        sKey += std::to_string(stMeasure.iDpi);
+        sKey += '\x01';
+        sKey += sText;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_mapSizes.find(sKey);
+            if (it != m_mapSizes.end()) return it->second;
+        }
+
+        SIZE szSize{};
+        if (sFont && *sFont) cWin.GetTextSize(sFont,sText,szSize);
+        else cWin.GetTextSize(sText,szSize);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if ((int) m_mapSizes.size() >= kMaxEntries) m_mapSizes.clear();
+        m_mapSizes.emplace(std::move(sKey),szSize);
+        return szSize;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapSizes.clear();
+    }
+};
+
+class CDialogTemplate
+{
+public:
+    // kTextPadX, kTextPadY -- Added to the measured text size of auto-sized controls, for the border and inner margin on
+    // both sides of a button or edit box (5 pixels a side across, 3 up and down).  These are pixels at 96 DPI; Compile()
+    // scales them to the DPI of cMeasure.
+
+    static constexpr int kTextPadX = 10;
+    static constexpr int kTextPadY = 6;
+
+    using stControl_t = CDialogParser::stControl_t;
+
+private:
+    std::vector<stControl_t>    m_vControls;
+    std::vector<SIZE>           m_vTextSizes;
+    std::vector<RECT>           m_vRects;
+    RECT                        m_rBounds{};
+    std::string                 m_sDefinition;
+    CTextSizeCache::Measure_t   m_stMeasure;                    // Font and DPI the text was measured with
+    unsigned long long          m_ullHash       = 0;
+    bool                        m_bValid        = false;
+
+public:
+    // Hash() -- 64-bit FNV-1a of a definition string
+    //
+    static unsigned long long Hash(const char * sDefinition,unsigned long long ullHash = 14695981039346656037ULL)
+    {
+        for (auto s = (const unsigned char *) sDefinition;s && *s;s++) ullHash = (ullHash ^ *s)*1099511628211ULL;
+        return ullHash;
+    }
+
+    // Hash() -- Hash of a definition with the font and DPI it is measured with (the CDialogTemplateCache key)
+    //
+    static unsigned long long Hash(const char * sDefinition,const CTextSizeCache::Measure_t & stMeasure)
+    {
+        return Hash(stMeasure.sFont.c_str(),Hash(sDefinition) ^ (unsigned long long) stMeasure.iDpi);
+    }
+
+    // GetMeasure() -- The font and DPI Compile(sDefinition,cMeasure,sFont) measures text with
+    //
+    static CTextSizeCache::Measure_t GetMeasure(CWindow * cMeasure,const char * sFont)
+    {
+        return cMeasure ? CTextSizeCache::GetMeasure(*cMeasure,sFont) : CTextSizeCache::Measure_t{};
+    }
+
+    // Compile() -- Parse a definition and lay it out.  Text is measured with cMeasure (and sFont, or cMeasure's current
+    // font when sFont is nullptr) through CTextSizeCache; with no cMeasure, text sizes are 0 and auto-sized controls keep
+    // their size from the definition.
+    //
+    bool Compile(const char * sDefinition,CWindow * cMeasure = nullptr,const char * sFont = nullptr)
+    {
+        return Compile(sDefinition,cMeasure,sFont,GetMeasure(cMeasure,sFont));
+    }
+
+    // Compile() -- As above, with stMeasure from GetMeasure(cMeasure,sFont)
+    //
+    bool Compile(const char * sDefinition,CWindow * cMeasure,const char * sFont,const CTextSizeCache::Measure_t & stMeasure)
+    {
+        m_bValid = false;
+        m_vControls.clear();
+        m_vTextSizes.clear();
+        m_vRects.clear();
+        m_rBounds = RECT{};
+        if (!sDefinition) return false;
+
+        m_sDefinition   = sDefinition;
+        m_stMeasure     = stMeasure;
+        m_ullHash       = Hash(sDefinition,stMeasure);
+
+        int iPadX = stMeasure.iDpi ? MulDiv(kTextPadX,stMeasure.iDpi,96) : kTextPadX;
+        int iPadY = stMeasure.iDpi ? MulDiv(kTextPadY,stMeasure.iDpi,96) : kTextPadY;
+
+        std::vector<char> vText(m_sDefinition.begin(),m_sDefinition.end());     // CDialogParser works in place
+        vText.push_back(0);
+
+        CDialogParser cParser;
+        if (!cParser.Init(vText.data()) || !cParser.CompileDialog()) return false;
+
+        m_vControls = cParser.GetControls();
+        bool bFirst = true;
+
+        for (auto & stControl : m_vControls)
+        {
+            stControl.cWidget   = nullptr;
+            stControl.pObject   = nullptr;
+            stControl.hWnd      = nullptr;
+
+            SIZE szText{};
+            const char * sText = stControl.csText;
+            if (cMeasure && sText && *sText) szText = CTextSizeCache::GetDefault().GetTextSize(*cMeasure,sFont,sText,stMeasure);
+
+            if (stControl.iWidth <= 0 && szText.cx) stControl.iWidth = szText.cx + iPadX;
+            if (stControl.iHeight <= 0 && szText.cy) stControl.iHeight = szText.cy + iPadY;
+
+            RECT rControl = { stControl.iX,stControl.iY,stControl.iX + stControl.iWidth,stControl.iY + stControl.iHeight };
+            if (bFirst) m_rBounds = rControl;
+            else
+            {
+                if (rControl.left < m_rBounds.left) m_rBounds.left = rControl.left;
+                if (rControl.top < m_rBounds.top) m_rBounds.top = rControl.top;
+                if (rControl.right > m_rBounds.right) m_rBounds.right = rControl.right;
+                if (rControl.bottom > m_rBounds.bottom) m_rBounds.bottom = rControl.bottom;
+            }
+            bFirst = false;
+
+            m_vTextSizes.push_back(szText);
+            m_vRects.push_back(rControl);
+        }
+
+        return m_bValid = true;
+    }
+
+    bool isValid() const { return m_bValid; }
+    unsigned long long GetHash() const { return m_ullHash; }
+    const std::string & GetDefinition() const { return m_sDefinition; }
+    const CTextSizeCache::Measure_t & GetMeasure() const { return m_stMeasure; }
+
+    // isSame() -- True if this template is sDefinition measured with stMeasure
+    //
+    bool isSame(const char * sDefinition,const CTextSizeCache::Measure_t & stMeasure) const
+    {
+        return m_stMeasure == stMeasure && m_sDefinition == sDefinition;
+    }
+
+    int GetNumControls() const { return (int) m_vControls.size(); }
+    const std::vector<stControl_t> & GetControls() const { return m_vControls; }
+    const RECT & GetRect(int iControl) const { return m_vRects[iControl]; }
+    SIZE GetTextSize(int iControl) const { return m_vTextSizes[iControl]; }
+
+    // GetBounds() -- Rectangle enclosing all controls (i.e. to size the dialog window)
+    //
+    const RECT & GetBounds() const { return m_rBounds; }
+
+    // Instantiate() -- Create the controls in cWin, offset by pOffset.  vControls receives a copy of the control list with
+    // pObject (the CButton, CEditBox, etc.) and hWnd (for Window controls) filled in.  Redraws of cWin are turned off until
+    // every control is created, and the window is redrawn once.
+    //
+    bool Instantiate(CWindow & cWin,std::vector<stControl_t> & vControls,POINT pOffset = POINT{}) const
+    {
+        SageProfileZone("CDialogTemplate::Instantiate");
+        vControls = m_vControls;
+        if (!m_bValid) return false;
+
+        HWND hWnd = cWin.GetWindowHandle();
+        bool bDeferRedraw = hWnd && IsWindowVisible(hWnd);
+        if (bDeferRedraw) SendMessage(hWnd,WM_SETREDRAW,FALSE,0);
+
+        for (auto & stControl : vControls)
+        {
+            int iX = stControl.iX + pOffset.x;
+            int iY = stControl.iY + pOffset.y;
+            const char * sText      = stControl.csText;
+            const char * sOptions   = stControl.csOptions;
+            if (!sOptions) sOptions = "";
+
+            switch (stControl.controlType)
+            {
+                case CDialogParser::ControlType::Button:
+                    stControl.pObject = &cWin.NewButton(iX,iY,stControl.iWidth,stControl.iHeight,sText,opt::str(sOptions));
+                    break;
+                case CDialogParser::ControlType::EditBox:
+                    stControl.pObject = &cWin.NewEditBox(iX,iY,stControl.iWidth,stControl.iHeight,sText,opt::str(sOptions));
+                    break;
+                case CDialogParser::ControlType::Slider:
+                    stControl.pObject = &cWin.NewSlider(iX,iY,stControl.iWidth,sText,opt::str(sOptions));
+                    break;
+                case CDialogParser::ControlType::TextWidget:
+                    stControl.pObject = &cWin.TextWidget(iX,iY,stControl.iWidth,stControl.iHeight,sText,opt::str(sOptions));
+                    break;
+                case CDialogParser::ControlType::ListBox:
+                {
+                    auto & cListBox = cWin.NewListBox(iX,iY,stControl.iWidth,stControl.iHeight,opt::str(sOptions));
+                    stControl.pObject = &cListBox;
+
+                    // Items are the lines of the control's text
+
+                    for (const char * s = sText;s && *s;)
+                    {
+                        const char * sEnd = strchr(s,'\n');
+                        std::string sItem(s,sEnd ? sEnd-s : strlen(s));
+                        if (!sItem.empty()) cListBox.AddItem(sItem.c_str());
+                        s = sEnd ? sEnd+1 : nullptr;
+                    }
+                    break;
+                }
+                case CDialogParser::ControlType::Window:
+                {
+                    auto & cChild = cWin.ChildWindow(iX,iY,stControl.iWidth,stControl.iHeight,opt::str(sOptions));
+                    stControl.pObject   = &cChild;
+                    stControl.hWnd      = cChild.GetWindowHandle();
+                    break;
+                }
+                default:
+                    break;      // BitmapWidget, Bitmap, Widget -- created by the caller
+            }
+        }
+
+        if (bDeferRedraw)
+        {
+            SendMessage(hWnd,WM_SETREDRAW,TRUE,0);
+            RedrawWindow(hWnd,nullptr,nullptr,RDW_ERASE | RDW_FRAME | RDW_INVALIDATE | RDW_ALLCHILDREN);
+        }
+        return true;
+    }
+};
+
+// CDialogTemplateCache -- Process-wide cache of compiled dialog templates
+
+class CDialogTemplateCache
+{
+public:
+    struct Stats_t
+    {
+        long long llHits;
+        long long llMisses;
+        int       iEntries;
+    };
+
+private:
+    std::mutex                                                                      m_mutex;
+    std::unordered_map<unsigned long long,std::vector<std::shared_ptr<const CDialogTemplate>>>  m_mapTemplates;
+    long long                                                                       m_llHits    = 0;
+    long long                                                                       m_llMisses  = 0;
+    int                                                                             m_iEntries  = 0;
+
+public:
+    static CDialogTemplateCache & GetDefault()
+    {
+        static CDialogTemplateCache cCache;
+        return cCache;
+    }
+
+    // Get() -- The compiled template for a definition, compiling it the first time for each font and DPI (see
+    // CDialogTemplate::Compile() for cMeasure and sFont).  Returns nullptr if the definition does not compile; failed
+    // definitions are not cached.
+    //
+    std::shared_ptr<const CDialogTemplate> Get(const char * sDefinition,CWindow * cMeasure = nullptr,const char * sFont = nullptr,bool * bSuccess = nullptr)
+    {
+        if (bSuccess) *bSuccess = false;
+        if (!sDefinition) return nullptr;
+
+        auto stMeasure = CDialogTemplate::GetMeasure(cMeasure,sFont);
+        unsigned long long ullHash = CDialogTemplate::Hash(sDefinition,stMeasure);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_mapTemplates.find(ullHash);
+            if (it != m_mapTemplates.end())
+                for (auto & cTemplate : it->second)
+                    if (cTemplate->isSame(sDefinition,stMeasure))
+                    {
+                        m_llHits++;
+                        if (bSuccess) *bSuccess = true;
+                        return cTemplate;
+                    }
+            m_llMisses++;
+        }
+
+        // Compile outside of the lock; if two threads compile the same definition, the first one stored is kept
+
+        auto cTemplate = std::make_shared<CDialogTemplate>();
+        if (!cTemplate->Compile(sDefinition,cMeasure,sFont,stMeasure)) return nullptr;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto & vTemplates = m_mapTemplates[ullHash];
+        for (auto & cExisting : vTemplates)
+            if (cExisting->isSame(sDefinition,stMeasure))
+            {
+                if (bSuccess) *bSuccess = true;
+                return cExisting;
+            }
+
+        vTemplates.push_back(cTemplate);
+        m_iEntries++;
+        if (bSuccess) *bSuccess = true;
+        return cTemplate;
+    }
+
+    // Clear() -- Drop all templates (i.e. to free memory).  A font or DPI change does not need Clear(): templates are kept
+    // per font and DPI.  Templates in use stay valid.
+    //
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapTemplates.clear();
+        m_iEntries = 0;
+    }
+
+    Stats_t GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return { m_llHits,m_llMisses,m_iEntries };
+    }
+};
+
+}; // namespace Sage
+#endif // _CDialogTemplate_H_
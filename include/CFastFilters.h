@@ -0,0 +1,631 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CFastFilters -- Large-radius filters whose cost per pixel does not depend on the radius.
+//
+//      CIntegralImage      -- Summed-area table (64-bit accumulators) for 24-bit bitmaps, luminance, masks and float bitmaps.
+//      BoxBlur()           -- Mean over a (2r+1)x(2r+1) square using the summed-area table.
+//      LocalThreshold()    -- Local-mean (adaptive) thresholding for scanned documents and masks.
+//      Erode()/Dilate()    -- Min/Max over a square using the van Herk/Gil-Werman algorithm (3 comparisons per pixel per pass).
+//      Open()/Close()      -- Erode then Dilate, and Dilate then Erode, for mask cleanup.
+//      Median()            -- Median over a square using sliding column histograms (Perreault & Hebert).
+//
+// All filters are multi-threaded by row bands (and column bands for vertical passes) with CParallel.
+//
+// The xxxNaive() versions compute the same result directly over the whole window and are kept as references for
+// verifying and benchmarking the fast versions.  They are slow with larger radii.
+//
+// Edges: pixels outside of the image are ignored for BoxBlur() and LocalThreshold() (i.e. the mean is over the part of the window inside the image),
+// ignored for Erode()/Dilate(), and replicated from the nearest edge pixel for Median().
+//
+// Output bitmaps for the CBitmap versions may be empty, in which case they are created at the input size.  Otherwise they must be the
+// same size as the input.  The output may not be the same bitmap as the input.
+//
+#if !defined(_CFastFilters_H_)
+#define _CFastFilters_H_
+
+#include <vector>
+#include <cfloat>
+#include <emmintrin.h>
+#include "Sage.h"
+#include "CRawBitmap.h"
+#include "CParallel.h"
+#include "SageProfile.h"
+
+namespace Sage
+{
+
+// CIntegralImage -- Summed-area table with 64-bit accumulators.
+//
+// The table is (Width+1)x(Height+1) entries per channel, with the first row and column set to 0, so that
+// the sum of any rectangle is 4 lookups with GetSum().
+//
+// 24-bit bitmaps use 3 channels in Blue, Green, Red order (i.e. the order in memory), unless bLuminance is set in Build(), in which case
+// one channel of luminance is used.  Float bitmaps and 8-bit masks use one channel.
+//
+template <typename _t>
+class CSummedAreaTable
+{
+private:
+    Mem<_t> m_stSum;
+    int     m_iWidth    = 0;
+    int     m_iHeight   = 0;
+    int     m_iChannels = 0;
+    int     m_iRowItems = 0;    // (Width+1)*Channels
+
+    // Accumulate() -- After each row holds its horizontal prefix sums, add the rows together vertically (by column bands)
+    //
+    void Accumulate()
+    {
+        CParallel::ForBands(m_iRowItems,[this](int iX1,int iX2,int)
+        {
+            for (int iY=1;iY<=m_iHeight;iY++)
+            {
+                _t * pPrev = &m_stSum.pMem[(long long) (iY-1)*m_iRowItems];
+                _t * pCur  = &m_stSum.pMem[(long long) iY*m_iRowItems];
+                for (int i=iX1;i<iX2;i++) pCur[i] += pPrev[i];
+            }
+        },256);
+    }
+
+    bool Allocate(int iWidth,int iHeight,int iChannels)
+    {
+        long long llItems = (long long) (iWidth+1)*(iHeight+1)*iChannels;
+        if (iWidth <= 0 || iHeight <= 0 || llItems > INT_MAX) return false;
+
+        m_iWidth    = iWidth;
+        m_iHeight   = iHeight;
+        m_iChannels = iChannels;
+        m_iRowItems = (iWidth+1)*iChannels;
+
+        if (m_stSum.iSize < (int) llItems) m_stSum = (int) llItems;
+        if (!m_stSum.pMem) { m_iWidth = m_iHeight = 0; return false; }
+
+        memset(m_stSum.pMem,0,m_iRowItems*sizeof(_t));     // Top row is all zeros
+        return true;
+    }
+
+    // BuildRows() -- Horizontal prefix sums for each row.  fnGet(iX,iY,iChannel) returns the source value.
+    //
+    template <typename _fn>
+    void BuildRows(_fn && fnGet)
+    {
+        CParallel::ForBands(m_iHeight,[&](int iY1,int iY2,int)
+        {
+            for (int iY=iY1;iY<iY2;iY++)
+            {
+                _t * pRow = &m_stSum.pMem[(long long) (iY+1)*m_iRowItems];
+                for (int c=0;c<m_iChannels;c++) pRow[c] = 0;
+
+                for (int iX=0;iX<m_iWidth;iX++)
+                    for (int c=0;c<m_iChannels;c++)
+                        pRow[(iX+1)*m_iChannels + c] = pRow[iX*m_iChannels + c] + (_t) fnGet(iX,iY,c);
+            }
+        });
+        Accumulate();
+    }
+
+public:
+    CSummedAreaTable() { }
+    CSummedAreaTable(const RawBitmap_t & stBitmap,bool bLuminance = false) { Build(stBitmap,bLuminance); }
+
+    // Build() -- Build from a 24-bit bitmap (3 channels in B,G,R order, or 1 luminance channel when bLuminance = true)
+    //
+    bool Build(const RawBitmap_t & stBitmap,bool bLuminance = false)
+    {
+        if (!stBitmap.stMem || !Allocate(stBitmap.iWidth,stBitmap.iHeight,bLuminance ? 1 : 3)) return false;
+
+        const unsigned char * sMem = stBitmap.stMem;
+        int iWidthBytes = stBitmap.iWidthBytes;
+
+        if (bLuminance)
+            BuildRows([sMem,iWidthBytes](int iX,int iY,int)
+            {
+                const unsigned char * s = sMem + (long long) iY*iWidthBytes + iX*3;
+                return (77*s[2] + 150*s[1] + 29*s[0]) >> 8;
+            });
+        else
+            BuildRows([sMem,iWidthBytes](int iX,int iY,int c) { return sMem[(long long) iY*iWidthBytes + iX*3 + c]; });
+        return true;
+    }
+
+    // Build() -- Build from an 8-bit, single channel array (i.e. a mask) with iStride bytes per row
+    //
+    bool Build(const unsigned char * sMem,int iWidth,int iHeight,int iStride)
+    {
+        if (!sMem || !Allocate(iWidth,iHeight,1)) return false;
+        BuildRows([sMem,iStride](int iX,int iY,int) { return sMem[(long long) iY*iStride + iX]; });
+        return true;
+    }
+
+    // Build() -- Build from a float bitmap (1 channel).  Use CSummedAreaTable<double> for float bitmaps.
+    //
+    bool Build(const FloatBitmapM_t & fBitmap)
+    {
+        if (!fBitmap.fPixels || !Allocate(fBitmap.iWidth,fBitmap.iHeight,1)) return false;
+        const float * fMem = fBitmap.fPixels;
+        int iWidth = fBitmap.iWidth;
+        BuildRows([fMem,iWidth](int iX,int iY,int) { return fMem[(long long) iY*iWidth + iX]; });
+        return true;
+    }
+
+    // GetSum() -- Sum of the rectangle from (iX1,iY1) up to, but not including, (iX2,iY2).
+    // The rectangle is not clipped -- use GetSumClipped() for rectangles that may fall outside of the image.
+    //
+    __forceinline _t GetSum(int iX1,int iY1,int iX2,int iY2,int iChannel = 0) const
+    {
+        const _t * p = m_stSum.pMem + iChannel;
+        return  p[(long long) iY2*m_iRowItems + iX2*m_iChannels] - p[(long long) iY1*m_iRowItems + iX2*m_iChannels]
+              - p[(long long) iY2*m_iRowItems + iX1*m_iChannels] + p[(long long) iY1*m_iRowItems + iX1*m_iChannels];
+    }
+
+    // GetSumClipped() -- Same as GetSum(), but clips the rectangle to the image.  The number of pixels in the clipped area
+    // is returned in iCount (0 if the rectangle is outside of the image).
+    //
+    __forceinline _t GetSumClipped(int iX1,int iY1,int iX2,int iY2,int & iCount,int iChannel = 0) const
+    {
+        if (iX1 < 0) iX1 = 0;
+        if (iY1 < 0) iY1 = 0;
+        if (iX2 > m_iWidth) iX2 = m_iWidth;
+        if (iY2 > m_iHeight) iY2 = m_iHeight;
+        if (iX2 <= iX1 || iY2 <= iY1) { iCount = 0; return 0; }
+        iCount = (iX2-iX1)*(iY2-iY1);
+        return GetSum(iX1,iY1,iX2,iY2,iChannel);
+    }
+
+    // GetMean() -- Mean of the (2*iRadius+1) square around (iX,iY), clipped to the image.
+    //
+    __forceinline double GetMean(int iX,int iY,int iRadius,int iChannel = 0) const
+    {
+        int iCount;
+        _t tSum = GetSumClipped(iX-iRadius,iY-iRadius,iX+iRadius+1,iY+iRadius+1,iCount,iChannel);
+        return iCount ? (double) tSum/(double) iCount : 0.0;
+    }
+
+    __forceinline int GetWidth()    const { return m_iWidth;    }
+    __forceinline int GetHeight()   const { return m_iHeight;   }
+    __forceinline int GetChannels() const { return m_iChannels; }
+    bool isValid() const { return m_stSum.pMem && m_iWidth > 0; }
+};
+
+using CIntegralImage    = CSummedAreaTable<long long>;
+using CIntegralImageF   = CSummedAreaTable<double>;
+
+class CFastFilters
+{
+public:
+    static constexpr int kMaxMedianRadius = 127;    // Keeps the window count within the 16-bit histogram bins
+
+private:
+
+    // PrepareOutput() -- Create an empty output bitmap at the input size, or make sure it is the same size
+    //
+    static bool PrepareOutput(CBitmap & cIn,CBitmap & cOut)
+    {
+        if (cIn.isEmpty() || &cIn == &cOut) return false;
+        if (cOut.isEmpty()) return cOut.CreateBitmap(cIn.GetSize());
+        return cOut.GetWidth() == cIn.GetWidth() && cOut.GetHeight() == cIn.GetHeight();
+    }
+    static bool SameSize(const RawBitmap_t & stIn,const RawBitmap_t & stOut)
+    {
+        return stIn.stMem && stOut.stMem && stIn.stMem != stOut.stMem && stIn.iWidth == stOut.iWidth && stIn.iHeight == stOut.iHeight;
+    }
+
+    // MorphLine() -- van Herk/Gil-Werman min (bMax = false) or max (bMax = true) over a window of 2r+1 for one line of values.
+    //
+    // The line is padded by r on each side with the identity value (so pixels outside of the image are ignored), and split
+    // into blocks of the window size.  g[] holds running values from the start of each block and h[] from the end of each block, so
+    // the value for any window is op(h[start],g[end]), independent of the radius.
+    //
+    // pBuf must hold 3*(iCount + 4*iRadius + 2) values.
+    //
+    template <typename _t,bool bMax>
+    static void MorphLine(const _t * pIn,int iInStride,_t * pOut,int iOutStride,int iCount,int iRadius,_t tIdentity,_t * pBuf)
+    {
+        int k = 2*iRadius + 1;
+        int iLen = iCount + 2*iRadius;
+        iLen = ((iLen + k-1)/k)*k;
+
+        _t * f = pBuf;
+        _t * g = pBuf + iLen;
+        _t * h = pBuf + 2*iLen;
+
+        for (int i=0;i<iRadius;i++) f[i] = tIdentity;
+        for (int i=0;i<iCount;i++) f[iRadius + i] = pIn[(long long) i*iInStride];
+        for (int i=iRadius+iCount;i<iLen;i++) f[i] = tIdentity;
+
+        for (int i=0;i<iLen;i++)
+            if (i % k == 0) g[i] = f[i];
+            else g[i] = bMax ? (f[i] > g[i-1] ? f[i] : g[i-1]) : (f[i] < g[i-1] ? f[i] : g[i-1]);
+
+        for (int i=iLen-1;i>=0;i--)
+            if (i % k == k-1) h[i] = f[i];
+            else h[i] = bMax ? (f[i] > h[i+1] ? f[i] : h[i+1]) : (f[i] < h[i+1] ? f[i] : h[i+1]);
+
+        for (int i=0;i<iCount;i++)
+        {
+            _t a = h[i];
+            _t b = g[i + 2*iRadius];
+            pOut[(long long) i*iOutStride] = bMax ? (a > b ? a : b) : (a < b ? a : b);
+        }
+    }
+
+    // Morph() -- Separable 2-D erode/dilate over interleaved channels: horizontal pass (row bands) into a temporary
+    // buffer, then a vertical pass (column bands) into the output.
+    //
+    template <typename _t,bool bMax>
+    static bool Morph(const _t * pIn,_t * pOut,int iWidth,int iHeight,int iChannels,long long llInStride,long long llOutStride,int iRadius,_t tIdentity)
+    {
+        if (!pIn || !pOut || iWidth <= 0 || iHeight <= 0 || iRadius < 0) return false;
+
+        std::vector<_t> vTemp((size_t) iWidth*iHeight*iChannels);
+        int iTempStride = iWidth*iChannels;
+
+        if (!iRadius)
+        {
+            for (int iY=0;iY<iHeight;iY++) memcpy(pOut + iY*llOutStride,pIn + iY*llInStride,(size_t) iTempStride*sizeof(_t));
+            return true;
+        }
+
+        CParallel::ForBands(iHeight,[&](int iY1,int iY2,int)
+        {
+            std::vector<_t> vBuf(3*((size_t) iWidth + 4*iRadius + 2));
+            for (int iY=iY1;iY<iY2;iY++)
+                for (int c=0;c<iChannels;c++)
+                    MorphLine<_t,bMax>(pIn + iY*llInStride + c,iChannels,&vTemp[(size_t) iY*iTempStride + c],iChannels,iWidth,iRadius,tIdentity,vBuf.data());
+        });
+
+        CParallel::ForBands(iTempStride,[&](int iX1,int iX2,int)
+        {
+            std::vector<_t> vBuf(3*((size_t) iHeight + 4*iRadius + 2));
+            for (int iX=iX1;iX<iX2;iX++)
+                MorphLine<_t,bMax>(&vTemp[iX],iTempStride,pOut + iX,(int) llOutStride,iHeight,iRadius,tIdentity,vBuf.data());
+        },16);
+
+        return true;
+    }
+
+    // NaiveMorph() -- Reference version of Morph(): min/max over the whole window for every pixel.
+    //
+    template <typename _t,bool bMax>
+    static bool NaiveMorph(const _t * pIn,_t * pOut,int iWidth,int iHeight,int iChannels,long long llInStride,long long llOutStride,int iRadius)
+    {
+        if (!pIn || !pOut || iWidth <= 0 || iHeight <= 0 || iRadius < 0) return false;
+        for (int iY=0;iY<iHeight;iY++)
+            for (int iX=0;iX<iWidth;iX++)
+                for (int c=0;c<iChannels;c++)
+                {
+                    _t tValue = pIn[iY*llInStride + iX*iChannels + c];
+                    for (int y=max(0,iY-iRadius);y<=min(iHeight-1,iY+iRadius);y++)
+                        for (int x=max(0,iX-iRadius);x<=min(iWidth-1,iX+iRadius);x++)
+                        {
+                            _t t = pIn[y*llInStride + x*iChannels + c];
+                            if (bMax ? t > tValue : t < tValue) tValue = t;
+                        }
+                    pOut[iY*llOutStride + iX*iChannels + c] = tValue;
+                }
+        return true;
+    }
+
+    // Hist16 -- Add/Subtract 16-bit histograms with SSE2 (iCount must be a multiple of 8)
+    //
+    static __forceinline void AddHist(unsigned short * pDest,const unsigned short * pSource,int iCount)
+    {
+        for (int i=0;i<iCount;i+=8)
+            _mm_storeu_si128((__m128i *) (pDest+i),_mm_add_epi16(_mm_loadu_si128((__m128i *) (pDest+i)),_mm_loadu_si128((const __m128i *) (pSource+i))));
+    }
+    static __forceinline void SubHist(unsigned short * pDest,const unsigned short * pSource,int iCount)
+    {
+        for (int i=0;i<iCount;i+=8)
+            _mm_storeu_si128((__m128i *) (pDest+i),_mm_sub_epi16(_mm_loadu_si128((__m128i *) (pDest+i)),_mm_loadu_si128((const __m128i *) (pSource+i))));
+    }
+
+    // MedianBand() -- Median filter for one channel over a band of rows.
+    //
+    // Each column keeps a histogram of its 2r+1 rows (fine: 256 bins, coarse: 16 bins).  Moving down one row updates each column histogram
+    // by one pixel out and one in; moving right one pixel updates the kernel histogram by one column histogram out and one in.  The median is
+    // found by scanning the 16 coarse bins and then the 16 fine bins within the selected coarse bin.
+    //
+    static void MedianBand(const RawBitmap_t & stIn,RawBitmap_t & stOut,int iChannel,int iRadius,int iY1,int iY2)
+    {
+        int iWidth  = stIn.iWidth;
+        int iHeight = stIn.iHeight;
+        int iTarget = ((2*iRadius+1)*(2*iRadius+1))/2 + 1;
+
+        std::vector<unsigned short> vFine((size_t) iWidth*256);
+        std::vector<unsigned short> vCoarse((size_t) iWidth*16);
+
+        alignas(16) unsigned short uKernelFine[256];
+        alignas(16) unsigned short uKernelCoarse[16];
+
+        auto fnPixel = [&](int iX,int iY) -> int
+        {
+            iY = iY < 0 ? 0 : iY >= iHeight ? iHeight-1 : iY;
+            return stIn.stMem[(long long) iY*stIn.iWidthBytes + iX*3 + iChannel];
+        };
+        auto fnColumn = [iWidth](int iX) { return iX < 0 ? 0 : iX >= iWidth ? iWidth-1 : iX; };
+
+        for (int iY=iY1-iRadius;iY<=iY1+iRadius;iY++)
+            for (int iX=0;iX<iWidth;iX++)
+            {
+                int iValue = fnPixel(iX,iY);
+                vFine[(size_t) iX*256 + iValue]++;
+                vCoarse[(size_t) iX*16 + (iValue >> 4)]++;
+            }
+
+        for (int iY=iY1;iY<iY2;iY++)
+        {
+            if (iY > iY1)
+                for (int iX=0;iX<iWidth;iX++)
+                {
+                    int iOut = fnPixel(iX,iY-iRadius-1);
+                    int iIn  = fnPixel(iX,iY+iRadius);
+                    vFine[(size_t) iX*256 + iOut]--;
+                    vCoarse[(size_t) iX*16 + (iOut >> 4)]--;
+                    vFine[(size_t) iX*256 + iIn]++;
+                    vCoarse[(size_t) iX*16 + (iIn >> 4)]++;
+                }
+
+            memset(uKernelFine,0,sizeof(uKernelFine));
+            memset(uKernelCoarse,0,sizeof(uKernelCoarse));
+
+            for (int i=-iRadius;i<=iRadius;i++)
+            {
+                int iCol = fnColumn(i);
+                AddHist(uKernelFine,&vFine[(size_t) iCol*256],256);
+                AddHist(uKernelCoarse,&vCoarse[(size_t) iCol*16],16);
+            }
+
+            unsigned char * sOut = stOut.stMem + (long long) iY*stOut.iWidthBytes + iChannel;
+
+            for (int iX=0;iX<iWidth;iX++)
+            {
+                if (iX)
+                {
+                    int iColOut = fnColumn(iX-iRadius-1);
+                    int iColIn  = fnColumn(iX+iRadius);
+                    if (iColOut != iColIn)
+                    {
+                        SubHist(uKernelFine,&vFine[(size_t) iColOut*256],256);
+                        SubHist(uKernelCoarse,&vCoarse[(size_t) iColOut*16],16);
+                        AddHist(uKernelFine,&vFine[(size_t) iColIn*256],256);
+                        AddHist(uKernelCoarse,&vCoarse[(size_t) iColIn*16],16);
+                    }
+                }
+
+                int iSum = 0;
+                int iBin = 0;
+                while (iBin < 15 && iSum + uKernelCoarse[iBin] < iTarget) iSum += uKernelCoarse[iBin++];
+
+                int iValue = iBin*16;
+                while (iValue < iBin*16+15 && iSum + uKernelFine[iValue] < iTarget) iSum += uKernelFine[iValue++];
+
+                sOut[iX*3] = (unsigned char) iValue;
+            }
+        }
+    }
+
+public:
+
+    // BoxBlur() -- Mean of the (2*iRadius+1) square around each pixel, using a summed-area table.
+    // The cost per pixel is the same for any radius.
+    //
+    static bool BoxBlur(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius)
+    {
+        SageProfileZone("CFastFilters::BoxBlur");
+        if (!SameSize(stIn,stOut) || iRadius < 0) return false;
+        CIntegralImage cSum;
+        if (!cSum.Build(stIn)) return false;
+
+        CParallel::ForBands(stIn.iHeight,[&](int iY1,int iY2,int)
+        {
+            for (int iY=iY1;iY<iY2;iY++)
+            {
+                unsigned char * sOut = stOut.stMem + (long long) iY*stOut.iWidthBytes;
+                for (int iX=0;iX<stIn.iWidth;iX++)
+                {
+                    int iCount;
+                    for (int c=0;c<3;c++)
+                    {
+                        long long llSum = cSum.GetSumClipped(iX-iRadius,iY-iRadius,iX+iRadius+1,iY+iRadius+1,iCount,c);
+                        *sOut++ = (unsigned char) ((llSum + iCount/2)/iCount);
+                    }
+                }
+            }
+        });
+        return true;
+    }
+    static bool BoxBlur(CBitmap & cIn,CBitmap & cOut,int iRadius) { return PrepareOutput(cIn,cOut) && BoxBlur(*cIn,*cOut,iRadius); }
+
+    // BoxBlur() -- Float bitmap version
+    //
+    static bool BoxBlur(FloatBitmapM_t & fIn,FloatBitmapM_t & fOut,int iRadius)
+    {
+        SageProfileZone("CFastFilters::BoxBlur");
+        if (!fIn.fPixels || !fOut.fPixels || fIn.fPixels == fOut.fPixels || fIn.iWidth != fOut.iWidth || fIn.iHeight != fOut.iHeight || iRadius < 0) return false;
+        CIntegralImageF cSum;
+        if (!cSum.Build(fIn)) return false;
+
+        CParallel::ForBands(fIn.iHeight,[&](int iY1,int iY2,int)
+        {
+            for (int iY=iY1;iY<iY2;iY++)
+            {
+                float * fLine = fOut.fPixels + (long long) iY*fOut.iWidth;
+                for (int iX=0;iX<fIn.iWidth;iX++) fLine[iX] = (float) cSum.GetMean(iX,iY,iRadius);
+            }
+        });
+        return true;
+    }
+
+    // BoxBlurNaive() -- Reference version of BoxBlur() (sums the whole window for every pixel)
+    //
+    static bool BoxBlurNaive(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius)
+    {
+        if (!SameSize(stIn,stOut) || iRadius < 0) return false;
+        for (int iY=0;iY<stIn.iHeight;iY++)
+            for (int iX=0;iX<stIn.iWidth;iX++)
+                for (int c=0;c<3;c++)
+                {
+                    long long llSum = 0;
+                    int iCount = 0;
+                    for (int y=max(0,iY-iRadius);y<=min(stIn.iHeight-1,iY+iRadius);y++)
+                        for (int x=max(0,iX-iRadius);x<=min(stIn.iWidth-1,iX+iRadius);x++)
+                        {
+                            llSum += stIn.stMem[(long long) y*stIn.iWidthBytes + x*3 + c];
+                            iCount++;
+                        }
+                    stOut.stMem[(long long) iY*stOut.iWidthBytes + iX*3 + c] = (unsigned char) ((llSum + iCount/2)/iCount);
+                }
+        return true;
+    }
+
+    // LocalThreshold() -- Adaptive threshold against the local mean luminance.
+    //
+    // Each pixel is set to white when its luminance is above the mean of the (2*iRadius+1) square around it, less fBias (0-1) of the mean,
+    // and black otherwise.  This handles uneven lighting in scanned documents, where a single threshold does not.
+    // A radius of about 1/16th of the image width and a bias of .15 are good starting values for documents.
+    //
+    static bool LocalThreshold(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius,double fBias = .15)
+    {
+        if (!SameSize(stIn,stOut) || iRadius < 0) return false;
+        CIntegralImage cSum;
+        if (!cSum.Build(stIn,true)) return false;
+
+        double fScale = 1.0 - fBias;
+
+        CParallel::ForBands(stIn.iHeight,[&](int iY1,int iY2,int)
+        {
+            for (int iY=iY1;iY<iY2;iY++)
+            {
+                const unsigned char * sIn = stIn.stMem + (long long) iY*stIn.iWidthBytes;
+                unsigned char * sOut = stOut.stMem + (long long) iY*stOut.iWidthBytes;
+
+                for (int iX=0;iX<stIn.iWidth;iX++,sIn += 3)
+                {
+                    int iCount;
+                    long long llSum = cSum.GetSumClipped(iX-iRadius,iY-iRadius,iX+iRadius+1,iY+iRadius+1,iCount);
+                    int iLum = (77*sIn[2] + 150*sIn[1] + 29*sIn[0]) >> 8;
+                    unsigned char ucValue = (double) iLum*iCount > (double) llSum*fScale ? 255 : 0;
+                    *sOut++ = ucValue;
+                    *sOut++ = ucValue;
+                    *sOut++ = ucValue;
+                }
+            }
+        });
+        return true;
+    }
+    static bool LocalThreshold(CBitmap & cIn,CBitmap & cOut,int iRadius,double fBias = .15) { return PrepareOutput(cIn,cOut) && LocalThreshold(*cIn,*cOut,iRadius,fBias); }
+
+    // Erode() -- Minimum over the (2*iRadius+1) square around each pixel (per channel).  Shrinks bright areas/masks.
+    // Dilate() -- Maximum over the (2*iRadius+1) square around each pixel (per channel).  Grows bright areas/masks.
+    //
+    // Both use the van Herk/Gil-Werman algorithm, so the time is the same for any radius.
+    //
+    static bool Erode(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius)
+    {
+        return SameSize(stIn,stOut) && Morph<unsigned char,false>(stIn.stMem,stOut.stMem,stIn.iWidth,stIn.iHeight,3,stIn.iWidthBytes,stOut.iWidthBytes,iRadius,255);
+    }
+    static bool Dilate(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius)
+    {
+        return SameSize(stIn,stOut) && Morph<unsigned char,true>(stIn.stMem,stOut.stMem,stIn.iWidth,stIn.iHeight,3,stIn.iWidthBytes,stOut.iWidthBytes,iRadius,0);
+    }
+    static bool Erode(CBitmap & cIn,CBitmap & cOut,int iRadius)  { return PrepareOutput(cIn,cOut) && Erode(*cIn,*cOut,iRadius);  }
+    static bool Dilate(CBitmap & cIn,CBitmap & cOut,int iRadius) { return PrepareOutput(cIn,cOut) && Dilate(*cIn,*cOut,iRadius); }
+
+    // Erode()/Dilate() -- 8-bit single channel (mask) versions.  iStride is the number of bytes per row for both input and output.
+    //
+    static bool Erode(const unsigned char * sIn,unsigned char * sOut,int iWidth,int iHeight,int iStride,int iRadius)
+    {
+        return sIn != sOut && Morph<unsigned char,false>(sIn,sOut,iWidth,iHeight,1,iStride,iStride,iRadius,255);
+    }
+    static bool Dilate(const unsigned char * sIn,unsigned char * sOut,int iWidth,int iHeight,int iStride,int iRadius)
+    {
+        return sIn != sOut && Morph<unsigned char,true>(sIn,sOut,iWidth,iHeight,1,iStride,iStride,iRadius,0);
+    }
+
+    // Erode()/Dilate() -- Float bitmap versions
+    //
+    static bool Erode(FloatBitmapM_t & fIn,FloatBitmapM_t & fOut,int iRadius)
+    {
+        if (fIn.fPixels == fOut.fPixels || fIn.iWidth != fOut.iWidth || fIn.iHeight != fOut.iHeight) return false;
+        return Morph<float,false>(fIn.fPixels,fOut.fPixels,fIn.iWidth,fIn.iHeight,1,fIn.iWidth,fOut.iWidth,iRadius,FLT_MAX);
+    }
+    static bool Dilate(FloatBitmapM_t & fIn,FloatBitmapM_t & fOut,int iRadius)
+    {
+        if (fIn.fPixels == fOut.fPixels || fIn.iWidth != fOut.iWidth || fIn.iHeight != fOut.iHeight) return false;
+        return Morph<float,true>(fIn.fPixels,fOut.fPixels,fIn.iWidth,fIn.iHeight,1,fIn.iWidth,fOut.iWidth,iRadius,-FLT_MAX);
+    }
+
+    // Open() -- Erode then Dilate: removes bright specks smaller than the radius while keeping larger shapes.
+    // Close() -- Dilate then Erode: fills dark holes and gaps smaller than the radius.
+    //
+    static bool Open(CBitmap & cIn,CBitmap & cOut,int iRadius)
+    {
+        CBitmap cTemp;
+        return Erode(cIn,cTemp,iRadius) && Dilate(cTemp,cOut,iRadius);
+    }
+    static bool Close(CBitmap & cIn,CBitmap & cOut,int iRadius)
+    {
+        CBitmap cTemp;
+        return Dilate(cIn,cTemp,iRadius) && Erode(cTemp,cOut,iRadius);
+    }
+
+    // ErodeNaive()/DilateNaive() -- Reference versions of Erode() and Dilate()
+    //
+    static bool ErodeNaive(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius)
+    {
+        return SameSize(stIn,stOut) && NaiveMorph<unsigned char,false>(stIn.stMem,stOut.stMem,stIn.iWidth,stIn.iHeight,3,stIn.iWidthBytes,stOut.iWidthBytes,iRadius);
+    }
+    static bool DilateNaive(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius)
+    {
+        return SameSize(stIn,stOut) && NaiveMorph<unsigned char,true>(stIn.stMem,stOut.stMem,stIn.iWidth,stIn.iHeight,3,stIn.iWidthBytes,stOut.iWidthBytes,iRadius);
+    }
+
+    // Median() -- Median of the (2*iRadius+1) square around each pixel (per channel), with edge pixels replicated.
+    //
+    // This uses sliding column histograms, so the time per pixel does not grow with the radius.  iRadius is limited to kMaxMedianRadius.
+    //
+    static bool Median(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius)
+    {
+        SageProfileZone("CFastFilters::Median");
+        if (!SameSize(stIn,stOut) || iRadius < 0 || iRadius > kMaxMedianRadius) return false;
+
+        CParallel::ForBands(stIn.iHeight,[&](int iY1,int iY2,int)
+        {
+            for (int c=0;c<3;c++) MedianBand(stIn,stOut,c,iRadius,iY1,iY2);
+        });
+        return true;
+    }
+    static bool Median(CBitmap & cIn,CBitmap & cOut,int iRadius) { return PrepareOutput(cIn,cOut) && Median(*cIn,*cOut,iRadius); }
+
+    // MedianNaive() -- Reference version of Median() (sorts the whole window for every pixel)
+    //
+    static bool MedianNaive(RawBitmap_t & stIn,RawBitmap_t & stOut,int iRadius)
+    {
+        if (!SameSize(stIn,stOut) || iRadius < 0) return false;
+        int iHist[256];
+
+        for (int iY=0;iY<stIn.iHeight;iY++)
+            for (int iX=0;iX<stIn.iWidth;iX++)
+                for (int c=0;c<3;c++)
+                {
+                    memset(iHist,0,sizeof(iHist));
+                    for (int y=iY-iRadius;y<=iY+iRadius;y++)
+                        for (int x=iX-iRadius;x<=iX+iRadius;x++)
+                        {
+                            int yy = y < 0 ? 0 : y >= stIn.iHeight ? stIn.iHeight-1 : y;
+                            int xx = x < 0 ? 0 : x >= stIn.iWidth  ? stIn.iWidth-1  : x;
+                            iHist[stIn.stMem[(long long) yy*stIn.iWidthBytes + xx*3 + c]]++;
+                        }
+
+                    int iTarget = ((2*iRadius+1)*(2*iRadius+1))/2 + 1;
+                    int iSum = 0, iValue = 0;
+                    while ((iSum += iHist[iValue]) < iTarget) iValue++;
+                    stOut.stMem[(long long) iY*stOut.iWidthBytes + iX*3 + c] = (unsigned char) iValue;
+                }
+        return true;
+    }
+};
+
+}; // namespace Sage
+#endif // _CFastFilters_H_
@@ -0,0 +1,713 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CFormatCache -- Compiled printf() format strings with Sagebox {} markup, cached by format-string pointer.
+//
+// printf()-style output with markup such as "Finished. Time = {g}%d{/} ms" normally parses the format and the
+// markup on every call.  CFormatCache compiles a format string the first time it is seen into a small program of
+// literal runs, argument slots and style push/pop operations, with color names resolved up-front (via CColorTable).
+// Later calls with the same format string only format the arguments.
+//
+// The cache is keyed by the format-string pointer.  The text is compared with the compiled copy only when a thread first
+// sees a pointer (or sees a different pointer in the same slot of its per-thread cache), so a hit costs a pointer compare and
+// does not read the format.  This suits string literals, which are the common case.  A format built in a buffer that is then
+// changed in place (same address, different text) must be passed to Forget() after the change, or it is run with the old
+// program.  Resolved colors are refreshed automatically when user colors change (see CColorTable::GetGeneration()).
+//
+// Output goes to a sink with two functions:
+//
+//      void Text(const char * sText,int iLength,const FormatStyle_t & stStyle);      -- A run of text in the given style
+//      void Markup(const char * sMarkup,int iLength);                                 -- Markup not handled here (i.e. "{u}", "{x=40}")
+//
+// Example:
+//
+//      CFormatCache::Printf(MySink,"Finished. Time = {g}%d{/} ms\n",iTime);
+//
+// or, to get the formatted text with any markup left in place (i.e. to pass to Write()):
+//
+//      std::string sOut;
+//      CFormatCache::Sprintf(sOut,"Finished. Time = {g}%d{/} ms\n",iTime);
+//
+// Markup handled by the compiled program:
+//
+//      {<color>}       -- Push a text color, i.e. {g}, {lb}, {red}, {MyColor}
+//      {bg=<color>}    -- Push a background color
+//      {/}             -- Pop the last {} item.  If the last item was passed through as markup, "{/}" is passed through also.
+//
+// Anything else in {} is passed to the sink's Markup() function unchanged.  A '{' without a closing '}' is literal text.
+//
+// Arguments are always output as text -- markup inside an argument (i.e. a %s string containing "{r}") is not interpreted.
+// A format with a conversion that is not supported here (m_bValid is false) is run as far as that conversion, and the rest
+// of the format is formatted with vsnprintf() and output as plain text (including any markup after that point).
+//
+#if !defined(_CFormatCache_H_)
+#define _CFormatCache_H_
+
+#include <Windows.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CColorTable.h"
+#include "CNumFormat.h"
+
+namespace Sage
+{
+
+// FormatStyle_t -- Current style for a run of text.  bFgColor/bBgColor are false when the window's own color is in use.
+//
+struct FormatStyle_t
+{
+    DWORD   dwFgColor   = 0;
+    DWORD   dwBgColor   = 0;
+    bool    bFgColor    = false;
+    bool    bBgColor    = false;
+};
+
+class CFormatProgram
+{
+public:
+    enum class Op : unsigned char
+    {
+        Literal,        // Text from the format string
+        Arg,            // Formatted argument (see Arg_t)
+        PushFg,         // Push text color
+        PushBg,         // Push background color
+        Pop,            // {/}
+        Markup,         // Markup passed through to the sink
+    };
+
+    enum class ArgType : unsigned char
+    {
+        Int,
+        UInt,
+        Char,           // signed char (hh)
+        UChar,
+        Short,          // h
+        UShort,
+        Long,           // l
+        ULong,
+        LongLong,       // ll, I64
+        ULongLong,
+        SizeT,          // z, I
+        PtrDiff,        // t
+        IntMax,         // j
+        UIntMax,
+        Double,
+        LongDouble,     // L
+        String,
+        WideString,     // ls, S
+        Character,      // %c
+        Pointer,
+        Count,          // %n -- consumed, but never written
+    };
+
+    struct Arg_t
+    {
+        ArgType     eType;
+        bool        bStarWidth;         // Width given as '*' (consumes an int argument)
+        bool        bStarPrecision;     // Precision given as '.*'
+        bool        bPlain;             // No flags, width or precision -- allows the direct paths in Run()
+        char        cConv;              // Conversion character (i.e. 'd', 'f', 's')
+        char        sSpec[32];          // Normalized printf spec for this argument, i.e. "%-8.3lld"
+    };
+
+    struct Instr_t
+    {
+        Op          eOp;
+        int         iOffset;            // Literal/Markup: offset into the format string; Arg: index into m_vArgs; Push: color name offset
+        int         iLength;            // Literal/Markup/Push: length
+        DWORD       dwColor;            // PushFg/PushBg: resolved color
+    };
+
+    std::string             m_sFormat;          // Copy of the format string (also used to validate the cache entry)
+    std::vector<Instr_t>    m_vInstr;
+    std::vector<Arg_t>      m_vArgs;
+    unsigned int            m_uiColorGeneration = 0;
+    bool                    m_bValid = true;    // False if the format had an unsupported conversion (see m_iFallback)
+    int                     m_iFallback = 0;    // !m_bValid: offset of the unsupported conversion.  m_vInstr covers the format
+                                                // up to there; the rest is formatted with vsnprintf().
+
+    // Matches() -- True if sFormat has the same text as the compiled format.  Only called when a pointer is first seen.
+    //
+    bool Matches(const char * sFormat) const { return !strcmp(m_sFormat.c_str(),sFormat); }
+
+    // Compile() -- Compile a format string.
+    //
+    void Compile(const char * sFormat)
+    {
+        m_sFormat = sFormat ? sFormat : "";
+        m_vInstr.clear();
+        m_vArgs.clear();
+        m_bValid = true;
+        m_iFallback = 0;
+        m_uiColorGeneration = CColorTable::GetGeneration();     // Set first, so a format that fails to compile is still current
+
+        const char * sBase  = m_sFormat.c_str();
+        int iLength         = (int) m_sFormat.length();
+        int iLiteral        = 0;                // Start of the current literal run
+
+        auto FlushLiteral = [&](int iEnd)
+        {
+            if (iEnd > iLiteral) m_vInstr.push_back({ Op::Literal, iLiteral, iEnd-iLiteral, 0 });
+        };
+
+        for (int i=0;i<iLength;)
+        {
+            char c = sBase[i];
+            if (c == '%')
+            {
+                if (sBase[i+1] == '%')
+                {
+                    FlushLiteral(i+1);      // Keep the first '%' as text
+                    i += 2;
+                    iLiteral = i;
+                    continue;
+                }
+                FlushLiteral(i);
+                int iEnd = CompileArg(sBase,i);
+                if (iEnd < 0)
+                {
+                    m_bValid = false;
+                    m_iFallback = i;
+                    return;
+                }
+                m_vInstr.push_back({ Op::Arg, (int) m_vArgs.size()-1, 0, 0 });
+                i = iLiteral = iEnd;
+                continue;
+            }
+            if (c == '{')
+            {
+                const char * sClose = (const char *) memchr(sBase+i+1,'}',iLength-i-1);
+                if (sClose)
+                {
+                    FlushLiteral(i);
+                    CompileMarkup(sBase,i+1,(int) (sClose-sBase));
+                    i = iLiteral = (int) (sClose-sBase)+1;
+                    continue;
+                }
+            }
+            i++;
+        }
+        FlushLiteral(iLength);
+    }
+
+    // ResolveColors() -- Look up the colors again (called when user colors have changed since Compile())
+    //
+    void ResolveColors()
+    {
+        for (auto & stInstr : m_vInstr)
+            if (stInstr.eOp == Op::PushFg || stInstr.eOp == Op::PushBg)
+                CColorTable::GetColor(m_sFormat.c_str() + stInstr.iOffset,stInstr.iLength,stInstr.dwColor);
+        m_uiColorGeneration = CColorTable::GetGeneration();
+    }
+
+private:
+    void CompileMarkup(const char * sBase,int iStart,int iEnd)
+    {
+        int iLength = iEnd-iStart;
+        const char * sMarkup = sBase+iStart;
+        DWORD dwColor = 0;
+
+        if (iLength == 1 && *sMarkup == '/')
+            m_vInstr.push_back({ Op::Pop, iStart-1, 3, 0 });
+        else if (iLength > 3 && CColorTable::Lower(sMarkup[0]) == 'b' && CColorTable::Lower(sMarkup[1]) == 'g' && sMarkup[2] == '='
+                 && CColorTable::GetColor(sMarkup+3,iLength-3,dwColor))
+            m_vInstr.push_back({ Op::PushBg, iStart+3, iLength-3, dwColor });
+        else if (CColorTable::GetColor(sMarkup,iLength,dwColor))
+            m_vInstr.push_back({ Op::PushFg, iStart, iLength, dwColor });
+        else
+            m_vInstr.push_back({ Op::Markup, iStart-1, iLength+2, 0 });
+    }
+
+    // CompileArg() -- Compile one '%' conversion starting at iStart.  Returns the offset past it, or -1 if it is not supported.
+    //
+    int CompileArg(const char * sBase,int iStart)
+    {
+        Arg_t stArg = {};
+        std::string sSpec = "%";
+        int i = iStart+1;
+
+        while (strchr("-+ #0",sBase[i]) && sBase[i]) sSpec += sBase[i++];
+        if (sBase[i] == '*') { stArg.bStarWidth = true; sSpec += sBase[i++]; }
+        else while (sBase[i] >= '0' && sBase[i] <= '9') sSpec += sBase[i++];
+        if (sBase[i] == '.')
+        {
+            sSpec += sBase[i++];
+            if (sBase[i] == '*') { stArg.bStarPrecision = true; sSpec += sBase[i++]; }
+            else while (sBase[i] >= '0' && sBase[i] <= '9') sSpec += sBase[i++];
+        }
+        stArg.bPlain = sSpec.length() == 1;
+
+        // Length modifiers.  Integer arguments are fetched at their own size and printed as long long.
+
+        enum { None, hh, h, l, ll, z, t, j, L, I64 } eMod = None;
+        if (sBase[i] == 'h') { i++; eMod = h; if (sBase[i] == 'h') { i++; eMod = hh; } }
+        else if (sBase[i] == 'l') { i++; eMod = l; if (sBase[i] == 'l') { i++; eMod = ll; } }
+        else if (sBase[i] == 'z') { i++; eMod = z; }
+        else if (sBase[i] == 't') { i++; eMod = t; }
+        else if (sBase[i] == 'j') { i++; eMod = j; }
+        else if (sBase[i] == 'L') { i++; eMod = L; }
+        else if (sBase[i] == 'I')
+        {
+            if (sBase[i+1] == '6' && sBase[i+2] == '4') { i += 3; eMod = I64; }
+            else if (sBase[i+1] == '3' && sBase[i+2] == '2') i += 3;
+            else { i++; eMod = z; }
+        }
+
+        char cConv = sBase[i++];
+        stArg.cConv = cConv;
+        switch (cConv)
+        {
+            case 'd': case 'i':
+            case 'u': case 'o': case 'x': case 'X':
+            {
+                bool bSigned = cConv == 'd' || cConv == 'i';
+                switch (eMod)
+                {
+                    case hh:    stArg.eType = bSigned ? ArgType::Char : ArgType::UChar;             break;
+                    case h:     stArg.eType = bSigned ? ArgType::Short : ArgType::UShort;           break;
+                    case l:     stArg.eType = bSigned ? ArgType::Long : ArgType::ULong;             break;
+                    case ll:
+                    case I64:   stArg.eType = bSigned ? ArgType::LongLong : ArgType::ULongLong;     break;
+                    case z:     stArg.eType = ArgType::SizeT;                                       break;
+                    case t:     stArg.eType = ArgType::PtrDiff;                                     break;
+                    case j:     stArg.eType = bSigned ? ArgType::IntMax : ArgType::UIntMax;         break;
+                    default:    stArg.eType = bSigned ? ArgType::Int : ArgType::UInt;               break;
+                }
+                sSpec += "ll";
+                sSpec += (cConv == 'i' ? 'd' : cConv);
+                break;
+            }
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                stArg.eType = eMod == L ? ArgType::LongDouble : ArgType::Double;
+                if (eMod == L) sSpec += 'L';
+                sSpec += cConv;
+                break;
+            case 's':
+            case 'S':
+                stArg.eType = (cConv == 'S' || eMod == l) ? ArgType::WideString : ArgType::String;
+                sSpec += stArg.eType == ArgType::WideString ? "ls" : "s";
+                break;
+            case 'c':
+                stArg.eType = ArgType::Character;
+                sSpec += 'c';
+                break;
+            case 'p':
+                stArg.eType = ArgType::Pointer;
+                sSpec += 'p';
+                break;
+            case 'n':
+                stArg.eType = ArgType::Count;
+                break;
+            default:
+                return -1;
+        }
+        if (sSpec.length() >= sizeof(stArg.sSpec)) return -1;
+        strcpy(stArg.sSpec,sSpec.c_str());
+        m_vArgs.push_back(stArg);
+        return i;
+    }
+};
+
+class CFormatCache
+{
+    static constexpr int kMaxStyleDepth = 32;
+    static constexpr int kMaxEntries    = 4096;     // The cache is cleared if it grows past this (i.e. formats built at run-time)
+
+    struct Cache_t
+    {
+        std::shared_timed_mutex mtLock;
+        std::unordered_map<const char *,std::shared_ptr<CFormatProgram>> mPrograms;
+        std::atomic<long long> llHits{0};
+        std::atomic<long long> llMisses{0};
+        std::atomic<unsigned int> uiEpoch{0};       // Changed by Clear() and Forget(), so the per-thread caches let go of old programs
+    };
+    static Cache_t & GetCache() { static Cache_t stCache; return stCache; }
+
+    // FormatArg() -- Format one argument into sBuffer (iBufferSize).  Returns the length, which may be larger than the buffer.
+    //
+    static int FormatArg(const CFormatProgram::Arg_t & stArg,va_list & vaArgs,char * sBuffer,int iBufferSize,const char * & sDirect)
+    {
+        using ArgType = CFormatProgram::ArgType;
+
+        int iWidth      = stArg.bStarWidth ? va_arg(vaArgs,int) : 0;
+        int iPrecision  = stArg.bStarPrecision ? va_arg(vaArgs,int) : 0;
+        sDirect         = nullptr;
+
+        auto Print = [&](auto xValue) -> int
+        {
+            if (stArg.bStarWidth && stArg.bStarPrecision) return snprintf(sBuffer,iBufferSize,stArg.sSpec,iWidth,iPrecision,xValue);
+            if (stArg.bStarWidth) return snprintf(sBuffer,iBufferSize,stArg.sSpec,iWidth,xValue);
+            if (stArg.bStarPrecision) return snprintf(sBuffer,iBufferSize,stArg.sSpec,iPrecision,xValue);
+            return snprintf(sBuffer,iBufferSize,stArg.sSpec,xValue);
+        };
+
+        // Plain %d, %u, %f, %e and %g (the common cases) are converted with CNumFormat rather than snprintf()
+
+        auto PrintInt = [&](long long llValue) -> int
+        {
+            if (!stArg.bPlain || stArg.cConv == 'o' || stArg.cConv == 'x' || stArg.cConv == 'X') return Print(llValue);
+            if (stArg.cConv == 'u') return CNumFormat::UIntToText(sBuffer,(unsigned long long) llValue);
+            return CNumFormat::IntToText(sBuffer,llValue);
+        };
+        auto PrintDouble = [&](double fValue) -> int
+        {
+            if (!stArg.bPlain || iBufferSize < CNumFormat::kMaxFormatText || stArg.cConv == 'a' || stArg.cConv == 'A') return Print(fValue);
+            char sStyle[3] = { '%', stArg.cConv, 0 };
+            return CNumFormat::Format(sBuffer,fValue,sStyle);
+        };
+
+        switch (stArg.eType)
+        {
+            case ArgType::Int:          return PrintInt((long long) va_arg(vaArgs,int));
+            case ArgType::UInt:         return PrintInt((long long) va_arg(vaArgs,unsigned int));
+            case ArgType::Char:         return PrintInt((long long) (signed char) va_arg(vaArgs,int));
+            case ArgType::UChar:        return PrintInt((long long) (unsigned char) va_arg(vaArgs,int));
+            case ArgType::Short:        return PrintInt((long long) (short) va_arg(vaArgs,int));
+            case ArgType::UShort:       return PrintInt((long long) (unsigned short) va_arg(vaArgs,int));
+            case ArgType::Long:         return PrintInt((long long) va_arg(vaArgs,long));
+            case ArgType::ULong:        return PrintInt((long long) va_arg(vaArgs,unsigned long));
+            case ArgType::LongLong:     return PrintInt(va_arg(vaArgs,long long));
+            case ArgType::ULongLong:    return PrintInt((long long) va_arg(vaArgs,unsigned long long));
+            case ArgType::SizeT:        return PrintInt((long long) va_arg(vaArgs,size_t));
+            case ArgType::PtrDiff:      return PrintInt((long long) va_arg(vaArgs,ptrdiff_t));
+            case ArgType::IntMax:       return PrintInt((long long) va_arg(vaArgs,intmax_t));
+            case ArgType::UIntMax:      return PrintInt((long long) va_arg(vaArgs,uintmax_t));
+            case ArgType::Double:       return PrintDouble(va_arg(vaArgs,double));
+            case ArgType::LongDouble:   return Print(va_arg(vaArgs,long double));
+            case ArgType::WideString:   return Print(va_arg(vaArgs,const wchar_t *));
+            case ArgType::Character:    return Print(va_arg(vaArgs,int));
+            case ArgType::Pointer:      return Print(va_arg(vaArgs,void *));
+            case ArgType::Count:        (void) va_arg(vaArgs,void *); return 0;
+            case ArgType::String:
+            {
+                const char * sString = va_arg(vaArgs,const char *);
+                if (stArg.bPlain)
+                {
+                    sDirect = sString ? sString : "(null)";
+                    return (int) strlen(sDirect);
+                }
+                return Print(sString);
+            }
+            default:
+                return 0;
+        }
+    }
+
+    // FormatArgAlloc() -- FormatArg() with a fallback to a larger buffer for long output.
+    //
+    static int FormatArgAlloc(const CFormatProgram::Arg_t & stArg,va_list & vaArgs,char * sBuffer,int iBufferSize,
+                              std::vector<char> & vLarge,const char * & sOut)
+    {
+        va_list vaCopy;
+        va_copy(vaCopy,vaArgs);
+        int iLength = FormatArg(stArg,vaArgs,sBuffer,iBufferSize,sOut);
+        if (!sOut && iLength >= iBufferSize)
+        {
+            vLarge.resize(iLength+1);
+            const char * sIgnore;
+            FormatArg(stArg,vaCopy,vLarge.data(),iLength+1,sIgnore);
+            sOut = vLarge.data();
+        }
+        else if (!sOut) sOut = sBuffer;
+        va_end(vaCopy);
+        return iLength < 0 ? 0 : iLength;
+    }
+
+public:
+    // GetProgram() -- Returns the compiled program for a format string, compiling it the first time it is seen.
+    //
+    static std::shared_ptr<CFormatProgram> GetProgram(const char * sFormat)
+    {
+        if (!sFormat) sFormat = "";
+        auto & stCache = GetCache();
+        std::shared_ptr<CFormatProgram> pProgram;
+        {
+            std::shared_lock<std::shared_timed_mutex> lock(stCache.mtLock);
+            auto it = stCache.mPrograms.find(sFormat);
+            if (it != stCache.mPrograms.end()) pProgram = it->second;
+        }
+
+        if (pProgram && pProgram->Matches(sFormat))
+        {
+            stCache.llHits++;
+            if (pProgram->m_uiColorGeneration != CColorTable::GetGeneration())
+            {
+                // Compile a new copy rather than changing one that may be in use by another thread
+
+                auto pNew = std::make_shared<CFormatProgram>(*pProgram);
+                pNew->ResolveColors();
+                std::unique_lock<std::shared_timed_mutex> lock(stCache.mtLock);
+                stCache.mPrograms[sFormat] = pNew;
+                return pNew;
+            }
+            return pProgram;
+        }
+
+        auto pNew = std::make_shared<CFormatProgram>();
+        pNew->Compile(sFormat);
+
+        std::unique_lock<std::shared_timed_mutex> lock(stCache.mtLock);
+        stCache.llMisses++;
+        if ((int) stCache.mPrograms.size() >= kMaxEntries) stCache.mPrograms.clear();
+        stCache.mPrograms[sFormat] = pNew;
+        return pNew;
+    }
+
+    // FindProgram() -- GetProgram() with a small per-thread cache in front of it, so repeated calls from the same
+    // call site do not take the shared lock.  A hit is a pointer compare only -- the text is not read (see the notes at the
+    // top of this file).
+    //
+    // The returned program is only held by the per-thread cache, so it is valid until the next FindProgram() call on
+    // the same thread.  Printf() and Sprintf() called from inside a sink (while a Printf() is running) use GetProgram()
+    // instead, so they cannot replace the program that is being run.
+    //
+    static const CFormatProgram & FindProgram(const char * sFormat)
+    {
+        struct LocalEntry_t
+        {
+            const char * sKey;
+            unsigned int uiEpoch;
+            std::shared_ptr<CFormatProgram> pProgram;
+        };
+        static constexpr int kLocalEntries = 64;
+        thread_local LocalEntry_t stLocal[kLocalEntries];
+        thread_local int iLocalHits = 0;
+
+        if (!sFormat) sFormat = "";
+        auto & stEntry = stLocal[((size_t) sFormat >> 4) & (kLocalEntries-1)];
+        unsigned int uiEpoch = GetCache().uiEpoch.load(std::memory_order_acquire);
+
+        if (stEntry.sKey == sFormat && stEntry.uiEpoch == uiEpoch && stEntry.pProgram->m_uiColorGeneration == CColorTable::GetGeneration())
+        {
+            // Hits are added to the shared count in batches, to avoid contention on the counter
+
+            if (++iLocalHits == 256) { GetCache().llHits += iLocalHits; iLocalHits = 0; }
+            return *stEntry.pProgram;
+        }
+
+        stEntry.pProgram = GetProgram(sFormat);
+        stEntry.sKey = sFormat;
+        stEntry.uiEpoch = uiEpoch;
+        return *stEntry.pProgram;
+    }
+
+    // Run() -- Output a compiled program with the given arguments to a sink (see notes at the top of this file).
+    //
+    template <typename _Sink>
+    static void Run(const CFormatProgram & cProgram,_Sink & cSink,va_list vaInput)
+    {
+        using Op = CFormatProgram::Op;
+
+        va_list vaArgs;                 // Local copy, so it can be passed by reference to FormatArgAlloc()
+        va_copy(vaArgs,vaInput);
+
+        struct Stack_t
+        {
+            FormatStyle_t   stStyle;
+            bool            bMarkup;        // True if the pushed item was passed through as markup
+        };
+
+        Stack_t stStack[kMaxStyleDepth];
+        int iDepth = 0;
+        FormatStyle_t stStyle;
+
+        char sBuffer[CNumFormat::kMaxFormatText];
+        std::vector<char> vLarge;
+        const char * sFormat = cProgram.m_sFormat.c_str();
+
+        auto Push = [&](bool bMarkup)
+        {
+            if (iDepth < kMaxStyleDepth) stStack[iDepth] = { stStyle, bMarkup };
+            iDepth++;
+        };
+
+        for (auto & stInstr : cProgram.m_vInstr)
+        {
+            switch (stInstr.eOp)
+            {
+                case Op::Literal:
+                    cSink.Text(sFormat + stInstr.iOffset,stInstr.iLength,stStyle);
+                    break;
+                case Op::Arg:
+                {
+                    const char * sOut;
+                    int iLength = FormatArgAlloc(cProgram.m_vArgs[stInstr.iOffset],vaArgs,sBuffer,sizeof(sBuffer),vLarge,sOut);
+                    if (iLength) cSink.Text(sOut,iLength,stStyle);
+                    break;
+                }
+                case Op::PushFg:
+                    Push(false);
+                    stStyle.dwFgColor = stInstr.dwColor;
+                    stStyle.bFgColor = true;
+                    break;
+                case Op::PushBg:
+                    Push(false);
+                    stStyle.dwBgColor = stInstr.dwColor;
+                    stStyle.bBgColor = true;
+                    break;
+                case Op::Markup:
+                    Push(true);
+                    cSink.Markup(sFormat + stInstr.iOffset,stInstr.iLength);
+                    break;
+                case Op::Pop:
+                    if (!iDepth || iDepth > kMaxStyleDepth || stStack[iDepth-1].bMarkup) cSink.Markup(sFormat + stInstr.iOffset,stInstr.iLength);
+                    else stStyle = stStack[iDepth-1].stStyle;
+                    if (iDepth) iDepth--;
+                    break;
+            }
+        }
+
+        // Unsupported conversion -- the rest of the format (from that conversion on) is plain text from vsnprintf()
+
+        if (!cProgram.m_bValid)
+        {
+            std::string sText;
+            FormatFallback(sText,sFormat + cProgram.m_iFallback,vaArgs);
+            if (!sText.empty()) cSink.Text(sText.c_str(),(int) sText.length(),stStyle);
+        }
+        va_end(vaArgs);
+    }
+
+    // Printf() -- Compile (or find in the cache) and output a format string to a sink.
+    //
+    template <typename _Sink>
+    static void Printf(_Sink & cSink,const char * sFormat,...)
+    {
+        va_list vaArgs;
+        va_start(vaArgs,sFormat);
+        vPrintf(cSink,sFormat,vaArgs);
+        va_end(vaArgs);
+    }
+
+    template <typename _Sink>
+    static void vPrintf(_Sink & cSink,const char * sFormat,va_list vaArgs)
+    {
+        RunDepth_t stDepth;
+        if (stDepth.iDepth > 1)
+        {
+            // Called from inside a sink -- hold the program here rather than in the per-thread cache (see FindProgram())
+
+            auto pProgram = GetProgram(sFormat);
+            Run(*pProgram,cSink,vaArgs);
+        }
+        else Run(FindProgram(sFormat),cSink,vaArgs);
+    }
+
+    // Sprintf() -- Append the formatted text to sOut.  Colors handled by the program are written back out as markup
+    // (i.e. "{g}" becomes "{g}" again), so the output may be given to any function that takes Sagebox markup.
+    //
+    static void Sprintf(std::string & sOut,const char * sFormat,...)
+    {
+        va_list vaArgs;
+        va_start(vaArgs,sFormat);
+        vSprintf(sOut,sFormat,vaArgs);
+        va_end(vaArgs);
+    }
+
+    static void vSprintf(std::string & sOut,const char * sFormat,va_list vaInput)
+    {
+        std::shared_ptr<CFormatProgram> pHold;
+        auto pProgram = RunDepth_t::GetDepth() ? (pHold = GetProgram(sFormat)).get() : &FindProgram(sFormat);
+
+        // Run the program with the color ops turned back into their original markup
+
+        va_list vaArgs;
+        va_copy(vaArgs,vaInput);
+        const char * sBase = pProgram->m_sFormat.c_str();
+        for (auto & stInstr : pProgram->m_vInstr)
+        {
+            using Op = CFormatProgram::Op;
+            switch (stInstr.eOp)
+            {
+                case Op::Literal:   sOut.append(sBase + stInstr.iOffset,stInstr.iLength); break;
+                case Op::Markup:
+                case Op::Pop:       sOut.append(sBase + stInstr.iOffset,stInstr.iLength); break;
+                case Op::PushFg:    sOut += '{'; sOut.append(sBase + stInstr.iOffset,stInstr.iLength); sOut += '}'; break;
+                case Op::PushBg:    sOut += "{bg="; sOut.append(sBase + stInstr.iOffset,stInstr.iLength); sOut += '}'; break;
+                case Op::Arg:
+                {
+                    char sBuffer[CNumFormat::kMaxFormatText];
+                    std::vector<char> vLarge;
+                    const char * sText;
+                    int iLength = FormatArgAlloc(pProgram->m_vArgs[stInstr.iOffset],vaArgs,sBuffer,sizeof(sBuffer),vLarge,sText);
+                    sOut.append(sText,iLength);
+                    break;
+                }
+            }
+        }
+        if (!pProgram->m_bValid) FormatFallback(sOut,sBase + pProgram->m_iFallback,vaArgs);     // As in Run()
+        va_end(vaArgs);
+    }
+
+    // GetStats() -- Cache hit/miss counts and the number of compiled formats
+    //
+    static void GetStats(long long & llHits,long long & llMisses,int & iEntries)
+    {
+        auto & stCache = GetCache();
+        std::shared_lock<std::shared_timed_mutex> lock(stCache.mtLock);
+        llHits      = stCache.llHits;
+        llMisses    = stCache.llMisses;
+        iEntries    = (int) stCache.mPrograms.size();
+    }
+
+    // Clear() -- Remove all compiled formats (programs in use remain valid until released)
+    //
+    static void Clear()
+    {
+        auto & stCache = GetCache();
+        std::unique_lock<std::shared_timed_mutex> lock(stCache.mtLock);
+        stCache.mPrograms.clear();
+        stCache.uiEpoch++;
+    }
+
+    // Forget() -- Drop the compiled program for a format buffer whose text has been changed in place, so the next call
+    // with it compiles the new text.  Not needed for string literals or for buffers that are not reused.
+    //
+    static void Forget(const char * sFormat)
+    {
+        auto & stCache = GetCache();
+        std::unique_lock<std::shared_timed_mutex> lock(stCache.mtLock);
+        stCache.mPrograms.erase(sFormat ? sFormat : "");
+        stCache.uiEpoch++;
+    }
+
+private:
+    // RunDepth_t -- Counts the vPrintf() calls running on this thread, so that calls made from inside a sink can be detected
+    //
+    struct RunDepth_t
+    {
+        int iDepth;
+        static int & GetDepth() { thread_local int iDepth = 0; return iDepth; }
+        RunDepth_t() { iDepth = ++GetDepth(); }
+        ~RunDepth_t() { --GetDepth(); }
+    };
+
+    // FormatFallback() -- Append the output of vsnprintf() for the whole format (used for formats that did not compile)
+    //
+    static void FormatFallback(std::string & sOut,const char * sFormat,va_list & vaArgs)
+    {
+        char sBuffer[1024];
+        va_list vaCopy;
+        va_copy(vaCopy,vaArgs);
+        int iLength = vsnprintf(sBuffer,sizeof(sBuffer),sFormat,vaArgs);
+        if (iLength >= (int) sizeof(sBuffer))
+        {
+            std::vector<char> vOut(iLength+1);
+            vsnprintf(vOut.data(),vOut.size(),sFormat,vaCopy);
+            sOut.append(vOut.data(),iLength);
+        }
+        else if (iLength > 0) sOut.append(sBuffer,iLength);
+        va_end(vaCopy);
+    }
+};
+
+}; // namespace Sage
+#endif // _CFormatCache_H_
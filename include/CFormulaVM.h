@@ -0,0 +1,780 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CFormulaVM -- Bytecode back-end for CToken/CTree expressions, for formulas evaluated per pixel or per sample.
+//
+// CFormulaCompiler lowers expression trees (stNODE/stNODEDATA, as built by CTree) to a compact register bytecode
+// (CFormulaProgram):
+//
+//      1. Each tree is converted to value-numbered IR, so repeated sub-expressions (common subexpressions) are computed once.
+//      2. Operations on constants are folded at compile time, and identities (x+0, x*1, x/1, x-0) are removed.
+//      3. Only values that reach the result (or an assigned variable) are emitted, and temporary registers are reused
+//         once a value is no longer needed.
+//
+// Each instruction is 4 bytes (op, destination, two operand registers).  Registers hold doubles: variables first, then
+// constants, then temporaries.
+//
+// CFormulaProgram runs the bytecode two ways:
+//
+//      Evaluate()      -- One set of variables, with a threaded-dispatch interpreter (computed goto with GCC/Clang; a
+//                         switch with MSVC, which compiles it to a jump table).
+//      EvaluateN()     -- N sets of variables at once (i.e. a whole image row).  Each instruction runs over a block of
+//                         values in a simple loop the compiler vectorizes, so dispatch cost is paid once per block rather
+//                         than once per value.
+//
+// Node types and values:
+//
+//      nNum, nFloat                        Constants (integer or float)
+//      nVar                                Variables bound with BindVar() (by stVARSTRUCT name)
+//      nAdd nSub nMul nFadd nFsub nFmul    Arithmetic
+//      nDiv, nFdiv                         Integer division (truncated) and floating-point division
+//      nMod, nAnd, nOr, nxor               Integer remainder and bitwise operators (on the truncated values)
+//      nneg, nFneg, nNot                   Unary minus and logical not (operand in tLeft or tRight)
+//      nEqualto nNotEqualto nLessThan      Comparisons (1 or 0)
+//      nGreaterThan nFGreaterThan
+//      nlogAnd, nlogOr                     Logical and/or (1 or 0; both sides are evaluated, as expressions have no side effects)
+//      nAssign                             tLeft (a variable) := tRight.  The variable is written back by Evaluate()
+//      nFunc                               Built-in functions by CFunc name: sin cos tan sqrt abs exp log floor ceil
+//                                          (argument in tLeft), pow min max atan2 (arguments in tLeft and tRight)
+//      nlparen, nrparen                    Pass-through to the child node
+//
+// Integer division and remainder by zero give 0.
+//
+// Basic usage:
+//
+//      CFormulaCompiler cCompiler;
+//      cCompiler.BindVar("x",0);
+//      cCompiler.BindVar("y",1);
+//
+//      CFormulaProgram cProgram;
+//      if (!cCompiler.Compile(cTree.stMaster,cProgram)) printf("%s\n",cCompiler.GetErrorMessage());
+//
+//      double fVars[2] = { 1.5, 2.0 };
+//      double fValue = cProgram.Evaluate(fVars);
+//
+//      FormulaVector_t stVars[2] = { { pRowX, 1 }, { &fY, 0 } };     // x varies along the row, y is the same for the row
+//      cProgram.EvaluateN(stVars,iWidth,pRowOut);
+//
+#if !defined(_CFormulaVM_H_)
+#define _CFormulaVM_H_
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CToken.h"
+
+namespace Sage
+{
+
+enum class FormulaOp : unsigned char
+{
+    End,
+    Mov,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    IDiv,
+    Mod,
+    And,
+    Or,
+    Xor,
+    Neg,
+    Not,
+    LogAnd,
+    LogOr,
+    Eq,
+    Ne,
+    Lt,
+    Gt,
+    Sin,
+    Cos,
+    Tan,
+    Sqrt,
+    Abs,
+    Exp,
+    Log,
+    Floor,
+    Ceil,
+    Pow,
+    Min,
+    Max,
+    Atan2,
+
+    NumOps,
+};
+
+struct FormulaInstr_t
+{
+    FormulaOp       eOp;
+    unsigned char   ucDest;
+    unsigned char   ucA;
+    unsigned char   ucB;
+};
+
+static_assert(sizeof(FormulaInstr_t) == 4,"FormulaInstr_t must be 4 bytes");
+
+// FormulaVector_t -- One variable for CFormulaProgram::EvaluateN(): iCount values iStride apart (iStride = 0 uses the
+// same value for all)
+//
+struct FormulaVector_t
+{
+    double    * pData;
+    int         iStride;
+};
+
+class CFormulaProgram
+{
+    friend class CFormulaCompiler;
+
+public:
+    static constexpr int kMaxRegisters  = 256;
+    static constexpr int kBlockSize     = 64;           // Values per block in EvaluateN()
+
+private:
+    std::vector<FormulaInstr_t> m_vCode;                // Ends with FormulaOp::End
+    std::vector<double>         m_vConstants;           // Loaded into registers m_iNumVars..m_iNumVars+constants-1
+    std::vector<unsigned char>  m_vAssigned;            // Variables written by the program
+    int                         m_iNumVars      = 0;
+    int                         m_iNumRegisters = 0;
+    int                         m_iResult       = 0;    // Register holding the result
+
+    static long long ToInt(double fValue) { return std::isfinite(fValue) ? (long long) fValue : 0; }
+
+public:
+    // Apply() -- Apply one operation (also used by the compiler for constant folding)
+    //
+    static double Apply(FormulaOp eOp,double a,double b)
+    {
+        switch (eOp)
+        {
+            case FormulaOp::Mov:    return a;
+            case FormulaOp::Add:    return a + b;
+            case FormulaOp::Sub:    return a - b;
+            case FormulaOp::Mul:    return a * b;
+            case FormulaOp::Div:    return a / b;
+            case FormulaOp::IDiv:   { long long llB = ToInt(b); return llB ? (double) (ToInt(a) / llB) : 0; }
+            case FormulaOp::Mod:    { long long llB = ToInt(b); return llB ? (double) (ToInt(a) % llB) : 0; }
+            case FormulaOp::And:    return (double) (ToInt(a) & ToInt(b));
+            case FormulaOp::Or:     return (double) (ToInt(a) | ToInt(b));
+            case FormulaOp::Xor:    return (double) (ToInt(a) ^ ToInt(b));
+            case FormulaOp::Neg:    return -a;
+            case FormulaOp::Not:    return a == 0 ? 1.0 : 0.0;
+            case FormulaOp::LogAnd: return a != 0 && b != 0 ? 1.0 : 0.0;
+            case FormulaOp::LogOr:  return a != 0 || b != 0 ? 1.0 : 0.0;
+            case FormulaOp::Eq:     return a == b ? 1.0 : 0.0;
+            case FormulaOp::Ne:     return a != b ? 1.0 : 0.0;
+            case FormulaOp::Lt:     return a < b ? 1.0 : 0.0;
+            case FormulaOp::Gt:     return a > b ? 1.0 : 0.0;
+            case FormulaOp::Sin:    return sin(a);
+            case FormulaOp::Cos:    return cos(a);
+            case FormulaOp::Tan:    return tan(a);
+            case FormulaOp::Sqrt:   return sqrt(a);
+            case FormulaOp::Abs:    return fabs(a);
+            case FormulaOp::Exp:    return exp(a);
+            case FormulaOp::Log:    return log(a);
+            case FormulaOp::Floor:  return floor(a);
+            case FormulaOp::Ceil:   return ceil(a);
+            case FormulaOp::Pow:    return pow(a,b);
+            case FormulaOp::Min:    return a < b ? a : b;
+            case FormulaOp::Max:    return a > b ? a : b;
+            case FormulaOp::Atan2:  return atan2(a,b);
+            default:                return 0;
+        }
+    }
+
+    static const char * GetOpName(FormulaOp eOp)
+    {
+        static const char * sNames[] =
+        {
+            "end","mov","add","sub","mul","div","idiv","mod","and","or","xor","neg","not","land","lor","eq","ne","lt","gt",
+            "sin","cos","tan","sqrt","abs","exp","log","floor","ceil","pow","min","max","atan2",
+        };
+        static_assert(sizeof(sNames)/sizeof(sNames[0]) == (size_t) FormulaOp::NumOps,"Op names out of date");
+        return eOp < FormulaOp::NumOps ? sNames[(int) eOp] : "?";
+    }
+
+    bool isValid() const { return !m_vCode.empty(); }
+
+    int GetNumVars() const { return m_iNumVars; }
+    int GetNumRegisters() const { return m_iNumRegisters; }
+    int GetNumInstructions() const { return (int) m_vCode.size() - 1; }
+    const std::vector<FormulaInstr_t> & GetCode() const { return m_vCode; }
+
+    // isAssigned() -- true if the program writes variable iVar (with nAssign)
+    //
+    bool isAssigned(int iVar) const { return iVar >= 0 && iVar < m_iNumVars && m_vAssigned[iVar]; }
+
+    // Evaluate() -- Run the program once.  pVars holds GetNumVars() values; assigned variables are written back.
+    // Returns the value of the last expression.
+    //
+    double Evaluate(double * pVars) const
+    {
+        if (!isValid()) return 0;
+
+        double r[kMaxRegisters];
+        if (m_iNumVars) memcpy(r,pVars,m_iNumVars*sizeof(double));
+        if (!m_vConstants.empty()) memcpy(r+m_iNumVars,m_vConstants.data(),m_vConstants.size()*sizeof(double));
+
+        const FormulaInstr_t * p = m_vCode.data();
+
+#if defined(__GNUC__)
+        static void * pDispatch[] =
+        {
+            &&lEnd,&&lMov,&&lAdd,&&lSub,&&lMul,&&lDiv,&&lIDiv,&&lMod,&&lAnd,&&lOr,&&lXor,&&lNeg,&&lNot,&&lLogAnd,&&lLogOr,
+            &&lEq,&&lNe,&&lLt,&&lGt,&&lSin,&&lCos,&&lTan,&&lSqrt,&&lAbs,&&lExp,&&lLog,&&lFloor,&&lCeil,&&lPow,&&lMin,&&lMax,&&lAtan2,
+        };
+        static_assert(sizeof(pDispatch)/sizeof(pDispatch[0]) == (size_t) FormulaOp::NumOps,"Dispatch table out of date");
+
+#define _FormulaOp_(_Op)    l##_Op:
+#define _FormulaNext_       goto *pDispatch[(int) (++p)->eOp];
+        goto *pDispatch[(int) p->eOp];
+#else
+#define _FormulaOp_(_Op)    case FormulaOp::_Op:
+#define _FormulaNext_       ++p; continue;
+        for (;;) switch (p->eOp) {
+#endif
+        _FormulaOp_(Mov)    r[p->ucDest] = r[p->ucA];                                   _FormulaNext_
+        _FormulaOp_(Add)    r[p->ucDest] = r[p->ucA] + r[p->ucB];                       _FormulaNext_
+        _FormulaOp_(Sub)    r[p->ucDest] = r[p->ucA] - r[p->ucB];                       _FormulaNext_
+        _FormulaOp_(Mul)    r[p->ucDest] = r[p->ucA] * r[p->ucB];                       _FormulaNext_
+        _FormulaOp_(Div)    r[p->ucDest] = r[p->ucA] / r[p->ucB];                       _FormulaNext_
+        _FormulaOp_(IDiv)   r[p->ucDest] = Apply(FormulaOp::IDiv,r[p->ucA],r[p->ucB]);  _FormulaNext_
+        _FormulaOp_(Mod)    r[p->ucDest] = Apply(FormulaOp::Mod,r[p->ucA],r[p->ucB]);   _FormulaNext_
+        _FormulaOp_(And)    r[p->ucDest] = Apply(FormulaOp::And,r[p->ucA],r[p->ucB]);   _FormulaNext_
+        _FormulaOp_(Or)     r[p->ucDest] = Apply(FormulaOp::Or,r[p->ucA],r[p->ucB]);    _FormulaNext_
+        _FormulaOp_(Xor)    r[p->ucDest] = Apply(FormulaOp::Xor,r[p->ucA],r[p->ucB]);   _FormulaNext_
+        _FormulaOp_(Neg)    r[p->ucDest] = -r[p->ucA];                                  _FormulaNext_
+        _FormulaOp_(Not)    r[p->ucDest] = r[p->ucA] == 0 ? 1.0 : 0.0;                  _FormulaNext_
+        _FormulaOp_(LogAnd) r[p->ucDest] = r[p->ucA] != 0 && r[p->ucB] != 0 ? 1.0 : 0.0; _FormulaNext_
+        _FormulaOp_(LogOr)  r[p->ucDest] = r[p->ucA] != 0 || r[p->ucB] != 0 ? 1.0 : 0.0; _FormulaNext_
+        _FormulaOp_(Eq)     r[p->ucDest] = r[p->ucA] == r[p->ucB] ? 1.0 : 0.0;          _FormulaNext_
+        _FormulaOp_(Ne)     r[p->ucDest] = r[p->ucA] != r[p->ucB] ? 1.0 : 0.0;          _FormulaNext_
+        _FormulaOp_(Lt)     r[p->ucDest] = r[p->ucA] < r[p->ucB] ? 1.0 : 0.0;           _FormulaNext_
+        _FormulaOp_(Gt)     r[p->ucDest] = r[p->ucA] > r[p->ucB] ? 1.0 : 0.0;           _FormulaNext_
+        _FormulaOp_(Sin)    r[p->ucDest] = sin(r[p->ucA]);                              _FormulaNext_
+        _FormulaOp_(Cos)    r[p->ucDest] = cos(r[p->ucA]);                              _FormulaNext_
+        _FormulaOp_(Tan)    r[p->ucDest] = tan(r[p->ucA]);                              _FormulaNext_
+        _FormulaOp_(Sqrt)   r[p->ucDest] = sqrt(r[p->ucA]);                             _FormulaNext_
+        _FormulaOp_(Abs)    r[p->ucDest] = fabs(r[p->ucA]);                             _FormulaNext_
+        _FormulaOp_(Exp)    r[p->ucDest] = exp(r[p->ucA]);                              _FormulaNext_
+        _FormulaOp_(Log)    r[p->ucDest] = log(r[p->ucA]);                              _FormulaNext_
+        _FormulaOp_(Floor)  r[p->ucDest] = floor(r[p->ucA]);                            _FormulaNext_
+        _FormulaOp_(Ceil)   r[p->ucDest] = ceil(r[p->ucA]);                             _FormulaNext_
+        _FormulaOp_(Pow)    r[p->ucDest] = pow(r[p->ucA],r[p->ucB]);                    _FormulaNext_
+        _FormulaOp_(Min)    r[p->ucDest] = r[p->ucA] < r[p->ucB] ? r[p->ucA] : r[p->ucB]; _FormulaNext_
+        _FormulaOp_(Max)    r[p->ucDest] = r[p->ucA] > r[p->ucB] ? r[p->ucA] : r[p->ucB]; _FormulaNext_
+        _FormulaOp_(Atan2)  r[p->ucDest] = atan2(r[p->ucA],r[p->ucB]);                  _FormulaNext_
+        _FormulaOp_(End)
+#if !defined(__GNUC__)
+            break;
+        default: break;
+        }
+        break; }
+#endif
+#undef _FormulaOp_
+#undef _FormulaNext_
+
+        for (int i=0;i<m_iNumVars;i++) if (m_vAssigned[i]) pVars[i] = r[i];
+        return r[m_iResult];
+    }
+
+    // EvaluateN() -- Run the program over iCount sets of variables.  stVars[i] gives the values of variable i (read as 0
+    // if pData is nullptr; assigned variables are written back unless pData is nullptr or iStride is 0).  pResult (if not nullptr) receives the value of
+    // the last expression for each set.
+    //
+    void EvaluateN(const FormulaVector_t * stVars,int iCount,double * pResult) const
+    {
+        if (!isValid() || iCount <= 0) return;
+
+        constexpr int B = kBlockSize;
+        std::vector<double> vRegisters((size_t) m_iNumRegisters*B);
+        double * r = vRegisters.data();
+
+        for (size_t i=0;i<m_vConstants.size();i++)
+            for (int j=0;j<B;j++) r[(m_iNumVars+i)*B+j] = m_vConstants[i];
+
+        for (int iStart=0;iStart<iCount;iStart += B)
+        {
+            int n = iCount-iStart < B ? iCount-iStart : B;
+
+            for (int v=0;v<m_iNumVars;v++)
+            {
+                double * d = r+v*B;
+                const double * s = stVars[v].pData;
+                int iStride = stVars[v].iStride;
+                if (!s) for (int i=0;i<n;i++) d[i] = 0;
+                else if (!iStride) for (int i=0;i<n;i++) d[i] = s[0];
+                else if (iStride == 1) memcpy(d,s+iStart,n*sizeof(double));
+                else for (int i=0;i<n;i++) d[i] = s[(size_t) (iStart+i)*iStride];
+            }
+
+            for (const FormulaInstr_t * p = m_vCode.data();p->eOp != FormulaOp::End;p++)
+            {
+                double * d          = r + p->ucDest*B;
+                const double * a    = r + p->ucA*B;
+                const double * b    = r + p->ucB*B;
+
+                switch (p->eOp)
+                {
+                    case FormulaOp::Mov:    for (int i=0;i<n;i++) d[i] = a[i];                          break;
+                    case FormulaOp::Add:    for (int i=0;i<n;i++) d[i] = a[i] + b[i];                   break;
+                    case FormulaOp::Sub:    for (int i=0;i<n;i++) d[i] = a[i] - b[i];                   break;
+                    case FormulaOp::Mul:    for (int i=0;i<n;i++) d[i] = a[i] * b[i];                   break;
+                    case FormulaOp::Div:    for (int i=0;i<n;i++) d[i] = a[i] / b[i];                   break;
+                    case FormulaOp::Neg:    for (int i=0;i<n;i++) d[i] = -a[i];                         break;
+                    case FormulaOp::Not:    for (int i=0;i<n;i++) d[i] = a[i] == 0 ? 1.0 : 0.0;         break;
+                    case FormulaOp::Eq:     for (int i=0;i<n;i++) d[i] = a[i] == b[i] ? 1.0 : 0.0;      break;
+                    case FormulaOp::Ne:     for (int i=0;i<n;i++) d[i] = a[i] != b[i] ? 1.0 : 0.0;      break;
+                    case FormulaOp::Lt:     for (int i=0;i<n;i++) d[i] = a[i] < b[i] ? 1.0 : 0.0;       break;
+                    case FormulaOp::Gt:     for (int i=0;i<n;i++) d[i] = a[i] > b[i] ? 1.0 : 0.0;       break;
+                    case FormulaOp::Min:    for (int i=0;i<n;i++) d[i] = a[i] < b[i] ? a[i] : b[i];     break;
+                    case FormulaOp::Max:    for (int i=0;i<n;i++) d[i] = a[i] > b[i] ? a[i] : b[i];     break;
+                    case FormulaOp::Abs:    for (int i=0;i<n;i++) d[i] = fabs(a[i]);                    break;
+                    case FormulaOp::Sqrt:   for (int i=0;i<n;i++) d[i] = sqrt(a[i]);                    break;
+                    case FormulaOp::Floor:  for (int i=0;i<n;i++) d[i] = floor(a[i]);                   break;
+                    case FormulaOp::Ceil:   for (int i=0;i<n;i++) d[i] = ceil(a[i]);                    break;
+                    default:                for (int i=0;i<n;i++) d[i] = Apply(p->eOp,a[i],b[i]);       break;
+                }
+            }
+
+            if (pResult) memcpy(pResult+iStart,r+m_iResult*B,n*sizeof(double));
+
+            for (int v=0;v<m_iNumVars;v++)
+            {
+                double * d = stVars[v].pData;
+                int iStride = stVars[v].iStride;
+                if (!m_vAssigned[v] || !d || !iStride) continue;
+                for (int i=0;i<n;i++) d[(size_t) (iStart+i)*iStride] = r[v*B+i];
+            }
+        }
+    }
+
+    // GetListing() -- Disassembly of the program, for debugging
+    //
+    std::string GetListing() const
+    {
+        std::string sListing;
+        char sLine[128];
+        for (size_t i=0;i<m_vConstants.size();i++)
+        {
+            snprintf(sLine,sizeof(sLine),"  r%-3d = %.17g\n",(int) (m_iNumVars+i),m_vConstants[i]);
+            sListing += sLine;
+        }
+        for (auto & stInstr : m_vCode)
+        {
+            if (stInstr.eOp == FormulaOp::End) break;
+            snprintf(sLine,sizeof(sLine),"  %-6s r%d, r%d, r%d\n",GetOpName(stInstr.eOp),stInstr.ucDest,stInstr.ucA,stInstr.ucB);
+            sListing += sLine;
+        }
+        snprintf(sLine,sizeof(sLine),"  result r%d\n",m_iResult);
+        return sListing += sLine;
+    }
+};
+
+class CFormulaCompiler
+{
+    enum class IrType : unsigned char { Var, Const, Op };
+
+    struct Ir_t
+    {
+        IrType      eType;
+        FormulaOp   eOp;
+        int         iA;             // Operand values (Op), or the variable index (Var)
+        int         iB;
+        double      fValue;         // Const
+    };
+
+    struct IrKeyHash
+    {
+        size_t operator()(const Ir_t & st) const
+        {
+            unsigned long long ullBits;
+            memcpy(&ullBits,&st.fValue,8);
+            return (size_t) (((unsigned long long) st.eType*31 + (unsigned long long) st.eOp)*0x9E3779B97F4A7C15ULL ^
+                             ((unsigned long long) (unsigned int) st.iA << 32 | (unsigned int) st.iB)*0xBF58476D1CE4E5B9ULL ^ ullBits);
+        }
+    };
+
+    struct IrKeyEqual
+    {
+        bool operator()(const Ir_t & st1,const Ir_t & st2) const
+        {
+            return st1.eType == st2.eType && st1.eOp == st2.eOp && st1.iA == st2.iA && st1.iB == st2.iB &&
+                   !memcmp(&st1.fValue,&st2.fValue,sizeof(double));
+        }
+    };
+
+    struct Var_t
+    {
+        std::string sName;
+        int         iIndex;
+    };
+
+    std::vector<Var_t>                                  m_vVars;
+    std::vector<Ir_t>                                   m_vIr;
+    std::unordered_map<Ir_t,int,IrKeyHash,IrKeyEqual>   m_mIr;          // Value numbering (CSE)
+    std::vector<int>                                    m_vVarValue;    // Current value of each variable (after assignments)
+    std::string                                         m_sError;
+    int                                                 m_iNumVars = 0;
+
+    // isCommutative() -- Operands may be swapped for value numbering.  Min and Max are not included: with a NaN operand,
+    // a < b ? a : b returns the second operand, so min(x,NaN) and min(NaN,x) differ.
+    //
+    static bool isCommutative(FormulaOp eOp)
+    {
+        switch (eOp)
+        {
+            case FormulaOp::Add: case FormulaOp::Mul: case FormulaOp::And: case FormulaOp::Or: case FormulaOp::Xor:
+            case FormulaOp::LogAnd: case FormulaOp::LogOr: case FormulaOp::Eq: case FormulaOp::Ne:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static bool isUnary(FormulaOp eOp)
+    {
+        switch (eOp)
+        {
+            case FormulaOp::Neg: case FormulaOp::Not: case FormulaOp::Sin: case FormulaOp::Cos: case FormulaOp::Tan:
+            case FormulaOp::Sqrt: case FormulaOp::Abs: case FormulaOp::Exp: case FormulaOp::Log: case FormulaOp::Floor:
+            case FormulaOp::Ceil: case FormulaOp::Mov:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    int AddIr(const Ir_t & stIr)
+    {
+        auto it = m_mIr.find(stIr);
+        if (it != m_mIr.end()) return it->second;
+
+        int iValue = (int) m_vIr.size();
+        m_vIr.push_back(stIr);
+        m_mIr.emplace(stIr,iValue);
+        return iValue;
+    }
+
+    int AddConst(double fValue) { return AddIr({ IrType::Const,FormulaOp::End,0,0,fValue }); }
+
+    bool isConst(int iValue,double fValue) const
+    {
+        return m_vIr[iValue].eType == IrType::Const && m_vIr[iValue].fValue == fValue;
+    }
+
+    // AddOp() -- Add an operation, folding constants and identities, and sharing an existing identical value (CSE)
+
+    int AddOp(FormulaOp eOp,int iA,int iB)
+    {
+        if (isUnary(eOp)) iB = 0;
+
+        bool bConstA = m_vIr[iA].eType == IrType::Const;
+        bool bConstB = isUnary(eOp) || m_vIr[iB].eType == IrType::Const;
+        if (bConstA && bConstB) return AddConst(CFormulaProgram::Apply(eOp,m_vIr[iA].fValue,isUnary(eOp) ? 0 : m_vIr[iB].fValue));
+
+        switch (eOp)
+        {
+            case FormulaOp::Add:    if (isConst(iB,0)) return iA; if (isConst(iA,0)) return iB; break;
+            case FormulaOp::Sub:    if (isConst(iB,0)) return iA; break;
+            case FormulaOp::Mul:    if (isConst(iB,1)) return iA; if (isConst(iA,1)) return iB; break;
+            case FormulaOp::Div:    if (isConst(iB,1)) return iA; break;
+            case FormulaOp::Mov:    return iA;
+            default: break;
+        }
+
+        if (isCommutative(eOp) && iA > iB) std::swap(iA,iB);
+        return AddIr({ IrType::Op,eOp,iA,iB,0 });
+    }
+
+    bool SetError(const char * sError,const stNODE * stNode)
+    {
+        char sLine[64] = "";
+        if (stNode && stNode->stNodeData && stNode->stNodeData->iLineNumber)
+            snprintf(sLine,sizeof(sLine)," (line %d)",stNode->stNodeData->iLineNumber);
+        m_sError = std::string(sError) + sLine;
+        return false;
+    }
+
+    int FindVar(const char * sName) const
+    {
+        if (!sName) return -1;
+        for (auto & stVar : m_vVars) if (stVar.sName == sName) return stVar.iIndex;
+        return -1;
+    }
+
+    static const char * GetVarName(const stVARSTRUCT * stVar) { return !stVar ? nullptr : stVar->spName ? stVar->spName : stVar->sName; }
+    static const char * GetFuncName(const CFunc * cFunc) { return !cFunc ? nullptr : cFunc->spName ? cFunc->spName : cFunc->sName; }
+
+    static bool GetFunction(const char * sName,FormulaOp & eOp)
+    {
+        static const struct { const char * sName; FormulaOp eOp; } stFunctions[] =
+        {
+            { "sin",FormulaOp::Sin },   { "cos",FormulaOp::Cos },       { "tan",FormulaOp::Tan },   { "sqrt",FormulaOp::Sqrt },
+            { "abs",FormulaOp::Abs },   { "exp",FormulaOp::Exp },       { "log",FormulaOp::Log },   { "floor",FormulaOp::Floor },
+            { "ceil",FormulaOp::Ceil }, { "pow",FormulaOp::Pow },       { "min",FormulaOp::Min },   { "max",FormulaOp::Max },
+            { "atan2",FormulaOp::Atan2 },
+        };
+        if (!sName) return false;
+        for (auto & stFunc : stFunctions)
+        {
+            const char * s1 = sName, * s2 = stFunc.sName;
+            while (*s1 && (*s1 | 0x20) == *s2) { s1++; s2++; }
+            if (!*s1 && !*s2) { eOp = stFunc.eOp; return true; }
+        }
+        return false;
+    }
+
+    // Lower() -- Convert a tree to IR.  Returns the value number, or -1 on error (see m_sError).
+
+    int Lower(const stNODE * stNode,int iDepth)
+    {
+        if (!stNode || !stNode->stNodeData) { SetError("Missing operand",stNode); return -1; }
+        if (iDepth > 1000) { SetError("Expression is too deeply nested",stNode); return -1; }
+
+        auto & stData       = *stNode->stNodeData;
+        const stNODE * stL  = stNode->tLeft;
+        const stNODE * stR  = stNode->tRight;
+
+        auto Binary = [&](FormulaOp eOp)
+        {
+            int iA = Lower(stL,iDepth+1);
+            int iB = iA < 0 ? -1 : Lower(stR,iDepth+1);
+            return iB < 0 ? -1 : AddOp(eOp,iA,iB);
+        };
+        auto Unary = [&](FormulaOp eOp)
+        {
+            int iA = Lower(stL ? stL : stR,iDepth+1);
+            return iA < 0 ? -1 : AddOp(eOp,iA,0);
+        };
+
+        switch (stData.eNodeType)
+        {
+            case nNum:
+            {
+                auto & stNumber = stData.suTokenData.stNumber.stNumber;
+                bool bUnsigned  = (stNumber.eRawNumType & __numtypUNSIGNED) != 0;
+                return AddConst(bUnsigned ? (double) (unsigned int) stNumber.LSW : (double) (int) stNumber.LSW);
+            }
+            case nFloat:
+                return AddConst((double) stData.suTokenData.stNumber.stNumber.fFloat);
+
+            case nVar:
+            {
+                int iVar = FindVar(GetVarName(stData.suTokenData.stVar));
+                if (iVar < 0) { SetError((std::string("Unknown variable '") + (GetVarName(stData.suTokenData.stVar) ? GetVarName(stData.suTokenData.stVar) : "") + "'").c_str(),stNode); return -1; }
+                return m_vVarValue[iVar];
+            }
+
+            case nAdd: case nFadd:  return Binary(FormulaOp::Add);
+            case nSub: case nFsub:  return Binary(FormulaOp::Sub);
+            case nMul: case nFmul:  return Binary(FormulaOp::Mul);
+            case nFdiv:             return Binary(FormulaOp::Div);
+            case nDiv:              return Binary(FormulaOp::IDiv);
+            case nMod:              return Binary(FormulaOp::Mod);
+            case nAnd:              return Binary(FormulaOp::And);
+            case nOr:               return Binary(FormulaOp::Or);
+            case nxor:              return Binary(FormulaOp::Xor);
+            case nlogAnd:           return Binary(FormulaOp::LogAnd);
+            case nlogOr:            return Binary(FormulaOp::LogOr);
+            case nEqualto:          return Binary(FormulaOp::Eq);
+            case nNotEqualto:       return Binary(FormulaOp::Ne);
+            case nLessThan:         return Binary(FormulaOp::Lt);
+            case nGreaterThan:
+            case nFGreaterThan:     return Binary(FormulaOp::Gt);
+            case nneg: case nFneg:  return Unary(FormulaOp::Neg);
+            case nNot:              return Unary(FormulaOp::Not);
+            case nlparen:
+            case nrparen:           return Unary(FormulaOp::Mov);
+
+            case nAssign:
+            {
+                if (!stL || !stL->stNodeData || stL->stNodeData->eNodeType != nVar) { SetError("Left side of an assignment must be a variable",stNode); return -1; }
+                int iVar = FindVar(GetVarName(stL->stNodeData->suTokenData.stVar));
+                if (iVar < 0) { SetError("Unknown variable in assignment",stL); return -1; }
+
+                int iValue = Lower(stR,iDepth+1);
+                if (iValue < 0) return -1;
+                m_vVarValue[iVar] = iValue;
+                return iValue;
+            }
+
+            case nFunc:
+            {
+                FormulaOp eOp;
+                const char * sName = GetFuncName(stData.suTokenData.cFunc);
+                if (!GetFunction(sName,eOp)) { SetError((std::string("Unknown function '") + (sName ? sName : "") + "'").c_str(),stNode); return -1; }
+                return isUnary(eOp) ? Unary(eOp) : Binary(eOp);
+            }
+
+            default:
+                SetError("Unsupported operator in formula",stNode);
+                return -1;
+        }
+    }
+
+    // Emit() -- Allocate registers and write the bytecode for the values that reach iResult or an assigned variable
+
+    bool Emit(int iResult,CFormulaProgram & cProgram)
+    {
+        int iNumValues = (int) m_vIr.size();
+        std::vector<int> vLastUse(iNumValues,-1);
+        std::vector<char> vLive(iNumValues,0);
+
+        // Mark live values, walking back from the roots (operands always have lower value numbers)
+
+        vLive[iResult] = 1;
+        for (int v=0;v<m_iNumVars;v++) if (m_vVarValue[v] != v) vLive[m_vVarValue[v]] = 1;
+        for (int i=iNumValues-1;i>=0;i--)
+        {
+            if (!vLive[i] || m_vIr[i].eType != IrType::Op) continue;
+            vLive[m_vIr[i].iA] = 1;
+            if (!isUnary(m_vIr[i].eOp)) vLive[m_vIr[i].iB] = 1;
+        }
+
+        // Registers: variables, then live constants, then temporaries
+
+        std::vector<int> vRegister(iNumValues,-1);
+        for (int v=0;v<m_iNumVars;v++) vRegister[v] = v;        // Var IR values are 0..m_iNumVars-1
+
+        cProgram.m_vConstants.clear();
+        for (int i=0;i<iNumValues;i++)
+        {
+            if (!vLive[i] || m_vIr[i].eType != IrType::Const) continue;
+            vRegister[i] = m_iNumVars + (int) cProgram.m_vConstants.size();
+            cProgram.m_vConstants.push_back(m_vIr[i].fValue);
+        }
+
+        int iFirstTemp = m_iNumVars + (int) cProgram.m_vConstants.size();
+        for (int i=0;i<iNumValues;i++)
+        {
+            if (!vLive[i] || m_vIr[i].eType != IrType::Op) continue;
+            vLastUse[m_vIr[i].iA] = i;
+            if (!isUnary(m_vIr[i].eOp)) vLastUse[m_vIr[i].iB] = i;
+        }
+
+        // Values needed at the end (results and assigned variables) stay in their registers
+
+        vLastUse[iResult] = iNumValues;
+        for (int v=0;v<m_iNumVars;v++) vLastUse[m_vVarValue[v]] = iNumValues;
+
+        std::vector<int> vFree;
+        int iNumRegisters = iFirstTemp;
+        cProgram.m_vCode.clear();
+
+        for (int i=0;i<iNumValues;i++)
+        {
+            auto & stIr = m_vIr[i];
+            if (!vLive[i] || stIr.eType != IrType::Op) continue;
+
+            // Release operands used for the last time (the result may use the same register)
+
+            int iA = vRegister[stIr.iA];
+            int iB = isUnary(stIr.eOp) ? iA : vRegister[stIr.iB];
+            if (vLastUse[stIr.iA] == i && iA >= iFirstTemp) vFree.push_back(iA);
+            if (!isUnary(stIr.eOp) && vLastUse[stIr.iB] == i && iB >= iFirstTemp && stIr.iB != stIr.iA) vFree.push_back(iB);
+
+            int iDest;
+            if (!vFree.empty()) { iDest = vFree.back(); vFree.pop_back(); }
+            else iDest = iNumRegisters++;
+
+            if (iNumRegisters > CFormulaProgram::kMaxRegisters) { m_sError = "Formula is too large (out of registers)"; return false; }
+
+            vRegister[i] = iDest;
+            cProgram.m_vCode.push_back({ stIr.eOp,(unsigned char) iDest,(unsigned char) iA,(unsigned char) iB });
+        }
+
+        // A variable's original value that is still needed after the write-back (i.e. "t := x; x := 1") is copied to a
+        // temporary first, since the write-back overwrites the variable's register
+
+        auto Preserve = [&](int iValue)
+        {
+            if (m_vIr[iValue].eType != IrType::Var || vRegister[iValue] != iValue || m_vVarValue[iValue] == iValue) return true;
+
+            int iDest;
+            if (!vFree.empty()) { iDest = vFree.back(); vFree.pop_back(); }
+            else iDest = iNumRegisters++;
+            if (iNumRegisters > CFormulaProgram::kMaxRegisters) { m_sError = "Formula is too large (out of registers)"; return false; }
+
+            cProgram.m_vCode.push_back({ FormulaOp::Mov,(unsigned char) iDest,(unsigned char) iValue,0 });
+            vRegister[iValue] = iDest;
+            return true;
+        };
+
+        if (!Preserve(iResult)) return false;
+        for (int v=0;v<m_iNumVars;v++) if (!Preserve(m_vVarValue[v])) return false;
+
+        // Write assigned variables back to their registers
+
+        cProgram.m_vAssigned.assign(m_iNumVars,0);
+        for (int v=0;v<m_iNumVars;v++)
+        {
+            if (m_vVarValue[v] == v) continue;
+            cProgram.m_vAssigned[v] = 1;
+            cProgram.m_vCode.push_back({ FormulaOp::Mov,(unsigned char) v,(unsigned char) vRegister[m_vVarValue[v]],0 });
+        }
+
+        cProgram.m_vCode.push_back({ FormulaOp::End,0,0,0 });
+        cProgram.m_iNumVars         = m_iNumVars;
+        cProgram.m_iNumRegisters    = iNumRegisters;
+        cProgram.m_iResult          = vRegister[iResult];
+
+        // A result that is an assigned variable's new value is read from the variable's register (written by the Mov above)
+
+        for (int v=0;v<m_iNumVars;v++) if (cProgram.m_vAssigned[v] && m_vVarValue[v] == iResult) cProgram.m_iResult = v;
+        return true;
+    }
+
+public:
+    // BindVar() -- Make a variable (by its stVARSTRUCT name) available to formulas as variable iIndex (0 to kMaxVars-1).
+    // Variable indexes must be 0..n-1 with no gaps.
+    //
+    static constexpr int kMaxVars = 64;
+
+    bool BindVar(const char * sName,int iIndex)
+    {
+        if (!sName || iIndex < 0 || iIndex >= kMaxVars || FindVar(sName) >= 0) return false;
+        for (auto & stVar : m_vVars) if (stVar.iIndex == iIndex) return false;
+        m_vVars.push_back({ sName,iIndex });
+        return true;
+    }
+
+    void ClearVars() { m_vVars.clear(); }
+
+    const char * GetErrorMessage() const { return m_sError.c_str(); }
+
+    // Compile() -- Compile one expression tree (i.e. CTree::stMaster).  Returns false on error (see GetErrorMessage()).
+    //
+    bool Compile(const stNODE * stRoot,CFormulaProgram & cProgram) { return Compile(&stRoot,1,cProgram); }
+
+    // Compile() -- Compile a sequence of statements (i.e. "t := x*x+y*y; sqrt(t)").  Statements run in order; the
+    // result is the value of the last one.
+    //
+    bool Compile(const stNODE * const * stStatements,int iNumStatements,CFormulaProgram & cProgram)
+    {
+        m_sError.clear();
+        m_vIr.clear();
+        m_mIr.clear();
+        cProgram = CFormulaProgram();
+
+        m_iNumVars = 0;
+        for (auto & stVar : m_vVars) if (stVar.iIndex+1 > m_iNumVars) m_iNumVars = stVar.iIndex+1;
+        if (m_iNumVars != (int) m_vVars.size()) { m_sError = "Variable indexes must be 0..n-1 with no gaps"; return false; }
+        if (!stStatements || iNumStatements <= 0) { m_sError = "No expression to compile"; return false; }
+
+        m_vVarValue.resize(m_iNumVars);
+        for (int v=0;v<m_iNumVars;v++) m_vVarValue[v] = AddIr({ IrType::Var,FormulaOp::End,v,0,0 });
+
+        int iResult = -1;
+        for (int i=0;i<iNumStatements;i++) if ((iResult = Lower(stStatements[i],0)) < 0) return false;
+
+        return Emit(iResult,cProgram);
+    }
+};
+
+}; // namespace Sage
+#endif // _CFormulaVM_H_
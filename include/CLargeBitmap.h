@@ -0,0 +1,511 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CLargeBitmap -- 24-bit bitmap with 64-bit extents for images that are larger than memory (i.e. gigapixel scans).
+//
+// RawBitmap_t and CBitmap use int for the width, height and total size, which overflows with images such as 60000x40000x3.
+// CLargeBitmap stores the image in fixed-size square tiles in a temporary file that is memory-mapped one tile at a time,
+// so only the tiles currently in use occupy memory.
+//
+// Each tile is presented as a normal RawBitmap_t (with the same layout as Sage::CreateBitmap(), i.e. 3 bytes per pixel and rows
+// padded to a 4-byte boundary), so existing functions such as CSageTools::GaussianBlurStd() can be used on the image one tile at a time.
+//
+// Basic usage:
+//
+//      CLargeBitmap cBitmap(60000,40000);          // Creates the tile file in the Windows temp directory
+//
+//      auto stTile = cBitmap.LockTile(iTileX,iTileY);  // Map tile into memory as a RawBitmap_t (do not Delete() it)
+//      ... work on stTile.stBitmap ...
+//      cBitmap.UnlockTile(stTile);                     // Write back & unmap
+//
+//      cBitmap.ReadTile(iTileX,iTileY,cMyBitmap);      // Streaming versions: copy a tile in or out of a CBitmap
+//      cBitmap.WriteTile(iTileX,iTileY,cMyBitmap);
+//
+//      cBitmap.GaussianBlurStd(cOutput,20.0);          // Run a CSageTools filter tile-by-tile with enough overlap for the radius
+//
+// GaussianBlurStd() is the only part that needs CSageTools.h (and with it the window classes).  Define SAGE_NO_SAGETOOLS before
+// including this file to leave it out, i.e. for tools that only move pixels in and out of the tiles.
+//
+// Row 0 is the first row in the file -- no bitmap reversal is performed, so images read from top-down sources stay top-down.
+//
+#if !defined(_CLargeBitmap_H_)
+#define _CLargeBitmap_H_
+
+#include <Windows.h>
+#include <functional>
+#include "Sage.h"
+#include "CRawBitmap.h"
+#if !defined(SAGE_NO_SAGETOOLS)
+#include "CSageTools.h"
+#endif
+
+namespace Sage
+{
+
+// LargeBitmapTile_t -- A tile of a CLargeBitmap currently mapped into memory.
+//
+// stBitmap is a RawBitmap_t that points into the mapped file.  It does not own its memory and must
+// not be deleted -- use CLargeBitmap::UnlockTile() to release it.
+//
+struct LargeBitmapTile_t
+{
+    RawBitmap_t stBitmap;           // Bitmap view of the tile (memory points into the mapped view)
+    long long   llX;                // Pixel location of the tile in the large image
+    long long   llY;
+    int         iTileX;             // Tile index
+    int         iTileY;
+    void      * pView;              // Mapped view (as returned by MapViewOfFile())
+
+    bool isValid() { return pView != nullptr && stBitmap.stMem != nullptr; }
+};
+
+class CLargeBitmap
+{
+public:
+    static constexpr int kDefaultTileSize   = 1024;     // 1024x1024x3 = 3MB per tile
+    static constexpr int kMinTileSize       = 64;
+    static constexpr int kMaxTileSize       = 8192;
+
+private:
+    long long   m_llWidth           = 0;
+    long long   m_llHeight          = 0;
+    int         m_iTileSize         = 0;
+    int         m_iTilesX           = 0;
+    int         m_iTilesY           = 0;
+    long long   m_llTileStride      = 0;    // Bytes between tiles in the file (rounded to the allocation granularity)
+    long long   m_llFileSize        = 0;
+
+    HANDLE      m_hFile             = INVALID_HANDLE_VALUE;
+    HANDLE      m_hMapping          = nullptr;
+    bool        m_bReadOnly         = false;
+    int         m_iLockedTiles      = 0;
+
+    // WidthBytes() -- Same row layout as a standard Sagebox 24-bit bitmap (padded to a 4-byte boundary)
+    //
+    static __forceinline int WidthBytes(int iWidth) { return (iWidth*3 + 3) & ~3; }
+
+    bool CreateTempFile(const char * sTempPath)
+    {
+        char sPath[MAX_PATH+1];
+        char sFile[MAX_PATH+1];
+
+        if (!sTempPath || !*sTempPath)
+        {
+            if (!GetTempPathA(MAX_PATH,sPath)) return false;
+            sTempPath = sPath;
+        }
+        if (!GetTempFileNameA(sTempPath,"sgl",0,sFile)) return false;
+
+        // FILE_FLAG_DELETE_ON_CLOSE removes the file when the last handle (including the mapping) is closed.
+
+        m_hFile = CreateFileA(sFile,GENERIC_READ | GENERIC_WRITE,0,nullptr,CREATE_ALWAYS,
+                              FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,nullptr);
+
+        return m_hFile != INVALID_HANDLE_VALUE;
+    }
+
+    // SetGeometry() -- Calculate tile counts and tile stride for the image size
+    //
+    bool SetGeometry(long long llWidth,long long llHeight,int iTileSize)
+    {
+        if (llWidth <= 0 || llHeight <= 0) return false;
+        if (iTileSize <= 0) iTileSize = kDefaultTileSize;
+        if (iTileSize < kMinTileSize) iTileSize = kMinTileSize;
+        if (iTileSize > kMaxTileSize) iTileSize = kMaxTileSize;
+        iTileSize = (iTileSize + 3) & ~3;       // Keep tile rows 4-byte aligned with no overhang for full tiles
+
+        long long llTilesX = (llWidth + iTileSize-1)/iTileSize;
+        long long llTilesY = (llHeight + iTileSize-1)/iTileSize;
+        if (llTilesX > INT_MAX || llTilesY > INT_MAX) return false;
+
+        SYSTEM_INFO stInfo;
+        GetSystemInfo(&stInfo);
+        long long llGranularity = stInfo.dwAllocationGranularity ? (long long) stInfo.dwAllocationGranularity : 65536;
+
+        long long llTileBytes = (long long) WidthBytes(iTileSize)*iTileSize;
+
+        m_llWidth       = llWidth;
+        m_llHeight      = llHeight;
+        m_iTileSize     = iTileSize;
+        m_iTilesX       = (int) llTilesX;
+        m_iTilesY       = (int) llTilesY;
+        m_llTileStride  = ((llTileBytes + llGranularity-1)/llGranularity)*llGranularity;
+        m_llFileSize    = m_llTileStride*llTilesX*llTilesY;
+        return true;
+    }
+
+    // MoveFrom() -- Take over p2's file and mapping.  The current object must be empty (Delete() first).
+    //
+    void MoveFrom(CLargeBitmap & p2)
+    {
+        m_llWidth       = p2.m_llWidth;
+        m_llHeight      = p2.m_llHeight;
+        m_iTileSize     = p2.m_iTileSize;
+        m_iTilesX       = p2.m_iTilesX;
+        m_iTilesY       = p2.m_iTilesY;
+        m_llTileStride  = p2.m_llTileStride;
+        m_llFileSize    = p2.m_llFileSize;
+        m_hFile         = p2.m_hFile;
+        m_hMapping      = p2.m_hMapping;
+        m_bReadOnly     = p2.m_bReadOnly;
+        m_iLockedTiles  = p2.m_iLockedTiles;
+
+        // Delete() on p2 would close the handles we now own
+
+        p2.m_hFile      = INVALID_HANDLE_VALUE;
+        p2.m_hMapping   = nullptr;
+        p2.Delete();
+    }
+
+    // CopyRows() -- Copy a rectangle between a tile and a RawBitmap_t (bToTile selects the direction)
+    //
+    static void CopyRows(RawBitmap_t & stTile,int iTileX,int iTileY,RawBitmap_t & stBitmap,int iX,int iY,int iWidth,int iHeight,bool bToTile)
+    {
+        int iBytes = iWidth*3;
+        for (int i=0;i<iHeight;i++)
+        {
+            unsigned char * sTile   = stTile.stMem + (long long) (iTileY + i)*stTile.iWidthBytes + iTileX*3;
+            unsigned char * sBitmap = stBitmap.stMem + (long long) (iY + i)*stBitmap.iWidthBytes + iX*3;
+            if (bToTile) memcpy(sTile,sBitmap,iBytes);
+            else         memcpy(sBitmap,sTile,iBytes);
+        }
+    }
+
+    // TransferRegion() -- Move a rectangle of the large image in or out of a RawBitmap_t, walking all tiles it crosses.
+    //
+    bool TransferRegion(long long llX,long long llY,RawBitmap_t & stBitmap,POINT pBitmapStart,SIZE szSize,bool bToImage)
+    {
+        if (!isValid() || !stBitmap.stMem) return false;
+        if (bToImage && m_bReadOnly) return false;
+
+        // Clip to the large image and the bitmap
+
+        long long llX2 = llX + szSize.cx;
+        long long llY2 = llY + szSize.cy;
+        int iBx = (int) pBitmapStart.x;
+        int iBy = (int) pBitmapStart.y;
+
+        if (llX < 0) { iBx -= (int) llX; llX = 0; }
+        if (llY < 0) { iBy -= (int) llY; llY = 0; }
+        if (llX2 > m_llWidth)  llX2 = m_llWidth;
+        if (llY2 > m_llHeight) llY2 = m_llHeight;
+        if (llX2 - llX > stBitmap.iWidth - iBx)  llX2 = llX + stBitmap.iWidth - iBx;
+        if (llY2 - llY > stBitmap.iHeight - iBy) llY2 = llY + stBitmap.iHeight - iBy;
+        if (llX2 <= llX || llY2 <= llY || iBx < 0 || iBy < 0) return false;
+
+        int iTileX1 = (int) (llX/m_iTileSize);
+        int iTileY1 = (int) (llY/m_iTileSize);
+        int iTileX2 = (int) ((llX2-1)/m_iTileSize);
+        int iTileY2 = (int) ((llY2-1)/m_iTileSize);
+
+        for (int iTy = iTileY1;iTy <= iTileY2;iTy++)
+            for (int iTx = iTileX1;iTx <= iTileX2;iTx++)
+            {
+                LargeBitmapTile_t stTile = LockTile(iTx,iTy);
+                if (!stTile.isValid()) return false;
+
+                long long llSx = max(llX,stTile.llX);
+                long long llSy = max(llY,stTile.llY);
+                long long llEx = min(llX2,stTile.llX + stTile.stBitmap.iWidth);
+                long long llEy = min(llY2,stTile.llY + stTile.stBitmap.iHeight);
+
+                CopyRows(stTile.stBitmap,(int) (llSx - stTile.llX),(int) (llSy - stTile.llY),
+                         stBitmap,iBx + (int) (llSx - llX),iBy + (int) (llSy - llY),(int) (llEx-llSx),(int) (llEy-llSy),bToImage);
+
+                UnlockTile(stTile);
+            }
+
+        return true;
+    }
+
+public:
+    CLargeBitmap() { }
+
+    // CLargeBitmap() -- Create a large bitmap of the given size.  See Create() for parameters.
+    //
+    CLargeBitmap(long long llWidth,long long llHeight,int iTileSize = kDefaultTileSize,const char * sTempPath = nullptr)
+    {
+        Create(llWidth,llHeight,iTileSize,sTempPath);
+    }
+    ~CLargeBitmap() { Delete(); }
+
+    CLargeBitmap(const CLargeBitmap &) = delete;
+    CLargeBitmap & operator = (const CLargeBitmap &) = delete;
+
+    // Move constructor/assignment -- The file and mapping move to the new object; p2 is left empty.
+    // Tiles locked through p2 stay valid (the views belong to the mapping) and are unlocked through the new object.
+    //
+    CLargeBitmap(CLargeBitmap && p2) noexcept { MoveFrom(p2); }
+
+    CLargeBitmap & operator = (CLargeBitmap && p2) noexcept
+    {
+        if (this != &p2)
+        {
+            Delete();
+            MoveFrom(p2);
+        }
+        return *this;
+    }
+
+    // Create() -- Create a new large bitmap backed by a temporary file.
+    //
+    // llWidth, llHeight    -- Size of the image.  This is limited only by disk space.
+    // iTileSize            -- Width and height of each tile (rounded to a multiple of 4).  Tiles on the right and bottom edges may be smaller.
+    // sTempPath            -- Directory for the temporary file.  When nullptr, the Windows temp directory is used.
+    //
+    // The temporary file is deleted automatically when the CLargeBitmap is deleted (or the process exits).
+    // New tiles are zero-filled (black).  Returns false if the file could not be created.
+    //
+    bool Create(long long llWidth,long long llHeight,int iTileSize = kDefaultTileSize,const char * sTempPath = nullptr)
+    {
+        Delete();
+        if (!SetGeometry(llWidth,llHeight,iTileSize)) return false;
+        if (!CreateTempFile(sTempPath)) { Delete(); return false; }
+
+        m_hMapping = CreateFileMappingA(m_hFile,nullptr,PAGE_READWRITE,(DWORD) (m_llFileSize >> 32),(DWORD) (m_llFileSize & 0xFFFFFFFF),nullptr);
+        if (!m_hMapping) { Delete(); return false; }
+
+        m_bReadOnly = false;
+        return true;
+    }
+
+    // Delete() -- Release the mapping and the temporary file.  All tiles must be unlocked before calling Delete().
+    //
+    void Delete()
+    {
+        if (m_hMapping) CloseHandle(m_hMapping);
+        if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+        m_hMapping      = nullptr;
+        m_hFile         = INVALID_HANDLE_VALUE;
+        m_llWidth       = m_llHeight = 0;
+        m_iTileSize     = m_iTilesX = m_iTilesY = 0;
+        m_llTileStride  = m_llFileSize = 0;
+        m_iLockedTiles  = 0;
+    }
+
+    bool isValid() const { return m_hMapping != nullptr; }
+    bool isEmpty() const { return !isValid(); }
+
+    __forceinline long long GetWidth()      const { return m_llWidth;       }
+    __forceinline long long GetHeight()     const { return m_llHeight;      }
+    __forceinline long long GetTotalPixels() const { return m_llWidth*m_llHeight; }
+    __forceinline int GetTileSize()         const { return m_iTileSize;     }
+    __forceinline int GetTilesX()           const { return m_iTilesX;       }
+    __forceinline int GetTilesY()           const { return m_iTilesY;       }
+    __forceinline int GetNumTiles()         const { return m_iTilesX*m_iTilesY; }
+    __forceinline int GetLockedTiles()      const { return m_iLockedTiles;  }
+
+    // GetTileSize() -- Returns the actual size of a tile (tiles on the right and bottom edges can be smaller than the tile size)
+    //
+    SIZE GetTileSize(int iTileX,int iTileY) const
+    {
+        if (iTileX < 0 || iTileY < 0 || iTileX >= m_iTilesX || iTileY >= m_iTilesY) return { 0,0 };
+        return { (LONG) min((long long) m_iTileSize,m_llWidth  - (long long) iTileX*m_iTileSize),
+                 (LONG) min((long long) m_iTileSize,m_llHeight - (long long) iTileY*m_iTileSize) };
+    }
+
+    // LockTile() -- Map a tile into memory and return it as a RawBitmap_t (in LargeBitmapTile_t::stBitmap).
+    //
+    // The memory is the file mapping itself, so any changes are written to the large bitmap.  The returned
+    // bitmap must not be deleted; call UnlockTile() when finished.  Several tiles may be locked at once, and different
+    // tiles may be locked and used from different threads.
+    //
+    // If the tile is out of range or the mapping fails, the returned tile's isValid() is false.
+    //
+    LargeBitmapTile_t LockTile(int iTileX,int iTileY)
+    {
+        LargeBitmapTile_t stTile = {};
+        SIZE szTile = GetTileSize(iTileX,iTileY);
+        if (!isValid() || !szTile.cx) return stTile;
+
+        long long llOffset = m_llTileStride*((long long) iTileY*m_iTilesX + iTileX);
+        int iWidthBytes = WidthBytes(szTile.cx);
+
+        stTile.pView = MapViewOfFile(m_hMapping,m_bReadOnly ? FILE_MAP_READ : FILE_MAP_ALL_ACCESS,
+                                     (DWORD) (llOffset >> 32),(DWORD) (llOffset & 0xFFFFFFFF),(SIZE_T) iWidthBytes*szTile.cy);
+        if (!stTile.pView) return stTile;
+
+        InterlockedIncrement((volatile LONG *) &m_iLockedTiles);
+
+        stTile.iTileX               = iTileX;
+        stTile.iTileY               = iTileY;
+        stTile.llX                  = (long long) iTileX*m_iTileSize;
+        stTile.llY                  = (long long) iTileY*m_iTileSize;
+        stTile.stBitmap.iWidth      = szTile.cx;
+        stTile.stBitmap.iHeight     = szTile.cy;
+        stTile.stBitmap.iWidthBytes = iWidthBytes;
+        stTile.stBitmap.iOverHang   = iWidthBytes - szTile.cx*3;
+        stTile.stBitmap.iTotalSize  = iWidthBytes*szTile.cy;
+        stTile.stBitmap.stMem       = (unsigned char *) stTile.pView;
+        stTile.stBitmap.stRGB       = (RGBColor24 *) stTile.pView;
+        stTile.stBitmap.sMask       = nullptr;
+        return stTile;
+    }
+
+    // UnlockTile() -- Unmap a tile locked with LockTile().  The tile's data is kept in the large bitmap.
+    // bFlush forces the tile to be written to disk immediately, rather than when Windows decides to write it.
+    //
+    void UnlockTile(LargeBitmapTile_t & stTile,bool bFlush = false)
+    {
+        if (!stTile.pView) return;
+        if (bFlush) FlushViewOfFile(stTile.pView,0);
+        UnmapViewOfFile(stTile.pView);
+        InterlockedDecrement((volatile LONG *) &m_iLockedTiles);
+        stTile = {};
+    }
+
+    // ReadTile() -- Copy a tile into a CBitmap.  If cDest is empty or the wrong size, it is (re)created to the tile size.
+    //
+    bool ReadTile(int iTileX,int iTileY,CBitmap & cDest)
+    {
+        SIZE szTile = GetTileSize(iTileX,iTileY);
+        if (!szTile.cx) return false;
+        if (cDest.GetWidth() != szTile.cx || cDest.GetHeight() != szTile.cy) cDest.CreateBitmap(szTile);
+        return ReadRegion((long long) iTileX*m_iTileSize,(long long) iTileY*m_iTileSize,*cDest);
+    }
+
+    // WriteTile() -- Copy a bitmap into a tile.  The bitmap is clipped to the tile size.
+    //
+    bool WriteTile(int iTileX,int iTileY,RawBitmap_t & stSource)
+    {
+        SIZE szTile = GetTileSize(iTileX,iTileY);
+        if (!szTile.cx) return false;
+        return TransferRegion((long long) iTileX*m_iTileSize,(long long) iTileY*m_iTileSize,stSource,{ 0,0 },szTile,true);
+    }
+    bool WriteTile(int iTileX,int iTileY,CBitmap & cSource) { return WriteTile(iTileX,iTileY,*cSource); }
+
+    // ReadRegion() -- Copy any rectangle of the large image into a bitmap, across tile boundaries.
+    //
+    // The rectangle starts at (llX,llY) and is the size of the destination bitmap (or szSize when given),
+    // placed at pDestStart in the destination.  Areas outside of the large image are not written.
+    //
+    bool ReadRegion(long long llX,long long llY,RawBitmap_t & stDest,POINT pDestStart = { 0,0 },SIZE szSize = { 0,0 })
+    {
+        if (!szSize.cx || !szSize.cy) szSize = { stDest.iWidth - pDestStart.x, stDest.iHeight - pDestStart.y };
+        return TransferRegion(llX,llY,stDest,pDestStart,szSize,false);
+    }
+    bool ReadRegion(long long llX,long long llY,CBitmap & cDest,POINT pDestStart = { 0,0 },SIZE szSize = { 0,0 })
+    {
+        return ReadRegion(llX,llY,*cDest,pDestStart,szSize);
+    }
+
+    // WriteRegion() -- Copy a bitmap (or part of it) into the large image at (llX,llY), across tile boundaries.
+    //
+    bool WriteRegion(long long llX,long long llY,RawBitmap_t & stSource,POINT pSourceStart = { 0,0 },SIZE szSize = { 0,0 })
+    {
+        if (!szSize.cx || !szSize.cy) szSize = { stSource.iWidth - pSourceStart.x, stSource.iHeight - pSourceStart.y };
+        return TransferRegion(llX,llY,stSource,pSourceStart,szSize,true);
+    }
+    bool WriteRegion(long long llX,long long llY,CBitmap & cSource,POINT pSourceStart = { 0,0 },SIZE szSize = { 0,0 })
+    {
+        return WriteRegion(llX,llY,*cSource,pSourceStart,szSize);
+    }
+
+    // ReadRows() / WriteRows() -- Stream whole rows in or out of the image (i.e. for reading or writing a file row band by row band)
+    // The bitmap must be the width of the large image; iHeight rows are transferred starting at row llY.
+    //
+    bool ReadRows(long long llY,RawBitmap_t & stDest)   { return stDest.iWidth == m_llWidth && ReadRegion(0,llY,stDest); }
+    bool WriteRows(long long llY,RawBitmap_t & stSource) { return stSource.iWidth == m_llWidth && WriteRegion(0,llY,stSource); }
+
+    // FillColor() -- Fill the entire image with a color, one tile at a time.
+    //
+    bool FillColor(RGBColor_t rgbColor)
+    {
+        if (!isValid()) return false;
+        for (int iTy=0;iTy<m_iTilesY;iTy++)
+            for (int iTx=0;iTx<m_iTilesX;iTx++)
+            {
+                auto stTile = LockTile(iTx,iTy);
+                if (!stTile.isValid()) return false;
+                stTile.stBitmap.FillColor(rgbColor);
+                UnlockTile(stTile);
+            }
+        return true;
+    }
+
+    // ProcessTiles() -- Run a function over the image one tile at a time.
+    //
+    // The function receives a bitmap containing the tile plus iApron pixels of the surrounding image on each side
+    // (clipped to the image), and an output bitmap of the same size to write to.  Only the tile area of the output
+    // (excluding the apron) is written to cDest.
+    //
+    // iApron should be large enough to cover the reach of the filter (i.e. 3x the radius for a Gaussian blur), so that tiles
+    // blend seamlessly.  When iApron is 0 cDest may be the same object as this bitmap; otherwise cDest must be a different
+    // CLargeBitmap of the same size, since neighboring tiles still need to read the original pixels.
+    //
+    // Each tile is processed on its own, so the function must not depend on statistics of the tile (i.e. normalizing or
+    // auto-levels) -- every tile would get a different stretch and the seams would show.  Gather such statistics over the
+    // whole image first and then apply them per pixel:
+    //
+    //      int iMin = 255, iMax = 0;                                   // Pass 1: range of the whole image
+    //      for (int iTy=0;iTy<cBitmap.GetTilesY();iTy++)
+    //          for (int iTx=0;iTx<cBitmap.GetTilesX();iTx++)
+    //          {
+    //              auto stTile = cBitmap.LockTile(iTx,iTy);
+    //              ... update iMin, iMax from stTile.stBitmap ...
+    //              cBitmap.UnlockTile(stTile);
+    //          }
+    //
+    //      cBitmap.ProcessTiles(cOut,0,[&](CBitmap & cIn,CBitmap & cOut)     // Pass 2: the same stretch for every tile
+    //      {
+    //          RawBitmap_t & stIn = cIn.stBitmap, & stOut = cOut.stBitmap;
+    //          for (int y=0;y<stIn.iHeight;y++)
+    //              for (int x=0;x<stIn.iWidth*3;x++)
+    //              {
+    //                  int iValue = stIn.stMem[y*stIn.iWidthBytes + x];
+    //                  stOut.stMem[y*stOut.iWidthBytes + x] = (unsigned char) ((iValue - iMin)*255/(std::max)(1,iMax - iMin));
+    //              }
+    //          return true;
+    //      });
+    //
+    bool ProcessTiles(CLargeBitmap & cDest,int iApron,const std::function<bool(CBitmap & cIn,CBitmap & cOut)> & fnProcess)
+    {
+        if (!isValid() || !cDest.isValid() || cDest.m_llWidth != m_llWidth || cDest.m_llHeight != m_llHeight) return false;
+        if (iApron < 0) iApron = 0;
+        if (iApron && &cDest == this) return false;
+
+        CBitmap cIn;
+        CBitmap cOut;
+
+        for (int iTy=0;iTy<m_iTilesY;iTy++)
+            for (int iTx=0;iTx<m_iTilesX;iTx++)
+            {
+                SIZE szTile = GetTileSize(iTx,iTy);
+                long long llX = (long long) iTx*m_iTileSize;
+                long long llY = (long long) iTy*m_iTileSize;
+
+                long long llX1 = max(0LL,llX - iApron);
+                long long llY1 = max(0LL,llY - iApron);
+                long long llX2 = min(m_llWidth,llX + szTile.cx + iApron);
+                long long llY2 = min(m_llHeight,llY + szTile.cy + iApron);
+
+                SIZE szIn = { (LONG) (llX2 - llX1), (LONG) (llY2 - llY1) };
+
+                if (cIn.GetWidth() != szIn.cx || cIn.GetHeight() != szIn.cy)
+                {
+                    cIn.CreateBitmap(szIn);
+                    cOut.CreateBitmap(szIn);
+                }
+                if (!ReadRegion(llX1,llY1,cIn)) return false;
+                if (!fnProcess(cIn,cOut)) return false;
+
+                POINT pTileStart = { (LONG) (llX - llX1), (LONG) (llY - llY1) };
+                if (!cDest.WriteRegion(llX,llY,cOut,pTileStart,szTile)) return false;
+            }
+        return true;
+    }
+
+#if !defined(SAGE_NO_SAGETOOLS)
+    // GaussianBlurStd() -- Blur the large image into cDest with CSageTools::GaussianBlurStd(), tile by tile.
+    // cDest must be a different CLargeBitmap of the same size (see ProcessTiles())
+    //
+    bool GaussianBlurStd(CLargeBitmap & cDest,double fRadius)
+    {
+        int iApron = (int) std::ceil(fRadius*3.0);
+        return ProcessTiles(cDest,iApron,[fRadius](CBitmap & cIn,CBitmap & cOut) { return CSageTools::GaussianBlurStd(cIn,cOut,fRadius); });
+    }
+#endif
+};
+
+}; // namespace Sage
+#endif // _CLargeBitmap_H_
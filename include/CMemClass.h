@@ -7,6 +7,9 @@
 // MemA is used to align memory on a 128-byte boundary for using SSE, and other instructions that require alignment.
 // MemA alignment is 128 bytes regardless of the data type, allowing arrays of unsigned char, int, etc to be alligned
 // on a 128-byte boundary more easily. 
+//
+// MemP takes an allocation policy (alignment, large pages, geometric growth) as a template parameter, and uses 64-bit sizes.
+// See MemPolicyDefault below. 
 
 // While exceptions and boundary safety are provided with [] usage (i.e. MyMemory[iIndex]), the Mem and MemA classes
 // are meant to be used as containers, with the main usage as pointers directly to memory.
@@ -39,6 +42,10 @@
 #include <cstdio>
 #include <memory>
 #include <malloc.h>
+#include <cstring>
+#include <atomic>
+#include <type_traits>
+#include <emmintrin.h>
 #include "Sage.h"
 #include "ErrCtl.h"
 #include "CString.h"
@@ -54,6 +61,169 @@ namespace Sage
     {
     public:
         static CString ShowExceptMsg(const char * sTitle, const char * sMsg,const char * sFile,unsigned int sLine);
+
+        static constexpr size_t kStreamThreshold    = 4*1024*1024;     // Smallest fill that bStream fills bypass the cache for (non-temporal stores)
+        static constexpr size_t kHugePageThreshold  = 2*1024*1024;     // Smallest allocation MemP<> will try to put in large pages
+
+        // FillBytes16() -- Fill szBytes at pDest with a 16-byte pattern, using SSE2 stores.  pDest must be 16-byte aligned
+        // and szBytes a multiple of 16.  With bStream, fills of kStreamThreshold bytes or more use non-temporal stores,
+        // which are faster for memory that is not read again soon but leave none of it in the cache.
+        //
+        static void FillBytes16(void * pDest,size_t szBytes,__m128i m128Pattern,bool bStream)
+        {
+            auto * pOut = (__m128i *) pDest;
+            size_t szBlocks = szBytes/16;
+
+            if (bStream && szBytes >= kStreamThreshold)
+            {
+                for (size_t i=0;i<szBlocks;i++) _mm_stream_si128(pOut+i,m128Pattern);
+                _mm_sfence();
+                return;
+            }
+
+            size_t i = 0;
+            for (;i+4<=szBlocks;i+=4)
+            {
+                _mm_store_si128(pOut+i,m128Pattern);
+                _mm_store_si128(pOut+i+1,m128Pattern);
+                _mm_store_si128(pOut+i+2,m128Pattern);
+                _mm_store_si128(pOut+i+3,m128Pattern);
+            }
+            for (;i<szBlocks;i++) _mm_store_si128(pOut+i,m128Pattern);
+        }
+
+        // FillKind_t -- How FillItems() fills a type: 0 = one item at a time, 1 = memset(), 2 = SSE2 16-byte pattern
+        //
+        template <class _t>
+        using FillKind_t = std::integral_constant<int,!std::is_trivially_copyable<_t>::value ? 0 : sizeof(_t) == 1 ? 1 :
+                                                      (sizeof(_t) == 2 || sizeof(_t) == 4 || sizeof(_t) == 8 || sizeof(_t) == 16) ? 2 : 0>;
+
+        template <class _t>
+        static void FillItems(_t * pMem,long long llCount,const _t & tValue,bool,std::integral_constant<int,0>)
+        {
+            for (long long i=0;i<llCount;i++) pMem[i] = tValue;
+        }
+
+        template <class _t>
+        static void FillItems(_t * pMem,long long llCount,const _t & tValue,bool bStream,std::integral_constant<int,1>)
+        {
+            unsigned char ucValue;
+            memcpy(&ucValue,&tValue,1);
+            ClearBytes(pMem,(size_t) llCount,ucValue,bStream);
+        }
+
+        template <class _t>
+        static void FillItems(_t * pMem,long long llCount,const _t & tValue,bool bStream,std::integral_constant<int,2>)
+        {
+            // Fill items one at a time until the pointer is 16-byte aligned (if it can be), then in 16-byte blocks
+
+            constexpr size_t szItem = sizeof(_t);
+            _t * pEnd = pMem + llCount;
+            while (pMem < pEnd && ((size_t) pMem & 15)) *pMem++ = tValue;
+            if (((size_t) pMem & 15) == 0)
+            {
+                alignas(16) unsigned char ucPattern[16];
+                for (size_t i=0;i<16;i+=szItem) memcpy(ucPattern+i,&tValue,szItem);
+
+                size_t szBytes = ((size_t) (pEnd-pMem)*szItem) & ~(size_t) 15;
+                FillBytes16(pMem,szBytes,_mm_load_si128((__m128i *) ucPattern),bStream);
+                pMem += szBytes/szItem;
+            }
+            while (pMem < pEnd) *pMem++ = tValue;
+        }
+
+        // FillItems() -- Fill llCount items with a value.  Uses SSE2 for trivially-copyable 2, 4, 8 and 16-byte types, and
+        // memset() for 1-byte types.  Other types are copied one at a time.  bStream: see FillBytes16().
+        //
+        template <class _t>
+        static void FillItems(_t * pMem,long long llCount,const _t & tValue,bool bStream = false)
+        {
+            if (pMem && llCount > 0) FillItems(pMem,llCount,tValue,bStream,FillKind_t<_t>());
+        }
+
+        // ClearBytes() -- memset() to a byte value.  With bStream, blocks of kStreamThreshold bytes or more are written
+        // with non-temporal stores (see FillBytes16()).
+        //
+        static void ClearBytes(void * pMem,size_t szBytes,unsigned char ucValue = 0,bool bStream = false)
+        {
+            if (!pMem || !szBytes) return;
+            if (!bStream || szBytes < kStreamThreshold) { memset(pMem,ucValue,szBytes); return; }
+
+            auto * pBytes = (unsigned char *) pMem;
+            size_t szHead = (16 - ((size_t) pBytes & 15)) & 15;
+            memset(pBytes,ucValue,szHead);
+            size_t szBody = (szBytes-szHead) & ~(size_t) 15;
+            FillBytes16(pBytes+szHead,szBody,_mm_set1_epi8((char) ucValue),true);
+            memset(pBytes+szHead+szBody,ucValue,szBytes-szHead-szBody);
+        }
+
+        enum class AllocType : unsigned char
+        {
+            None,
+            Aligned,        // _aligned_malloc()
+            Virtual,        // VirtualAlloc() -- large (huge) pages, or page-aligned memory when large pages are not available
+        };
+
+        // EnableLockMemoryPrivilege() -- Enable SeLockMemoryPrivilege in the process token, which VirtualAlloc() needs for
+        // MEM_LARGE_PAGES.  This is done once; it returns false when the account has not been given the "Lock pages in
+        // memory" right (Local Security Policy), which is the default.
+        //
+        static bool EnableLockMemoryPrivilege()
+        {
+            static const bool bEnabled = []
+            {
+                HANDLE hToken = nullptr;
+                if (!OpenProcessToken(GetCurrentProcess(),TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY,&hToken)) return false;
+
+                TOKEN_PRIVILEGES stPrivileges = {};
+                stPrivileges.PrivilegeCount             = 1;
+                stPrivileges.Privileges[0].Attributes   = SE_PRIVILEGE_ENABLED;
+
+                // AdjustTokenPrivileges() succeeds without enabling anything when the account lacks the right
+
+                bool bOk = LookupPrivilegeValueA(nullptr,"SeLockMemoryPrivilege",&stPrivileges.Privileges[0].Luid) &&
+                           AdjustTokenPrivileges(hToken,FALSE,&stPrivileges,0,nullptr,nullptr) && GetLastError() == ERROR_SUCCESS;
+                CloseHandle(hToken);
+                return bOk;
+            }();
+            return bEnabled;
+        }
+
+        // AllocBlock() -- Allocate szBytes aligned to szAlign.  When bLargePages is true and the allocation is large enough,
+        // large pages are tried first, enabling SeLockMemoryPrivilege on first use (see EnableLockMemoryPrivilege()).
+        // When the privilege cannot be enabled or large pages are not available, normal pages are used.
+        //
+        static void * AllocBlock(size_t szBytes,size_t szAlign,bool bLargePages,AllocType & eType)
+        {
+            eType = AllocType::None;
+            if (!szBytes) return nullptr;
+
+            if (bLargePages && szBytes >= kHugePageThreshold)
+            {
+                static std::atomic<bool> bLargePagesFailed{false};
+                size_t szLarge = GetLargePageMinimum();
+                if (szLarge && !bLargePagesFailed && EnableLockMemoryPrivilege())
+                {
+                    void * pMem = VirtualAlloc(nullptr,(szBytes + szLarge-1)/szLarge*szLarge,MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,PAGE_READWRITE);
+                    if (pMem) { eType = AllocType::Virtual; return pMem; }
+                    bLargePagesFailed = true;
+                }
+                void * pMem = VirtualAlloc(nullptr,szBytes,MEM_RESERVE | MEM_COMMIT,PAGE_READWRITE);
+                if (pMem) eType = AllocType::Virtual;
+                return pMem;
+            }
+
+            void * pMem = _aligned_malloc(szBytes,szAlign < sizeof(void *) ? sizeof(void *) : szAlign);
+            if (pMem) eType = AllocType::Aligned;
+            return pMem;
+        }
+
+        static void FreeBlock(void * pMem,AllocType eType)
+        {
+            if (!pMem) return;
+            if (eType == AllocType::Aligned) _aligned_free(pMem);
+            else if (eType == AllocType::Virtual) VirtualFree(pMem,0,MEM_RELEASE);
+        }
     };
 template <class _t>
 	class Mem
@@ -192,6 +362,21 @@ template <class _t>
             }
         }
 
+        // FillFast() -- Fill() using SSE2 stores (see MemTools::FillItems()).  Fills of 4MB or more use non-temporal stores,
+        // which do not leave the memory in the cache -- use Fill() when the memory is read again right away.
+        //
+        void FillFast(const _t & t)
+        {
+            if (pMem) MemTools::FillItems(pMem,iSize,t,true);
+        }
+
+        // ClearMemFast() -- ClearMem() using non-temporal stores for 4MB or more (see MemTools::ClearBytes()).
+        //
+        void ClearMemFast(unsigned char ucValue = 0)
+        {
+            if (pMem) MemTools::ClearBytes(pMem,iSize*sizeof(_t),ucValue,true);
+        }
+
         // SetMaxBlock() -- Keep Memory sized to a certain block size past the current size. 
         //
         // **** Use this function BEFORE accessing the next pointer to ensure memory is available ****
@@ -570,6 +755,21 @@ template <class _t>
                 for (int i=0;i<iSize;i++) *pTemp++ = t;
             }
         }
+
+        // FillFast() -- Fill() using SSE2 stores (see MemTools::FillItems()).  Fills of 4MB or more use non-temporal stores,
+        // which do not leave the memory in the cache -- use Fill() when the memory is read again right away.
+        //
+        void FillFast(const _t & t)
+        {
+            if (pMem) MemTools::FillItems(pMem,iSize,t,true);
+        }
+
+        // ClearMemFast() -- ClearMem() using non-temporal stores for 4MB or more (see MemTools::ClearBytes()).
+        //
+        void ClearMemFast(unsigned char ucValue = 0)
+        {
+            if (pMem) MemTools::ClearBytes(pMem,iSize*sizeof(_t),ucValue,true);
+        }
 		MemA(const MemA &p2)
 		{
 			if (&p2 == this)
@@ -651,6 +851,267 @@ template <class _t>
 
 	};
 
+// Allocation policies for MemP<>.
+//
+//      kAlignment      -- Alignment of the memory, in bytes (power of 2).  64 bytes is a full cache line and the widest SIMD load.
+//      bLargePages     -- Try large (huge) pages for allocations of MemTools::kHugePageThreshold bytes or more.
+//                         Large pages need the "Lock pages in memory" right, which MemP enables in the process token
+//                         on first use; when the account does not have it, page-aligned memory is used.
+//      bGeometric      -- ResizeMax() and Append() grow the capacity by 1.5x (amortized O(1) growth) rather than to the exact size.
+//
+struct MemPolicyDefault { static constexpr size_t kAlignment = 64;  static constexpr bool bLargePages = false; static constexpr bool bGeometric = true;  };
+struct MemPolicyExact   { static constexpr size_t kAlignment = 64;  static constexpr bool bLargePages = false; static constexpr bool bGeometric = false; };
+struct MemPolicyLarge   { static constexpr size_t kAlignment = 64;  static constexpr bool bLargePages = true;  static constexpr bool bGeometric = true;  };
+struct MemPolicyA128    { static constexpr size_t kAlignment = 128; static constexpr bool bLargePages = false; static constexpr bool bGeometric = false; };
+
+// MemP -- Mem with an allocation policy and 64-bit sizes.
+//
+// MemP works as Mem and MemA (the memory is used through the pointer), with the policy as a template parameter:
+//
+//      MemP<double> MyDoubles(iCount);                             // 64-byte aligned
+//      MemP<float,MemPolicyLarge> MyWeights(llCount);              // 64-byte aligned, large pages for large buffers
+//
+// Unlike Mem, MemP keeps a capacity separate from the size, so ResizeMax() and Append() do not reallocate on every call,
+// and Resize()/ResizeUninit() can shrink the size without freeing the memory.
+//
+// Resize() and ResizeUninit() differ in that Resize() zeros new items, where ResizeUninit() leaves them uninitialized
+// (use this when the memory is about to be written anyway).
+//
+// As with Mem, MemP is for data types only (no constructors or destructors are called).  MemP can be moved but not copied;
+// use copyFrom() to copy.
+//
+template <class _t,class _Policy = MemPolicyDefault>
+	class MemP
+	{
+        static_assert((_Policy::kAlignment & (_Policy::kAlignment-1)) == 0,"MemP: Policy alignment must be a power of 2");
+
+	private:
+        MemTools::AllocType eAllocType = MemTools::AllocType::None;
+
+        MemP(const MemP &p2) = delete;
+        MemP & operator = (const MemP &p2) = delete;
+
+        // Realloc() -- Set the capacity to llNewCapacity items, keeping the first llKeep items.
+        //
+        bool Realloc(long long llNewCapacity,long long llKeep)
+        {
+            if (llNewCapacity == llCapacity) return true;
+            if (llNewCapacity <= 0) { DeleteData(); return true; }
+
+            MemTools::AllocType eNewType;
+            auto pNewMem = (_t *) MemTools::AllocBlock((size_t) llNewCapacity*sizeof(_t),_Policy::kAlignment,_Policy::bLargePages,eNewType);
+            if (!pNewMem) return false;
+
+            if (pMem && llKeep > 0) memcpy(pNewMem,pMem,(size_t) (llKeep < llNewCapacity ? llKeep : llNewCapacity)*sizeof(_t));
+            MemTools::FreeBlock(pMem,eAllocType);
+
+            pMem        = pNewMem;
+            eAllocType  = eNewType;
+            llCapacity  = llNewCapacity;
+            return true;
+        }
+
+        long long GrowCapacity(long long llNeeded)
+        {
+            if (!_Policy::bGeometric) return llNeeded;
+            long long llGrow = llCapacity + llCapacity/2;
+            return llGrow > llNeeded ? llGrow : llNeeded;
+        }
+
+	public:
+		long long llSize        = 0;
+        long long llCapacity    = 0;
+		_t * pMem = nullptr;
+        _t * GetMem() { return pMem; }
+
+        static constexpr size_t kAlignment = _Policy::kAlignment;
+
+        MemP() { }
+		MemP(long long llItems) { ResizeUninit(llItems); }
+		~MemP() { DeleteData(); }
+
+        MemP(MemP && p2) noexcept
+        {
+            llSize      = p2.llSize;
+            llCapacity  = p2.llCapacity;
+            pMem        = p2.pMem;
+            eAllocType  = p2.eAllocType;
+
+            p2.llSize       = 0;
+            p2.llCapacity   = 0;
+            p2.pMem         = nullptr;
+            p2.eAllocType   = MemTools::AllocType::None;
+        }
+        MemP & operator=(MemP && p2) noexcept
+        {
+            if (this != &p2)
+            {
+                DeleteData();
+                llSize      = p2.llSize;
+                llCapacity  = p2.llCapacity;
+                pMem        = p2.pMem;
+                eAllocType  = p2.eAllocType;
+
+                p2.llSize       = 0;
+                p2.llCapacity   = 0;
+                p2.pMem         = nullptr;
+                p2.eAllocType   = MemTools::AllocType::None;
+            }
+            return *this;
+        }
+
+		void DeleteData()
+		{
+			MemTools::FreeBlock(pMem,eAllocType);
+			pMem        = nullptr;
+			llSize      = 0;
+            llCapacity  = 0;
+            eAllocType  = MemTools::AllocType::None;
+		}
+
+		// GetNumItems() -- Returns the number of elements in use.  Use GetMemSize() for total memory size
+		//
+		__forceinline long long GetNumItems() { return pMem ? llSize : 0; }
+
+		// GetMemSize() -- Returns the memory size of the elements in use (i.e. number of elements X sizeof(element_type))
+		//
+		__forceinline long long GetMemSize() { return pMem ? llSize*(long long) sizeof(_t) : 0; }
+
+        // GetCapacity() -- Returns the number of elements allocated, which may be more than GetNumItems()
+        //
+		__forceinline long long GetCapacity() { return pMem ? llCapacity : 0; }
+
+        // isLargePages() -- Returns true if the memory was allocated with VirtualAlloc() (large pages, when available)
+        //
+        bool isLargePages() { return eAllocType == MemTools::AllocType::Virtual; }
+
+        // Reserve() -- Make sure the capacity is at least llItems, without changing the size.
+        //
+        // Returns the current pointer to the allocated memory, or nullptr if the allocation failed (the current memory is kept).
+        //
+        _t * Reserve(long long llItems)
+        {
+            if (llItems > llCapacity && !Realloc(llItems,llSize)) return nullptr;
+            return pMem;
+        }
+
+        // ResizeUninit() -- Set the size to llItems.  New items are not initialized.  The capacity is never reduced
+        // (use ShrinkToFit() to release unused memory).
+        //
+        // Returns the current pointer to the allocated memory, or nullptr if the allocation failed (the current memory is kept).
+        //
+        _t * ResizeUninit(long long llItems)
+        {
+            if (llItems < 0) llItems = 0;
+            if (llItems > llCapacity && !Realloc(llItems,llSize)) return nullptr;
+            llSize = llItems;
+            return pMem;
+        }
+
+        // Resize() -- Set the size to llItems, filling new items with zeros.
+        //
+        _t * Resize(long long llItems)
+        {
+            long long llOldSize = llSize;
+            if (!ResizeUninit(llItems)) return nullptr;
+            if (llSize > llOldSize) MemTools::ClearBytes(pMem+llOldSize,(size_t) (llSize-llOldSize)*sizeof(_t));
+            return pMem;
+        }
+
+		// ResizeMax() -- Resize the memory to the new value or keep the current size, whichever is greater.
+        //
+        // With a geometric policy (the default), the capacity grows by at least 1.5x, so calling ResizeMax() with a slowly
+        // growing size in a loop reallocates only O(log n) times.  New items are not initialized.
+		//
+		// ResizeMax() returns the current pointer to the allocated memory, or nullptr if the allocation failed.
+		//
+		__forceinline _t * ResizeMax(long long llItems)
+		{
+			if (llItems > llCapacity && !Realloc(GrowCapacity(llItems),llSize)) return nullptr;
+			if (llItems > llSize) llSize = llItems;
+			return pMem;
+		}
+
+        // Append() -- Add an item to the end, growing the memory as needed.  Returns false if the memory could not be allocated.
+        //
+        __forceinline bool Append(const _t & tValue)
+        {
+            if (llSize >= llCapacity && !Realloc(GrowCapacity(llSize+1),llSize)) return false;
+            pMem[llSize++] = tValue;
+            return true;
+        }
+
+        // ShrinkToFit() -- Reduce the capacity to the current size.
+        //
+        bool ShrinkToFit() { return Realloc(llSize,llSize); }
+
+		// Clear all allocate memory of array.  If a value is specified, the memory is filled with this value (unsigned char of 0-255)
+		//
+        // bStream -- Use non-temporal stores for 4MB (MemTools::kStreamThreshold) or more.  This is faster for buffers
+        //            that are not read again soon, but leaves none of the memory in the cache.
+        //
+		void ClearMem(unsigned char ucValue = 0,bool bStream = false)
+		{
+			if (pMem) MemTools::ClearBytes(pMem,(size_t) llSize*sizeof(_t),ucValue,bStream);
+		}
+
+        // Fill() -- Fill memory with a specified value corresponding to the MemP type (i.e. int, double, etc.)
+        //
+        // bStream -- As with ClearMem(), use non-temporal stores for 4MB or more, i.e. MyWeights.Fill(0.0f,true) for a
+        //            large buffer that is filled long before it is used.
+        //
+        void Fill(const _t & t,bool bStream = false)
+        {
+            if (pMem) MemTools::FillItems(pMem,llSize,t,bStream);
+        }
+
+		_t MemNull{};
+		bool isValid() { return pMem != nullptr; };
+		bool isEmpty() { return pMem == nullptr; };
+		operator _t * () const { return (_t *) pMem; };
+		_t * operator = (long long llItems)
+		{
+            llSize = 0;
+			return ResizeUninit(llItems);
+		}
+#if defined(NOBOUNDS)
+            __forceinline _t & operator [](long long i) { return pMem[i]; }
+#elif defined(NOMEMEXCEPT)
+
+		 __forceinline _t & operator [](long long i) 
+         { 
+             if (!pMem) return MemNull;
+             if ((i < 0) | (i >= llSize)) i = 0;
+             return pMem[i];  
+         }
+#else
+		 __forceinline _t & operator [](long long i) 
+         { 
+             if ((!pMem) | (i < 0) | (i >= llSize))
+             {
+                 char sMsg[100];
+                 snprintf(sMsg,sizeof(sMsg),"MemP::[] Value out of range.\n\nValue = %lld\nMax Size = %lld",i,llSize);
+                 auto cs = MemTools::ShowExceptMsg("MemP Object Error",sMsg,__FILE__,__LINE__);
+                throw std::exception(cs.str()); 
+             }
+             return pMem[i];  
+         }
+#endif
+
+		 __forceinline _t & operator ()(long long i) { return pMem[i];  }
+
+		bool copyFrom(const MemP & p2)
+		{
+            llSize = 0;
+			if (!p2.pMem || !p2.llSize) return true;
+			if (!ResizeUninit(p2.llSize)) return false;
+			memcpy(pMem,p2.pMem,(size_t) p2.llSize*sizeof(_t));
+			return true;
+		}
+	};
+
+template <class _t> using MemLarge = MemP<_t,MemPolicyLarge>;
+
 template <class _t>
 	class Obj
 	{
@@ -671,12 +1132,12 @@ template <class _t>
 		Obj(const Obj &p2)
 		{
 			memcpy(this,&p2,sizeof(*this));
-			Obj * pMem = (Mem *) &p2;
+			Obj * pMem = (Obj *) &p2;
 			pMem->pObj = nullptr;
 		}
 
-		bool isValid() { return Obj != nullptr; };
-		bool isEmpty() { return Obj == nullptr; };
+		bool isValid() { return pObj != nullptr; };
+		bool isEmpty() { return pObj == nullptr; };
 		_t * operator ->() const { return pObj; };
 	};
 }; // namespace Sage
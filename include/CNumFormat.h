@@ -0,0 +1,960 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CNumFormat -- Fast number to text and text to number conversion, without sprintf()/sscanf() or the C locale.
+//
+// Integers are written with a two-digit lookup table, writing from the end of the number.
+//
+// When compiled as C++17, doubles are written using std::to_chars(), which gives the shortest text that reads back
+// as exactly the same double (Ryu-based in the Microsoft STL and in libstdc++).  Format() honors a CString float style
+// (i.e. "%g", "%.3f", "%.10e"), giving the same text as sprintf() for the styles it handles directly and falling
+// back to snprintf() for styles with flags or a field width.
+//
+// ParseDouble() and ParseInt() are the matching input functions, accepting the leading whitespace and '+' accepted
+// by atof()/atoi().  ParseDouble() uses std::from_chars() with C++17.  ParseInt() does its own conversion.
+//
+// With C++14 (the Sagebox projects' default) there is no <charconv>, and CNumFormat does the conversions itself:
+//
+//      Shortest()      -- Grisu3 (Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers"),
+//                         with 64-bit significands and a table of 87 cached powers of ten.  About 0.5% of doubles cannot
+//                         be proven shortest by Grisu3; these use the %.15e/%.16e/%.17e + strtod() search.  The text
+//                         is laid out as std::to_chars() does, so C++14 and C++17 builds write the same text.
+//      Format()        -- %f (precision up to 17) is rounded exactly with 128-bit integer arithmetic.  %e and %g (up to
+//                         15 significant digits) round the shortest digits, which gives the same result as rounding the
+//                         double itself unless the shortest text is exactly one digit longer than the precision; that
+//                         case, subnormals, and everything else go to snprintf().
+//      ParseDouble()   -- Up to 19 significant digits are read into an integer.  Clinger's exact fast path is used when
+//                         the digits fit in 53 bits and the exponent is within 10^22, otherwise the digits are scaled
+//                         with a cached power of ten with a bound on the error (as in double-conversion's Strtod()).
+//                         Results too close to halfway between two doubles, outside the normal range, hexadecimal, inf
+//                         and nan are read with strtod().
+//
+// Text() returns a small stack object that can be streamed into a CString, i.e.
+//
+//      CString() << "Value = " << CNumFormat::Text(fValue);           // Shortest round-trip text
+//      CString() << "Value = " << CNumFormat::Text(fValue,"%.3f");    // Fixed precision
+//
+#if !defined(_CNumFormat_H_)
+#define _CNumFormat_H_
+
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#define _CNumFormat_CharConv_
+#include <charconv>
+#endif
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace Sage
+{
+
+class CNumFormat
+{
+public:
+    static constexpr int kMaxText = 32;     // Large enough for any integer or shortest double; Format() may need up to kMaxFormatText
+    static constexpr int kMaxFormatText = 350;
+
+    // NumText_t -- Formatted number held on the stack.  Converts to const char * for CString and other text functions.
+    //
+    struct NumText_t
+    {
+        char sText[kMaxFormatText];
+        int iLength;
+        operator const char * () const { return sText; }
+        const char * c_str() const { return sText; }
+    };
+
+private:
+    static const char * DigitPairs()
+    {
+        static constexpr char sPairs[] =
+            "00010203040506070809"
+            "10111213141516171819"
+            "20212223242526272829"
+            "30313233343536373839"
+            "40414243444546474849"
+            "50515253545556575859"
+            "60616263646566676869"
+            "70717273747576777879"
+            "80818283848586878889"
+            "90919293949596979899";
+        return sPairs;
+    }
+
+    static int CountDigits(unsigned long long ullValue)
+    {
+        int iDigits = 1;
+        for (;;)
+        {
+            if (ullValue < 10) return iDigits;
+            if (ullValue < 100) return iDigits+1;
+            if (ullValue < 1000) return iDigits+2;
+            if (ullValue < 10000) return iDigits+3;
+            ullValue /= 10000;
+            iDigits += 4;
+        }
+    }
+
+    // FloatStyle_t -- A parsed float style such as "%.3f".  bDirect is false for styles needing snprintf().
+    //
+    struct FloatStyle_t
+    {
+        bool bDirect;
+        bool bUpper;
+        int iPrecision;
+        char cConv;         // 'f', 'e' or 'g'
+    };
+
+    static FloatStyle_t ParseStyle(const char * sStyle)
+    {
+        FloatStyle_t stStyle = { false, false, 6, 'g' };
+        if (!sStyle || sStyle[0] != '%') return stStyle;
+
+        const char * s = sStyle+1;
+        if (*s == '.')
+        {
+            s++;
+            stStyle.iPrecision = 0;
+            while (*s >= '0' && *s <= '9') stStyle.iPrecision = stStyle.iPrecision*10 + (*s++ - '0');
+            if (stStyle.iPrecision > 300) return stStyle;
+        }
+        if (*s == 'l') s++;
+        switch (*s)
+        {
+            case 'f': case 'F': stStyle.cConv = 'f';    break;
+            case 'e': case 'E': stStyle.cConv = 'e';    break;
+            case 'g': case 'G': stStyle.cConv = 'g';    break;
+            default: return stStyle;
+        }
+        stStyle.bUpper = *s == 'F' || *s == 'E' || *s == 'G';
+        stStyle.bDirect = !s[1];
+        return stStyle;
+    }
+
+    static constexpr unsigned long long kHiddenBit      = 0x0010000000000000ULL;
+    static constexpr unsigned long long kFractionMask   = 0x000FFFFFFFFFFFFFULL;
+
+    // DiyFp_t -- ullF * 2^iE, the "do it yourself" floating point of Grisu and double-conversion
+    //
+    struct DiyFp_t
+    {
+        unsigned long long ullF;
+        int iE;
+    };
+
+    // CachedPower_t -- 10^iDecimal = ullF * 2^iBinary, rounded to 64 bits
+    //
+    struct CachedPower_t
+    {
+        unsigned long long ullF;
+        int iBinary;
+        int iDecimal;
+    };
+
+    // CachedPowers() -- 10^-348 to 10^340 in steps of 8
+    //
+    static const CachedPower_t * CachedPowers()
+    {
+        static constexpr CachedPower_t stPowers[] =
+        {
+            { 0xfa8fd5a0081c0288ULL,-1220, -348 }, { 0xbaaee17fa23ebf76ULL,-1193, -340 }, { 0x8b16fb203055ac76ULL,-1166, -332 },
+            { 0xcf42894a5dce35eaULL,-1140, -324 }, { 0x9a6bb0aa55653b2dULL,-1113, -316 }, { 0xe61acf033d1a45dfULL,-1087, -308 },
+            { 0xab70fe17c79ac6caULL,-1060, -300 }, { 0xff77b1fcbebcdc4fULL,-1034, -292 }, { 0xbe5691ef416bd60cULL,-1007, -284 },
+            { 0x8dd01fad907ffc3cULL, -980, -276 }, { 0xd3515c2831559a83ULL, -954, -268 }, { 0x9d71ac8fada6c9b5ULL, -927, -260 },
+            { 0xea9c227723ee8bcbULL, -901, -252 }, { 0xaecc49914078536dULL, -874, -244 }, { 0x823c12795db6ce57ULL, -847, -236 },
+            { 0xc21094364dfb5637ULL, -821, -228 }, { 0x9096ea6f3848984fULL, -794, -220 }, { 0xd77485cb25823ac7ULL, -768, -212 },
+            { 0xa086cfcd97bf97f4ULL, -741, -204 }, { 0xef340a98172aace5ULL, -715, -196 }, { 0xb23867fb2a35b28eULL, -688, -188 },
+            { 0x84c8d4dfd2c63f3bULL, -661, -180 }, { 0xc5dd44271ad3cdbaULL, -635, -172 }, { 0x936b9fcebb25c996ULL, -608, -164 },
+            { 0xdbac6c247d62a584ULL, -582, -156 }, { 0xa3ab66580d5fdaf6ULL, -555, -148 }, { 0xf3e2f893dec3f126ULL, -529, -140 },
+            { 0xb5b5ada8aaff80b8ULL, -502, -132 }, { 0x87625f056c7c4a8bULL, -475, -124 }, { 0xc9bcff6034c13053ULL, -449, -116 },
+            { 0x964e858c91ba2655ULL, -422, -108 }, { 0xdff9772470297ebdULL, -396, -100 }, { 0xa6dfbd9fb8e5b88fULL, -369,  -92 },
+            { 0xf8a95fcf88747d94ULL, -343,  -84 }, { 0xb94470938fa89bcfULL, -316,  -76 }, { 0x8a08f0f8bf0f156bULL, -289,  -68 },
+            { 0xcdb02555653131b6ULL, -263,  -60 }, { 0x993fe2c6d07b7facULL, -236,  -52 }, { 0xe45c10c42a2b3b06ULL, -210,  -44 },
+            { 0xaa242499697392d3ULL, -183,  -36 }, { 0xfd87b5f28300ca0eULL, -157,  -28 }, { 0xbce5086492111aebULL, -130,  -20 },
+            { 0x8cbccc096f5088ccULL, -103,  -12 }, { 0xd1b71758e219652cULL,  -77,   -4 }, { 0x9c40000000000000ULL,  -50,    4 },
+            { 0xe8d4a51000000000ULL,  -24,   12 }, { 0xad78ebc5ac620000ULL,    3,   20 }, { 0x813f3978f8940984ULL,   30,   28 },
+            { 0xc097ce7bc90715b3ULL,   56,   36 }, { 0x8f7e32ce7bea5c70ULL,   83,   44 }, { 0xd5d238a4abe98068ULL,  109,   52 },
+            { 0x9f4f2726179a2245ULL,  136,   60 }, { 0xed63a231d4c4fb27ULL,  162,   68 }, { 0xb0de65388cc8ada8ULL,  189,   76 },
+            { 0x83c7088e1aab65dbULL,  216,   84 }, { 0xc45d1df942711d9aULL,  242,   92 }, { 0x924d692ca61be758ULL,  269,  100 },
+            { 0xda01ee641a708deaULL,  295,  108 }, { 0xa26da3999aef774aULL,  322,  116 }, { 0xf209787bb47d6b85ULL,  348,  124 },
+            { 0xb454e4a179dd1877ULL,  375,  132 }, { 0x865b86925b9bc5c2ULL,  402,  140 }, { 0xc83553c5c8965d3dULL,  428,  148 },
+            { 0x952ab45cfa97a0b3ULL,  455,  156 }, { 0xde469fbd99a05fe3ULL,  481,  164 }, { 0xa59bc234db398c25ULL,  508,  172 },
+            { 0xf6c69a72a3989f5cULL,  534,  180 }, { 0xb7dcbf5354e9beceULL,  561,  188 }, { 0x88fcf317f22241e2ULL,  588,  196 },
+            { 0xcc20ce9bd35c78a5ULL,  614,  204 }, { 0x98165af37b2153dfULL,  641,  212 }, { 0xe2a0b5dc971f303aULL,  667,  220 },
+            { 0xa8d9d1535ce3b396ULL,  694,  228 }, { 0xfb9b7cd9a4a7443cULL,  720,  236 }, { 0xbb764c4ca7a44410ULL,  747,  244 },
+            { 0x8bab8eefb6409c1aULL,  774,  252 }, { 0xd01fef10a657842cULL,  800,  260 }, { 0x9b10a4e5e9913129ULL,  827,  268 },
+            { 0xe7109bfba19c0c9dULL,  853,  276 }, { 0xac2820d9623bf429ULL,  880,  284 }, { 0x80444b5e7aa7cf85ULL,  907,  292 },
+            { 0xbf21e44003acdd2dULL,  933,  300 }, { 0x8e679c2f5e44ff8fULL,  960,  308 }, { 0xd433179d9c8cb841ULL,  986,  316 },
+            { 0x9e19db92b4e31ba9ULL, 1013,  324 }, { 0xeb96bf6ebadf77d9ULL, 1039,  332 }, { 0xaf87023b9bf0ee6bULL, 1066,  340 },
+        };
+        return stPowers;
+    }
+
+    // Mul64() -- Full 64x64 -> 128-bit product.  Returns the low 64 bits.
+    //
+    static unsigned long long Mul64(unsigned long long ullA,unsigned long long ullB,unsigned long long & ullHigh)
+    {
+        unsigned long long ullLL = (ullA & 0xFFFFFFFF)*(ullB & 0xFFFFFFFF);
+        unsigned long long ullLH = (ullA & 0xFFFFFFFF)*(ullB >> 32);
+        unsigned long long ullHL = (ullA >> 32)*(ullB & 0xFFFFFFFF);
+        unsigned long long ullMid = (ullLL >> 32) + (ullLH & 0xFFFFFFFF) + (ullHL & 0xFFFFFFFF);
+        ullHigh = (ullA >> 32)*(ullB >> 32) + (ullLH >> 32) + (ullHL >> 32) + (ullMid >> 32);
+        return (ullMid << 32) | (ullLL & 0xFFFFFFFF);
+    }
+
+    // Multiply() -- Product of two DiyFp_t values, rounded to the upper 64 bits (not normalized)
+    //
+    static DiyFp_t Multiply(DiyFp_t stA,DiyFp_t stB)
+    {
+        unsigned long long ullHigh;
+        unsigned long long ullLow = Mul64(stA.ullF,stB.ullF,ullHigh);
+        return { ullHigh + (ullLow >> 63), stA.iE + stB.iE + 64 };
+    }
+
+    static DiyFp_t Normalize(DiyFp_t stValue)
+    {
+        while (!(stValue.ullF & 0xFFC0000000000000ULL)) { stValue.ullF <<= 10; stValue.iE -= 10; }
+        while (!(stValue.ullF & 0x8000000000000000ULL)) { stValue.ullF <<= 1; stValue.iE--; }
+        return stValue;
+    }
+
+    // RoundWeed() -- Move the last digit towards w while it stays inside the safe interval, and check that the result
+    // is provably the closest shortest text.  All values are in units of the digit's scaled fraction.
+    //
+    static bool RoundWeed(char * sDigits,int iDigits,unsigned long long ullDistHighW,unsigned long long ullUnsafe,
+                          unsigned long long ullRest,unsigned long long ullTenKappa,unsigned long long ullUnit)
+    {
+        unsigned long long ullSmall = ullDistHighW - ullUnit;
+        unsigned long long ullBig   = ullDistHighW + ullUnit;
+
+        while (ullRest < ullSmall && ullUnsafe - ullRest >= ullTenKappa &&
+               (ullRest + ullTenKappa < ullSmall || ullSmall - ullRest >= ullRest + ullTenKappa - ullSmall))
+        {
+            sDigits[iDigits-1]--;
+            ullRest += ullTenKappa;
+        }
+        if (ullRest < ullBig && ullUnsafe - ullRest >= ullTenKappa &&
+            (ullRest + ullTenKappa < ullBig || ullBig - ullRest > ullRest + ullTenKappa - ullBig)) return false;
+
+        return 2*ullUnit <= ullRest && ullRest <= ullUnsafe - 4*ullUnit;
+    }
+
+    // Grisu3() -- Shortest digits of a positive, finite double: fValue = sDigits * 10^iExp10 (sDigits is not
+    // null-terminated, at most 17 digits).  Returns false for the few doubles Grisu3 cannot decide.
+    //
+    static bool Grisu3(double fValue,char * sDigits,int & iDigits,int & iExp10)
+    {
+        unsigned long long ullBits;
+        memcpy(&ullBits,&fValue,sizeof(ullBits));
+        int iBiased = (int) (ullBits >> 52) & 0x7FF;
+        unsigned long long ullFraction = ullBits & kFractionMask;
+        DiyFp_t stV = iBiased ? DiyFp_t{ ullFraction | kHiddenBit, iBiased - 1075 } : DiyFp_t{ ullFraction, -1074 };
+
+        // Boundaries halfway to the neighboring doubles (the one below is closer at a power of two)
+
+        DiyFp_t stPlus  = Normalize({ (stV.ullF << 1) + 1, stV.iE - 1 });
+        DiyFp_t stMinus = !ullFraction && iBiased > 1 ? DiyFp_t{ (stV.ullF << 2) - 1, stV.iE - 2 } : DiyFp_t{ (stV.ullF << 1) - 1, stV.iE - 1 };
+        stMinus.ullF <<= stMinus.iE - stPlus.iE;
+        stMinus.iE = stPlus.iE;
+        DiyFp_t stW = Normalize(stV);
+
+        // A cached power of ten that brings the exponent into [-60,-32], so the integral part fits in 32 bits
+
+        int iMinExponent = -60 - (stW.iE + 64);
+        int iK = (int) ceil((iMinExponent + 63)*0.30102999566398114);
+        const CachedPower_t & stPower = CachedPowers()[(348 + iK - 1)/8 + 1];
+        DiyFp_t stTen = { stPower.ullF, stPower.iBinary };
+
+        DiyFp_t stScaledW   = Multiply(stW,stTen);
+        DiyFp_t stTooLow    = Multiply(stMinus,stTen);
+        DiyFp_t stTooHigh   = Multiply(stPlus,stTen);
+
+        // Generate digits of the upper bound until the rest is inside the unsafe interval
+
+        unsigned long long ullUnit = 1;
+        stTooLow.ullF  -= ullUnit;
+        stTooHigh.ullF += ullUnit;
+        unsigned long long ullUnsafe = stTooHigh.ullF - stTooLow.ullF;
+
+        int iShift = -stScaledW.iE;
+        unsigned long long ullOne = 1ULL << iShift;
+        unsigned int uiIntegrals = (unsigned int) (stTooHigh.ullF >> iShift);
+        unsigned long long ullFractionals = stTooHigh.ullF & (ullOne - 1);
+
+        unsigned int uiDivisor = 1;
+        int iKappa = 1;
+        while (uiDivisor <= uiIntegrals/10) { uiDivisor *= 10; iKappa++; }
+
+        iDigits = 0;
+        while (iKappa > 0)
+        {
+            sDigits[iDigits++] = (char) ('0' + uiIntegrals/uiDivisor);
+            uiIntegrals %= uiDivisor;
+            iKappa--;
+            unsigned long long ullRest = ((unsigned long long) uiIntegrals << iShift) + ullFractionals;
+            if (ullRest < ullUnsafe)
+            {
+                iExp10 = iKappa - stPower.iDecimal;
+                return RoundWeed(sDigits,iDigits,stTooHigh.ullF - stScaledW.ullF,ullUnsafe,ullRest,(unsigned long long) uiDivisor << iShift,ullUnit);
+            }
+            uiDivisor /= 10;
+        }
+        for (;;)
+        {
+            ullFractionals *= 10;
+            ullUnit *= 10;
+            ullUnsafe *= 10;
+            sDigits[iDigits++] = (char) ('0' + (ullFractionals >> iShift));
+            ullFractionals &= ullOne - 1;
+            iKappa--;
+            if (ullFractionals < ullUnsafe)
+            {
+                iExp10 = iKappa - stPower.iDecimal;
+                return RoundWeed(sDigits,iDigits,(stTooHigh.ullF - stScaledW.ullF)*ullUnit,ullUnsafe,ullFractionals,ullOne,ullUnit);
+            }
+        }
+    }
+
+    // SearchDigits() -- The Grisu3 fallback: the first of %.15e, %.16e and %.17e that reads back as fValue (starting
+    // at one digit for subnormals, whose rounding interval can hold several 15-digit values)
+    //
+    static void SearchDigits(double fValue,char * sDigits,int & iDigits,int & iExp10)
+    {
+        char sText[kMaxText];
+        int iPrecision = fValue < DBL_MIN ? 1 : 15;
+        for (;iPrecision<17;iPrecision++)
+        {
+            snprintf(sText,sizeof(sText),"%.*e",iPrecision-1,fValue);
+            if (strtod(sText,nullptr) == fValue) break;
+        }
+        if (iPrecision == 17) snprintf(sText,sizeof(sText),"%.16e",fValue);
+
+        iDigits = 0;
+        const char * s = sText;
+        for (;*s != 'e';s++) if (*s != '.') sDigits[iDigits++] = *s;
+        int iExponent = atoi(s+1);
+        while (iDigits > 1 && sDigits[iDigits-1] == '0') iDigits--;
+        iExp10 = iExponent - (iDigits-1);
+    }
+
+    // WriteExponent() -- "e+05", "e-123"
+    //
+    static char * WriteExponent(char * s,int iExponent,char cE)
+    {
+        *s++ = cE;
+        *s++ = iExponent < 0 ? '-' : '+';
+        if (iExponent < 0) iExponent = -iExponent;
+        if (iExponent >= 100) { *s++ = (char) ('0' + iExponent/100); iExponent %= 100; }
+        *s++ = DigitPairs()[iExponent*2];
+        *s++ = DigitPairs()[iExponent*2+1];
+        return s;
+    }
+
+    // WriteInteger() -- Exact decimal digits of a double from 2^53 to 2^96 (always an integer).  Returns the length.
+    //
+    static int WriteInteger(char * sOut,double fValue)
+    {
+        unsigned long long ullBits;
+        memcpy(&ullBits,&fValue,sizeof(ullBits));
+        int iE2 = (int) ((ullBits >> 52) & 0x7FF) - 1075;
+        unsigned long long ullM = (ullBits & kFractionMask) | kHiddenBit;
+
+        // 96-bit value in 32-bit limbs (most significant first), divided down by 10^9
+
+        unsigned long long ullLow = ullM << iE2;
+        unsigned int uiLimbs[3] = { (unsigned int) (ullM >> (64 - iE2)), (unsigned int) (ullLow >> 32), (unsigned int) ullLow };
+        unsigned int uiChunks[4];
+        int iChunks = 0;
+        while (uiLimbs[0] || uiLimbs[1] || uiLimbs[2])
+        {
+            unsigned long long ullRest = 0;
+            for (auto & uiLimb : uiLimbs)
+            {
+                unsigned long long ullCurrent = (ullRest << 32) | uiLimb;
+                uiLimb = (unsigned int) (ullCurrent/1000000000);
+                ullRest = ullCurrent % 1000000000;
+            }
+            uiChunks[iChunks++] = (unsigned int) ullRest;
+        }
+
+        int iLength = UIntToText(sOut,uiChunks[--iChunks]);
+        while (iChunks--)
+        {
+            char sChunk[24];
+            UIntToText(sChunk,1000000000ULL + uiChunks[iChunks]);
+            memcpy(sOut+iLength,sChunk+1,9);
+            iLength += 9;
+        }
+        return iLength;
+    }
+
+    // WriteShortest() -- Lay out sDigits * 10^iExp10 (the shortest digits of fValue) as std::to_chars() does: fixed
+    // or scientific, whichever is shorter (fixed on a tie).  Returns the length.
+    //
+    static int WriteShortest(char * sOut,double fValue,const char * sDigits,int iDigits,int iExp10)
+    {
+        char * s = sOut;
+        if (std::signbit(fValue)) *s++ = '-';
+
+        int iPoint      = iDigits + iExp10;         // Digits before the decimal point
+        int iExponent   = iPoint - 1;
+        int iSciLength  = iDigits + (iDigits > 1) + (iExponent >= 100 || iExponent <= -100 ? 5 : 4);
+        int iFixLength  = iPoint >= iDigits ? iPoint : iPoint > 0 ? iDigits + 1 : iDigits - iPoint + 2;
+
+        if (iFixLength <= iSciLength)
+        {
+            // std::to_chars() writes the exact value of an integer above 2^53 rather than the digits padded with zeros
+
+            if (iPoint > iDigits && fabs(fValue) >= 9007199254740992.0) s += WriteInteger(s,fabs(fValue));
+            else if (iPoint >= iDigits)
+            {
+                memcpy(s,sDigits,iDigits);
+                memset(s+iDigits,'0',iPoint-iDigits);
+                s += iPoint;
+            }
+            else if (iPoint > 0)
+            {
+                memcpy(s,sDigits,iPoint);
+                s[iPoint] = '.';
+                memcpy(s+iPoint+1,sDigits+iPoint,iDigits-iPoint);
+                s += iDigits + 1;
+            }
+            else
+            {
+                *s++ = '0';
+                *s++ = '.';
+                memset(s,'0',-iPoint);
+                memcpy(s-iPoint,sDigits,iDigits);
+                s += iDigits - iPoint;
+            }
+        }
+        else
+        {
+            *s++ = sDigits[0];
+            if (iDigits > 1)
+            {
+                *s++ = '.';
+                memcpy(s,sDigits+1,iDigits-1);
+                s += iDigits-1;
+            }
+            s = WriteExponent(s,iExponent,'e');
+        }
+        *s = 0;
+        return (int) (s-sOut);
+    }
+
+    static const unsigned long long * PowersOfTen()
+    {
+        static constexpr unsigned long long ullPowers[] =
+        {
+            1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL,
+            10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+            10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL,
+        };
+        return ullPowers;
+    }
+
+    // FormatFixed() -- "%.Nf": fValue * 10^N rounded (to even on an exact tie, as the CRT does) with 128-bit integers.
+    // Returns -1 (use snprintf()) above 17 decimals or when the scaled value does not fit in 64 bits.
+    //
+    static int FormatFixed(char * sOut,double fValue,int iPrecision)
+    {
+        if (iPrecision > 17) return -1;
+
+        unsigned long long ullBits;
+        memcpy(&ullBits,&fValue,sizeof(ullBits));
+        int iBiased = (int) (ullBits >> 52) & 0x7FF;
+        unsigned long long ullM = iBiased ? (ullBits & kFractionMask) | kHiddenBit : ullBits & kFractionMask;
+        int iE2 = iBiased ? iBiased - 1075 : -1074;
+
+        unsigned long long ullHigh;
+        unsigned long long ullLow = Mul64(ullM,PowersOfTen()[iPrecision],ullHigh);
+        unsigned long long ullQ = 0;            // Stays 0 for zero and values below 2^-128
+
+        if (iE2 >= 0)
+        {
+            if (ullHigh || iE2 > 11 || ullLow > (~0ULL >> iE2)) return -1;
+            ullQ = ullLow << iE2;
+        }
+        else if (-iE2 < 128)
+        {
+            // Quotient and remainder of the 128-bit product divided by 2^iShift, compared with half the divisor
+
+            int iShift = -iE2;
+            bool bAbove,bHalf;
+            if (iShift < 64)
+            {
+                if (ullHigh >> iShift) return -1;
+                ullQ = (ullLow >> iShift) | (ullHigh << (64 - iShift));
+                unsigned long long ullRest = ullLow & ((1ULL << iShift) - 1);
+                unsigned long long ullHalfWay = 1ULL << (iShift - 1);
+                bAbove = ullRest > ullHalfWay;
+                bHalf = ullRest == ullHalfWay;
+            }
+            else if (iShift == 64)
+            {
+                ullQ = ullHigh;
+                bAbove = ullLow > 0x8000000000000000ULL;
+                bHalf = ullLow == 0x8000000000000000ULL;
+            }
+            else
+            {
+                ullQ = ullHigh >> (iShift - 64);
+                unsigned long long ullRest = ullHigh & ((1ULL << (iShift - 64)) - 1);
+                unsigned long long ullHalfWay = 1ULL << (iShift - 65);
+                bAbove = ullRest > ullHalfWay || (ullRest == ullHalfWay && ullLow);
+                bHalf = ullRest == ullHalfWay && !ullLow;
+            }
+            if (bAbove || (bHalf && (ullQ & 1)))
+            {
+                if (ullQ == ~0ULL) return -1;
+                ullQ++;
+            }
+        }
+
+        char sNumber[24];
+        int iLength = UIntToText(sNumber,ullQ);
+        char * s = sOut;
+        if (ullBits >> 63) *s++ = '-';
+
+        if (!iPrecision)
+        {
+            memcpy(s,sNumber,iLength);
+            s += iLength;
+        }
+        else if (iLength <= iPrecision)
+        {
+            *s++ = '0';
+            *s++ = '.';
+            memset(s,'0',iPrecision - iLength);
+            memcpy(s + iPrecision - iLength,sNumber,iLength);
+            s += iPrecision;
+        }
+        else
+        {
+            int iInteger = iLength - iPrecision;
+            memcpy(s,sNumber,iInteger);
+            s[iInteger] = '.';
+            memcpy(s+iInteger+1,sNumber+iInteger,iPrecision);
+            s += iLength + 1;
+        }
+        *s = 0;
+        return (int) (s-sOut);
+    }
+
+    // FormatDigits() -- "%.Ne" and "%.Ng" from the shortest digits.  With at most 15 significant digits there is only
+    // one N-digit value inside a normal double's rounding interval, so shortest digits no longer than N are the
+    // rounded result, and rounding shortest digits 2 or more digits longer than N rounds the same way as the double.
+    // Returns -1 (use snprintf()) otherwise.
+    //
+    static int FormatDigits(char * sOut,double fValue,const FloatStyle_t & stStyle)
+    {
+        int iSignificant = stStyle.cConv == 'e' ? stStyle.iPrecision + 1 : stStyle.iPrecision ? stStyle.iPrecision : 1;
+        if (iSignificant > 15) return -1;
+
+        char sDigits[kMaxText];
+        int iDigits = 1,iExponent = 0;
+        double fAbs = fabs(fValue);
+
+        if (fAbs == 0) sDigits[0] = '0';
+        else
+        {
+            int iExp10;
+            if (fAbs < DBL_MIN || !Grisu3(fAbs,sDigits,iDigits,iExp10)) return -1;
+            iExponent = iDigits + iExp10 - 1;
+
+            if (iDigits > iSignificant)
+            {
+                if (iDigits == iSignificant + 1) return -1;
+                bool bRoundUp = sDigits[iSignificant] >= '5';
+                iDigits = iSignificant;
+                if (bRoundUp)
+                {
+                    while (iDigits && sDigits[iDigits-1] == '9') iDigits--;
+                    if (!iDigits) { sDigits[0] = '1'; iDigits = 1; iExponent++; }
+                    else sDigits[iDigits-1]++;
+                }
+            }
+            while (iDigits > 1 && sDigits[iDigits-1] == '0') iDigits--;
+        }
+
+        char cE = stStyle.bUpper ? 'E' : 'e';
+        char * s = sOut;
+        if (std::signbit(fValue)) *s++ = '-';
+
+        if (stStyle.cConv == 'g' && iExponent < iSignificant && iExponent >= -4)
+        {
+            if (iExponent >= 0)
+            {
+                int iInteger = iExponent + 1;
+                int iCopy = iDigits < iInteger ? iDigits : iInteger;
+                memcpy(s,sDigits,iCopy);
+                memset(s+iCopy,'0',iInteger-iCopy);
+                s += iInteger;
+                if (iDigits > iInteger)
+                {
+                    *s++ = '.';
+                    memcpy(s,sDigits+iInteger,iDigits-iInteger);
+                    s += iDigits-iInteger;
+                }
+            }
+            else
+            {
+                *s++ = '0';
+                *s++ = '.';
+                memset(s,'0',-iExponent-1);
+                memcpy(s-iExponent-1,sDigits,iDigits);
+                s += iDigits - iExponent - 1;
+            }
+        }
+        else
+        {
+            // %e keeps the trailing zeros of its precision, %g drops them
+
+            int iFraction = stStyle.cConv == 'e' ? stStyle.iPrecision : iDigits - 1;
+            *s++ = sDigits[0];
+            if (iFraction)
+            {
+                *s++ = '.';
+                memcpy(s,sDigits+1,iDigits-1);
+                memset(s+iDigits-1,'0',iFraction-(iDigits-1));
+                s += iFraction;
+            }
+            s = WriteExponent(s,iExponent,cE);
+        }
+        *s = 0;
+        return (int) (s-sOut);
+    }
+
+    // ParseDecimal() -- Read a decimal number without strtod().  Returns false when strtod() is needed (see the
+    // notes at the top), in which case fValue and sStop are not changed.
+    //
+    static bool ParseDecimal(const char * s,double & fValue,const char *& sStop)
+    {
+        bool bNegative = *s == '-';
+        if (bNegative) s++;
+        if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) return false;
+
+        unsigned long long ullDigits = 0;
+        int iKept       = 0;            // Significant digits in ullDigits (at most 19)
+        int iExp10      = 0;
+        bool bAnyDigit  = false;
+        bool bPoint     = false;
+        bool bInexact   = false;        // Nonzero digits were dropped after the 19th
+        char cDropped   = 0;            // First dropped digit
+
+        for (;;s++)
+        {
+            if (*s >= '0' && *s <= '9')
+            {
+                bAnyDigit = true;
+                if (!iKept && *s == '0') { if (bPoint) iExp10--; continue; }
+                if (iKept < 19)
+                {
+                    ullDigits = ullDigits*10 + (*s - '0');
+                    iKept++;
+                    if (bPoint) iExp10--;
+                }
+                else
+                {
+                    if (!cDropped) cDropped = *s;
+                    bInexact |= *s != '0';
+                    if (!bPoint) iExp10++;
+                }
+            }
+            else if (*s == '.' && !bPoint) bPoint = true;
+            else break;
+        }
+        if (!bAnyDigit) return false;
+
+        if (*s == 'e' || *s == 'E')
+        {
+            const char * sExp = s+1;
+            bool bNegExp = *sExp == '-';
+            if (*sExp == '-' || *sExp == '+') sExp++;
+            if (*sExp >= '0' && *sExp <= '9')
+            {
+                int iExponent = 0;
+                for (;*sExp >= '0' && *sExp <= '9';sExp++) if (iExponent < 100000) iExponent = iExponent*10 + (*sExp - '0');
+                iExp10 += bNegExp ? -iExponent : iExponent;
+                s = sExp;
+            }
+        }
+
+        if (!ullDigits)
+        {
+            fValue = bNegative ? -0.0 : 0.0;
+            sStop = s;
+            return true;
+        }
+
+        // Clinger: both the digits and the power of ten are exact doubles, so one multiply or divide rounds correctly
+
+        if (!bInexact && ullDigits <= (1ULL << 53) && iExp10 >= -22 && iExp10 <= 22)
+        {
+            static constexpr double fPowers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+            double fRead = (double) ullDigits;
+            fRead = iExp10 < 0 ? fRead/fPowers[-iExp10] : fRead*fPowers[iExp10];
+            fValue = bNegative ? -fRead : fRead;
+            sStop = s;
+            return true;
+        }
+        if (iExp10 < -348 || iExp10 > 340) return false;
+
+        // Scale by a cached power of ten, keeping the error in 1/8ths of the last bit of the 64-bit significand
+
+        if (bInexact && cDropped >= '5') ullDigits++;
+        unsigned long long ullError = bInexact ? 4 : 0;
+
+        DiyFp_t stValue = Normalize({ ullDigits, 0 });
+        ullError <<= -stValue.iE;
+
+        const CachedPower_t & stPower = CachedPowers()[(iExp10 + 348)/8];
+        int iAdjust = iExp10 - stPower.iDecimal;
+        if (iAdjust)
+        {
+            // 10^1 to 10^7 are exact; the product is exact if it still fits in 19 digits
+
+            DiyFp_t stAdjust = Normalize({ PowersOfTen()[iAdjust], 0 });
+            stValue = Multiply(stValue,stAdjust);
+            if (19 - iKept < iAdjust) ullError += 4;
+        }
+        stValue = Multiply(stValue,{ stPower.ullF, stPower.iBinary });
+        ullError += 4 + (ullError ? 1 : 0) + 4;
+
+        int iOldE = stValue.iE;
+        stValue = Normalize(stValue);
+        ullError <<= iOldE - stValue.iE;
+
+        // Round the 64-bit significand to 53 bits, unless the error could put it on the other side of halfway
+
+        int iBiased = stValue.iE + 1086;
+        if (iBiased < 1 || iBiased > 2046) return false;
+
+        unsigned long long ullLowBits = (stValue.ullF & 0x7FF)*8;
+        unsigned long long ullHalfWay = 0x400*8;
+        if (ullError >= ullHalfWay || (ullHalfWay - ullError < ullLowBits && ullLowBits < ullHalfWay + ullError)) return false;
+
+        unsigned long long ullSignificand = stValue.ullF >> 11;
+        if (ullLowBits >= ullHalfWay + ullError && ++ullSignificand == (1ULL << 53))
+        {
+            ullSignificand >>= 1;
+            if (++iBiased > 2046) return false;
+        }
+
+        unsigned long long ullBits = ((unsigned long long) iBiased << 52) | (ullSignificand & kFractionMask) | (bNegative ? 1ULL << 63 : 0);
+        memcpy(&fValue,&ullBits,sizeof(fValue));
+        sStop = s;
+        return true;
+    }
+
+    static int DigitValue(char c)
+    {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return 99;
+    }
+
+public:
+    // UIntToText() -- Write ullValue to sOut (null-terminated).  Returns the length.  sOut needs 21 characters.
+    //
+    static int UIntToText(char * sOut,unsigned long long ullValue)
+    {
+        int iLength = CountDigits(ullValue);
+        char * sEnd = sOut + iLength;
+        *sEnd = 0;
+
+        const char * sPairs = DigitPairs();
+        while (ullValue >= 100)
+        {
+            int iPair = (int) (ullValue % 100)*2;
+            ullValue /= 100;
+            *--sEnd = sPairs[iPair+1];
+            *--sEnd = sPairs[iPair];
+        }
+        if (ullValue >= 10)
+        {
+            *--sEnd = sPairs[ullValue*2+1];
+            *--sEnd = sPairs[ullValue*2];
+        }
+        else *--sEnd = (char) ('0' + ullValue);
+        return iLength;
+    }
+
+    // IntToText() -- Write llValue to sOut (null-terminated).  Returns the length.  sOut needs 21 characters.
+    //
+    static int IntToText(char * sOut,long long llValue)
+    {
+        if (llValue >= 0) return UIntToText(sOut,(unsigned long long) llValue);
+        *sOut = '-';
+        return UIntToText(sOut+1,0ULL - (unsigned long long) llValue) + 1;
+    }
+
+    // Shortest() -- Write the shortest text that reads back as exactly fValue.  Returns the length.
+    // sOut needs kMaxText characters.
+    //
+    static int Shortest(char * sOut,double fValue)
+    {
+#if defined(_CNumFormat_CharConv_)
+        auto stResult = std::to_chars(sOut,sOut+kMaxText-1,fValue);
+        *stResult.ptr = 0;
+        return (int) (stResult.ptr-sOut);
+#else
+        if (!std::isfinite(fValue))
+        {
+            bool bNegative = std::signbit(fValue);
+            const char * sText = std::isnan(fValue) ? (bNegative ? "-nan" : "nan") : (bNegative ? "-inf" : "inf");
+            strcpy(sOut,sText);
+            return (int) strlen(sText);
+        }
+
+        char sDigits[kMaxText] = { '0' };
+        int iDigits = 1,iExp10 = 0;
+        double fAbs = fabs(fValue);
+        if (fAbs != 0 && !Grisu3(fAbs,sDigits,iDigits,iExp10)) SearchDigits(fAbs,sDigits,iDigits,iExp10);
+
+        return WriteShortest(sOut,fValue,sDigits,iDigits,iExp10);
+#endif
+    }
+
+    // Format() -- Write fValue with a CString float style (i.e. "%g", "%.3f").  nullptr uses "%g", the CString default.
+    // Returns the length.  sOut needs kMaxFormatText characters.
+    //
+    static int Format(char * sOut,double fValue,const char * sStyle = nullptr)
+    {
+        if (!sStyle) sStyle = "%g";
+        FloatStyle_t stStyle = ParseStyle(sStyle);
+#if defined(_CNumFormat_CharConv_)
+        std::chars_format eFormat = stStyle.cConv == 'f' ? std::chars_format::fixed : stStyle.cConv == 'e' ? std::chars_format::scientific : std::chars_format::general;
+
+        auto stResult = std::to_chars_result{ sOut, std::errc::value_too_large };
+        if (stStyle.bDirect) stResult = std::to_chars(sOut,sOut+kMaxFormatText-1,fValue,eFormat,stStyle.iPrecision);
+
+        if (stResult.ec == std::errc())
+        {
+            *stResult.ptr = 0;
+            int iLength = (int) (stResult.ptr-sOut);
+
+            if (stStyle.bUpper)
+                for (int i=0;i<iLength;i++) if (sOut[i] >= 'a' && sOut[i] <= 'z') sOut[i] -= 'a'-'A';
+            return iLength;
+        }
+#else
+        // inf and nan are left to snprintf(), which spells them the way the CRT does
+
+        if (stStyle.bDirect && std::isfinite(fValue))
+        {
+            int iLength = stStyle.cConv == 'f' ? FormatFixed(sOut,fValue,stStyle.iPrecision) : FormatDigits(sOut,fValue,stStyle);
+            if (iLength >= 0) return iLength;
+        }
+#endif
+        int iLength = snprintf(sOut,kMaxFormatText,sStyle,fValue);
+        return iLength < 0 ? 0 : iLength >= kMaxFormatText ? kMaxFormatText-1 : iLength;
+    }
+
+    // Text() -- Return a number as a NumText_t.  The double version with no style gives the shortest round-trip text.
+    //
+    static NumText_t Text(long long llValue)            { NumText_t stText; stText.iLength = IntToText(stText.sText,llValue); return stText; }
+    static NumText_t Text(int iValue)                   { return Text((long long) iValue); }
+    static NumText_t Text(unsigned int uiValue)         { return Text((long long) uiValue); }
+    static NumText_t Text(unsigned long long ullValue)  { NumText_t stText; stText.iLength = UIntToText(stText.sText,ullValue); return stText; }
+    static NumText_t Text(double fValue)                { NumText_t stText; stText.iLength = Shortest(stText.sText,fValue); return stText; }
+    static NumText_t Text(double fValue,const char * sStyle)
+    {
+        NumText_t stText;
+        stText.iLength = Format(stText.sText,fValue,sStyle);
+        return stText;
+    }
+
+    // ParseDouble() -- Read a double, skipping leading whitespace and accepting a leading '+'.
+    //
+    // Returns false (and leaves fValue unchanged) if no number was found.  sEnd (optional) is set to the character after the number.
+    //
+    static bool ParseDouble(const char * sText,double & fValue,const char ** sEnd = nullptr)
+    {
+        if (!sText) return false;
+        const char * s = sText;
+        while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') s++;
+        if (*s == '+' && s[1] != '-') s++;
+
+#if !defined(_CNumFormat_CharConv_)
+        // strtod() also reads hexadecimal floats, which from_chars() (and so ParseDouble() with C++17) does not
+
+        double fRead = 0;
+        const char * sStop = s;
+        if (!ParseDecimal(s,fRead,sStop))
+        {
+            char * sStrtod;
+            fRead = strtod(s,&sStrtod);
+            sStop = sStrtod;
+        }
+        if (sStop == s) return false;
+        fValue = fRead;
+        if (sEnd) *sEnd = sStop;
+        return true;
+#else
+        auto stResult = std::from_chars(s,s+strlen(s),fValue);
+        if (stResult.ec == std::errc::invalid_argument) return false;
+
+        // Out-of-range values are set to +/-HUGE_VAL or 0 (as with strtod())
+
+        if (stResult.ec == std::errc::result_out_of_range)
+        {
+            const char * sScan = s;
+            bool bNegative = *sScan == '-';
+            if (bNegative) sScan++;
+            while ((*sScan >= '0' && *sScan <= '9') || *sScan == '.') sScan++;
+            bool bSmall = (*sScan == 'e' || *sScan == 'E') && sScan[1] == '-';
+            fValue = bSmall ? 0 : (bNegative ? -HUGE_VAL : HUGE_VAL);
+        }
+        if (sEnd) *sEnd = stResult.ptr;
+        return true;
+#endif
+    }
+
+    // ParseInt() -- Read an integer, skipping leading whitespace and accepting a leading '+', and "0x" for hexadecimal.
+    //
+    // Returns false (and leaves llValue unchanged) if no number was found or it is out of range.
+    //
+    static bool ParseInt(const char * sText,long long & llValue,const char ** sEnd = nullptr)
+    {
+        if (!sText) return false;
+        const char * s = sText;
+        while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r') s++;
+
+        bool bNegative = *s == '-';
+        if (*s == '-' || *s == '+') s++;
+
+        int iBase = 10;
+        if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) { iBase = 16; s += 2; }
+
+        unsigned long long ullLimit = bNegative ? 0x8000000000000000ULL : 0x7FFFFFFFFFFFFFFFULL;
+        unsigned long long ullValue = 0;
+        const char * sStart = s;
+        for (int iDigit;(iDigit = DigitValue(*s)) < iBase;s++)
+        {
+            if (ullValue > (ullLimit - iDigit)/iBase) return false;
+            ullValue = ullValue*iBase + iDigit;
+        }
+        if (s == sStart) return false;
+
+        llValue = bNegative ? (long long) (0ULL - ullValue) : (long long) ullValue;
+        if (sEnd) *sEnd = s;
+        return true;
+    }
+
+    static bool ParseInt(const char * sText,int & iValue,const char ** sEnd = nullptr)
+    {
+        long long llValue;
+        if (!ParseInt(sText,llValue,sEnd) || llValue < -2147483647LL-1 || llValue > 2147483647LL) return false;
+        iValue = (int) llValue;
+        return true;
+    }
+};
+
+}; // namespace Sage
+#endif // _CNumFormat_H_
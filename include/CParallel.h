@@ -0,0 +1,74 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CParallel -- Simple row-band threading used by the image processing functions.
+//
+// ForBands() splits a range of rows (or any range of items) into contiguous bands and runs each band on its own thread,
+// with the last band running on the calling thread.  Small ranges run entirely on the calling thread.
+//
+// Example:
+//
+//      CParallel::ForBands(stBitmap.iHeight,[&](int iY1,int iY2,int iBand)
+//      {
+//          for (int iY=iY1;iY<iY2;iY++) ... process row iY ...
+//      });
+//
+#if !defined(_CParallel_H_)
+#define _CParallel_H_
+
+#include <thread>
+#include <vector>
+
+namespace Sage
+{
+
+class CParallel
+{
+public:
+    static constexpr int kDefaultMinItems = 64;     // Minimum rows (items) per band before using another thread
+
+    // GetNumBands() -- Number of bands ForBands() will use for iItems items.
+    //
+    // iMaxThreads = 0 uses the number of hardware threads.
+    //
+    static int GetNumBands(int iItems,int iMinItems = kDefaultMinItems,int iMaxThreads = 0)
+    {
+        int iThreads = iMaxThreads > 0 ? iMaxThreads : (int) std::thread::hardware_concurrency();
+        if (iMinItems < 1) iMinItems = 1;
+        int iMax = iItems/iMinItems;
+        if (iThreads > iMax) iThreads = iMax;
+        return iThreads < 1 ? 1 : iThreads;
+    }
+
+    // ForBands() -- Run fnBand(iStart,iEnd,iBand) over [0,iItems) split into bands.
+    //
+    // Returns the number of bands used (which can be used to size per-band data beforehand via GetNumBands() with
+    // the same parameters).
+    //
+    template <typename _fn>
+    static int ForBands(int iItems,_fn && fnBand,int iMinItems = kDefaultMinItems,int iMaxThreads = 0)
+    {
+        if (iItems <= 0) return 0;
+        int iBands = GetNumBands(iItems,iMinItems,iMaxThreads);
+
+        if (iBands == 1)
+        {
+            fnBand(0,iItems,0);
+            return 1;
+        }
+
+        std::vector<std::thread> vThreads;
+        vThreads.reserve(iBands-1);
+
+        for (int i=0;i<iBands-1;i++)
+            vThreads.emplace_back([&fnBand,i,iItems,iBands]() { fnBand((int) ((long long) iItems*i/iBands),(int) ((long long) iItems*(i+1)/iBands),i); });
+
+        fnBand((int) ((long long) iItems*(iBands-1)/iBands),iItems,iBands-1);
+
+        for (auto & t : vThreads) t.join();
+        return iBands;
+    }
+};
+
+}; // namespace Sage
+#endif // _CParallel_H_
@@ -0,0 +1,320 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CPgrArchive -- Indexed PGR archive format ("PGRI"), written by CPgrBuilder and read by CPgrReader.
+//
+// An indexed PGR holds files by name, laid out so the archive can be memory-mapped and read in place:
+//
+//      PgrArchiveHeader_t                  64 bytes
+//      PgrArchiveEntry_t[uiNumEntries]     Sorted by name (case-insensitive)
+//      Names                               Entry names, each null-terminated
+//      File data                           Each stored file starts on a uiAlignment boundary (64 bytes by default)
+//
+// Files with the same contents are stored once (entries share ullOffset).  Files may be stored as-is (the bytes can be
+// used directly from the mapped archive) or LZ4-compressed (LZ4 block format, decompressed on read).
+//
+// All values are little-endian.  ullTableHash covers the entry table and names so a damaged index is caught on open.
+//
+// CPgrArchive also holds the pieces shared by the builder and reader: Hash64() (used for deduplication and the
+// table hash) and the LZ4 block compressor and decompressor.
+//
+#if !defined(_CPgrArchive_H_)
+#define _CPgrArchive_H_
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace Sage
+{
+
+struct PgrArchiveHeader_t
+{
+    char                sMagic[4];          // "PGRI"
+    unsigned int        uiVersion;
+    unsigned int        uiNumEntries;
+    unsigned int        uiAlignment;
+    unsigned long long  ullEntriesOffset;
+    unsigned long long  ullNamesOffset;
+    unsigned long long  ullNamesSize;
+    unsigned long long  ullFileSize;
+    unsigned long long  ullTableHash;       // Hash64() of the entry table followed by the names
+    unsigned long long  ullReserved;
+};
+
+struct PgrArchiveEntry_t
+{
+    unsigned long long  ullOffset;          // Offset of the stored data in the archive
+    unsigned long long  ullStoredSize;      // Size as stored (compressed size for LZ4)
+    unsigned long long  ullSize;            // Size of the file
+    unsigned long long  ullHash;            // Hash64() of the file (uncompressed)
+    unsigned int        uiNameOffset;       // Offset of the name in the name table
+    unsigned int        uiNameLength;
+    unsigned int        uiCompression;      // CPgrArchive::Compression
+    unsigned int        uiReserved;
+};
+
+static_assert(sizeof(PgrArchiveHeader_t) == 64,"PgrArchiveHeader_t must be 64 bytes");
+static_assert(sizeof(PgrArchiveEntry_t) == 48,"PgrArchiveEntry_t must be 48 bytes");
+
+class CPgrArchive
+{
+public:
+    static constexpr unsigned int kVersion          = 1;
+    static constexpr unsigned int kDefaultAlignment = 64;
+
+    enum Compression : unsigned int
+    {
+        None    = 0,
+        LZ4     = 1,
+    };
+
+private:
+    static unsigned long long Read64(const unsigned char * p) { unsigned long long ullValue; memcpy(&ullValue,p,8); return ullValue; }
+    static unsigned int Read32(const unsigned char * p) { unsigned int uiValue; memcpy(&uiValue,p,4); return uiValue; }
+
+    static unsigned long long Mix(unsigned long long ullValue)
+    {
+        ullValue ^= ullValue >> 33; ullValue *= 0xFF51AFD7ED558CCDULL;
+        ullValue ^= ullValue >> 33; ullValue *= 0xC4CEB9FE1A85EC53ULL;
+        ullValue ^= ullValue >> 33;
+        return ullValue;
+    }
+
+    static constexpr int kMinMatch      = 4;
+    static constexpr int kLastLiterals  = 5;        // LZ4: the last 5 bytes are always literals
+    static constexpr int kMatchLimit    = 12;       // LZ4: the last match must start at least 12 bytes before the end
+    static constexpr int kHashBits      = 16;
+
+    static void WriteLength(unsigned char * & pOut,size_t szLength)
+    {
+        while (szLength >= 255) { *pOut++ = 255; szLength -= 255; }
+        *pOut++ = (unsigned char) szLength;
+    }
+
+public:
+    static bool isArchive(const void * pData,size_t szSize)
+    {
+        return pData && szSize >= sizeof(PgrArchiveHeader_t) && !memcmp(pData,"PGRI",4);
+    }
+
+    // Hash64() -- 64-bit hash of a block of memory (8 bytes per step, with a final avalanche).
+    //
+    static unsigned long long Hash64(const void * pData,size_t szSize,unsigned long long ullSeed = 0)
+    {
+        auto p = (const unsigned char *) pData;
+        unsigned long long ullHash = ullSeed ^ (szSize*0x9E3779B97F4A7C15ULL);
+
+        size_t i = 0;
+        for (;i+32<=szSize;i+=32)
+        {
+            ullHash = (ullHash ^ Mix(Read64(p+i)))*0x9E3779B97F4A7C15ULL;
+            ullHash = (ullHash ^ Mix(Read64(p+i+8)))*0xBF58476D1CE4E5B9ULL;
+            ullHash = (ullHash ^ Mix(Read64(p+i+16)))*0x94D049BB133111EBULL;
+            ullHash = (ullHash ^ Mix(Read64(p+i+24)))*0x9E3779B97F4A7C15ULL;
+        }
+        for (;i+8<=szSize;i+=8) ullHash = (ullHash ^ Mix(Read64(p+i)))*0x9E3779B97F4A7C15ULL;
+
+        unsigned long long ullTail = 0;
+        if (i < szSize) memcpy(&ullTail,p+i,szSize-i);
+        return Mix(ullHash ^ Mix(ullTail ^ szSize));
+    }
+
+    // GetMaxCompressedSize() -- Largest size LZ4Compress() can produce for szSize bytes.
+    //
+    static size_t GetMaxCompressedSize(size_t szSize) { return szSize + szSize/255 + 16; }
+
+    // LZ4Compress() -- Compress to the LZ4 block format.  pOut must hold GetMaxCompressedSize(szSize) bytes.
+    // Returns the compressed size.
+    //
+    // This is a single-pass greedy compressor with a 64K-entry hash table (the same approach as LZ4's fast mode).
+    // The output is the same for the same input on every run.
+    //
+    static size_t LZ4Compress(const void * pSource,size_t szSize,void * pOut)
+    {
+        auto pIn        = (const unsigned char *) pSource;
+        auto pDest      = (unsigned char *) pOut;
+        auto pStart     = pDest;
+        size_t szAnchor = 0;
+
+        if (szSize >= kMatchLimit+1)
+        {
+            std::vector<unsigned int> vTable((size_t) 1 << kHashBits,0xFFFFFFFF);
+            auto Hash = [&](size_t szPos) { return (Read32(pIn+szPos)*2654435761u) >> (32-kHashBits); };
+
+            size_t szLimit = szSize - kMatchLimit;
+            size_t szPos = 0;
+            while (szPos < szLimit)
+            {
+                unsigned int uiHash = Hash(szPos);
+                size_t szCandidate = vTable[uiHash];
+                vTable[uiHash] = (unsigned int) szPos;
+
+                if (szCandidate == 0xFFFFFFFF || szPos-szCandidate > 65535 || Read32(pIn+szCandidate) != Read32(pIn+szPos))
+                {
+                    szPos++;
+                    continue;
+                }
+
+                // Extend the match backward over pending literals, then forward (stopping before the last literals)
+
+                while (szPos > szAnchor && szCandidate > 0 && pIn[szPos-1] == pIn[szCandidate-1]) { szPos--; szCandidate--; }
+
+                size_t szMatchEnd = szPos + kMinMatch;
+                size_t szMaxEnd = szSize - kLastLiterals;
+                while (szMatchEnd < szMaxEnd && pIn[szMatchEnd] == pIn[szCandidate + (szMatchEnd-szPos)]) szMatchEnd++;
+
+                size_t szLiterals = szPos - szAnchor;
+                size_t szMatch = szMatchEnd - szPos - kMinMatch;
+
+                unsigned char * pToken = pDest++;
+                *pToken = (unsigned char) (((szLiterals >= 15 ? 15 : szLiterals) << 4) | (szMatch >= 15 ? 15 : szMatch));
+                if (szLiterals >= 15) WriteLength(pDest,szLiterals-15);
+                memcpy(pDest,pIn+szAnchor,szLiterals);
+                pDest += szLiterals;
+
+                unsigned int uiOffset = (unsigned int) (szPos-szCandidate);
+                *pDest++ = (unsigned char) uiOffset;
+                *pDest++ = (unsigned char) (uiOffset >> 8);
+                if (szMatch >= 15) WriteLength(pDest,szMatch-15);
+
+                szPos = szAnchor = szMatchEnd;
+                if (szPos >= 2 && szPos-2 < szLimit) vTable[Hash(szPos-2)] = (unsigned int) (szPos-2);
+            }
+        }
+
+        // Last literals
+
+        size_t szLiterals = szSize - szAnchor;
+        *pDest++ = (unsigned char) ((szLiterals >= 15 ? 15 : szLiterals) << 4);
+        if (szLiterals >= 15) WriteLength(pDest,szLiterals-15);
+        if (szLiterals) memcpy(pDest,pIn+szAnchor,szLiterals);
+        pDest += szLiterals;
+
+        return (size_t) (pDest-pStart);
+    }
+
+    // LZ4Decompress() -- Decompress an LZ4 block into exactly szSize bytes.  Returns false if the data is damaged
+    // (every read and write is bounds-checked).
+    //
+    static bool LZ4Decompress(const void * pSource,size_t szStored,void * pOut,size_t szSize)
+    {
+        auto pIn    = (const unsigned char *) pSource;
+        auto pInEnd = pIn + szStored;
+        auto pDest  = (unsigned char *) pOut;
+        auto pStart = pDest;
+        auto pEnd   = pDest + szSize;
+
+        auto ReadLength = [&](size_t & szLength) -> bool
+        {
+            for (;;)
+            {
+                if (pIn >= pInEnd) return false;
+                unsigned char ucByte = *pIn++;
+                szLength += ucByte;
+                if (ucByte != 255) return true;
+            }
+        };
+
+        while (pIn < pInEnd)
+        {
+            unsigned char ucToken = *pIn++;
+            size_t szLiterals = ucToken >> 4;
+            if (szLiterals == 15 && !ReadLength(szLiterals)) return false;
+            if (szLiterals > (size_t) (pInEnd-pIn) || szLiterals > (size_t) (pEnd-pDest)) return false;
+            if (szLiterals) memcpy(pDest,pIn,szLiterals);
+            pDest += szLiterals;
+            pIn += szLiterals;
+
+            if (pIn == pInEnd) break;       // Last sequence has no match
+
+            if (pInEnd-pIn < 2) return false;
+            size_t szOffset = pIn[0] | (pIn[1] << 8);
+            pIn += 2;
+            if (!szOffset || szOffset > (size_t) (pDest-pStart)) return false;
+
+            size_t szMatch = ucToken & 15;
+            if (szMatch == 15 && !ReadLength(szMatch)) return false;
+            szMatch += kMinMatch;
+            if (szMatch > (size_t) (pEnd-pDest)) return false;
+
+            // Byte copy -- matches may overlap their own output (i.e. run-length repeats)
+
+            const unsigned char * pMatch = pDest - szOffset;
+            if (szOffset >= szMatch) memcpy(pDest,pMatch,szMatch);
+            else for (size_t i=0;i<szMatch;i++) pDest[i] = pMatch[i];
+            pDest += szMatch;
+        }
+        return pDest == pEnd;
+    }
+
+    // GetHeader() -- Check an archive's header and index (bounds and table hash).  Returns nullptr if it is not a valid
+    // indexed PGR.
+    //
+    static const PgrArchiveHeader_t * GetHeader(const void * pData,size_t szSize)
+    {
+        if (!isArchive(pData,szSize)) return nullptr;
+        auto stHeader = (const PgrArchiveHeader_t *) pData;
+        if (stHeader->uiVersion != kVersion || stHeader->ullFileSize != szSize) return nullptr;
+
+        unsigned long long ullEntriesSize = (unsigned long long) stHeader->uiNumEntries*sizeof(PgrArchiveEntry_t);
+        if (stHeader->ullEntriesOffset != sizeof(PgrArchiveHeader_t) ||
+            stHeader->ullNamesOffset != stHeader->ullEntriesOffset + ullEntriesSize ||
+            stHeader->ullNamesSize > szSize || stHeader->ullNamesOffset + stHeader->ullNamesSize > szSize) return nullptr;
+
+        auto pBytes = (const unsigned char *) pData;
+        if (Hash64(pBytes + stHeader->ullEntriesOffset,(size_t) (ullEntriesSize + stHeader->ullNamesSize)) != stHeader->ullTableHash) return nullptr;
+
+        // Check each entry's name and data bounds once here, so readers can use the entries without checking
+
+        auto stEntries = (const PgrArchiveEntry_t *) (pBytes + stHeader->ullEntriesOffset);
+        auto sNames = (const char *) (pBytes + stHeader->ullNamesOffset);
+        for (unsigned int i=0;i<stHeader->uiNumEntries;i++)
+        {
+            auto & stEntry = stEntries[i];
+            if ((unsigned long long) stEntry.uiNameOffset + stEntry.uiNameLength >= stHeader->ullNamesSize) return nullptr;
+            if (sNames[stEntry.uiNameOffset + stEntry.uiNameLength]) return nullptr;
+            if (stEntry.ullOffset > szSize || stEntry.ullStoredSize > szSize - stEntry.ullOffset) return nullptr;
+            if (stEntry.uiCompression == None && stEntry.ullStoredSize != stEntry.ullSize) return nullptr;
+            if (stEntry.uiCompression > LZ4) return nullptr;
+        }
+        return stHeader;
+    }
+
+    static const PgrArchiveEntry_t * GetEntries(const void * pData)
+    {
+        return (const PgrArchiveEntry_t *) ((const unsigned char *) pData + ((const PgrArchiveHeader_t *) pData)->ullEntriesOffset);
+    }
+    static const char * GetName(const void * pData,const PgrArchiveEntry_t & stEntry)
+    {
+        return (const char *) pData + ((const PgrArchiveHeader_t *) pData)->ullNamesOffset + stEntry.uiNameOffset;
+    }
+
+    // Extract() -- Copy (or decompress) an entry into pOut, which must hold stEntry.ullSize bytes.
+    //
+    static bool Extract(const void * pData,const PgrArchiveEntry_t & stEntry,void * pOut)
+    {
+        auto pStored = (const unsigned char *) pData + stEntry.ullOffset;
+        if (stEntry.uiCompression == None) { memcpy(pOut,pStored,(size_t) stEntry.ullSize); return true; }
+        return LZ4Decompress(pStored,(size_t) stEntry.ullStoredSize,pOut,(size_t) stEntry.ullSize);
+    }
+
+    // CompareNames() -- Case-insensitive name order used for the entry table ('\\' and '/' are the same)
+    //
+    static int CompareNames(const char * s1,const char * s2)
+    {
+        for (;;s1++,s2++)
+        {
+            unsigned char c1 = (unsigned char) *s1, c2 = (unsigned char) *s2;
+            if (c1 >= 'A' && c1 <= 'Z') c1 += 'a'-'A';
+            if (c2 >= 'A' && c2 <= 'Z') c2 += 'a'-'A';
+            if (c1 == '\\') c1 = '/';
+            if (c2 == '\\') c2 = '/';
+            if (c1 != c2) return c1 < c2 ? -1 : 1;
+            if (!c1) return 0;
+        }
+    }
+};
+
+}; // namespace Sage
+#endif // _CPgrArchive_H_
@@ -0,0 +1,496 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CPgrBuilder -- Writes indexed PGR archives (see CPgrArchive.h), read with CPgrReader.
+//
+// Files are added by name from disk, from memory, from a directory tree, or from a manifest file, and written with Build():
+//
+//      CPgrBuilder cBuilder;
+//      cBuilder.AddDirectory("Textures");                        // Names are paths relative to the directory, i.e. "Dial/Face.jpg"
+//      cBuilder.AddFile("About.txt","Docs/About.txt");
+//      if (!cBuilder.Build("Resources.pgr")) printf("Error: %s\n",cBuilder.GetError());
+//
+// Build():
+//
+//      1. Reads, hashes and compresses the files in parallel (CParallel).
+//      2. Stores files with the same contents once (matched by Hash64() and then compared byte-for-byte).
+//      3. Keeps LZ4 compression for a file only if it saves at least 1/8 of its size -- already-compressed files
+//         such as JPEGs are stored as-is and can be used in place from a memory-mapped archive.
+//      4. Aligns each stored file to the alignment (64 bytes by default; 4096 puts each file on its own page boundary).
+//
+// The output depends only on the names and contents of the files and the options: entries are sorted by name, files are
+// stored in that order, and nothing time- or thread-dependent is written, so the same input gives the same archive.
+//
+// Manifest files have one file per line, either "name = path" or just "path" (the path is then also the name).
+// Relative paths are relative to the manifest's directory.  Blank lines and lines starting with '#' are ignored.
+//
+#if !defined(_CPgrBuilder_H_)
+#define _CPgrBuilder_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "CPgrArchive.h"
+#include "CParallel.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace Sage
+{
+
+class CPgrBuilder
+{
+public:
+    struct Options_t
+    {
+        unsigned int    uiAlignment     = CPgrArchive::kDefaultAlignment;  // Power of 2, 8 or more
+        bool            bCompress       = true;                             // Try LZ4 on each file
+        int             iMaxThreads     = 0;                                // 0 = number of hardware threads
+    };
+
+    struct Stats_t
+    {
+        int         iEntries;
+        int         iStoredFiles;       // Files stored after deduplication
+        int         iCompressedFiles;
+        long long   llInputBytes;       // Total size of all entries
+        long long   llStoredBytes;      // File data written (after deduplication and compression, without alignment)
+        long long   llArchiveBytes;     // Size of the archive
+    };
+
+private:
+    struct Input_t
+    {
+        std::string                 sName;
+        std::string                 sPath;          // Empty for memory input
+        std::vector<unsigned char>  vData;          // Contents (read during Build() for file input)
+        std::vector<unsigned char>  vCompressed;    // LZ4 data, if smaller
+        unsigned long long          ullHash = 0;
+        bool                        bReadError = false;
+    };
+
+    Options_t               m_stOptions;
+    std::vector<Input_t>    m_vInputs;
+    std::string             m_sError;
+    Stats_t                 m_stStats{};
+
+    // NormalizeName() -- Use '/' as the separator and remove any leading "./" or '/'
+    //
+    static std::string NormalizeName(const std::string & sName)
+    {
+        std::string sOut(sName);
+        std::replace(sOut.begin(),sOut.end(),'\\','/');
+        while (sOut.compare(0,2,"./") == 0) sOut.erase(0,2);
+        while (!sOut.empty() && sOut[0] == '/') sOut.erase(0,1);
+        return sOut;
+    }
+
+    bool SetError(const std::string & sError) { m_sError = sError; return false; }
+
+    static bool ReadWholeFile(const std::string & sPath,std::vector<unsigned char> & vData)
+    {
+        unsigned long long ullSize;
+        if (!GetPathSize(sPath,ullSize) || ullSize > (size_t) -1) return false;
+
+        FILE * fFile = fopen(sPath.c_str(),"rb");
+        if (!fFile) return false;
+        vData.resize((size_t) ullSize);
+        bool bSuccess = !ullSize || fread(vData.data(),1,(size_t) ullSize,fFile) == (size_t) ullSize;
+        fclose(fFile);
+        return bSuccess;
+    }
+
+    // Prepare() -- Read, hash and compress one input (runs on worker threads)
+    //
+    void Prepare(Input_t & stInput)
+    {
+        if (!stInput.sPath.empty() && !ReadWholeFile(stInput.sPath,stInput.vData)) { stInput.bReadError = true; return; }
+        stInput.ullHash = CPgrArchive::Hash64(stInput.vData.data(),stInput.vData.size());
+
+        // LZ4 offsets in CPgrArchive are 32-bit; files of 2GB or more are stored uncompressed
+
+        size_t szSize = stInput.vData.size();
+        if (!m_stOptions.bCompress || szSize < 64 || szSize >= 0x80000000ULL) return;
+
+        stInput.vCompressed.resize(CPgrArchive::GetMaxCompressedSize(szSize));
+        size_t szCompressed = CPgrArchive::LZ4Compress(stInput.vData.data(),szSize,stInput.vCompressed.data());
+        if (szCompressed <= szSize - szSize/8) stInput.vCompressed.resize(szCompressed);
+        else std::vector<unsigned char>().swap(stInput.vCompressed);
+    }
+
+public:
+    CPgrBuilder() { }
+    CPgrBuilder(const Options_t & stOptions) : m_stOptions(stOptions) { }
+
+    void SetOptions(const Options_t & stOptions) { m_stOptions = stOptions; }
+    const char * GetError() { return m_sError.c_str(); }
+    Stats_t GetStats() { return m_stStats; }
+    int GetNumFiles() { return (int) m_vInputs.size(); }
+
+    // AddFile() -- Add a file from disk (read during Build()).
+    //
+    bool AddFile(const char * sName,const char * sPath)
+    {
+        if (!sName || !*sName || !sPath || !*sPath) return SetError("AddFile(): empty name or path");
+        Input_t stInput;
+        stInput.sName = NormalizeName(sName);
+        stInput.sPath = sPath;
+        m_vInputs.push_back(std::move(stInput));
+        return true;
+    }
+
+    // AddMemory() -- Add a file from memory (the data is copied).
+    //
+    bool AddMemory(const char * sName,const void * pData,size_t szSize)
+    {
+        if (!sName || !*sName || (!pData && szSize)) return SetError("AddMemory(): empty name or data");
+        Input_t stInput;
+        stInput.sName = NormalizeName(sName);
+        stInput.vData.assign((const unsigned char *) pData,(const unsigned char *) pData + szSize);
+        m_vInputs.push_back(std::move(stInput));
+        return true;
+    }
+
+    // AddDirectory() -- Add every file under sDirectory.  Names are the paths relative to sDirectory, with sPrefix
+    // (if given) in front, i.e. AddDirectory("Textures","Tex") adds "Textures/Dial/Face.jpg" as "Tex/Dial/Face.jpg".
+    //
+    bool AddDirectory(const char * sDirectory,const char * sPrefix = nullptr)
+    {
+        std::string sRoot(sDirectory ? sDirectory : "");
+        if (!isDirectory(sRoot)) return SetError("AddDirectory(): not a directory: " + sRoot);
+
+        std::vector<std::string> vFiles;
+        if (!ListFiles(sRoot,"",vFiles)) return SetError("AddDirectory(): error reading " + sRoot);
+
+        std::string sBase = sPrefix && *sPrefix ? NormalizeName(sPrefix) + "/" : "";
+        for (auto & sFile : vFiles)
+            if (!AddFile((sBase + sFile).c_str(),JoinPath(sRoot,sFile).c_str())) return false;
+        return true;
+    }
+
+    // AddManifest() -- Add the files listed in a manifest ("name = path" or "path" per line).
+    //
+    bool AddManifest(const char * sManifest)
+    {
+        std::vector<unsigned char> vText;
+        if (!sManifest || !ReadWholeFile(sManifest,vText)) return SetError(std::string("AddManifest(): can't read ") + (sManifest ? sManifest : ""));
+
+        std::string sBaseDir = GetParentDir(sManifest);
+        auto Trim = [](std::string s)
+        {
+            size_t szStart = s.find_first_not_of(" \t\r\n");
+            size_t szEnd = s.find_last_not_of(" \t\r\n");
+            return szStart == std::string::npos ? std::string() : s.substr(szStart,szEnd-szStart+1);
+        };
+
+        std::string sText(vText.begin(),vText.end());
+        int iLine = 0;
+        for (size_t szPos = 0;szPos < sText.size();)
+        {
+            size_t szEnd = sText.find('\n',szPos);
+            if (szEnd == std::string::npos) szEnd = sText.size();
+            std::string sLine = Trim(sText.substr(szPos,szEnd-szPos));
+            szPos = szEnd+1;
+            iLine++;
+            if (sLine.empty() || sLine[0] == '#') continue;
+
+            size_t szEqual = sLine.find('=');
+            std::string sName = Trim(szEqual == std::string::npos ? sLine : sLine.substr(0,szEqual));
+            std::string sPath = Trim(szEqual == std::string::npos ? sLine : sLine.substr(szEqual+1));
+            if (sName.empty() || sPath.empty()) return SetError(std::string(sManifest) + "(" + std::to_string(iLine) + "): expected \"name = path\"");
+
+            if (isRelativePath(sPath)) sPath = JoinPath(sBaseDir,sPath);
+            if (!AddFile(sName.c_str(),sPath.c_str())) return false;
+        }
+        return true;
+    }
+
+    // Build() -- Write the archive to memory.  Returns false (see GetError()) on a read error or a duplicate name.
+    //
+    bool Build(std::vector<unsigned char> & vArchive)
+    {
+        vArchive.clear();
+        m_stStats = {};
+        m_sError.clear();
+
+        unsigned int uiAlign = m_stOptions.uiAlignment;
+        if (uiAlign < 8 || (uiAlign & (uiAlign-1))) return SetError("Build(): alignment must be a power of 2, 8 or more");
+
+        // Sort by name first, so everything after this is in a fixed order
+
+        std::stable_sort(m_vInputs.begin(),m_vInputs.end(),[](const Input_t & i1,const Input_t & i2)
+                        { return CPgrArchive::CompareNames(i1.sName.c_str(),i2.sName.c_str()) < 0; });
+        for (size_t i=1;i<m_vInputs.size();i++)
+            if (!CPgrArchive::CompareNames(m_vInputs[i-1].sName.c_str(),m_vInputs[i].sName.c_str()))
+                return SetError("Build(): duplicate name: " + m_vInputs[i].sName);
+
+        // Read, hash and compress.  Threads take the next input from a shared counter, so large files don't hold up a band.
+
+        int iCount = (int) m_vInputs.size();
+        std::atomic<int> iNext{0};
+        int iThreads = CParallel::GetNumBands(iCount,1,m_stOptions.iMaxThreads);
+        CParallel::ForBands(iThreads,[&](int,int,int)
+        {
+            for (int i;(i = iNext++) < iCount;) Prepare(m_vInputs[i]);
+        },1,m_stOptions.iMaxThreads);
+
+        for (auto & stInput : m_vInputs)
+            if (stInput.bReadError) return SetError("Build(): can't read " + stInput.sPath);
+
+        // Lay out the header, entries and names
+
+        std::vector<PgrArchiveEntry_t> vEntries(iCount);
+        std::string sNames;
+        for (int i=0;i<iCount;i++)
+        {
+            vEntries[i] = {};
+            vEntries[i].uiNameOffset = (unsigned int) sNames.size();
+            vEntries[i].uiNameLength = (unsigned int) m_vInputs[i].sName.size();
+            sNames += m_vInputs[i].sName;
+            sNames += '\0';
+        }
+        sNames.resize((sNames.size() + 7) & ~(size_t) 7,'\0');
+
+        unsigned long long ullEntriesOffset = sizeof(PgrArchiveHeader_t);
+        unsigned long long ullNamesOffset = ullEntriesOffset + (unsigned long long) iCount*sizeof(PgrArchiveEntry_t);
+        unsigned long long ullOffset = ullNamesOffset + sNames.size();
+
+        // Assign data offsets, storing identical files once
+
+        std::unordered_map<unsigned long long,std::vector<int>> mapStored;      // Hash -> inputs already stored
+        std::vector<int> vStoredInputs;                                         // Inputs whose data is written
+        for (int i=0;i<iCount;i++)
+        {
+            auto & stInput = m_vInputs[i];
+            auto & stEntry = vEntries[i];
+            stEntry.ullSize = stInput.vData.size();
+            stEntry.ullHash = stInput.ullHash;
+            m_stStats.llInputBytes += (long long) stEntry.ullSize;
+
+            int iSame = -1;
+            for (int iStored : mapStored[stInput.ullHash])
+                if (m_vInputs[iStored].vData == stInput.vData) { iSame = iStored; break; }
+
+            if (iSame >= 0)
+            {
+                stEntry.ullOffset       = vEntries[iSame].ullOffset;
+                stEntry.ullStoredSize   = vEntries[iSame].ullStoredSize;
+                stEntry.uiCompression   = vEntries[iSame].uiCompression;
+                continue;
+            }
+
+            bool bCompressed = !stInput.vCompressed.empty();
+            ullOffset = (ullOffset + uiAlign-1) & ~(unsigned long long) (uiAlign-1);
+            stEntry.ullOffset       = ullOffset;
+            stEntry.ullStoredSize   = bCompressed ? stInput.vCompressed.size() : stInput.vData.size();
+            stEntry.uiCompression   = bCompressed ? CPgrArchive::LZ4 : CPgrArchive::None;
+            ullOffset += stEntry.ullStoredSize;
+
+            mapStored[stInput.ullHash].push_back(i);
+            vStoredInputs.push_back(i);
+            m_stStats.iStoredFiles++;
+            m_stStats.iCompressedFiles += bCompressed;
+            m_stStats.llStoredBytes += (long long) stEntry.ullStoredSize;
+        }
+        unsigned long long ullFileSize = (ullOffset + uiAlign-1) & ~(unsigned long long) (uiAlign-1);
+        if (ullFileSize > (size_t) -1) return SetError("Build(): archive too large");
+
+        // Write
+
+        vArchive.assign((size_t) ullFileSize,0);
+        memcpy(vArchive.data() + ullEntriesOffset,vEntries.data(),vEntries.size()*sizeof(PgrArchiveEntry_t));
+        memcpy(vArchive.data() + ullNamesOffset,sNames.data(),sNames.size());
+
+        PgrArchiveHeader_t stHeader = {};
+        memcpy(stHeader.sMagic,"PGRI",4);
+        stHeader.uiVersion          = CPgrArchive::kVersion;
+        stHeader.uiNumEntries       = (unsigned int) iCount;
+        stHeader.uiAlignment        = uiAlign;
+        stHeader.ullEntriesOffset   = ullEntriesOffset;
+        stHeader.ullNamesOffset     = ullNamesOffset;
+        stHeader.ullNamesSize       = sNames.size();
+        stHeader.ullFileSize        = ullFileSize;
+        stHeader.ullTableHash       = CPgrArchive::Hash64(vArchive.data() + ullEntriesOffset,(size_t) (ullNamesOffset + sNames.size() - ullEntriesOffset));
+        memcpy(vArchive.data(),&stHeader,sizeof(stHeader));
+
+        for (int i : vStoredInputs)
+        {
+            auto & stInput = m_vInputs[i];
+            auto & vStored = stInput.vCompressed.empty() ? stInput.vData : stInput.vCompressed;
+            if (!vStored.empty()) memcpy(vArchive.data() + vEntries[i].ullOffset,vStored.data(),vStored.size());
+        }
+
+        m_stStats.iEntries = iCount;
+        m_stStats.llArchiveBytes = (long long) ullFileSize;
+
+        // Release file data read from disk, so the builder can be reused or destroyed cheaply
+
+        for (auto & stInput : m_vInputs)
+        {
+            std::vector<unsigned char>().swap(stInput.vCompressed);
+            if (!stInput.sPath.empty()) std::vector<unsigned char>().swap(stInput.vData);
+        }
+        return true;
+    }
+
+    // Build() -- Write the archive to a file.  The file is written under a temporary name and renamed when complete,
+    // so an existing archive is not left half-written if the build fails.
+    //
+    bool Build(const char * sOutputPath)
+    {
+        if (!sOutputPath || !*sOutputPath) return SetError("Build(): empty output path");
+
+        std::vector<unsigned char> vArchive;
+        if (!Build(vArchive)) return false;
+
+        std::string sTemp = std::string(sOutputPath) + ".tmp";
+        FILE * fFile = fopen(sTemp.c_str(),"wb");
+        if (!fFile) return SetError("Build(): can't create " + sTemp);
+        bool bSuccess = fwrite(vArchive.data(),1,vArchive.size(),fFile) == vArchive.size();
+        bSuccess = !fclose(fFile) && bSuccess;
+
+        if (!bSuccess || !RenameFile(sTemp,sOutputPath))
+        {
+            remove(sTemp.c_str());
+            return SetError(std::string("Build(): can't write ") + sOutputPath);
+        }
+        return true;
+    }
+
+    // File system helpers (also used by the PgrBuild tool)
+
+    static bool isPathSeparator(char c) { return c == '/' || c == '\\'; }
+
+    static std::string JoinPath(const std::string & sDir,const std::string & sName)
+    {
+        if (sDir.empty() || sDir == ".") return sName;
+        return isPathSeparator(sDir.back()) ? sDir + sName : sDir + "/" + sName;
+    }
+
+    // GetParentDir() -- The directory part of a path ("" if there is none)
+    //
+    static std::string GetParentDir(const std::string & sPath)
+    {
+        size_t szEnd = sPath.size();
+        while (szEnd && !isPathSeparator(sPath[szEnd-1])) szEnd--;
+        while (szEnd > 1 && isPathSeparator(sPath[szEnd-1])) szEnd--;
+        return sPath.substr(0,szEnd);
+    }
+
+    // GetFileName() -- The name part of a path (after the last separator)
+    //
+    static std::string GetFileName(const std::string & sPath)
+    {
+        size_t szStart = sPath.size();
+        while (szStart && !isPathSeparator(sPath[szStart-1])) szStart--;
+        return sPath.substr(szStart);
+    }
+
+    static bool isRelativePath(const std::string & sPath)
+    {
+        if (!sPath.empty() && isPathSeparator(sPath[0])) return false;
+#if defined(_WIN32)
+        if (sPath.size() > 1 && sPath[1] == ':') return false;     // Drive letter
+#endif
+        return true;
+    }
+
+#if defined(_WIN32)
+    static bool isDirectory(const std::string & sPath)
+    {
+        DWORD dwAttributes = GetFileAttributesA(sPath.c_str());
+        return dwAttributes != INVALID_FILE_ATTRIBUTES && (dwAttributes & FILE_ATTRIBUTE_DIRECTORY);
+    }
+
+    static bool GetPathSize(const std::string & sPath,unsigned long long & ullSize)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA stData;
+        if (!GetFileAttributesExA(sPath.c_str(),GetFileExInfoStandard,&stData) || (stData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) return false;
+        ullSize = ((unsigned long long) stData.nFileSizeHigh << 32) | stData.nFileSizeLow;
+        return true;
+    }
+
+    static bool RenameFile(const std::string & sFrom,const char * sTo)
+    {
+        return MoveFileExA(sFrom.c_str(),sTo,MOVEFILE_REPLACE_EXISTING) != 0;
+    }
+
+    // ListFiles() -- Add the regular files under sRoot/sRelative to vFiles, as '/'-separated paths relative to sRoot
+    //
+    static bool ListFiles(const std::string & sRoot,const std::string & sRelative,std::vector<std::string> & vFiles)
+    {
+        WIN32_FIND_DATAA stFind;
+        HANDLE hFind = FindFirstFileA(JoinPath(JoinPath(sRoot,sRelative),"*").c_str(),&stFind);
+        if (hFind == INVALID_HANDLE_VALUE) return false;
+
+        bool bSuccess = true;
+        do
+        {
+            if (!strcmp(stFind.cFileName,".") || !strcmp(stFind.cFileName,"..")) continue;
+            std::string sName = sRelative.empty() ? std::string(stFind.cFileName) : sRelative + "/" + stFind.cFileName;
+            // Directory links (reparse points) are not followed, so a link loop can't recurse forever
+
+            if (!(stFind.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) vFiles.push_back(sName);
+            else if (!(stFind.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) bSuccess = ListFiles(sRoot,sName,vFiles) && bSuccess;
+        } while (FindNextFileA(hFind,&stFind));
+
+        bSuccess = GetLastError() == ERROR_NO_MORE_FILES && bSuccess;
+        FindClose(hFind);
+        return bSuccess;
+    }
+#else
+    static bool isDirectory(const std::string & sPath)
+    {
+        struct stat stInfo;
+        return !stat(sPath.c_str(),&stInfo) && S_ISDIR(stInfo.st_mode);
+    }
+
+    static bool GetPathSize(const std::string & sPath,unsigned long long & ullSize)
+    {
+        struct stat stInfo;
+        if (stat(sPath.c_str(),&stInfo) || !S_ISREG(stInfo.st_mode)) return false;
+        ullSize = (unsigned long long) stInfo.st_size;
+        return true;
+    }
+
+    static bool RenameFile(const std::string & sFrom,const char * sTo) { return !rename(sFrom.c_str(),sTo); }
+
+    // ListFiles() -- Add the regular files under sRoot/sRelative to vFiles, as '/'-separated paths relative to sRoot
+    //
+    static bool ListFiles(const std::string & sRoot,const std::string & sRelative,std::vector<std::string> & vFiles)
+    {
+        DIR * pDir = opendir(JoinPath(sRoot,sRelative).c_str());
+        if (!pDir) return false;
+
+        bool bSuccess = true;
+        while (auto pEntry = readdir(pDir))
+        {
+            if (!strcmp(pEntry->d_name,".") || !strcmp(pEntry->d_name,"..")) continue;
+            std::string sName = sRelative.empty() ? std::string(pEntry->d_name) : sRelative + "/" + pEntry->d_name;
+            std::string sPath = JoinPath(sRoot,sName);
+
+            // Links to files are added; links to directories are not followed (so a link loop can't recurse forever)
+
+            struct stat stInfo;
+            if (lstat(sPath.c_str(),&stInfo)) { bSuccess = false; continue; }
+            if (S_ISDIR(stInfo.st_mode)) bSuccess = ListFiles(sRoot,sName,vFiles) && bSuccess;
+            else if (S_ISREG(stInfo.st_mode) || (S_ISLNK(stInfo.st_mode) && !stat(sPath.c_str(),&stInfo) && S_ISREG(stInfo.st_mode)))
+                vFiles.push_back(sName);
+        }
+        closedir(pDir);
+        return bSuccess;
+    }
+#endif
+};
+
+}; // namespace Sage
+#endif // _CPgrBuilder_H_
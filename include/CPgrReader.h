@@ -0,0 +1,692 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CPgrReader -- Memory-mapped, indexed PGR reader that can be used from any number of threads at once.
+//
+// CSagePGR (and the CReadPGR underneath it) reads through one file cursor (fseek()/fread(), or a memory pointer for CMemPGR),
+// so a CSagePGR can only be used by one thread at a time, and every FindKey() or ReadFile() walks the key or directory table.
+//
+// CPgrReader maps the PGR file into memory once (or copies a PGR already in memory into a shared memory section), and:
+//
+//      1. Builds a hash index of the file directory on Open(), so FileExists() and GetFileSpan() are O(1) and need no locking.
+//      2. Builds a hash index of the keys, so FindKey() is O(1) and ReadText() does not lease a CSagePGR for top-level keys.
+//      3. Returns files as zero-copy spans pointing into the mapped view (GetFileSpan()).
+//      4. Keeps a lock-free pool of CSagePGR objects.  Each call leases one object (so each thread has its own read cursor),
+//         which makes ReadFile(), ReadBitmap(), ReadRawBitmap() and ReadText() safe to call from any thread.  Leasing is a
+//         single compare-exchange; the PGR is parsed again only when more threads read at the same time than there are
+//         pooled objects.
+//
+// CSagePGR is in the prebuilt library, so whether it ever writes to the PGR memory it is given cannot be checked here.
+// Each CSagePGR (and the CMemPGR used to build the index) therefore gets its own copy-on-write view of the mapping: the
+// pages are shared between all of them (and with the file cache) until one is written, and a write only changes that
+// object's copy.  The view used for GetFileSpan() and the indexes is mapped read-only.
+//
+// CPgrReader also reads indexed PGR archives written by CPgrBuilder (see CPgrArchive.h).  These are read directly, without
+// CSagePGR: the index comes from the archive's sorted entry table, GetFileSpan() returns uncompressed files in place,
+// ReadFileMem() decompresses LZ4 files, and ReadBitmap() decodes JPEG files.  Names are paths, and a top key is joined
+// to the file name as "TopKey/File".  ReadFile() and Use() are for CSagePGR-format PGRs only (use ReadFileMem() for both).
+//
+// In both kinds of PGR, names are matched without regard to case, and '\' matches '/' (i.e. "Textures\Sky.jpg" finds
+// "textures/sky.jpg").
+//
+// Basic usage:
+//
+//      CPgrReader cPgr("Textures.pgr");
+//
+//      auto cBitmap = cPgr.ReadBitmap("Texture","Background.jpg");    // Any thread
+//      auto stSpan  = cPgr.GetFileSpan("Data.bin");                    // Stored bytes, no copy (valid until Close())
+//
+//      cPgr.Use([&](CSagePGR & cSagePgr) { cSagePgr.ReadInt(&iValue,"Width"); });    // Any other CSagePGR function
+//
+// Close() (and the destructor) must not be called while other threads are still reading.
+//
+// Keys: FindKey() only finds keys named in the PGR's key table, and only without a sub key -- the values are read through
+// CSagePGR::ReadText() once when the PGR is opened, so they are the same text CSagePGR returns.  ReadText() with a sub key,
+// or for a key that is not in the index, uses a leased CSagePGR as before.
+//
+#if !defined(_CPgrReader_H_)
+#define _CPgrReader_H_
+
+#include <Windows.h>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Sage.h"
+#include "CString.h"
+#include "CRawBitmap.h"
+#include "CPgr.h"
+#include "CPgrArchive.h"
+
+namespace Sage
+{
+
+// PgrSpan_t -- Bytes of a file stored in a PGR, pointing directly into the mapped PGR.
+//
+// This is the file as stored in the PGR (the same bytes ReadRawFile() returns), and is valid until CPgrReader::Close().
+//
+struct PgrSpan_t
+{
+    const unsigned char * pData;
+    int                   iSize;
+
+    bool isValid() const { return pData != nullptr; }
+};
+
+class CPgrReader
+{
+public:
+    static constexpr int kMaxPooled = 32;       // Maximum number of pooled CSagePGR objects (more concurrent readers use a temporary object)
+
+    struct Stats_t
+    {
+        long long llLeases;         // Number of CSagePGR leases
+        long long llTemporary;      // Leases that had to parse the PGR because all pooled objects were in use
+        int       iPooled;          // Number of CSagePGR objects created for the pool
+        int       iIndexedFiles;    // Number of files in the directory index
+    };
+
+private:
+    struct IndexEntry_t
+    {
+        unsigned int    uiHash;
+        int             iFile;      // Index into m_vFiles, or -1 for an empty slot
+    };
+
+    struct File_t
+    {
+        const char    * sName;      // Points into m_vNames
+        int             iLocation;  // Offset of the file in the mapped PGR
+        int             iSize;
+        int             iStoredSize;
+        unsigned int    uiCompression;  // CPgrArchive::Compression (always None for CSagePGR-format PGRs)
+    };
+
+    // Pool slot states
+
+    enum : int { kSlotEmpty, kSlotBusy, kSlotIdle };
+
+    // PgrView_t -- A CSagePGR reading from its own copy-on-write view of the mapping
+
+    struct PgrView_t
+    {
+        std::unique_ptr<CSagePGR>   cPgr;
+        unsigned char             * pView = nullptr;
+
+        void Reset() { cPgr.reset(); if (pView) UnmapViewOfFile(pView); pView = nullptr; }
+    };
+
+    struct Slot_t
+    {
+        std::atomic<int>            iState{kSlotEmpty};
+        PgrView_t                   stPgr;
+    };
+
+    struct Key_t
+    {
+        const char    * sName;      // Points into m_vKeyText
+        const char    * sValue;
+    };
+
+    HANDLE                      m_hFile         = INVALID_HANDLE_VALUE;
+    HANDLE                      m_hMapping      = nullptr;      // File mapping, or a pagefile-backed section holding a copy of the caller's memory
+    const unsigned char       * m_pView         = nullptr;      // Read-only view (spans and indexes)
+    int                         m_iSize         = 0;
+    bool                        m_bArchive      = false;        // Indexed PGR archive (CPgrBuilder) rather than a CSagePGR-format PGR
+
+    std::vector<File_t>         m_vFiles;
+    std::vector<IndexEntry_t>   m_vIndex;                       // Open-addressed, power-of-2 size
+    std::vector<char>           m_vNames;                       // File names copied from the string table
+    std::vector<Key_t>          m_vKeys;
+    std::vector<IndexEntry_t>   m_vKeyIndex;                    // Open-addressed, power-of-2 size (iFile is an index into m_vKeys)
+    std::vector<char>           m_vKeyText;                     // Key names and values
+    std::unique_ptr<Slot_t[]>   m_stSlots{new Slot_t[kMaxPooled]};
+
+    std::atomic<long long>      m_llLeases{0};
+    std::atomic<long long>      m_llTemporary{0};
+    std::atomic<int>            m_iPooled{0};
+
+    // NameChar() -- A name character as it is hashed and compared: lower case, with '\' read as '/'
+    //
+    static unsigned char NameChar(char cChar)
+    {
+        unsigned char ucChar = (unsigned char) cChar;
+        if (ucChar >= 'A' && ucChar <= 'Z') return (unsigned char) (ucChar + 'a'-'A');
+        return ucChar == '\\' ? '/' : ucChar;
+    }
+
+    // HashName() -- Case-insensitive FNV-1a (PGR file names are matched without regard to case or path separator)
+    //
+    static unsigned int HashName(const char * sName)
+    {
+        unsigned int uiHash = 2166136261u;
+        for (;*sName;sName++) uiHash = (uiHash ^ NameChar(*sName))*16777619u;
+        return uiHash;
+    }
+
+    static bool SameName(const char * s1,const char * s2)
+    {
+        for (;;s1++,s2++)
+        {
+            unsigned char c1 = NameChar(*s1), c2 = NameChar(*s2);
+            if (c1 != c2) return false;
+            if (!c1) return true;
+        }
+    }
+
+    // MapCopy() -- Map a new copy-on-write view of the PGR.  Free with UnmapViewOfFile().
+    //
+    unsigned char * MapCopy() const
+    {
+        return m_hMapping ? (unsigned char *) MapViewOfFile(m_hMapping,FILE_MAP_COPY,0,0,(SIZE_T) m_iSize) : nullptr;
+    }
+
+    // NewPgr() -- Create a CSagePGR reading from its own copy-on-write view
+    //
+    bool NewPgr(PgrView_t & stPgr)
+    {
+        stPgr.pView = MapCopy();
+        if (stPgr.pView)
+        {
+            stPgr.cPgr.reset(new CSagePGR());
+            if (stPgr.cPgr->ReadMemPGR(stPgr.pView,m_iSize) == ePGR_OK) return true;
+        }
+        stPgr.Reset();
+        return false;
+    }
+
+    // BuildIndex() -- Parse the PGR directory once and hash the file names.
+    //
+    // Every offset read from the PGR is checked against the size of the PGR and the string table, so a damaged or
+    // differently-encoded PGR leaves the index empty rather than reading out of bounds.  Without an index, FileExists() and
+    // the Read functions still work through the pooled CSagePGR objects; only GetFileSpan() needs the index.
+    //
+    void BuildIndex(CSagePGR & cSagePgr)
+    {
+        std::unique_ptr<unsigned char,BOOL (*)(const void *)> pView(MapCopy(),[](const void * p) { return p ? UnmapViewOfFile(p) : FALSE; });
+        if (!pView) return;
+
+        CMemPGR cMemPgr(pView.get(),m_iSize);
+        if (cMemPgr.ReadFile() != ePGR_OK) return;
+
+        auto & stHeader = cMemPgr.m_stPGRHeader;
+        if (!cMemPgr.m_stPGRFileDirectory || !cMemPgr.m_sStringTable || stHeader.ulNumFiles > (unsigned int) m_iSize) return;
+
+        long long llFileStart   = cMemPgr.m_iFileStart;
+        unsigned int uiTableLen = stHeader.ulStringTableLength;
+
+        for (unsigned int i=0;i<stHeader.ulNumFiles;i++)
+        {
+            auto & stEntry = cMemPgr.m_stPGRFileDirectory[i];
+            if (stEntry.ulFileNamePointer >= uiTableLen) continue;
+            if (llFileStart + stEntry.ulFilePointer + stEntry.ulFileSize > m_iSize) continue;
+
+            const char * sName = cMemPgr.m_sStringTable + stEntry.ulFileNamePointer;
+            size_t szName = strnlen(sName,uiTableLen - stEntry.ulFileNamePointer);
+            if (!szName || szName == uiTableLen - stEntry.ulFileNamePointer) continue;
+
+            m_vFiles.push_back({ (const char *) m_vNames.size(),(int) (llFileStart + stEntry.ulFilePointer),(int) stEntry.ulFileSize,
+                                 (int) stEntry.ulFileSize,CPgrArchive::None });
+            m_vNames.insert(m_vNames.end(),sName,sName+szName+1);
+        }
+
+        // Names were stored as offsets while m_vNames was growing
+
+        for (auto & stFile : m_vFiles) stFile.sName = m_vNames.data() + (size_t) stFile.sName;
+        HashFiles();
+        BuildKeyIndex(cMemPgr,cSagePgr);
+    }
+
+    // BuildKeyIndex() -- Hash the names in the key table, with each value as CSagePGR::ReadText() returns it.
+    //
+    // The values are taken from CSagePGR rather than from the string table, so FindKey() returns exactly what CSagePGR
+    // would (CSagePGR may decode values).  Names it does not find are left out, and fall back to CSagePGR in ReadText().
+    //
+    void BuildKeyIndex(CMemPGR & cMemPgr,CSagePGR & cSagePgr)
+    {
+        auto & stHeader = cMemPgr.m_stPGRHeader;
+        if (!cMemPgr.m_stPGRKeyTable || !cMemPgr.m_sStringTable || stHeader.ulNumKeys > (unsigned int) m_iSize) return;
+
+        unsigned int uiTableLen = stHeader.ulStringTableLength;
+        std::vector<std::pair<size_t,size_t>> vOffsets;        // Name and value offsets in m_vKeyText
+
+        for (unsigned int i=0;i<stHeader.ulNumKeys;i++)
+        {
+            unsigned int uiName = cMemPgr.m_stPGRKeyTable[i].ulKeynamePointer;
+            if (uiName >= uiTableLen) continue;
+
+            const char * sName = cMemPgr.m_sStringTable + uiName;
+            size_t szName = strnlen(sName,uiTableLen - uiName);
+            if (!szName || szName == uiTableLen - uiName) continue;
+
+            std::string sKey(sName,szName);
+            const char * sValue = cSagePgr.ReadText(sKey.c_str());
+            if (!sValue) continue;
+
+            size_t szNameOffset = m_vKeyText.size();
+            m_vKeyText.insert(m_vKeyText.end(),sKey.c_str(),sKey.c_str()+szName+1);
+            vOffsets.push_back({ szNameOffset,m_vKeyText.size() });
+            m_vKeyText.insert(m_vKeyText.end(),sValue,sValue+strlen(sValue)+1);
+        }
+
+        m_vKeys.reserve(vOffsets.size());
+        for (auto & stOffsets : vOffsets) m_vKeys.push_back({ m_vKeyText.data() + stOffsets.first,m_vKeyText.data() + stOffsets.second });
+
+        std::vector<const char *> vNames(m_vKeys.size());
+        for (size_t i=0;i<m_vKeys.size();i++) vNames[i] = m_vKeys[i].sName;
+        HashNames(vNames,m_vKeyIndex);
+    }
+
+    // BuildArchiveIndex() -- Index an indexed PGR archive.  CPgrArchive::GetHeader() has already checked every entry.
+    //
+    bool BuildArchiveIndex()
+    {
+        auto stHeader = CPgrArchive::GetHeader(m_pView,(size_t) m_iSize);
+        if (!stHeader) return false;
+
+        auto stEntries = CPgrArchive::GetEntries(m_pView);
+        m_vFiles.reserve(stHeader->uiNumEntries);
+        for (unsigned int i=0;i<stHeader->uiNumEntries;i++)
+        {
+            auto & stEntry = stEntries[i];
+            m_vFiles.push_back({ CPgrArchive::GetName(m_pView,stEntry),(int) stEntry.ullOffset,(int) stEntry.ullSize,
+                                 (int) stEntry.ullStoredSize,stEntry.uiCompression });
+        }
+        HashFiles();
+        return true;
+    }
+
+    // HashNames() -- Build an open-addressed hash index over a list of names.  The first of any duplicate names wins.
+    //
+    static void HashNames(const std::vector<const char *> & vNames,std::vector<IndexEntry_t> & vIndex)
+    {
+        size_t szIndex = 16;
+        while (szIndex < vNames.size()*2) szIndex *= 2;
+        vIndex.assign(szIndex,IndexEntry_t{ 0,-1 });
+
+        for (int i=0;i<(int) vNames.size();i++)
+        {
+            unsigned int uiHash = HashName(vNames[i]);
+            size_t szSlot = uiHash & (szIndex-1);
+            while (vIndex[szSlot].iFile >= 0)
+            {
+                if (vIndex[szSlot].uiHash == uiHash && SameName(vNames[vIndex[szSlot].iFile],vNames[i])) break;
+                szSlot = (szSlot+1) & (szIndex-1);
+            }
+            if (vIndex[szSlot].iFile < 0) vIndex[szSlot] = { uiHash,i };
+        }
+    }
+
+    // FindName() -- Look up a name in a HashNames() index.  fnName(i) returns the name of item i.  Returns the item, or -1.
+    //
+    template <typename _fn>
+    static int FindName(const std::vector<IndexEntry_t> & vIndex,const char * sName,_fn && fnName)
+    {
+        if (!sName || vIndex.empty()) return -1;
+        unsigned int uiHash = HashName(sName);
+        size_t szMask = vIndex.size()-1;
+        for (size_t szSlot = uiHash & szMask;vIndex[szSlot].iFile >= 0;szSlot = (szSlot+1) & szMask)
+        {
+            auto & stEntry = vIndex[szSlot];
+            if (stEntry.uiHash == uiHash && SameName(fnName(stEntry.iFile),sName)) return stEntry.iFile;
+        }
+        return -1;
+    }
+
+    // HashFiles() -- Build the hash index over m_vFiles
+    //
+    void HashFiles()
+    {
+        std::vector<const char *> vNames(m_vFiles.size());
+        for (size_t i=0;i<m_vFiles.size();i++) vNames[i] = m_vFiles[i].sName;
+        HashNames(vNames,m_vIndex);
+    }
+
+    const File_t * FindFile(const char * sFile) const
+    {
+        int iFile = FindName(m_vIndex,sFile,[&](int i) { return m_vFiles[i].sName; });
+        return iFile < 0 ? nullptr : &m_vFiles[iFile];
+    }
+
+    static std::string JoinName(const char * sTopKey,const char * sFile)
+    {
+        std::string sName(sTopKey ? sTopKey : "");
+        if (!sName.empty()) sName += '/';
+        return sName + (sFile ? sFile : "");
+    }
+
+    // ReadArchiveBitmap() -- Decode a JPEG file from an indexed archive
+    //
+    CBitmap ReadArchiveBitmap(const char * sFile)
+    {
+        bool bSuccess = false;
+        auto cData = ReadFileMem(sFile,&bSuccess);
+        if (!bSuccess || !cData.pMem) return CBitmap();
+        return Sage::ReadJpegMem(cData.pMem,cData.iSize);
+    }
+
+    // OpenMapping() -- Map the read-only view of m_hMapping and index the PGR
+    //
+    bool OpenMapping()
+    {
+        if (m_hMapping) m_pView = (const unsigned char *) MapViewOfFile(m_hMapping,FILE_MAP_READ,0,0,(SIZE_T) m_iSize);
+        if (!m_pView) { Close(); return false; }
+
+        if (CPgrArchive::isArchive(m_pView,(size_t) m_iSize))
+        {
+            m_bArchive = BuildArchiveIndex();
+            if (!m_bArchive) Close();
+            return m_bArchive;
+        }
+
+        // Make sure the PGR can be read at all before reporting success (this also creates the first pooled object)
+
+        if (!NewPgr(m_stSlots[0].stPgr)) { Close(); return false; }
+        BuildIndex(*m_stSlots[0].stPgr.cPgr);
+        m_stSlots[0].iState = kSlotIdle;
+        m_iPooled = 1;
+        return true;
+    }
+
+public:
+    // Lease -- A CSagePGR for the calling thread to use.  Returned to the pool when the Lease goes out of scope.
+    //
+    class Lease
+    {
+        friend class CPgrReader;
+        Slot_t        * m_stSlot    = nullptr;
+        CSagePGR      * m_cPgr      = nullptr;
+        PgrView_t       m_stTemp;                   // Temporary object (and its view) when m_stSlot is nullptr
+
+        Lease(Slot_t * stSlot) : m_stSlot(stSlot), m_cPgr(stSlot ? stSlot->stPgr.cPgr.get() : nullptr) { }
+        Lease(PgrView_t && stTemp) : m_cPgr(stTemp.cPgr.get()), m_stTemp(std::move(stTemp)) { stTemp.pView = nullptr; }
+    public:
+        Lease(Lease && p2) noexcept : m_stSlot(p2.m_stSlot), m_cPgr(p2.m_cPgr), m_stTemp(std::move(p2.m_stTemp))
+        {
+            p2.m_stSlot         = nullptr;
+            p2.m_cPgr           = nullptr;
+            p2.m_stTemp.pView   = nullptr;
+        }
+        Lease(const Lease &) = delete;
+        Lease & operator = (const Lease &) = delete;
+        ~Lease()
+        {
+            if (m_stSlot) m_stSlot->iState.store(kSlotIdle,std::memory_order_release);
+            else m_stTemp.Reset();
+        }
+
+        bool isValid() const { return m_cPgr != nullptr; }
+        CSagePGR * operator -> () const { return m_cPgr; }
+        CSagePGR & operator * () const { return *m_cPgr; }
+        operator CSagePGR * () const { return m_cPgr; }
+    };
+
+    CPgrReader() { }
+    CPgrReader(const char * sPath) { Open(sPath); }
+    CPgrReader(const unsigned char * pPgrData,int iLength) { Open(pPgrData,iLength); }
+    ~CPgrReader() { Close(); }
+
+    CPgrReader(const CPgrReader &) = delete;
+    CPgrReader & operator = (const CPgrReader &) = delete;
+
+    // Open() -- Map a PGR file into memory and index it.  Returns false if the file could not be opened or is not a PGR.
+    //
+    bool Open(const char * sPath)
+    {
+        Close();
+        if (!sPath) return false;
+
+        m_hFile = CreateFileA(sPath,GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+        if (m_hFile == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER stSize;
+        if (!GetFileSizeEx(m_hFile,&stSize) || stSize.QuadPart <= 0 || stSize.QuadPart > INT_MAX) { Close(); return false; }
+        m_iSize = (int) stSize.QuadPart;
+
+        // PAGE_WRITECOPY allows the read-only view and the copy-on-write views given to each CSagePGR
+
+        m_hMapping = CreateFileMappingA(m_hFile,nullptr,PAGE_WRITECOPY,0,0,nullptr);
+        return OpenMapping();
+    }
+
+    // Open() -- Use a PGR already in memory (i.e. compiled into the program).
+    //
+    // The data is copied once into a pagefile-backed section, so that each CSagePGR can have its own copy-on-write view
+    // (as for files).  The caller's memory is not used after Open() returns.
+    //
+    bool Open(const unsigned char * pPgrData,int iLength)
+    {
+        Close();
+        if (!pPgrData || iLength <= 0) return false;
+        m_iSize = iLength;
+
+        m_hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE,nullptr,PAGE_READWRITE,0,(DWORD) iLength,nullptr);
+        auto pCopy = m_hMapping ? (unsigned char *) MapViewOfFile(m_hMapping,FILE_MAP_WRITE,0,0,(SIZE_T) iLength) : nullptr;
+        if (!pCopy) { Close(); return false; }
+        memcpy(pCopy,pPgrData,(size_t) iLength);
+        UnmapViewOfFile(pCopy);
+
+        return OpenMapping();
+    }
+
+    void Close()
+    {
+        for (int i=0;i<kMaxPooled;i++)
+        {
+            m_stSlots[i].stPgr.Reset();
+            m_stSlots[i].iState = kSlotEmpty;
+        }
+        m_vFiles.clear();
+        m_vIndex.clear();
+        m_vNames.clear();
+        m_vKeys.clear();
+        m_vKeyIndex.clear();
+        m_vKeyText.clear();
+
+        if (m_pView) UnmapViewOfFile(m_pView);
+        if (m_hMapping) CloseHandle(m_hMapping);
+        if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+
+        m_hFile     = INVALID_HANDLE_VALUE;
+        m_hMapping  = nullptr;
+        m_pView     = nullptr;
+        m_iSize     = 0;
+        m_bArchive  = false;
+        m_iPooled   = 0;
+    }
+
+    bool isValid() const { return m_pView != nullptr; }
+
+    // GetLease() -- Lease a CSagePGR for use by the calling thread.  Check isValid() on the result.
+    //
+    Lease GetLease()
+    {
+        m_llLeases.fetch_add(1,std::memory_order_relaxed);
+        if (!m_pView || m_bArchive) return Lease(nullptr);
+
+        for (int i=0;i<kMaxPooled;i++)
+        {
+            auto & stSlot = m_stSlots[i];
+            int iState = kSlotIdle;
+            if (stSlot.iState.load(std::memory_order_relaxed) == kSlotIdle &&
+                stSlot.iState.compare_exchange_strong(iState,kSlotBusy,std::memory_order_acquire))
+                return Lease(&stSlot);
+        }
+
+        // All existing objects are busy -- claim an empty slot, or use a temporary object if the pool is full
+
+        for (int i=0;i<kMaxPooled;i++)
+        {
+            auto & stSlot = m_stSlots[i];
+            int iState = kSlotEmpty;
+            if (stSlot.iState.load(std::memory_order_relaxed) == kSlotEmpty &&
+                stSlot.iState.compare_exchange_strong(iState,kSlotBusy,std::memory_order_acquire))
+            {
+                if (!NewPgr(stSlot.stPgr)) { stSlot.iState.store(kSlotEmpty,std::memory_order_release); break; }
+                m_iPooled.fetch_add(1,std::memory_order_relaxed);
+                return Lease(&stSlot);
+            }
+        }
+        m_llTemporary.fetch_add(1,std::memory_order_relaxed);
+        PgrView_t stTemp;
+        NewPgr(stTemp);
+        return Lease(std::move(stTemp));
+    }
+
+    // Use() -- Call fnUse(CSagePGR &) with a leased CSagePGR, for CSagePGR functions without a CPgrReader version.
+    // Returns what fnUse() returns (or a default value if the PGR is not open).
+    //
+    // Pointers returned by CSagePGR (i.e. FindKey()) must not be used after fnUse() returns.
+    //
+    template <typename _fn>
+    auto Use(_fn && fnUse) -> decltype(fnUse(std::declval<CSagePGR &>()))
+    {
+        auto cLease = GetLease();
+        if (!cLease.isValid()) return decltype(fnUse(std::declval<CSagePGR &>()))();
+        return fnUse(*cLease);
+    }
+
+    // GetFileSpan() -- Return the stored bytes of a file in the PGR, with no copy and no locking.
+    // Returns an invalid span (pData == nullptr) if the file is not found, or is LZ4-compressed in an indexed archive
+    // (use ReadFileMem() for these).
+    //
+    PgrSpan_t GetFileSpan(const char * sFile) const
+    {
+        auto stFile = FindFile(sFile);
+        if (!stFile || stFile->uiCompression != CPgrArchive::None) return { nullptr,0 };
+        return { m_pView + stFile->iLocation,stFile->iSize };
+    }
+
+    bool isArchive() const { return m_bArchive; }
+
+    bool FileExists(const char * sFile)
+    {
+        if (!m_vIndex.empty() || m_bArchive) return FindFile(sFile) != nullptr;
+        return Use([&](CSagePGR & cPgr) { return cPgr.FileExists(sFile); });
+    }
+    bool FileExists(const char * sTopKey,const char * sFile)
+    {
+        if (m_bArchive) return FindFile(JoinName(sTopKey,sFile).c_str()) != nullptr;
+        return Use([&](CSagePGR & cPgr) { return cPgr.FileExists(sTopKey,sFile); });
+    }
+
+    // ReadFileMem() -- Read (and decompress or decode) a file into memory owned by the returned Mem object.
+    // Works for both indexed archives and CSagePGR-format PGRs.
+    //
+    Mem<unsigned char> ReadFileMem(const char * sFile,bool * bSuccess = nullptr)
+    {
+        Mem<unsigned char> cData;
+        bool bRead = false;
+        if (m_bArchive)
+        {
+            auto stFile = FindFile(sFile);
+            if (stFile && (cData = stFile->iSize, stFile->iSize == 0 || cData.pMem))
+            {
+                auto & stEntry = CPgrArchive::GetEntries(m_pView)[stFile - m_vFiles.data()];
+                bRead = !stFile->iSize || CPgrArchive::Extract(m_pView,stEntry,cData.pMem);
+                if (!bRead) cData.DeleteData();
+            }
+        }
+        else
+        {
+            int iSize = 0;
+            unsigned char * sData = ReadFile(sFile,iSize);
+            if (sData && (cData = iSize, iSize == 0 || cData.pMem))
+            {
+                if (iSize) memcpy(cData.pMem,sData,iSize);
+                bRead = true;
+            }
+            if (sData) CSagePGR::FreeFileMem(sData);
+        }
+        if (bSuccess) *bSuccess = bRead;
+        return cData;
+    }
+
+    // ReadFile() -- Read (and decode) a file from a CSagePGR-format PGR.  Free the returned memory with CSagePGR::FreeFileMem().
+    // Returns nullptr for indexed archives (use ReadFileMem()).
+    //
+    unsigned char * ReadFile(const char * sFile,int & iFileSize)
+    {
+        iFileSize = 0;
+        if (m_bArchive) return nullptr;
+        return Use([&](CSagePGR & cPgr) { return cPgr.ReadFile(sFile,iFileSize); });
+    }
+    unsigned char * ReadFile(const char * sTopKey,const char * sFile,int & iFileSize,bool bRawFile = false)
+    {
+        iFileSize = 0;
+        if (m_bArchive) return nullptr;
+        return Use([&](CSagePGR & cPgr) { return cPgr.ReadFile(sTopKey,sFile,iFileSize,bRawFile); });
+    }
+
+    [[nodiscard]] RawBitmap_t ReadRawBitmap(const char * sFile)
+    {
+        if (m_bArchive)
+        {
+            RawBitmap_t stBitmap{};
+            auto cBitmap = ReadArchiveBitmap(sFile);
+            std::swap(stBitmap,cBitmap.stBitmap);
+            return stBitmap;
+        }
+        return Use([&](CSagePGR & cPgr) { return cPgr.ReadRawBitmap(sFile); });
+    }
+    [[nodiscard]] RawBitmap_t ReadRawBitmap(const char * sTopKey,const char * sFile)
+    {
+        if (m_bArchive) return ReadRawBitmap(JoinName(sTopKey,sFile).c_str());
+        return Use([&](CSagePGR & cPgr) { return cPgr.ReadRawBitmap(sTopKey,sFile); });
+    }
+
+    CBitmap ReadBitmap(const char * sFile)
+    {
+        if (m_bArchive) return ReadArchiveBitmap(sFile);
+        return Use([&](CSagePGR & cPgr) { return cPgr.ReadBitmap(sFile); });
+    }
+    CBitmap ReadBitmap(const char * sTopKey,const char * sFile)
+    {
+        if (m_bArchive) return ReadArchiveBitmap(JoinName(sTopKey,sFile).c_str());
+        return Use([&](CSagePGR & cPgr) { return cPgr.ReadBitmap(sTopKey,sFile); });
+    }
+
+    // FindKey() -- The value of a key, from the key index, with no lease and no locking.  The returned text is valid
+    // until Close().  Returns nullptr if the key is not in the index (see the notes at the top of this file).
+    //
+    const char * FindKey(const char * sKey) const
+    {
+        int iKey = FindName(m_vKeyIndex,sKey,[&](int i) { return m_vKeys[i].sName; });
+        return iKey < 0 ? nullptr : m_vKeys[iKey].sValue;
+    }
+
+    // ReadText() -- Copy the text of a key into cString.  Returns false if the key was not found.
+    // For indexed archives, the key is a file name (with sSubKey as the top key) and its contents are the text.
+    //
+    bool ReadText(CString & cString,const char * sKey,const char * sSubKey = nullptr)
+    {
+        if (!sSubKey)
+            if (auto sValue = FindKey(sKey)) { cString = sValue; return true; }
+
+        if (m_bArchive)
+        {
+            bool bSuccess = false;
+            auto cData = ReadFileMem(sSubKey ? JoinName(sSubKey,sKey).c_str() : sKey,&bSuccess);
+            if (!bSuccess) return false;
+            std::string sText((const char *) cData.pMem,(size_t) (cData.pMem ? cData.iSize : 0));
+            cString = sText.c_str();
+            return true;
+        }
+        return Use([&](CSagePGR & cPgr) { return cPgr.ReadText(cString,sKey,sSubKey); });
+    }
+
+    int GetNumIndexedFiles() const { return (int) m_vFiles.size(); }
+    int GetNumIndexedKeys() const { return (int) m_vKeys.size(); }
+
+    Stats_t GetStats() const
+    {
+        return { m_llLeases.load(std::memory_order_relaxed),m_llTemporary.load(std::memory_order_relaxed),
+                 m_iPooled.load(std::memory_order_relaxed),(int) m_vFiles.size() };
+    }
+};
+
+}; // namespace Sage
+#endif // _CPgrReader_H_
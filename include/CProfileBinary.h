@@ -0,0 +1,588 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CProfileBinary -- Binary, memory-mappable profile format, used alongside the text profile format (see CProfileIndex.h).
+//
+// Text profiles carry embedded data files (masks, images, etc.) inline, so reading one means decoding each file into its own
+// buffer (and CProfiles copies each into an stProfileFileData_t).  A binary profile is mapped and used in place:
+//
+//      ProfileBinaryHeader_t                       80 bytes
+//      ProfileBinaryTag_t[uiNumTags]               Sorted by name hash, then name
+//      ProfileBinaryFile_t[uiNumFiles]             In profile order
+//      Strings                                     Tag names and values, each null-terminated (values have no escapes)
+//      File data                                   Each file starts on a 64-byte boundary
+//
+// Each section (header, tag table, file table, strings, and each file) has its own CRC-32C (CCrc32c, which uses the SSE4.2
+// CRC32 instruction).  The header and tables are checked on Open(); each file is checked the first time it is used.
+//
+// Lookups are a binary search of the tag table.  GetText() returns a value as a null-terminated string in the mapped
+// profile, and GetFileData() returns an embedded file as a view into the mapped profile, with no copies.
+//
+// Converting between the two formats:
+//
+//      CProfileBinary::ConvertText("Presets.txt","Presets.prb");      // Text -> binary
+//      CProfileBinary::ConvertBinary("Presets.prb","Presets.txt");    // Binary -> text
+//
+// Converting to binary and back gives the same tags, values and files (the text is written with tags sorted by name
+// and grouped by section, and comments are not kept).
+//
+#if !defined(_CProfileBinary_H_)
+#define _CProfileBinary_H_
+
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CProfileIndex.h"
+#include "CCrc32c.h"
+
+namespace Sage
+{
+
+struct ProfileBinaryHeader_t
+{
+    char                sMagic[4];          // "PRFB"
+    unsigned int        uiVersion;
+    unsigned int        uiNumTags;
+    unsigned int        uiNumFiles;
+    unsigned long long  ullTagsOffset;
+    unsigned long long  ullFilesOffset;
+    unsigned long long  ullStringsOffset;
+    unsigned long long  ullStringsSize;
+    unsigned long long  ullFileSize;
+    unsigned int        uiTagsCrc;
+    unsigned int        uiFilesCrc;
+    unsigned int        uiStringsCrc;
+    unsigned int        uiHeaderCrc;        // CCrc32c of the header, with uiHeaderCrc set to 0
+    unsigned long long  ullReserved;
+};
+
+struct ProfileBinaryTag_t
+{
+    unsigned int        uiHash;             // CProfileIndex::HashName() of the name
+    unsigned int        uiNameOffset;       // Offsets are into the strings section
+    unsigned int        uiNameLength;
+    unsigned int        uiValueOffset;
+    unsigned int        uiValueLength;
+    unsigned int        uiReserved;
+};
+
+struct ProfileBinaryFile_t
+{
+    unsigned long long  ullOffset;          // Offset of the data in the profile
+    unsigned long long  ullSize;
+    unsigned int        uiNameOffset;       // Offset into the strings section
+    unsigned int        uiNameLength;
+    unsigned int        uiCrc;              // CCrc32c of the data
+    unsigned int        uiReserved;
+};
+
+static_assert(sizeof(ProfileBinaryHeader_t) == 80,"ProfileBinaryHeader_t must be 80 bytes");
+static_assert(sizeof(ProfileBinaryTag_t) == 24,"ProfileBinaryTag_t must be 24 bytes");
+static_assert(sizeof(ProfileBinaryFile_t) == 32,"ProfileBinaryFile_t must be 32 bytes");
+
+// ProfileFileView_t -- An embedded file in a binary profile, pointing directly into the mapped profile (valid until Close())
+//
+struct ProfileFileView_t
+{
+    const unsigned char   * pData;
+    int                     iSize;
+
+    bool isValid() const { return pData != nullptr; }
+};
+
+class CProfileBinary
+{
+public:
+    static constexpr unsigned int kVersion      = 1;
+    static constexpr unsigned int kDataAlignment = 64;
+
+private:
+    enum : unsigned char { kUnchecked, kCrcOk, kCrcBad };
+
+    HANDLE                          m_hFile         = INVALID_HANDLE_VALUE;
+    HANDLE                          m_hMapping      = nullptr;
+    const unsigned char           * m_pData         = nullptr;  // Mapped view (or the caller's memory)
+    size_t                          m_szSize        = 0;
+    bool                            m_bMapped       = false;
+
+    const ProfileBinaryHeader_t   * m_pHeader       = nullptr;
+    const ProfileBinaryTag_t      * m_pTags         = nullptr;
+    const ProfileBinaryFile_t     * m_pFiles        = nullptr;
+    const char                    * m_pStrings      = nullptr;
+    const char                    * m_sError        = nullptr;
+
+    std::unique_ptr<std::atomic<unsigned char>[]> m_pFileCrc;  // Per-file CRC state (files are checked on first use)
+
+    static int CompareNoCase(const char * s1,int iLength1,const char * s2,int iLength2)
+    {
+        int iLength = iLength1 < iLength2 ? iLength1 : iLength2;
+        for (int i=0;i<iLength;i++)
+        {
+            int c1 = (unsigned char) s1[i], c2 = (unsigned char) s2[i];
+            if (c1 >= 'A' && c1 <= 'Z') c1 += 'a'-'A';
+            if (c2 >= 'A' && c2 <= 'Z') c2 += 'a'-'A';
+            if (c1 != c2) return c1 - c2;
+        }
+        return iLength1 - iLength2;
+    }
+
+    static bool TagLess(const ProfileBinaryTag_t & st1,const ProfileBinaryTag_t & st2,const char * pStrings)
+    {
+        if (st1.uiHash != st2.uiHash) return st1.uiHash < st2.uiHash;
+        return CompareNoCase(pStrings+st1.uiNameOffset,st1.uiNameLength,pStrings+st2.uiNameOffset,st2.uiNameLength) < 0;
+    }
+
+    bool SetError(const char * sError)
+    {
+        m_sError = sError;
+        return false;
+    }
+
+    // InRange() -- true if [ullOffset,ullOffset+ullSize) is inside a section of szSection bytes
+
+    static bool InRange(unsigned long long ullOffset,unsigned long long ullSize,size_t szSection)
+    {
+        return ullOffset <= szSection && ullSize <= szSection - ullOffset;
+    }
+
+    // OpenData() -- Check the header and tables (and their CRCs) of the profile in m_pData
+
+    bool OpenData()
+    {
+        if (m_szSize < sizeof(ProfileBinaryHeader_t) || memcmp(m_pData,"PRFB",4)) return SetError("Not a binary profile");
+
+        auto & stHeader = *(const ProfileBinaryHeader_t *) m_pData;
+        if (stHeader.uiVersion != kVersion) return SetError("Unsupported binary profile version");
+
+        ProfileBinaryHeader_t stCheck = stHeader;
+        stCheck.uiHeaderCrc = 0;
+        if (CCrc32c::Compute(&stCheck,sizeof(stCheck)) != stHeader.uiHeaderCrc) return SetError("Header CRC does not match");
+        if (stHeader.ullFileSize != m_szSize) return SetError("File size does not match the header (truncated file?)");
+
+        unsigned long long ullTagsSize  = (unsigned long long) stHeader.uiNumTags*sizeof(ProfileBinaryTag_t);
+        unsigned long long ullFilesSize = (unsigned long long) stHeader.uiNumFiles*sizeof(ProfileBinaryFile_t);
+
+        if (!InRange(stHeader.ullTagsOffset,ullTagsSize,m_szSize) || !InRange(stHeader.ullFilesOffset,ullFilesSize,m_szSize) ||
+            !InRange(stHeader.ullStringsOffset,stHeader.ullStringsSize,m_szSize) || stHeader.ullStringsSize > UINT_MAX ||
+            (stHeader.ullTagsOffset | stHeader.ullFilesOffset) & 7)
+            return SetError("Damaged section table");
+
+        m_pTags     = (const ProfileBinaryTag_t *) (m_pData+stHeader.ullTagsOffset);
+        m_pFiles    = (const ProfileBinaryFile_t *) (m_pData+stHeader.ullFilesOffset);
+        m_pStrings  = (const char *) (m_pData+stHeader.ullStringsOffset);
+
+        if (CCrc32c::Compute(m_pTags,ullTagsSize) != stHeader.uiTagsCrc)                     return SetError("Tag table CRC does not match");
+        if (CCrc32c::Compute(m_pFiles,ullFilesSize) != stHeader.uiFilesCrc)                  return SetError("File table CRC does not match");
+        if (CCrc32c::Compute(m_pStrings,stHeader.ullStringsSize) != stHeader.uiStringsCrc)   return SetError("String table CRC does not match");
+
+        // Every name and value must be a null-terminated string inside the strings section
+
+        auto StringOk = [&](unsigned int uiOffset,unsigned int uiLength)
+        {
+            return InRange(uiOffset,(unsigned long long) uiLength+1,stHeader.ullStringsSize) && !m_pStrings[uiOffset+uiLength];
+        };
+
+        for (unsigned int i=0;i<stHeader.uiNumTags;i++)
+        {
+            auto & stTag = m_pTags[i];
+            if (!StringOk(stTag.uiNameOffset,stTag.uiNameLength) || !StringOk(stTag.uiValueOffset,stTag.uiValueLength) ||
+                (i && TagLess(stTag,m_pTags[i-1],m_pStrings)))
+                return SetError("Damaged tag table");
+        }
+        for (unsigned int i=0;i<stHeader.uiNumFiles;i++)
+        {
+            auto & stFile = m_pFiles[i];
+            if (!StringOk(stFile.uiNameOffset,stFile.uiNameLength) || !InRange(stFile.ullOffset,stFile.ullSize,m_szSize) || stFile.ullSize > INT_MAX)
+                return SetError("Damaged file table");
+        }
+
+        m_pFileCrc.reset(new std::atomic<unsigned char>[stHeader.uiNumFiles ? stHeader.uiNumFiles : 1]);
+        for (unsigned int i=0;i<stHeader.uiNumFiles;i++) m_pFileCrc[i] = kUnchecked;
+
+        m_pHeader = &stHeader;
+        return true;
+    }
+
+    static bool WriteWholeFile(const char * sPath,const void * pData,size_t szSize)
+    {
+        FILE * fFile = sPath ? fopen(sPath,"wb") : nullptr;
+        if (!fFile) return false;
+        bool bSuccess = fwrite(pData,1,szSize,fFile) == szSize;
+        return fclose(fFile) == 0 && bSuccess;
+    }
+
+public:
+    CProfileBinary() = default;
+    CProfileBinary(const char * sPath) { Open(sPath); }
+    CProfileBinary(const void * pData,size_t szSize) { Open(pData,szSize); }
+    ~CProfileBinary() { Close(); }
+
+    CProfileBinary(const CProfileBinary &) = delete;
+    CProfileBinary & operator = (const CProfileBinary &) = delete;
+
+    // Open() -- Map a binary profile into memory.  Returns false if the file could not be opened or is damaged
+    // (see GetErrorMessage()).
+    //
+    bool Open(const char * sPath)
+    {
+        Close();
+        if (!sPath) return false;
+
+        m_hFile = CreateFileA(sPath,GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+        if (m_hFile == INVALID_HANDLE_VALUE) return SetError("File not found");
+
+        LARGE_INTEGER stSize;
+        if (!GetFileSizeEx(m_hFile,&stSize) || stSize.QuadPart < (long long) sizeof(ProfileBinaryHeader_t))
+        {
+            Close();
+            return SetError("Not a binary profile");
+        }
+        m_szSize = (size_t) stSize.QuadPart;
+
+        m_hMapping = CreateFileMappingA(m_hFile,nullptr,PAGE_READONLY,0,0,nullptr);
+        if (m_hMapping) m_pData = (const unsigned char *) MapViewOfFile(m_hMapping,FILE_MAP_READ,0,0,0);
+        if (!m_pData) { Close(); return SetError("Could not map file"); }
+
+        m_bMapped = true;
+        if (!OpenData()) { auto sError = m_sError; Close(); return SetError(sError); }
+        return true;
+    }
+
+    // Open() -- Use a binary profile already in memory (8-byte aligned).  The memory must remain valid until Close().
+    //
+    bool Open(const void * pData,size_t szSize)
+    {
+        Close();
+        if (!pData || ((size_t) pData & 7)) return SetError("Invalid memory");
+
+        m_pData  = (const unsigned char *) pData;
+        m_szSize = szSize;
+        if (!OpenData()) { auto sError = m_sError; Close(); return SetError(sError); }
+        return true;
+    }
+
+    void Close()
+    {
+        if (m_bMapped && m_pData) UnmapViewOfFile((void *) m_pData);
+        if (m_hMapping) CloseHandle(m_hMapping);
+        if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+
+        m_hFile     = INVALID_HANDLE_VALUE;
+        m_hMapping  = nullptr;
+        m_pData     = nullptr;
+        m_szSize    = 0;
+        m_bMapped   = false;
+        m_pHeader   = nullptr;
+        m_pTags     = nullptr;
+        m_pFiles    = nullptr;
+        m_pStrings  = nullptr;
+        m_sError    = nullptr;
+        m_pFileCrc.reset();
+    }
+
+    bool isValid() const { return m_pHeader != nullptr; }
+
+    // isBinaryProfile() -- true if the memory starts with a binary profile header (use this to choose between CProfileIndex
+    // and CProfileBinary)
+    //
+    static bool isBinaryProfile(const void * pData,size_t szSize)
+    {
+        return pData && szSize >= sizeof(ProfileBinaryHeader_t) && !memcmp(pData,"PRFB",4);
+    }
+
+    const char * GetErrorMessage() const { return m_sError; }
+
+    int GetNumTags() const { return m_pHeader ? (int) m_pHeader->uiNumTags : 0; }
+    int GetNumFiles() const { return m_pHeader ? (int) m_pHeader->uiNumFiles : 0; }
+
+    // GetTag() -- Tags in table order (sorted by name hash)
+    //
+    const ProfileBinaryTag_t & GetTag(int iTag) const { return m_pTags[iTag]; }
+    const char * GetTagName(const ProfileBinaryTag_t & stTag) const { return m_pStrings+stTag.uiNameOffset; }
+    const char * GetTagValue(const ProfileBinaryTag_t & stTag) const { return m_pStrings+stTag.uiValueOffset; }
+
+    const ProfileBinaryFile_t & GetFile(int iFile) const { return m_pFiles[iFile]; }
+    const char * GetFileName(const ProfileBinaryFile_t & stFile) const { return m_pStrings+stFile.uiNameOffset; }
+
+    // Find() -- Find a tag by name ("Section.Tag" for tags in a section; not case-sensitive).  Returns nullptr if the tag is
+    // not in the profile.
+    //
+    const ProfileBinaryTag_t * Find(const char * sTag) const
+    {
+        if (!sTag || !m_pHeader) return nullptr;
+
+        int iLength = (int) strlen(sTag);
+        unsigned int uiHash = CProfileIndex::HashName(sTag,iLength);
+
+        auto pEnd = m_pTags + m_pHeader->uiNumTags;
+        auto pTag = std::lower_bound(m_pTags,pEnd,uiHash,[](const ProfileBinaryTag_t & stTag,unsigned int uiValue) { return stTag.uiHash < uiValue; });
+
+        for (;pTag < pEnd && pTag->uiHash == uiHash;pTag++)
+            if (!CompareNoCase(m_pStrings+pTag->uiNameOffset,pTag->uiNameLength,sTag,iLength)) return pTag;
+        return nullptr;
+    }
+
+    bool TagExists(const char * sTag) const { return Find(sTag) != nullptr; }
+
+    // GetText() -- The value of a tag as a null-terminated string in the mapped profile (no copy).  Returns sDefault if the
+    // tag is not found.
+    //
+    const char * GetText(const char * sTag,const char * sDefault = nullptr) const
+    {
+        auto pTag = Find(sTag);
+        return pTag ? m_pStrings+pTag->uiValueOffset : sDefault;
+    }
+
+    // GetView() -- The value of a tag as a span (for the CProfileIndex::To...() conversions).  Check isValid() on the result.
+    //
+    ProfileSpan_t GetView(const char * sTag) const
+    {
+        auto pTag = Find(sTag);
+        return pTag ? ProfileSpan_t{ m_pStrings+pTag->uiValueOffset,(int) pTag->uiValueLength,false } : ProfileSpan_t{};
+    }
+
+    CString GetString(const char * sTag,const char * sDefault = nullptr) const
+    {
+        auto sText = GetText(sTag,sDefault);
+        return CString(sText ? sText : "");
+    }
+
+    int CopyString(const char * sTag,char * sDest,int iMaxLength) const { return CProfileIndex::CopyValue(GetView(sTag),sDest,iMaxLength); }
+    int GetInteger(const char * sTag,int iDefault = 0,bool * bSuccess = nullptr) const { return CProfileIndex::ToInteger(GetView(sTag),iDefault,bSuccess); }
+    double GetFloat(const char * sTag,double fDefault = 0,bool * bSuccess = nullptr) const { return CProfileIndex::ToFloat(GetView(sTag),fDefault,bSuccess); }
+    bool GetBool(const char * sTag,bool bDefault = false,bool * bSuccess = nullptr) const { return CProfileIndex::ToBool(GetView(sTag),bDefault,bSuccess); }
+    CfPoint GetCfPoint(const char * sTag,CfPoint cfDefault = CfPoint{},bool * bSuccess = nullptr) const { return CProfileIndex::ToCfPoint(GetView(sTag),cfDefault,bSuccess); }
+
+    // GetFileData() -- An embedded file, as a view into the mapped profile (no copy).  The file's CRC is checked the first
+    // time it is used.  Returns an invalid view (and *bSuccess = false) if the file is not found or its CRC does not match.
+    //
+    ProfileFileView_t GetFileData(const char * sFilename,bool * bSuccess = nullptr) const
+    {
+        if (bSuccess) *bSuccess = false;
+        if (!sFilename || !m_pHeader) return {};
+
+        int iLength = (int) strlen(sFilename);
+        for (unsigned int i=0;i<m_pHeader->uiNumFiles;i++)
+        {
+            auto & stFile = m_pFiles[i];
+            if (CompareNoCase(m_pStrings+stFile.uiNameOffset,stFile.uiNameLength,sFilename,iLength)) continue;
+
+            auto pData = m_pData+stFile.ullOffset;
+            unsigned char ucState = m_pFileCrc[i];
+            if (ucState == kUnchecked)
+            {
+                ucState = CCrc32c::Compute(pData,(size_t) stFile.ullSize) == stFile.uiCrc ? kCrcOk : kCrcBad;
+                m_pFileCrc[i] = ucState;
+            }
+            if (ucState != kCrcOk) return {};
+
+            if (bSuccess) *bSuccess = true;
+            return { pData,(int) stFile.ullSize };
+        }
+        return {};
+    }
+
+    // Build() -- Create a binary profile from tags (full names and unescaped values) and files.  Tags with the same name
+    // (not case-sensitive) keep the first value.
+    //
+    struct BuildFile_t
+    {
+        std::string     sName;
+        const void    * pData;
+        int             iSize;
+    };
+
+    static bool Build(const std::vector<std::pair<std::string,std::string>> & vTags,const std::vector<BuildFile_t> & vFiles,
+                      std::vector<unsigned char> & vOut)
+    {
+        std::vector<char> vStrings;
+        std::vector<ProfileBinaryTag_t> vTable;
+        std::vector<ProfileBinaryFile_t> vFileTable(vFiles.size());
+        vTable.reserve(vTags.size());
+
+        auto AddString = [&](const std::string & sString)
+        {
+            auto uiOffset = (unsigned int) vStrings.size();
+            vStrings.insert(vStrings.end(),sString.begin(),sString.end());
+            vStrings.push_back(0);
+            return uiOffset;
+        };
+
+        // Sort by hash, keeping the first of any duplicate names (a stable sort keeps profile order among equal names).
+        // Strings are stored in table order, so the output does not depend on the order of vTags.
+
+        using TagRef_t = std::pair<unsigned int,const std::pair<std::string,std::string> *>;
+        std::vector<TagRef_t> vSorted;
+        vSorted.reserve(vTags.size());
+        for (auto & stTag : vTags) vSorted.emplace_back(CProfileIndex::HashName(stTag.first.data(),(int) stTag.first.size()),&stTag);
+
+        auto Less = [](const TagRef_t & st1,const TagRef_t & st2)
+        {
+            if (st1.first != st2.first) return st1.first < st2.first;
+            auto & s1 = st1.second->first;
+            auto & s2 = st2.second->first;
+            return CompareNoCase(s1.data(),(int) s1.size(),s2.data(),(int) s2.size()) < 0;
+        };
+        std::stable_sort(vSorted.begin(),vSorted.end(),Less);
+        vSorted.erase(std::unique(vSorted.begin(),vSorted.end(),[&](auto & st1,auto & st2) { return !Less(st1,st2) && !Less(st2,st1); }),vSorted.end());
+
+        for (auto & stSorted : vSorted)
+        {
+            auto & stTag = *stSorted.second;
+
+            ProfileBinaryTag_t stEntry{};
+            stEntry.uiHash          = stSorted.first;
+            stEntry.uiNameOffset    = AddString(stTag.first);
+            stEntry.uiNameLength    = (unsigned int) stTag.first.size();
+            stEntry.uiValueOffset   = AddString(stTag.second);
+            stEntry.uiValueLength   = (unsigned int) stTag.second.size();
+            vTable.push_back(stEntry);
+            if (vStrings.size() > UINT_MAX) return false;
+        }
+        for (size_t i=0;i<vFiles.size();i++)
+        {
+            if (vFiles[i].iSize < 0 || (vFiles[i].iSize && !vFiles[i].pData)) return false;
+            vFileTable[i].uiNameOffset  = AddString(vFiles[i].sName);
+            vFileTable[i].uiNameLength  = (unsigned int) vFiles[i].sName.size();
+            vFileTable[i].ullSize       = (unsigned long long) vFiles[i].iSize;
+            vFileTable[i].uiCrc         = CCrc32c::Compute(vFiles[i].pData,vFiles[i].iSize);
+        }
+
+        // Layout
+
+        auto Align = [](size_t szOffset,size_t szAlign) { return (szOffset + szAlign-1) & ~(szAlign-1); };
+
+        ProfileBinaryHeader_t stHeader{};
+        memcpy(stHeader.sMagic,"PRFB",4);
+        stHeader.uiVersion          = kVersion;
+        stHeader.uiNumTags          = (unsigned int) vTable.size();
+        stHeader.uiNumFiles         = (unsigned int) vFileTable.size();
+        stHeader.ullTagsOffset      = sizeof(ProfileBinaryHeader_t);
+        stHeader.ullFilesOffset     = stHeader.ullTagsOffset + vTable.size()*sizeof(ProfileBinaryTag_t);
+        stHeader.ullStringsOffset   = stHeader.ullFilesOffset + vFileTable.size()*sizeof(ProfileBinaryFile_t);
+        stHeader.ullStringsSize     = vStrings.size();
+
+        size_t szOffset = (size_t) (stHeader.ullStringsOffset + stHeader.ullStringsSize);
+        for (auto & stFile : vFileTable)
+        {
+            szOffset = Align(szOffset,kDataAlignment);
+            stFile.ullOffset = szOffset;
+            szOffset += (size_t) stFile.ullSize;
+        }
+        stHeader.ullFileSize = szOffset;
+
+        stHeader.uiTagsCrc      = CCrc32c::Compute(vTable.data(),vTable.size()*sizeof(ProfileBinaryTag_t));
+        stHeader.uiFilesCrc     = CCrc32c::Compute(vFileTable.data(),vFileTable.size()*sizeof(ProfileBinaryFile_t));
+        stHeader.uiStringsCrc   = CCrc32c::Compute(vStrings.data(),vStrings.size());
+        stHeader.uiHeaderCrc    = CCrc32c::Compute(&stHeader,sizeof(stHeader));
+
+        vOut.assign(szOffset,0);
+        memcpy(vOut.data(),&stHeader,sizeof(stHeader));
+        if (!vTable.empty()) memcpy(vOut.data()+stHeader.ullTagsOffset,vTable.data(),vTable.size()*sizeof(ProfileBinaryTag_t));
+        if (!vFileTable.empty()) memcpy(vOut.data()+stHeader.ullFilesOffset,vFileTable.data(),vFileTable.size()*sizeof(ProfileBinaryFile_t));
+        if (!vStrings.empty()) memcpy(vOut.data()+stHeader.ullStringsOffset,vStrings.data(),vStrings.size());
+        for (size_t i=0;i<vFiles.size();i++)
+            if (vFiles[i].iSize) memcpy(vOut.data()+vFileTable[i].ullOffset,vFiles[i].pData,vFiles[i].iSize);
+
+        return true;
+    }
+
+    // FromText() -- Create a binary profile from a text profile.  Returns false if an embedded file is damaged.
+    //
+    static bool FromText(const CProfileIndex & cText,std::vector<unsigned char> & vOut)
+    {
+        std::vector<std::pair<std::string,std::string>> vTags;
+        vTags.reserve(cText.GetNumTags());
+        for (auto & stTag : cText.GetTags()) vTags.emplace_back(cText.GetName(stTag),CProfileIndex::ToString(cText.GetView(stTag)));
+
+        std::vector<std::vector<unsigned char>> vData(cText.GetNumFiles());
+        std::vector<BuildFile_t> vFiles;
+        for (int i=0;i<cText.GetNumFiles();i++)
+        {
+            auto & stFile = cText.GetFiles()[i];
+            vData[i].resize(stFile.iSize);
+            if (!cText.DecodeFile(stFile,vData[i].data())) return false;
+            vFiles.push_back({ cText.GetFileName(stFile),vData[i].data(),stFile.iSize });
+        }
+        return Build(vTags,vFiles,vOut);
+    }
+
+    // ToText() -- Write the profile as text.  Tags are sorted by name and grouped by section (the part of the name before
+    // the first '.'), followed by the embedded files.
+    //
+    bool ToText(CProfileWriter & cWriter) const
+    {
+        if (!m_pHeader || !cWriter.isValid()) return false;
+
+        auto SectionLength = [&](const ProfileBinaryTag_t & stTag)
+        {
+            auto pDot = (const char *) memchr(m_pStrings+stTag.uiNameOffset,'.',stTag.uiNameLength);
+            return pDot ? (int) (pDot - (m_pStrings+stTag.uiNameOffset)) : 0;
+        };
+
+        // Tags without a section come first (they can't follow a [Section])
+
+        std::vector<const ProfileBinaryTag_t *> vSorted(m_pHeader->uiNumTags);
+        for (unsigned int i=0;i<m_pHeader->uiNumTags;i++) vSorted[i] = m_pTags+i;
+        std::sort(vSorted.begin(),vSorted.end(),[&](auto p1,auto p2)
+        {
+            bool bSection1 = SectionLength(*p1) > 0, bSection2 = SectionLength(*p2) > 0;
+            if (bSection1 != bSection2) return bSection2;
+            return CompareNoCase(m_pStrings+p1->uiNameOffset,p1->uiNameLength,m_pStrings+p2->uiNameOffset,p2->uiNameLength) < 0;
+        });
+
+        std::string sSection;
+        for (auto pTag : vSorted)
+        {
+            auto sName = m_pStrings+pTag->uiNameOffset;
+            int iSection = SectionLength(*pTag);
+            if (iSection && CompareNoCase(sSection.data(),(int) sSection.size(),sName,iSection))
+            {
+                sSection.assign(sName,iSection);
+                cWriter.Section(sSection.c_str());
+            }
+            cWriter.PutString(iSection ? sName+iSection+1 : sName,m_pStrings+pTag->uiValueOffset);
+        }
+
+        for (unsigned int i=0;i<m_pHeader->uiNumFiles;i++)
+        {
+            bool bSuccess;
+            auto sName = m_pStrings+m_pFiles[i].uiNameOffset;
+            auto stView = GetFileData(sName,&bSuccess);
+            if (!bSuccess) return false;
+            if (i == 0) cWriter.Write("\n",1);
+            cWriter.PutFile(sName,stView.pData,stView.iSize);
+        }
+        return true;
+    }
+
+    // ConvertText() -- Convert a text profile file to a binary profile file
+    //
+    static bool ConvertText(const char * sTextPath,const char * sBinaryPath)
+    {
+        CProfileIndex cText(sTextPath);
+        std::vector<unsigned char> vOut;
+        return cText.isValid() && FromText(cText,vOut) && WriteWholeFile(sBinaryPath,vOut.data(),vOut.size());
+    }
+
+    // ConvertBinary() -- Convert a binary profile file to a text profile file
+    //
+    static bool ConvertBinary(const char * sBinaryPath,const char * sTextPath)
+    {
+        CProfileBinary cBinary(sBinaryPath);
+        CProfileWriter cWriter;
+        if (!cBinary.isValid() || !cWriter.Open(sTextPath)) return false;
+
+        bool bSuccess = cBinary.ToText(cWriter);
+        return cWriter.Close() && bSuccess;
+    }
+};
+
+}; // namespace Sage
+#endif // _CProfileBinary_H_
@@ -0,0 +1,1040 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CProfileIndex -- Single-pass, indexed reader for text profiles, and CProfileWriter, a streaming profile writer.
+//
+// CProfiles (Cprofiles2.h) cleans and re-parses the profile image when it is read, then looks up each tag by scanning the
+// text (GetTagPointer()/CopyTag()), copying through fixed buffers (m_sTag, m_sTempString).  With thousands of tags per file
+// this makes reading a profile O(tags * file size).
+//
+// CProfileIndex maps the profile file (or uses memory supplied by the caller) and tokenizes it once, building a hash index
+// of tag names to value spans in the mapped text.  Lookups are O(1), and the typed getters (GetInteger(), GetFloat(),
+// GetBool(), GetCfPoint()) parse the value in place without copying.  GetView() returns the value itself as a span into
+// the mapped text.
+//
+// The text format below is a new format, defined by this file.  It is not the CProfiles format: CProfileIndex does not
+// parse CProfiles files, and CProfiles is not expected to read CProfileWriter output.  Existing CProfiles files must be
+// converted (or kept on CProfiles) rather than opened with CProfileIndex.
+//
+// Profile text format:
+//
+//      // Comment to the end of the line
+//      /* Comment,
+//         which may span lines */
+//
+//      Tag = Value to the end of the line              Leading and trailing whitespace is removed
+//      Tag = Value   // Comment                        "//" after whitespace ends an unquoted value ("http://" does not)
+//      Tag = "Quoted value"                            May span lines; \" \\ \n \r and \t are escapes
+//
+//      [Section]                                       Tags that follow are named "Section.Tag"
+//      Width = 640
+//
+//      #file "Mask.bmp" 12345 0x1A2B3C4D               Embedded data file: name, size and CRC-32C, followed by
+//      Qk02AAAAAAAAADYAAAAoAAAA...                     the data in base64 lines, up to #end
+//      #end
+//
+// Tag names are not case-sensitive.  If a tag appears more than once, the first one is used (as with GetTagPointer()).
+// Embedded files are skipped over when the profile is read, and decoded (and their CRC checked) by GetFileData().
+//
+// CProfileWriter writes the same format, streaming through one 64K buffer to the file (or to memory) rather than building
+// the output in m_sOutputBuffers.
+//
+// Basic usage:
+//
+//      CProfileIndex cProfile("Presets.txt");
+//
+//      int iWidth      = cProfile.GetInteger("Window.Width",640);
+//      double fGamma   = cProfile.GetFloat("Gamma",2.2);
+//      CString csTitle = cProfile.GetString("Title");
+//
+//      CProfileWriter cOut("Presets.txt");
+//      cOut.Section("Window");
+//      cOut.PutInteger("Width",iWidth);
+//      cOut.Close();
+//
+#if !defined(_CProfileIndex_H_)
+#define _CProfileIndex_H_
+
+#include <Windows.h>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CString.h"
+#include "CPoint.h"
+#include "CMemClass.h"
+#include "CCrc32c.h"
+
+namespace Sage
+{
+
+// ProfileSpan_t -- A value in a profile, pointing directly into the profile text (valid until CProfileIndex::Close()).
+//
+// Quoted values point to the text between the quotes; bEscaped is set when the text contains escapes (GetString()
+// removes them).
+//
+struct ProfileSpan_t
+{
+    const char    * pData;
+    int             iLength;
+    bool            bEscaped;
+
+    bool isValid() const { return pData != nullptr; }
+};
+
+class CProfileIndex
+{
+public:
+    struct Tag_t
+    {
+        int             iSection;       // Offset of the section name in the text (iSectionLength is 0 outside a section)
+        int             iSectionLength;
+        int             iName;          // Offset of the tag name in the text
+        int             iNameLength;
+        int             iValue;         // Offset of the value in the text
+        int             iValueLength;
+        unsigned int    uiHash;
+        bool            bQuoted;
+        bool            bEscaped;
+    };
+
+    struct File_t
+    {
+        int             iName;          // Offset of the file name in the text
+        int             iNameLength;
+        int             iData;          // Offset of the base64 data lines in the text
+        int             iDataLength;
+        int             iSize;          // Size of the file
+        unsigned int    uiCrc;          // CCrc32c of the file
+    };
+
+private:
+    HANDLE                      m_hFile         = INVALID_HANDLE_VALUE;
+    HANDLE                      m_hMapping      = nullptr;
+    const char                * m_pText         = nullptr;      // Mapped view (or the caller's memory)
+    int                         m_iSize         = 0;
+    bool                        m_bMapped       = false;
+
+    std::vector<Tag_t>          m_vTags;                        // In file order
+    std::vector<int>            m_vIndex;                       // Open-addressed, power-of-2 size; m_vTags index + 1, or 0 for an empty slot
+    std::vector<File_t>         m_vFiles;                       // Embedded files, in file order
+
+    int                         m_iErrorLine    = 0;
+    const char                * m_sError        = nullptr;
+
+    static unsigned char Lower(unsigned char c) { return c >= 'A' && c <= 'Z' ? c + ('a'-'A') : c; }
+
+    // Case-insensitive FNV-1a, computed in pieces so "Section" + "." + "Tag" hashes the same as "Section.Tag"
+
+    static unsigned int HashAdd(unsigned int uiHash,const char * s,int iLength)
+    {
+        for (int i=0;i<iLength;i++) uiHash = (uiHash ^ Lower((unsigned char) s[i]))*16777619u;
+        return uiHash;
+    }
+
+    static constexpr unsigned int kHashStart = 2166136261u;
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t'; }
+    static bool isLineEnd(char c) { return c == '\n' || c == '\r'; }
+
+    static bool EqualNoCase(const char * s1,const char * s2,int iLength)
+    {
+        for (int i=0;i<iLength;i++) if (Lower((unsigned char) s1[i]) != Lower((unsigned char) s2[i])) return false;
+        return true;
+    }
+
+    bool Matches(const Tag_t & stTag,const char * sTag,int iLength) const
+    {
+        if (stTag.iSectionLength)
+        {
+            if (iLength != stTag.iSectionLength + 1 + stTag.iNameLength || sTag[stTag.iSectionLength] != '.') return false;
+            return EqualNoCase(m_pText+stTag.iSection,sTag,stTag.iSectionLength) &&
+                   EqualNoCase(m_pText+stTag.iName,sTag+stTag.iSectionLength+1,stTag.iNameLength);
+        }
+        return iLength == stTag.iNameLength && EqualNoCase(m_pText+stTag.iName,sTag,iLength);
+    }
+
+    bool SetError(const char * sError,const char * p)
+    {
+        m_sError = sError;
+        m_iErrorLine = 1;
+        for (const char * s = m_pText;s < p;s++) if (*s == '\n') m_iErrorLine++;
+        return false;
+    }
+
+    // SkipBlank() -- Skip whitespace, line ends and comments.  Returns false for an unterminated /* comment.
+
+    bool SkipBlank(const char * & p,const char * pEnd,bool bLineOnly)
+    {
+        while (p < pEnd)
+        {
+            if (isSpace(*p) || (!bLineOnly && isLineEnd(*p))) { p++; continue; }
+            if (*p == '/' && p+1 < pEnd && p[1] == '/')
+            {
+                while (p < pEnd && !isLineEnd(*p)) p++;
+                continue;
+            }
+            if (*p == '/' && p+1 < pEnd && p[1] == '*')
+            {
+                const char * pStart = p;
+                for (p += 2;p+1 < pEnd && !(p[0] == '*' && p[1] == '/');p++);
+                if (p+1 >= pEnd) { p = pStart; return false; }
+                p += 2;
+                continue;
+            }
+            break;
+        }
+        return true;
+    }
+
+    // Parse() -- Tokenize the text once, recording each tag and building the hash index.
+
+    bool Parse()
+    {
+        const char * p      = m_pText;
+        const char * pEnd   = m_pText + m_iSize;
+
+        // Skip a UTF-8 byte order mark
+
+        if (m_iSize >= 3 && !memcmp(p,"\xEF\xBB\xBF",3)) p += 3;
+
+        m_vTags.reserve(m_iSize/32);
+
+        int iSection        = 0;
+        int iSectionLength  = 0;
+        unsigned int uiSectionHash = kHashStart;
+
+        for (;;)
+        {
+            if (!SkipBlank(p,pEnd,false)) return SetError("Unterminated /* comment",p);
+            if (p >= pEnd) break;
+
+            if (*p == '#')
+            {
+                if (!ParseFile(p,pEnd)) return false;
+                continue;
+            }
+
+            if (*p == '[')
+            {
+                const char * pName = ++p;
+                while (p < pEnd && *p != ']' && !isLineEnd(*p)) p++;
+                if (p >= pEnd || *p != ']') return SetError("Missing ']' after section name",pName);
+
+                const char * pNameEnd = p++;
+                while (pName < pNameEnd && isSpace(*pName)) pName++;
+                while (pNameEnd > pName && isSpace(pNameEnd[-1])) pNameEnd--;
+
+                iSection        = (int) (pName - m_pText);
+                iSectionLength  = (int) (pNameEnd - pName);
+                uiSectionHash   = iSectionLength ? HashAdd(HashAdd(kHashStart,pName,iSectionLength),".",1) : kHashStart;
+
+                if (!SkipBlank(p,pEnd,true)) return SetError("Unterminated /* comment",p);
+                if (p < pEnd && !isLineEnd(*p)) return SetError("Unexpected text after section name",p);
+                continue;
+            }
+
+            // Tag name
+
+            const char * pName = p;
+            while (p < pEnd && *p != '=' && !isLineEnd(*p)) p++;
+            if (p >= pEnd || *p != '=') return SetError("Missing '=' after tag name",pName);
+
+            const char * pNameEnd = p++;
+            while (pNameEnd > pName && isSpace(pNameEnd[-1])) pNameEnd--;
+            if (pNameEnd == pName) return SetError("Missing tag name before '='",pName);
+
+            Tag_t stTag{};
+            stTag.iSection          = iSection;
+            stTag.iSectionLength    = iSectionLength;
+            stTag.iName             = (int) (pName - m_pText);
+            stTag.iNameLength       = (int) (pNameEnd - pName);
+            stTag.uiHash            = HashAdd(uiSectionHash,pName,stTag.iNameLength);
+
+            // Value
+
+            while (p < pEnd && isSpace(*p)) p++;
+
+            if (p < pEnd && *p == '"')
+            {
+                const char * pValue = ++p;
+                for (;p < pEnd && *p != '"';p++)
+                {
+                    if (*p == '\\')
+                    {
+                        stTag.bEscaped = true;
+                        if (++p >= pEnd) break;
+                    }
+                }
+                if (p >= pEnd) return SetError("Unterminated quoted value",pValue-1);
+
+                stTag.bQuoted       = true;
+                stTag.iValue        = (int) (pValue - m_pText);
+                stTag.iValueLength  = (int) (p++ - pValue);
+
+                if (!SkipBlank(p,pEnd,true)) return SetError("Unterminated /* comment",p);
+                if (p < pEnd && !isLineEnd(*p)) return SetError("Unexpected text after quoted value",p);
+            }
+            else
+            {
+                // A "//" at the start of the value or after whitespace starts a comment
+
+                const char * pValue = p;
+                const char * pValueEnd = nullptr;
+                for (;p < pEnd && !isLineEnd(*p);p++)
+                    if (!pValueEnd && *p == '/' && p+1 < pEnd && p[1] == '/' && (p == pValue || isSpace(p[-1]))) pValueEnd = p;
+
+                if (!pValueEnd) pValueEnd = p;
+                while (pValueEnd > pValue && isSpace(pValueEnd[-1])) pValueEnd--;
+
+                stTag.iValue        = (int) (pValue - m_pText);
+                stTag.iValueLength  = (int) (pValueEnd - pValue);
+            }
+
+            m_vTags.push_back(stTag);
+        }
+
+        BuildIndex();
+        return true;
+    }
+
+    // ParseFile() -- Record an embedded file (#file "Name" Size Crc, base64 lines, #end) without decoding it
+
+    bool ParseFile(const char * & p,const char * pEnd)
+    {
+        if (pEnd-p < 6 || memcmp(p,"#file",5) || !isSpace(p[5])) return SetError("Unknown directive (expected #file)",p);
+        p += 5;
+        while (p < pEnd && isSpace(*p)) p++;
+
+        if (p >= pEnd || *p != '"') return SetError("Missing quoted file name after #file",p);
+        const char * pName = ++p;
+        while (p < pEnd && *p != '"' && !isLineEnd(*p)) p++;
+        if (p >= pEnd || *p != '"' || p == pName) return SetError("Missing file name after #file",pName);
+
+        File_t stFile{};
+        stFile.iName        = (int) (pName - m_pText);
+        stFile.iNameLength  = (int) (p++ - pName);
+
+        while (p < pEnd && isSpace(*p)) p++;
+        unsigned int uiSize;
+        if (!ParseUnsigned(p,pEnd,uiSize,10,INT_MAX)) return SetError("Missing file size after #file name",p);
+        stFile.iSize = (int) uiSize;
+
+        while (p < pEnd && isSpace(*p)) p++;
+        if (pEnd-p < 2 || p[0] != '0' || (p[1] != 'x' && p[1] != 'X')) return SetError("Missing CRC after #file size",p);
+        const char * pCrc = p;
+        p += 2;
+        if (!ParseUnsigned(p,pEnd,stFile.uiCrc,16,UINT_MAX)) return SetError("Missing CRC after #file size",pCrc);
+
+        if (!SkipBlank(p,pEnd,true)) return SetError("Unterminated /* comment",p);
+        if (p < pEnd && !isLineEnd(*p)) return SetError("Unexpected text after #file",p);
+
+        // Data lines, up to a line starting with #end
+
+        if (p < pEnd && *p == '\r') p++;
+        if (p < pEnd && *p == '\n') p++;
+        stFile.iData = (int) (p - m_pText);
+
+        for (;;)
+        {
+            if (p >= pEnd) return SetError("Missing #end after #file data",m_pText+stFile.iName);
+            if (pEnd-p >= 4 && !memcmp(p,"#end",4)) break;
+            auto pLineEnd = (const char *) memchr(p,'\n',pEnd-p);
+            p = pLineEnd ? pLineEnd+1 : pEnd;
+        }
+        stFile.iDataLength = (int) (p - m_pText) - stFile.iData;
+        p += 4;
+
+        m_vFiles.push_back(stFile);
+        return true;
+    }
+
+    void BuildIndex()
+    {
+        size_t szSlots = 16;
+        while (szSlots < m_vTags.size()*2) szSlots <<= 1;
+        m_vIndex.assign(szSlots,0);
+
+        size_t szMask = szSlots-1;
+        for (int i=0;i<(int) m_vTags.size();i++)
+        {
+            auto & stTag = m_vTags[i];
+            size_t szSlot = stTag.uiHash & szMask;
+
+            // Keep the first occurrence of a tag
+
+            bool bDuplicate = false;
+            for (;m_vIndex[szSlot];szSlot = (szSlot+1) & szMask)
+            {
+                auto & stOther = m_vTags[m_vIndex[szSlot]-1];
+                if (stOther.uiHash != stTag.uiHash) continue;
+
+                std::string sName = GetName(stOther);
+                if (Matches(stTag,sName.c_str(),(int) sName.size())) { bDuplicate = true; break; }
+            }
+            if (!bDuplicate) m_vIndex[szSlot] = i+1;
+        }
+    }
+
+    bool OpenText()
+    {
+        if (!Parse())
+        {
+            m_vTags.clear();
+            m_vIndex.clear();
+            m_vFiles.clear();
+            return false;
+        }
+        return true;
+    }
+
+    // Unescape() -- Append a quoted value to sOut, removing escapes
+
+    static void Unescape(const ProfileSpan_t & stSpan,std::string & sOut)
+    {
+        if (!stSpan.bEscaped) { sOut.append(stSpan.pData,stSpan.iLength); return; }
+
+        for (int i=0;i<stSpan.iLength;i++)
+        {
+            char c = stSpan.pData[i];
+            if (c == '\\' && i+1 < stSpan.iLength)
+            {
+                switch (c = stSpan.pData[++i])
+                {
+                    case 'n': c = '\n'; break;
+                    case 'r': c = '\r'; break;
+                    case 't': c = '\t'; break;
+                    default: break;
+                }
+            }
+            sOut += c;
+        }
+    }
+
+    // DecodeBase64() -- Decode base64 text (skipping line ends and whitespace) into pDest.  Returns false if the text is
+    // not base64 or does not decode to exactly szSize bytes.
+
+    static bool DecodeBase64(const char * pText,int iLength,unsigned char * pDest,size_t szSize)
+    {
+        static const signed char * pTable = []
+        {
+            static signed char cTable[256];
+            memset(cTable,-1,sizeof(cTable));
+            for (int i=0;i<64;i++) cTable[(unsigned char) "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"[i]] = (signed char) i;
+            return cTable;
+        }();
+
+        size_t szOut = 0;
+        unsigned int uiBits = 0;
+        int iBits = 0;
+        for (int i=0;i<iLength;i++)
+        {
+            unsigned char c = (unsigned char) pText[i];
+            if (c == '=') break;
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+            if (pTable[c] < 0) return false;
+
+            uiBits = (uiBits << 6) | pTable[c];
+            if ((iBits += 6) >= 8)
+            {
+                iBits -= 8;
+                if (szOut >= szSize) return false;
+                pDest[szOut++] = (unsigned char) (uiBits >> iBits);
+            }
+        }
+        return szOut == szSize;
+    }
+
+    // ParseUnsigned() -- Parse the digits at p (no sign) in base 10 or 16, up to uiMax.  p is moved past the digits.
+    // Returns false (with p unchanged) if there are no digits or the value is more than uiMax.
+    //
+    static bool ParseUnsigned(const char * & p,const char * pEnd,unsigned int & uiValue,int iBase,unsigned int uiMax)
+    {
+        const char * s = p;
+        unsigned long long ullValue = 0;
+        for (;s < pEnd;s++)
+        {
+            int iDigit = *s >= '0' && *s <= '9' ? *s - '0' : iBase == 16 && *s >= 'a' && *s <= 'f' ? *s - 'a' + 10 :
+                         iBase == 16 && *s >= 'A' && *s <= 'F' ? *s - 'A' + 10 : -1;
+            if (iDigit < 0) break;
+            ullValue = ullValue*iBase + iDigit;
+            if (ullValue > uiMax) return false;
+        }
+        if (s == p) return false;
+
+        uiValue = (unsigned int) ullValue;
+        p = s;
+        return true;
+    }
+
+    static bool ParseDouble(const char * & p,const char * pEnd,double & fValue)
+    {
+        char sNumber[64];
+        while (p < pEnd && isSpace(*p)) p++;
+
+        int iLength = 0;
+        while (p+iLength < pEnd && iLength < (int) sizeof(sNumber)-1 && !isSpace(p[iLength]) && p[iLength] != ',' && p[iLength] != ')' && p[iLength] != '}') iLength++;
+        if (!iLength) return false;
+
+        memcpy(sNumber,p,iLength);
+        sNumber[iLength] = 0;
+
+        char * sEnd;
+        fValue = strtod(sNumber,&sEnd);
+        if (sEnd != sNumber+iLength) return false;
+        p += iLength;
+        return true;
+    }
+
+public:
+    CProfileIndex() = default;
+    CProfileIndex(const char * sPath) { Open(sPath); }
+    CProfileIndex(const char * pText,int iLength) { Open(pText,iLength); }
+    ~CProfileIndex() { Close(); }
+
+    CProfileIndex(const CProfileIndex &) = delete;
+    CProfileIndex & operator = (const CProfileIndex &) = delete;
+
+    // Open() -- Map a profile file into memory and index it.  Returns false if the file could not be opened or has a
+    // format error (see GetErrorMessage()).
+    //
+    bool Open(const char * sPath)
+    {
+        Close();
+        if (!sPath) return false;
+
+        m_hFile = CreateFileA(sPath,GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,nullptr);
+        if (m_hFile == INVALID_HANDLE_VALUE) { m_sError = "File not found"; return false; }
+
+        LARGE_INTEGER stSize;
+        if (!GetFileSizeEx(m_hFile,&stSize) || stSize.QuadPart < 0 || stSize.QuadPart > INT_MAX) { Close(); m_sError = "File too large"; return false; }
+        m_iSize = (int) stSize.QuadPart;
+
+        // An empty file is a valid (empty) profile, but can't be mapped
+
+        if (!m_iSize) { m_pText = ""; return true; }
+
+        m_hMapping = CreateFileMappingA(m_hFile,nullptr,PAGE_READONLY,0,0,nullptr);
+        if (m_hMapping) m_pText = (const char *) MapViewOfFile(m_hMapping,FILE_MAP_READ,0,0,0);
+        if (!m_pText) { Close(); m_sError = "Could not map file"; return false; }
+
+        m_bMapped = true;
+        return OpenText();
+    }
+
+    // Open() -- Use profile text already in memory.  The memory must remain valid until Close().
+    //
+    bool Open(const char * pText,int iLength)
+    {
+        Close();
+        if (!pText || iLength < 0) return false;
+        m_pText = pText;
+        m_iSize = iLength;
+        return OpenText();
+    }
+
+    void Close()
+    {
+        m_vTags.clear();
+        m_vIndex.clear();
+        m_vFiles.clear();
+
+        if (m_bMapped && m_pText) UnmapViewOfFile((void *) m_pText);
+        if (m_hMapping) CloseHandle(m_hMapping);
+        if (m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+
+        m_hFile         = INVALID_HANDLE_VALUE;
+        m_hMapping      = nullptr;
+        m_pText         = nullptr;
+        m_iSize         = 0;
+        m_bMapped       = false;
+        m_iErrorLine    = 0;
+        m_sError        = nullptr;
+    }
+
+    bool isValid() const { return m_pText != nullptr && !m_sError; }
+
+    // HashName() -- Hash of a full tag name, as used by the index (not case-sensitive; also used by CProfileBinary)
+    //
+    static unsigned int HashName(const char * sName,int iLength) { return HashAdd(kHashStart,sName,iLength); }
+
+    // GetErrorMessage() -- Reason the last Open() failed (nullptr if it succeeded), and the line of a format error
+    //
+    const char * GetErrorMessage() const { return m_sError; }
+    int GetErrorLine() const { return m_iErrorLine; }
+
+    int GetNumTags() const { return (int) m_vTags.size(); }
+
+    // GetTags() -- All tags, in file order (including later duplicates)
+    //
+    const std::vector<Tag_t> & GetTags() const { return m_vTags; }
+
+    // GetName() -- Full name of a tag ("Section.Tag", or "Tag" outside a section)
+    //
+    std::string GetName(const Tag_t & stTag) const
+    {
+        std::string sName;
+        if (stTag.iSectionLength) sName.append(m_pText+stTag.iSection,stTag.iSectionLength) += '.';
+        return sName.append(m_pText+stTag.iName,stTag.iNameLength);
+    }
+
+    ProfileSpan_t GetView(const Tag_t & stTag) const { return { m_pText+stTag.iValue,stTag.iValueLength,stTag.bEscaped }; }
+
+    // Find() -- Find a tag by name ("Section.Tag" for tags in a section).  Returns nullptr if the tag is not in the profile.
+    //
+    const Tag_t * Find(const char * sTag) const
+    {
+        if (!sTag || m_vIndex.empty()) return nullptr;
+
+        int iLength = (int) strlen(sTag);
+        unsigned int uiHash = HashAdd(kHashStart,sTag,iLength);
+        size_t szMask = m_vIndex.size()-1;
+
+        for (size_t szSlot = uiHash & szMask;m_vIndex[szSlot];szSlot = (szSlot+1) & szMask)
+        {
+            auto & stTag = m_vTags[m_vIndex[szSlot]-1];
+            if (stTag.uiHash == uiHash && Matches(stTag,sTag,iLength)) return &stTag;
+        }
+        return nullptr;
+    }
+
+    bool TagExists(const char * sTag) const { return Find(sTag) != nullptr; }
+
+    // GetView() -- The value of a tag, pointing into the profile text (no copy).  Check isValid() on the result.
+    //
+    ProfileSpan_t GetView(const char * sTag) const
+    {
+        auto pTag = Find(sTag);
+        return pTag ? GetView(*pTag) : ProfileSpan_t{};
+    }
+
+    // GetString() -- The value of a tag as a string, with escapes removed.  Returns sDefault (or an empty string) if the tag is not found.
+    //
+    CString GetString(const char * sTag,const char * sDefault = nullptr) const
+    {
+        auto stSpan = GetView(sTag);
+        if (!stSpan.isValid()) return CString(sDefault ? sDefault : "");
+        return CString(ToString(stSpan).c_str());
+    }
+
+    // CopyString() -- Copy the value of a tag (with escapes removed) into sDest, truncating to iMaxLength characters.
+    // Returns the length copied, or -1 if the tag was not found (sDest is then an empty string).
+    //
+    int CopyString(const char * sTag,char * sDest,int iMaxLength) const { return CopyValue(GetView(sTag),sDest,iMaxLength); }
+
+    // GetInteger() -- The value of a tag as an integer (decimal, or hexadecimal with a 0x prefix).  Returns iDefault if the
+    // tag is not found or is not an integer.
+    //
+    int GetInteger(const char * sTag,int iDefault = 0,bool * bSuccess = nullptr) const { return ToInteger(GetView(sTag),iDefault,bSuccess); }
+
+    // GetFloat() -- The value of a tag as a floating-point value.  Returns fDefault if the tag is not found or is not a number.
+    //
+    double GetFloat(const char * sTag,double fDefault = 0,bool * bSuccess = nullptr) const { return ToFloat(GetView(sTag),fDefault,bSuccess); }
+
+    // GetBool() -- The value of a tag as a boolean (true/false, yes/no, on/off or 1/0).  Returns bDefault if the tag is not
+    // found or is not one of these.
+    //
+    bool GetBool(const char * sTag,bool bDefault = false,bool * bSuccess = nullptr) const { return ToBool(GetView(sTag),bDefault,bSuccess); }
+
+    // GetCfPoint() -- The value of a tag as a point, written as "x,y" (optionally in parentheses or braces).  Returns
+    // cfDefault if the tag is not found or is not a point.
+    //
+    CfPoint GetCfPoint(const char * sTag,CfPoint cfDefault = CfPoint{},bool * bSuccess = nullptr) const { return ToCfPoint(GetView(sTag),cfDefault,bSuccess); }
+
+    int GetNumFiles() const { return (int) m_vFiles.size(); }
+
+    // GetFiles() -- Embedded files, in file order
+    //
+    const std::vector<File_t> & GetFiles() const { return m_vFiles; }
+
+    std::string GetFileName(const File_t & stFile) const { return std::string(m_pText+stFile.iName,stFile.iNameLength); }
+
+    // FindFile() -- Find an embedded file by name (not case-sensitive).  Returns nullptr if the file is not in the profile.
+    //
+    const File_t * FindFile(const char * sFilename) const
+    {
+        int iLength = sFilename ? (int) strlen(sFilename) : 0;
+        for (auto & stFile : m_vFiles)
+            if (stFile.iNameLength == iLength && EqualNoCase(m_pText+stFile.iName,sFilename,iLength)) return &stFile;
+        return nullptr;
+    }
+
+    // DecodeFile() -- Decode an embedded file into pDest (stFile.iSize bytes).  Returns false if the data is damaged or the
+    // CRC does not match.
+    //
+    bool DecodeFile(const File_t & stFile,void * pDest) const
+    {
+        return DecodeBase64(m_pText+stFile.iData,stFile.iDataLength,(unsigned char *) pDest,stFile.iSize) &&
+               CCrc32c::Compute(pDest,stFile.iSize) == stFile.uiCrc;
+    }
+
+    // GetFileData() -- Decode an embedded file.  Returns an empty Mem<char> (and *bSuccess = false) if the file is not found
+    // or is damaged.
+    //
+    [[nodiscard]] Mem<char> GetFileData(const char * sFilename,bool * bSuccess = nullptr) const
+    {
+        if (bSuccess) *bSuccess = false;
+        auto pFile = FindFile(sFilename);
+        if (!pFile) return Mem<char>();
+        if (!pFile->iSize) { if (bSuccess) *bSuccess = true; return Mem<char>(); }
+
+        Mem<char> cData(pFile->iSize);
+        if (!cData.isValid() || !DecodeFile(*pFile,(char *) cData)) return Mem<char>();
+
+        if (bSuccess) *bSuccess = true;
+        return cData;
+    }
+
+    // Value conversions used by the Get functions (and by CProfileBinary).  These read the value in place.  Each returns the
+    // default, and sets *bSuccess to false, if the span is invalid or the value can't be converted.
+
+    static std::string ToString(const ProfileSpan_t & stSpan)
+    {
+        std::string sValue;
+        if (stSpan.isValid()) Unescape(stSpan,sValue);
+        return sValue;
+    }
+
+    static int CopyValue(const ProfileSpan_t & stSpan,char * sDest,int iMaxLength)
+    {
+        if (!sDest || iMaxLength < 0) return -1;
+        *sDest = 0;
+        if (!stSpan.isValid()) return -1;
+
+        if (!stSpan.bEscaped)
+        {
+            int iLength = stSpan.iLength < iMaxLength ? stSpan.iLength : iMaxLength;
+            memcpy(sDest,stSpan.pData,iLength);
+            sDest[iLength] = 0;
+            return iLength;
+        }
+
+        std::string sValue;
+        Unescape(stSpan,sValue);
+        int iLength = (int) sValue.size() < iMaxLength ? (int) sValue.size() : iMaxLength;
+        memcpy(sDest,sValue.data(),iLength);
+        sDest[iLength] = 0;
+        return iLength;
+    }
+
+    static int ToInteger(const ProfileSpan_t & stSpan,int iDefault = 0,bool * bSuccess = nullptr)
+    {
+        const char * p      = stSpan.pData;
+        const char * pEnd   = p + stSpan.iLength;
+
+        if (p && p < pEnd && *p == '+') p++;
+
+        // Decimal may go down to INT_MIN; hex (-0x...) is limited to -INT_MAX
+
+        int iBase = 10;
+        bool bNegative = p && p < pEnd && *p == '-';
+        if (bNegative) p++;
+        if (p && pEnd-p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        {
+            iBase = 16;
+            p += 2;
+        }
+
+        unsigned int uiValue = 0;
+        unsigned int uiMax = bNegative && iBase == 10 ? (unsigned int) INT_MAX + 1 : INT_MAX;
+        bool bValid = p && ParseUnsigned(p,pEnd,uiValue,iBase,uiMax) && p == pEnd;
+
+        if (bSuccess) *bSuccess = bValid;
+        return bValid ? (bNegative ? (int) (0u - uiValue) : (int) uiValue) : iDefault;
+    }
+
+    static double ToFloat(const ProfileSpan_t & stSpan,double fDefault = 0,bool * bSuccess = nullptr)
+    {
+        const char * p = stSpan.pData;
+        double fValue = 0;
+
+        bool bValid = p && ParseDouble(p,stSpan.pData+stSpan.iLength,fValue) && p == stSpan.pData+stSpan.iLength;
+
+        if (bSuccess) *bSuccess = bValid;
+        return bValid ? fValue : fDefault;
+    }
+
+    static bool ToBool(const ProfileSpan_t & stSpan,bool bDefault = false,bool * bSuccess = nullptr)
+    {
+        static const char * sTrue[]  = { "true","yes","on","1" };
+        static const char * sFalse[] = { "false","no","off","0" };
+
+        if (bSuccess) *bSuccess = true;
+
+        if (stSpan.isValid())
+        {
+            for (int i=0;i<4;i++)
+            {
+                if ((int) strlen(sTrue[i]) == stSpan.iLength && EqualNoCase(stSpan.pData,sTrue[i],stSpan.iLength)) return true;
+                if ((int) strlen(sFalse[i]) == stSpan.iLength && EqualNoCase(stSpan.pData,sFalse[i],stSpan.iLength)) return false;
+            }
+        }
+
+        if (bSuccess) *bSuccess = false;
+        return bDefault;
+    }
+
+    static CfPoint ToCfPoint(const ProfileSpan_t & stSpan,CfPoint cfDefault = CfPoint{},bool * bSuccess = nullptr)
+    {
+        const char * p      = stSpan.pData;
+        const char * pEnd   = p + stSpan.iLength;
+
+        CfPoint cfPoint{};
+        bool bValid = p != nullptr;
+        char cClose = 0;
+
+        if (bValid && p < pEnd && (*p == '(' || *p == '{')) cClose = *p++ == '(' ? ')' : '}';
+
+        bValid = bValid && ParseDouble(p,pEnd,cfPoint.x);
+        while (bValid && p < pEnd && isSpace(*p)) p++;
+        bValid = bValid && p < pEnd && *p++ == ',';
+        bValid = bValid && ParseDouble(p,pEnd,cfPoint.y);
+        while (bValid && p < pEnd && isSpace(*p)) p++;
+        if (bValid && cClose) bValid = p < pEnd && *p++ == cClose;
+        bValid = bValid && p == pEnd;
+
+        if (bSuccess) *bSuccess = bValid;
+        return bValid ? cfPoint : cfDefault;
+    }
+};
+
+// CProfileWriter -- Streams a profile to a file (or to memory) through one fixed buffer.
+//
+// Each Put function writes one "Tag = Value" line.  Strings are written quoted (with escapes) only when needed, so the
+// output reads back through CProfileIndex unchanged.  Floating-point values are written with enough digits to read back
+// exactly.
+//
+class CProfileWriter
+{
+    static constexpr size_t kBufferSize = 65536;
+
+    FILE                  * m_fFile     = nullptr;
+    std::vector<char>       m_vBuffer;
+    size_t                  m_szUsed    = 0;
+    bool                    m_bMemory   = false;
+    bool                    m_bError    = false;
+    std::string             m_sMemory;                  // Output when writing to memory
+
+    void Flush()
+    {
+        if (!m_szUsed) return;
+        if (m_bMemory) m_sMemory.append(m_vBuffer.data(),m_szUsed);
+        else if (!m_fFile || fwrite(m_vBuffer.data(),1,m_szUsed,m_fFile) != m_szUsed) m_bError = true;
+        m_szUsed = 0;
+    }
+
+    void WriteTag(const char * sTag)
+    {
+        Write(sTag);
+        Write(" = ",3);
+    }
+
+    static bool NeedsQuotes(const char * sValue,size_t szLength)
+    {
+        if (!szLength) return false;
+        if (isSpace(sValue[0]) || isSpace(sValue[szLength-1]) || sValue[0] == '"') return true;
+        for (size_t i=0;i<szLength;i++)
+        {
+            if (sValue[i] == '\n' || sValue[i] == '\r') return true;
+            if (sValue[i] == '/' && i+1 < szLength && sValue[i+1] == '/' && (!i || isSpace(sValue[i-1]))) return true;    // Would read as a comment
+        }
+        return false;
+    }
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t'; }
+
+public:
+    CProfileWriter() = default;
+    CProfileWriter(const char * sPath) { Open(sPath); }
+    ~CProfileWriter() { Close(); }
+
+    CProfileWriter(const CProfileWriter &) = delete;
+    CProfileWriter & operator = (const CProfileWriter &) = delete;
+
+    // Open() -- Start writing a profile file.  Returns false if the file could not be created.
+    //
+    bool Open(const char * sPath)
+    {
+        Close();
+        m_fFile = sPath ? fopen(sPath,"wb") : nullptr;
+        if (!m_fFile) return false;
+        m_vBuffer.resize(kBufferSize);
+        return true;
+    }
+
+    // OpenMemory() -- Start writing a profile to memory (see GetMemory()).
+    //
+    void OpenMemory()
+    {
+        Close();
+        m_sMemory.clear();
+        m_bMemory = true;
+        m_vBuffer.resize(kBufferSize);
+    }
+
+    // Close() -- Flush the output and close the file.  Returns false if any write failed.
+    //
+    bool Close()
+    {
+        Flush();
+        bool bSuccess = !m_bError;
+        if (m_fFile && fclose(m_fFile)) bSuccess = false;
+
+        m_fFile     = nullptr;
+        m_bError    = false;
+        return bSuccess;
+    }
+
+    bool isValid() const { return m_fFile || m_bMemory; }
+
+    // GetMemory() -- Profile text written after OpenMemory() (complete after Close())
+    //
+    const std::string & GetMemory() const { return m_sMemory; }
+
+    void Write(const char * sText,size_t szLength)
+    {
+        if (!isValid()) return;
+        if (m_szUsed + szLength > kBufferSize)
+        {
+            Flush();
+            if (szLength >= kBufferSize)
+            {
+                if (m_bMemory) m_sMemory.append(sText,szLength);
+                else if (fwrite(sText,1,szLength,m_fFile) != szLength) m_bError = true;
+                return;
+            }
+        }
+        memcpy(m_vBuffer.data()+m_szUsed,sText,szLength);
+        m_szUsed += szLength;
+    }
+
+    void Write(const char * sText) { if (sText) Write(sText,strlen(sText)); }
+
+    void Section(const char * sSection)
+    {
+        Write("\n[",2);
+        Write(sSection);
+        Write("]\n",2);
+    }
+
+    void Comment(const char * sComment)
+    {
+        Write("// ",3);
+        Write(sComment);
+        Write("\n",1);
+    }
+
+    // PutString() -- Write a string value, quoting it only if it would not otherwise read back the same
+    //
+    void PutString(const char * sTag,const char * sValue,bool bForceQuotes = false)
+    {
+        if (!sValue) sValue = "";
+        size_t szLength = strlen(sValue);
+
+        WriteTag(sTag);
+        if (!bForceQuotes && !NeedsQuotes(sValue,szLength))
+        {
+            Write(sValue,szLength);
+            Write("\n",1);
+            return;
+        }
+
+        Write("\"",1);
+        size_t szStart = 0;
+        for (size_t i=0;i<szLength;i++)
+        {
+            const char * sEscape = nullptr;
+            switch (sValue[i])
+            {
+                case '"':   sEscape = "\\\""; break;
+                case '\\':  sEscape = "\\\\"; break;
+                case '\n':  sEscape = "\\n";  break;
+                case '\r':  sEscape = "\\r";  break;
+                case '\t':  sEscape = "\\t";  break;
+                default: continue;
+            }
+            Write(sValue+szStart,i-szStart);
+            Write(sEscape,2);
+            szStart = i+1;
+        }
+        Write(sValue+szStart,szLength-szStart);
+        Write("\"\n",2);
+    }
+
+    // PutText() -- Write a string value, always quoted (for multi-line text)
+    //
+    void PutText(const char * sTag,const char * sText) { PutString(sTag,sText,true); }
+
+    void PutInteger(const char * sTag,int iValue)
+    {
+        char sValue[16];
+        int iLength = snprintf(sValue,sizeof(sValue),"%d",iValue);
+        WriteTag(sTag);
+        Write(sValue,iLength);
+        Write("\n",1);
+    }
+
+    void PutFloat(const char * sTag,double fValue)
+    {
+        char sValue[32];
+        int iLength = snprintf(sValue,sizeof(sValue),"%.17g",fValue);
+        WriteTag(sTag);
+        Write(sValue,iLength);
+        Write("\n",1);
+    }
+
+    void PutBool(const char * sTag,bool bValue)
+    {
+        WriteTag(sTag);
+        Write(bValue ? "true\n" : "false\n");
+    }
+
+    void PutCfPoint(const char * sTag,CfPoint cfPoint)
+    {
+        char sValue[64];
+        int iLength = snprintf(sValue,sizeof(sValue),"%.17g, %.17g",cfPoint.x,cfPoint.y);
+        WriteTag(sTag);
+        Write(sValue,iLength);
+        Write("\n",1);
+    }
+
+    // PutFile() -- Embed a data file (written as base64 with its size and CRC; see CProfileIndex::GetFileData())
+    //
+    void PutFile(const char * sFilename,const void * pData,int iSize)
+    {
+        static const char * sBase64 = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        static constexpr int kLineBytes = 57;           // 76 characters per line
+
+        if (!pData) iSize = 0;
+        char sLine[128];
+        int iLength = snprintf(sLine,sizeof(sLine),"\" %d 0x%08X\n",iSize,CCrc32c::Compute(pData,iSize));
+        Write("#file \"",7);
+        Write(sFilename);
+        Write(sLine,iLength);
+
+        auto p = (const unsigned char *) pData;
+        for (int iPos = 0;iPos < iSize;iPos += kLineBytes)
+        {
+            int iBytes = iSize-iPos < kLineBytes ? iSize-iPos : kLineBytes;
+            char * sOut = sLine;
+            for (int i=0;i<iBytes;i += 3)
+            {
+                unsigned int uiValue = p[iPos+i] << 16;
+                if (i+1 < iBytes) uiValue |= p[iPos+i+1] << 8;
+                if (i+2 < iBytes) uiValue |= p[iPos+i+2];
+
+                *sOut++ = sBase64[uiValue >> 18];
+                *sOut++ = sBase64[(uiValue >> 12) & 63];
+                *sOut++ = i+1 < iBytes ? sBase64[(uiValue >> 6) & 63] : '=';
+                *sOut++ = i+2 < iBytes ? sBase64[uiValue & 63] : '=';
+            }
+            *sOut++ = '\n';
+            Write(sLine,sOut-sLine);
+        }
+        Write("#end\n",5);
+    }
+};
+
+}; // namespace Sage
+#endif // _CProfileIndex_H_
@@ -0,0 +1,511 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CProfiler -- Lightweight, always-available profiling: scoped zones, counters, frame markers and thread names
+//
+// Programs time themselves with clock() ("Finished. Time = %d ms"), which gives one number and nothing about where the
+// time went.  CProfiler records where the time went, on every thread, cheaply enough to leave in:
+//
+//      SageProfileZone("Mandelbrot::Row");         -- Times the enclosing scope (zones nest)
+//      SageProfileCounter("Iterations",iIter);     -- A value over time
+//      SageProfileFrame();                         -- End of a frame (i.e. after Update())
+//      CProfiler::SetThreadName("Worker 1");       -- Names the calling thread in the views
+//
+// The SageProfile macros are opt-in: they compile to nothing unless SAGE_PROFILE is defined (for the whole program, i.e.
+// on the compiler command line, so Sagebox's headers see it too).  SAGE_NO_PROFILER turns them off even when SAGE_PROFILE
+// is defined.  CProfiler itself can always be used directly.
+//
+// Recording is off until CProfiler::Enable(true), which also allocates the history.  While it is off, a zone is one
+// relaxed load.  While it is on, an event is two clock reads and a store into a ring owned by the calling thread -- no
+// lock, no allocation (after the thread's first event), nothing shared with other threads.  If a ring fills before it is
+// collected, the event is dropped and counted (GetDropped()).  A thread's ring is freed by the first Collect() after the
+// thread exits; its name and dropped count are kept for the views and the export.
+//
+// Collect() (called by CProfilerView's timer, and by the exports) moves the events into a bounded history, which can be:
+//
+//      - shown live: CProfilerView (CProfilerView.h) draws a timeline / flame chart of the last 100ms, per thread, in the
+//        Dev Window or any window
+//      - exported as Chrome trace JSON (ExportChromeTrace()) for chrome://tracing, Perfetto or Speedscope
+//
+// Times are in nanoseconds from the same start as CStartupTrace, whose startup events are included in the export.
+//
+// Zone and counter names must be string literals (only the pointer is kept).
+//
+// Sagebox's own hot paths (bitmap decode, warp/resize, filters, dialog creation and the text views) are instrumented
+// with zones through SageProfile.h, so with SAGE_PROFILE defined they show up in the timeline next to the program's zones.
+// Without it, those headers do not include CProfiler.h at all.
+//
+#if !defined(_CProfiler_H_)
+#define _CProfiler_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "CResourceLoader.h"
+
+namespace Sage
+{
+
+class CProfiler
+{
+public:
+    enum class EventType : unsigned char
+    {
+        Zone,           // llStartNs .. llStartNs + llDurationNs
+        Counter,        // fValue at llStartNs
+        Frame,          // End of frame llFrame at llStartNs
+        Mark,           // A point in time
+    };
+
+    struct Event_t
+    {
+        const char    * sName;
+        long long       llStartNs;
+        union
+        {
+            long long   llDurationNs;       // Zone
+            double      fValue;             // Counter
+            long long   llFrame;            // Frame
+        };
+        unsigned int    uiThread;           // Thread_t::iIndex
+        EventType       eType;
+        unsigned char   ucDepth;            // Zone nesting depth on its thread (0 = outermost)
+    };
+
+    struct Thread_t
+    {
+        std::string     sName;
+        int             iIndex;
+        long long       llDropped;
+        bool            bRunning;           // False once the thread has exited and its ring has been freed
+    };
+
+    static constexpr int kRingEvents        = 1 << 15;      // Per thread, between collections
+    static constexpr int kDefaultHistory    = 1 << 18;      // Events kept by Collect()
+
+private:
+    enum RingState : int { RingActive, RingRetired, RingReleased };    // Retired: the thread has exited; Released: ring freed
+
+    // CRing -- One thread's events.  Written by that thread only, read by Collect().  The events are allocated on the
+    //          thread's first event, and freed by Collect() once the thread has exited (the rest is kept for its name).
+
+    struct CRing
+    {
+        std::unique_ptr<Event_t[]>      pEvents;
+        std::string                     sName;                          // Guarded by Registry_t::mtRings
+        unsigned int                    uiIndex = 0;
+        std::atomic<int>                iState{RingActive};
+
+        char                                cPadHead[64];       // Padding rather than alignas(64): heap objects are not over-aligned before C++17
+        std::atomic<uint64_t>               ullHead{0};
+        uint64_t                            ullCachedTail = 0;
+        std::atomic<long long>              llDropped{0};
+
+        char                                cPadTail[64];
+        std::atomic<uint64_t>               ullTail{0};
+    };
+
+    struct Registry_t
+    {
+        std::atomic<bool>                   bEnabled{false};
+        std::atomic<long long>              llFrame{0};
+
+        std::mutex                          mtRings;
+        std::vector<std::unique_ptr<CRing>> vRings;                     // Never removed (a thread's name outlives it)
+
+        std::mutex                          mtHistory;                  // Collect() and the queries
+        std::vector<Event_t>                vHistory;                   // Allocated by Enable()
+        int                                 iHistorySize = kDefaultHistory;
+        uint64_t                            ullHistoryCount = 0;
+    };
+
+    static Registry_t & GetRegistry() { static Registry_t stRegistry; return stRegistry; }
+
+    // RingOwner_t -- The calling thread's ring.  Its destructor runs when the thread exits and retires the ring.
+
+    struct RingOwner_t
+    {
+        CRing * pRing;
+
+        RingOwner_t()
+        {
+            auto & stReg = GetRegistry();
+            std::lock_guard<std::mutex> lock(stReg.mtRings);
+            stReg.vRings.push_back(std::unique_ptr<CRing>(new CRing()));
+            pRing = stReg.vRings.back().get();
+            pRing->uiIndex = (unsigned int) (stReg.vRings.size()-1);
+            pRing->sName = pRing->uiIndex ? "Thread " + std::to_string(pRing->uiIndex) : std::string("Main");
+        }
+        ~RingOwner_t() { pRing->iState.store(RingRetired,std::memory_order_release); }
+    };
+
+    static CRing * GetRing()
+    {
+        thread_local RingOwner_t stOwner;
+        return stOwner.pRing;
+    }
+
+    static int & GetDepth() { thread_local int iDepth = 0; return iDepth; }
+
+    static void Record(EventType eType,const char * sName,long long llStartNs,long long llData,int iDepth)
+    {
+        CRing * pRing = GetRing();
+        if (!pRing->pEvents) pRing->pEvents.reset(new Event_t[kRingEvents]);     // Published to Collect() by the ullHead store
+
+        uint64_t ullHead = pRing->ullHead.load(std::memory_order_relaxed);
+        if (ullHead - pRing->ullCachedTail >= (uint64_t) kRingEvents)
+        {
+            pRing->ullCachedTail = pRing->ullTail.load(std::memory_order_acquire);
+            if (ullHead - pRing->ullCachedTail >= (uint64_t) kRingEvents)
+            {
+                pRing->llDropped.store(pRing->llDropped.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+                return;
+            }
+        }
+
+        Event_t & stEvent   = pRing->pEvents[ullHead & (kRingEvents-1)];
+        stEvent.sName       = sName;
+        stEvent.llStartNs   = llStartNs;
+        stEvent.llDurationNs = llData;
+        stEvent.uiThread    = pRing->uiIndex;
+        stEvent.eType       = eType;
+        stEvent.ucDepth     = (unsigned char) (iDepth < 255 ? iDepth : 255);
+        pRing->ullHead.store(ullHead+1,std::memory_order_release);
+    }
+
+    static void AppendJson(std::string & sOut,const char * sText)
+    {
+        sOut += '"';
+        for (const char * s = sText ? sText : "";*s;s++)
+        {
+            unsigned char c = (unsigned char) *s;
+            if (c == '"' || c == '\\') { sOut += '\\'; sOut += (char) c; }
+            else if (c < 0x20)
+            {
+                char sEscape[8];
+                snprintf(sEscape,sizeof(sEscape),"\\u%04x",c);
+                sOut += sEscape;
+            }
+            else sOut += (char) c;
+        }
+        sOut += '"';
+    }
+
+public:
+    // Enable() -- Start or stop recording (off by default).  The history is allocated the first time recording starts.
+    //
+    static void Enable(bool bEnable = true)
+    {
+        auto & stReg = GetRegistry();
+        if (bEnable)
+        {
+            std::lock_guard<std::mutex> lock(stReg.mtHistory);
+            if (stReg.vHistory.empty()) stReg.vHistory.assign(stReg.iHistorySize,Event_t{});
+        }
+        stReg.bEnabled.store(bEnable,std::memory_order_relaxed);
+    }
+
+    static bool isEnabled() { return GetRegistry().bEnabled.load(std::memory_order_relaxed); }
+
+    // Now() -- Nanoseconds since process start (the same start as CStartupTrace::Now())
+    //
+    static long long Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-CStartupTrace::GetStartTime()).count();
+    }
+
+    // Zone -- Time the enclosing scope (use SageProfileZone(), which names the variable)
+    //
+    class Zone
+    {
+        const char    * m_sName;
+        long long       m_llStartNs;
+
+    public:
+        explicit Zone(const char * sName)
+        {
+            if (!isEnabled()) { m_sName = nullptr; return; }
+            m_sName     = sName;
+            m_llStartNs = Now();
+            GetDepth()++;
+        }
+
+        ~Zone()
+        {
+            if (!m_sName) return;
+            int iDepth = --GetDepth();
+            Record(EventType::Zone,m_sName,m_llStartNs,Now()-m_llStartNs,iDepth);
+        }
+
+        Zone(const Zone &) = delete;
+        Zone & operator = (const Zone &) = delete;
+    };
+
+    // Counter() -- Record a value (shown as a graph in trace viewers, and the last value in CProfilerView)
+    //
+    static void Counter(const char * sName,double fValue)
+    {
+        if (!isEnabled()) return;
+        long long llValue;
+        memcpy(&llValue,&fValue,sizeof(llValue));
+        Record(EventType::Counter,sName,Now(),llValue,0);
+    }
+
+    // Frame() -- Mark the end of a frame.  Returns the frame number.
+    //
+    static long long Frame(const char * sName = "Frame")
+    {
+        long long llFrame = GetRegistry().llFrame.fetch_add(1,std::memory_order_relaxed);
+        if (isEnabled()) Record(EventType::Frame,sName,Now(),llFrame,0);
+        return llFrame;
+    }
+
+    // Mark() -- A point in time (i.e. "Image loaded")
+    //
+    static void Mark(const char * sName)
+    {
+        if (isEnabled()) Record(EventType::Mark,sName,Now(),0,0);
+    }
+
+    // SetThreadName() -- Name the calling thread in the views and the export (the name is copied)
+    //
+    static void SetThreadName(const char * sName)
+    {
+        CRing * pRing = GetRing();
+        std::lock_guard<std::mutex> lock(GetRegistry().mtRings);
+        pRing->sName = sName ? sName : "";
+    }
+
+    // Collect() -- Move the events recorded by all threads into the history, and free the rings of threads that have
+    // exited.  Returns the number of events moved (events collected before Enable() are counted but not kept).
+    //
+    static int Collect()
+    {
+        auto & stReg = GetRegistry();
+        std::lock_guard<std::mutex> lockHistory(stReg.mtHistory);
+        std::lock_guard<std::mutex> lockRings(stReg.mtRings);
+
+        int iCount = 0;
+        size_t szHistory = stReg.vHistory.size();
+        for (auto & pRing : stReg.vRings)
+        {
+            // The state is read before the head, so a retired ring's head is its last one
+
+            int iState = pRing->iState.load(std::memory_order_acquire);
+            if (iState == RingReleased) continue;
+
+            uint64_t ullHead = pRing->ullHead.load(std::memory_order_acquire);
+            uint64_t ullTail = pRing->ullTail.load(std::memory_order_relaxed);
+            if (!szHistory) { iCount += (int) (ullHead - ullTail); ullTail = ullHead; }
+            for (;ullTail < ullHead;ullTail++,iCount++)
+                stReg.vHistory[stReg.ullHistoryCount++ % szHistory] = pRing->pEvents[ullTail & (kRingEvents-1)];
+            pRing->ullTail.store(ullHead,std::memory_order_release);
+
+            if (iState == RingRetired)
+            {
+                pRing->pEvents.reset();
+                pRing->iState.store(RingReleased,std::memory_order_relaxed);
+            }
+        }
+        return iCount;
+    }
+
+    // SetHistorySize() -- Number of events kept by Collect() (clears the history).  The memory is allocated now if
+    // recording has been enabled, otherwise by Enable().
+    //
+    static void SetHistorySize(int iEvents)
+    {
+        auto & stReg = GetRegistry();
+        std::lock_guard<std::mutex> lock(stReg.mtHistory);
+        stReg.iHistorySize = iEvents < 1024 ? 1024 : iEvents;
+        if (!stReg.vHistory.empty()) stReg.vHistory.assign(stReg.iHistorySize,Event_t{});
+        stReg.ullHistoryCount = 0;
+    }
+
+    // GetHistoryMemory() -- Bytes allocated for the history (0 until Enable())
+    //
+    static size_t GetHistoryMemory()
+    {
+        auto & stReg = GetRegistry();
+        std::lock_guard<std::mutex> lock(stReg.mtHistory);
+        return stReg.vHistory.size()*sizeof(Event_t);
+    }
+
+    // Clear() -- Remove the collected events (and any not yet collected)
+    //
+    static void Clear()
+    {
+        Collect();
+        auto & stReg = GetRegistry();
+        std::lock_guard<std::mutex> lock(stReg.mtHistory);
+        stReg.ullHistoryCount = 0;
+    }
+
+    // GetEvents() -- Collected events in [llFromNs,llToNs] (zones that overlap it), oldest collected first.  Use
+    // llFromNs = 0, llToNs = LLONG_MAX for all of them.
+    //
+    static void GetEvents(std::vector<Event_t> & vEvents,long long llFromNs = 0,long long llToNs = 0x7FFFFFFFFFFFFFFFLL)
+    {
+        auto & stReg = GetRegistry();
+        std::lock_guard<std::mutex> lock(stReg.mtHistory);
+        vEvents.clear();
+
+        size_t szHistory = stReg.vHistory.size();
+        if (!szHistory) return;
+        uint64_t ullFirst = stReg.ullHistoryCount > szHistory ? stReg.ullHistoryCount - szHistory : 0;
+        for (uint64_t i = ullFirst;i < stReg.ullHistoryCount;i++)
+        {
+            const Event_t & stEvent = stReg.vHistory[i % szHistory];
+            long long llEnd = stEvent.eType == EventType::Zone ? stEvent.llStartNs + stEvent.llDurationNs : stEvent.llStartNs;
+            if (llEnd >= llFromNs && stEvent.llStartNs <= llToNs) vEvents.push_back(stEvent);
+        }
+    }
+
+    static std::vector<Thread_t> GetThreads()
+    {
+        auto & stReg = GetRegistry();
+        std::lock_guard<std::mutex> lock(stReg.mtRings);
+        std::vector<Thread_t> vThreads;
+        for (auto & pRing : stReg.vRings)
+            vThreads.push_back({ pRing->sName,(int) pRing->uiIndex,pRing->llDropped.load(std::memory_order_relaxed),
+                                 pRing->iState.load(std::memory_order_relaxed) != RingReleased });
+        return vThreads;
+    }
+
+    static long long GetDropped()
+    {
+        long long llDropped = 0;
+        for (auto & stThread : GetThreads()) llDropped += stThread.llDropped;
+        return llDropped;
+    }
+
+    // GetFrameStats() -- Average and longest frame time (ms) over the last iFrames collected frames.  Returns false if
+    // fewer than two frames have been collected.
+    //
+    static bool GetFrameStats(int iFrames,double & fAverageMs,double & fMaxMs)
+    {
+        std::vector<Event_t> vEvents;
+        GetEvents(vEvents);
+
+        std::vector<long long> vTimes;
+        for (auto & stEvent : vEvents) if (stEvent.eType == EventType::Frame) vTimes.push_back(stEvent.llStartNs);
+        fAverageMs = fMaxMs = 0;
+        if (vTimes.size() < 2) return false;
+
+        std::sort(vTimes.begin(),vTimes.end());
+        size_t szFirst = vTimes.size() > (size_t) iFrames + 1 ? vTimes.size() - iFrames - 1 : 0;
+        for (size_t i = szFirst+1;i < vTimes.size();i++)
+        {
+            double fMs = (vTimes[i] - vTimes[i-1])/1e6;
+            if (fMs > fMaxMs) fMaxMs = fMs;
+        }
+        fAverageMs = (vTimes.back() - vTimes[szFirst])/1e6/(vTimes.size() - 1 - szFirst);
+        return true;
+    }
+
+    // ExportChromeTrace() -- Collect, then write the history (and CStartupTrace's events) as Chrome trace JSON, which
+    // chrome://tracing, ui.perfetto.dev and Speedscope read.
+    //
+    static void ExportChromeTrace(std::string & sOut)
+    {
+        Collect();
+        std::vector<Event_t> vEvents;
+        GetEvents(vEvents);
+        auto vThreads = GetThreads();
+
+        char sBuffer[160];
+        sOut = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool bFirst = true;
+        auto fnBegin = [&](const char * sName)
+        {
+            if (!bFirst) sOut += ",\n";
+            bFirst = false;
+            sOut += "{\"name\":";
+            AppendJson(sOut,sName);
+        };
+
+        fnBegin("process_name");
+        sOut += ",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Sagebox\"}}";
+        for (auto & stThread : vThreads)
+        {
+            fnBegin("thread_name");
+            snprintf(sBuffer,sizeof(sBuffer),",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",stThread.iIndex);
+            sOut += sBuffer;
+            AppendJson(sOut,stThread.sName.c_str());
+            sOut += "}}";
+        }
+
+        for (auto & stEvent : vEvents)
+        {
+            fnBegin(stEvent.sName);
+            switch (stEvent.eType)
+            {
+                case EventType::Zone:
+                    snprintf(sBuffer,sizeof(sBuffer),",\"cat\":\"sage\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                             stEvent.llStartNs/1000.0,stEvent.llDurationNs/1000.0,stEvent.uiThread);
+                    break;
+                case EventType::Counter:        // JSON has no NaN or infinity, so those are written as null
+                    snprintf(sBuffer,sizeof(sBuffer),",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"value\":",
+                             stEvent.llStartNs/1000.0,stEvent.uiThread);
+                    sOut += sBuffer;
+                    if (std::isfinite(stEvent.fValue)) snprintf(sBuffer,sizeof(sBuffer),"%.17g}}",stEvent.fValue);
+                    else snprintf(sBuffer,sizeof(sBuffer),"null}}");
+                    break;
+                case EventType::Frame:
+                    snprintf(sBuffer,sizeof(sBuffer),",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"frame\":%lld}}",
+                             stEvent.llStartNs/1000.0,stEvent.uiThread,stEvent.llFrame);
+                    break;
+                case EventType::Mark:
+                    snprintf(sBuffer,sizeof(sBuffer),",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                             stEvent.llStartNs/1000.0,stEvent.uiThread);
+                    break;
+            }
+            sOut += sBuffer;
+        }
+
+        // Startup events (resource loads and marks), as a second process so their thread numbers do not mix with ours
+
+        auto vStartup = CStartupTrace::GetEvents();
+        if (!vStartup.empty())
+        {
+            fnBegin("process_name");
+            sOut += ",\"ph\":\"M\",\"pid\":2,\"args\":{\"name\":\"Startup\"}}";
+        }
+        for (auto & stEvent : vStartup)
+        {
+            fnBegin(stEvent.sName.c_str());
+            sOut += ",\"cat\":";
+            AppendJson(sOut,stEvent.sGroup.empty() ? "mark" : stEvent.sGroup.c_str());
+            if (stEvent.sGroup.empty()) snprintf(sBuffer,sizeof(sBuffer),",\"ph\":\"i\",\"s\":\"p\",\"ts\":%lld,\"pid\":2,\"tid\":%u}",stEvent.llStartUs,stEvent.uiThread);
+            else snprintf(sBuffer,sizeof(sBuffer),",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":2,\"tid\":%u}",stEvent.llStartUs,
+                          stEvent.llEndUs-stEvent.llStartUs,stEvent.uiThread);
+            sOut += sBuffer;
+        }
+        sOut += "\n]}\n";
+    }
+
+    static bool ExportChromeTrace(const char * sPath)
+    {
+        if (!sPath) return false;
+        std::string sOut;
+        ExportChromeTrace(sOut);
+
+        FILE * fp = fopen(sPath,"wb");
+        if (!fp) return false;
+        bool bSuccess = fwrite(sOut.data(),1,sOut.size(),fp) == sOut.size();
+        return fclose(fp) == 0 && bSuccess;
+    }
+};
+
+}; // namespace Sage
+
+#include "SageProfile.h"      // The SageProfile macros
+
+#endif // _CProfiler_H_
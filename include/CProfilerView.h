@@ -0,0 +1,421 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CProfilerView -- Live timeline of CProfiler zones, for the Dev Window or any window
+//
+// Shows the last 100ms (adjustable) of every thread as a flame chart: one lane per thread, zones as bars stacked by
+// nesting depth, labeled when they are wide enough, and colored by name so the same zone has the same color everywhere.
+// Frame markers (SageProfileFrame()) are drawn as vertical lines, and the top line shows the frame time, the number of
+// events and any dropped events.  The last value of each counter is shown at the bottom.
+//
+//      Click or Space      -- Pause / resume (paused, the timeline stays put so it can be looked at)
+//      Mouse wheel         -- Zoom the time span (1ms .. 10s)
+//      Left / Right        -- Pan, while paused
+//
+// A timer (every 100ms) collects the events (CProfiler::Collect()) and redraws.  The view turns recording on when it
+// is created (CProfiler::Enable()) unless bEnable = false is passed to Create().
+//
+// Example:
+//
+//      CProfilerView cProfile;
+//      cProfile.Create(*Sage::DevGetWindow(),10,10,600,300);
+//
+//      while (cWin.GetEvent())
+//      {
+//          { SageProfileZone("Draw"); DrawScene(); }
+//          cWin.Update();
+//          SageProfileFrame();
+//      }
+//
+// CProfiler::ExportChromeTrace("trace.json") saves the same events for chrome://tracing or Perfetto.
+//
+#if !defined(_CProfilerView_H_)
+#define _CProfilerView_H_
+
+#include <Windows.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "CSageBox.h"
+#include "CProfiler.h"
+
+namespace Sage
+{
+
+class CProfilerView
+{
+    static constexpr const char * kClassName    = "SageProfilerView";
+    static constexpr UINT_PTR kTimerId          = 1;
+    static constexpr UINT kRefreshMs            = 100;
+    static constexpr int kLabelWidth            = 90;
+    static constexpr long long kMinSpanNs       = 1000000LL;
+    static constexpr long long kMaxSpanNs       = 10000000000LL;
+
+    HWND            m_hWnd          = nullptr;
+    HFONT           m_hFont         = nullptr;
+    int             m_iRowHeight    = 16;
+    int             m_iWheelDelta   = 0;
+
+    bool            m_bPaused       = false;
+    long long       m_llSpanNs      = 100000000LL;      // Width of the timeline
+    long long       m_llEndNs       = 0;                // Time at the right edge
+
+    std::vector<CProfiler::Event_t>     m_vEvents;      // Events in the timeline
+    std::vector<CProfiler::Thread_t>    m_vThreads;
+    long long       m_llDropped     = 0;
+
+    COLORREF        m_rgbText       = RGB(0,0,0);
+    COLORREF        m_rgbBackground = RGB(250,250,250);
+    COLORREF        m_rgbLane       = RGB(236,236,240);
+    COLORREF        m_rgbFrame      = RGB(160,160,160);
+
+    static bool RegisterClass()
+    {
+        static const bool bRegistered = []
+        {
+            WNDCLASSEXA stClass{};
+            stClass.cbSize          = sizeof(stClass);
+            stClass.lpfnWndProc     = WindowProc;
+            stClass.hInstance       = GetModuleHandleA(nullptr);
+            stClass.hCursor         = LoadCursor(nullptr,IDC_ARROW);
+            stClass.lpszClassName   = kClassName;
+            return RegisterClassExA(&stClass) != 0 || GetLastError() == ERROR_CLASS_ALREADY_EXISTS;
+        }();
+        return bRegistered;
+    }
+
+    static LRESULT CALLBACK WindowProc(HWND hWnd,UINT uMsg,WPARAM wParam,LPARAM lParam)
+    {
+        if (uMsg == WM_NCCREATE)
+            SetWindowLongPtrA(hWnd,GWLP_USERDATA,(LONG_PTR) ((CREATESTRUCTA *) lParam)->lpCreateParams);
+
+        auto cView = (CProfilerView *) GetWindowLongPtrA(hWnd,GWLP_USERDATA);
+        if (!cView) return DefWindowProcA(hWnd,uMsg,wParam,lParam);
+        if (uMsg == WM_NCDESTROY)
+        {
+            SetWindowLongPtrA(hWnd,GWLP_USERDATA,0);
+            cView->m_hWnd = nullptr;
+            return DefWindowProcA(hWnd,uMsg,wParam,lParam);
+        }
+        return cView->HandleMessage(uMsg,wParam,lParam);
+    }
+
+    // GetZoneColor() -- A light color from the name, so a zone keeps its color between frames and threads
+
+    static COLORREF GetZoneColor(const char * sName)
+    {
+        unsigned int uiHash = 2166136261u;
+        for (const char * s = sName ? sName : "";*s;s++) uiHash = (uiHash ^ (unsigned char) *s)*16777619u;
+        return RGB(140 + (uiHash & 0x7F) % 100,140 + ((uiHash >> 8) & 0x7F) % 100,140 + ((uiHash >> 16) & 0x7F) % 100);
+    }
+
+    static void FillSolid(HDC hDC,const RECT & rRect,COLORREF rgbColor)
+    {
+        SetBkColor(hDC,rgbColor);
+        ExtTextOutA(hDC,0,0,ETO_OPAQUE,&rRect,nullptr,0,nullptr);
+    }
+
+    void UpdateRowHeight()
+    {
+        HDC hDC = GetDC(m_hWnd);
+        HGDIOBJ hOld = SelectObject(hDC,m_hFont);
+        TEXTMETRICA stMetrics{};
+        GetTextMetricsA(hDC,&stMetrics);
+        SelectObject(hDC,hOld);
+        ReleaseDC(m_hWnd,hDC);
+        m_iRowHeight = stMetrics.tmHeight > 4 ? stMetrics.tmHeight + 2 : 16;
+    }
+
+    // Refresh() -- Collect new events and take the ones in the timeline
+
+    void Refresh()
+    {
+        CProfiler::Collect();
+        if (!m_bPaused) m_llEndNs = CProfiler::Now();
+        CProfiler::GetEvents(m_vEvents,m_llEndNs - m_llSpanNs,m_llEndNs);
+        m_vThreads  = CProfiler::GetThreads();
+        m_llDropped = 0;
+        for (auto & stThread : m_vThreads) m_llDropped += stThread.llDropped;
+        if (m_hWnd) InvalidateRect(m_hWnd,nullptr,FALSE);
+    }
+
+    void Paint()
+    {
+        SageProfileZone("CProfilerView::Paint");
+
+        PAINTSTRUCT stPaint;
+        HDC hDC = BeginPaint(m_hWnd,&stPaint);
+        RECT rClient;
+        GetClientRect(m_hWnd,&rClient);
+        int iWidth  = rClient.right > 0 ? rClient.right : 1;
+        int iHeight = rClient.bottom > 0 ? rClient.bottom : 1;
+
+        // Drawn off-screen, then copied, so the 10 redraws a second do not flicker
+
+        HDC hMemDC      = CreateCompatibleDC(hDC);
+        HBITMAP hBitmap = CreateCompatibleBitmap(hDC,iWidth,iHeight);
+        HGDIOBJ hOldBitmap  = SelectObject(hMemDC,hBitmap);
+        HGDIOBJ hOldFont    = SelectObject(hMemDC,m_hFont);
+        SetTextColor(hMemDC,m_rgbText);
+
+        FillSolid(hMemDC,rClient,m_rgbBackground);
+
+        int iPlotWidth  = iWidth - kLabelWidth > 1 ? iWidth - kLabelWidth : 1;
+        long long llFromNs = m_llEndNs - m_llSpanNs;
+        auto fnX = [&](long long llNs)
+        {
+            long long llX = kLabelWidth + (llNs - llFromNs)*iPlotWidth/m_llSpanNs;
+            return (int) (llX < kLabelWidth ? kLabelWidth : llX > iWidth ? iWidth : llX);
+        };
+
+        // Header: frame time, events, drops
+
+        char sText[256];
+        double fAverageMs = 0,fMaxMs = 0;
+        long long llLastFrame = -1;
+        int iFrames = 0;
+        for (auto & stEvent : m_vEvents)
+            if (stEvent.eType == CProfiler::EventType::Frame)
+            {
+                if (llLastFrame >= 0)
+                {
+                    double fMs = (stEvent.llStartNs - llLastFrame)/1e6;
+                    fAverageMs += fMs;
+                    if (fMs > fMaxMs) fMaxMs = fMs;
+                    iFrames++;
+                }
+                llLastFrame = stEvent.llStartNs;
+            }
+        if (iFrames) fAverageMs /= iFrames;
+
+        int iLength = snprintf(sText,sizeof(sText),"%s%.0f ms   frame %.2f ms avg, %.2f ms max   %d events   %lld dropped",
+                               m_bPaused ? "PAUSED   " : "",m_llSpanNs/1e6,fAverageMs,fMaxMs,(int) m_vEvents.size(),m_llDropped);
+        if (iLength > (int) sizeof(sText)-1) iLength = (int) sizeof(sText)-1;
+        SetBkColor(hMemDC,m_rgbBackground);
+        ExtTextOutA(hMemDC,4,1,0,nullptr,sText,(UINT) iLength,nullptr);
+
+        // Lanes: one per thread, as deep as its deepest zone in view
+
+        int iY = m_iRowHeight + 2;
+        for (auto & stThread : m_vThreads)
+        {
+            int iMaxDepth = 0;
+            bool bAny = false;
+            for (auto & stEvent : m_vEvents)
+                if (stEvent.uiThread == stThread.iIndex && stEvent.eType == CProfiler::EventType::Zone)
+                {
+                    bAny = true;
+                    if (stEvent.ucDepth > iMaxDepth) iMaxDepth = stEvent.ucDepth;
+                }
+            if (!bAny && m_vThreads.size() > 1 && stThread.iIndex) continue;        // Idle worker threads are not shown
+
+            int iLaneHeight = (iMaxDepth+1)*m_iRowHeight;
+            if (iY >= iHeight) break;
+
+            RECT rLane = { kLabelWidth,iY,iWidth,iY + iLaneHeight };
+            FillSolid(hMemDC,rLane,m_rgbLane);
+
+            RECT rLabel = { 2,iY,kLabelWidth-4,iY + m_iRowHeight };
+            SetBkColor(hMemDC,m_rgbBackground);
+            ExtTextOutA(hMemDC,rLabel.left,iY+1,ETO_CLIPPED,&rLabel,stThread.sName.c_str(),(UINT) stThread.sName.size(),nullptr);
+
+            for (auto & stEvent : m_vEvents)
+            {
+                if (stEvent.uiThread != stThread.iIndex) continue;
+                if (stEvent.eType == CProfiler::EventType::Zone)
+                {
+                    int iLeft   = fnX(stEvent.llStartNs);
+                    int iRight  = fnX(stEvent.llStartNs + stEvent.llDurationNs);
+                    if (iRight <= iLeft) iRight = iLeft + 1;        // Short zones stay visible
+
+                    int iTop = iY + stEvent.ucDepth*m_iRowHeight;
+                    RECT rZone = { iLeft,iTop,iRight,iTop + m_iRowHeight - 1 };
+                    FillSolid(hMemDC,rZone,GetZoneColor(stEvent.sName));
+
+                    if (iRight - iLeft > 24)
+                    {
+                        int iNameLength = snprintf(sText,sizeof(sText),"%s %.2f ms",stEvent.sName,stEvent.llDurationNs/1e6);
+                        if (iNameLength > (int) sizeof(sText)-1) iNameLength = (int) sizeof(sText)-1;
+                        RECT rText = { iLeft+2,iTop,iRight-1,iTop + m_iRowHeight - 1 };
+                        ExtTextOutA(hMemDC,rText.left,iTop,ETO_CLIPPED,&rText,sText,(UINT) iNameLength,nullptr);
+                    }
+                }
+                else if (stEvent.eType == CProfiler::EventType::Mark)
+                {
+                    int iX = fnX(stEvent.llStartNs);
+                    RECT rMark = { iX,iY,iX+2,iY + iLaneHeight };
+                    FillSolid(hMemDC,rMark,RGB(220,60,60));
+                }
+            }
+            iY += iLaneHeight + 2;
+        }
+
+        // Frame markers, across all the lanes
+
+        for (auto & stEvent : m_vEvents)
+            if (stEvent.eType == CProfiler::EventType::Frame)
+            {
+                int iX = fnX(stEvent.llStartNs);
+                RECT rLine = { iX,m_iRowHeight,iX+1,iY };
+                FillSolid(hMemDC,rLine,m_rgbFrame);
+            }
+
+        // Counters: the last value of each, on the bottom line
+
+        std::vector<const CProfiler::Event_t *> vCounters;
+        for (auto & stEvent : m_vEvents)
+        {
+            if (stEvent.eType != CProfiler::EventType::Counter) continue;
+            bool bFound = false;
+            for (auto & pCounter : vCounters)
+                if (pCounter->sName == stEvent.sName || !strcmp(pCounter->sName,stEvent.sName))
+                {
+                    if (stEvent.llStartNs >= pCounter->llStartNs) pCounter = &stEvent;
+                    bFound = true;
+                    break;
+                }
+            if (!bFound) vCounters.push_back(&stEvent);
+        }
+        if (!vCounters.empty())
+        {
+            std::string sCounters;
+            for (auto & pCounter : vCounters)
+            {
+                snprintf(sText,sizeof(sText),"%s = %g    ",pCounter->sName,pCounter->fValue);
+                sCounters += sText;
+            }
+            RECT rCounters = { 0,iHeight - m_iRowHeight,iWidth,iHeight };
+            SetBkColor(hMemDC,m_rgbBackground);
+            ExtTextOutA(hMemDC,4,rCounters.top+1,ETO_OPAQUE | ETO_CLIPPED,&rCounters,sCounters.c_str(),(UINT) sCounters.size(),nullptr);
+        }
+
+        BitBlt(hDC,0,0,iWidth,iHeight,hMemDC,0,0,SRCCOPY);
+        SelectObject(hMemDC,hOldFont);
+        SelectObject(hMemDC,hOldBitmap);
+        DeleteObject(hBitmap);
+        DeleteDC(hMemDC);
+        EndPaint(m_hWnd,&stPaint);
+    }
+
+    void Zoom(int iSteps)
+    {
+        for (;iSteps > 0;iSteps--) m_llSpanNs = m_llSpanNs*4/5;
+        for (;iSteps < 0;iSteps++) m_llSpanNs = m_llSpanNs*5/4;
+        if (m_llSpanNs < kMinSpanNs) m_llSpanNs = kMinSpanNs;
+        if (m_llSpanNs > kMaxSpanNs) m_llSpanNs = kMaxSpanNs;
+        Refresh();
+    }
+
+    void Pan(int iDirection)
+    {
+        if (!m_bPaused) return;
+        m_llEndNs += iDirection*m_llSpanNs/4;
+        Refresh();
+    }
+
+    LRESULT HandleMessage(UINT uMsg,WPARAM wParam,LPARAM lParam)
+    {
+        switch (uMsg)
+        {
+            case WM_PAINT:          Paint();                    return 0;
+            case WM_ERASEBKGND:                                 return 1;
+            case WM_TIMER:          if (wParam == kTimerId) Refresh(); return 0;
+            case WM_SIZE:           InvalidateRect(m_hWnd,nullptr,FALSE); return 0;
+            case WM_LBUTTONDOWN:    SetFocus(m_hWnd); SetPaused(!m_bPaused); return 0;
+
+            case WM_MOUSEWHEEL:
+            {
+                m_iWheelDelta += GET_WHEEL_DELTA_WPARAM(wParam);
+                int iSteps = m_iWheelDelta/WHEEL_DELTA;
+                m_iWheelDelta -= iSteps*WHEEL_DELTA;
+                if (iSteps) Zoom(iSteps);
+                return 0;
+            }
+
+            case WM_KEYDOWN:
+                switch (wParam)
+                {
+                    case VK_SPACE:  SetPaused(!m_bPaused);  break;
+                    case VK_LEFT:   Pan(-1);                break;
+                    case VK_RIGHT:  Pan(1);                 break;
+                    default: break;
+                }
+                return 0;
+
+            default:                return DefWindowProcA(m_hWnd,uMsg,wParam,lParam);
+        }
+    }
+
+public:
+    CProfilerView() = default;
+    CProfilerView(const CProfilerView &) = delete;
+    CProfilerView & operator = (const CProfilerView &) = delete;
+    ~CProfilerView() { Destroy(); }
+
+    // Create() -- Create the view as a child window, and start recording (unless bEnable = false)
+    //
+    bool Create(HWND hParent,int iX,int iY,int iWidth,int iHeight,bool bEnable = true)
+    {
+        if (m_hWnd || !RegisterClass()) return false;
+        m_hWnd = CreateWindowExA(0,kClassName,"",WS_CHILD | WS_VISIBLE | WS_BORDER,iX,iY,iWidth,iHeight,hParent,nullptr,
+                                 GetModuleHandleA(nullptr),this);
+        if (!m_hWnd) return false;
+
+        if (bEnable) CProfiler::Enable(true);
+        if (!m_hFont) m_hFont = (HFONT) GetStockObject(DEFAULT_GUI_FONT);
+        UpdateRowHeight();
+        SetTimer(m_hWnd,kTimerId,kRefreshMs,nullptr);
+        Refresh();
+        return true;
+    }
+
+    bool Create(CWindow & cWin,int iX,int iY,int iWidth,int iHeight,bool bEnable = true)
+    {
+        return Create(cWin.GetWindowHandle(),iX,iY,iWidth,iHeight,bEnable);
+    }
+
+    void Destroy()
+    {
+        if (m_hWnd)
+        {
+            KillTimer(m_hWnd,kTimerId);
+            DestroyWindow(m_hWnd);
+        }
+        m_hWnd = nullptr;
+    }
+
+    bool isValid() const { return m_hWnd != nullptr; }
+    HWND GetWindowHandle() const { return m_hWnd; }
+
+    // SetPaused() -- Paused, the timeline stops moving (events are still collected, up to the history size)
+    //
+    void SetPaused(bool bPaused)
+    {
+        m_bPaused = bPaused;
+        Refresh();
+    }
+
+    bool isPaused() const { return m_bPaused; }
+
+    // SetSpan() -- Width of the timeline in milliseconds (default 100)
+    //
+    void SetSpan(double fMs)
+    {
+        long long llSpanNs = (long long) (fMs*1e6);
+        m_llSpanNs = llSpanNs < kMinSpanNs ? kMinSpanNs : llSpanNs > kMaxSpanNs ? kMaxSpanNs : llSpanNs;
+        Refresh();
+    }
+
+    // SetFont() -- The font is not owned (it must outlive the view).  nullptr uses the default GUI font.
+    //
+    void SetFont(HFONT hFont)
+    {
+        m_hFont = hFont ? hFont : (HFONT) GetStockObject(DEFAULT_GUI_FONT);
+        if (!m_hWnd) return;
+        UpdateRowHeight();
+        InvalidateRect(m_hWnd,nullptr,FALSE);
+    }
+};
+
+}; // namespace Sage
+#endif // _CProfilerView_H_
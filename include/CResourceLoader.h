@@ -0,0 +1,402 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CResourceLoader -- Lazy (on first use) resource loading with optional background prefetch, and a startup timeline trace.
+//
+// CDavinci loads its default styles, widgets, slider and dialog resources in its constructor, before the first window
+// appears.  Program resources (textures, styles, PGR files) are usually loaded the same way, all at once before the
+// program can show anything.
+//
+// CResourceLoader holds named resource groups, each with a load function.  A group is loaded:
+//
+//      1. On first use -- Require("Textures") loads the group if it is not loaded yet, and returns right away if it is.
+//         If the group is already being loaded (by another thread or the prefetch thread), Require() waits for it.
+//      2. In the background -- Prefetch("Textures") queues the group for the loader's worker thread, so it is usually
+//         loaded by the time it is needed.
+//
+// Every load is recorded in CStartupTrace (with the thread that ran it), along with any marks the program adds,
+// so the time to the first window and the groups that dominate it can be seen:
+//
+//      CResourceLoader cLoader;
+//      cLoader.Register("DialTextures",[&] { return LoadDialTextures(); });
+//      cLoader.Register("AboutPage",[&] { return LoadAboutPage(); });
+//
+//      cLoader.Prefetch("AboutPage");                        // Not needed for the first window
+//      cLoader.Require("DialTextures");                      // Needed now
+//
+//      auto & cWin = NewWindow(...);
+//      CStartupTrace::Mark("First Window",true);             // true = this is the first window
+//
+//      CStartupTrace::Print();                               // Timeline and per-group totals to stdout
+//
+// Load functions return true on success.  A group that fails is not retried (Require() keeps returning false) until Reset().
+//
+#if !defined(_CResourceLoader_H_)
+#define _CResourceLoader_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Sage
+{
+
+// CStartupTrace -- Process-wide timeline of startup events (resource loads and marks), in microseconds since process start.
+//
+// Times are measured from when the program's static data was initialized, which is as close to process start as
+// a header can get.
+//
+class CStartupTrace
+{
+public:
+    struct Event_t
+    {
+        std::string sName;
+        std::string sGroup;             // Empty for marks
+        long long   llStartUs;          // Microseconds since process start
+        long long   llEndUs;            // Same as llStartUs for marks
+        unsigned    uiThread;           // Small thread number (0 = first thread that recorded an event)
+        bool        bSuccess;
+    };
+
+private:
+    struct Trace_t
+    {
+        std::mutex                  mutex;
+        std::vector<Event_t>        vEvents;
+        long long                   llFirstWindowUs = -1;
+        std::atomic<unsigned>       uiNextThread{0};
+    };
+    static Trace_t & GetTrace() { static Trace_t stTrace; return stTrace; }
+
+public:
+    // Now() -- Microseconds since process start
+    //
+    static long long Now()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-GetStartTime()).count();
+    }
+
+    // GetStartTime() -- The time that Now() measures from (so other timelines, such as CProfiler's, can share it).
+    // Set on the first call, which kStartupTraceStart below makes happen during static initialization.
+    //
+    static std::chrono::steady_clock::time_point GetStartTime()
+    {
+        static const std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+        return tStart;
+    }
+
+    static unsigned GetThreadNumber()
+    {
+        thread_local unsigned uiThread = GetTrace().uiNextThread.fetch_add(1);
+        return uiThread;
+    }
+
+    static void AddEvent(const char * sName,const char * sGroup,long long llStartUs,long long llEndUs,bool bSuccess = true)
+    {
+        auto & stTrace = GetTrace();
+        Event_t stEvent{ sName ? sName : "",sGroup ? sGroup : "",llStartUs,llEndUs,GetThreadNumber(),bSuccess };
+        std::lock_guard<std::mutex> lock(stTrace.mutex);
+        stTrace.vEvents.push_back(std::move(stEvent));
+    }
+
+    // Mark() -- Add a point in time to the timeline.  bFirstWindow = true records the time-to-first-window
+    // (only the first such mark counts).
+    //
+    static void Mark(const char * sName,bool bFirstWindow = false)
+    {
+        long long llNow = Now();
+        AddEvent(sName,nullptr,llNow,llNow);
+        if (bFirstWindow)
+        {
+            auto & stTrace = GetTrace();
+            std::lock_guard<std::mutex> lock(stTrace.mutex);
+            if (stTrace.llFirstWindowUs < 0) stTrace.llFirstWindowUs = llNow;
+        }
+    }
+
+    // Scope -- Record the time from construction to destruction as one event
+    //
+    class Scope
+    {
+        const char    * m_sName;
+        const char    * m_sGroup;
+        long long       m_llStartUs;
+    public:
+        bool            bSuccess = true;
+        Scope(const char * sName,const char * sGroup = "Startup") : m_sName(sName), m_sGroup(sGroup), m_llStartUs(Now()) { }
+        ~Scope() { AddEvent(m_sName,m_sGroup,m_llStartUs,Now(),bSuccess); }
+    };
+
+    // GetTimeToFirstWindow() -- Microseconds from process start to Mark(...,true), or -1 if not marked yet.
+    //
+    static long long GetTimeToFirstWindow()
+    {
+        auto & stTrace = GetTrace();
+        std::lock_guard<std::mutex> lock(stTrace.mutex);
+        return stTrace.llFirstWindowUs;
+    }
+
+    static std::vector<Event_t> GetEvents()
+    {
+        auto & stTrace = GetTrace();
+        std::lock_guard<std::mutex> lock(stTrace.mutex);
+        return stTrace.vEvents;
+    }
+
+    static void Clear()
+    {
+        auto & stTrace = GetTrace();
+        std::lock_guard<std::mutex> lock(stTrace.mutex);
+        stTrace.vEvents.clear();
+        stTrace.llFirstWindowUs = -1;
+    }
+
+    // Print() -- Write the timeline (sorted by start time) and the total time for each resource, largest first.
+    //
+    static void Print(FILE * fOut = stdout)
+    {
+        auto vEvents = GetEvents();
+        std::stable_sort(vEvents.begin(),vEvents.end(),[](const Event_t & e1,const Event_t & e2) { return e1.llStartUs < e2.llStartUs; });
+
+        fprintf(fOut,"%10s %10s %6s  %-16s %s\n","Start(ms)","Time(ms)","Thread","Group","Name");
+        std::vector<std::pair<std::string,long long>> vGroups;
+        for (auto & stEvent : vEvents)
+        {
+            fprintf(fOut,"%10.3f %10.3f %6u  %-16s %s%s\n",stEvent.llStartUs/1000.0,(stEvent.llEndUs-stEvent.llStartUs)/1000.0,
+                    stEvent.uiThread,stEvent.sGroup.empty() ? "(mark)" : stEvent.sGroup.c_str(),stEvent.sName.c_str(),
+                    stEvent.bSuccess ? "" : "  ** FAILED **");
+
+            if (stEvent.sGroup.empty()) continue;
+            std::string sTotal = stEvent.sGroup + ": " + stEvent.sName;
+            auto it = std::find_if(vGroups.begin(),vGroups.end(),[&](auto & stGroup) { return stGroup.first == sTotal; });
+            if (it == vGroups.end()) vGroups.emplace_back(sTotal,stEvent.llEndUs-stEvent.llStartUs);
+            else it->second += stEvent.llEndUs-stEvent.llStartUs;
+        }
+
+        std::stable_sort(vGroups.begin(),vGroups.end(),[](auto & g1,auto & g2) { return g1.second > g2.second; });
+        fprintf(fOut,"\nTotal time by resource:\n");
+        for (auto & stGroup : vGroups) fprintf(fOut,"    %-40s %10.3f ms\n",stGroup.first.c_str(),stGroup.second/1000.0);
+
+        long long llFirstWindow = GetTimeToFirstWindow();
+        if (llFirstWindow >= 0) fprintf(fOut,"\nTime to first window: %.3f ms\n",llFirstWindow/1000.0);
+    }
+};
+
+class CResourceLoader
+{
+public:
+    enum class State
+    {
+        NotLoaded,
+        Queued,         // Waiting for the prefetch thread
+        Loading,
+        Loaded,
+        Failed,
+    };
+
+private:
+    struct Group_t
+    {
+        std::string             sName;
+        std::function<bool()>   fnLoad;
+        State                   eState = State::NotLoaded;
+    };
+
+    std::mutex                                      m_mutex;
+    std::condition_variable                         m_cvDone;           // Signaled when a group finishes loading
+    std::condition_variable                         m_cvQueue;          // Signaled when a group is queued for prefetch
+    std::unordered_map<std::string,std::unique_ptr<Group_t>> m_mapGroups;
+    std::deque<Group_t *>                           m_qPrefetch;
+    std::thread                                     m_thWorker;
+    bool                                            m_bStop = false;
+    const char                                    * m_sTraceGroup;
+
+    // Load() -- Load a group on the calling thread.  The lock is held on entry and exit, and released while loading.
+    //
+    bool Load(std::unique_lock<std::mutex> & lock,Group_t & stGroup)
+    {
+        stGroup.eState = State::Loading;
+        lock.unlock();
+
+        bool bSuccess = false;
+        {
+            CStartupTrace::Scope cScope(stGroup.sName.c_str(),m_sTraceGroup);
+            try { bSuccess = stGroup.fnLoad ? stGroup.fnLoad() : false; }
+            catch (...) { bSuccess = false; }
+            cScope.bSuccess = bSuccess;
+        }
+
+        lock.lock();
+        stGroup.eState = bSuccess ? State::Loaded : State::Failed;
+        m_cvDone.notify_all();
+        return bSuccess;
+    }
+
+    void Worker()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_cvQueue.wait(lock,[&] { return m_bStop || !m_qPrefetch.empty(); });
+            if (m_bStop) return;
+
+            auto stGroup = m_qPrefetch.front();
+            m_qPrefetch.pop_front();
+
+            // Require() may have loaded it (or be loading it) since it was queued
+
+            if (stGroup->eState == State::Queued) Load(lock,*stGroup);
+        }
+    }
+
+    Group_t * FindGroup(const char * sName)
+    {
+        auto it = m_mapGroups.find(sName ? sName : "");
+        return it == m_mapGroups.end() ? nullptr : it->second.get();
+    }
+
+public:
+    // sTraceGroup is the group name used for this loader's events in CStartupTrace
+    //
+    CResourceLoader(const char * sTraceGroup = "Resources") : m_sTraceGroup(sTraceGroup) { }
+    ~CResourceLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bStop = true;
+        }
+        m_cvQueue.notify_all();
+        if (m_thWorker.joinable()) m_thWorker.join();
+    }
+
+    CResourceLoader(const CResourceLoader &) = delete;
+    CResourceLoader & operator = (const CResourceLoader &) = delete;
+
+    // Register() -- Add a resource group.  Registering a group that exists replaces its load function if it has not been loaded.
+    //
+    bool Register(const char * sName,std::function<bool()> fnLoad)
+    {
+        if (!sName || !fnLoad) return false;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto & stGroup = m_mapGroups[sName];
+        if (!stGroup) stGroup.reset(new Group_t{ sName,nullptr,State::NotLoaded });
+        else if (stGroup->eState != State::NotLoaded) return false;
+        stGroup->fnLoad = std::move(fnLoad);
+        return true;
+    }
+
+    // Require() -- Make sure a group is loaded, loading it on this thread or waiting for the thread already loading it.
+    // Returns true if the group is loaded.
+    //
+    bool Require(const char * sName)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto stGroup = FindGroup(sName);
+        if (!stGroup) return false;
+
+        for (;;)
+        {
+            switch (stGroup->eState)
+            {
+                case State::Loaded:     return true;
+                case State::Failed:     return false;
+                case State::Loading:    m_cvDone.wait(lock); break;
+                default:                return Load(lock,*stGroup);      // Not loaded, or still in the prefetch queue
+            }
+        }
+    }
+
+    // Prefetch() -- Queue a group to be loaded on the background thread (started on first use).
+    //
+    bool Prefetch(const char * sName)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto stGroup = FindGroup(sName);
+        if (!stGroup) return false;
+        if (stGroup->eState != State::NotLoaded) return true;
+
+        stGroup->eState = State::Queued;
+        m_qPrefetch.push_back(stGroup);
+        if (!m_thWorker.joinable()) m_thWorker = std::thread([this] { Worker(); });
+        m_cvQueue.notify_one();
+        return true;
+    }
+
+    // PrefetchAll() -- Queue every registered group that is not loaded yet
+    //
+    void PrefetchAll()
+    {
+        std::vector<std::string> vNames;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (auto & stEntry : m_mapGroups) vNames.push_back(stEntry.first);
+        }
+        for (auto & sName : vNames) Prefetch(sName.c_str());
+    }
+
+    State GetState(const char * sName)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto stGroup = FindGroup(sName);
+        return stGroup ? stGroup->eState : State::NotLoaded;
+    }
+    bool isLoaded(const char * sName) { return GetState(sName) == State::Loaded; }
+
+    // Reset() -- Mark a failed or loaded group as not loaded, so the next Require() or Prefetch() loads it again.
+    //
+    bool Reset(const char * sName)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto stGroup = FindGroup(sName);
+        if (!stGroup || (stGroup->eState != State::Loaded && stGroup->eState != State::Failed)) return false;
+        stGroup->eState = State::NotLoaded;
+        return true;
+    }
+};
+
+// CLazyResource -- A single resource that is created on first use (thread-safe), i.e. a texture that only some windows need.
+//
+//      CLazyResource<CBitmap> cFace([] { return CDavinci::ReadPgrBitmap("DialFace",sPgr); },"DialFace");
+//      cWin.DisplayBitmap(*cFace.Get());
+//
+template <class _t>
+class CLazyResource
+{
+    std::once_flag          m_once;
+    std::function<_t()>     m_fnCreate;
+    std::unique_ptr<_t>     m_tValue;
+    const char            * m_sName;
+
+public:
+    CLazyResource(std::function<_t()> fnCreate,const char * sName = "Lazy Resource") : m_fnCreate(std::move(fnCreate)), m_sName(sName) { }
+
+    _t * Get()
+    {
+        std::call_once(m_once,[&]
+        {
+            CStartupTrace::Scope cScope(m_sName,"Lazy");
+            m_tValue.reset(new _t(m_fnCreate()));
+        });
+        return m_tValue.get();
+    }
+    _t * operator -> () { return Get(); }
+    _t & operator * () { return *Get(); }
+};
+
+// kStartupTraceStart -- Starts the CStartupTrace clock when the program starts rather than on the first Now()
+
+static const std::chrono::steady_clock::time_point kStartupTraceStart = CStartupTrace::GetStartTime();
+
+}; // namespace Sage
+#endif // _CResourceLoader_H_
@@ -0,0 +1,439 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CScrollback -- Bounded scrollback store of styled text lines (see CScrollbackView.h for the window that shows it)
+//
+// Text written to a window with Write() or printf() is drawn into the window's bitmap, so it is lost once it scrolls off,
+// and each scroll redraws the bitmap.  CScrollback keeps the text instead, as lines of styled spans:
+//
+//      - Lines are kept in chunks of 256.  Each chunk holds its lines' text and spans in three flat arrays, so adding a line
+//        is an append (no allocation per line) and dropping the oldest lines is dropping a chunk.
+//      - SetMaxLines() caps the history.  Whole chunks are dropped, so between iMaxLines and iMaxLines+255 lines are kept.
+//        Dropped chunks are reused, so a full scrollback appends without allocating.
+//      - Lines have absolute numbers (GetFirstLine() .. GetEndLine()-1) which stay the same as older lines are dropped.
+//      - The last line is open: text is added to it until a '\n'.
+//
+// Threads:
+//
+//      Write(), printf()   -- Any thread.  The text is formatted and its markup resolved on the calling thread, then pushed
+//                             onto a lock-free queue (one compare-exchange).  Nothing is added to the store until Drain().
+//      Drain()             -- The thread that owns the store (i.e. the window's thread) moves the queued text into the
+//                             store, in the order it was written.  CScrollbackView does this on a timer.
+//      Append(), GetLine() -- The owning thread only.
+//
+// Markup is the same as printf() and Write() in CWindow: {<color>}, {bg=<color>} and {/} (see CFormatCache).  Other {}
+// markup, such as {x=40}, is removed.
+//
+#if !defined(_CScrollback_H_)
+#define _CScrollback_H_
+
+#include <Windows.h>
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "CColorTable.h"
+#include "CFormatCache.h"
+
+namespace Sage
+{
+
+class CScrollback
+{
+public:
+    static constexpr int kLinesPerChunk     = 256;
+    static constexpr int kDefaultMaxLines   = 100000;
+
+    // Span_t -- A run of text in one style.  iStart is from the start of the line.
+
+    struct Span_t
+    {
+        int             iStart;
+        int             iLength;
+        FormatStyle_t   stStyle;
+    };
+
+    // Line_t -- A line as returned by GetLine().  Valid until the next Append() or Drain().
+
+    struct Line_t
+    {
+        const char    * sText;
+        int             iLength;
+        const Span_t  * stSpans;
+        int             iNumSpans;
+    };
+
+private:
+    struct LineEntry_t
+    {
+        int iText;              // Offset in Chunk_t::vText
+        int iLength;
+        int iSpan;              // First span in Chunk_t::vSpans
+        int iNumSpans;
+    };
+
+    struct Chunk_t
+    {
+        std::vector<char>           vText;
+        std::vector<Span_t>         vSpans;
+        std::vector<LineEntry_t>    vLines;
+
+        void Clear()
+        {
+            vText.clear();
+            vSpans.clear();
+            vLines.clear();
+        }
+    };
+
+    // Post_t -- Queued text: a header, then iNumRuns Run_t, then the text of all runs
+
+    struct Run_t
+    {
+        int             iLength;
+        FormatStyle_t   stStyle;
+    };
+
+    struct Post_t
+    {
+        Post_t        * pNext;
+        int             iNumRuns;
+        int             iTextLength;
+
+        Run_t * GetRuns() { return (Run_t *) (this+1); }
+        char * GetText() { return (char *) (GetRuns() + iNumRuns); }
+    };
+
+    // CRunBuilder -- Sink for CFormatCache (and the Write() markup parser): collects text runs on the writing thread
+
+    struct CRunBuilder
+    {
+        std::vector<Run_t>  vRuns;
+        std::string         sText;
+
+        void Reset()
+        {
+            vRuns.clear();
+            sText.clear();
+        }
+
+        void Text(const char * sRun,int iLength,const FormatStyle_t & stStyle)
+        {
+            if (iLength <= 0) return;
+            if (!vRuns.empty() && SameStyle(vRuns.back().stStyle,stStyle)) vRuns.back().iLength += iLength;
+            else vRuns.push_back({ iLength,stStyle });
+            sText.append(sRun,iLength);
+        }
+
+        void Markup(const char *,int) { }       // {x=40} etc. have no meaning in the scrollback
+    };
+
+    std::deque<std::unique_ptr<Chunk_t>>    m_vChunks;
+    std::vector<std::unique_ptr<Chunk_t>>   m_vFreeChunks;
+    uint64_t                m_ullBase           = 0;        // Absolute number of the first line in m_vChunks[0]
+    int                     m_iMaxLines         = kDefaultMaxLines;
+    uint64_t                m_ullDropped        = 0;
+
+    std::atomic<Post_t *>   m_pPosts{nullptr};             // Lock-free stack of queued text (newest first)
+    std::atomic<long long>  m_llPosted{0};
+
+    static bool SameStyle(const FormatStyle_t & st1,const FormatStyle_t & st2)
+    {
+        return st1.bFgColor == st2.bFgColor && st1.bBgColor == st2.bBgColor && (!st1.bFgColor || st1.dwFgColor == st2.dwFgColor) &&
+               (!st1.bBgColor || st1.dwBgColor == st2.dwBgColor);
+    }
+
+    static CRunBuilder & GetRunBuilder()
+    {
+        thread_local CRunBuilder cBuilder;
+        cBuilder.Reset();
+        return cBuilder;
+    }
+
+    Chunk_t * NewChunk()
+    {
+        std::unique_ptr<Chunk_t> pChunk;
+        if (!m_vFreeChunks.empty())
+        {
+            pChunk = std::move(m_vFreeChunks.back());
+            m_vFreeChunks.pop_back();
+        }
+        else pChunk = std::make_unique<Chunk_t>();
+
+        m_vChunks.push_back(std::move(pChunk));
+        return m_vChunks.back().get();
+    }
+
+    void NewLine()
+    {
+        Chunk_t * pChunk = m_vChunks.empty() ? nullptr : m_vChunks.back().get();
+        if (!pChunk || (int) pChunk->vLines.size() == kLinesPerChunk) pChunk = NewChunk();
+        pChunk->vLines.push_back({ (int) pChunk->vText.size(),0,(int) pChunk->vSpans.size(),0 });
+
+        // Drop the oldest chunk once the lines after it reach the cap
+
+        while (m_vChunks.size() > 1 && GetLineCount() - kLinesPerChunk >= (uint64_t) m_iMaxLines)
+        {
+            m_vChunks.front()->Clear();
+            if (m_vFreeChunks.size() < 2) m_vFreeChunks.push_back(std::move(m_vChunks.front()));
+            m_vChunks.pop_front();
+            m_ullBase       += kLinesPerChunk;
+            m_ullDropped    += kLinesPerChunk;
+        }
+    }
+
+    // AddText() -- Add text without newlines to the open line
+
+    void AddText(const char * sText,int iLength,const FormatStyle_t & stStyle)
+    {
+        if (iLength <= 0) return;
+        Chunk_t * pChunk = m_vChunks.back().get();
+        LineEntry_t & stLine = pChunk->vLines.back();
+
+        if (stLine.iNumSpans && SameStyle(pChunk->vSpans.back().stStyle,stStyle)) pChunk->vSpans.back().iLength += iLength;
+        else
+        {
+            pChunk->vSpans.push_back({ stLine.iLength,iLength,stStyle });
+            stLine.iNumSpans++;
+        }
+        pChunk->vText.insert(pChunk->vText.end(),sText,sText+iLength);
+        stLine.iLength += iLength;
+    }
+
+    // ParseMarkup() -- Write() text to runs: {<color>}, {bg=<color>} and {/} as in CFormatCache; other {} markup is removed
+    //                  (and popped by its {/}); a '{' with no '}' is text.
+
+    static void ParseMarkup(CRunBuilder & cRuns,const char * sText,int iLength)
+    {
+        static constexpr int kMaxDepth = 16;
+        struct Stack_t { FormatStyle_t stStyle; bool bMarkup; } stStack[kMaxDepth];
+        FormatStyle_t stStyle;
+        int iDepth = 0;
+        int iRunStart = 0;
+
+        auto fnPush = [&](bool bMarkup)
+        {
+            if (iDepth < kMaxDepth) stStack[iDepth] = { stStyle,bMarkup };
+            iDepth++;
+        };
+
+        for (int i=0;i<iLength;i++)
+        {
+            if (sText[i] != '{') continue;
+            const char * sEnd = (const char *) memchr(sText+i+1,'}',iLength-i-1);
+            if (!sEnd) break;
+
+            cRuns.Text(sText+iRunStart,i-iRunStart,stStyle);
+            const char * sTag = sText+i+1;
+            int iTagLength = (int) (sEnd - sTag);
+            DWORD dwColor;
+
+            if (iTagLength == 1 && *sTag == '/')
+            {
+                if (iDepth && iDepth <= kMaxDepth && !stStack[iDepth-1].bMarkup) stStyle = stStack[iDepth-1].stStyle;
+                if (iDepth) iDepth--;
+            }
+            else if (iTagLength > 3 && !_strnicmp(sTag,"bg=",3) && CColorTable::GetColor(sTag+3,iTagLength-3,dwColor))
+            {
+                fnPush(false);
+                stStyle.dwBgColor   = dwColor;
+                stStyle.bBgColor    = true;
+            }
+            else if (CColorTable::GetColor(sTag,iTagLength,dwColor))
+            {
+                fnPush(false);
+                stStyle.dwFgColor   = dwColor;
+                stStyle.bFgColor    = true;
+            }
+            else fnPush(true);
+
+            i = (int) (sEnd - sText);
+            iRunStart = i+1;
+        }
+        cRuns.Text(sText+iRunStart,iLength-iRunStart,stStyle);
+    }
+
+    void Post(const CRunBuilder & cRuns)
+    {
+        if (cRuns.vRuns.empty()) return;
+
+        size_t szRuns = cRuns.vRuns.size()*sizeof(Run_t);
+        auto pPost = (Post_t *) malloc(sizeof(Post_t) + szRuns + cRuns.sText.size());
+        if (!pPost) return;
+
+        pPost->iNumRuns     = (int) cRuns.vRuns.size();
+        pPost->iTextLength  = (int) cRuns.sText.size();
+        memcpy(pPost->GetRuns(),cRuns.vRuns.data(),szRuns);
+        memcpy(pPost->GetText(),cRuns.sText.data(),cRuns.sText.size());
+
+        pPost->pNext = m_pPosts.load(std::memory_order_relaxed);
+        while (!m_pPosts.compare_exchange_weak(pPost->pNext,pPost,std::memory_order_release,std::memory_order_relaxed));
+        m_llPosted.fetch_add(1,std::memory_order_relaxed);
+    }
+
+public:
+    CScrollback() { NewLine(); }
+    CScrollback(const CScrollback &) = delete;
+    CScrollback & operator = (const CScrollback &) = delete;
+
+    ~CScrollback()
+    {
+        for (Post_t * pPost = m_pPosts.exchange(nullptr);pPost;)
+        {
+            Post_t * pNext = pPost->pNext;
+            free(pPost);
+            pPost = pNext;
+        }
+    }
+
+    // SetMaxLines() -- Cap the number of lines kept (older lines are dropped a chunk at a time).  Takes effect with the
+    // next line added.
+    //
+    void SetMaxLines(int iMaxLines) { m_iMaxLines = iMaxLines < kLinesPerChunk ? kLinesPerChunk : iMaxLines; }
+    int GetMaxLines() const { return m_iMaxLines; }
+
+    // Write() -- Queue text with Sagebox markup, i.e. Write("Status: {g}Ok{/}\n").  Any thread.
+    //
+    void Write(const char * sText)
+    {
+        if (!sText) return;
+        auto & cRuns = GetRunBuilder();
+        ParseMarkup(cRuns,sText,(int) strlen(sText));
+        Post(cRuns);
+    }
+
+    // printf() -- Queue formatted text, as CWindow::printf().  Any thread.
+    //
+    void printf(const char * sFormat,...)
+    {
+        va_list vaArgs;
+        va_start(vaArgs,sFormat);
+        vprintf(sFormat,vaArgs);
+        va_end(vaArgs);
+    }
+
+    void vprintf(const char * sFormat,va_list vaArgs)
+    {
+        if (!sFormat) return;
+        auto & cRuns = GetRunBuilder();
+        CFormatCache::vPrintf(cRuns,sFormat,vaArgs);
+        Post(cRuns);
+    }
+
+    // isPending() -- True if there is queued text for Drain().  Any thread.
+    //
+    bool isPending() const { return m_pPosts.load(std::memory_order_relaxed) != nullptr; }
+
+    // GetPostCount() -- Number of Write()/printf() calls so far.  Any thread.
+    //
+    long long GetPostCount() const { return m_llPosted.load(std::memory_order_relaxed); }
+
+    // Drain() -- Move queued text into the store.  Owning thread only.  Returns the number of Write()/printf() calls drained.
+    //
+    int Drain()
+    {
+        Post_t * pPost = m_pPosts.exchange(nullptr,std::memory_order_acquire);
+        if (!pPost) return 0;
+
+        // The queue is a stack; reverse it to get the writes in order
+
+        Post_t * pOrdered = nullptr;
+        while (pPost)
+        {
+            Post_t * pNext = pPost->pNext;
+            pPost->pNext = pOrdered;
+            pOrdered = pPost;
+            pPost = pNext;
+        }
+
+        int iCount = 0;
+        for (pPost = pOrdered;pPost;iCount++)
+        {
+            const char * sText = pPost->GetText();
+            Run_t * stRuns = pPost->GetRuns();
+            for (int i=0;i<pPost->iNumRuns;i++)
+            {
+                Append(sText,stRuns[i].iLength,stRuns[i].stStyle);
+                sText += stRuns[i].iLength;
+            }
+
+            Post_t * pNext = pPost->pNext;
+            free(pPost);
+            pPost = pNext;
+        }
+        return iCount;
+    }
+
+    // Append() -- Add text in one style directly (no markup).  Owning thread only.
+    //
+    void Append(const char * sText,int iLength,const FormatStyle_t & stStyle = FormatStyle_t())
+    {
+        for (const char * sEnd = sText + iLength;sText < sEnd;)
+        {
+            auto sNewline = (const char *) memchr(sText,'\n',sEnd-sText);
+            const char * sStop = sNewline ? sNewline : sEnd;
+            int iRun = (int) (sStop - sText);
+            if (iRun && sStop[-1] == '\r') iRun--;
+
+            AddText(sText,iRun,stStyle);
+            if (!sNewline) break;
+            NewLine();
+            sText = sNewline+1;
+        }
+    }
+
+    // GetFirstLine(), GetEndLine() -- The lines kept are GetFirstLine() to GetEndLine()-1.  The last one is the open line.
+    //
+    uint64_t GetFirstLine() const { return m_ullBase; }
+    uint64_t GetEndLine() const { return m_ullBase + GetLineCount(); }
+    uint64_t GetLineCount() const { return (uint64_t) (m_vChunks.size()-1)*kLinesPerChunk + m_vChunks.back()->vLines.size(); }
+    uint64_t GetDroppedLines() const { return m_ullDropped; }
+
+    // GetLine() -- A line by its absolute number.  Returns false if it has been dropped or does not exist yet.
+    //
+    bool GetLine(uint64_t ullLine,Line_t & stLine) const
+    {
+        if (ullLine < m_ullBase || ullLine >= GetEndLine()) return false;
+
+        uint64_t ullIndex = ullLine - m_ullBase;
+        const Chunk_t & stChunk = *m_vChunks[(size_t) (ullIndex/kLinesPerChunk)];
+        const LineEntry_t & stEntry = stChunk.vLines[(size_t) (ullIndex % kLinesPerChunk)];
+
+        stLine.sText        = stChunk.vText.data() + stEntry.iText;
+        stLine.iLength      = stEntry.iLength;
+        stLine.stSpans      = stChunk.vSpans.data() + stEntry.iSpan;
+        stLine.iNumSpans    = stEntry.iNumSpans;
+        return true;
+    }
+
+    // Clear() -- Remove all lines (queued text is kept).  Line numbers continue from where they were.
+    //
+    void Clear()
+    {
+        uint64_t ullEnd = GetEndLine();
+        while (!m_vChunks.empty())
+        {
+            m_vChunks.back()->Clear();
+            if (m_vFreeChunks.size() < 2) m_vFreeChunks.push_back(std::move(m_vChunks.back()));
+            m_vChunks.pop_back();
+        }
+        m_ullBase = ullEnd;
+        NewLine();
+    }
+
+    size_t GetMemoryUsed() const
+    {
+        size_t szBytes = 0;
+        for (auto & pChunk : m_vChunks)
+            szBytes += pChunk->vText.capacity() + pChunk->vSpans.capacity()*sizeof(Span_t) + pChunk->vLines.capacity()*sizeof(LineEntry_t);
+        return szBytes;
+    }
+};
+
+}; // namespace Sage
+#endif // _CScrollback_H_
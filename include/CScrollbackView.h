@@ -0,0 +1,434 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CScrollbackView -- Text console window backed by a CScrollback
+//
+// A child window (i.e. in a CWindow or the DevWindow) for continuous log output.  The text is kept in a CScrollback, so
+// the history can be scrolled back through, up to the line cap, and the cost of output does not grow with the history:
+//
+//      - Write() and printf() may be called from any thread.  They only queue the text (see CScrollback).
+//      - A timer (every 30ms) drains the queue.  Everything written since the last tick is shown with one scroll.
+//      - New lines scroll the window with ScrollWindowEx(), which moves the pixels already drawn, so only the rows
+//        uncovered at the bottom (and the open line) are drawn.
+//      - WM_PAINT draws only the rows in the update rectangle.
+//
+// When the view is scrolled to the bottom it follows the output; when it has been scrolled up it stays where it is
+// (and the lines it shows stay the same until they are dropped by the line cap).
+//
+// Example:
+//
+//      CScrollbackView cLog;
+//      cLog.Create(*Sage::DevGetWindow(),10,10,400,300);      // or any CWindow
+//      cLog.SetMaxLines(50000);
+//
+//      std::thread([&] { for (int i=0;;i++) cLog.printf("Item {g}%d{/} done\n",i); }).detach();
+//
+#if !defined(_CScrollbackView_H_)
+#define _CScrollbackView_H_
+
+#include <Windows.h>
+#include <chrono>
+#include <cstdarg>
+#include "CSageBox.h"
+#include "CScrollback.h"
+#include "SageProfile.h"
+
+namespace Sage
+{
+
+class CScrollbackView
+{
+public:
+    struct Stats_t
+    {
+        int     iPaints;            // WM_PAINT calls
+        int     iRowsPainted;       // Rows drawn by all paints
+        int     iScrolls;           // Blit scrolls (ScrollWindowEx())
+        int     iFullRedraws;       // Redraws of the whole window (i.e. more new lines than fit in the window)
+        double  fLastPaintMs;
+    };
+
+private:
+    static constexpr const char * kClassName    = "SageScrollbackView";
+    static constexpr UINT_PTR kTimerId          = 1;
+    static constexpr UINT kDrainMs              = 30;
+
+    HWND            m_hWnd          = nullptr;
+    HFONT           m_hFont         = nullptr;
+    CScrollback     m_cStore;
+
+    uint64_t        m_ullTop        = 0;            // Absolute number of the top line
+    int             m_iRowHeight    = 16;
+    int             m_iWheelDelta   = 0;
+    bool            m_bFollow       = true;         // Keep the last line in view
+
+    COLORREF        m_rgbText       = RGB(0,0,0);
+    COLORREF        m_rgbBackground = RGB(255,255,255);
+    Stats_t         m_stStats{};
+
+    static bool RegisterClass()
+    {
+        static const bool bRegistered = []
+        {
+            WNDCLASSEXA stClass{};
+            stClass.cbSize          = sizeof(stClass);
+            stClass.lpfnWndProc     = WindowProc;
+            stClass.hInstance       = GetModuleHandleA(nullptr);
+            stClass.hCursor         = LoadCursor(nullptr,IDC_ARROW);
+            stClass.lpszClassName   = kClassName;
+            return RegisterClassExA(&stClass) != 0 || GetLastError() == ERROR_CLASS_ALREADY_EXISTS;
+        }();
+        return bRegistered;
+    }
+
+    static LRESULT CALLBACK WindowProc(HWND hWnd,UINT uMsg,WPARAM wParam,LPARAM lParam)
+    {
+        if (uMsg == WM_NCCREATE)
+            SetWindowLongPtrA(hWnd,GWLP_USERDATA,(LONG_PTR) ((CREATESTRUCTA *) lParam)->lpCreateParams);
+
+        auto cView = (CScrollbackView *) GetWindowLongPtrA(hWnd,GWLP_USERDATA);
+        if (!cView) return DefWindowProcA(hWnd,uMsg,wParam,lParam);
+        if (uMsg == WM_NCDESTROY)
+        {
+            SetWindowLongPtrA(hWnd,GWLP_USERDATA,0);
+            cView->m_hWnd = nullptr;
+            return DefWindowProcA(hWnd,uMsg,wParam,lParam);
+        }
+        return cView->HandleMessage(uMsg,wParam,lParam);
+    }
+
+    int GetVisibleRows() const
+    {
+        RECT rClient{};
+        if (m_hWnd) GetClientRect(m_hWnd,&rClient);
+        int iRows = (rClient.bottom - rClient.top)/m_iRowHeight;
+        return iRows < 1 ? 1 : iRows;
+    }
+
+    // GetBottomTop() -- The top line that puts the last line at the bottom of the window
+
+    uint64_t GetBottomTop() const
+    {
+        uint64_t ullEnd = m_cStore.GetEndLine();
+        uint64_t ullRows = (uint64_t) GetVisibleRows();
+        return ullEnd - m_cStore.GetFirstLine() > ullRows ? ullEnd - ullRows : m_cStore.GetFirstLine();
+    }
+
+    void ClampTop()
+    {
+        if (m_ullTop < m_cStore.GetFirstLine()) m_ullTop = m_cStore.GetFirstLine();
+        if (m_ullTop > GetBottomTop()) m_ullTop = GetBottomTop();
+    }
+
+    void UpdateRowHeight()
+    {
+        HDC hDC = GetDC(m_hWnd);
+        HGDIOBJ hOld = SelectObject(hDC,m_hFont);
+        TEXTMETRICA stMetrics{};
+        GetTextMetricsA(hDC,&stMetrics);
+        SelectObject(hDC,hOld);
+        ReleaseDC(m_hWnd,hDC);
+        m_iRowHeight = stMetrics.tmHeight > 4 ? stMetrics.tmHeight : 16;
+    }
+
+    // UpdateScrollBar() -- Positions are relative to the first line kept (the scroll range is bounded by the line cap)
+
+    void UpdateScrollBar()
+    {
+        SCROLLINFO stInfo{};
+        stInfo.cbSize   = sizeof(stInfo);
+        stInfo.fMask    = SIF_RANGE | SIF_PAGE | SIF_POS;
+        stInfo.nMin     = 0;
+        stInfo.nMax     = (int) (m_cStore.GetLineCount()-1);
+        stInfo.nPage    = GetVisibleRows();
+        stInfo.nPos     = (int) (m_ullTop - m_cStore.GetFirstLine());
+        SetScrollInfo(m_hWnd,SB_VERT,&stInfo,TRUE);
+    }
+
+    // ScrollTo() -- Move the top line, moving the pixels already drawn when the old and new views overlap
+
+    void ScrollTo(uint64_t ullTop)
+    {
+        uint64_t ullOldTop = m_ullTop;
+        m_ullTop = ullTop;
+        ClampTop();
+        m_bFollow = m_ullTop == GetBottomTop();
+        UpdateScrollBar();
+        if (m_ullTop == ullOldTop) return;
+
+        long long llDelta = (long long) (m_ullTop - ullOldTop);
+        if (llDelta < GetVisibleRows() && -llDelta < GetVisibleRows())
+        {
+            ScrollWindowEx(m_hWnd,0,(int) -llDelta*m_iRowHeight,nullptr,nullptr,nullptr,nullptr,SW_INVALIDATE);
+            m_stStats.iScrolls++;
+        }
+        else
+        {
+            InvalidateRect(m_hWnd,nullptr,FALSE);
+            m_stStats.iFullRedraws++;
+        }
+    }
+
+    void InvalidateLine(uint64_t ullLine)
+    {
+        if (ullLine < m_ullTop) return;
+        uint64_t ullRow = ullLine - m_ullTop;
+        if (ullRow >= (uint64_t) GetVisibleRows() + 1) return;
+
+        RECT rClient;
+        GetClientRect(m_hWnd,&rClient);
+        RECT rRow = { 0,(int) ullRow*m_iRowHeight,rClient.right,(int) (ullRow+1)*m_iRowHeight };
+        InvalidateRect(m_hWnd,&rRow,FALSE);
+    }
+
+    // OnDrain() -- Timer: move queued text into the store and bring it into view
+
+    void OnDrain()
+    {
+        SageProfileZone("CScrollbackView::Drain");
+        uint64_t ullOldEnd = m_cStore.GetEndLine();
+        if (!m_cStore.Drain()) return;
+
+        if (m_bFollow) ScrollTo(GetBottomTop());
+        else
+        {
+            // Scrolled back: keep the same lines in view unless they were dropped
+
+            uint64_t ullOldTop = m_ullTop;
+            ClampTop();
+            if (m_ullTop != ullOldTop) InvalidateRect(m_hWnd,nullptr,FALSE);
+            UpdateScrollBar();
+        }
+        InvalidateLine(ullOldEnd-1);            // The open line may have grown
+    }
+
+    void Paint()
+    {
+        SageProfileZone("CScrollbackView::Paint");
+        auto tStart = std::chrono::steady_clock::now();
+
+        PAINTSTRUCT stPaint;
+        HDC hDC = BeginPaint(m_hWnd,&stPaint);
+        RECT rClient;
+        GetClientRect(m_hWnd,&rClient);
+        HGDIOBJ hOldFont = SelectObject(hDC,m_hFont);
+
+        // Only the rows in the update rectangle.  Each row is drawn opaque, so there is no erase and no flicker.
+
+        int iFirstRow   = stPaint.rcPaint.top/m_iRowHeight;
+        int iLastRow    = (stPaint.rcPaint.bottom + m_iRowHeight - 1)/m_iRowHeight;
+
+        for (int iRow = iFirstRow;iRow < iLastRow;iRow++)
+        {
+            RECT rRow = { 0,iRow*m_iRowHeight,rClient.right,(iRow+1)*m_iRowHeight };
+            int iX = 2;
+
+            CScrollback::Line_t stLine;
+            if (m_cStore.GetLine(m_ullTop + iRow,stLine))
+            {
+                for (int i=0;i<stLine.iNumSpans && iX < rClient.right;i++)
+                {
+                    auto & stSpan = stLine.stSpans[i];
+                    const char * sText = stLine.sText + stSpan.iStart;
+                    SIZE stSize{};
+                    GetTextExtentPoint32A(hDC,sText,stSpan.iLength,&stSize);
+
+                    RECT rSpan = { iX,rRow.top,iX + stSize.cx,rRow.bottom };
+                    SetTextColor(hDC,stSpan.stStyle.bFgColor ? stSpan.stStyle.dwFgColor : m_rgbText);
+                    SetBkColor(hDC,stSpan.stStyle.bBgColor ? stSpan.stStyle.dwBgColor : m_rgbBackground);
+                    ExtTextOutA(hDC,iX,rRow.top,ETO_OPAQUE | ETO_CLIPPED,&rSpan,sText,(UINT) stSpan.iLength,nullptr);
+                    iX += stSize.cx;
+                }
+            }
+
+            // The rest of the row, and the left margin
+
+            SetBkColor(hDC,m_rgbBackground);
+            RECT rFill = { iX < rClient.right ? iX : rClient.right,rRow.top,rClient.right,rRow.bottom };
+            ExtTextOutA(hDC,0,0,ETO_OPAQUE,&rFill,nullptr,0,nullptr);
+            RECT rMargin = { 0,rRow.top,2,rRow.bottom };
+            ExtTextOutA(hDC,0,0,ETO_OPAQUE,&rMargin,nullptr,0,nullptr);
+        }
+
+        SelectObject(hDC,hOldFont);
+        EndPaint(m_hWnd,&stPaint);
+
+        m_stStats.iPaints++;
+        m_stStats.iRowsPainted += iLastRow - iFirstRow;
+        m_stStats.fLastPaintMs = std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+    }
+
+    void OnScroll(int iCode)
+    {
+        int iPage = GetVisibleRows();
+        switch (iCode)
+        {
+            case SB_LINEUP:         ScrollBy(-1);                               break;
+            case SB_LINEDOWN:       ScrollBy(1);                                break;
+            case SB_PAGEUP:         ScrollBy(-iPage);                           break;
+            case SB_PAGEDOWN:       ScrollBy(iPage);                            break;
+            case SB_TOP:            ScrollTo(m_cStore.GetFirstLine());          break;
+            case SB_BOTTOM:         ScrollTo(GetBottomTop());                   break;
+            case SB_THUMBTRACK:
+            case SB_THUMBPOSITION:
+            {
+                SCROLLINFO stInfo{};
+                stInfo.cbSize   = sizeof(stInfo);
+                stInfo.fMask    = SIF_TRACKPOS;             // 32-bit position (the WM_VSCROLL position is only 16 bits)
+                GetScrollInfo(m_hWnd,SB_VERT,&stInfo);
+                ScrollTo(m_cStore.GetFirstLine() + stInfo.nTrackPos);
+                break;
+            }
+            default: break;
+        }
+    }
+
+    void ScrollBy(int iLines)
+    {
+        if (iLines < 0 && m_ullTop - m_cStore.GetFirstLine() < (uint64_t) -iLines) ScrollTo(m_cStore.GetFirstLine());
+        else ScrollTo(m_ullTop + iLines);
+    }
+
+    LRESULT HandleMessage(UINT uMsg,WPARAM wParam,LPARAM lParam)
+    {
+        switch (uMsg)
+        {
+            case WM_PAINT:          Paint();                    return 0;
+            case WM_ERASEBKGND:                                 return 1;
+            case WM_TIMER:          if (wParam == kTimerId) OnDrain(); return 0;
+            case WM_VSCROLL:        OnScroll(LOWORD(wParam));   return 0;
+            case WM_SIZE:
+                if (m_bFollow) m_ullTop = GetBottomTop();
+                ClampTop();
+                UpdateScrollBar();
+                InvalidateRect(m_hWnd,nullptr,FALSE);
+                return 0;
+
+            case WM_MOUSEWHEEL:
+            {
+                UINT uiLines = 3;
+                SystemParametersInfoA(SPI_GETWHEELSCROLLLINES,0,&uiLines,0);
+                m_iWheelDelta += GET_WHEEL_DELTA_WPARAM(wParam);
+                int iSteps = m_iWheelDelta/WHEEL_DELTA;
+                m_iWheelDelta -= iSteps*WHEEL_DELTA;
+                ScrollBy(-iSteps*(int) uiLines);
+                return 0;
+            }
+
+            case WM_KEYDOWN:
+                switch (wParam)
+                {
+                    case VK_UP:     ScrollBy(-1);                       break;
+                    case VK_DOWN:   ScrollBy(1);                        break;
+                    case VK_PRIOR:  ScrollBy(-GetVisibleRows());        break;
+                    case VK_NEXT:   ScrollBy(GetVisibleRows());         break;
+                    case VK_HOME:   ScrollTo(m_cStore.GetFirstLine());  break;
+                    case VK_END:    ScrollTo(GetBottomTop());           break;
+                    default: break;
+                }
+                return 0;
+
+            case WM_LBUTTONDOWN:    SetFocus(m_hWnd);           return 0;
+            default:                return DefWindowProcA(m_hWnd,uMsg,wParam,lParam);
+        }
+    }
+
+public:
+    CScrollbackView() = default;
+    CScrollbackView(const CScrollbackView &) = delete;
+    CScrollbackView & operator = (const CScrollbackView &) = delete;
+    ~CScrollbackView() { Destroy(); }
+
+    // Create() -- Create the view as a child window.  Text written before Create() is kept and shown.
+    //
+    bool Create(HWND hParent,int iX,int iY,int iWidth,int iHeight)
+    {
+        if (m_hWnd || !RegisterClass()) return false;
+        m_hWnd = CreateWindowExA(0,kClassName,"",WS_CHILD | WS_VISIBLE | WS_VSCROLL | WS_BORDER,iX,iY,iWidth,iHeight,hParent,nullptr,
+                                 GetModuleHandleA(nullptr),this);
+        if (!m_hWnd) return false;
+
+        if (!m_hFont) m_hFont = (HFONT) GetStockObject(ANSI_FIXED_FONT);
+        UpdateRowHeight();
+        SetTimer(m_hWnd,kTimerId,kDrainMs,nullptr);
+        OnDrain();
+        UpdateScrollBar();
+        return true;
+    }
+
+    bool Create(CWindow & cWin,int iX,int iY,int iWidth,int iHeight) { return Create(cWin.GetWindowHandle(),iX,iY,iWidth,iHeight); }
+
+    void Destroy()
+    {
+        if (m_hWnd)
+        {
+            KillTimer(m_hWnd,kTimerId);
+            DestroyWindow(m_hWnd);
+        }
+        m_hWnd = nullptr;
+    }
+
+    bool isValid() const { return m_hWnd != nullptr; }
+    HWND GetWindowHandle() const { return m_hWnd; }
+
+    // Write(), printf() -- Add text (with Sagebox markup).  Any thread; shown on the next timer tick.
+    //
+    void Write(const char * sText) { m_cStore.Write(sText); }
+
+    void printf(const char * sFormat,...)
+    {
+        va_list vaArgs;
+        va_start(vaArgs,sFormat);
+        m_cStore.vprintf(sFormat,vaArgs);
+        va_end(vaArgs);
+    }
+
+    // Flush() -- Show queued text now rather than on the next tick.  Window thread only.
+    //
+    void Flush() { if (m_hWnd) OnDrain(); }
+
+    // Cls() -- Clear the text.  Window thread only.
+    //
+    void Cls()
+    {
+        m_cStore.Drain();
+        m_cStore.Clear();
+        m_ullTop = m_cStore.GetFirstLine();
+        m_bFollow = true;
+        if (m_hWnd)
+        {
+            UpdateScrollBar();
+            InvalidateRect(m_hWnd,nullptr,FALSE);
+        }
+    }
+
+    void SetMaxLines(int iMaxLines) { m_cStore.SetMaxLines(iMaxLines); }
+
+    // SetFont() -- The font is not owned (it must outlive the view).  nullptr uses the stock fixed font.
+    //
+    void SetFont(HFONT hFont)
+    {
+        m_hFont = hFont ? hFont : (HFONT) GetStockObject(ANSI_FIXED_FONT);
+        if (!m_hWnd) return;
+        UpdateRowHeight();
+        ClampTop();
+        UpdateScrollBar();
+        InvalidateRect(m_hWnd,nullptr,FALSE);
+    }
+
+    void SetColors(COLORREF rgbText,COLORREF rgbBackground)
+    {
+        m_rgbText       = rgbText;
+        m_rgbBackground = rgbBackground;
+        if (m_hWnd) InvalidateRect(m_hWnd,nullptr,FALSE);
+    }
+
+    // GetStore() -- The scrollback (window thread only, except for its Write() and printf())
+    //
+    CScrollback & GetStore() { return m_cStore; }
+
+    const Stats_t & GetStats() const { return m_stStats; }
+};
+
+}; // namespace Sage
+#endif // _CScrollbackView_H_
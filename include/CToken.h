@@ -32,6 +32,90 @@ extern int gMessagesOff;
 const int TokenInsert_File   = 1;
 const int TokenInsert_Define = 2;
 
+enum TokenType
+{
+	tNULL=0, 
+	tAdd, 
+	tMul, 
+	tSub, 
+ 	tDiv, 
+	tAnd, 
+	tOr, 
+	tVar,
+	tFunc,
+	tNum, 
+	tFloat,
+	tlogAnd, 
+	tlogOr, 
+	txor,
+	tMod,
+	tneg,
+	tlparen, 
+	trparen, 
+	tLineDelimit,
+	tVarDelim,	// Only used with Pascal, I think, i.e. var : Integer;
+	tDelimExpr,
+	tAssign,
+	tPtr,
+	tTakeAddress,
+// Comparison operator tokens
+
+	tNot,
+	tEqualto,
+	tGreaterThan,
+	tLessThan,
+	tPlusEqual,
+	tNotEqualto,
+	tLessThanEqual,
+	tGreaterThanEqual,
+	tAddr,
+	tComma,
+	tColon,
+	tClass,
+	tEOF,
+	tBad,
+
+	tInt,
+	tWord,
+	tLong,
+	tChar,
+	tUnsigned,
+	
+// Web-driver tokens
+
+	tVarDecl,
+	tProcedureDecl,
+	tFunctionDecl,
+	tOverload,
+	tThreadDecl,
+	tBegin,
+	tReturn,
+	tIf,
+	tThen,
+	tElse,
+	tFor,
+	tRepeat,
+	tUntil,
+	tTo,
+	tDo,
+	tStep,
+	tStopCompile,
+	tEnd,
+
+	tInclude,		// Differs from Relaxed Pascal to Pascal or C.. i.e. C= #include (not sure what
+					// Pascal Does), RPascal is just "include". 
+
+
+	tBreakCompile,
+	tLiteral,
+	tStopCalc,			// Used to stop the parser cold. 
+
+	tTypeArithOps = 0x1000,
+	tTypeLogicalOps,
+	tTypeValueTokens,
+	tTypeUnaryPrefixOps,
+};
+
 struct stTOKENOPERATORLOOKUP
 { 
 	char * sToken;
@@ -254,90 +338,6 @@ union suTOKENDATA
 //	CTree * cAnyTree;
 };
 
-
-enum TokenType
-{
-	tNULL=0, 
-	tAdd, 
-	tMul, 
-	tSub, 
- 	tDiv, 
-	tAnd, 
-	tOr, 
-	tVar,
-	tFunc,
-	tNum, 
-	tFloat,
-	tlogAnd, 
-	tlogOr, 
-	txor,
-	tMod,
-	tneg,
-	tlparen, 
-	trparen, 
-	tLineDelimit,
-	tVarDelim,	// Only used with Pascal, I think, i.e. var : Integer;
-	tDelimExpr,
-	tAssign,
-	tPtr,
-	tTakeAddress,
-// Comparison operator tokens
-
-	tNot,
-	tEqualto,
-	tGreaterThan,
-	tLessThan,
-	tPlusEqual,
-	tNotEqualto,
-	tLessThanEqual,
-	tGreaterThanEqual,
-	tAddr,
-	tComma,
-	tColon,
-	tClass,
-	tEOF,
-	tBad,
-
-	tInt,
-	tWord,
-	tLong,
-	tChar,
-	tUnsigned,
-	
-// Web-driver tokens
-
-	tVarDecl,
-	tProcedureDecl,
-	tFunctionDecl,
-	tOverload,
-	tThreadDecl,
-	tBegin,
-	tReturn,
-	tIf,
-	tThen,
-	tElse,
-	tFor,
-	tRepeat,
-	tUntil,
-	tTo,
-	tDo,
-	tStep,
-	tStopCompile,
-	tEnd,
-
-	tInclude,		// Differs from Relaxed Pascal to Pascal or C.. i.e. C= #include (not sure what
-					// Pascal Does), RPascal is just "include". 
-
-
-	tBreakCompile,
-	tLiteral,
-	tStopCalc,			// Used to stop the parser cold. 
-
-	tTypeArithOps = 0x1000,
-	tTypeLogicalOps,
-	tTypeValueTokens,
-	tTypeUnaryPrefixOps,
-};
 const struct MultiWordTokens_t stMultiWordTokens[] = 
 {
 	tOr,tlogOr,"IF",
@@ -686,7 +686,7 @@ public:
 	//stNODEDATA * getNodeData() { return stNodeData; } 
 	stNODEDATA *  GetLiteralString();
 	CToken(char * sString,CVars * cMainVar=NULL);
-	int CToken::CheckforEmptyParens(void);
+	int CheckforEmptyParens(void);
 	void Reverse() { bReverse = 1; }
 	void SetVars(CVars * cMainVar) { cVar = cMainVar; }
 	void SetCodeBlock(CCodeBlock * cCodeBlock) { this->cCodeBlock = cCodeBlock; }
@@ -0,0 +1,564 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CTokenArena -- Compile-session allocation and hashed lookup tables for the CToken front end
+//
+// CCompileArena        -- Bump allocator for everything created during one compile (stNODE, stNODEDATA, stVARSTRUCT,
+//                         TokenInsert_t, names, etc.).  Allocation is a pointer increment, and Reset() (or the destructor)
+//                         frees the whole session at once rather than node by node.
+//
+// CIdentifierTable     -- Interned identifiers.  Each distinct name is stored once (in the arena) and Intern() always
+//                         returns the same pointer for it, so names compare by pointer rather than strcmp().  Optionally
+//                         case-insensitive (for the '!' keyword languages), where names are stored upper-case.
+//
+// CSymbolTable<_t>     -- Hash table from an interned name to a symbol (stVARSTRUCT, CFunc, ...), with an optional parent
+//                         scope, i.e. function variables -> global variables.  Replaces linear list walks (FindFunc(), var
+//                         lists) with one hash probe per scope.
+//
+// CTokenLookup         -- Perfect-hash keyword and operator tables, built once from the stTOKENOPERATORLOOKUP tables
+//                         (stTokenAlphaLookup, stTokenOperatorLookup, or an alternate set).  A lookup is one hash and one
+//                         compare, with no collisions.  The hash is case-folded, so a table cannot hold two case-sensitive
+//                         tokens that differ only in case; isValid() is then false and GetErrorMessage() names them.
+//
+// None of these are thread-safe; use one arena and set of tables per compile (the keyword tables are read-only once built
+// and can be shared).
+//
+//      CCompileArena cArena;
+//      CIdentifierTable cNames(cArena);
+//      CSymbolTable<stVARSTRUCT> cGlobals;
+//
+//      stNODE * stNode = cArena.NewZeroed<stNODE>();
+//      const char * sName = cNames.Intern(sToken,iLength);
+//      stVARSTRUCT * stVar = cGlobals.Find(sName);
+//
+//      TokenType eToken = CTokenLookup::GetAlphaTable().Find(sToken,iLength);      // tNULL if not a keyword
+//
+#if !defined(_CTokenArena_H_)
+#define _CTokenArena_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "CToken.h"
+
+namespace Sage
+{
+
+class CCompileArena
+{
+    struct alignas(16) Chunk_t
+    {
+        Chunk_t   * pNext;
+        size_t      szSize;
+    };
+
+    struct Destructor_t
+    {
+        void         (* fnDestroy)(void *);
+        void          * pObject;
+        Destructor_t  * pNext;
+    };
+
+    static constexpr size_t kChunkSize = 64*1024;
+
+    Chunk_t       * m_pChunks       = nullptr;      // Current chunk first
+    Chunk_t       * m_pFree         = nullptr;      // Chunks kept by Reset() for the next session
+    unsigned char * m_pCurrent      = nullptr;
+    unsigned char * m_pEnd          = nullptr;
+    Destructor_t  * m_pDestructors  = nullptr;
+    size_t          m_szAllocated   = 0;            // Bytes handed out since the last Reset()
+    size_t          m_szReserved    = 0;            // Bytes held in chunks
+
+    unsigned char * AllocChunk(size_t szSize,size_t szAlign)
+    {
+        size_t szChunk = szSize + szAlign > kChunkSize ? szSize + szAlign : kChunkSize;
+        Chunk_t * pChunk;
+
+        if (szChunk == kChunkSize && m_pFree)
+        {
+            pChunk  = m_pFree;
+            m_pFree = m_pFree->pNext;
+        }
+        else
+        {
+            if (!(pChunk = (Chunk_t *) malloc(sizeof(Chunk_t) + szChunk))) throw std::bad_alloc();
+            pChunk->szSize  = szChunk;
+            m_szReserved   += szChunk;
+        }
+
+        auto pData = (unsigned char *) (pChunk+1);
+
+        // Large blocks get their own chunk behind the current one, so the rest of the current chunk is still used
+
+        if (szChunk > kChunkSize && m_pChunks)
+        {
+            pChunk->pNext       = m_pChunks->pNext;
+            m_pChunks->pNext    = pChunk;
+            return (unsigned char *) (((size_t) pData + szAlign-1) & ~(szAlign-1));
+        }
+
+        pChunk->pNext   = m_pChunks;
+        m_pChunks       = pChunk;
+        m_pEnd          = pData + szChunk;
+        m_pCurrent      = (unsigned char *) (((size_t) pData + szAlign-1) & ~(szAlign-1));
+
+        unsigned char * p = m_pCurrent;
+        m_pCurrent += szSize;
+        return p;
+    }
+
+    void RunDestructors()
+    {
+        for (auto p = m_pDestructors;p;p = p->pNext) p->fnDestroy(p->pObject);
+        m_pDestructors = nullptr;
+    }
+
+public:
+    CCompileArena() = default;
+    CCompileArena(const CCompileArena &) = delete;
+    CCompileArena & operator = (const CCompileArena &) = delete;
+    ~CCompileArena() { Free(); }
+
+    // Alloc() -- Allocate uninitialized memory.  szAlign must be a power of 2.
+    //
+    void * Alloc(size_t szSize,size_t szAlign = alignof(std::max_align_t))
+    {
+        m_szAllocated += szSize;
+        auto p = (unsigned char *) (((size_t) m_pCurrent + szAlign-1) & ~(szAlign-1));
+        if (m_pCurrent && p + szSize <= m_pEnd)
+        {
+            m_pCurrent = p + szSize;
+            return p;
+        }
+        return AllocChunk(szSize,szAlign);
+    }
+
+    // NewZeroed() -- Allocate a zero-filled C structure (stNODE, stNODEDATA, stVARSTRUCT, TokenInsert_t, etc.)
+    //
+    template <typename _t>
+    _t * NewZeroed(size_t szCount = 1)
+    {
+        static_assert(std::is_trivially_destructible<_t>::value,"NewZeroed() is for plain structures; use New()");
+        void * p = Alloc(sizeof(_t)*szCount,alignof(_t));
+        memset(p,0,sizeof(_t)*szCount);
+        return (_t *) p;
+    }
+
+    // New() -- Construct an object in the arena.  Objects with destructors are destroyed (newest first) by Reset().
+    //
+    template <typename _t,typename... _Args>
+    _t * New(_Args &&... args)
+    {
+        _t * pObject = new (Alloc(sizeof(_t),alignof(_t))) _t(std::forward<_Args>(args)...);
+        if (!std::is_trivially_destructible<_t>::value)
+        {
+            auto pDestructor        = (Destructor_t *) Alloc(sizeof(Destructor_t),alignof(Destructor_t));
+            pDestructor->fnDestroy  = [](void * p) { ((_t *) p)->~_t(); };
+            pDestructor->pObject    = pObject;
+            pDestructor->pNext      = m_pDestructors;
+            m_pDestructors          = pDestructor;
+        }
+        return pObject;
+    }
+
+    // StrDup() -- Copy a string (iLength characters, or to the terminating 0 when iLength < 0) into the arena
+    //
+    char * StrDup(const char * sString,int iLength = -1)
+    {
+        if (!sString) sString = "";
+        size_t szLength = iLength < 0 ? strlen(sString) : (size_t) iLength;
+        auto s = (char *) Alloc(szLength+1,1);
+        memcpy(s,sString,szLength);
+        s[szLength] = 0;
+        return s;
+    }
+
+    // Reset() -- Free everything allocated in the session at once.  Chunks are kept for the next session (except blocks
+    // larger than a chunk), so a repeated compile of the same size does not allocate from the system.
+    //
+    void Reset()
+    {
+        RunDestructors();
+        for (Chunk_t * p = m_pChunks,* pNext;p;p = pNext)
+        {
+            pNext = p->pNext;
+            if (p->szSize != kChunkSize)
+            {
+                m_szReserved -= p->szSize;
+                free(p);
+                continue;
+            }
+            p->pNext    = m_pFree;
+            m_pFree     = p;
+        }
+        m_pChunks       = nullptr;
+        m_pCurrent      = m_pEnd = nullptr;
+        m_szAllocated   = 0;
+    }
+
+    // Free() -- Like Reset(), but also returns the kept chunks to the system
+    //
+    void Free()
+    {
+        Reset();
+        for (Chunk_t * p = m_pFree,* pNext;p;p = pNext)
+        {
+            pNext = p->pNext;
+            free(p);
+        }
+        m_pFree         = nullptr;
+        m_szReserved    = 0;
+    }
+
+    size_t GetBytesAllocated() const { return m_szAllocated; }
+    size_t GetBytesReserved() const { return m_szReserved; }
+};
+
+class CIdentifierTable
+{
+    struct Ident_t
+    {
+        const char    * sName;
+        unsigned int    uiHash;
+        int             iLength;
+    };
+
+    CCompileArena         & m_cArena;
+    std::vector<Ident_t>    m_vTable;           // Open addressing; size is a power of 2
+    int                     m_iCount    = 0;
+    bool                    m_bNoCase   = false;
+
+    static char Upper(char c) { return c >= 'a' && c <= 'z' ? c - 32 : c; }
+
+    unsigned int Hash(const char * s,int iLength) const
+    {
+        unsigned int uiHash = 2166136261u;
+        if (m_bNoCase) for (int i=0;i<iLength;i++) uiHash = (uiHash ^ (unsigned char) Upper(s[i]))*16777619u;
+        else for (int i=0;i<iLength;i++) uiHash = (uiHash ^ (unsigned char) s[i])*16777619u;
+        return uiHash;
+    }
+
+    bool Equal(const Ident_t & stIdent,const char * s,int iLength) const
+    {
+        if (stIdent.iLength != iLength) return false;
+        if (!m_bNoCase) return !memcmp(stIdent.sName,s,iLength);
+        for (int i=0;i<iLength;i++) if (stIdent.sName[i] != Upper(s[i])) return false;
+        return true;
+    }
+
+    void Grow()
+    {
+        std::vector<Ident_t> vOld(m_vTable.size()*2);
+        vOld.swap(m_vTable);
+        size_t szMask = m_vTable.size()-1;
+        for (auto & stIdent : vOld)
+        {
+            if (!stIdent.sName) continue;
+            size_t i = stIdent.uiHash & szMask;
+            while (m_vTable[i].sName) i = (i+1) & szMask;
+            m_vTable[i] = stIdent;
+        }
+    }
+
+public:
+    // bNoCase -- Names are case-insensitive and are stored (and returned) upper-case
+    //
+    CIdentifierTable(CCompileArena & cArena,bool bNoCase = false) : m_cArena(cArena), m_vTable(256), m_bNoCase(bNoCase) { }
+
+    // Intern() -- The single stored copy of a name (iLength < 0 uses strlen()).  The same name always returns the same
+    // pointer, valid until the arena is Reset().
+    //
+    const char * Intern(const char * sName,int iLength = -1)
+    {
+        if (!sName) return nullptr;
+        if (iLength < 0) iLength = (int) strlen(sName);
+
+        unsigned int uiHash = Hash(sName,iLength);
+        size_t szMask = m_vTable.size()-1;
+        size_t i = uiHash & szMask;
+        for (;m_vTable[i].sName;i = (i+1) & szMask)
+            if (m_vTable[i].uiHash == uiHash && Equal(m_vTable[i],sName,iLength)) return m_vTable[i].sName;
+
+        char * s = m_cArena.StrDup(sName,iLength);
+        if (m_bNoCase) for (int j=0;j<iLength;j++) s[j] = Upper(s[j]);
+
+        m_vTable[i] = { s,uiHash,iLength };
+        if (++m_iCount*2 > (int) m_vTable.size()) Grow();
+        return s;
+    }
+
+    // Find() -- The interned copy of a name, or nullptr if it has not been interned
+    //
+    const char * Find(const char * sName,int iLength = -1) const
+    {
+        if (!sName) return nullptr;
+        if (iLength < 0) iLength = (int) strlen(sName);
+
+        unsigned int uiHash = Hash(sName,iLength);
+        size_t szMask = m_vTable.size()-1;
+        for (size_t i = uiHash & szMask;m_vTable[i].sName;i = (i+1) & szMask)
+            if (m_vTable[i].uiHash == uiHash && Equal(m_vTable[i],sName,iLength)) return m_vTable[i].sName;
+        return nullptr;
+    }
+
+    int GetCount() const { return m_iCount; }
+
+    // Clear() -- Forget all names (call when the arena is Reset())
+    //
+    void Clear()
+    {
+        m_vTable.assign(256,Ident_t{});
+        m_iCount = 0;
+    }
+};
+
+template <typename _t>
+class CSymbolTable
+{
+    struct Entry_t
+    {
+        const char  * sName;
+        _t          * pSymbol;
+    };
+
+    std::vector<Entry_t>    m_vTable;
+    int                     m_iCount    = 0;
+    const CSymbolTable    * m_pParent   = nullptr;
+
+    static size_t Hash(const char * sName)
+    {
+        unsigned long long ull = (unsigned long long) (size_t) sName * 0x9E3779B97F4A7C15ULL;
+        return (size_t) (ull >> 32);
+    }
+
+    void Grow()
+    {
+        std::vector<Entry_t> vOld(m_vTable.size()*2);
+        vOld.swap(m_vTable);
+        size_t szMask = m_vTable.size()-1;
+        for (auto & stEntry : vOld)
+        {
+            if (!stEntry.sName) continue;
+            size_t i = Hash(stEntry.sName) & szMask;
+            while (m_vTable[i].sName) i = (i+1) & szMask;
+            m_vTable[i] = stEntry;
+        }
+    }
+
+public:
+    // pParent -- Scope searched when a name is not found here (i.e. the global variables for a function's variables)
+    //
+    CSymbolTable(const CSymbolTable * pParent = nullptr) : m_vTable(64), m_pParent(pParent) { }
+
+    // Add() -- Add a symbol under an interned name (from CIdentifierTable::Intern()).  Returns false if the name is already
+    // in this scope.
+    //
+    bool Add(const char * sInternedName,_t * pSymbol)
+    {
+        if (!sInternedName) return false;
+        size_t szMask = m_vTable.size()-1;
+        size_t i = Hash(sInternedName) & szMask;
+        for (;m_vTable[i].sName;i = (i+1) & szMask) if (m_vTable[i].sName == sInternedName) return false;
+
+        m_vTable[i] = { sInternedName,pSymbol };
+        if (++m_iCount*2 > (int) m_vTable.size()) Grow();
+        return true;
+    }
+
+    // Find() -- The symbol for an interned name, searching parent scopes; nullptr if not found
+    //
+    _t * Find(const char * sInternedName) const
+    {
+        for (auto pScope = this;pScope;pScope = pScope->m_pParent)
+        {
+            size_t szMask = pScope->m_vTable.size()-1;
+            for (size_t i = Hash(sInternedName) & szMask;pScope->m_vTable[i].sName;i = (i+1) & szMask)
+                if (pScope->m_vTable[i].sName == sInternedName) return pScope->m_vTable[i].pSymbol;
+        }
+        return nullptr;
+    }
+
+    // FindLocal() -- Like Find(), but only in this scope (i.e. to check for a redeclaration)
+    //
+    _t * FindLocal(const char * sInternedName) const
+    {
+        size_t szMask = m_vTable.size()-1;
+        for (size_t i = Hash(sInternedName) & szMask;m_vTable[i].sName;i = (i+1) & szMask)
+            if (m_vTable[i].sName == sInternedName) return m_vTable[i].pSymbol;
+        return nullptr;
+    }
+
+    int GetCount() const { return m_iCount; }
+    void SetParent(const CSymbolTable * pParent) { m_pParent = pParent; }
+
+    void Clear()
+    {
+        m_vTable.assign(64,Entry_t{});
+        m_iCount = 0;
+    }
+};
+
+class CTokenLookup
+{
+    struct Entry_t
+    {
+        const char    * sToken;
+        int             iLength;
+        TokenType       eToken;
+        bool            bNoCase;
+    };
+
+    std::vector<Entry_t>    m_vEntries;
+    std::vector<short>      m_vSlots;           // Entry index per slot, -1 = empty
+    unsigned int            m_uiSeed    = 0;
+    unsigned int            m_uiMask    = 0;
+    int                     m_iMaxLength = 0;
+    std::string             m_sError;
+
+    static char Upper(char c) { return c >= 'a' && c <= 'z' ? c - 32 : c; }
+
+    // Hash() -- Always case-folded, so case-insensitive and case-sensitive entries can share the table
+
+    static unsigned int Hash(const char * s,int iLength,unsigned int uiSeed)
+    {
+        unsigned int uiHash = 2166136261u ^ uiSeed;
+        for (int i=0;i<iLength;i++) uiHash = (uiHash ^ (unsigned char) Upper(s[i]))*16777619u;
+        return uiHash ^ (uiHash >> 15);
+    }
+
+    static bool Equal(const Entry_t & stEntry,const char * s,int iLength)
+    {
+        if (stEntry.iLength != iLength) return false;
+        if (!stEntry.bNoCase) return !memcmp(stEntry.sToken,s,iLength);
+        for (int i=0;i<iLength;i++) if (Upper(stEntry.sToken[i]) != Upper(s[i])) return false;
+        return true;
+    }
+
+    // Build() -- Find a seed that puts every entry in its own slot.  Entries that fold to the same text (case-sensitive
+    // tokens that differ only in case) always hash to the same slot, so they are reported rather than searched for.
+
+    bool Build()
+    {
+        m_vSlots.clear();
+        for (size_t i=0;i<m_vEntries.size();i++)
+            for (size_t j=0;j<i;j++)
+            {
+                auto & stEntry = m_vEntries[i];
+                auto & stOther = m_vEntries[j];
+                if (!Equal({ stOther.sToken,stOther.iLength,stOther.eToken,true },stEntry.sToken,stEntry.iLength)) continue;
+
+                m_sError = "Tokens '" + std::string(stOther.sToken,stOther.iLength) + "' and '" + std::string(stEntry.sToken,stEntry.iLength) +
+                           "' differ only in case (the table is case-folded)";
+                return false;
+            }
+
+        for (unsigned int uiSize = 16;uiSize <= 32768;uiSize *= 2)
+        {
+            if (uiSize < m_vEntries.size()*2) continue;
+            m_vSlots.resize(uiSize);
+            m_uiMask = uiSize-1;
+
+            for (m_uiSeed = 1;m_uiSeed < 4096;m_uiSeed++)
+            {
+                std::fill(m_vSlots.begin(),m_vSlots.end(),(short) -1);
+                bool bCollision = false;
+                for (size_t i=0;i<m_vEntries.size() && !bCollision;i++)
+                {
+                    auto & stEntry = m_vEntries[i];
+                    short & sSlot = m_vSlots[Hash(stEntry.sToken,stEntry.iLength,m_uiSeed) & m_uiMask];
+                    if (sSlot >= 0) bCollision = true;
+                    else sSlot = (short) i;
+                }
+                if (!bCollision) return true;
+            }
+        }
+        m_vSlots.clear();
+        m_sError = "No perfect hash found for " + std::to_string(m_vEntries.size()) + " tokens";
+        return false;
+    }
+
+public:
+    // CTokenLookup() -- Build from a token table.  iCount < 0 reads up to the entry with a NULL sToken.  With
+    // bCaseCode, the first character of each token is its case code ('!' = not case-sensitive, '*' = case-sensitive), as
+    // in stTokenAlphaLookup.  When a token appears more than once, the first entry is used (as with a linear search).
+    //
+    CTokenLookup(const stTOKENOPERATORLOOKUP * stTable,int iCount = -1,bool bCaseCode = false)
+    {
+        for (int i=0;stTable && (iCount < 0 || i < iCount) && stTable[i].sToken;i++)
+        {
+            Entry_t stEntry = { stTable[i].sToken,0,stTable[i].eToken,false };
+            if (bCaseCode && (*stEntry.sToken == '!' || *stEntry.sToken == '*'))
+            {
+                stEntry.bNoCase = *stEntry.sToken == '!';
+                stEntry.sToken++;
+            }
+            stEntry.iLength = (int) strlen(stEntry.sToken);
+            if (!stEntry.iLength) continue;
+
+            bool bDuplicate = false;
+            for (auto & stOther : m_vEntries) if (Equal(stOther,stEntry.sToken,stEntry.iLength) || Equal(stEntry,stOther.sToken,stOther.iLength)) bDuplicate = true;
+            if (bDuplicate) continue;
+
+            if (stEntry.iLength > m_iMaxLength) m_iMaxLength = stEntry.iLength;
+            m_vEntries.push_back(stEntry);
+        }
+        Build();
+    }
+
+    bool isValid() const { return !m_vSlots.empty(); }
+
+    // GetErrorMessage() -- Why the table could not be built (empty if isValid())
+    //
+    const char * GetErrorMessage() const { return m_sError.c_str(); }
+    int GetNumEntries() const { return (int) m_vEntries.size(); }
+    int GetTableSize() const { return (int) m_vSlots.size(); }
+    int GetMaxLength() const { return m_iMaxLength; }
+
+    // Find() -- The token for a whole word/operator, or tNULL if it is not in the table
+    //
+    TokenType Find(const char * sToken,int iLength) const
+    {
+        if (iLength <= 0 || iLength > m_iMaxLength || m_vSlots.empty()) return tNULL;
+        short sSlot = m_vSlots[Hash(sToken,iLength,m_uiSeed) & m_uiMask];
+        return sSlot >= 0 && Equal(m_vEntries[sSlot],sToken,iLength) ? m_vEntries[sSlot].eToken : tNULL;
+    }
+
+    // Match() -- The longest token at the start of a 0-terminated string (i.e. "<=" before "<").  iLength receives its
+    // length; returns tNULL (iLength = 0) if none match.
+    //
+    TokenType Match(const char * sText,int & iLength) const
+    {
+        int iAvailable = 0;
+        while (iAvailable < m_iMaxLength && sText[iAvailable]) iAvailable++;
+
+        for (iLength = iAvailable;iLength > 0;iLength--)
+        {
+            TokenType eToken = Find(sText,iLength);
+            if (eToken != tNULL) return eToken;
+        }
+        return tNULL;
+    }
+
+    // GetAlphaTable(), GetOperatorTable() -- Tables for the default CToken keywords and operators (built on first use)
+    //
+    static const CTokenLookup & GetAlphaTable()
+    {
+        static const CTokenLookup cTable(stTokenAlphaLookup,-1,true);
+        return cTable;
+    }
+
+    static const CTokenLookup & GetOperatorTable()
+    {
+        static const CTokenLookup cTable(stTokenOperatorLookup,(int) (sizeof(stTokenOperatorLookup)/sizeof(stTokenOperatorLookup[0])));
+        return cTable;
+    }
+};
+
+}; // namespace Sage
+#endif // _CTokenArena_H_
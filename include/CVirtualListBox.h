@@ -0,0 +1,669 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CVirtualListBox, CVirtualComboBox -- Owner-data list and combo boxes for very large lists
+//
+// CListBox and CComboBox add each item to the native control, which is slow and memory-hungry past a few thousand
+// items.  These controls keep no per-item state in the window: the items come from a CVirtualListModel (a column store
+// or an application callback, see CVirtualListModel.h), and painting asks the model only for the rows that are visible.
+// Adding 500,000 rows is an append to the column store, and scrolling anywhere costs the same as scrolling the top.
+//
+//      - 32-bit scroll positions (SIF_TRACKPOS), so the thumb works past 65,535 rows
+//      - Type-ahead: typing selects the next row that begins with the typed text, through the model's sorted index
+//      - AppendItems() and BeginUpdate()/EndUpdate() suspend redraws (as CListBox::EnableInvalidate() does) so a batch
+//        of rows is drawn once
+//      - GetStats() gives the time of the last append, paint (scroll) and search
+//
+// Basic usage:
+//
+//      CVirtualListBox cList;
+//      cList.Create(cWin,10,50,600,400);
+//      cList.AppendItems(sLines,iNumLines);
+//      cList.SetSelectHandler([&](int iRow) { ... });
+//
+//      cList.GetModel().SetCallback(iNumRecords,[&](int iRow,std::string & s) { return FormatRecord(iRow,s); });
+//      cList.Refresh();
+//
+// CVirtualComboBox shows the selected row and drops down a CVirtualListBox (sharing its model) when clicked.
+//
+#if !defined(_CVirtualListBox_H_)
+#define _CVirtualListBox_H_
+
+#include <Windows.h>
+#include <chrono>
+#include <functional>
+#include <string>
+#include "CSageBox.h"
+#include "CVirtualListModel.h"
+#include "SageProfile.h"
+
+namespace Sage
+{
+
+class CVirtualListBox
+{
+public:
+    struct Stats_t
+    {
+        double fAppendMs;           // Last AppendItems()
+        double fPaintMs;            // Last paint (i.e. after a scroll)
+        double fSearchMs;           // Last type-ahead or Find search
+        int    iRowsPainted;        // Rows drawn by the last paint
+    };
+
+private:
+    static constexpr const char * kClassName    = "SageVirtualListBox";
+    static constexpr int kTypeAheadMs           = 1000;         // Typed characters reset after this pause
+
+    HWND                    m_hWnd              = nullptr;
+    HFONT                   m_hFont             = nullptr;
+    CVirtualListModel       m_cOwnModel;
+    CVirtualListModel     * m_cModel            = &m_cOwnModel;
+
+    int                     m_iRowHeight        = 16;
+    int                     m_iTop              = 0;
+    int                     m_iSelection        = -1;
+    int                     m_iWheelDelta       = 0;
+    int                     m_iUpdateDepth      = 0;            // BeginUpdate() nesting
+    bool                    m_bUpdatePending    = false;
+
+    COLORREF                m_rgbText           = RGB(0,0,0);
+    COLORREF                m_rgbBackground     = RGB(255,255,255);
+    COLORREF                m_rgbSelText        = RGB(255,255,255);
+    COLORREF                m_rgbSelBackground  = RGB(0,120,215);
+
+    std::string             m_sTypeAhead;
+    DWORD                   m_dwLastChar        = 0;
+    Stats_t                 m_stStats{};
+
+    std::function<void(int)> m_fnSelect;
+    std::function<void(int)> m_fnDoubleClick;
+    std::function<void()>    m_fnKillFocus;
+
+    static double ElapsedMs(std::chrono::steady_clock::time_point tStart)
+    {
+        return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now()-tStart).count();
+    }
+
+    static bool RegisterClass()
+    {
+        static const bool bRegistered = []
+        {
+            WNDCLASSEXA stClass{};
+            stClass.cbSize          = sizeof(stClass);
+            stClass.style           = CS_DBLCLKS;
+            stClass.lpfnWndProc     = WindowProc;
+            stClass.hInstance       = GetModuleHandleA(nullptr);
+            stClass.hCursor         = LoadCursor(nullptr,IDC_ARROW);
+            stClass.lpszClassName   = kClassName;
+            return RegisterClassExA(&stClass) != 0 || GetLastError() == ERROR_CLASS_ALREADY_EXISTS;
+        }();
+        return bRegistered;
+    }
+
+    static LRESULT CALLBACK WindowProc(HWND hWnd,UINT uMsg,WPARAM wParam,LPARAM lParam)
+    {
+        if (uMsg == WM_NCCREATE)
+            SetWindowLongPtrA(hWnd,GWLP_USERDATA,(LONG_PTR) ((CREATESTRUCTA *) lParam)->lpCreateParams);
+
+        auto cList = (CVirtualListBox *) GetWindowLongPtrA(hWnd,GWLP_USERDATA);
+        if (!cList) return DefWindowProcA(hWnd,uMsg,wParam,lParam);
+        if (uMsg == WM_NCDESTROY)
+        {
+            SetWindowLongPtrA(hWnd,GWLP_USERDATA,0);
+            cList->m_hWnd = nullptr;
+            return DefWindowProcA(hWnd,uMsg,wParam,lParam);
+        }
+        return cList->HandleMessage(uMsg,wParam,lParam);
+    }
+
+    int GetVisibleRows() const
+    {
+        RECT rClient{};
+        if (m_hWnd) GetClientRect(m_hWnd,&rClient);
+        int iRows = (rClient.bottom - rClient.top)/m_iRowHeight;
+        return iRows < 1 ? 1 : iRows;
+    }
+
+    void UpdateRowHeight()
+    {
+        HDC hDC = GetDC(m_hWnd);
+        HGDIOBJ hOld = m_hFont ? SelectObject(hDC,m_hFont) : nullptr;
+        TEXTMETRICA stMetrics{};
+        GetTextMetricsA(hDC,&stMetrics);
+        if (hOld) SelectObject(hDC,hOld);
+        ReleaseDC(m_hWnd,hDC);
+        m_iRowHeight = stMetrics.tmHeight + 2 > 4 ? stMetrics.tmHeight + 2 : 16;
+    }
+
+    void ClampTop()
+    {
+        int iMaxTop = m_cModel->GetCount() - GetVisibleRows();
+        if (m_iTop > iMaxTop) m_iTop = iMaxTop;
+        if (m_iTop < 0) m_iTop = 0;
+    }
+
+    void UpdateScrollBar()
+    {
+        SCROLLINFO stInfo{};
+        stInfo.cbSize   = sizeof(stInfo);
+        stInfo.fMask    = SIF_RANGE | SIF_PAGE | SIF_POS | SIF_DISABLENOSCROLL;
+        stInfo.nMin     = 0;
+        stInfo.nMax     = m_cModel->GetCount() > 0 ? m_cModel->GetCount()-1 : 0;
+        stInfo.nPage    = GetVisibleRows();
+        stInfo.nPos     = m_iTop;
+        SetScrollInfo(m_hWnd,SB_VERT,&stInfo,TRUE);
+    }
+
+    void Paint()
+    {
+        SageProfileZone("CVirtualListBox::Paint");
+        auto tStart = std::chrono::steady_clock::now();
+
+        PAINTSTRUCT stPaint;
+        HDC hDC = BeginPaint(m_hWnd,&stPaint);
+        RECT rClient;
+        GetClientRect(m_hWnd,&rClient);
+
+        // Draw to a memory bitmap and copy it once, so scrolling does not flicker
+
+        HDC hMemDC      = CreateCompatibleDC(hDC);
+        HBITMAP hBitmap = CreateCompatibleBitmap(hDC,rClient.right > 0 ? rClient.right : 1,rClient.bottom > 0 ? rClient.bottom : 1);
+        HGDIOBJ hOldBitmap  = SelectObject(hMemDC,hBitmap);
+        HGDIOBJ hOldFont    = m_hFont ? SelectObject(hMemDC,m_hFont) : nullptr;
+
+        SetBkColor(hMemDC,m_rgbBackground);
+        ExtTextOutA(hMemDC,0,0,ETO_OPAQUE,&rClient,nullptr,0,nullptr);
+
+        std::string sScratch;
+        int iCount  = m_cModel->GetCount();
+        int iRows   = 0;
+        bool bFocus = GetFocus() == m_hWnd;
+
+        for (int iRow = m_iTop,iY = 0;iRow < iCount && iY < rClient.bottom;iRow++,iY += m_iRowHeight,iRows++)
+        {
+            const char * sText = m_cModel->GetItem(iRow,sScratch);
+            bool bSelected = iRow == m_iSelection;
+            RECT rRow = { 0,iY,rClient.right,iY + m_iRowHeight };
+
+            SetTextColor(hMemDC,bSelected ? m_rgbSelText : m_rgbText);
+            SetBkColor(hMemDC,bSelected ? m_rgbSelBackground : m_rgbBackground);
+            ExtTextOutA(hMemDC,4,iY+1,ETO_OPAQUE | ETO_CLIPPED,&rRow,sText,(UINT) strlen(sText),nullptr);
+            if (bSelected && bFocus) DrawFocusRect(hMemDC,&rRow);
+        }
+
+        BitBlt(hDC,0,0,rClient.right,rClient.bottom,hMemDC,0,0,SRCCOPY);
+
+        if (hOldFont) SelectObject(hMemDC,hOldFont);
+        SelectObject(hMemDC,hOldBitmap);
+        DeleteObject(hBitmap);
+        DeleteDC(hMemDC);
+        EndPaint(m_hWnd,&stPaint);
+
+        m_stStats.fPaintMs      = ElapsedMs(tStart);
+        m_stStats.iRowsPainted  = iRows;
+    }
+
+    void Redraw()
+    {
+        if (!m_hWnd) return;
+        if (m_iUpdateDepth) { m_bUpdatePending = true; return; }
+        ClampTop();
+        UpdateScrollBar();
+        InvalidateRect(m_hWnd,nullptr,FALSE);
+    }
+
+    void Select(int iRow,bool bNotify)
+    {
+        int iCount = m_cModel->GetCount();
+        if (iRow >= iCount) iRow = iCount-1;
+        if (iRow < 0) iRow = iCount ? 0 : -1;
+
+        m_iSelection = iRow;
+        EnsureVisible(iRow);
+        Redraw();
+        if (bNotify && m_fnSelect && iRow >= 0) m_fnSelect(iRow);
+    }
+
+    void OnScroll(int iCode)
+    {
+        int iPage = GetVisibleRows();
+        switch (iCode)
+        {
+            case SB_LINEUP:         m_iTop--;               break;
+            case SB_LINEDOWN:       m_iTop++;               break;
+            case SB_PAGEUP:         m_iTop -= iPage;        break;
+            case SB_PAGEDOWN:       m_iTop += iPage;        break;
+            case SB_TOP:            m_iTop = 0;             break;
+            case SB_BOTTOM:         m_iTop = m_cModel->GetCount(); break;
+            case SB_THUMBTRACK:
+            case SB_THUMBPOSITION:
+            {
+                SCROLLINFO stInfo{};
+                stInfo.cbSize   = sizeof(stInfo);
+                stInfo.fMask    = SIF_TRACKPOS;             // 32-bit position (the WM_VSCROLL position is only 16 bits)
+                GetScrollInfo(m_hWnd,SB_VERT,&stInfo);
+                m_iTop = stInfo.nTrackPos;
+                break;
+            }
+            default: return;
+        }
+        Redraw();
+    }
+
+    void OnKey(WPARAM wKey)
+    {
+        int iPage = GetVisibleRows();
+        switch (wKey)
+        {
+            case VK_UP:     Select(m_iSelection-1,true);            break;
+            case VK_DOWN:   Select(m_iSelection+1,true);            break;
+            case VK_PRIOR:  Select(m_iSelection-iPage,true);        break;
+            case VK_NEXT:   Select(m_iSelection+iPage,true);        break;
+            case VK_HOME:   Select(0,true);                         break;
+            case VK_END:    Select(m_cModel->GetCount()-1,true);    break;
+            case VK_RETURN: if (m_fnDoubleClick && m_iSelection >= 0) m_fnDoubleClick(m_iSelection); break;
+            default: break;
+        }
+    }
+
+    // OnChar() -- Type-ahead.  A single repeated character cycles through the rows that start with it.
+
+    void OnChar(char cChar)
+    {
+        if ((unsigned char) cChar < ' ') return;
+
+        DWORD dwNow = GetTickCount();
+        if (dwNow - m_dwLastChar > kTypeAheadMs) m_sTypeAhead.clear();
+        m_dwLastChar = dwNow;
+
+        bool bRepeat = m_sTypeAhead.size() == 1 && m_sTypeAhead[0] == cChar;
+        if (!bRepeat) m_sTypeAhead += cChar;
+
+        int iRow = FindPrefix(m_sTypeAhead.c_str(),bRepeat || m_sTypeAhead.size() == 1 ? m_iSelection+1 : m_iSelection);
+        if (iRow >= 0) Select(iRow,true);
+    }
+
+    LRESULT HandleMessage(UINT uMsg,WPARAM wParam,LPARAM lParam)
+    {
+        switch (uMsg)
+        {
+            case WM_PAINT:          Paint();                                        return 0;
+            case WM_ERASEBKGND:                                                     return 1;
+            case WM_SIZE:           Redraw();                                       return 0;
+            case WM_VSCROLL:        OnScroll(LOWORD(wParam));                       return 0;
+            case WM_KEYDOWN:        OnKey(wParam);                                  return 0;
+            case WM_CHAR:           OnChar((char) wParam);                          return 0;
+            case WM_GETDLGCODE:                                                     return DLGC_WANTARROWS | DLGC_WANTCHARS;
+            case WM_SETFOCUS:       InvalidateRect(m_hWnd,nullptr,FALSE);           return 0;
+            case WM_KILLFOCUS:
+                InvalidateRect(m_hWnd,nullptr,FALSE);
+                if (m_fnKillFocus) m_fnKillFocus();
+                return 0;
+
+            case WM_MOUSEWHEEL:
+            {
+                UINT uiLines = 3;
+                SystemParametersInfoA(SPI_GETWHEELSCROLLLINES,0,&uiLines,0);
+                m_iWheelDelta += GET_WHEEL_DELTA_WPARAM(wParam);
+                int iSteps = m_iWheelDelta/WHEEL_DELTA;
+                m_iWheelDelta -= iSteps*WHEEL_DELTA;
+                m_iTop -= iSteps*(int) uiLines;
+                Redraw();
+                return 0;
+            }
+
+            case WM_LBUTTONDOWN:
+            case WM_LBUTTONDBLCLK:
+            {
+                SetFocus(m_hWnd);
+                int iRow = m_iTop + (short) HIWORD(lParam)/m_iRowHeight;
+                if (iRow >= m_cModel->GetCount()) return 0;
+                Select(iRow,uMsg == WM_LBUTTONDOWN);
+                if (uMsg == WM_LBUTTONDBLCLK && m_fnDoubleClick) m_fnDoubleClick(iRow);
+                return 0;
+            }
+
+            default:
+                return DefWindowProcA(m_hWnd,uMsg,wParam,lParam);
+        }
+    }
+
+public:
+    CVirtualListBox() = default;
+    CVirtualListBox(const CVirtualListBox &) = delete;
+    CVirtualListBox & operator = (const CVirtualListBox &) = delete;
+    ~CVirtualListBox() { Destroy(); }
+
+    // Create() -- Create the list box as a child of hParent.  With bPopup, it is created as a borderless popup window owned
+    // by hParent, at screen coordinates (used by CVirtualComboBox for its drop-down list).
+    //
+    bool Create(HWND hParent,int iX,int iY,int iWidth,int iHeight,bool bPopup = false)
+    {
+        if (m_hWnd || !RegisterClass()) return false;
+
+        DWORD dwStyle = WS_VSCROLL | WS_CLIPCHILDREN | (bPopup ? WS_POPUP | WS_BORDER : WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER);
+        m_hWnd = CreateWindowExA(bPopup ? WS_EX_TOOLWINDOW | WS_EX_TOPMOST : 0,kClassName,"",dwStyle,iX,iY,iWidth,iHeight,hParent,nullptr,
+                                 GetModuleHandleA(nullptr),this);
+        if (!m_hWnd) return false;
+
+        if (!m_hFont) m_hFont = (HFONT) GetStockObject(DEFAULT_GUI_FONT);
+        UpdateRowHeight();
+        Redraw();
+        return true;
+    }
+
+    bool Create(CWindow & cWin,int iX,int iY,int iWidth,int iHeight) { return Create(cWin.GetWindowHandle(),iX,iY,iWidth,iHeight); }
+
+    void Destroy()
+    {
+        if (m_hWnd) DestroyWindow(m_hWnd);
+        m_hWnd = nullptr;
+    }
+
+    bool isValid() const { return m_hWnd != nullptr; }
+    HWND GetWindowHandle() const { return m_hWnd; }
+
+    // GetModel() -- The rows.  After changing the model directly, call Refresh().
+    //
+    CVirtualListModel & GetModel() { return *m_cModel; }
+
+    // SetModel() -- Show another model (i.e. one shared with other lists).  nullptr returns to this list's own model.
+    //
+    void SetModel(CVirtualListModel * cModel)
+    {
+        m_cModel = cModel ? cModel : &m_cOwnModel;
+        m_iSelection = -1;
+        m_iTop = 0;
+        Redraw();
+    }
+
+    // Refresh() -- Update the scroll bar and redraw after the model has changed
+    //
+    void Refresh() { Redraw(); }
+
+    // AppendItem(), AppendItems() -- Add rows to the column store and redraw once.  Returns the first new row.
+    //
+    int AppendItem(const char * sItem) { return AppendItems(&sItem,1); }
+
+    int AppendItems(const char * const * sItems,int iCount)
+    {
+        auto tStart = std::chrono::steady_clock::now();
+        BeginUpdate();
+        int iFirst = m_cModel->AppendItems(sItems,iCount);
+        EndUpdate();
+        m_stStats.fAppendMs = ElapsedMs(tStart);
+        return iFirst;
+    }
+
+    // BeginUpdate(), EndUpdate() -- Suspend redraws while the model is changed (nestable).  EndUpdate() redraws once.
+    //
+    void BeginUpdate() { m_iUpdateDepth++; }
+    void EndUpdate()
+    {
+        if (m_iUpdateDepth > 0 && !--m_iUpdateDepth && m_bUpdatePending)
+        {
+            m_bUpdatePending = false;
+            Redraw();
+        }
+        else if (!m_iUpdateDepth) Redraw();
+    }
+
+    // EnableInvalidate() -- Same as CListBox::EnableInvalidate(): false suspends redraws; true (with bRefresh) redraws
+    //
+    void EnableInvalidate(bool bEnable,bool bRefresh = false)
+    {
+        if (!bEnable) { BeginUpdate(); return; }
+        if (m_iUpdateDepth) EndUpdate();
+        if (bRefresh) Redraw();
+    }
+
+    void Clear()
+    {
+        m_cModel->Clear();
+        m_iSelection = -1;
+        m_iTop = 0;
+        Redraw();
+    }
+
+    int GetCount() const { return m_cModel->GetCount(); }
+    int GetSelection() const { return m_iSelection; }
+    int GetTopRow() const { return m_iTop; }
+    int GetRowHeight() const { return m_iRowHeight; }
+
+    // SetSelection() -- Select a row (-1 for none) and scroll it into view.  The select handler is not called.
+    //
+    void SetSelection(int iRow)
+    {
+        if (iRow < 0) { m_iSelection = -1; Redraw(); return; }
+        Select(iRow,false);
+    }
+
+    void SetTopRow(int iRow)
+    {
+        m_iTop = iRow;
+        Redraw();
+    }
+
+    void EnsureVisible(int iRow)
+    {
+        int iVisible = GetVisibleRows();
+        if (iRow < m_iTop) m_iTop = iRow;
+        else if (iRow >= m_iTop + iVisible) m_iTop = iRow - iVisible + 1;
+        ClampTop();
+    }
+
+    // FindPrefix(), FindText() -- Search the model (see CVirtualListModel), timing the search for GetStats()
+    //
+    int FindPrefix(const char * sPrefix,int iStart = 0)
+    {
+        auto tStart = std::chrono::steady_clock::now();
+        int iRow = m_cModel->FindPrefix(sPrefix,iStart);
+        m_stStats.fSearchMs = ElapsedMs(tStart);
+        return iRow;
+    }
+
+    int FindText(const char * sText,int iStart = 0)
+    {
+        auto tStart = std::chrono::steady_clock::now();
+        int iRow = m_cModel->FindText(sText,iStart);
+        m_stStats.fSearchMs = ElapsedMs(tStart);
+        return iRow;
+    }
+
+    // SetFont() -- The font is not owned (it must outlive the list box)
+    //
+    void SetFont(HFONT hFont)
+    {
+        m_hFont = hFont ? hFont : (HFONT) GetStockObject(DEFAULT_GUI_FONT);
+        if (m_hWnd) UpdateRowHeight();
+        Redraw();
+    }
+
+    void SetColors(COLORREF rgbText,COLORREF rgbBackground,COLORREF rgbSelText,COLORREF rgbSelBackground)
+    {
+        m_rgbText           = rgbText;
+        m_rgbBackground     = rgbBackground;
+        m_rgbSelText        = rgbSelText;
+        m_rgbSelBackground  = rgbSelBackground;
+        Redraw();
+    }
+
+    void SetSelectHandler(std::function<void(int)> fnSelect) { m_fnSelect = std::move(fnSelect); }
+    void SetDoubleClickHandler(std::function<void(int)> fnDoubleClick) { m_fnDoubleClick = std::move(fnDoubleClick); }
+    void SetKillFocusHandler(std::function<void()> fnKillFocus) { m_fnKillFocus = std::move(fnKillFocus); }
+
+    const Stats_t & GetStats() const { return m_stStats; }
+};
+
+class CVirtualComboBox
+{
+    static constexpr const char * kClassName    = "SageVirtualComboBox";
+    static constexpr int kDropRows              = 12;
+
+    HWND                    m_hWnd          = nullptr;
+    CVirtualListBox         m_cDropList;            // Popup list; its model holds the rows
+    std::function<void(int)> m_fnSelect;
+    int                     m_iSelection    = -1;
+
+    static bool RegisterClass()
+    {
+        static const bool bRegistered = []
+        {
+            WNDCLASSEXA stClass{};
+            stClass.cbSize          = sizeof(stClass);
+            stClass.lpfnWndProc     = WindowProc;
+            stClass.hInstance       = GetModuleHandleA(nullptr);
+            stClass.hCursor         = LoadCursor(nullptr,IDC_ARROW);
+            stClass.lpszClassName   = kClassName;
+            return RegisterClassExA(&stClass) != 0 || GetLastError() == ERROR_CLASS_ALREADY_EXISTS;
+        }();
+        return bRegistered;
+    }
+
+    static LRESULT CALLBACK WindowProc(HWND hWnd,UINT uMsg,WPARAM wParam,LPARAM lParam)
+    {
+        if (uMsg == WM_NCCREATE)
+            SetWindowLongPtrA(hWnd,GWLP_USERDATA,(LONG_PTR) ((CREATESTRUCTA *) lParam)->lpCreateParams);
+
+        auto cCombo = (CVirtualComboBox *) GetWindowLongPtrA(hWnd,GWLP_USERDATA);
+        if (!cCombo) return DefWindowProcA(hWnd,uMsg,wParam,lParam);
+        if (uMsg == WM_NCDESTROY)
+        {
+            SetWindowLongPtrA(hWnd,GWLP_USERDATA,0);
+            cCombo->m_hWnd = nullptr;
+            return DefWindowProcA(hWnd,uMsg,wParam,lParam);
+        }
+        return cCombo->HandleMessage(uMsg,wParam,lParam);
+    }
+
+    void Paint()
+    {
+        SageProfileZone("CVirtualComboBox::Paint");
+        PAINTSTRUCT stPaint;
+        HDC hDC = BeginPaint(m_hWnd,&stPaint);
+        RECT rClient;
+        GetClientRect(m_hWnd,&rClient);
+
+        RECT rText = rClient;
+        rText.right -= GetSystemMetrics(SM_CXVSCROLL);
+        std::string sScratch;
+        const char * sText = m_iSelection >= 0 ? GetModel().GetItem(m_iSelection,sScratch) : "";
+
+        HGDIOBJ hOldFont = SelectObject(hDC,GetStockObject(DEFAULT_GUI_FONT));
+        SetBkColor(hDC,GetSysColor(COLOR_WINDOW));
+        SetTextColor(hDC,GetSysColor(COLOR_WINDOWTEXT));
+        ExtTextOutA(hDC,4,(rClient.bottom-GetDropList().GetRowHeight())/2+1,ETO_OPAQUE | ETO_CLIPPED,&rText,sText,(UINT) strlen(sText),nullptr);
+        SelectObject(hDC,hOldFont);
+
+        RECT rButton = { rText.right,0,rClient.right,rClient.bottom };
+        DrawFrameControl(hDC,&rButton,DFC_SCROLL,DFCS_SCROLLCOMBOBOX);
+        EndPaint(m_hWnd,&stPaint);
+    }
+
+    void Select(int iRow,bool bNotify)
+    {
+        m_iSelection = iRow;
+        m_cDropList.SetSelection(iRow);
+        if (m_hWnd) InvalidateRect(m_hWnd,nullptr,FALSE);
+        if (bNotify && m_fnSelect && iRow >= 0) m_fnSelect(iRow);
+    }
+
+    LRESULT HandleMessage(UINT uMsg,WPARAM wParam,LPARAM lParam)
+    {
+        switch (uMsg)
+        {
+            case WM_PAINT:          Paint();                                                return 0;
+            case WM_LBUTTONDOWN:    SetFocus(m_hWnd); ShowDropDown(!isDroppedDown());       return 0;
+            case WM_GETDLGCODE:                                                             return DLGC_WANTARROWS | DLGC_WANTCHARS;
+            case WM_KEYDOWN:
+                if (wParam == VK_F4 || (wParam == VK_DOWN && (GetKeyState(VK_MENU) & 0x8000))) ShowDropDown(true);
+                else if (wParam == VK_UP && m_iSelection > 0) Select(m_iSelection-1,true);
+                else if (wParam == VK_DOWN && m_iSelection+1 < GetModel().GetCount()) Select(m_iSelection+1,true);
+                return 0;
+            case WM_CHAR:
+            {
+                // Closed type-ahead: forward to the drop list's search, then show its selection
+
+                SendMessageA(m_cDropList.GetWindowHandle(),WM_CHAR,wParam,lParam);
+                if (m_cDropList.GetSelection() != m_iSelection) Select(m_cDropList.GetSelection(),true);
+                return 0;
+            }
+            default:
+                return DefWindowProcA(m_hWnd,uMsg,wParam,lParam);
+        }
+    }
+
+public:
+    CVirtualComboBox()
+    {
+        m_cDropList.SetSelectHandler([this](int iRow) { Select(iRow,true); });
+        m_cDropList.SetDoubleClickHandler([this](int iRow) { Select(iRow,true); ShowDropDown(false); });
+        m_cDropList.SetKillFocusHandler([this] { ShowDropDown(false); });
+    }
+    CVirtualComboBox(const CVirtualComboBox &) = delete;
+    CVirtualComboBox & operator = (const CVirtualComboBox &) = delete;
+    ~CVirtualComboBox() { Destroy(); }
+
+    // Create() -- Create the combo box (iHeight is the height of the closed box; the drop-down shows up to 12 rows)
+    //
+    bool Create(HWND hParent,int iX,int iY,int iWidth,int iHeight)
+    {
+        if (m_hWnd || !RegisterClass()) return false;
+        m_hWnd = CreateWindowExA(0,kClassName,"",WS_CHILD | WS_VISIBLE | WS_TABSTOP | WS_BORDER,iX,iY,iWidth,iHeight,hParent,nullptr,
+                                 GetModuleHandleA(nullptr),this);
+        if (!m_hWnd) return false;
+        return m_cDropList.Create(m_hWnd,0,0,iWidth,iHeight*kDropRows,true);
+    }
+
+    bool Create(CWindow & cWin,int iX,int iY,int iWidth,int iHeight) { return Create(cWin.GetWindowHandle(),iX,iY,iWidth,iHeight); }
+
+    void Destroy()
+    {
+        m_cDropList.Destroy();
+        if (m_hWnd) DestroyWindow(m_hWnd);
+        m_hWnd = nullptr;
+    }
+
+    bool isValid() const { return m_hWnd != nullptr; }
+    HWND GetWindowHandle() const { return m_hWnd; }
+
+    CVirtualListModel & GetModel() { return m_cDropList.GetModel(); }
+    CVirtualListBox & GetDropList() { return m_cDropList; }
+
+    int AppendItems(const char * const * sItems,int iCount) { return m_cDropList.AppendItems(sItems,iCount); }
+    void Refresh() { m_cDropList.Refresh(); if (m_hWnd) InvalidateRect(m_hWnd,nullptr,FALSE); }
+
+    int GetSelection() const { return m_iSelection; }
+    void SetSelection(int iRow) { Select(iRow < GetModel().GetCount() ? iRow : -1,false); }
+    void SetSelectHandler(std::function<void(int)> fnSelect) { m_fnSelect = std::move(fnSelect); }
+
+    bool isDroppedDown() const { return m_cDropList.isValid() && IsWindowVisible(m_cDropList.GetWindowHandle()); }
+
+    // ShowDropDown() -- Open (below the box, in screen coordinates) or close the drop-down list.  A click or Enter in the
+    // list selects a row and closes it; losing the focus closes it.
+    //
+    void ShowDropDown(bool bShow)
+    {
+        HWND hList = m_cDropList.GetWindowHandle();
+        if (!hList || bShow == isDroppedDown()) return;
+        if (!bShow)
+        {
+            ShowWindow(hList,SW_HIDE);
+            return;
+        }
+
+        RECT rBox;
+        GetWindowRect(m_hWnd,&rBox);
+        int iRows = GetModel().GetCount() < kDropRows ? GetModel().GetCount() : kDropRows;
+        int iHeight = (iRows > 0 ? iRows : 1)*m_cDropList.GetRowHeight() + 2*GetSystemMetrics(SM_CYBORDER);
+
+        m_cDropList.Refresh();
+        if (m_iSelection >= 0) m_cDropList.SetSelection(m_iSelection);
+        SetWindowPos(hList,HWND_TOPMOST,rBox.left,rBox.bottom,rBox.right-rBox.left,iHeight,SWP_SHOWWINDOW);
+        SetFocus(hList);
+    }
+};
+
+}; // namespace Sage
+#endif // _CVirtualListBox_H_
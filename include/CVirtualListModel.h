@@ -0,0 +1,352 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CVirtualListModel -- Item data for virtual (owner-data) list and combo boxes (see CVirtualListBox.h)
+//
+// A virtual list does not copy its items into the native control.  It only asks for the rows it is drawing, so a list
+// of millions of rows costs nothing more to show than a list of 20.  The rows come from either:
+//
+//      A column store      -- CStringColumn: all strings in one block of memory plus one offset per row.  500,000 log
+//                             lines of ~80 characters take ~44MB, rather than a native allocation (and message) per item.
+//      A callback          -- SetCallback(iCount,fnItem): the application keeps its own data and returns the text of a row
+//                             when asked (i.e. formatting a record on demand).
+//
+// Search:
+//
+//      FindPrefix()        -- Type-ahead: the first row at or after a start row whose text begins with a prefix (not case
+//                             sensitive).  Uses a sorted index of the rows, which is built on first use and extended (sort
+//                             of the new rows + merge) as rows are appended, so each search is a binary search.
+//                             The index is also kept in blocks of 64 and 4096 entries sorted by row number, so the
+//                             lowest matching row after the start row is found with a binary search per block, however
+//                             many rows match.
+//      FindText()          -- The first row at or after a start row containing a string (not case sensitive), as a scan.
+//
+#if !defined(_CVirtualListModel_H_)
+#define _CVirtualListModel_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Sage
+{
+
+// CStringColumn -- Strings stored end-to-end (each 0-terminated) with an offset per row
+
+class CStringColumn
+{
+    std::vector<char>       m_vText;
+    std::vector<size_t>     m_vOffsets;
+
+public:
+    void Reserve(int iRows,size_t szTextBytes)
+    {
+        m_vOffsets.reserve(iRows);
+        m_vText.reserve(szTextBytes);
+    }
+
+    // Append() -- Add a row (iLength < 0 uses strlen()).  Returns the row number.
+    //
+    int Append(const char * sText,int iLength = -1)
+    {
+        if (!sText) sText = "";
+        if (iLength < 0) iLength = (int) strlen(sText);
+
+        m_vOffsets.push_back(m_vText.size());
+        m_vText.insert(m_vText.end(),sText,sText+iLength);
+        m_vText.push_back(0);
+        return (int) m_vOffsets.size()-1;
+    }
+
+    // Append() -- Add iCount rows.  Returns the row number of the first one.
+    //
+    int Append(const char * const * sItems,int iCount)
+    {
+        size_t szBytes = 0;
+        for (int i=0;i<iCount;i++) szBytes += (sItems[i] ? strlen(sItems[i]) : 0) + 1;
+
+        int iFirst = (int) m_vOffsets.size();
+        m_vOffsets.reserve(m_vOffsets.size() + iCount);
+        m_vText.reserve(m_vText.size() + szBytes);
+        for (int i=0;i<iCount;i++) Append(sItems[i]);
+        return iFirst;
+    }
+
+    int GetCount() const { return (int) m_vOffsets.size(); }
+
+    // Get() -- Row text.  The pointer is valid until the next Append() or Clear().
+    //
+    const char * Get(int iRow) const { return m_vText.data() + m_vOffsets[iRow]; }
+
+    int GetLength(int iRow) const
+    {
+        size_t szEnd = iRow+1 < (int) m_vOffsets.size() ? m_vOffsets[iRow+1] : m_vText.size();
+        return (int) (szEnd - m_vOffsets[iRow] - 1);
+    }
+
+    size_t GetMemoryUsed() const { return m_vText.capacity() + m_vOffsets.capacity()*sizeof(size_t); }
+
+    void Clear()
+    {
+        m_vText.clear();
+        m_vOffsets.clear();
+    }
+};
+
+class CVirtualListModel
+{
+public:
+    // ItemCallback -- Returns the text of iRow.  The text may be written to sScratch (and sScratch.c_str() returned), or
+    // may point to the application's own data; it needs to stay valid only until the next call.
+    //
+    using ItemCallback = std::function<const char * (int iRow,std::string & sScratch)>;
+
+private:
+    CStringColumn   m_cStore;
+    ItemCallback    m_fnItem;
+    int             m_iCount        = 0;        // Callback mode only
+    bool            m_bCallback     = false;
+
+    std::vector<int>    m_vIndex;               // Rows sorted by text (not case sensitive); covers rows 0..m_iIndexed-1
+    std::vector<int>    m_vSmallBlocks;         // m_vIndex with each kSmallBlock entries sorted by row number
+    std::vector<int>    m_vLargeBlocks;         // m_vIndex with each kLargeBlock entries sorted by row number
+    int                 m_iIndexed  = 0;
+
+    static constexpr size_t kSmallBlock = 64;
+    static constexpr size_t kLargeBlock = 4096;
+
+    static void SortBlocks(std::vector<int> & vBlocks,const std::vector<int> & vIndex,size_t szBlock)
+    {
+        vBlocks = vIndex;
+        for (size_t i=0;i<vBlocks.size();i += szBlock) std::sort(vBlocks.begin()+i,vBlocks.begin()+std::min(i+szBlock,vBlocks.size()));
+    }
+
+    static unsigned char Lower(char c) { return (unsigned char) (c >= 'A' && c <= 'Z' ? c + 32 : c); }
+
+    // Compare() -- strcmp() without case; with iLength >= 0, only the first iLength characters of s2 are compared
+    //              (so a row "begins with" s2 when the result is 0)
+
+    static int Compare(const char * s1,const char * s2,int iLength = -1)
+    {
+        for (int i=0;iLength < 0 || i < iLength;i++)
+        {
+            unsigned char c1 = Lower(s1[i]),c2 = Lower(s2[i]);
+            if (c1 != c2) return c1 < c2 ? -1 : 1;
+            if (!c1) return 0;
+        }
+        return 0;
+    }
+
+    // GetKey() -- 8 characters of a row from iDepth, lowered and packed so that comparing keys compares the text
+
+    uint64_t GetKey(int iRow,int iDepth,std::string & sScratch) const
+    {
+        const char * sText = GetItem(iRow,sScratch);
+        for (int i=0;i<iDepth;i++) if (!sText[i]) return 0;
+
+        uint64_t uiKey = 0;
+        int i = 0;
+        for (;i < 8 && sText[iDepth+i];i++) uiKey = (uiKey << 8) | Lower(sText[iDepth+i]);
+        return uiKey << (8*(8-i));
+    }
+
+    // SortRows() -- Sort rows by text, 8 characters at a time: sort on the key at iDepth, then sort each run of equal keys
+    //               on the next 8 characters.  Rows with the same text stay in row order.  Log lines share long prefixes
+    //               ("Render INFO: request"), which makes this much faster than a sort comparing whole strings.
+
+    void SortRows(int * pRows,int iCount,int iDepth)
+    {
+        std::string sScratch;
+        std::vector<std::pair<uint64_t,int>> vKeys(iCount);
+        for (int i=0;i<iCount;i++) vKeys[i] = { GetKey(pRows[i],iDepth,sScratch),pRows[i] };
+        std::sort(vKeys.begin(),vKeys.end());
+        for (int i=0;i<iCount;i++) pRows[i] = vKeys[i].second;
+
+        for (int i=0,iEnd;i<iCount;i = iEnd)
+        {
+            for (iEnd = i+1;iEnd < iCount && vKeys[iEnd].first == vKeys[i].first;iEnd++);
+            if (iEnd - i > 1 && (vKeys[i].first & 0xFF)) SortRows(pRows+i,iEnd-i,iDepth+8);     // Text continues past the key
+        }
+    }
+
+    void UpdateIndex()
+    {
+        int iCount = GetCount();
+        if (m_iIndexed >= iCount) return;
+
+        size_t szOld = m_vIndex.size();
+        for (int i=m_iIndexed;i<iCount;i++) m_vIndex.push_back(i);
+        SortRows(m_vIndex.data()+szOld,(int) (m_vIndex.size()-szOld),0);
+
+        std::string s1,s2;
+        std::inplace_merge(m_vIndex.begin(),m_vIndex.begin()+szOld,m_vIndex.end(),[&](int i1,int i2)
+        {
+            int iCompare = Compare(GetItem(i1,s1),GetItem(i2,s2));
+            return iCompare ? iCompare < 0 : i1 < i2;
+        });
+        m_iIndexed = iCount;
+
+        SortBlocks(m_vSmallBlocks,m_vIndex,kSmallBlock);
+        SortBlocks(m_vLargeBlocks,m_vIndex,kLargeBlock);
+    }
+
+public:
+    // SetCallback() -- Use application data: iCount rows, with fnItem returning the text of a row.  Replaces any stored rows.
+    //
+    void SetCallback(int iCount,ItemCallback fnItem)
+    {
+        m_cStore.Clear();
+        m_fnItem    = std::move(fnItem);
+        m_bCallback = true;
+        m_iCount    = iCount < 0 ? 0 : iCount;
+        InvalidateIndex();
+    }
+
+    // SetCount() -- Change the number of rows in callback mode (i.e. as a log grows).  Rows past the old count are
+    // added to the search index when it is next used.  If existing rows change, call InvalidateIndex().
+    //
+    void SetCount(int iCount)
+    {
+        if (!m_bCallback) return;
+        m_iCount = iCount < 0 ? 0 : iCount;
+        if (m_iIndexed > m_iCount) InvalidateIndex();
+    }
+
+    // AppendItem(), AppendItems() -- Add rows to the column store (switches from callback mode to the store).  Returns
+    // the first new row.
+    //
+    int AppendItem(const char * sItem,int iLength = -1)
+    {
+        if (m_bCallback) Clear();
+        return m_cStore.Append(sItem,iLength);
+    }
+
+    int AppendItems(const char * const * sItems,int iCount)
+    {
+        if (m_bCallback) Clear();
+        return m_cStore.Append(sItems,iCount);
+    }
+
+    void Reserve(int iRows,size_t szTextBytes) { m_cStore.Reserve(iRows,szTextBytes); }
+
+    // Clear() -- Remove all rows (and leave callback mode)
+    //
+    void Clear()
+    {
+        m_cStore.Clear();
+        m_fnItem    = nullptr;
+        m_bCallback = false;
+        m_iCount    = 0;
+        InvalidateIndex();
+    }
+
+    int GetCount() const { return m_bCallback ? m_iCount : m_cStore.GetCount(); }
+    bool isCallback() const { return m_bCallback; }
+    const CStringColumn & GetStore() const { return m_cStore; }
+    size_t GetMemoryUsed() const { return m_cStore.GetMemoryUsed() + (m_vIndex.capacity() + m_vSmallBlocks.capacity() + m_vLargeBlocks.capacity())*sizeof(int); }
+
+    // GetItem() -- Text of a row ("" when out of range)
+    //
+    const char * GetItem(int iRow,std::string & sScratch) const
+    {
+        if (iRow < 0 || iRow >= GetCount()) return "";
+        if (!m_bCallback) return m_cStore.Get(iRow);
+
+        const char * sText = m_fnItem ? m_fnItem(iRow,sScratch) : nullptr;
+        return sText ? sText : "";
+    }
+
+    // InvalidateIndex() -- Rebuild the search index on next use (after rows have changed in callback mode)
+    //
+    void InvalidateIndex()
+    {
+        m_vIndex.clear();
+        m_vSmallBlocks.clear();
+        m_vLargeBlocks.clear();
+        m_iIndexed = 0;
+    }
+
+    // BuildIndex() -- Bring the search index up to date now (otherwise done by the first FindPrefix() after rows are added)
+    //
+    void BuildIndex() { UpdateIndex(); }
+
+    // FindPrefix() -- First row at or after iStart (wrapping to the top) whose text begins with sPrefix (not case
+    // sensitive), or -1
+    //
+    int FindPrefix(const char * sPrefix,int iStart = 0)
+    {
+        int iCount = GetCount();
+        if (!sPrefix || !iCount) return -1;
+        if (iStart < 0 || iStart >= iCount) iStart = 0;
+        UpdateIndex();
+
+        int iLength = (int) strlen(sPrefix);
+        std::string sScratch;
+
+        auto itBegin = std::lower_bound(m_vIndex.begin(),m_vIndex.end(),sPrefix,[&](int iRow,const char * s)
+        {
+            return Compare(GetItem(iRow,sScratch),s,iLength) < 0;
+        });
+        auto itEnd = std::upper_bound(itBegin,m_vIndex.end(),sPrefix,[&](const char * s,int iRow)
+        {
+            return Compare(GetItem(iRow,sScratch),s,iLength) > 0;
+        });
+
+        // Matching rows are contiguous in the index.  Find the lowest row >= iStart (else the lowest row, wrapping to the
+        // top): entries of partial blocks at either end are checked one by one, and each whole block with a binary
+        // search of its rows in row order (large blocks in the middle of the range, small blocks up to them).
+
+        int iFirst = -1,iLowest = -1;
+        auto Consider = [&](int iRow)
+        {
+            if (iRow >= iStart && (iFirst < 0 || iRow < iFirst)) iFirst = iRow;
+            if (iLowest < 0 || iRow < iLowest) iLowest = iRow;
+        };
+
+        size_t i = itBegin - m_vIndex.begin(),szEnd = itEnd - m_vIndex.begin();
+        auto Search = [&](const std::vector<int> & vBlocks,size_t szBlock)
+        {
+            auto itBlock = vBlocks.begin() + i;
+            auto it = std::lower_bound(itBlock,itBlock + szBlock,iStart);
+            if (it != itBlock + szBlock) Consider(*it);
+            Consider(*itBlock);
+            i += szBlock;
+        };
+
+        for (;i < szEnd && i % kSmallBlock;i++) Consider(m_vIndex[i]);
+        while (i + kSmallBlock <= szEnd && i % kLargeBlock) Search(m_vSmallBlocks,kSmallBlock);
+        while (i + kLargeBlock <= szEnd) Search(m_vLargeBlocks,kLargeBlock);
+        while (i + kSmallBlock <= szEnd) Search(m_vSmallBlocks,kSmallBlock);
+        for (;i < szEnd;i++) Consider(m_vIndex[i]);
+
+        return iFirst >= 0 ? iFirst : iLowest;
+    }
+
+    // FindText() -- First row at or after iStart (wrapping to the top) containing sText (not case sensitive), or -1
+    //
+    int FindText(const char * sText,int iStart = 0) const
+    {
+        int iCount = GetCount();
+        if (!sText || !*sText || !iCount) return -1;
+        if (iStart < 0 || iStart >= iCount) iStart = 0;
+
+        int iLength = (int) strlen(sText);
+        unsigned char cLower = Lower(sText[0]);
+        unsigned char cUpper = (unsigned char) (cLower >= 'a' && cLower <= 'z' ? cLower - 32 : cLower);
+        std::string sScratch;
+
+        for (int i=0;i<iCount;i++)
+        {
+            int iRow = iStart + i < iCount ? iStart + i : iStart + i - iCount;
+            for (const char * s = GetItem(iRow,sScratch);*s;s++)
+                if (((unsigned char) *s == cLower || (unsigned char) *s == cUpper) && !Compare(s,sText,iLength)) return iRow;
+        }
+        return -1;
+    }
+};
+
+}; // namespace Sage
+#endif // _CVirtualListModel_H_
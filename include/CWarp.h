@@ -0,0 +1,505 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// CWarp -- Affine and perspective warping (rotation, scaling, skew, etc.) of 24-bit bitmaps.
+//
+// A WarpMatrix_t describes where source pixels go in the destination.  CWarp::Warp() walks the destination, maps each pixel back
+// into the source with the inverse matrix and samples it with nearest, bilinear or bicubic filtering.
+//
+// Affine matrices (rotation, scale, skew, translation) step through the source with 16.16 fixed-point increments, so each
+// destination pixel costs two integer adds plus the sample.  Bilinear and bicubic sampling work on all three channels at once with SSE2.
+// Perspective matrices use a floating-point divide per pixel.
+//
+// The output is clipped to the destination bitmap (and an optional destination rectangle).  Pixels that map outside of the source
+// are left untouched, and an optional 8-bit mask (255 = written, 0 = not written) can be output for compositing.
+//
+// Example -- Rotate a sprite around its center and place its center at (500,300) in the window bitmap:
+//
+//      auto mMatrix = WarpMatrix_t::Translate(-cSprite.GetWidth()/2.0,-cSprite.GetHeight()/2.0)
+//                   * WarpMatrix_t::Rotate(fAngle)
+//                   * WarpMatrix_t::Translate(500,300);
+//
+//      CWarp::Warp(cSprite,cWindowBitmap,mMatrix,WarpSample::Bilinear);
+//
+// Matrices combine left to right, i.e. A*B applies A first, then B.
+//
+#if !defined(_CWarp_H_)
+#define _CWarp_H_
+
+#include <cmath>
+#include <emmintrin.h>
+#include "Sage.h"
+#include "CRawBitmap.h"
+#include "CPoint.h"
+#include "CParallel.h"
+#include "SageProfile.h"
+
+namespace Sage
+{
+
+enum class WarpSample
+{
+    Nearest,
+    Bilinear,
+    Bicubic,
+};
+
+// WarpMatrix_t -- 3x3 transform applied to row vectors (x,y,1).  Affine matrices have a last column of (0,0,1).
+//
+struct WarpMatrix_t
+{
+    double m[3][3];
+
+    static WarpMatrix_t Identity()                          { return { { { 1,0,0 },{ 0,1,0 },{ 0,0,1 } } }; }
+    static WarpMatrix_t Translate(double fX,double fY)      { return { { { 1,0,0 },{ 0,1,0 },{ fX,fY,1 } } }; }
+    static WarpMatrix_t Scale(double fX,double fY)          { return { { { fX,0,0 },{ 0,fY,0 },{ 0,0,1 } } }; }
+    static WarpMatrix_t Scale(double fScale)                { return Scale(fScale,fScale); }
+    static WarpMatrix_t Skew(double fX,double fY)           { return { { { 1,fY,0 },{ fX,1,0 },{ 0,0,1 } } }; }
+
+    // Rotate() -- Rotation around (0,0) in degrees (clockwise on the screen, since y points down)
+    //
+    static WarpMatrix_t Rotate(double fDegrees)
+    {
+        double fRad = fDegrees*3.14159265358979323846/180.0;
+        double c = std::cos(fRad), s = std::sin(fRad);
+        return { { { c,s,0 },{ -s,c,0 },{ 0,0,1 } } };
+    }
+
+    // Rotate() -- Rotation in degrees around a center point
+    //
+    static WarpMatrix_t Rotate(double fDegrees,double fCenterX,double fCenterY)
+    {
+        return Translate(-fCenterX,-fCenterY)*Rotate(fDegrees)*Translate(fCenterX,fCenterY);
+    }
+
+    // Perspective() -- Matrix that maps the 4 corners of a fWidth x fHeight rectangle to 4 destination points
+    // (top-left, top-right, bottom-right, bottom-left).  bSuccess is set false if the points are degenerate.
+    //
+    static WarpMatrix_t Perspective(double fWidth,double fHeight,const CfPoint (&pDest)[4],bool * bSuccess = nullptr)
+    {
+        // Unit square to quad (Heckbert), then scale the rectangle to the unit square
+
+        double x0 = pDest[0].x, y0 = pDest[0].y, x1 = pDest[1].x, y1 = pDest[1].y;
+        double x2 = pDest[2].x, y2 = pDest[2].y, x3 = pDest[3].x, y3 = pDest[3].y;
+
+        double dx1 = x1 - x2, dx2 = x3 - x2, dx3 = x0 - x1 + x2 - x3;
+        double dy1 = y1 - y2, dy2 = y3 - y2, dy3 = y0 - y1 + y2 - y3;
+
+        WarpMatrix_t mQuad = Identity();
+        double fDet = dx1*dy2 - dx2*dy1;
+
+        if (bSuccess) *bSuccess = fDet != 0 && fWidth > 0 && fHeight > 0;
+        if (fDet == 0 || fWidth <= 0 || fHeight <= 0) return Identity();
+
+        double g = (dx3*dy2 - dx2*dy3)/fDet;
+        double h = (dx1*dy3 - dx3*dy1)/fDet;
+
+        mQuad.m[0][0] = x1 - x0 + g*x1;  mQuad.m[0][1] = y1 - y0 + g*y1;  mQuad.m[0][2] = g;
+        mQuad.m[1][0] = x3 - x0 + h*x3;  mQuad.m[1][1] = y3 - y0 + h*y3;  mQuad.m[1][2] = h;
+        mQuad.m[2][0] = x0;              mQuad.m[2][1] = y0;              mQuad.m[2][2] = 1;
+
+        return Scale(1.0/fWidth,1.0/fHeight)*mQuad;
+    }
+
+    WarpMatrix_t operator * (const WarpMatrix_t & m2) const
+    {
+        WarpMatrix_t mOut;
+        for (int i=0;i<3;i++)
+            for (int j=0;j<3;j++)
+                mOut.m[i][j] = m[i][0]*m2.m[0][j] + m[i][1]*m2.m[1][j] + m[i][2]*m2.m[2][j];
+        return mOut;
+    }
+
+    bool isAffine() const { return m[0][2] == 0 && m[1][2] == 0 && m[2][2] == 1; }
+
+    // Invert() -- Returns the inverse matrix.  bSuccess is set false (and the identity returned) if the matrix cannot be inverted.
+    //
+    WarpMatrix_t Invert(bool * bSuccess = nullptr) const
+    {
+        double fDet =  m[0][0]*(m[1][1]*m[2][2] - m[1][2]*m[2][1])
+                     - m[0][1]*(m[1][0]*m[2][2] - m[1][2]*m[2][0])
+                     + m[0][2]*(m[1][0]*m[2][1] - m[1][1]*m[2][0]);
+
+        if (bSuccess) *bSuccess = fDet != 0;
+        if (fDet == 0) return Identity();
+
+        double f = 1.0/fDet;
+        WarpMatrix_t mOut;
+        mOut.m[0][0] =  (m[1][1]*m[2][2] - m[1][2]*m[2][1])*f;
+        mOut.m[0][1] = -(m[0][1]*m[2][2] - m[0][2]*m[2][1])*f;
+        mOut.m[0][2] =  (m[0][1]*m[1][2] - m[0][2]*m[1][1])*f;
+        mOut.m[1][0] = -(m[1][0]*m[2][2] - m[1][2]*m[2][0])*f;
+        mOut.m[1][1] =  (m[0][0]*m[2][2] - m[0][2]*m[2][0])*f;
+        mOut.m[1][2] = -(m[0][0]*m[1][2] - m[0][2]*m[1][0])*f;
+        mOut.m[2][0] =  (m[1][0]*m[2][1] - m[1][1]*m[2][0])*f;
+        mOut.m[2][1] = -(m[0][0]*m[2][1] - m[0][1]*m[2][0])*f;
+        mOut.m[2][2] =  (m[0][0]*m[1][1] - m[0][1]*m[1][0])*f;
+        return mOut;
+    }
+
+    // Transform() -- Map a point through the matrix
+    //
+    CfPoint Transform(double fX,double fY) const
+    {
+        double fW = fX*m[0][2] + fY*m[1][2] + m[2][2];
+        if (fW == 0) fW = 1e-12;
+        return { (fX*m[0][0] + fY*m[1][0] + m[2][0])/fW, (fX*m[0][1] + fY*m[1][1] + m[2][1])/fW };
+    }
+};
+
+class CWarp
+{
+public:
+    static constexpr int kMinRowsPerThread = 32;
+
+private:
+    static constexpr int kFixedShift    = 16;
+    static constexpr long long kFixedOne = 1LL << kFixedShift;
+
+    // Warp parameters shared by all rows
+    //
+    struct Job_t
+    {
+        const RawBitmap_t * stSource;
+        RawBitmap_t       * stDest;
+        WarpMatrix_t        mInverse;
+        WarpSample          eSample;
+        RECT                rClip;
+        unsigned char     * sMask;
+        int                 iMaskStride;
+    };
+
+    static __forceinline __m128i Load3(const unsigned char * s)
+    {
+        return _mm_cvtsi32_si128((int) s[0] | ((int) s[1] << 8) | ((int) s[2] << 16));
+    }
+    static __forceinline void Store3(unsigned char * s,__m128i v)
+    {
+        int i = _mm_cvtsi128_si32(v);
+        s[0] = (unsigned char) i;
+        s[1] = (unsigned char) (i >> 8);
+        s[2] = (unsigned char) (i >> 16);
+    }
+
+    // SampleBilinear() -- iX,iY are the top-left source pixel, iFx,iFy are the fractions (0-256).  Edges are clamped.
+    //
+    static __forceinline void SampleBilinear(const RawBitmap_t & stSource,int iX,int iY,int iFx,int iFy,unsigned char * sOut)
+    {
+        int iX0 = iX < 0 ? 0 : iX, iX1 = iX+1 >= stSource.iWidth ? stSource.iWidth-1 : iX+1;
+        int iY0 = iY < 0 ? 0 : iY, iY1 = iY+1 >= stSource.iHeight ? stSource.iHeight-1 : iY+1;
+        if (iX0 >= stSource.iWidth) iX0 = stSource.iWidth-1;
+        if (iY0 >= stSource.iHeight) iY0 = stSource.iHeight-1;
+
+        const unsigned char * sRow0 = stSource.stMem + (long long) iY0*stSource.iWidthBytes;
+        const unsigned char * sRow1 = stSource.stMem + (long long) iY1*stSource.iWidthBytes;
+
+        __m128i vZero = _mm_setzero_si128();
+        __m128i v00 = _mm_unpacklo_epi8(Load3(sRow0 + iX0*3),vZero);
+        __m128i v01 = _mm_unpacklo_epi8(Load3(sRow0 + iX1*3),vZero);
+        __m128i v10 = _mm_unpacklo_epi8(Load3(sRow1 + iX0*3),vZero);
+        __m128i v11 = _mm_unpacklo_epi8(Load3(sRow1 + iX1*3),vZero);
+
+        __m128i vFx  = _mm_set1_epi16((short) iFx);
+        __m128i vFx1 = _mm_set1_epi16((short) (256-iFx));
+        __m128i vFy  = _mm_set1_epi16((short) iFy);
+        __m128i vFy1 = _mm_set1_epi16((short) (256-iFy));
+
+        // Each product is at most 255*256, so the sums stay within 16 bits (unsigned)
+
+        __m128i vTop = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(v00,vFx1),_mm_mullo_epi16(v01,vFx)),8);
+        __m128i vBot = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(v10,vFx1),_mm_mullo_epi16(v11,vFx)),8);
+        __m128i vOut = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(vTop,vFy1),_mm_mullo_epi16(vBot,vFy)),_mm_set1_epi16(128)),8);
+
+        Store3(sOut,_mm_packus_epi16(vOut,vZero));
+    }
+
+    // CubicWeights() -- Catmull-Rom weights for a fraction 0-1
+    //
+    static __forceinline void CubicWeights(float f,float * w)
+    {
+        float f2 = f*f, f3 = f2*f;
+        w[0] = -0.5f*f3 + f2 - 0.5f*f;
+        w[1] =  1.5f*f3 - 2.5f*f2 + 1.0f;
+        w[2] = -1.5f*f3 + 2.0f*f2 + 0.5f*f;
+        w[3] =  0.5f*f3 - 0.5f*f2;
+    }
+
+    // SampleBicubic() -- 4x4 Catmull-Rom with the 3 channels in one SSE register.  Edges are clamped.
+    //
+    static __forceinline void SampleBicubic(const RawBitmap_t & stSource,int iX,int iY,float fFx,float fFy,unsigned char * sOut)
+    {
+        float fWx[4], fWy[4];
+        CubicWeights(fFx,fWx);
+        CubicWeights(fFy,fWy);
+
+        __m128i vZero = _mm_setzero_si128();
+        __m128 vSum = _mm_setzero_ps();
+
+        for (int j=0;j<4;j++)
+        {
+            int y = iY - 1 + j;
+            y = y < 0 ? 0 : y >= stSource.iHeight ? stSource.iHeight-1 : y;
+            const unsigned char * sRow = stSource.stMem + (long long) y*stSource.iWidthBytes;
+
+            __m128 vRow = _mm_setzero_ps();
+            for (int i=0;i<4;i++)
+            {
+                int x = iX - 1 + i;
+                x = x < 0 ? 0 : x >= stSource.iWidth ? stSource.iWidth-1 : x;
+                __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(Load3(sRow + x*3),vZero),vZero);
+                vRow = _mm_add_ps(vRow,_mm_mul_ps(_mm_cvtepi32_ps(v),_mm_set1_ps(fWx[i])));
+            }
+            vSum = _mm_add_ps(vSum,_mm_mul_ps(vRow,_mm_set1_ps(fWy[j])));
+        }
+
+        __m128i vOut = _mm_cvtps_epi32(vSum);
+        vOut = _mm_packs_epi32(vOut,vZero);
+        Store3(sOut,_mm_packus_epi16(vOut,vZero));
+    }
+
+    // Sample() -- Sample the source at (fU,fV) in source pixel coordinates (pixel centers at integer positions)
+    //
+    static __forceinline void Sample(const RawBitmap_t & stSource,WarpSample eSample,long long llU,long long llV,unsigned char * sOut)
+    {
+        if (eSample == WarpSample::Nearest)
+        {
+            int iX = (int) ((llU + kFixedOne/2) >> kFixedShift);
+            int iY = (int) ((llV + kFixedOne/2) >> kFixedShift);
+            const unsigned char * s = stSource.stMem + (long long) iY*stSource.iWidthBytes + iX*3;
+            sOut[0] = s[0]; sOut[1] = s[1]; sOut[2] = s[2];
+        }
+        else if (eSample == WarpSample::Bilinear)
+            SampleBilinear(stSource,(int) (llU >> kFixedShift),(int) (llV >> kFixedShift),
+                           (int) ((llU & (kFixedOne-1)) >> (kFixedShift-8)),(int) ((llV & (kFixedOne-1)) >> (kFixedShift-8)),sOut);
+        else
+            SampleBicubic(stSource,(int) (llU >> kFixedShift),(int) (llV >> kFixedShift),
+                          (float) (llU & (kFixedOne-1))/(float) kFixedOne,(float) (llV & (kFixedOne-1))/(float) kFixedOne,sOut);
+    }
+
+    // ClipSpan() -- Narrow [iStart,iEnd) to the steps i where llMin <= llValue + i*llStep < llMax
+    //
+    static void ClipSpan(long long llValue,long long llStep,long long llMin,long long llMax,int & iStart,int & iEnd)
+    {
+        if (!llStep)
+        {
+            if (llValue < llMin || llValue >= llMax) iEnd = iStart;
+            return;
+        }
+
+        double fA = (double) (llMin - llValue)/(double) llStep;
+        double fB = (double) (llMax - llValue)/(double) llStep;
+        if (fA > fB) std::swap(fA,fB);
+
+        int iLo = (int) max(-1.0,min(std::floor(fA) - 1,(double) INT_MAX/2));
+        int iHi = (int) max(-1.0,min(std::ceil(fB) + 1,(double) INT_MAX/2));
+
+        // Tighten with exact integer tests (the double estimate can be off by one at the ends)
+
+        auto fnInside = [=](int i) { long long v = llValue + i*llStep; return v >= llMin && v < llMax; };
+
+        if (iLo < iStart) iLo = iStart;
+        if (iHi > iEnd) iHi = iEnd;
+        while (iLo < iHi && !fnInside(iLo)) iLo++;
+        while (iHi > iLo && !fnInside(iHi-1)) iHi--;
+
+        iStart = iLo;
+        iEnd   = iHi;
+    }
+
+    // WarpRows() -- Process destination rows iY1 to iY2 (inside the clip rectangle)
+    //
+    static void WarpRows(const Job_t & stJob,int iY1,int iY2)
+    {
+        const RawBitmap_t & stSource = *stJob.stSource;
+        RawBitmap_t & stDest = *stJob.stDest;
+        const WarpMatrix_t & mi = stJob.mInverse;
+
+        // A sample is inside when its nearest source pixel is inside (i.e. -0.5 <= u < Width-0.5)
+
+        long long llMinU = -kFixedOne/2, llMaxU = (long long) stSource.iWidth*kFixedOne - kFixedOne/2;
+        long long llMinV = -kFixedOne/2, llMaxV = (long long) stSource.iHeight*kFixedOne - kFixedOne/2;
+
+        int iX1 = stJob.rClip.left;
+        int iX2 = stJob.rClip.right;
+        bool bAffine = mi.isAffine();
+
+        for (int iY=iY1;iY<iY2;iY++)
+        {
+            unsigned char * sOut  = stDest.stMem + (long long) iY*stDest.iWidthBytes + iX1*3;
+            unsigned char * sMask = stJob.sMask ? stJob.sMask + (long long) iY*stJob.iMaskStride + iX1 : nullptr;
+
+            if (bAffine)
+            {
+                // Fixed-point incremental stepping along the row
+
+                long long llU  = (long long) std::llround((iX1*mi.m[0][0] + iY*mi.m[1][0] + mi.m[2][0])*kFixedOne);
+                long long llV  = (long long) std::llround((iX1*mi.m[0][1] + iY*mi.m[1][1] + mi.m[2][1])*kFixedOne);
+                long long llDu = (long long) std::llround(mi.m[0][0]*kFixedOne);
+                long long llDv = (long long) std::llround(mi.m[0][1]*kFixedOne);
+
+                // Clip the row to the span that falls inside the source, so the inner loop has no bounds checks
+
+                int iStart = 0, iEnd = iX2 - iX1;
+                ClipSpan(llU,llDu,llMinU,llMaxU,iStart,iEnd);
+                ClipSpan(llV,llDv,llMinV,llMaxV,iStart,iEnd);
+
+                if (sMask)
+                {
+                    if (iEnd <= iStart) memset(sMask,0,iX2 - iX1);
+                    else
+                    {
+                        memset(sMask,0,iStart);
+                        memset(sMask + iStart,255,iEnd - iStart);
+                        memset(sMask + iEnd,0,iX2 - iX1 - iEnd);
+                    }
+                }
+
+                llU += llDu*iStart;
+                llV += llDv*iStart;
+                sOut += iStart*3;
+
+                switch (stJob.eSample)
+                {
+                    case WarpSample::Nearest:
+                        for (int i=iStart;i<iEnd;i++,llU += llDu,llV += llDv,sOut += 3)
+                            Sample(stSource,WarpSample::Nearest,llU,llV,sOut);
+                        break;
+                    case WarpSample::Bilinear:
+                        for (int i=iStart;i<iEnd;i++,llU += llDu,llV += llDv,sOut += 3)
+                            Sample(stSource,WarpSample::Bilinear,llU,llV,sOut);
+                        break;
+                    default:
+                        for (int i=iStart;i<iEnd;i++,llU += llDu,llV += llDv,sOut += 3)
+                            Sample(stSource,WarpSample::Bicubic,llU,llV,sOut);
+                        break;
+                }
+            }
+            else
+            {
+                // Perspective -- step the homogeneous coordinates and divide per pixel
+
+                double fU = iX1*mi.m[0][0] + iY*mi.m[1][0] + mi.m[2][0];
+                double fV = iX1*mi.m[0][1] + iY*mi.m[1][1] + mi.m[2][1];
+                double fW = iX1*mi.m[0][2] + iY*mi.m[1][2] + mi.m[2][2];
+
+                for (int iX=iX1;iX<iX2;iX++,fU += mi.m[0][0],fV += mi.m[0][1],fW += mi.m[0][2],sOut += 3)
+                {
+                    bool bInside = false;
+                    if (fW > 1e-12)
+                    {
+                        double fInvW = 1.0/fW;
+                        double fX = fU*fInvW*kFixedOne;
+                        double fY = fV*fInvW*kFixedOne;
+                        if (fX >= llMinU && fX < llMaxU && fY >= llMinV && fY < llMaxV)
+                        {
+                            bInside = true;
+                            Sample(stSource,stJob.eSample,(long long) std::floor(fX),(long long) std::floor(fY),sOut);
+                        }
+                    }
+                    if (sMask) *sMask++ = bInside ? 255 : 0;
+                }
+            }
+        }
+    }
+
+public:
+
+    // Warp() -- Warp stSource into stDest with a source-to-destination matrix.
+    //
+    // eSample      -- Nearest, Bilinear or Bicubic
+    // rDestClip    -- Optional rectangle in the destination to limit the output to (i.e. a dirty rectangle).  nullptr = whole destination
+    // sMask        -- Optional 8-bit mask the size of the destination (iMaskStride bytes per row, 0 = destination width).  Pixels inside the clip
+    //                 rectangle are set to 255 where the source was drawn and 0 where it was not.
+    //
+    // Only the destination pixels that map into the source are written.  Returns false if the bitmaps are invalid or the matrix cannot be inverted.
+    //
+    static bool Warp(const RawBitmap_t & stSource,RawBitmap_t & stDest,const WarpMatrix_t & mMatrix,WarpSample eSample = WarpSample::Bilinear,
+                     const RECT * rDestClip = nullptr,unsigned char * sMask = nullptr,int iMaskStride = 0)
+    {
+        SageProfileZone("CWarp::Warp");
+        if (!stSource.stMem || !stDest.stMem || stSource.iWidth <= 0 || stSource.iHeight <= 0 || stSource.stMem == stDest.stMem) return false;
+
+        bool bSuccess;
+        Job_t stJob;
+        stJob.mInverse = mMatrix.Invert(&bSuccess);
+        if (!bSuccess) return false;
+
+        stJob.stSource      = &stSource;
+        stJob.stDest        = &stDest;
+        stJob.eSample       = eSample;
+        stJob.sMask         = sMask;
+        stJob.iMaskStride   = iMaskStride > 0 ? iMaskStride : stDest.iWidth;
+        stJob.rClip         = { 0,0,stDest.iWidth,stDest.iHeight };
+
+        if (rDestClip)
+        {
+            stJob.rClip.left    = max(stJob.rClip.left,rDestClip->left);
+            stJob.rClip.top     = max(stJob.rClip.top,rDestClip->top);
+            stJob.rClip.right   = min(stJob.rClip.right,rDestClip->right);
+            stJob.rClip.bottom  = min(stJob.rClip.bottom,rDestClip->bottom);
+        }
+        if (stJob.rClip.right <= stJob.rClip.left || stJob.rClip.bottom <= stJob.rClip.top) return true;
+
+        // Limit the rows to the bounding box of the transformed source (affine and perspective in front of the camera)
+
+        int iTop = stJob.rClip.top, iBottom = stJob.rClip.bottom;
+        if (mMatrix.isAffine())
+        {
+            CfPoint p[4] = { mMatrix.Transform(-.5,-.5), mMatrix.Transform(stSource.iWidth-.5,-.5),
+                             mMatrix.Transform(-.5,stSource.iHeight-.5), mMatrix.Transform(stSource.iWidth-.5,stSource.iHeight-.5) };
+            double fMinY = min(min(p[0].y,p[1].y),min(p[2].y,p[3].y));
+            double fMaxY = max(max(p[0].y,p[1].y),max(p[2].y,p[3].y));
+            iTop    = max(iTop,(int) std::floor(max(fMinY,-1e9)));
+            iBottom = min(iBottom,(int) std::ceil(min(fMaxY,1e9)) + 1);
+
+            if (sMask)      // Rows outside of the bounding box still need their mask cleared
+            {
+                for (int iY=stJob.rClip.top;iY<stJob.rClip.bottom;iY++)
+                    if (iY < iTop || iY >= iBottom)
+                        memset(sMask + (long long) iY*stJob.iMaskStride + stJob.rClip.left,0,stJob.rClip.right - stJob.rClip.left);
+            }
+        }
+        if (iBottom <= iTop) return true;
+
+        CParallel::ForBands(iBottom - iTop,[&stJob,iTop](int iY1,int iY2,int) { WarpRows(stJob,iTop + iY1,iTop + iY2); },kMinRowsPerThread);
+        return true;
+    }
+
+    static bool Warp(CBitmap & cSource,CBitmap & cDest,const WarpMatrix_t & mMatrix,WarpSample eSample = WarpSample::Bilinear,
+                     const RECT * rDestClip = nullptr,unsigned char * sMask = nullptr,int iMaskStride = 0)
+    {
+        return Warp(*cSource,*cDest,mMatrix,eSample,rDestClip,sMask,iMaskStride);
+    }
+
+    // Rotate() -- Rotate a bitmap by fDegrees around its center and place the center at pDestCenter in the destination.
+    // fScale scales the bitmap at the same time (1.0 = same size).
+    //
+    static bool Rotate(CBitmap & cSource,CBitmap & cDest,double fDegrees,CfPoint pDestCenter,double fScale = 1.0,
+                       WarpSample eSample = WarpSample::Bilinear,unsigned char * sMask = nullptr)
+    {
+        WarpMatrix_t mMatrix = WarpMatrix_t::Translate(-(cSource.GetWidth()-1)/2.0,-(cSource.GetHeight()-1)/2.0)
+                             * WarpMatrix_t::Scale(fScale) * WarpMatrix_t::Rotate(fDegrees)
+                             * WarpMatrix_t::Translate(pDestCenter.x,pDestCenter.y);
+
+        return Warp(*cSource,*cDest,mMatrix,eSample,nullptr,sMask);
+    }
+
+    // GetBoundingRect() -- Destination rectangle covered by a source of szSource warped with mMatrix (i.e. for a dirty rectangle or sizing the destination)
+    //
+    static RECT GetBoundingRect(SIZE szSource,const WarpMatrix_t & mMatrix)
+    {
+        CfPoint p[4] = { mMatrix.Transform(-.5,-.5), mMatrix.Transform(szSource.cx-.5,-.5),
+                         mMatrix.Transform(-.5,szSource.cy-.5), mMatrix.Transform(szSource.cx-.5,szSource.cy-.5) };
+
+        double fMinX = p[0].x, fMaxX = p[0].x, fMinY = p[0].y, fMaxY = p[0].y;
+        for (int i=1;i<4;i++)
+        {
+            fMinX = min(fMinX,p[i].x); fMaxX = max(fMaxX,p[i].x);
+            fMinY = min(fMinY,p[i].y); fMaxY = max(fMaxY,p[i].y);
+        }
+        return { (LONG) std::floor(fMinX), (LONG) std::floor(fMinY), (LONG) std::ceil(fMaxX) + 1, (LONG) std::ceil(fMaxY) + 1 };
+    }
+};
+
+}; // namespace Sage
+#endif // _CWarp_H_
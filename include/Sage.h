@@ -125,7 +125,7 @@ enum class ImageStatus
 #endif
 #include <Windows.h>
 #include "CDevString.h"
-#include "Sagestring.h"
+#include "SageString.h"
 #if 0
 #define FailBox(_FunctionName,_Error) Sage::FailBoxMsg((char *) _FunctionName,(char *) _Error);
 #else
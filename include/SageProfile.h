@@ -0,0 +1,33 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// SageProfile -- The SageProfile macros (see CProfiler.h)
+//
+// Profiling is opt-in: with SAGE_PROFILE defined (and SAGE_NO_PROFILER not defined), the macros record into CProfiler,
+// and this header includes CProfiler.h.  Otherwise they compile to nothing and nothing else is included, so headers
+// instrumented with SageProfileZone() cost nothing, at compile time or at run time, in programs that do not profile.
+//
+//      SageProfileZone("Mandelbrot::Row");         -- Times the enclosing scope (zones nest)
+//      SageProfileCounter("Iterations",iIter);     -- A value over time
+//      SageProfileFrame();                         -- End of a frame (i.e. after Update())
+//
+// SAGE_PROFILE must be defined the same way for the whole program (i.e. on the compiler command line).
+//
+#if !defined(_SageProfile_H_)
+#define _SageProfile_H_
+
+#define _SageProfileConcat2(a,b) a##b
+#define _SageProfileConcat(a,b) _SageProfileConcat2(a,b)
+
+#if defined(SAGE_PROFILE) && !defined(SAGE_NO_PROFILER)
+#include "CProfiler.h"
+#define SageProfileZone(sName)              Sage::CProfiler::Zone _SageProfileConcat(cSageProfileZone,__LINE__)(sName)
+#define SageProfileCounter(sName,fValue)    Sage::CProfiler::Counter(sName,(double) (fValue))
+#define SageProfileFrame()                  Sage::CProfiler::Frame()
+#else
+#define SageProfileZone(sName)
+#define SageProfileCounter(sName,fValue)
+#define SageProfileFrame()
+#endif
+
+#endif // _SageProfile_H_
@@ -0,0 +1,480 @@
+// This file copyright(c) 2021 Rob Nelson, All Rights Reserved.    E-mail rob@projectsagebox.com for more information.
+//
+
+// -------------------------------------------------------------------------------------------
+// SageTypedOpt.H -- OptSet_t and topt namespace -- typed, compile-time options for controls
+// -------------------------------------------------------------------------------------------
+//
+// cwfOpt (SageOpt.h) builds options by concatenating strings, using a global recycled array of cwfOpt objects guarded
+// by a process lock, and the receiving function then parses the string back out with GetOptInt(), GetOptColor(), etc.
+//
+// OptSet_t holds the same common options as typed fields in a fixed-layout structure, with a bitmask of which options
+// are present.  The topt:: functions are constexpr, so a full option set such as
+//
+//      constexpr auto kMyButtonOpt = topt::fgColor(RGB(255,0,0)) | topt::Font("Arial,15") | topt::Transparent();
+//
+// is built entirely at compile time -- no memory allocation and no lock.  Code that takes an OptSet_t reads the options
+// back with typed accessors, without parsing:
+//
+//      DWORD dwColor;
+//      if (stOpt.GetColor(OptKey::FgColor,dwColor)) ...
+//      if (stOpt.isSet(OptKey::Transparent)) ...
+//
+// Combining with '|' (or '<<' or '+') works like cwfOpt, except that when the same option is given twice the
+// right-most value is used.
+//
+// Current state -- what is and is not saved:
+//
+// The library functions (NewButton(), NewWindow(), etc.) still take a cwfOpt, and none of them read an OptSet_t yet.
+// An OptSet_t passed to them converts to the equivalent cwfOpt string (ToOpt(), through operator cwfOpt()) at each call,
+// and the function parses that string exactly as it would a cwfOpt, e.g.
+//
+//      MyWindow.NewButton(10,10,"Ok",topt::fgColor("Red") | topt::Transparent());   // Builds "fgColor=Red,Transparent" here
+//
+// So for these calls OptSet_t avoids the global cwfOpt array and its lock (the options themselves are built at compile time),
+// but not the string building or the parsing.  The parse-free path applies only to code that takes an OptSet_t itself
+// (i.e. application controls and widgets written against OptSet_t).  The typed accessors are the interface the library
+// functions will read once they take an OptSet_t directly.
+//
+// Strings given to topt:: functions (fonts, names, color names, etc.) are not copied and must outlive the OptSet_t.
+// String literals (the common case) always do.
+//
+#if !defined(_SageTypedOpt_H_)
+#define _SageTypedOpt_H_
+
+#include "SageOpt.h"
+
+namespace Sage
+{
+
+// OptKey -- index of each option in OptSet_t (and its bit in the presence mask)
+//
+enum class OptKey : int
+{
+    // Colors
+
+    FgColor,
+    BgColor,
+    BgColor2,
+    FgHigh,
+    BgHigh,
+    FgChecked,
+    BgChecked,
+    TextColor,
+    ValueColor,
+    LabelColor,
+    BorderColor,
+
+    // Strings
+
+    Font,
+    FontHigh,
+    FontChecked,
+    ValueFont,
+    LabelFont,
+    Style,
+    Title,
+    Label,
+    Name,
+    Group,
+    Plate,
+    DefaultString,
+
+    // Numeric values
+
+    Blend,
+    PadX,
+    PadY,
+    OffsetX,
+    OffsetY,
+    GroupID,
+    ControlID,
+    Width,
+    CharWidth,
+    DefaultInt,
+    DefaultFloat,
+    MinMax,
+    Checked,
+
+    // Flags
+
+    Transparent,
+    Hidden,
+    AllowDrag,
+    Border,
+    ThickBorder,
+    NoBorder,
+    NoClose,
+    Resizeable,
+    Modal,
+    Popup,
+    AddShadow,
+    Disabled,
+    ReadOnly,
+    NumbersOnly,
+    FloatsOnly,
+    ShowValue,
+    NoAutoUpdate,
+    Horizontal,
+    Vertical,
+    Center,
+    CenterX,
+    CenterY,
+    TextCenter,
+    TextCenterX,
+    TextCenterY,
+
+    Count
+};
+
+static_assert((int) OptKey::Count <= 64,"OptKey: too many options for the 64-bit presence mask");
+
+// OptColor_t -- A color option given either as a color value or as a color name (i.e. "Red", "MyColor").
+//
+// Names are resolved by the receiving function, since named colors may be defined at run-time.
+//
+struct OptColor_t
+{
+    DWORD dwColor;
+    const char * sName;
+
+    constexpr OptColor_t() : dwColor(0), sName(nullptr) { }
+    constexpr OptColor_t(DWORD dwColor) : dwColor(dwColor), sName(nullptr) { }
+    constexpr OptColor_t(int iColor) : dwColor((DWORD) iColor), sName(nullptr) { }         // int and unsigned int overloads make literals such as
+    constexpr OptColor_t(unsigned int uiColor) : dwColor((DWORD) uiColor), sName(nullptr) { }   // fgColor(0) a color rather than ambiguous with a name
+    constexpr OptColor_t(const char * sName) : dwColor(0), sName(sName) { }
+    OptColor_t(const RGBColor_t & rgbColor) : dwColor(RGB(rgbColor.iRed,rgbColor.iGreen,rgbColor.iBlue)), sName(nullptr) { }
+
+    constexpr bool isName() const { return sName != nullptr; }
+};
+
+// OptSet_t -- Fixed-layout set of typed options.  See notes at the top of this file.
+//
+struct OptSet_t
+{
+    static constexpr int kNumColors     = (int) OptKey::Font;
+    static constexpr int kNumStrings    = (int) OptKey::Blend - (int) OptKey::Font;
+    static constexpr int kNumInts       = (int) OptKey::DefaultFloat - (int) OptKey::Blend;
+
+    unsigned long long  uiSet           = 0;                // Bit (1 << OptKey) set for each option present
+    OptColor_t          stColor[kNumColors]     = {};       // OptKey::FgColor ... OptKey::BorderColor
+    const char *        sString[kNumStrings]    = {};       // OptKey::Font ... OptKey::DefaultString
+    int                 iValue[kNumInts]        = {};       // OptKey::Blend ... OptKey::DefaultInt
+    double              fDefault                = 0;        // OptKey::DefaultFloat
+    double              fMin                    = 0;        // OptKey::MinMax
+    double              fMax                    = 0;
+    bool                bChecked                = false;    // OptKey::Checked
+
+    static constexpr unsigned long long Bit(OptKey eKey) { return 1ULL << (int) eKey; }
+
+    constexpr bool isSet(OptKey eKey) const { return (uiSet & Bit(eKey)) != 0; }
+    constexpr bool isEmpty() const { return !uiSet; }
+
+    // SetColor(), SetString(), SetInt(), SetFlag() -- Set an option of the given type.  Return *this so they may be chained.
+    //
+    constexpr OptSet_t & SetColor(OptKey eKey,OptColor_t stValue)
+    {
+        stColor[(int) eKey] = stValue;
+        uiSet |= Bit(eKey);
+        return *this;
+    }
+    constexpr OptSet_t & SetString(OptKey eKey,const char * sValue)
+    {
+        sString[(int) eKey - (int) OptKey::Font] = sValue;
+        uiSet |= Bit(eKey);
+        return *this;
+    }
+    constexpr OptSet_t & SetInt(OptKey eKey,int iSetValue)
+    {
+        iValue[(int) eKey - (int) OptKey::Blend] = iSetValue;
+        uiSet |= Bit(eKey);
+        return *this;
+    }
+    constexpr OptSet_t & SetFlag(OptKey eKey,bool bSet = true)
+    {
+        if (bSet) uiSet |= Bit(eKey);
+        else uiSet &= ~Bit(eKey);
+        return *this;
+    }
+
+    // GetColor() -- Get a color option.  Returns false if the option is not set or is a color name, in which case
+    // GetColorName() returns the name.
+    //
+    constexpr bool GetColor(OptKey eKey,DWORD & dwColor) const
+    {
+        if (!isSet(eKey) || stColor[(int) eKey].isName()) return false;
+        dwColor = stColor[(int) eKey].dwColor;
+        return true;
+    }
+
+    // GetColorName() -- Returns the color name for a color option, or nullptr if not set or set as a value.
+    //
+    constexpr const char * GetColorName(OptKey eKey) const { return isSet(eKey) ? stColor[(int) eKey].sName : nullptr; }
+
+    // GetString() -- Returns the string for a string option, or sDefault if it is not set.
+    //
+    constexpr const char * GetString(OptKey eKey,const char * sDefault = nullptr) const
+    {
+        return isSet(eKey) ? sString[(int) eKey - (int) OptKey::Font] : sDefault;
+    }
+
+    // GetInt() -- Returns the value for an integer option, or iDefault if it is not set.
+    //
+    constexpr int GetInt(OptKey eKey,int iDefault = 0) const
+    {
+        return isSet(eKey) ? iValue[(int) eKey - (int) OptKey::Blend] : iDefault;
+    }
+
+    constexpr double GetDefaultFloat(double fDefaultValue = 0) const { return isSet(OptKey::DefaultFloat) ? fDefault : fDefaultValue; }
+    constexpr bool GetChecked(bool bDefault = false) const { return isSet(OptKey::Checked) ? bChecked : bDefault; }
+
+    // GetMinMax() -- Returns false (and leaves the values unchanged) if MinMax() was not set.
+    //
+    constexpr bool GetMinMax(double & fMinValue,double & fMaxValue) const
+    {
+        if (!isSet(OptKey::MinMax)) return false;
+        fMinValue = fMin;
+        fMaxValue = fMax;
+        return true;
+    }
+
+    // Merge() -- Add all options set in stOpt, replacing any that are already set.
+    //
+    constexpr OptSet_t & Merge(const OptSet_t & stOpt)
+    {
+        for (int i=0;i<(int) OptKey::Count;i++)
+        {
+            if (!stOpt.isSet((OptKey) i)) continue;
+
+            if (i < (int) OptKey::Font) stColor[i] = stOpt.stColor[i];
+            else if (i < (int) OptKey::Blend) sString[i - (int) OptKey::Font] = stOpt.sString[i - (int) OptKey::Font];
+            else if (i < (int) OptKey::DefaultFloat) iValue[i - (int) OptKey::Blend] = stOpt.iValue[i - (int) OptKey::Blend];
+        }
+        if (stOpt.isSet(OptKey::DefaultFloat)) fDefault = stOpt.fDefault;
+        if (stOpt.isSet(OptKey::MinMax)) { fMin = stOpt.fMin; fMax = stOpt.fMax; }
+        if (stOpt.isSet(OptKey::Checked)) bChecked = stOpt.bChecked;
+
+        uiSet |= stOpt.uiSet;
+        return *this;
+    }
+
+    constexpr OptSet_t operator | (const OptSet_t & stOpt) const { OptSet_t stOut = *this; return stOut.Merge(stOpt); }
+    constexpr OptSet_t operator << (const OptSet_t & stOpt) const { return *this | stOpt; }
+    constexpr OptSet_t operator + (const OptSet_t & stOpt) const { return *this | stOpt; }
+    constexpr OptSet_t & operator |= (const OptSet_t & stOpt) { return Merge(stOpt); }
+
+    // ToOpt() -- Build the equivalent cwfOpt, for functions that still take a cwfOpt.
+    //
+    // This builds the option string once per call; it does not use the global cwfOpt array or its lock.
+    //
+    cwfOpt ToOpt() const
+    {
+        cwfOpt cOpt;
+        if (!uiSet) return cOpt;
+
+        auto AddColor = [&](OptKey eKey,cwfOpt & (cwfOpt::*fnName)(const char *),cwfOpt & (cwfOpt::*fnValue)(DWORD))
+        {
+            if (!isSet(eKey)) return;
+            auto & stColorOpt = stColor[(int) eKey];
+            if (stColorOpt.isName()) (cOpt.*fnName)(stColorOpt.sName);
+            else (cOpt.*fnValue)(stColorOpt.dwColor);
+        };
+
+        AddColor(OptKey::FgColor,       &cwfOpt::fgColor,       &cwfOpt::fgColor);
+        AddColor(OptKey::BgColor,       &cwfOpt::bgColor,       &cwfOpt::bgColor);
+        AddColor(OptKey::BgColor2,      &cwfOpt::bgColor2,      &cwfOpt::bgColor2);
+        AddColor(OptKey::FgHigh,        &cwfOpt::fgHigh,        &cwfOpt::fgHigh);
+        AddColor(OptKey::BgHigh,        &cwfOpt::bgHigh,        &cwfOpt::bgHigh);
+        AddColor(OptKey::FgChecked,     &cwfOpt::fgChecked,     &cwfOpt::fgChecked);
+        AddColor(OptKey::BgChecked,     &cwfOpt::bgChecked,     &cwfOpt::bgChecked);
+        AddColor(OptKey::TextColor,     &cwfOpt::TextColor,     &cwfOpt::TextColor);
+        AddColor(OptKey::ValueColor,    &cwfOpt::ValueColor,    &cwfOpt::ValueColor);
+        AddColor(OptKey::LabelColor,    &cwfOpt::LabelColor,    &cwfOpt::LabelColor);
+        AddColor(OptKey::BorderColor,   &cwfOpt::BorderColor,   &cwfOpt::BorderColor);
+
+        auto AddString = [&](OptKey eKey,cwfOpt & (cwfOpt::*fnString)(const char *))
+        {
+            if (isSet(eKey)) (cOpt.*fnString)(GetString(eKey,""));
+        };
+
+        AddString(OptKey::Font,         &cwfOpt::Font);
+        AddString(OptKey::FontHigh,     &cwfOpt::FontHigh);
+        AddString(OptKey::FontChecked,  &cwfOpt::FontChecked);
+        AddString(OptKey::ValueFont,    &cwfOpt::ValueFont);
+        AddString(OptKey::LabelFont,    &cwfOpt::LabelFont);
+        AddString(OptKey::Style,        &cwfOpt::Style);
+        AddString(OptKey::Title,        &cwfOpt::Title);
+        AddString(OptKey::Label,        &cwfOpt::Label);
+        AddString(OptKey::Name,         &cwfOpt::Name);
+        AddString(OptKey::Group,        &cwfOpt::Group);
+        AddString(OptKey::Plate,        &cwfOpt::Plate);
+        AddString(OptKey::DefaultString,&cwfOpt::Default);
+
+        auto AddInt = [&](OptKey eKey,cwfOpt & (cwfOpt::*fnInt)(int))
+        {
+            if (isSet(eKey)) (cOpt.*fnInt)(GetInt(eKey));
+        };
+
+        // Transparent(int) and Blend(int) are the same option; Transparent() without a value is handled with the flags.
+
+        if (isSet(OptKey::Blend)) cOpt.Transparent(GetInt(OptKey::Blend));
+        else if (isSet(OptKey::Transparent)) cOpt.Transparent();
+
+        AddInt(OptKey::PadX,            &cwfOpt::PadX);
+        AddInt(OptKey::PadY,            &cwfOpt::PadY);
+        AddInt(OptKey::OffsetX,         &cwfOpt::OffsetX);
+        AddInt(OptKey::OffsetY,         &cwfOpt::OffsetY);
+        AddInt(OptKey::GroupID,         &cwfOpt::GroupID);
+        AddInt(OptKey::ControlID,       &cwfOpt::ControlID);
+        AddInt(OptKey::Width,           &cwfOpt::Width);
+        AddInt(OptKey::CharWidth,       &cwfOpt::CharWidth);
+        AddInt(OptKey::DefaultInt,      &cwfOpt::Default);
+
+        if (isSet(OptKey::DefaultFloat))    cOpt.Default(fDefault);
+        if (isSet(OptKey::MinMax))          cOpt.MinMax(fMin,fMax);
+        if (isSet(OptKey::Checked))         cOpt.Checked(bChecked);
+
+        auto AddFlag = [&](OptKey eKey,cwfOpt & (cwfOpt::*fnFlag)())
+        {
+            if (isSet(eKey)) (cOpt.*fnFlag)();
+        };
+
+        AddFlag(OptKey::Hidden,         &cwfOpt::Hidden);
+        AddFlag(OptKey::AllowDrag,      &cwfOpt::AllowDrag);
+        AddFlag(OptKey::Border,         &cwfOpt::Border);
+        AddFlag(OptKey::ThickBorder,    &cwfOpt::ThickBorder);
+        AddFlag(OptKey::NoBorder,       &cwfOpt::NoBorder);
+        AddFlag(OptKey::NoClose,        &cwfOpt::NoClose);
+        AddFlag(OptKey::Resizeable,     &cwfOpt::Resizeable);
+        AddFlag(OptKey::Modal,          &cwfOpt::Modal);
+        AddFlag(OptKey::Popup,          &cwfOpt::Popup);
+        AddFlag(OptKey::AddShadow,      &cwfOpt::AddShadow);
+        AddFlag(OptKey::Disabled,       &cwfOpt::Disabled);
+        AddFlag(OptKey::ReadOnly,       &cwfOpt::ReadOnly);
+        AddFlag(OptKey::NumbersOnly,    &cwfOpt::NumbersOnly);
+        AddFlag(OptKey::FloatsOnly,     &cwfOpt::FloatsOnly);
+        AddFlag(OptKey::ShowValue,      &cwfOpt::ShowValue);
+        AddFlag(OptKey::NoAutoUpdate,   &cwfOpt::NoAutoUpdate);
+        AddFlag(OptKey::Horizontal,     &cwfOpt::Horizontal);
+        AddFlag(OptKey::Vertical,       &cwfOpt::Vertical);
+        AddFlag(OptKey::Center,         &cwfOpt::Center);
+        AddFlag(OptKey::CenterX,        &cwfOpt::CenterX);
+        AddFlag(OptKey::CenterY,        &cwfOpt::CenterY);
+        AddFlag(OptKey::TextCenter,     &cwfOpt::TextCenter);
+        AddFlag(OptKey::TextCenterX,    &cwfOpt::TextCenterX);
+        AddFlag(OptKey::TextCenterY,    &cwfOpt::TextCenterY);
+
+        return cOpt;
+    }
+
+    // Compatibility adapter so an OptSet_t may be passed to any function taking a cwfOpt.  This builds the option string
+    // (ToOpt()) on every call, which the function then parses -- see the notes at the top of this file.
+    //
+    operator cwfOpt () const { return ToOpt(); }
+};
+
+// OptSet_t and cwfOpt may be mixed, e.g. topt::fgColor("Red") | opt::Font(MyFont), which produces a cwfOpt.
+//
+static inline cwfOpt operator | (const OptSet_t & stOpt,const cwfOpt & cOpt) { cwfOpt cOut = stOpt.ToOpt(); cOut | cOpt; return cOut; }
+
+// -----------------------------------------------------------------------------------------------------------------------
+// topt namespace -- constexpr option builders.  These mirror the opt:: functions of the same name (see SageOpt.h for
+// a description of each option) but return an OptSet_t.
+// -----------------------------------------------------------------------------------------------------------------------
+
+namespace topt
+{
+    static constexpr OptSet_t Color_(OptKey eKey,OptColor_t stColor) { return OptSet_t().SetColor(eKey,stColor); }
+    static constexpr OptSet_t String_(OptKey eKey,const char * sValue) { return OptSet_t().SetString(eKey,sValue); }
+    static constexpr OptSet_t Int_(OptKey eKey,int iValue) { return OptSet_t().SetInt(eKey,iValue); }
+    static constexpr OptSet_t Flag_(OptKey eKey) { return OptSet_t().SetFlag(eKey); }
+
+    static constexpr OptSet_t fgColor(OptColor_t stColor)       { return Color_(OptKey::FgColor,stColor);       }
+    static constexpr OptSet_t bgColor(OptColor_t stColor)       { return Color_(OptKey::BgColor,stColor);       }
+    static constexpr OptSet_t bgColor2(OptColor_t stColor)      { return Color_(OptKey::BgColor2,stColor);      }
+    static constexpr OptSet_t fgHigh(OptColor_t stColor)        { return Color_(OptKey::FgHigh,stColor);        }
+    static constexpr OptSet_t bgHigh(OptColor_t stColor)        { return Color_(OptKey::BgHigh,stColor);        }
+    static constexpr OptSet_t fgChecked(OptColor_t stColor)     { return Color_(OptKey::FgChecked,stColor);     }
+    static constexpr OptSet_t bgChecked(OptColor_t stColor)     { return Color_(OptKey::BgChecked,stColor);     }
+    static constexpr OptSet_t TextColor(OptColor_t stColor)     { return Color_(OptKey::TextColor,stColor);     }
+    static constexpr OptSet_t ValueColor(OptColor_t stColor)    { return Color_(OptKey::ValueColor,stColor);    }
+    static constexpr OptSet_t LabelColor(OptColor_t stColor)    { return Color_(OptKey::LabelColor,stColor);    }
+    static constexpr OptSet_t BorderColor(OptColor_t stColor)   { return Color_(OptKey::BorderColor,stColor);   }
+
+    static constexpr OptSet_t Font(const char * sFont)          { return String_(OptKey::Font,sFont);           }
+    static constexpr OptSet_t FontHigh(const char * sFont)      { return String_(OptKey::FontHigh,sFont);       }
+    static constexpr OptSet_t FontChecked(const char * sFont)   { return String_(OptKey::FontChecked,sFont);    }
+    static constexpr OptSet_t ValueFont(const char * sFont)     { return String_(OptKey::ValueFont,sFont);      }
+    static constexpr OptSet_t LabelFont(const char * sFont)     { return String_(OptKey::LabelFont,sFont);      }
+    static constexpr OptSet_t Style(const char * sStyle)        { return String_(OptKey::Style,sStyle);         }
+    static constexpr OptSet_t Title(const char * sTitle)        { return String_(OptKey::Title,sTitle);         }
+    static constexpr OptSet_t Label(const char * sLabel)        { return String_(OptKey::Label,sLabel);         }
+    static constexpr OptSet_t Name(const char * sName)          { return String_(OptKey::Name,sName);           }
+    static constexpr OptSet_t Group(const char * sGroup)        { return String_(OptKey::Group,sGroup);         }
+    static constexpr OptSet_t Plate(const char * sPlate)        { return String_(OptKey::Plate,sPlate);         }
+    static constexpr OptSet_t Default(const char * sDefault)    { return String_(OptKey::DefaultString,sDefault);}
+
+    static constexpr OptSet_t Transparent(int iBlendValue)      { return Int_(OptKey::Blend,iBlendValue).SetFlag(OptKey::Transparent); }
+    static constexpr OptSet_t Blend(int iBlendValue)            { return Transparent(iBlendValue);              }
+    static constexpr OptSet_t PadX(int iPad)                    { return Int_(OptKey::PadX,iPad);               }
+    static constexpr OptSet_t PadY(int iPad)                    { return Int_(OptKey::PadY,iPad);               }
+    static constexpr OptSet_t OffsetX(int iOffset)              { return Int_(OptKey::OffsetX,iOffset);         }
+    static constexpr OptSet_t OffsetY(int iOffset)              { return Int_(OptKey::OffsetY,iOffset);         }
+    static constexpr OptSet_t GroupID(int iGroupID)             { return Int_(OptKey::GroupID,iGroupID);        }
+    static constexpr OptSet_t ControlID(int iControlID)         { return Int_(OptKey::ControlID,iControlID);    }
+    static constexpr OptSet_t Width(int iWidth)                 { return Int_(OptKey::Width,iWidth);            }
+    static constexpr OptSet_t CharWidth(int iCharWidth)         { return Int_(OptKey::CharWidth,iCharWidth);    }
+    static constexpr OptSet_t Default(int iDefault)             { return Int_(OptKey::DefaultInt,iDefault);     }
+
+    static constexpr OptSet_t Default(double fDefault)
+    {
+        OptSet_t stOpt;
+        stOpt.fDefault = fDefault;
+        return stOpt.SetFlag(OptKey::DefaultFloat);
+    }
+    static constexpr OptSet_t MinMax(double fMin,double fMax)
+    {
+        OptSet_t stOpt;
+        stOpt.fMin = fMin;
+        stOpt.fMax = fMax;
+        return stOpt.SetFlag(OptKey::MinMax);
+    }
+    static constexpr OptSet_t MinMax(int iMin,int iMax) { return MinMax((double) iMin,(double) iMax); }
+    static constexpr OptSet_t Checked(bool bChecked = true)
+    {
+        OptSet_t stOpt;
+        stOpt.bChecked = bChecked;
+        return stOpt.SetFlag(OptKey::Checked);
+    }
+
+    static constexpr OptSet_t Transparent()                     { return Flag_(OptKey::Transparent);            }
+    static constexpr OptSet_t Hidden()                          { return Flag_(OptKey::Hidden);                 }
+    static constexpr OptSet_t AllowDrag()                       { return Flag_(OptKey::AllowDrag);              }
+    static constexpr OptSet_t Border()                          { return Flag_(OptKey::Border);                 }
+    static constexpr OptSet_t ThickBorder()                     { return Flag_(OptKey::ThickBorder);            }
+    static constexpr OptSet_t NoBorder()                        { return Flag_(OptKey::NoBorder);               }
+    static constexpr OptSet_t NoClose()                         { return Flag_(OptKey::NoClose);                }
+    static constexpr OptSet_t Resizeable()                      { return Flag_(OptKey::Resizeable);             }
+    static constexpr OptSet_t Modal()                           { return Flag_(OptKey::Modal);                  }
+    static constexpr OptSet_t Popup()                           { return Flag_(OptKey::Popup);                  }
+    static constexpr OptSet_t AddShadow()                       { return Flag_(OptKey::AddShadow);              }
+    static constexpr OptSet_t Disabled()                        { return Flag_(OptKey::Disabled);               }
+    static constexpr OptSet_t ReadOnly()                        { return Flag_(OptKey::ReadOnly);               }
+    static constexpr OptSet_t NumbersOnly()                     { return Flag_(OptKey::NumbersOnly);            }
+    static constexpr OptSet_t FloatsOnly()                      { return Flag_(OptKey::FloatsOnly);             }
+    static constexpr OptSet_t ShowValue()                       { return Flag_(OptKey::ShowValue);              }
+    static constexpr OptSet_t NoAutoUpdate()                    { return Flag_(OptKey::NoAutoUpdate);           }
+    static constexpr OptSet_t Horizontal()                      { return Flag_(OptKey::Horizontal);             }
+    static constexpr OptSet_t Horz()                            { return Flag_(OptKey::Horizontal);             }
+    static constexpr OptSet_t Vertical()                        { return Flag_(OptKey::Vertical);               }
+    static constexpr OptSet_t Vert()                            { return Flag_(OptKey::Vertical);               }
+    static constexpr OptSet_t Center()                          { return Flag_(OptKey::Center);                 }
+    static constexpr OptSet_t CenterX()                         { return Flag_(OptKey::CenterX);                }
+    static constexpr OptSet_t CenterY()                         { return Flag_(OptKey::CenterY);                }
+    static constexpr OptSet_t TextCenter()                      { return Flag_(OptKey::TextCenter);             }
+    static constexpr OptSet_t TextCenterX()                     { return Flag_(OptKey::TextCenterX);            }
+    static constexpr OptSet_t TextCenterY()                     { return Flag_(OptKey::TextCenterY);            }
+}; // namespace topt
+
+}; // namespace Sage
+#endif // _SageTypedOpt_H_